@@ -0,0 +1,121 @@
+#!/usr/bin/env python
+
+# Precompute the "fruit" dither matrices for the common sizes. This is the
+# same algorithm as mp_make_fruit_dither_matrix() in video/out/dither.c, and
+# must be kept in sync with it. (Including the libavutil LFG, which is used
+# to break ties.)
+
+#
+# This file is part of mpv.
+#
+# mpv is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# mpv is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+import hashlib
+import math
+import struct
+import sys
+
+# Sizes (as log2) embedded into the binary. Larger sizes take too long to
+# generate with Python, and are computed at runtime instead.
+SIZES = range(2, 7)
+
+UINT64_MAX = 2**64 - 1
+M32 = 0xFFFFFFFF
+
+class LFG(object):
+    # av_lfg_init() / av_lfg_get()
+    def __init__(self, seed):
+        self.state = [0] * 64
+        tmp = bytearray(16)
+        for i in range(8, 64, 4):
+            tmp[0:4] = struct.pack('<I', seed)
+            tmp[4] = i
+            tmp = bytearray(hashlib.md5(bytes(tmp)).digest())
+            self.state[i:i + 4] = struct.unpack('<4I', bytes(tmp))
+        self.index = 0
+
+    def get(self):
+        s = self.state
+        i = self.index
+        a = (s[(i - 24) & 63] + s[(i - 55) & 63]) & M32
+        s[i & 63] = a
+        self.index = i + 1
+        return a
+
+def make_matrix(sizeb):
+    lfg = LFG(123)
+    size = 1 << sizeb
+    size2 = size * size
+    xy = lambda x, y: x | (y << sizeb)
+
+    radius = size // 2 - 1
+    middle = xy(radius, radius)
+    gsize = radius * 2 + 1
+    gsize2 = gsize * gsize
+
+    gauss = [0] * size2
+    sigma = -math.log(1.5 / float(UINT64_MAX) * gsize2) / radius
+    for gy in range(radius + 1):
+        for gx in range(gy + 1):
+            cx = gx - radius
+            cy = gy - radius
+            e = math.exp(-math.sqrt(cx * cx + cy * cy) * sigma)
+            v = int(e / gsize2 * float(UINT64_MAX))
+            for c in (xy(gx, gy), xy(gy, gx),
+                      xy(gx, gsize - 1 - gy), xy(gy, gsize - 1 - gx),
+                      xy(gsize - 1 - gx, gy), xy(gsize - 1 - gy, gx),
+                      xy(gsize - 1 - gx, gsize - 1 - gy),
+                      xy(gsize - 1 - gy, gsize - 1 - gx)):
+                gauss[c] = v
+
+    calcmat = [False] * size2
+    gaussmat = [0] * size2
+    unimat = [0] * size2
+    for n in range(size2):
+        # getmin()
+        free = [c for c in range(size2) if not calcmat[c]]
+        low = min(gaussmat[c] for c in free)
+        res = [c for c in free if gaussmat[c] == low]
+        if len(res) == 1:
+            r = res[0]
+        elif len(res) == size2:
+            r = size2 // 2
+        else:
+            r = res[lfg.get() % len(res)]
+        # setbit()
+        calcmat[r] = True
+        w = (middle + size2 - r) & (size2 - 1)
+        rot = gauss[w:] + gauss[:w]
+        gaussmat = [a + b for a, b in zip(gaussmat, rot)]
+        unimat[r] = n
+
+    # Same layout as the output of mp_make_fruit_dither_matrix().
+    return [unimat[xy(x, y)] for y in range(size) for x in range(size)]
+
+def generate_C_dither_matrices(out):
+    out.write("// Generated by TOOLS/dither.py\n\n")
+    for sizeb in SIZES:
+        m = make_matrix(sizeb)
+        out.write("static const uint16_t fruit_dither_%d[] = {\n" % sizeb)
+        for n in range(0, len(m), 12):
+            out.write("    " + ", ".join("%d" % v for v in m[n:n + 12]) + ",\n")
+        out.write("};\n\n")
+    out.write("static const uint16_t *const fruit_dither_builtin[] = {\n")
+    for sizeb in SIZES:
+        out.write("    [%d] = fruit_dither_%d,\n" % (sizeb, sizeb))
+    out.write("};\n")
+
+if __name__ == "__main__":
+    generate_C_dither_matrices(sys.stdout)
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+
+"""
+Measure the GPU time of vo_gpu's render passes for a set of option profiles.
+
+For each profile, this plays the given file with mpv (looping, untimed, no
+audio) for a while, then reads the vo-passes property over the JSON IPC and
+prints one JSON object per profile on stdout:
+
+    {"profile": "gpu-hq", "mpv": "mpv 0.29.0", "frames": 1234,
+     "total-avg": 1234567, "passes": [{"desc": "...", "avg": ..., "peak": ...,
+     "count": ...}, ...]}
+
+All times are in nanoseconds, as measured by the renderer's GPU timers (the
+same numbers as shown on the stats page). Comparing the output of two mpv
+builds on the same machine and file shows shader regressions per pass.
+
+Usage:
+
+    TOOLS/gpu-bench.py [--mpv=path] [--time=seconds] [--profile=name]...
+                       [--shader=file.glsl] file
+
+Without --profile, all built-in profiles are run. More mpv options can be
+passed with the MPV_OPTS environment variable (split on whitespace), e.g. to
+select --gpu-api or --gpu-context. Since the renderer needs a window, this
+needs a display; a headless X server (like Xvfb with a GPU-backed GL) works.
+"""
+
+import argparse
+import json
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+PROFILES = {
+    "default": [],
+    "gpu-hq": ["--profile=gpu-hq"],
+    # Pretend the source is PQ/BT.2020, so tone mapping runs on any file.
+    "hdr-tonemap": ["--vf=format=gamma=pq:primaries=bt.2020",
+                    "--tone-mapping=hable", "--hdr-compute-peak=yes"],
+    "interpolation": ["--interpolation", "--video-sync=display-resample",
+                      "--tscale=oversample"],
+    "user-shaders": None, # filled in from --shader
+}
+
+def ipc_request(sock, command):
+    sock.sendall((json.dumps({"command": command}) + "\n").encode("utf-8"))
+    buf = b""
+    while True:
+        data = sock.recv(65536)
+        if not data:
+            raise RuntimeError("mpv closed the IPC connection")
+        buf += data
+        while b"\n" in buf:
+            line, buf = buf.split(b"\n", 1)
+            msg = json.loads(line.decode("utf-8"))
+            if "event" in msg:
+                continue
+            if msg.get("error") != "success":
+                raise RuntimeError("%s: %s" % (command, msg.get("error")))
+            return msg.get("data")
+
+def connect(path, proc, timeout=10):
+    start = time.time()
+    while time.time() - start < timeout:
+        if proc.poll() is not None:
+            raise RuntimeError("mpv exited with code %d" % proc.returncode)
+        try:
+            sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            sock.connect(path)
+            return sock
+        except (FileNotFoundError, ConnectionRefusedError):
+            sock.close()
+            time.sleep(0.1)
+    raise RuntimeError("could not connect to mpv")
+
+def run_profile(args, name, opts):
+    tmpdir = tempfile.mkdtemp(prefix="mpv-gpu-bench-")
+    ipc = os.path.join(tmpdir, "ipc")
+    cmd = [args.mpv, "--no-config", "--vo=gpu", "--no-audio", "--untimed",
+           "--loop-file=inf", "--really-quiet", "--input-ipc-server=" + ipc]
+    cmd += os.environ.get("MPV_OPTS", "").split()
+    cmd += opts + ["--", args.file]
+    proc = subprocess.Popen(cmd, stdin=subprocess.DEVNULL)
+    try:
+        sock = connect(ipc, proc)
+        version = ipc_request(sock, ["get_property", "mpv-version"])
+        time.sleep(args.time)
+        passes = ipc_request(sock, ["get_property", "vo-passes"])
+        frames = ipc_request(sock, ["get_property", "estimated-frame-number"])
+        ipc_request(sock, ["quit"])
+        sock.close()
+    finally:
+        try:
+            proc.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+        if os.path.exists(ipc):
+            os.unlink(ipc)
+        os.rmdir(tmpdir)
+
+    fresh = (passes or {}).get("fresh", [])
+    res = {
+        "profile": name,
+        "mpv": version,
+        "frames": frames,
+        "total-avg": sum(p["avg"] for p in fresh),
+        "passes": [{k: p[k] for k in ("desc", "avg", "peak", "count")}
+                   for p in fresh],
+    }
+    return res
+
+def main():
+    parser = argparse.ArgumentParser(description="vo_gpu pass benchmark")
+    parser.add_argument("--mpv", default="mpv", help="mpv binary")
+    parser.add_argument("--time", type=float, default=10,
+                        help="seconds to play per profile (default: 10)")
+    parser.add_argument("--profile", action="append", choices=PROFILES.keys(),
+                        help="profile to run (can be repeated)")
+    parser.add_argument("--shader", action="append", default=[],
+                        help="user shader for the user-shaders profile")
+    parser.add_argument("file", help="video file to render")
+    args = parser.parse_args()
+
+    PROFILES["user-shaders"] = ["--glsl-shader=" + s for s in args.shader]
+    profiles = args.profile or [p for p in PROFILES
+                                if p != "user-shaders" or args.shader]
+
+    ok = True
+    for name in profiles:
+        try:
+            print(json.dumps(run_profile(args, name, PROFILES[name])))
+            sys.stdout.flush()
+        except RuntimeError as e:
+            sys.stderr.write("%s: %s\n" % (name, e))
+            ok = False
+    return 0 if ok else 1
+
+if __name__ == "__main__":
+    sys.exit(main())
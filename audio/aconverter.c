@@ -60,6 +60,7 @@ struct mp_aconverter {
     double playback_speed;
     bool is_resampling;
     bool passthrough_mode;
+    bool need_clip; // output can exceed the nominal float range
     struct AVAudioResampleContext *avrctx;
     struct mp_aframe *avrctx_fmt; // output format of avrctx
     struct mp_aframe *pool_fmt; // format used to allocate frames for avrctx output
@@ -336,6 +337,11 @@ static bool configure_lavrr(struct mp_aconverter *p, bool verbose)
 
     p->is_resampling = false;
 
+    // Integer input can't go out of range when only converting the format or
+    // downmixing with normalization. Resampling can overshoot.
+    p->need_clip = !af_fmt_is_int(p->in_format) || p->in_rate != p->out_rate ||
+                   !normalize;
+
     if (avresample_open(p->avrctx) < 0 || avresample_open(p->avrctx_out) < 0) {
         MP_ERR(p, "Cannot open Libavresample context.\n");
         goto error;
@@ -387,22 +393,35 @@ void mp_aconverter_set_speed(struct mp_aconverter *p, double speed)
     p->playback_speed = speed;
 }
 
+// Plain comparisons instead of av_clipf()/fminf(), so the compiler can turn
+// these into SIMD min/max.
+static void clip_float(float *ptr, int total)
+{
+    for (int s = 0; s < total; s++)
+        ptr[s] = MPCLAMP(ptr[s], -1.0f, 1.0f);
+}
+
+static void clip_double(double *ptr, int total)
+{
+    for (int s = 0; s < total; s++)
+        ptr[s] = MPCLAMP(ptr[s], -1.0, 1.0);
+}
+
 static void extra_output_conversion(struct mp_aframe *mpa)
 {
     int format = af_fmt_from_planar(mp_aframe_get_format(mpa));
+    if (format != AF_FORMAT_FLOAT && format != AF_FORMAT_DOUBLE)
+        return;
     int num_planes = mp_aframe_get_planes(mpa);
     uint8_t **planes = mp_aframe_get_data_rw(mpa);
     if (!planes)
         return;
+    int total = mp_aframe_get_total_plane_samples(mpa);
     for (int p = 0; p < num_planes; p++) {
-        void *ptr = planes[p];
-        int total = mp_aframe_get_total_plane_samples(mpa);
         if (format == AF_FORMAT_FLOAT) {
-            for (int s = 0; s < total; s++)
-                ((float *)ptr)[s] = av_clipf(((float *)ptr)[s], -1.0f, 1.0f);
-        } else if (format == AF_FORMAT_DOUBLE) {
-            for (int s = 0; s < total; s++)
-                ((double *)ptr)[s] = MPCLAMP(((double *)ptr)[s], -1.0, 1.0);
+            clip_float((float *)planes[p], total);
+        } else {
+            clip_double((double *)planes[p], total);
         }
     }
 }
@@ -503,7 +522,8 @@ static void filter_resample(struct mp_aconverter *p, struct mp_aframe *in)
             goto error;
     }
 
-    extra_output_conversion(out);
+    if (p->need_clip || p->is_resampling)
+        extra_output_conversion(out);
 
     if (in)
         mp_aframe_copy_attributes(out, in);
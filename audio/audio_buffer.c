@@ -32,7 +32,10 @@ struct mp_audio_buffer {
     int sstride;
     int num_planes;
     uint8_t *data[MP_NUM_CHANNELS];
-    int allocated;
+    uint8_t *read_ptrs[MP_NUM_CHANNELS];
+    int allocated;  // usable size in samples, as requested by the user
+    int capacity;   // actual size of data[] in samples
+    int start;      // offset of the first buffered sample in data[]
     int num_samples;
 };
 
@@ -52,6 +55,8 @@ void mp_audio_buffer_reinit_fmt(struct mp_audio_buffer *ab, int format,
     ab->channels = *channels;
     ab->srate = srate;
     ab->allocated = 0;
+    ab->capacity = 0;
+    ab->start = 0;
     ab->num_samples = 0;
     ab->sstride = af_fmt_to_bytes(ab->format);
     ab->num_planes = 1;
@@ -63,14 +68,18 @@ void mp_audio_buffer_reinit_fmt(struct mp_audio_buffer *ab, int format,
 }
 
 // Make the total size of the internal buffer at least this number of samples.
+// The actual allocation is twice as large, so that reading from the start
+// (mp_audio_buffer_skip()) doesn't need to move the remaining data each time.
 void mp_audio_buffer_preallocate_min(struct mp_audio_buffer *ab, int samples)
 {
     if (samples > ab->allocated) {
+        int capacity = samples * 2;
         for (int n = 0; n < ab->num_planes; n++) {
             ab->data[n] = talloc_realloc(ab, ab->data[n], char,
-                                         ab->sstride * samples);
+                                         ab->sstride * capacity);
         }
         ab->allocated = samples;
+        ab->capacity = capacity;
     }
 }
 
@@ -94,12 +103,30 @@ static void copy_planes(struct mp_audio_buffer *ab,
     }
 }
 
+// Move the buffered data to offset dst_start in data[].
+static void move_data(struct mp_audio_buffer *ab, int dst_start)
+{
+    if (ab->start != dst_start)
+        copy_planes(ab, ab->data, dst_start, ab->data, ab->start, ab->num_samples);
+    ab->start = dst_start;
+}
+
+// Make sure that the given number of samples can be added after the end of the
+// buffered data.
+static void reserve_end(struct mp_audio_buffer *ab, int samples)
+{
+    mp_audio_buffer_preallocate_min(ab, ab->num_samples + samples);
+    if (ab->start + ab->num_samples + samples > ab->capacity)
+        move_data(ab, 0);
+}
+
 // Append data to the end of the buffer.
 // If the buffer is not large enough, it is transparently resized.
 void mp_audio_buffer_append(struct mp_audio_buffer *ab, void **ptr, int samples)
 {
-    mp_audio_buffer_preallocate_min(ab, ab->num_samples + samples);
-    copy_planes(ab, ab->data, ab->num_samples, (uint8_t **)ptr, 0, samples);
+    reserve_end(ab, samples);
+    copy_planes(ab, ab->data, ab->start + ab->num_samples,
+                (uint8_t **)ptr, 0, samples);
     ab->num_samples += samples;
 }
 
@@ -107,19 +134,24 @@ void mp_audio_buffer_append(struct mp_audio_buffer *ab, void **ptr, int samples)
 void mp_audio_buffer_prepend_silence(struct mp_audio_buffer *ab, int samples)
 {
     assert(samples >= 0);
-    mp_audio_buffer_preallocate_min(ab, ab->num_samples + samples);
-    copy_planes(ab, ab->data, samples, ab->data, 0, ab->num_samples);
+    if (ab->start < samples) {
+        mp_audio_buffer_preallocate_min(ab, ab->num_samples + samples);
+        move_data(ab, samples);
+    }
+    ab->start -= samples;
     ab->num_samples += samples;
-    for (int n = 0; n < ab->num_planes; n++)
-        af_fill_silence(ab->data[n], samples * ab->sstride, ab->format);
+    for (int n = 0; n < ab->num_planes; n++) {
+        af_fill_silence(ab->data[n] + ab->start * ab->sstride,
+                        samples * ab->sstride, ab->format);
+    }
 }
 
 void mp_audio_buffer_duplicate(struct mp_audio_buffer *ab, int samples)
 {
     assert(samples >= 0 && samples <= ab->num_samples);
-    mp_audio_buffer_preallocate_min(ab, ab->num_samples + samples);
-    copy_planes(ab, ab->data, ab->num_samples,
-                ab->data, ab->num_samples - samples, samples);
+    reserve_end(ab, samples);
+    int end = ab->start + ab->num_samples;
+    copy_planes(ab, ab->data, end, ab->data, end - samples, samples);
     ab->num_samples += samples;
 }
 
@@ -127,7 +159,9 @@ void mp_audio_buffer_duplicate(struct mp_audio_buffer *ab, int samples)
 void mp_audio_buffer_peek(struct mp_audio_buffer *ab, uint8_t ***ptr,
                           int *samples)
 {
-    *ptr = ab->data;
+    for (int n = 0; n < ab->num_planes; n++)
+        ab->read_ptrs[n] = ab->data[n] + ab->start * ab->sstride;
+    *ptr = ab->read_ptrs;
     *samples = ab->num_samples;
 }
 
@@ -135,12 +169,15 @@ void mp_audio_buffer_peek(struct mp_audio_buffer *ab, uint8_t ***ptr,
 void mp_audio_buffer_skip(struct mp_audio_buffer *ab, int samples)
 {
     assert(samples >= 0 && samples <= ab->num_samples);
-    copy_planes(ab, ab->data, 0, ab->data, samples, ab->num_samples - samples);
+    ab->start += samples;
     ab->num_samples -= samples;
+    if (!ab->num_samples)
+        ab->start = 0;
 }
 
 void mp_audio_buffer_clear(struct mp_audio_buffer *ab)
 {
+    ab->start = 0;
     ab->num_samples = 0;
 }
 
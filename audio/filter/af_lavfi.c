@@ -69,6 +69,10 @@ struct priv {
 
     bool eof;
 
+    // Input format of the last successfully created graph. Kept after
+    // destroy_graph(), so that it can be recreated when needed.
+    struct mp_audio graph_config;
+
     struct mp_tags *metadata;
 
     // options
@@ -100,6 +104,9 @@ static bool recreate_graph(struct af_instance *af, struct mp_audio *config)
     }
 
     destroy_graph(af);
+    struct mp_audio graph_config = {0};
+    mp_audio_copy_config(&graph_config, config);
+    p->graph_config = (struct mp_audio){0};
 
     AVFilterGraph *graph = avfilter_graph_alloc();
     if (!graph)
@@ -174,6 +181,7 @@ static bool recreate_graph(struct af_instance *af, struct mp_audio *config)
     p->in = in;
     p->out = out;
     p->graph = graph;
+    p->graph_config = graph_config;
 
     assert(out->nb_inputs == 1);
     assert(in->nb_outputs == 1);
@@ -191,10 +199,30 @@ error:
     return ok;
 }
 
+// libavfilter can't flush a graph, so a graph that has received data must be
+// recreated on seek resets. Do it lazily on the next frame, so that a reinit
+// following the reset doesn't create it twice.
 static void reset(struct af_instance *af)
 {
-    if (!recreate_graph(af, &af->fmt_in))
+    struct priv *p = af->priv;
+    if (p->samples_in || p->eof)
+        destroy_graph(af);
+}
+
+// Create the graph again if reset() destroyed it.
+static bool restore_graph(struct af_instance *af)
+{
+    struct priv *p = af->priv;
+    if (p->graph)
+        return true;
+    if (!mp_audio_config_valid(&p->graph_config))
+        return false;
+    struct mp_audio config = p->graph_config;
+    if (!recreate_graph(af, &config)) {
         MP_FATAL(af, "Can't recreate libavfilter filter after a seek reset.\n");
+        return false;
+    }
+    return true;
 }
 
 static int control(struct af_instance *af, int cmd, void *arg)
@@ -217,8 +245,14 @@ static int control(struct af_instance *af, int cmd, void *arg)
         if (!mp_chmap_is_lavc(&in->channels))
             mp_chmap_reorder_to_lavc(&in->channels); // will always work
 
-        if (!recreate_graph(af, in))
+        // The filter chain reinitializes all filters whenever one of them
+        // changes (and does so several times during format negotiation). A
+        // graph for the same input format can be kept as it is.
+        if (p->graph && !p->eof && mp_audio_config_equals(in, &p->graph_config)) {
+            MP_VERBOSE(af, "lavfi: reusing graph\n");
+        } else if (!recreate_graph(af, in)) {
             return AF_ERROR;
+        }
 
         AVFilterLink *l_out = p->out->inputs[0];
 
@@ -238,7 +272,7 @@ static int control(struct af_instance *af, int cmd, void *arg)
         return mp_audio_config_equals(in, &orig_in) ? AF_OK : AF_FALSE;
     }
     case AF_CONTROL_COMMAND: {
-        if (!p->graph)
+        if (!restore_graph(af))
             break;
         char **args = arg;
         return avfilter_graph_send_command(p->graph, "all",
@@ -277,7 +311,7 @@ static int filter_frame(struct af_instance *af, struct mp_audio *data)
     if (p->eof && data)
         reset(af);
 
-    if (!p->graph)
+    if (!restore_graph(af))
         goto error;
 
     if (!data) {
@@ -314,7 +348,7 @@ static int filter_out(struct af_instance *af)
     struct priv *p = af->priv;
 
     if (!p->graph)
-        goto error;
+        return mp_audio_config_valid(&p->graph_config) ? 0 : -1;
 
     AVFrame *frame = av_frame_alloc();
     if (!frame)
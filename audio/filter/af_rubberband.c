@@ -16,11 +16,14 @@
  */
 
 #include <stdlib.h>
+#include <limits.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include <rubberband/rubberband-c.h>
 
 #include "common/common.h"
+#include "osdep/threads.h"
 #include "af.h"
 
 struct priv {
@@ -32,11 +35,78 @@ struct priv {
     // Estimate how much librubberband has buffered internally.
     // I could not find a way to do this with the librubberband API.
     double rubber_delay;
+
+    // With buffered-frames > 0, processing runs on a separate thread. While
+    // the thread is busy, only it can access the stretcher (and the fields
+    // above). Other code can access it only while hold > 0 and busy is false.
+    pthread_t thread;
+    bool thread_valid;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+
+    // --- the following members are protected by lock
+    struct mp_audio **in_queue; // oldest first
+    int num_in_queue;
+    bool in_eof;                // EOF not yet taken by the thread
+    bool eof_queued;            // EOF was queued (until reset or new data)
+    bool draining;              // EOF taken, remaining output not retrieved
+    bool input_left;            // pending has samples not passed to rubberband
+    struct mp_audio **out_queue;
+    int num_out_queue;
+    double thread_delay;        // rubber_delay + pending samples
+    bool busy;
+    bool failed;
+    bool terminate;
+    int hold;
+
     // command line options
     int opt_transients, opt_detector, opt_phase, opt_window,
         opt_smoothing, opt_formant, opt_pitch, opt_channels;
+    int opt_buffered;
 };
 
+// Wait until the processing thread is idle, and keep it from accessing the
+// stretcher until release_rubber() is called.
+static void hold_rubber(struct af_instance *af)
+{
+    struct priv *p = af->priv;
+    if (!p->thread_valid)
+        return;
+    pthread_mutex_lock(&p->lock);
+    p->hold++;
+    while (p->busy)
+        pthread_cond_wait(&p->wakeup, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void release_rubber(struct af_instance *af)
+{
+    struct priv *p = af->priv;
+    if (!p->thread_valid)
+        return;
+    pthread_mutex_lock(&p->lock);
+    p->hold--;
+    pthread_cond_broadcast(&p->wakeup);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Drop all frames queued for or by the processing thread.
+static void flush_queues(struct af_instance *af)
+{
+    struct priv *p = af->priv;
+    pthread_mutex_lock(&p->lock);
+    for (int n = 0; n < p->num_in_queue; n++)
+        talloc_free(p->in_queue[n]);
+    p->num_in_queue = 0;
+    for (int n = 0; n < p->num_out_queue; n++)
+        talloc_free(p->out_queue[n]);
+    p->num_out_queue = 0;
+    p->in_eof = p->eof_queued = p->draining = p->input_left = false;
+    p->thread_delay = 0;
+    p->failed = false;
+    pthread_mutex_unlock(&p->lock);
+}
+
 static void update_speed(struct af_instance *af, double new_speed)
 {
     struct priv *p = af->priv;
@@ -70,6 +140,7 @@ static int control(struct af_instance *af, int cmd, void *arg)
         in->format = AF_FORMAT_FLOATP;
         mp_audio_copy_config(out, in);
 
+        hold_rubber(af);
         if (p->rubber)
             rubberband_delete(p->rubber);
 
@@ -80,26 +151,36 @@ static int control(struct af_instance *af, int cmd, void *arg)
 
         p->rubber = rubberband_new(in->rate, in->channels.num, opts, 1.0, 1.0);
         if (!p->rubber) {
+            release_rubber(af);
             MP_FATAL(af, "librubberband initialization failed.\n");
             return AF_ERROR;
         }
 
         update_speed(af, p->speed);
         update_pitch(af, p->pitch);
+        release_rubber(af);
         control(af, AF_CONTROL_RESET, NULL);
 
         return mp_audio_config_equals(in, &orig_in) ? AF_OK : AF_FALSE;
     }
     case AF_CONTROL_SET_PLAYBACK_SPEED: {
-        update_speed(af, *(double *)arg);
+        hold_rubber(af);
+        if (p->rubber)
+            update_speed(af, *(double *)arg);
+        release_rubber(af);
         return AF_OK;
     }
     case AF_CONTROL_RESET:
+        hold_rubber(af);
+        if (p->thread_valid)
+            flush_queues(af);
         if (p->rubber)
             rubberband_reset(p->rubber);
         talloc_free(p->pending);
         p->pending = NULL;
+        p->needs_reset = false;
         p->rubber_delay = 0;
+        release_rubber(af);
         return AF_OK;
     case AF_CONTROL_COMMAND: {
         char **args = arg;
@@ -109,32 +190,27 @@ static int control(struct af_instance *af, int cmd, void *arg)
             pitch = strtod(args[1], &endptr);
             if (*endptr)
                 return CONTROL_ERROR;
-            return update_pitch(af, pitch) ? CONTROL_OK : CONTROL_ERROR;
         } else if (!strcmp(args[0], "multiply-pitch")) {
             double mult = strtod(args[1], &endptr);
             if (*endptr || mult <= 0)
                 return CONTROL_ERROR;
             pitch *= mult;
-            return update_pitch(af, pitch) ? CONTROL_OK : CONTROL_ERROR;
         } else {
             return CONTROL_ERROR;
         }
+        hold_rubber(af);
+        bool ok = update_pitch(af, pitch);
+        release_rubber(af);
+        return ok ? CONTROL_OK : CONTROL_ERROR;
     }
     }
     return AF_UNKNOWN;
 }
 
-static int filter_frame(struct af_instance *af, struct mp_audio *data)
-{
-    struct priv *p = af->priv;
-
-    talloc_free(p->pending);
-    p->pending = data;
-
-    return 0;
-}
-
-static int filter_out(struct af_instance *af)
+// Feed p->pending to rubberband until output is available or more input is
+// needed, and retrieve the output. Returns -1 on errors, 0 if *out_frame was
+// not set, and 1 if it was.
+static int process(struct af_instance *af, struct mp_audio **out_frame)
 {
     struct priv *p = af->priv;
 
@@ -171,33 +247,232 @@ static int filter_out(struct af_instance *af)
     }
 
     int out_samples = rubberband_available(p->rubber);
-    if (out_samples > 0) {
-        struct mp_audio *out =
-            mp_audio_pool_get(af->out_pool, af->data, out_samples);
-        if (!out)
-            return -1;
-        if (p->pending)
-            mp_audio_copy_config(out, p->pending);
-
-        float **out_data = (void *)&out->planes;
-        out->samples = rubberband_retrieve(p->rubber, out_data, out->samples);
-        p->rubber_delay -= out->samples * p->speed;
-
-        af_add_output_frame(af, out);
-    }
+    if (out_samples <= 0)
+        return 0;
 
-    int delay_samples = p->rubber_delay;
+    struct mp_audio *out =
+        mp_audio_pool_get(af->out_pool, af->data, out_samples);
+    if (!out)
+        return -1;
     if (p->pending)
-        delay_samples += p->pending->samples;
-    af->delay = delay_samples / (af->data->rate * p->speed);
+        mp_audio_copy_config(out, p->pending);
+
+    float **out_data = (void *)&out->planes;
+    out->samples = rubberband_retrieve(p->rubber, out_data, out->samples);
+    p->rubber_delay -= out->samples * p->speed;
+
+    *out_frame = out;
+    return 1;
+}
+
+// Delay of the data buffered by rubberband, in input samples.
+static double get_rubber_delay(struct af_instance *af)
+{
+    struct priv *p = af->priv;
+    double delay = p->rubber_delay;
+    if (p->pending)
+        delay += p->pending->samples;
+    return delay;
+}
+
+static void *process_thread(void *ptr)
+{
+    struct af_instance *af = ptr;
+    struct priv *p = af->priv;
+
+    mpthread_set_name("rubberband");
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->terminate) {
+        if (p->hold || p->failed || p->num_out_queue >= p->opt_buffered ||
+            !(p->input_left || p->num_in_queue || p->in_eof || p->draining))
+        {
+            pthread_cond_wait(&p->wakeup, &p->lock);
+            continue;
+        }
+
+        if (!p->input_left) {
+            talloc_free(p->pending);
+            if (p->num_in_queue) {
+                p->pending = p->in_queue[0];
+                MP_TARRAY_REMOVE_AT(p->in_queue, p->num_in_queue, 0);
+            } else if (p->in_eof) {
+                p->pending = NULL;
+                p->in_eof = false;
+                p->draining = true;
+            }
+        }
+        p->busy = true;
+        pthread_cond_broadcast(&p->wakeup);
+        pthread_mutex_unlock(&p->lock);
+
+        struct mp_audio *out = NULL;
+        int r = process(af, &out);
+        double delay = get_rubber_delay(af);
+
+        pthread_mutex_lock(&p->lock);
+        if (out)
+            MP_TARRAY_APPEND(p, p->out_queue, p->num_out_queue, out);
+        p->input_left = p->pending && p->pending->samples > 0;
+        // Stop draining once rubberband has no more output after EOF.
+        if (r < 1)
+            p->draining = false;
+        p->failed |= r < 0;
+        p->thread_delay = delay;
+        p->busy = false;
+        pthread_cond_broadcast(&p->wakeup);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static bool locked_is_idle(struct priv *p)
+{
+    return !p->busy && !p->num_in_queue && !p->in_eof && !p->draining &&
+           !p->input_left;
+}
+
+static void locked_read_queue(struct af_instance *af, int max)
+{
+    struct priv *p = af->priv;
+    int num = MPMIN(max, p->num_out_queue);
+    for (int n = 0; n < num; n++)
+        af_add_output_frame(af, p->out_queue[n]);
+    for (int n = num; n < p->num_out_queue; n++)
+        p->out_queue[n - num] = p->out_queue[n];
+    p->num_out_queue -= num;
+    if (num)
+        pthread_cond_broadcast(&p->wakeup);
+}
+
+static void locked_update_delay(struct af_instance *af)
+{
+    struct priv *p = af->priv;
+    double delay = p->thread_delay;
+    for (int n = 0; n < p->num_in_queue; n++)
+        delay += p->in_queue[n]->samples;
+    for (int n = 0; n < p->num_out_queue; n++)
+        delay += p->out_queue[n]->samples * p->speed;
+    af->delay = delay / (af->data->rate * p->speed);
+}
+
+static int filter_frame_threaded(struct af_instance *af, struct mp_audio *data)
+{
+    struct priv *p = af->priv;
+    int ret = 0;
+
+    pthread_mutex_lock(&p->lock);
+
+    if (data && p->eof_queued) {
+        // Let the thread drain the old data first, so that new data is not
+        // sent to rubberband before the EOF.
+        while (!locked_is_idle(p) && !p->failed) {
+            locked_read_queue(af, INT_MAX);
+            pthread_cond_wait(&p->wakeup, &p->lock);
+        }
+        locked_read_queue(af, INT_MAX);
+        p->eof_queued = false;
+    }
+
+    if (data) {
+        // Keep returning output while waiting, so the thread can't get stuck
+        // on a full output queue.
+        while (p->num_in_queue >= p->opt_buffered && !p->failed) {
+            locked_read_queue(af, INT_MAX);
+            pthread_cond_wait(&p->wakeup, &p->lock);
+        }
+        if (p->failed) {
+            talloc_free(data);
+        } else {
+            MP_TARRAY_APPEND(p, p->in_queue, p->num_in_queue, data);
+        }
+    } else if (!p->eof_queued) {
+        p->in_eof = p->eof_queued = true;
+    }
+    if (p->failed)
+        ret = -1;
+
+    locked_update_delay(af);
+    pthread_cond_broadcast(&p->wakeup);
+    pthread_mutex_unlock(&p->lock);
+    return ret;
+}
+
+// Return 1 output frame, or none if the filter probably needs new input.
+static int filter_out_threaded(struct af_instance *af)
+{
+    struct priv *p = af->priv;
+    int ret = 0;
+
+    pthread_mutex_lock(&p->lock);
+    while (1) {
+        if (p->num_out_queue) {
+            locked_read_queue(af, 1);
+            break;
+        }
+        if (p->failed) {
+            ret = -1;
+            break;
+        }
+        if (locked_is_idle(p))
+            break;
+        // Let the caller send more input while the thread is busy, unless
+        // we're draining. The filter chain treats a filter without output
+        // after EOF as fully drained.
+        if (!p->eof_queued && p->num_in_queue < p->opt_buffered)
+            break;
+        pthread_cond_wait(&p->wakeup, &p->lock);
+    }
+    locked_update_delay(af);
+    pthread_mutex_unlock(&p->lock);
+    return ret;
+}
+
+static int filter_frame(struct af_instance *af, struct mp_audio *data)
+{
+    struct priv *p = af->priv;
+
+    if (p->thread_valid)
+        return filter_frame_threaded(af, data);
+
+    talloc_free(p->pending);
+    p->pending = data;
 
     return 0;
 }
 
+static int filter_out(struct af_instance *af)
+{
+    struct priv *p = af->priv;
+
+    if (p->thread_valid)
+        return filter_out_threaded(af);
+
+    struct mp_audio *out = NULL;
+    int r = process(af, &out);
+    af_add_output_frame(af, out);
+
+    af->delay = get_rubber_delay(af) / (af->data->rate * p->speed);
+
+    return r < 0 ? -1 : 0;
+}
+
 static void uninit(struct af_instance *af)
 {
     struct priv *p = af->priv;
 
+    if (p->thread_valid) {
+        pthread_mutex_lock(&p->lock);
+        p->terminate = true;
+        pthread_cond_broadcast(&p->wakeup);
+        pthread_mutex_unlock(&p->lock);
+        pthread_join(p->thread, NULL);
+        p->thread_valid = false;
+        flush_queues(af);
+    }
+    pthread_cond_destroy(&p->wakeup);
+    pthread_mutex_destroy(&p->lock);
+
     if (p->rubber)
         rubberband_delete(p->rubber);
     talloc_free(p->pending);
@@ -205,10 +480,22 @@ static void uninit(struct af_instance *af)
 
 static int af_open(struct af_instance *af)
 {
+    struct priv *p = af->priv;
+
     af->control = control;
     af->filter_frame = filter_frame;
     af->filter_out = filter_out;
     af->uninit = uninit;
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wakeup, NULL);
+
+    if (p->opt_buffered > 0) {
+        if (pthread_create(&p->thread, NULL, process_thread, af))
+            return AF_ERROR;
+        p->thread_valid = true;
+    }
+
     return AF_OK;
 }
 
@@ -256,6 +543,7 @@ const struct af_info af_info_rubberband = {
                    ({"apart", RubberBandOptionChannelsApart},
                     {"together", RubberBandOptionChannelsTogether})),
         OPT_DOUBLE("pitch-scale", pitch, M_OPT_RANGE, .min = 0.01, .max = 100),
+        OPT_INTRANGE("buffered-frames", opt_buffered, 0, 0, 100),
         {0}
     },
 };
@@ -117,6 +117,23 @@ static int fill_queue(struct af_instance *af, struct mp_audio *data, int offset)
 
 #define UNROLL_PADDING (4 * 4)
 
+// Dot product of a and b. This keeps several independent partial sums: float
+// addition is not associative, so the compiler can't vectorize or pipeline a
+// reduction into a single accumulator by itself.
+static float dot_float(const float *a, const float *b, int n)
+{
+    float sum[8] = {0};
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        for (int j = 0; j < 8; j++)
+            sum[j] += a[i + j] * b[i + j];
+    }
+    for (; i < n; i++)
+        sum[0] += a[i] * b[i];
+    return ((sum[0] + sum[1]) + (sum[2] + sum[3])) +
+           ((sum[4] + sum[5]) + (sum[6] + sum[7]));
+}
+
 static int best_overlap_offset_float(af_scaletempo_t *s)
 {
     float best_corr = INT_MIN;
@@ -129,13 +146,10 @@ static int best_overlap_offset_float(af_scaletempo_t *s)
     for (int i = s->num_channels; i < s->samples_overlap; i++)
         *ppc++ = *pw++ **po++;
 
+    int num_samples = s->samples_overlap - s->num_channels;
     float *search_start = (float *)s->buf_queue + s->num_channels;
     for (int off = 0; off < s->frames_search; off++) {
-        float corr = 0;
-        float *ps = search_start;
-        ppc = s->buf_pre_corr;
-        for (int i = s->num_channels; i < s->samples_overlap; i++)
-            corr += *ppc++ **ps++;
+        float corr = dot_float(s->buf_pre_corr, search_start, num_samples);
         if (corr > best_corr) {
             best_corr = corr;
             best_off  = off;
@@ -155,6 +155,7 @@ static struct ao *ao_alloc(bool probing, struct mpv_global *global,
         .wakeup_ctx = wakeup_ctx,
         .log = mp_log_new(ao, log, name),
         .def_buffer = opts->audio_buffer,
+        .adaptive_buffer = opts->audio_buffer_adaptive,
         .client_name = talloc_strdup(ao, opts->audio_client_name),
     };
     ao->priv = m_config_group_from_desc(ao, ao->log, global, &desc, name);
@@ -236,6 +237,7 @@ static struct ao *ao_init(bool probing, struct mpv_global *global,
     int align = af_format_sample_alignment(ao->format);
     ao->buffer = (ao->buffer + align - 1) / align * align;
     MP_VERBOSE(ao, "using soft-buffer of %d samples.\n", ao->buffer);
+    atomic_store(&ao->buffer_target, ao->buffer);
 
     if (ao->api->init(ao) < 0)
         goto fail;
@@ -371,6 +373,13 @@ double ao_get_delay(struct ao *ao)
     return ao->api->get_delay(ao);
 }
 
+// Return the amount of audio (in seconds) the AO currently tries to keep
+// buffered. This can change at runtime with --audio-buffer-adaptive.
+double ao_get_buffer_target(struct ao *ao)
+{
+    return atomic_load(&ao->buffer_target) / (double)ao->samplerate;
+}
+
 // Return free size of the internal audio buffer. This controls how much audio
 // the core should decode and try to queue with ao_play().
 int ao_get_space(struct ao *ao)
@@ -59,6 +59,7 @@ struct ao_alsa_opts {
     int resample;
     int ni;
     int ignore_chmap;
+    int mmap;
 };
 
 #define OPT_BASE_STRUCT struct ao_alsa_opts
@@ -70,6 +71,7 @@ static const struct m_sub_options ao_alsa_conf = {
         OPT_INTRANGE("alsa-mixer-index", mixer_index, 0, 0, 99),
         OPT_FLAG("alsa-non-interleaved", ni, 0),
         OPT_FLAG("alsa-ignore-chmap", ignore_chmap, 0),
+        OPT_FLAG("alsa-mmap", mmap, 0),
         {0}
     },
     .defaults = &(const struct ao_alsa_opts) {
@@ -91,6 +93,7 @@ struct priv {
     double delay_before_pause;
     snd_pcm_uframes_t buffersize;
     snd_pcm_uframes_t outburst;
+    bool mmap;          // mmap access, write with snd_pcm_mmap_write*()
 
     snd_output_t *output;
 
@@ -691,14 +694,35 @@ static int init_device(struct ao *ao, int mode)
     }
     dump_hw_params(ao, MSGL_DEBUG, "HW params after rate:\n", alsa_hwparams);
 
-    snd_pcm_access_t access = af_fmt_is_planar(ao->format)
-                                    ? SND_PCM_ACCESS_RW_NONINTERLEAVED
-                                    : SND_PCM_ACCESS_RW_INTERLEAVED;
-    err = snd_pcm_hw_params_set_access(p->alsa, alsa_hwparams, access);
-    if (err < 0 && af_fmt_is_planar(ao->format)) {
-        ao->format = af_fmt_from_planar(ao->format);
-        access = SND_PCM_ACCESS_RW_INTERLEAVED;
+    // With mmap access, samples are copied straight into the device ring
+    // buffer, instead of going through the kernel (or plugin) write path.
+    p->mmap = false;
+    err = -1;
+    if (p->opts->mmap) {
+        snd_pcm_access_t access = af_fmt_is_planar(ao->format)
+                                        ? SND_PCM_ACCESS_MMAP_NONINTERLEAVED
+                                        : SND_PCM_ACCESS_MMAP_INTERLEAVED;
         err = snd_pcm_hw_params_set_access(p->alsa, alsa_hwparams, access);
+        if (err < 0 && af_fmt_is_planar(ao->format)) {
+            access = SND_PCM_ACCESS_MMAP_INTERLEAVED;
+            err = snd_pcm_hw_params_set_access(p->alsa, alsa_hwparams, access);
+            if (err >= 0)
+                ao->format = af_fmt_from_planar(ao->format);
+        }
+        p->mmap = err >= 0;
+        if (!p->mmap)
+            MP_VERBOSE(ao, "mmap access not supported by the device.\n");
+    }
+    if (err < 0) {
+        snd_pcm_access_t access = af_fmt_is_planar(ao->format)
+                                        ? SND_PCM_ACCESS_RW_NONINTERLEAVED
+                                        : SND_PCM_ACCESS_RW_INTERLEAVED;
+        err = snd_pcm_hw_params_set_access(p->alsa, alsa_hwparams, access);
+        if (err < 0 && af_fmt_is_planar(ao->format)) {
+            ao->format = af_fmt_from_planar(ao->format);
+            access = SND_PCM_ACCESS_RW_INTERLEAVED;
+            err = snd_pcm_hw_params_set_access(p->alsa, alsa_hwparams, access);
+        }
     }
     CHECK_ALSA_ERROR("Unable to set access type");
     dump_hw_params(ao, MSGL_DEBUG, "HW params after access:\n", alsa_hwparams);
@@ -1096,7 +1120,11 @@ static int play(struct ao *ao, void **data, int samples, int flags)
     ao_convert_inplace(&p->convert, data, samples);
 
     do {
-        if (af_fmt_is_planar(ao->format)) {
+        if (p->mmap && af_fmt_is_planar(ao->format)) {
+            res = snd_pcm_mmap_writen(p->alsa, data, samples);
+        } else if (p->mmap) {
+            res = snd_pcm_mmap_writei(p->alsa, data[0], samples);
+        } else if (af_fmt_is_planar(ao->format)) {
             res = snd_pcm_writen(p->alsa, data, samples);
         } else {
             res = snd_pcm_writei(p->alsa, data[0], samples);
@@ -255,23 +255,32 @@ static void write_packet(struct ao *ao, AVPacket *packet)
     }
 }
 
-static void encode_audio_and_write(struct ao *ao, AVFrame *frame)
+// Returns false if encoding was aborted, and ac->codec must not be used.
+static bool encode_audio_and_write(struct ao *ao, AVFrame *frame)
 {
     // TODO: Can we unify this with the equivalent video code path?
     struct priv *ac = ao->priv;
     AVPacket packet = {0};
 
+    encode_lavc_begin_encode(ao->encode_lavc_ctx);
     int status = avcodec_send_frame(ac->codec, frame);
+    if (!encode_lavc_end_encode(ao->encode_lavc_ctx))
+        return false;
     if (status < 0) {
         MP_ERR(ao, "error encoding at %d %d/%d\n",
                frame ? (int) frame->pts : -1,
                ac->codec->time_base.num,
                ac->codec->time_base.den);
-        return;
+        return true;
     }
     for (;;) {
         av_init_packet(&packet);
+        encode_lavc_begin_encode(ao->encode_lavc_ctx);
         status = avcodec_receive_packet(ac->codec, &packet);
+        if (!encode_lavc_end_encode(ao->encode_lavc_ctx)) {
+            av_packet_unref(&packet);
+            return false;
+        }
         if (status == AVERROR(EAGAIN)) { // No more packets for now.
             if (frame == NULL) {
                 MP_ERR(ao, "sent flush frame, got EAGAIN");
@@ -299,6 +308,7 @@ static void encode_audio_and_write(struct ao *ao, AVFrame *frame)
         write_packet(ao, &packet);
         av_packet_unref(&packet);
     }
+    return true;
 }
 
 // must get exactly ac->aframesize amount of data
@@ -462,7 +472,7 @@ static int play(struct ao *ao, void **data, int samples, int flags)
     // Shift pts by the pts offset first.
     outpts += encode_lavc_getoffset(ectx, ac->codec);
 
-    while (samples - bufpos >= ac->aframesize) {
+    while (samples - bufpos >= ac->aframesize && !ectx->finished) {
         void *start[MP_NUM_CHANNELS] = {0};
         for (int n = 0; n < num_planes; n++)
             start[n] = (char *)data[n] + bufpos * ao->sstride;
@@ -116,17 +116,24 @@ static bool thread_feed(struct ao *ao)
     MP_TRACE(ao, "Frame to fill: %"PRIu32". Padding: %"PRIu32"\n",
              frame_count, padding);
 
-    double delay_us;
-    hr = get_device_delay(state, &delay_us);
-    EXIT_ON_ERROR(hr);
-    // add the buffer delay
-    delay_us += frame_count * 1e6 / state->format.Format.nSamplesPerSec;
-
     BYTE *pData;
     hr = IAudioRenderClient_GetBuffer(state->pRenderClient,
                                       frame_count, &pData);
     EXIT_ON_ERROR(hr);
 
+    // Query the delay as late as possible; with small exclusive mode buffers,
+    // the GetBuffer call can take a noticeable part of the buffer duration.
+    double delay_us;
+    hr = get_device_delay(state, &delay_us);
+    if (FAILED(hr)) {
+        IAudioRenderClient_ReleaseBuffer(state->pRenderClient, frame_count,
+                                         AUDCLNT_BUFFERFLAGS_SILENT);
+        goto exit_label;
+    }
+    // add the buffer delay
+    delay_us += frame_count * 1e6 / state->format.Format.nSamplesPerSec;
+
+    // Writes directly into the device buffer if no conversion is needed.
     BYTE *data[1] = {pData};
 
     ao_read_data_converted(ao, &state->convert_format,
@@ -502,4 +509,10 @@ const struct ao_driver audio_out_wasapi = {
     .hotplug_init   = hotplug_init,
     .hotplug_uninit = hotplug_uninit,
     .priv_size      = sizeof(wasapi_state),
+    .options        = (const struct m_option[]) {
+        OPT_CHOICE_OR_INT("exclusive-buffer", opt_exclusive_buffer, 0,
+                          1, 2000000, ({"default", 0}, {"min", -1})),
+        {0}
+    },
+    .options_prefix = "wasapi",
 };
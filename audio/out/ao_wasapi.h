@@ -87,6 +87,7 @@ typedef struct wasapi_state {
 
     // ao options
     int opt_exclusive;
+    int opt_exclusive_buffer; // in us; 0: device default period, -1: minimum
 
     // format info
     WAVEFORMATEXTENSIBLE format;
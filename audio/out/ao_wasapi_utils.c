@@ -25,6 +25,7 @@
 #include <ksmedia.h>
 #include <avrt.h>
 
+#include "common/common.h"
 #include "audio/format.h"
 #include "osdep/timer.h"
 #include "osdep/io.h"
@@ -583,16 +584,22 @@ static HRESULT fix_format(struct ao *ao, bool align_hack)
     struct wasapi_state *state = ao->priv;
 
     MP_DBG(state, "IAudioClient::GetDevicePeriod\n");
-    REFERENCE_TIME devicePeriod;
+    REFERENCE_TIME devicePeriod, minPeriod;
     HRESULT hr = IAudioClient_GetDevicePeriod(state->pAudioClient,&devicePeriod,
-                                              NULL);
-    MP_VERBOSE(state, "Device period: %.2g ms\n",
-               (double) devicePeriod / 10000.0 );
+                                              &minPeriod);
+    MP_VERBOSE(state, "Device period: %.2g ms (minimum: %.2g ms)\n",
+               (double) devicePeriod / 10000.0, (double) minPeriod / 10000.0);
 
     REFERENCE_TIME bufferDuration = devicePeriod;
     if (state->share_mode == AUDCLNT_SHAREMODE_SHARED) {
         // for shared mode, use integer multiple of device period close to 50ms
         bufferDuration = devicePeriod * ceil(50.0 * 10000.0 / devicePeriod);
+    } else if (state->opt_exclusive_buffer < 0) {
+        bufferDuration = minPeriod;
+    } else if (state->opt_exclusive_buffer > 0) {
+        // in 100 ns units; the device can't go below its minimum period
+        bufferDuration = MPMAX(minPeriod,
+                               (REFERENCE_TIME)state->opt_exclusive_buffer * 10);
     }
 
     // handle unsupported buffer size if AUDCLNT_E_BUFFER_SIZE_NOT_ALIGNED was
@@ -75,6 +75,10 @@ struct ao {
 
     int buffer;
     double def_buffer;
+    bool adaptive_buffer;
+    // Amount of audio (in samples) the push API currently tries to keep
+    // buffered. Equals buffer, unless adaptive_buffer is set.
+    atomic_int buffer_target;
     void *api_priv;
 };
 
@@ -15,6 +15,7 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include <stddef.h>
 #include <pthread.h>
 #include <inttypes.h>
@@ -30,6 +31,7 @@
 
 #include "common/msg.h"
 #include "common/common.h"
+#include "common/stats.h"
 
 #include "input/input.h"
 
@@ -37,17 +39,31 @@
 #include "osdep/timer.h"
 #include "osdep/atomic.h"
 
-#include "audio/audio_buffer.h"
+// --audio-buffer-adaptive: lowest soft buffer target (in seconds), and how long
+// playback must run without underruns before the target is lowered again.
+#define ADAPT_MIN_BUFFER 0.02
+#define ADAPT_STABLE_TIME 5.0
 
 struct ao_push_state {
     pthread_t thread;
     pthread_mutex_t lock;
     pthread_cond_t wakeup;
+    struct stats_ctx *stats;
+
+    // Sample ring buffer. play() is the only writer, and the playthread the
+    // only reader, so the data itself is accessed without holding the lock.
+    // Each side advances only its own position. (Except reset(), which runs on
+    // the writer's thread, and takes the lock to exclude the reader.) The
+    // positions count samples, and are never wrapped.
+    uint8_t *ring[MP_NUM_CHANNELS];
+    int ring_size; // in samples, a multiple of ao->period_size
+    int num_planes;
+    int sstride;
+    atomic_ullong read_pos;
+    atomic_ullong write_pos;
 
     // --- protected by lock
 
-    struct mp_audio_buffer *buffer;
-
     uint8_t *silence[MP_NUM_CHANNELS];
     int silence_samples;
 
@@ -61,9 +77,32 @@ struct ao_push_state {
     bool final_chunk;
     double expected_end_time;
 
+    // Current soft buffer target in samples (see adapt_buffer_target()).
+    int target;
+    int min_target;
+    double last_adapt_time;
+
     int wakeup_pipe[2];
 };
 
+static int ring_buffered(struct ao_push_state *p)
+{
+    return atomic_load(&p->write_pos) - atomic_load(&p->read_pos);
+}
+
+// Copy samples to the ring at the given position, wrapping around its end.
+static void ring_copy(struct ao_push_state *p, uint64_t pos, uint8_t **data,
+                      int samples)
+{
+    int start = pos % p->ring_size;
+    int part = MPMIN(samples, p->ring_size - start);
+    for (int n = 0; n < p->num_planes; n++) {
+        memcpy(p->ring[n] + start * p->sstride, data[n], part * p->sstride);
+        memcpy(p->ring[n], data[n] + part * p->sstride,
+               (samples - part) * p->sstride);
+    }
+}
+
 // lock must be held
 static void wakeup_playthread(struct ao *ao)
 {
@@ -92,7 +131,7 @@ static double unlocked_get_delay(struct ao *ao)
     double driver_delay = 0;
     if (ao->driver->get_delay)
         driver_delay = ao->driver->get_delay(ao);
-    return driver_delay + mp_audio_buffer_seconds(p->buffer);
+    return driver_delay + ring_buffered(p) / (double)ao->samplerate;
 }
 
 static double get_delay(struct ao *ao)
@@ -110,7 +149,7 @@ static void reset(struct ao *ao)
     pthread_mutex_lock(&p->lock);
     if (ao->driver->reset)
         ao->driver->reset(ao);
-    mp_audio_buffer_clear(p->buffer);
+    atomic_store(&p->read_pos, atomic_load(&p->write_pos));
     p->paused = false;
     if (p->still_playing)
         wakeup_playthread(ao);
@@ -159,7 +198,7 @@ static void drain(struct ao *ao)
     // can't be trusted to do this right, and we're hard-blocking here, apply
     // an upper bound timeout.
     struct timespec until = mp_rel_time_to_timespec(maxbuffer);
-    while (p->still_playing && mp_audio_buffer_samples(p->buffer) > 0) {
+    while (p->still_playing && ring_buffered(p) > 0) {
         if (pthread_cond_timedwait(&p->wakeup, &p->lock, &until)) {
             MP_WARN(ao, "Draining is taking too long, aborting.\n");
             goto done;
@@ -182,17 +221,17 @@ done:
 static int unlocked_get_space(struct ao *ao)
 {
     struct ao_push_state *p = ao->api_priv;
-    int space = mp_audio_buffer_get_write_available(p->buffer);
+    int space = p->ring_size - ring_buffered(p);
     if (ao->driver->get_space) {
         int align = af_format_sample_alignment(ao->format);
         // The following code attempts to keep the total buffered audio to
         // ao->buffer in order to improve latency.
         int device_space = ao->driver->get_space(ao);
         int device_buffered = ao->device_buffer - device_space;
-        int soft_buffered = mp_audio_buffer_samples(p->buffer);
+        int soft_buffered = ring_buffered(p);
         // The extra margin helps avoiding too many wakeups if the AO is fully
         // byte based and doesn't do proper chunked processing.
-        int min_buffer = ao->buffer + 64;
+        int min_buffer = p->target + 64;
         int missing = min_buffer - device_buffered - soft_buffered;
         missing = (missing + align - 1) / align * align;
         // But always keep the device's buffer filled as much as we can.
@@ -226,10 +265,13 @@ static int play(struct ao *ao, void **data, int samples, int flags)
 {
     struct ao_push_state *p = ao->api_priv;
 
-    pthread_mutex_lock(&p->lock);
-
-    int write_samples = mp_audio_buffer_get_write_available(p->buffer);
+    // Write the data without holding the lock, so the playthread never has to
+    // wait for the copy.
+    uint64_t write_pos = atomic_load(&p->write_pos);
+    int write_samples = p->ring_size - ring_buffered(p);
     write_samples = MPMIN(write_samples, samples);
+    ring_copy(p, write_pos, (uint8_t **)data, write_samples);
+    atomic_store(&p->write_pos, write_pos + write_samples);
 
     MP_TRACE(ao, "samples=%d flags=%d r=%d\n", samples, flags, write_samples);
 
@@ -237,7 +279,7 @@ static int play(struct ao *ao, void **data, int samples, int flags)
         flags = flags & ~AOPLAY_FINAL_CHUNK;
     bool is_final = flags & AOPLAY_FINAL_CHUNK;
 
-    mp_audio_buffer_append(p->buffer, data, samples);
+    pthread_mutex_lock(&p->lock);
 
     bool got_data = write_samples > 0 || p->paused || p->final_chunk != is_final;
 
@@ -277,8 +319,34 @@ static bool realloc_silence(struct ao *ao, int samples)
     return true;
 }
 
+// With --audio-buffer-adaptive, start with a small soft buffer, double it on
+// every underrun, and shrink it again slowly while playback is stable.
 // called locked
-static void ao_play_data(struct ao *ao)
+static void adapt_buffer_target(struct ao *ao, bool underrun)
+{
+    struct ao_push_state *p = ao->api_priv;
+    if (!ao->adaptive_buffer)
+        return;
+    double now = mp_time_sec();
+    int target = p->target;
+    if (underrun) {
+        target = MPMIN(target * 2, p->ring_size);
+        p->last_adapt_time = now;
+    } else if (now - p->last_adapt_time >= ADAPT_STABLE_TIME) {
+        target = MPMAX(target - target / 8, p->min_target);
+        p->last_adapt_time = now;
+    }
+    if (target != p->target) {
+        MP_VERBOSE(ao, "soft-buffer target: %d samples.\n", target);
+        p->target = target;
+        atomic_store(&ao->buffer_target, target);
+    }
+}
+
+// called locked
+// Returns true if only part of the buffered data could be written because the
+// ring wrapped around, and this should be called again immediately.
+static bool ao_play_data(struct ao *ao)
 {
     struct ao_push_state *p = ao->api_priv;
     int space = ao->driver->get_space(ao);
@@ -286,15 +354,29 @@ static void ao_play_data(struct ao *ao)
     space = MPMAX(space, 0);
     if (space % ao->period_size)
         MP_ERR(ao, "Audio device reports unaligned available buffer size.\n");
+    uint8_t *ring_planes[MP_NUM_CHANNELS];
     uint8_t **planes;
     int samples;
+    int max;
+    uint64_t read_pos = atomic_load(&p->read_pos);
     if (play_silence) {
         planes = p->silence;
-        samples = realloc_silence(ao, space) ? space : 0;
+        samples = max = realloc_silence(ao, space) ? space : 0;
     } else {
-        mp_audio_buffer_peek(p->buffer, &planes, &samples);
+        // Only the part up to the end of the ring is contiguous.
+        int start = read_pos % p->ring_size;
+        for (int n = 0; n < p->num_planes; n++)
+            ring_planes[n] = p->ring[n] + start * p->sstride;
+        planes = ring_planes;
+        max = ring_buffered(p);
+        samples = MPMIN(max, p->ring_size - start);
     }
-    int max = samples;
+    bool underrun =
+        !play_silence && p->still_playing && !max && space && !p->final_chunk;
+    if (underrun)
+        stats_event(p->stats, "underrun");
+    if (!play_silence && p->still_playing)
+        adapt_buffer_target(ao, underrun);
     if (samples > space)
         samples = space;
     int flags = 0;
@@ -304,10 +386,12 @@ static void ao_play_data(struct ao *ao)
         samples = samples / ao->period_size * ao->period_size;
     }
     MP_STATS(ao, "start ao fill");
+    stats_time_start(p->stats, "play");
     ao_post_process_data(ao, (void **)planes, samples);
     int r = 0;
     if (samples)
         r = ao->driver->play(ao, (void **)planes, samples, flags);
+    stats_time_end(p->stats, "play");
     MP_STATS(ao, "end ao fill");
     if (r > samples) {
         MP_ERR(ao, "Audio device returned nonsense value.\n");
@@ -327,7 +411,7 @@ static void ao_play_data(struct ao *ao)
         r = max;
     }
     if (!play_silence)
-        mp_audio_buffer_skip(p->buffer, r);
+        atomic_store(&p->read_pos, read_pos + r);
     if (r > 0)
         p->expected_end_time = 0;
     // Nothing written, but more input data than space - this must mean the
@@ -348,6 +432,7 @@ static void ao_play_data(struct ao *ao)
         ao->wakeup_cb(ao->wakeup_ctx); // request more data
     MP_TRACE(ao, "in=%d flags=%d space=%d r=%d wa/pl=%d/%d needed=%d more=%d\n",
              max, flags, space, r, p->wait_on_ao, p->still_playing, needed, more);
+    return !play_silence && r > 0 && r == samples && r < max && r < space;
 }
 
 static void *playthread(void *arg)
@@ -355,11 +440,13 @@ static void *playthread(void *arg)
     struct ao *ao = arg;
     struct ao_push_state *p = ao->api_priv;
     mpthread_set_name("ao");
+    mpthread_apply_opts(ao->global, ao->log, "ao");
     pthread_mutex_lock(&p->lock);
     while (!p->terminate) {
         bool playing = !p->paused || ao->stream_silence;
-        if (playing)
-            ao_play_data(ao);
+        if (playing) {
+            while (ao_play_data(ao)) {}
+        }
 
         if (!p->need_wakeup) {
             MP_STATS(ao, "start audio wait");
@@ -367,7 +454,7 @@ static void *playthread(void *arg)
                 // Avoid busy waiting, because the audio API will still report
                 // that it needs new data, even if we're not ready yet, or if
                 // get_space() decides that the amount of audio buffered in the
-                // device is enough, and p->buffer can be empty.
+                // device is enough, and the ring can be empty.
                 // The most important part is that the decoder is woken up, so
                 // that the decoder will wake up us in turn.
                 MP_TRACE(ao, "buffer inactive.\n");
@@ -375,7 +462,7 @@ static void *playthread(void *arg)
                 bool was_playing = p->still_playing;
                 double timeout = -1;
                 if (p->still_playing && !p->paused && p->final_chunk &&
-                    !mp_audio_buffer_samples(p->buffer))
+                    !ring_buffered(p))
                 {
                     double now = mp_time_sec();
                     if (!p->expected_end_time)
@@ -453,6 +540,7 @@ static int init(struct ao *ao)
 {
     struct ao_push_state *p = ao->api_priv;
 
+    p->stats = stats_ctx_create(ao, ao->global, "ao");
     pthread_mutex_init(&p->lock, NULL);
     pthread_cond_init(&p->wakeup, NULL);
     mp_make_wakeup_pipe(p->wakeup_pipe);
@@ -462,10 +550,29 @@ static int init(struct ao *ao)
         goto err;
     }
 
-    p->buffer = mp_audio_buffer_create(ao);
-    mp_audio_buffer_reinit_fmt(p->buffer, ao->format,
-                               &ao->channels, ao->samplerate);
-    mp_audio_buffer_preallocate_min(p->buffer, ao->buffer);
+    // Round up, so that reads starting at period boundaries never straddle
+    // the end of the ring in the middle of a period.
+    int period = MPMAX(ao->period_size, 1);
+    p->ring_size = (MPMAX(ao->buffer, 1) + period - 1) / period * period;
+    p->sstride = af_fmt_to_bytes(ao->format);
+    p->num_planes = 1;
+    if (af_fmt_is_planar(ao->format)) {
+        p->num_planes = ao->channels.num;
+    } else {
+        p->sstride *= ao->channels.num;
+    }
+    for (int n = 0; n < p->num_planes; n++)
+        p->ring[n] = talloc_size(ao, p->ring_size * p->sstride);
+
+    p->target = ao->buffer;
+    if (ao->adaptive_buffer) {
+        p->min_target = MPMAX(ao->samplerate * ADAPT_MIN_BUFFER,
+                              2 * ao->period_size);
+        p->min_target = MPMIN(p->min_target, ao->buffer);
+        p->target = p->min_target;
+        p->last_adapt_time = mp_time_sec();
+        atomic_store(&ao->buffer_target, p->target);
+    }
     if (pthread_create(&p->thread, NULL, playthread, ao))
         goto err;
     return 0;
@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio/aconverter.h"
+#include "audio/aframe.h"
+#include "audio/chmap.h"
+#include "audio/format.h"
+#include "bench.h"
+#include "common/common.h"
+#include "common/msg.h"
+#include "mpv_talloc.h"
+
+#define FRAME_SAMPLES 1024
+
+struct conv_ctx {
+    struct mp_aconverter *conv;
+    struct mp_aframe *in;
+};
+
+static struct mp_aframe *make_frame(void *ta, int format, int channels,
+                                    int rate)
+{
+    struct mp_aframe *frame = talloc_steal(ta, mp_aframe_create());
+    struct mp_chmap chmap;
+    mp_chmap_from_channels(&chmap, channels);
+    mp_aframe_set_format(frame, format);
+    mp_aframe_set_chmap(frame, &chmap);
+    mp_aframe_set_rate(frame, rate);
+    struct mp_aframe_pool *pool = mp_aframe_pool_create(ta);
+    if (mp_aframe_pool_allocate(pool, frame, FRAME_SAMPLES) < 0)
+        abort();
+    uint8_t **planes = mp_aframe_get_data_rw(frame);
+    size_t plane_size = mp_aframe_get_sstride(frame) * FRAME_SAMPLES;
+    for (int p = 0; p < mp_aframe_get_planes(frame); p++) {
+        for (size_t i = 0; i < plane_size; i++)
+            planes[p][i] = (i * 31 + p) & 0x3F; // small, valid values
+    }
+    return frame;
+}
+
+static void bench_convert(void *ctx, int64_t n)
+{
+    struct conv_ctx *cc = ctx;
+    for (int64_t i = 0; i < n; i++) {
+        if (!mp_aconverter_write_input(cc->conv, mp_aframe_new_ref(cc->in)))
+            abort();
+        bool eof;
+        struct mp_aframe *out;
+        while ((out = mp_aconverter_read_output(cc->conv, &eof))) {
+            bench_sink += mp_aframe_get_size(out);
+            talloc_free(out);
+        }
+    }
+}
+
+static void run_convert(const char *name, int in_format, int in_rate,
+                        int in_ch, int out_format, int out_rate, int out_ch)
+{
+    void *ta = talloc_new(NULL);
+    static const struct mp_resample_opts opts = MP_RESAMPLE_OPTS_DEF;
+    struct conv_ctx cc = {
+        .conv = mp_aconverter_create(NULL, mp_null_log, &opts),
+        .in = make_frame(ta, in_format, in_ch, in_rate),
+    };
+    struct mp_chmap in_chmap, out_chmap;
+    mp_chmap_from_channels(&in_chmap, in_ch);
+    mp_chmap_from_channels(&out_chmap, out_ch);
+    if (!mp_aconverter_reconfig(cc.conv, in_rate, in_format, in_chmap,
+                                out_rate, out_format, out_chmap))
+        abort();
+    bench_run(name, bench_convert, &cc);
+    talloc_free(cc.conv);
+    talloc_free(ta);
+}
+
+int main(void)
+{
+    bench_init();
+
+    run_convert("aconverter/s16-float/2ch", AF_FORMAT_S16, 48000, 2,
+                AF_FORMAT_FLOAT, 48000, 2);
+    run_convert("aconverter/floatp-s16/6ch", AF_FORMAT_FLOATP, 48000, 6,
+                AF_FORMAT_S16, 48000, 6);
+    run_convert("aconverter/downmix/6ch-2ch", AF_FORMAT_FLOAT, 48000, 6,
+                AF_FORMAT_FLOAT, 48000, 2);
+    run_convert("aconverter/resample/44100-48000", AF_FORMAT_FLOAT, 44100, 2,
+                AF_FORMAT_FLOAT, 48000, 2);
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef MP_BENCH_H
+#define MP_BENCH_H
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "common/common.h"
+#include "osdep/timer.h"
+
+// Approximate duration of a single timed run, in seconds.
+#define BENCH_RUN_TIME 0.2
+// Number of timed runs; the fastest one is reported.
+#define BENCH_RUNS 5
+
+// Benchmarks can store results here, so the compiler can't drop the work.
+static volatile uint64_t bench_sink;
+
+// Must perform the measured operation n times.
+typedef void (*bench_fn)(void *ctx, int64_t n);
+
+static inline void bench_init(void)
+{
+    mp_time_init();
+}
+
+// Run fn and print the result as a single JSON object per line on stdout:
+//   {"name": "json/parse", "iterations": 1000, "ns_per_op": 123.456}
+// The reported time is the fastest of BENCH_RUNS runs, which is the most
+// repeatable number on a machine that is doing other things too.
+static inline void bench_run(const char *name, bench_fn fn, void *ctx)
+{
+    // Calibrate the number of iterations to about BENCH_RUN_TIME per run.
+    int64_t n = 1;
+    while (1) {
+        int64_t t = mp_time_us();
+        fn(ctx, n);
+        double secs = (mp_time_us() - t) / 1e6;
+        if (secs >= BENCH_RUN_TIME / 10) {
+            n = MPMAX(1, (int64_t)(n * BENCH_RUN_TIME / secs));
+            break;
+        }
+        n *= 2;
+    }
+
+    double best = INFINITY;
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        int64_t t = mp_time_us();
+        fn(ctx, n);
+        best = MPMIN(best, (mp_time_us() - t) * 1e3 / n);
+    }
+
+    printf("{\"name\": \"%s\", \"iterations\": %"PRId64", \"ns_per_op\": %.3f}\n",
+           name, n, best);
+    fflush(stdout);
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "common/common.h"
+#include "demux/packet.h"
+#include "mpv_talloc.h"
+
+struct packet_ctx {
+    struct demux_packet_pool *pool;
+    size_t size;
+};
+
+static void bench_alloc(void *ctx, int64_t n)
+{
+    struct packet_ctx *pc = ctx;
+    for (int64_t i = 0; i < n; i++) {
+        struct demux_packet *dp = new_demux_packet(pc->size);
+        bench_sink += dp->len;
+        free_demux_packet(dp);
+    }
+}
+
+static void bench_alloc_pooled(void *ctx, int64_t n)
+{
+    struct packet_ctx *pc = ctx;
+    for (int64_t i = 0; i < n; i++) {
+        struct demux_packet *dp = new_demux_packet_pooled(pc->pool, pc->size);
+        bench_sink += dp->len;
+        free_demux_packet(dp);
+    }
+}
+
+// Simulates a packet queue: keep a window of packets alive, freeing the
+// oldest one for every new one, as the demuxer does during playback.
+#define QUEUE_LEN 256
+
+static void bench_queue(void *ctx, int64_t n)
+{
+    struct packet_ctx *pc = ctx;
+    struct demux_packet *queue[QUEUE_LEN] = {0};
+    for (int64_t i = 0; i < n; i++) {
+        struct demux_packet **slot = &queue[i % QUEUE_LEN];
+        free_demux_packet(*slot);
+        *slot = pc->pool ? new_demux_packet_pooled(pc->pool, pc->size)
+                         : new_demux_packet(pc->size);
+        (*slot)->pts = i;
+        bench_sink += demux_packet_estimate_total_size(*slot);
+    }
+    for (int i = 0; i < QUEUE_LEN; i++)
+        free_demux_packet(queue[i]);
+}
+
+static void bench_copy(void *ctx, int64_t n)
+{
+    struct packet_ctx *pc = ctx;
+    struct demux_packet *dp = new_demux_packet(pc->size);
+    for (int64_t i = 0; i < n; i++) {
+        struct demux_packet *copy = demux_copy_packet(dp);
+        bench_sink += copy->len;
+        free_demux_packet(copy);
+    }
+    free_demux_packet(dp);
+}
+
+int main(void)
+{
+    bench_init();
+
+    void *ta = talloc_new(NULL);
+    static const size_t sizes[] = {1024, 64 * 1024};
+    for (int n = 0; n < MP_ARRAY_SIZE(sizes); n++) {
+        struct packet_ctx plain = { .size = sizes[n] };
+        struct packet_ctx pooled = { demux_packet_pool_create(ta), sizes[n] };
+        char name[80];
+        snprintf(name, sizeof(name), "demux_packet/alloc/%zu", sizes[n]);
+        bench_run(name, bench_alloc, &plain);
+        snprintf(name, sizeof(name), "demux_packet/alloc-pooled/%zu", sizes[n]);
+        bench_run(name, bench_alloc_pooled, &pooled);
+        snprintf(name, sizeof(name), "demux_packet/queue/%zu", sizes[n]);
+        bench_run(name, bench_queue, &plain);
+        snprintf(name, sizeof(name), "demux_packet/queue-pooled/%zu", sizes[n]);
+        bench_run(name, bench_queue, &pooled);
+        snprintf(name, sizeof(name), "demux_packet/copy/%zu", sizes[n]);
+        bench_run(name, bench_copy, &plain);
+    }
+    talloc_free(ta);
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <string.h>
+
+#include "bench.h"
+#include "common/common.h"
+#include "misc/json.h"
+#include "mpv_talloc.h"
+
+static const char json_doc[] =
+    "{\"event\": \"property-change\", \"id\": 12, \"name\": \"track-list\","
+    " \"data\": [{\"id\": 1, \"type\": \"video\", \"src-id\": 0,"
+    " \"selected\": true, \"codec\": \"h264\", \"demux-w\": 1920,"
+    " \"demux-h\": 1080, \"demux-fps\": 23.976024},"
+    " {\"id\": 1, \"type\": \"audio\", \"lang\": \"eng\", \"title\": null,"
+    " \"selected\": true, \"codec\": \"aac\", \"demux-samplerate\": 48000,"
+    " \"demux-channel-count\": 2, \"external\": false},"
+    " {\"id\": 1, \"type\": \"sub\", \"lang\": \"ger\", \"title\":"
+    " \"Deutsch \\u00e4\\u00f6\\u00fc\", \"selected\": false}]}";
+
+static void bench_json_parse(void *ctx, int64_t n)
+{
+    for (int64_t i = 0; i < n; i++) {
+        void *ta = talloc_new(NULL);
+        char *src = talloc_strdup(ta, json_doc);
+        struct mpv_node node;
+        bench_sink += json_parse(ta, &node, &src, 50);
+        talloc_free(ta);
+    }
+}
+
+static void bench_json_write(void *ctx, int64_t n)
+{
+    struct mpv_node *node = ctx;
+    for (int64_t i = 0; i < n; i++) {
+        char *out = talloc_strdup(NULL, "");
+        json_write(&out, node);
+        bench_sink += strlen(out);
+        talloc_free(out);
+    }
+}
+
+static void bench_ta_alloc(void *ctx, int64_t n)
+{
+    for (int64_t i = 0; i < n; i++) {
+        void *p = talloc_size(NULL, 64);
+        bench_sink += (uintptr_t)p;
+        talloc_free(p);
+    }
+}
+
+static void bench_ta_tree(void *ctx, int64_t n)
+{
+    for (int64_t i = 0; i < n; i++) {
+        void *root = talloc_new(NULL);
+        for (int c = 0; c < 32; c++) {
+            char *s = talloc_size(root, 32);
+            talloc_size(s, 16);
+        }
+        talloc_free(root);
+    }
+}
+
+static void bench_ta_realloc(void *ctx, int64_t n)
+{
+    for (int64_t i = 0; i < n; i++) {
+        int *arr = NULL;
+        int num = 0;
+        for (int c = 0; c < 256; c++)
+            MP_TARRAY_APPEND(NULL, arr, num, c);
+        bench_sink += num;
+        talloc_free(arr);
+    }
+}
+
+int main(void)
+{
+    bench_init();
+
+    void *ta = talloc_new(NULL);
+    char *src = talloc_strdup(ta, json_doc);
+    struct mpv_node node;
+    if (json_parse(ta, &node, &src, 50) < 0)
+        return 1;
+
+    bench_run("json/parse", bench_json_parse, NULL);
+    bench_run("json/write", bench_json_write, &node);
+    bench_run("ta/alloc-free", bench_ta_alloc, NULL);
+    bench_run("ta/tree-32x2", bench_ta_tree, NULL);
+    bench_run("ta/tarray-append-256", bench_ta_realloc, NULL);
+
+    talloc_free(ta);
+    return 0;
+}
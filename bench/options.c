@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "common/common.h"
+#include "common/msg.h"
+#include "options/m_option.h"
+
+struct bench_opts {
+    int i;
+    double d;
+    double t;
+    int c;
+    char *s;
+    char **sl;
+    char **kv;
+};
+
+#define OPT_BASE_STRUCT struct bench_opts
+static const m_option_t bench_options[] = {
+    OPT_INT("int", i, 0),
+    OPT_DOUBLE("double", d, 0),
+    OPT_TIME("time", t, 0),
+    OPT_CHOICE("choice", c, 0,
+               ({"no", 0}, {"auto", 1}, {"yes", 2}, {"full", 3})),
+    OPT_STRING("string", s, 0),
+    OPT_STRINGLIST("string-list", sl, 0),
+    OPT_KEYVALUELIST("keyvalue-list", kv, 0),
+    {0}
+};
+
+struct parse_case {
+    const m_option_t *opt;
+    const char *param;
+};
+
+static void bench_parse(void *ctx, int64_t n)
+{
+    struct parse_case *pc = ctx;
+    struct bench_opts opts = {0};
+    void *dst = (char *)&opts + pc->opt->offset;
+    for (int64_t i = 0; i < n; i++) {
+        bench_sink += m_option_parse(mp_null_log, pc->opt, bstr0(pc->opt->name),
+                                     bstr0(pc->param), dst);
+        m_option_free(pc->opt, dst);
+    }
+}
+
+static void bench_copy(void *ctx, int64_t n)
+{
+    struct parse_case *pc = ctx;
+    struct bench_opts src = {0}, dst = {0};
+    void *psrc = (char *)&src + pc->opt->offset;
+    void *pdst = (char *)&dst + pc->opt->offset;
+    m_option_parse(mp_null_log, pc->opt, bstr0(pc->opt->name),
+                   bstr0(pc->param), psrc);
+    for (int64_t i = 0; i < n; i++) {
+        m_option_copy(pc->opt, pdst, psrc);
+        bench_sink += *(uintptr_t *)pdst;
+    }
+    m_option_free(pc->opt, pdst);
+    m_option_free(pc->opt, psrc);
+}
+
+static const m_option_t *find_opt(const char *name)
+{
+    for (int n = 0; bench_options[n].name; n++) {
+        if (strcmp(bench_options[n].name, name) == 0)
+            return &bench_options[n];
+    }
+    abort();
+}
+
+int main(void)
+{
+    bench_init();
+
+    static const struct { const char *opt, *param; } cases[] = {
+        {"int", "12345"},
+        {"double", "-1.5e3"},
+        {"time", "01:02:03.5"},
+        {"choice", "full"},
+        {"string", "some string value"},
+        {"string-list", "a,b,c,d,e,f,g,h"},
+        {"keyvalue-list", "a=1,bb=22,ccc=333,dddd=4444"},
+    };
+
+    for (int n = 0; n < MP_ARRAY_SIZE(cases); n++) {
+        struct parse_case pc = { find_opt(cases[n].opt), cases[n].param };
+        char name[80];
+        snprintf(name, sizeof(name), "m_option/parse/%s", cases[n].opt);
+        bench_run(name, bench_parse, &pc);
+    }
+
+    const char *copy_cases[] = {"string", "string-list", "keyvalue-list"};
+    for (int n = 0; n < MP_ARRAY_SIZE(copy_cases); n++) {
+        struct parse_case pc = { find_opt(copy_cases[n]), NULL };
+        for (int i = 0; i < MP_ARRAY_SIZE(cases); i++) {
+            if (strcmp(cases[i].opt, copy_cases[n]) == 0)
+                pc.param = cases[i].param;
+        }
+        char name[80];
+        snprintf(name, sizeof(name), "m_option/copy/%s", copy_cases[n]);
+        bench_run(name, bench_copy, &pc);
+    }
+
+    return 0;
+}
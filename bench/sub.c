@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "common/common.h"
+#include "mpv_talloc.h"
+#include "sub/draw_bmp.h"
+#include "sub/osd.h"
+#include "video/img_format.h"
+#include "video/mp_image.h"
+#include "video/out/bitmap_packer.h"
+
+#define VIDEO_W 1920
+#define VIDEO_H 1080
+
+// Roughly the layout of two lines of subtitles: one part per glyph, plus
+// outlines and shadows.
+#define NUM_PARTS 120
+#define PART_W 28
+#define PART_H 40
+
+struct draw_ctx {
+    struct mp_image *dst;
+    struct sub_bitmaps sbs;
+    struct mp_draw_sub_cache *cache;
+};
+
+static void make_bitmaps(void *ta, struct sub_bitmaps *sbs, int format)
+{
+    int bpp = format == SUBBITMAP_RGBA ? 4 : 1;
+    *sbs = (struct sub_bitmaps){ .format = format, .change_id = 1,
+                                 .num_parts = NUM_PARTS };
+    sbs->parts = talloc_zero_array(ta, struct sub_bitmap, NUM_PARTS);
+    for (int n = 0; n < NUM_PARTS; n++) {
+        struct sub_bitmap *b = &sbs->parts[n];
+        b->w = b->dw = PART_W;
+        b->h = b->dh = PART_H;
+        b->stride = PART_W * bpp;
+        b->x = 200 + (n % 60) * (PART_W + 2);
+        b->y = VIDEO_H - 120 + (n / 60) * (PART_H + 4);
+        b->libass.color = 0xFFFFFF00;
+        uint8_t *data = talloc_size(ta, b->stride * b->h);
+        for (int i = 0; i < b->stride * b->h; i++)
+            data[i] = (i * 7 + n) & 0xFF;
+        if (format == SUBBITMAP_RGBA) {
+            // premultiplied alpha: color components must not exceed alpha
+            for (int i = 0; i < b->w * b->h; i++) {
+                uint8_t *px = &data[i * 4];
+                for (int c = 0; c < 3; c++)
+                    px[c] = MPMIN(px[c], px[3]);
+            }
+        }
+        b->bitmap = data;
+    }
+}
+
+static void bench_draw(void *ctx, int64_t n)
+{
+    struct draw_ctx *dc = ctx;
+    for (int64_t i = 0; i < n; i++)
+        mp_draw_sub_bitmaps(&dc->cache, dc->dst, &dc->sbs);
+}
+
+static void run_draw(const char *name, int imgfmt, int format)
+{
+    void *ta = talloc_new(NULL);
+    struct draw_ctx dc = { .dst = mp_image_alloc(imgfmt, VIDEO_W, VIDEO_H) };
+    if (!dc.dst)
+        abort();
+    talloc_steal(ta, dc.dst);
+    mp_image_clear(dc.dst, 0, 0, VIDEO_W, VIDEO_H);
+    make_bitmaps(ta, &dc.sbs, format);
+    bench_run(name, bench_draw, &dc);
+    talloc_free(dc.cache);
+    talloc_free(ta);
+}
+
+struct packer_ctx {
+    struct bitmap_packer *packer;
+    bool reset;
+};
+
+static void bench_pack(void *ctx, int64_t n)
+{
+    struct packer_ctx *pc = ctx;
+    struct bitmap_packer *p = pc->packer;
+    for (int64_t i = 0; i < n; i++) {
+        if (pc->reset) {
+            // Forget the previous placement, so everything is packed anew.
+            p->prev_count = 0;
+        }
+        bench_sink += packer_pack(p);
+    }
+}
+
+static void run_pack(const char *name, bool reset)
+{
+    struct bitmap_packer *p = talloc_zero(NULL, struct bitmap_packer);
+    p->w_max = p->h_max = 4096;
+    p->padding = 1;
+    packer_set_size(p, 500);
+    for (int n = 0; n < p->count; n++) {
+        p->in[n].x = 4 + (n * 37) % 60;
+        p->in[n].y = 8 + (n * 13) % 50;
+    }
+    struct packer_ctx pc = { p, reset };
+    bench_run(name, bench_pack, &pc);
+    talloc_free(p);
+}
+
+int main(void)
+{
+    bench_init();
+
+    run_draw("draw_bmp/libass/yuv420p", IMGFMT_420P, SUBBITMAP_LIBASS);
+    run_draw("draw_bmp/rgba/yuv420p", IMGFMT_420P, SUBBITMAP_RGBA);
+    run_draw("draw_bmp/libass/bgra", IMGFMT_BGRA, SUBBITMAP_LIBASS);
+    run_draw("draw_bmp/rgba/bgra", IMGFMT_BGRA, SUBBITMAP_RGBA);
+
+    run_pack("bitmap_packer/pack-500", true);
+    run_pack("bitmap_packer/repack-500", false);
+
+    return 0;
+}
@@ -21,6 +21,7 @@
  */
 
 #include <libavutil/avutil.h>
+#include <libavutil/pixdesc.h>
 
 #include "config.h"
 #include "encode_lavc.h"
@@ -29,6 +30,7 @@
 #include "common/msg_control.h"
 #include "options/m_option.h"
 #include "options/options.h"
+#include "osdep/threads.h"
 #include "osdep/timer.h"
 #include "video/out/vo.h"
 #include "mpv_talloc.h"
@@ -177,6 +179,9 @@ struct encode_lavc_context *encode_lavc_init(struct encode_opts *options,
 
     ctx = talloc_zero(NULL, struct encode_lavc_context);
     pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->encoders_idle, NULL);
+    pthread_mutex_init(&ctx->mux_lock, NULL);
+    pthread_cond_init(&ctx->mux_wakeup, NULL);
     ctx->log = mp_log_new(ctx, global->log, "encode-lavc");
     ctx->global = global;
     encode_lavc_discontinuity(ctx);
@@ -306,6 +311,54 @@ void encode_lavc_set_metadata(struct encode_lavc_context *ctx,
     }
 }
 
+// Maximum amount of packet data waiting for mux_thread. If the output is
+// slower than this can absorb, encode_lavc_write_frame() blocks.
+#define MUX_QUEUE_MAX_BYTES (64 * 1024 * 1024)
+
+static void *mux_thread(void *p)
+{
+    struct encode_lavc_context *ctx = p;
+    mpthread_set_name("encode-mux");
+
+    pthread_mutex_lock(&ctx->mux_lock);
+    while (1) {
+        if (ctx->num_mux_queue) {
+            AVPacket *packet = ctx->mux_queue[0];
+            MP_TARRAY_REMOVE_AT(ctx->mux_queue, ctx->num_mux_queue, 0);
+            int size = packet->size;
+            pthread_mutex_unlock(&ctx->mux_lock);
+            bool ok = av_interleaved_write_frame(ctx->avc, packet) >= 0;
+            av_packet_free(&packet);
+            pthread_mutex_lock(&ctx->mux_lock);
+            if (!ok && !ctx->mux_error) {
+                MP_ERR(ctx, "error writing packet\n");
+                ctx->mux_error = true;
+            }
+            ctx->mux_queue_bytes -= size;
+            pthread_cond_broadcast(&ctx->mux_wakeup);
+            continue;
+        }
+        if (ctx->mux_terminate)
+            break;
+        pthread_cond_wait(&ctx->mux_wakeup, &ctx->mux_lock);
+    }
+    pthread_mutex_unlock(&ctx->mux_lock);
+    return NULL;
+}
+
+// Write all queued packets and wait until mux_thread exits.
+static void stop_mux_thread(struct encode_lavc_context *ctx)
+{
+    if (!ctx->mux_thread_running)
+        return;
+    pthread_mutex_lock(&ctx->mux_lock);
+    ctx->mux_terminate = true;
+    pthread_cond_broadcast(&ctx->mux_wakeup);
+    pthread_mutex_unlock(&ctx->mux_lock);
+    pthread_join(ctx->mux_thread, NULL);
+    ctx->mux_thread_running = false;
+}
+
 int encode_lavc_start(struct encode_lavc_context *ctx)
 {
     AVDictionaryEntry *de;
@@ -317,6 +370,11 @@ int encode_lavc_start(struct encode_lavc_context *ctx)
 
     CHECK_FAIL(ctx, 0);
 
+    // A hardware video encoder is opened with the first frame only, because
+    // it needs the frame's hw frames context. Wait for it.
+    if (ctx->vcc && !avcodec_is_open(ctx->vcc))
+        return 0;
+
     if (ctx->expect_video && ctx->vcc == NULL) {
         if (ctx->avc->oformat->video_codec != AV_CODEC_ID_NONE ||
             ctx->options->vcodec) {
@@ -370,6 +428,12 @@ int encode_lavc_start(struct encode_lavc_context *ctx)
         MP_WARN(ctx, "ofopts: key '%s' not found.\n", de->key);
     av_dict_free(&ctx->foptions);
 
+    if (pthread_create(&ctx->mux_thread, NULL, mux_thread, ctx)) {
+        encode_lavc_fail(ctx, "could not start muxer thread\n");
+        return 0;
+    }
+    ctx->mux_thread_running = true;
+
     ctx->header_written = 1;
     return 1;
 }
@@ -383,6 +447,9 @@ void encode_lavc_free(struct encode_lavc_context *ctx)
         encode_lavc_fail(ctx,
                          "called encode_lavc_free without encode_lavc_finish\n");
 
+    pthread_cond_destroy(&ctx->mux_wakeup);
+    pthread_mutex_destroy(&ctx->mux_lock);
+    pthread_cond_destroy(&ctx->encoders_idle);
     pthread_mutex_destroy(&ctx->lock);
     talloc_free(ctx);
 }
@@ -397,6 +464,13 @@ void encode_lavc_finish(struct encode_lavc_context *ctx)
     if (ctx->finished)
         return;
 
+    // If an encoder is running unlocked, the caller holds the lock (the
+    // encoders can only be active if the VO or AO exist).
+    while (ctx->encoders_busy)
+        pthread_cond_wait(&ctx->encoders_idle, &ctx->lock);
+
+    stop_mux_thread(ctx);
+
     if (ctx->avc) {
         if (ctx->header_written > 0)
             av_write_trailer(ctx->avc);  // this is allowed to fail
@@ -846,11 +920,45 @@ int encode_lavc_write_frame(struct encode_lavc_context *ctx, AVStream *stream,
             break;
     }
 
-    r = av_interleaved_write_frame(ctx->avc, packet);
+    AVPacket *new_packet = av_packet_clone(packet);
+    if (!new_packet)
+        return -1;
+
+    pthread_mutex_lock(&ctx->mux_lock);
+    while (ctx->mux_queue_bytes >= MUX_QUEUE_MAX_BYTES && !ctx->mux_error)
+        pthread_cond_wait(&ctx->mux_wakeup, &ctx->mux_lock);
+    r = ctx->mux_error ? -1 : 0;
+    if (r >= 0) {
+        MP_TARRAY_APPEND(ctx, ctx->mux_queue, ctx->num_mux_queue, new_packet);
+        ctx->mux_queue_bytes += new_packet->size;
+        pthread_cond_broadcast(&ctx->mux_wakeup);
+    } else {
+        av_packet_free(&new_packet);
+    }
+    pthread_mutex_unlock(&ctx->mux_lock);
 
     return r;
 }
 
+// vo_lavc.c and ao_lavc.c call avcodec encode functions between these two
+// calls, with the lock released in between, so that audio and video encoding
+// can run in parallel. The codec context must not be accessed after
+// encode_lavc_end_encode() returned false, because encoding was aborted and
+// the context has been freed.
+void encode_lavc_begin_encode(struct encode_lavc_context *ctx)
+{
+    ctx->encoders_busy++;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+bool encode_lavc_end_encode(struct encode_lavc_context *ctx)
+{
+    pthread_mutex_lock(&ctx->lock);
+    ctx->encoders_busy--;
+    pthread_cond_broadcast(&ctx->encoders_idle);
+    return !ctx->finished;
+}
+
 int encode_lavc_supports_pixfmt(struct encode_lavc_context *ctx,
                                 enum AVPixelFormat pix_fmt)
 {
@@ -861,9 +969,11 @@ int encode_lavc_supports_pixfmt(struct encode_lavc_context *ctx,
     if (pix_fmt == AV_PIX_FMT_NONE)
         return 0;
 
-    if (!ctx->vc->pix_fmts)
-        return 1;
-    else {
+    // Hardware formats must be listed explicitly by the encoder.
+    if (!ctx->vc->pix_fmts) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+        return desc && !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL);
+    } else {
         const enum AVPixelFormat *p;
         for (p = ctx->vc->pix_fmts; *p >= 0; ++p) {
             if (pix_fmt == *p)
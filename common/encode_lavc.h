@@ -45,6 +45,24 @@ struct encode_lavc_context {
     // must lock manually before accessing state.
     pthread_mutex_t lock;
 
+    // Number of vo_lavc/ao_lavc encoders running avcodec without the lock
+    // (see encode_lavc_begin_encode()).
+    int encoders_busy;
+    pthread_cond_t encoders_idle;
+
+    // Packets are written by mux_thread, so encoders don't wait for the
+    // output. The mux_* fields are protected by mux_lock, not lock. Once the
+    // header is written, avc is accessed only by mux_thread until it exits.
+    pthread_t mux_thread;
+    bool mux_thread_running;
+    pthread_mutex_t mux_lock;
+    pthread_cond_t mux_wakeup;
+    AVPacket **mux_queue;
+    int num_mux_queue;
+    int64_t mux_queue_bytes;
+    bool mux_terminate;
+    bool mux_error;
+
     float vo_fps;
 
     // FFmpeg contexts.
@@ -102,6 +120,8 @@ void encode_lavc_write_stats(struct encode_lavc_context *ctx,
                              AVCodecContext *stream);
 int encode_lavc_write_frame(struct encode_lavc_context *ctx, AVStream *stream,
                             AVPacket *packet);
+void encode_lavc_begin_encode(struct encode_lavc_context *ctx);
+bool encode_lavc_end_encode(struct encode_lavc_context *ctx);
 int encode_lavc_supports_pixfmt(struct encode_lavc_context *ctx, enum AVPixelFormat format);
 int encode_lavc_open_codec(struct encode_lavc_context *ctx,
                            AVCodecContext *codec);
@@ -36,6 +36,7 @@
 #include "options/path.h"
 #include "osdep/terminal.h"
 #include "osdep/io.h"
+#include "osdep/threads.h"
 #include "osdep/timer.h"
 
 #include "libmpv/client.h"
@@ -70,8 +71,23 @@ struct mp_log_root {
     atomic_ulong reload_counter;
     // --- protected by mp_msg_lock
     bstr buffer;
+    bstr log_file_line;
+    // --- log file writer thread; started while log_file is set
+    // Producers are serialized by mp_msg_lock, the only consumer is the
+    // writer thread.
+    struct mp_ring *log_file_ring;
+    bool log_file_thread_running;   // protected by mp_msg_lock
+    pthread_t log_file_thread;
+    pthread_mutex_t log_file_lock;  // for log_file_wakeup
+    pthread_cond_t log_file_wakeup;
+    bool log_file_terminate;        // protected by log_file_lock
+    atomic_ulong log_file_dropped;  // messages lost due to full ring
 };
 
+// Size of the log file ring buffer. If the writer thread can't keep up,
+// messages are dropped.
+#define LOG_FILE_RING_SIZE (1024 * 1024)
+
 struct mp_log {
     struct mp_log_root *root;
     const char *prefix;
@@ -281,6 +297,77 @@ static void print_terminal_line(struct mp_log *log, int lev,
     fflush(stream);
 }
 
+static bool drain_log_file_ring(struct mp_log_root *root)
+{
+    bool written = false;
+    unsigned char buf[4096];
+    int r;
+    while ((r = mp_ring_read(root->log_file_ring, buf, sizeof(buf))) > 0) {
+        fwrite(buf, r, 1, root->log_file);
+        written = true;
+    }
+    unsigned long dropped = atomic_exchange(&root->log_file_dropped, 0);
+    if (dropped) {
+        fprintf(root->log_file, "[%8.3f][w][log] %lu messages dropped\n",
+                (mp_time_us() - MP_START_TIME) / 1e6, dropped);
+        written = true;
+    }
+    return written;
+}
+
+static void *log_file_thread(void *p)
+{
+    struct mp_log_root *root = p;
+
+    mpthread_set_name("log-file");
+
+    pthread_mutex_lock(&root->log_file_lock);
+    while (1) {
+        bool terminate = root->log_file_terminate;
+        pthread_mutex_unlock(&root->log_file_lock);
+        if (drain_log_file_ring(root))
+            fflush(root->log_file);
+        pthread_mutex_lock(&root->log_file_lock);
+        if (terminate)
+            break;
+        if (!mp_ring_buffered(root->log_file_ring) &&
+            !atomic_load(&root->log_file_dropped) && !root->log_file_terminate)
+            pthread_cond_wait(&root->log_file_wakeup, &root->log_file_lock);
+    }
+    pthread_mutex_unlock(&root->log_file_lock);
+    return NULL;
+}
+
+// Must be called with mp_msg_lock held. Writes all pending messages.
+static void stop_log_file_thread(struct mp_log_root *root)
+{
+    if (!root->log_file_thread_running)
+        return;
+    pthread_mutex_lock(&root->log_file_lock);
+    root->log_file_terminate = true;
+    pthread_cond_signal(&root->log_file_wakeup);
+    pthread_mutex_unlock(&root->log_file_lock);
+    pthread_join(root->log_file_thread, NULL);
+    root->log_file_thread_running = false;
+}
+
+// Must be called with mp_msg_lock held. On failure, log messages are written
+// synchronously.
+static void start_log_file_thread(struct mp_log_root *root)
+{
+#if HAVE_ATOMICS
+    assert(!root->log_file_thread_running);
+    if (!root->log_file_ring)
+        root->log_file_ring = mp_ring_new(root, LOG_FILE_RING_SIZE);
+    if (!root->log_file_ring)
+        return;
+    mp_ring_reset(root->log_file_ring);
+    root->log_file_terminate = false;
+    root->log_file_thread_running =
+        !pthread_create(&root->log_file_thread, NULL, log_file_thread, root);
+#endif
+}
+
 static void write_log_file(struct mp_log *log, int lev, char *text)
 {
     struct mp_log_root *root = log->root;
@@ -288,11 +375,32 @@ static void write_log_file(struct mp_log *log, int lev, char *text)
     if (!root->log_file || lev > MPMAX(MSGL_DEBUG, log->terminal_level))
         return;
 
-    fprintf(root->log_file, "[%8.3f][%c][%s] %s",
-            (mp_time_us() - MP_START_TIME) / 1e6,
-            mp_log_levels[lev][0],
-            log->verbose_prefix, text);
-    fflush(root->log_file);
+    if (!root->log_file_thread_running) {
+        fprintf(root->log_file, "[%8.3f][%c][%s] %s",
+                (mp_time_us() - MP_START_TIME) / 1e6,
+                mp_log_levels[lev][0],
+                log->verbose_prefix, text);
+        fflush(root->log_file);
+        return;
+    }
+
+    // Format the line here (so the timestamp is accurate), and leave the
+    // slow file I/O to the writer thread.
+    root->log_file_line.len = 0;
+    bstr_xappend_asprintf(root, &root->log_file_line, "[%8.3f][%c][%s] %s",
+                          (mp_time_us() - MP_START_TIME) / 1e6,
+                          mp_log_levels[lev][0],
+                          log->verbose_prefix, text);
+    bstr line = root->log_file_line;
+    if (mp_ring_available(root->log_file_ring) < line.len) {
+        atomic_fetch_add(&root->log_file_dropped, 1);
+    } else {
+        mp_ring_write(root->log_file_ring, line.start, line.len);
+    }
+
+    pthread_mutex_lock(&root->log_file_lock);
+    pthread_cond_signal(&root->log_file_wakeup);
+    pthread_mutex_unlock(&root->log_file_lock);
 }
 
 static void write_msg_to_buffers(struct mp_log *log, int lev, char *text)
@@ -454,7 +562,10 @@ void mp_msg_init(struct mpv_global *global)
     *root = (struct mp_log_root){
         .global = global,
         .reload_counter = ATOMIC_VAR_INIT(1),
+        .log_file_dropped = ATOMIC_VAR_INIT(0),
     };
+    pthread_mutex_init(&root->log_file_lock, NULL);
+    pthread_cond_init(&root->log_file_wakeup, NULL);
 
     struct mp_log dummy = { .root = root };
     struct mp_log *log = mp_log_new(root, &dummy, "");
@@ -480,8 +591,13 @@ static void reopen_file(char *opt, char **current_path, FILE **file,
 
     pthread_mutex_lock(&mp_msg_lock); // for *current_path/*file
 
+    struct mp_log_root *root = global->log->root;
+    bool is_log = file == &root->log_file;
+
     char *old_path = *current_path ? *current_path : "";
     if (strcmp(old_path, new_path) != 0) {
+        if (is_log)
+            stop_log_file_thread(root);
         if (*file)
             fclose(*file);
         *file = NULL;
@@ -491,6 +607,8 @@ static void reopen_file(char *opt, char **current_path, FILE **file,
             *file = fopen(new_path, "wb");
             fail = !*file;
         }
+        if (is_log && *file)
+            start_log_file_thread(root);
     }
 
     pthread_mutex_unlock(&mp_msg_lock);
@@ -561,10 +679,15 @@ void mp_msg_uninit(struct mpv_global *global)
     if (root->stats_file)
         fclose(root->stats_file);
     talloc_free(root->stats_path);
+    pthread_mutex_lock(&mp_msg_lock);
+    stop_log_file_thread(root);
+    pthread_mutex_unlock(&mp_msg_lock);
     if (root->log_file)
         fclose(root->log_file);
     talloc_free(root->log_path);
     m_option_type_msglevels.free(&root->msg_levels);
+    pthread_cond_destroy(&root->log_file_wakeup);
+    pthread_mutex_destroy(&root->log_file_lock);
     talloc_free(root);
     global->log = NULL;
 }
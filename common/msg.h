@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include "config.h"
 #include "osdep/compiler.h"
 
 struct mp_log;
@@ -54,14 +55,32 @@ void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va);
 
 bool mp_msg_test(struct mp_log *log, int lev);
 
+// Like mp_msg(), but test the level before the arguments are evaluated. Used
+// for the verbose levels, which are often called on hot paths, but are
+// usually disabled. Can be used as a statement only.
+#define mp_msg_checked(log, lev, ...) do {                  \
+        struct mp_log *mp_msg_log_ = (log);                 \
+        if (mp_msg_test(mp_msg_log_, lev))                  \
+            mp_msg(mp_msg_log_, lev, __VA_ARGS__);          \
+    } while (0)
+
+// With --disable-msg-trace, trace messages are compiled out. (The dead
+// mp_msg() call keeps the format string checked and the arguments "used".)
+#if HAVE_MSG_TRACE
+#define mp_msg_trace(log, ...)  mp_msg_checked(log, MSGL_TRACE, __VA_ARGS__)
+#else
+#define mp_msg_trace(log, ...)                              \
+    do { if (0) mp_msg(log, MSGL_TRACE, __VA_ARGS__); } while (0)
+#endif
+
 // Convenience macros.
 #define mp_fatal(log, ...)      mp_msg(log, MSGL_FATAL, __VA_ARGS__)
 #define mp_err(log, ...)        mp_msg(log, MSGL_ERR, __VA_ARGS__)
 #define mp_warn(log, ...)       mp_msg(log, MSGL_WARN, __VA_ARGS__)
 #define mp_info(log, ...)       mp_msg(log, MSGL_INFO, __VA_ARGS__)
 #define mp_verbose(log, ...)    mp_msg(log, MSGL_V, __VA_ARGS__)
-#define mp_dbg(log, ...)        mp_msg(log, MSGL_DEBUG, __VA_ARGS__)
-#define mp_trace(log, ...)      mp_msg(log, MSGL_TRACE, __VA_ARGS__)
+#define mp_dbg(log, ...)        mp_msg_checked(log, MSGL_DEBUG, __VA_ARGS__)
+#define mp_trace(log, ...)      mp_msg_trace(log, __VA_ARGS__)
 
 // Convenience macros, typically called with a pointer to a context struct
 // as first argument, which has a "struct mp_log *log;" member.
@@ -73,8 +92,8 @@ bool mp_msg_test(struct mp_log *log, int lev);
 #define MP_WARN(obj, ...)       MP_MSG(obj, MSGL_WARN, __VA_ARGS__)
 #define MP_INFO(obj, ...)       MP_MSG(obj, MSGL_INFO, __VA_ARGS__)
 #define MP_VERBOSE(obj, ...)    MP_MSG(obj, MSGL_V, __VA_ARGS__)
-#define MP_DBG(obj, ...)        MP_MSG(obj, MSGL_DEBUG, __VA_ARGS__)
-#define MP_TRACE(obj, ...)      MP_MSG(obj, MSGL_TRACE, __VA_ARGS__)
+#define MP_DBG(obj, ...)        mp_msg_checked((obj)->log, MSGL_DEBUG, __VA_ARGS__)
+#define MP_TRACE(obj, ...)      mp_msg_trace((obj)->log, __VA_ARGS__)
 
 // This is a bit special. See TOOLS/stats-conv.py what rules text passed
 // to these functions should follow. Also see --dump-stats.
@@ -73,6 +73,13 @@ void playlist_insert(struct playlist *pl, struct playlist_entry *after,
     } else {
         pl->last = add;
     }
+    if (!add->next && !pl->index_dirty) {
+        add->pl_index = pl->num_entries;
+        MP_TARRAY_APPEND(pl, pl->entries, pl->num_entries, add);
+    } else {
+        pl->index_dirty = true;
+        pl->num_entries++;
+    }
     add->pl = pl;
     talloc_steal(pl, add);
 }
@@ -91,6 +98,13 @@ static void playlist_unlink(struct playlist *pl, struct playlist_entry *entry)
         pl->current_was_replaced = true;
     }
 
+    // Removing the last entry doesn't change the index of any other entry.
+    if (entry->next)
+        pl->index_dirty = true;
+    pl->num_entries--;
+    if (!pl->num_entries)
+        pl->index_dirty = false;
+
     if (entry->next) {
         entry->next->prev = entry->prev;
     } else {
@@ -150,19 +164,11 @@ void playlist_add_file(struct playlist *pl, const char *filename)
     playlist_add(pl, playlist_entry_new(filename));
 }
 
-static int playlist_count(struct playlist *pl)
-{
-    int c = 0;
-    for (struct playlist_entry *e = pl->first; e; e = e->next)
-        c++;
-    return c;
-}
-
 void playlist_shuffle(struct playlist *pl)
 {
     struct playlist_entry *save_current = pl->current;
     bool save_replaced = pl->current_was_replaced;
-    int count = playlist_count(pl);
+    int count = pl->num_entries;
     struct playlist_entry **arr = talloc_array(NULL, struct playlist_entry *,
                                                count);
     for (int n = 0; n < count; n++) {
@@ -243,36 +249,43 @@ void playlist_append_entries(struct playlist *pl, struct playlist *source_pl)
     }
 }
 
+static void playlist_update_index(struct playlist *pl)
+{
+    if (!pl->index_dirty)
+        return;
+    MP_TARRAY_GROW(pl, pl->entries, pl->num_entries);
+    int n = 0;
+    for (struct playlist_entry *e = pl->first; e; e = e->next) {
+        e->pl_index = n;
+        pl->entries[n++] = e;
+    }
+    assert(n == pl->num_entries);
+    pl->index_dirty = false;
+}
+
 // Return number of entries between list start and e.
 // Return -1 if e is not on the list, or if e is NULL.
 int playlist_entry_to_index(struct playlist *pl, struct playlist_entry *e)
 {
-    struct playlist_entry *cur = pl->first;
-    int pos = 0;
-    if (!e)
+    if (!e || e->pl != pl)
         return -1;
-    while (cur && cur != e) {
-        cur = cur->next;
-        pos++;
-    }
-    return cur == e ? pos : -1;
+    playlist_update_index(pl);
+    return e->pl_index;
 }
 
 int playlist_entry_count(struct playlist *pl)
 {
-    return playlist_entry_to_index(pl, pl->last) + 1;
+    return pl->num_entries;
 }
 
 // Return entry for which playlist_entry_to_index() would return index.
 // Return NULL if not found.
 struct playlist_entry *playlist_entry_from_index(struct playlist *pl, int index)
 {
-    struct playlist_entry *e = pl->first;
-    for (int n = 0; ; n++) {
-        if (!e || n == index)
-            return e;
-        e = e->next;
-    }
+    if (index < 0 || index >= pl->num_entries)
+        return NULL;
+    playlist_update_index(pl);
+    return pl->entries[index];
 }
 
 struct playlist *playlist_parse_file(const char *file, struct mpv_global *global)
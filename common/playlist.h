@@ -28,6 +28,8 @@ struct playlist_param {
 struct playlist_entry {
     struct playlist_entry *prev, *next;
     struct playlist *pl;
+    // Position in pl, valid only if pl->index_dirty is false.
+    int pl_index;
 
     char *filename;
 
@@ -71,6 +73,14 @@ struct playlist {
     bool current_was_replaced;
 
     bool disable_safety;
+
+    // Maps indexes to entries. num_entries is always valid; entries[] and
+    // playlist_entry.pl_index only if index_dirty is false. Appending keeps
+    // the index valid, other changes mark it dirty, and it's rebuilt on the
+    // next index lookup.
+    struct playlist_entry **entries;
+    int num_entries;
+    bool index_dirty;
 };
 
 void playlist_entry_add_param(struct playlist_entry *e, bstr name, bstr value);
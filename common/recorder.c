@@ -16,6 +16,7 @@
  */
 
 #include <math.h>
+#include <pthread.h>
 
 #include <libavformat/avformat.h>
 
@@ -25,6 +26,7 @@
 #include "common/msg.h"
 #include "demux/packet.h"
 #include "demux/stheader.h"
+#include "osdep/threads.h"
 
 #include "recorder.h"
 
@@ -38,6 +40,9 @@
 // codec delay and frame reordering, and potentially lack of DTS).
 // Keyframe flags can trigger this earlier.
 #define QUEUE_MIN_PACKETS 16
+// Maximum amount of packet data waiting for the writer thread. If the output
+// is slower than this can absorb, feeding packets blocks.
+#define WRITE_QUEUE_MAX_BYTES (64 * 1024 * 1024)
 
 struct mp_recorder {
     struct mpv_global *global;
@@ -59,6 +64,19 @@ struct mp_recorder {
     double rebase_ts;
 
     AVFormatContext *mux;
+
+    // Packets are written by a separate thread, so slow output doesn't block
+    // the caller. The mux context is accessed only by it while it's running.
+    pthread_t writer;
+    bool writer_running;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    // --- protected by lock
+    AVPacket **write_queue;
+    int num_write_queue;
+    int64_t write_queue_bytes;
+    bool writer_terminate;
+    bool stall_warning;
 };
 
 struct mp_recorder_sink {
@@ -114,6 +132,63 @@ static int add_stream(struct mp_recorder *priv, struct sh_stream *sh)
     return 0;
 }
 
+static void *writer_thread(void *p)
+{
+    struct mp_recorder *priv = p;
+    mpthread_set_name("recorder");
+
+    pthread_mutex_lock(&priv->lock);
+    while (1) {
+        if (priv->num_write_queue) {
+            AVPacket *pkt = priv->write_queue[0];
+            MP_TARRAY_REMOVE_AT(priv->write_queue, priv->num_write_queue, 0);
+            int size = pkt->size;
+            pthread_mutex_unlock(&priv->lock);
+            if (av_interleaved_write_frame(priv->mux, pkt) < 0)
+                MP_ERR(priv, "Failed writing packet.\n");
+            av_packet_free(&pkt);
+            pthread_mutex_lock(&priv->lock);
+            priv->write_queue_bytes -= size;
+            pthread_cond_broadcast(&priv->wakeup);
+            continue;
+        }
+        if (priv->writer_terminate)
+            break;
+        pthread_cond_wait(&priv->wakeup, &priv->lock);
+    }
+    pthread_mutex_unlock(&priv->lock);
+    return NULL;
+}
+
+static void queue_write(struct mp_recorder *priv, AVPacket *pkt)
+{
+    pthread_mutex_lock(&priv->lock);
+    if (priv->write_queue_bytes >= WRITE_QUEUE_MAX_BYTES) {
+        if (!priv->stall_warning) {
+            MP_WARN(priv, "Output is too slow, waiting for it.\n");
+            priv->stall_warning = true;
+        }
+        while (priv->write_queue_bytes >= WRITE_QUEUE_MAX_BYTES)
+            pthread_cond_wait(&priv->wakeup, &priv->lock);
+    }
+    MP_TARRAY_APPEND(priv, priv->write_queue, priv->num_write_queue, pkt);
+    priv->write_queue_bytes += pkt->size;
+    pthread_cond_broadcast(&priv->wakeup);
+    pthread_mutex_unlock(&priv->lock);
+}
+
+static void stop_writer(struct mp_recorder *priv)
+{
+    if (!priv->writer_running)
+        return;
+    pthread_mutex_lock(&priv->lock);
+    priv->writer_terminate = true;
+    pthread_cond_broadcast(&priv->wakeup);
+    pthread_mutex_unlock(&priv->lock);
+    pthread_join(priv->writer, NULL);
+    priv->writer_running = false;
+}
+
 struct mp_recorder *mp_recorder_create(struct mpv_global *global,
                                        const char *target_file,
                                        struct sh_stream **streams,
@@ -123,6 +198,8 @@ struct mp_recorder *mp_recorder_create(struct mpv_global *global,
 
     priv->global = global;
     priv->log = mp_log_new(priv, global->log, "recorder");
+    pthread_mutex_init(&priv->lock, NULL);
+    pthread_cond_init(&priv->wakeup, NULL);
 
     if (!num_streams) {
         MP_ERR(priv, "No streams.\n");
@@ -167,6 +244,12 @@ struct mp_recorder *mp_recorder_create(struct mpv_global *global,
     priv->opened = true;
     priv->muxing_from_start = true;
 
+    if (pthread_create(&priv->writer, NULL, writer_thread, priv)) {
+        MP_ERR(priv, "Starting writer thread failed.\n");
+        goto error;
+    }
+    priv->writer_running = true;
+
     priv->base_ts = MP_NOPTS_VALUE;
     priv->rebase_ts = 0;
 
@@ -217,8 +300,7 @@ static void mux_packet(struct mp_recorder_sink *rst,
         return;
     }
 
-    if (av_interleaved_write_frame(priv->mux, new_packet) < 0)
-        MP_ERR(priv, "Failed writing packet.\n");
+    queue_write(priv, new_packet);
 }
 
 // Write all packets that currently can be written.
@@ -300,6 +382,8 @@ void mp_recorder_destroy(struct mp_recorder *priv)
             mux_packets(rst, true);
         }
 
+        stop_writer(priv);
+
         if (av_write_trailer(priv->mux) < 0)
             MP_ERR(priv, "Writing trailer failed.\n");
     }
@@ -312,6 +396,8 @@ void mp_recorder_destroy(struct mp_recorder *priv)
     }
 
     flush_packets(priv);
+    pthread_cond_destroy(&priv->wakeup);
+    pthread_mutex_destroy(&priv->lock);
     talloc_free(priv);
 }
 
@@ -0,0 +1,435 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common/common.h"
+#include "common/global.h"
+#include "misc/node.h"
+#include "osdep/atomic.h"
+#include "osdep/timer.h"
+
+#include "stats.h"
+
+// Latency histogram buckets: bucket n counts times in [2^(n-1), 2^n) us, and
+// bucket 0 counts times below 1 us. The last bucket counts everything above.
+#define HIST_BUCKETS 28
+
+// Trace events buffered between stats_global_write_trace() calls. Once full,
+// further events are dropped instead of blocking the recording thread.
+#define TRACE_MAX_EVENTS (64 * 1024)
+
+struct trace_event {
+    int64_t ts;
+    const char *name;   // static string passed by the caller
+    int track;          // stats_ctx.track
+    char ph;            // Chrome trace event type
+};
+
+struct stats_base {
+    pthread_mutex_t lock;
+    // --- protected by lock
+    struct stats_ctx **list;
+    int num_list;
+    char **track_names; // stats_ctx.prefix for each stats_ctx.track
+    int num_tracks;
+    bool dead;          // stats_global_uninit() was called
+
+    pthread_mutex_t trace_lock;
+    // --- protected by trace_lock
+    struct trace_event *trace;
+    int num_trace;
+    int64_t trace_dropped;
+
+    // --- atomic
+    atomic_bool active; // collect stats at all
+    atomic_bool tracing; // record trace events
+};
+
+static const char *const mem_type_names[MP_MEM_TYPE_COUNT] = {
+    [MP_MEM_DEMUX_CACHE]    = "demux-cache",
+    [MP_MEM_STREAM_CACHE]   = "stream-cache",
+    [MP_MEM_IMAGE_POOLS]    = "image-pools",
+    [MP_MEM_GPU_TEXTURES]   = "gpu-textures",
+    [MP_MEM_SUBTITLES]      = "subtitles",
+    [MP_MEM_SCRIPTS]        = "scripts",
+};
+
+static atomic_llong mem_usage[MP_MEM_TYPE_COUNT];
+
+struct stat_entry {
+    const char *name;   // static string passed by the caller
+    int64_t count;
+    int64_t value;
+    bool has_value;
+    int64_t time_start;
+    int64_t time_count;
+    int64_t time_sum;
+    int64_t time_min;
+    int64_t time_max;
+    int64_t hist[HIST_BUCKETS];
+};
+
+struct stats_ctx {
+    struct stats_base *base;
+    const char *prefix;
+    int track;          // trace event thread ID
+
+    pthread_mutex_t lock;
+    // --- protected by lock
+    struct stat_entry **entries;
+    int num_entries;
+};
+
+static void free_base(struct stats_base *base)
+{
+    pthread_mutex_destroy(&base->lock);
+    pthread_mutex_destroy(&base->trace_lock);
+    talloc_free(base->trace);
+    talloc_free(base);
+}
+
+void stats_global_init(struct mpv_global *global)
+{
+    assert(!global->stats);
+    struct stats_base *base = talloc_zero(NULL, struct stats_base);
+    pthread_mutex_init(&base->lock, NULL);
+    pthread_mutex_init(&base->trace_lock, NULL);
+    atomic_store(&base->active, false);
+    atomic_store(&base->tracing, false);
+    global->stats = base;
+}
+
+// The base is freed only once all stats_ctx are destroyed, because they can
+// be owned by anything, and the destruction order is not strictly defined.
+void stats_global_uninit(struct mpv_global *global)
+{
+    struct stats_base *base = global->stats;
+    if (!base)
+        return;
+    pthread_mutex_lock(&base->lock);
+    base->dead = true;
+    bool unused = !base->num_list;
+    pthread_mutex_unlock(&base->lock);
+    if (unused)
+        free_base(base);
+    global->stats = NULL;
+}
+
+// Start collecting stats. This is done lazily, so that the instrumented code
+// costs close to nothing if nobody is interested in the data.
+void stats_global_enable(struct mpv_global *global)
+{
+    if (global->stats)
+        atomic_store(&global->stats->active, true);
+}
+
+// Start or stop buffering trace events. Enabling tracing also enables stats
+// collection in general.
+void stats_global_set_tracing(struct mpv_global *global, bool enable)
+{
+    struct stats_base *base = global->stats;
+    if (!base)
+        return;
+    if (enable)
+        atomic_store(&base->active, true);
+    atomic_store(&base->tracing, enable);
+}
+
+// Write all buffered trace events to f, and clear the buffer. The output
+// consists of Chrome trace format event objects, each followed by ",\n", so
+// the caller has to write the surrounding "[" and "]". *num_tracks is the
+// number of tracks whose names were already written (start with 0).
+void stats_global_write_trace(struct mpv_global *global, FILE *f,
+                              int *num_tracks)
+{
+    struct stats_base *base = global->stats;
+    if (!base)
+        return;
+
+    pthread_mutex_lock(&base->lock);
+    for (; *num_tracks < base->num_tracks; (*num_tracks)++) {
+        fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+                *num_tracks, base->track_names[*num_tracks]);
+    }
+    pthread_mutex_unlock(&base->lock);
+
+    // Swap out the buffer, so that the recording threads are not blocked
+    // while formatting.
+    pthread_mutex_lock(&base->trace_lock);
+    struct trace_event *events = base->trace;
+    int num_events = base->num_trace;
+    int64_t dropped = base->trace_dropped;
+    base->trace = NULL;
+    base->num_trace = 0;
+    base->trace_dropped = 0;
+    pthread_mutex_unlock(&base->trace_lock);
+
+    for (int n = 0; n < num_events; n++) {
+        struct trace_event *ev = &events[n];
+        fprintf(f, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%"PRId64","
+                "\"pid\":1,\"tid\":%d%s},\n", ev->name, ev->ph, ev->ts,
+                ev->track, ev->ph == 'i' ? ",\"s\":\"t\"" : "");
+    }
+    if (dropped) {
+        fprintf(f, "{\"name\":\"dropped-events\",\"ph\":\"i\",\"ts\":%"
+                PRId64",\"pid\":1,\"tid\":0,\"s\":\"g\",\"args\":"
+                "{\"count\":%"PRId64"}},\n", mp_time_us(), dropped);
+    }
+    talloc_free(events);
+}
+
+static void add_entry_node(struct mpv_node *dst, struct stat_entry *e)
+{
+    struct mpv_node *ne = node_map_add(dst, e->name, MPV_FORMAT_NODE_MAP);
+    if (e->count)
+        node_map_add_int64(ne, "count", e->count);
+    if (e->has_value)
+        node_map_add_int64(ne, "value", e->value);
+    if (e->time_count) {
+        node_map_add_int64(ne, "time-count", e->time_count);
+        node_map_add_double(ne, "time-avg", e->time_sum / 1e6 / e->time_count);
+        node_map_add_double(ne, "time-min", e->time_min / 1e6);
+        node_map_add_double(ne, "time-max", e->time_max / 1e6);
+        node_map_add_double(ne, "time-total", e->time_sum / 1e6);
+        struct mpv_node *hist =
+            node_map_add(ne, "time-histogram", MPV_FORMAT_NODE_ARRAY);
+        int last = 0;
+        for (int n = 0; n < HIST_BUCKETS; n++) {
+            if (e->hist[n])
+                last = n;
+        }
+        for (int n = 0; n <= last; n++)
+            node_array_add(hist, MPV_FORMAT_INT64)->u.int64 = e->hist[n];
+    }
+}
+
+// Return all stats as a map of prefix -> map of name -> values.
+void stats_global_query(struct mpv_global *global, void *ta_parent,
+                        struct mpv_node *node)
+{
+    struct stats_base *base = global->stats;
+    node_init(node, MPV_FORMAT_NODE_MAP, NULL);
+    talloc_steal(ta_parent, node->u.list);
+    if (!base)
+        return;
+
+    stats_global_enable(global);
+
+    pthread_mutex_lock(&base->lock);
+    for (int n = 0; n < base->num_list; n++) {
+        struct stats_ctx *ctx = base->list[n];
+        pthread_mutex_lock(&ctx->lock);
+        if (ctx->num_entries) {
+            // Instances with the same prefix share one map.
+            struct mpv_node *dst = NULL;
+            struct mpv_node_list *list = node->u.list;
+            for (int i = 0; i < list->num; i++) {
+                if (strcmp(list->keys[i], ctx->prefix) == 0)
+                    dst = &list->values[i];
+            }
+            if (!dst)
+                dst = node_map_add(node, ctx->prefix, MPV_FORMAT_NODE_MAP);
+            for (int i = 0; i < ctx->num_entries; i++)
+                add_entry_node(dst, ctx->entries[i]);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+    }
+    pthread_mutex_unlock(&base->lock);
+
+    struct mpv_node *mem = node_map_add(node, "memory", MPV_FORMAT_NODE_MAP);
+    for (int n = 0; n < MP_MEM_TYPE_COUNT; n++) {
+        struct mpv_node *ne = node_map_add(mem, mem_type_names[n],
+                                           MPV_FORMAT_NODE_MAP);
+        node_map_add_int64(ne, "value", atomic_load(&mem_usage[n]));
+    }
+}
+
+static void stats_ctx_destroy(void *p)
+{
+    struct stats_ctx *ctx = p;
+    struct stats_base *base = ctx->base;
+
+    pthread_mutex_destroy(&ctx->lock);
+    if (!base)
+        return;
+
+    pthread_mutex_lock(&base->lock);
+    for (int n = 0; n < base->num_list; n++) {
+        if (base->list[n] == ctx) {
+            MP_TARRAY_REMOVE_AT(base->list, base->num_list, n);
+            break;
+        }
+    }
+    bool free_it = base->dead && !base->num_list;
+    pthread_mutex_unlock(&base->lock);
+    if (free_it)
+        free_base(base);
+}
+
+// Create a context for recording stats. prefix identifies the component in
+// stats_global_query() output. The context is thread-safe. If global has no
+// stats (dummy mpv_global instances), the context silently records nothing.
+struct stats_ctx *stats_ctx_create(void *ta_parent, struct mpv_global *global,
+                                   const char *prefix)
+{
+    struct stats_base *base = global->stats;
+
+    struct stats_ctx *ctx = talloc_zero(ta_parent, struct stats_ctx);
+    ctx->base = base;
+    ctx->prefix = talloc_strdup(ctx, prefix);
+    pthread_mutex_init(&ctx->lock, NULL);
+    talloc_set_destructor(ctx, stats_ctx_destroy);
+
+    if (base) {
+        pthread_mutex_lock(&base->lock);
+        MP_TARRAY_APPEND(base, base->list, base->num_list, ctx);
+        ctx->track = base->num_tracks;
+        MP_TARRAY_APPEND(base, base->track_names, base->num_tracks,
+                         talloc_strdup(base, prefix));
+        pthread_mutex_unlock(&base->lock);
+    }
+
+    return ctx;
+}
+
+// Must be called with ctx->lock held.
+static struct stat_entry *find_entry(struct stats_ctx *ctx, const char *name)
+{
+    for (int n = 0; n < ctx->num_entries; n++) {
+        struct stat_entry *e = ctx->entries[n];
+        if (e->name == name || strcmp(e->name, name) == 0)
+            return e;
+    }
+
+    struct stat_entry *e = talloc_zero(ctx, struct stat_entry);
+    e->name = name;
+    MP_TARRAY_APPEND(ctx, ctx->entries, ctx->num_entries, e);
+    return e;
+}
+
+static bool is_active(struct stats_ctx *ctx)
+{
+    return ctx && ctx->base &&
+           atomic_load_explicit(&ctx->base->active, memory_order_relaxed);
+}
+
+static void add_trace(struct stats_ctx *ctx, const char *name, char ph,
+                      int64_t ts)
+{
+    struct stats_base *base = ctx->base;
+    if (!atomic_load_explicit(&base->tracing, memory_order_relaxed))
+        return;
+    pthread_mutex_lock(&base->trace_lock);
+    if (base->num_trace < TRACE_MAX_EVENTS) {
+        MP_TARRAY_APPEND(NULL, base->trace, base->num_trace,
+            (struct trace_event){ts, name, ctx->track, ph});
+    } else {
+        base->trace_dropped++;
+    }
+    pthread_mutex_unlock(&base->trace_lock);
+}
+
+void stats_event(struct stats_ctx *ctx, const char *name)
+{
+    if (!is_active(ctx))
+        return;
+    add_trace(ctx, name, 'i', mp_time_us());
+    pthread_mutex_lock(&ctx->lock);
+    find_entry(ctx, name)->count++;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+void stats_value(struct stats_ctx *ctx, const char *name, int64_t value)
+{
+    if (!is_active(ctx))
+        return;
+    pthread_mutex_lock(&ctx->lock);
+    struct stat_entry *e = find_entry(ctx, name);
+    e->value = value;
+    e->has_value = true;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+void stats_time_start(struct stats_ctx *ctx, const char *name)
+{
+    if (!is_active(ctx))
+        return;
+    int64_t now = mp_time_us();
+    add_trace(ctx, name, 'B', now);
+    pthread_mutex_lock(&ctx->lock);
+    find_entry(ctx, name)->time_start = now;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+// Must be called with ctx->lock held.
+static void add_time(struct stat_entry *e, int64_t t)
+{
+    e->time_min = e->time_count ? MPMIN(e->time_min, t) : t;
+    e->time_max = e->time_count ? MPMAX(e->time_max, t) : t;
+    e->time_sum += t;
+    e->time_count++;
+    int bucket = 0;
+    while (bucket < HIST_BUCKETS - 1 && t >= (INT64_C(1) << bucket))
+        bucket++;
+    e->hist[bucket]++;
+}
+
+void stats_time_end(struct stats_ctx *ctx, const char *name)
+{
+    if (!is_active(ctx))
+        return;
+    int64_t now = mp_time_us();
+    add_trace(ctx, name, 'E', now);
+    pthread_mutex_lock(&ctx->lock);
+    struct stat_entry *e = find_entry(ctx, name);
+    if (e->time_start) {
+        add_time(e, now - e->time_start);
+        e->time_start = 0;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+void stats_time_add(struct stats_ctx *ctx, const char *name, int64_t t)
+{
+    if (!is_active(ctx))
+        return;
+    pthread_mutex_lock(&ctx->lock);
+    add_time(find_entry(ctx, name), MPMAX(t, 0));
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+void mp_mem_account(enum mp_mem_type type, int64_t delta)
+{
+    assert(type >= 0 && type < MP_MEM_TYPE_COUNT);
+    atomic_fetch_add(&mem_usage[type], delta);
+}
+
+void mp_mem_query(struct mpv_node *dst)
+{
+    int64_t total = 0;
+    for (int n = 0; n < MP_MEM_TYPE_COUNT; n++) {
+        int64_t v = atomic_load(&mem_usage[n]);
+        node_map_add_int64(dst, mem_type_names[n], v);
+        total += v;
+    }
+    node_map_add_int64(dst, "total", total);
+}
@@ -0,0 +1,77 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MP_STATS_H_
+#define MP_STATS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct mpv_global;
+struct mpv_node;
+struct stats_ctx;
+
+void stats_global_init(struct mpv_global *global);
+void stats_global_uninit(struct mpv_global *global);
+void stats_global_enable(struct mpv_global *global);
+void stats_global_query(struct mpv_global *global, void *ta_parent,
+                        struct mpv_node *node);
+void stats_global_set_tracing(struct mpv_global *global, bool enable);
+void stats_global_write_trace(struct mpv_global *global, FILE *f,
+                              int *num_tracks);
+
+struct stats_ctx *stats_ctx_create(void *ta_parent, struct mpv_global *global,
+                                   const char *prefix);
+
+// Increment the counter for name. With tracing, this is an instant event.
+void stats_event(struct stats_ctx *ctx, const char *name);
+
+// Set the current value of a gauge (e.g. memory usage). Not traced.
+void stats_value(struct stats_ctx *ctx, const char *name, int64_t value);
+
+// Measure the time between the two calls, and add it to the name's latency
+// statistics. Calls for the same name must not be nested or interleaved from
+// multiple threads.
+void stats_time_start(struct stats_ctx *ctx, const char *name);
+void stats_time_end(struct stats_ctx *ctx, const char *name);
+
+// Add a time (in microseconds) measured by the caller to the name's latency
+// statistics. Unlike stats_time_start/end, this can be used for intervals that
+// start and end on different threads. Not traced.
+void stats_time_add(struct stats_ctx *ctx, const char *name, int64_t t);
+
+// Subsystems for memory accounting.
+enum mp_mem_type {
+    MP_MEM_DEMUX_CACHE,     // packets buffered by the demuxer
+    MP_MEM_STREAM_CACHE,    // stream cache ringbuffer and saved blocks
+    MP_MEM_IMAGE_POOLS,     // images owned by mp_image_pool
+    MP_MEM_GPU_TEXTURES,    // estimated size of ra textures
+    MP_MEM_SUBTITLES,       // packed subtitle bitmaps
+    MP_MEM_SCRIPTS,         // Lua/JavaScript heaps
+    MP_MEM_TYPE_COUNT
+};
+
+// Add delta bytes (can be negative) to the counter for type. The counters are
+// process-wide (shared by all mpv instances), always enabled, and cheap enough
+// to be called on every allocation. Thread-safe.
+void mp_mem_account(enum mp_mem_type type, int64_t delta);
+
+// Add the current counters to dst (a MPV_FORMAT_NODE_MAP) as name -> bytes.
+void mp_mem_query(struct mpv_node *dst);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <libavcodec/avcodec.h>
+
+#include "config.h"
+
+#include "osdep/io.h"
+#include "osdep/timer.h"
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "options/path.h"
+
+#include "cache.h"
+#include "packet.h"
+
+// Backing store for packet payloads of the demuxer back buffer. Packet data is
+// appended to an anonymous file, and the packet metadata remains in memory
+// (the packets stay in the demux_queue, with dp->is_cached set). The file is
+// append-only; space of pruned packets is not reused.
+struct demux_cache {
+    struct mp_log *log;
+    char *filename;     // only set if the file must be removed on close
+    FILE *f;
+    int64_t size;       // current end of file
+    int64_t max_size;
+};
+
+static void cache_destroy(void *ptr)
+{
+    struct demux_cache *cache = ptr;
+    if (cache->f)
+        fclose(cache->f);
+    if (cache->filename)
+        unlink(cache->filename);
+}
+
+static FILE *create_file(struct demux_cache *cache, const char *dir)
+{
+    for (int n = 0; n < 100; n++) {
+        char name[80];
+        snprintf(name, sizeof(name), "mpv-demux-cache-%lld-%d-%lld.tmp",
+                 (long long)getpid(), n, (long long)mp_time_us());
+        char *path = mp_path_join(cache, dir, name);
+        int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_BINARY, 0600);
+        if (fd < 0) {
+            talloc_free(path);
+            if (errno == EEXIST)
+                continue;
+            break;
+        }
+        FILE *f = fdopen(fd, "w+b");
+        if (!f) {
+            close(fd);
+            unlink(path);
+            talloc_free(path);
+            break;
+        }
+#if HAVE_POSIX
+        // Make sure the file disappears even if the player crashes.
+        unlink(path);
+        talloc_free(path);
+#else
+        cache->filename = path;
+#endif
+        return f;
+    }
+    return NULL;
+}
+
+struct demux_cache *demux_cache_create(void *ta_parent, struct mp_log *log,
+                                       const char *dir, int64_t max_size)
+{
+    struct demux_cache *cache = talloc_zero(ta_parent, struct demux_cache);
+    talloc_set_destructor(cache, cache_destroy);
+    cache->log = log;
+    cache->max_size = max_size;
+
+    cache->f = create_file(cache, dir);
+    if (!cache->f) {
+        mp_err(log, "Could not create demuxer cache file in '%s'.\n", dir);
+        talloc_free(cache);
+        return NULL;
+    }
+
+    mp_verbose(log, "Using demuxer cache file in '%s'.\n", dir);
+    return cache;
+}
+
+// Append the packet payload to the cache file, and free it from memory.
+// Packets with side data are not supported and are left alone. Returns false
+// if the packet was not written (this is not an error for the caller).
+bool demux_cache_write(struct demux_cache *cache, struct demux_packet *dp)
+{
+    if (dp->is_cached || !dp->avpacket || dp->avpacket->side_data_elems)
+        return false;
+
+    if (cache->size + dp->len > cache->max_size)
+        return false;
+
+    if (fseeko(cache->f, cache->size, SEEK_SET) ||
+        fwrite(dp->buffer, dp->len, 1, cache->f) != 1)
+    {
+        MP_ERR(cache, "Failed to write to demuxer cache file.\n");
+        // Give up on further writes.
+        cache->max_size = 0;
+        return false;
+    }
+
+    dp->is_cached = true;
+    dp->cached_pos = cache->size;
+    cache->size += dp->len;
+
+    av_packet_unref(dp->avpacket);
+    dp->buffer = NULL;
+    return true;
+}
+
+// Return a new packet with the contents of dp (which must have been written
+// with demux_cache_write()), or NULL on error.
+struct demux_packet *demux_cache_read(struct demux_cache *cache,
+                                      struct demux_packet *dp)
+{
+    assert(dp->is_cached);
+
+    struct demux_packet *new = new_demux_packet(dp->len);
+    if (!new)
+        return NULL;
+
+    // The writes go through the same FILE, so no flushing is needed.
+    if (fseeko(cache->f, dp->cached_pos, SEEK_SET) ||
+        fread(new->buffer, dp->len, 1, cache->f) != 1)
+    {
+        MP_ERR(cache, "Failed to read from demuxer cache file.\n");
+        talloc_free(new);
+        return NULL;
+    }
+
+    demux_packet_copy_attribs(new, dp);
+    return new;
+}
+
+int64_t demux_cache_get_size(struct demux_cache *cache)
+{
+    return cache->size;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct demux_packet;
+struct mp_log;
+
+struct demux_cache;
+
+struct demux_cache *demux_cache_create(void *ta_parent, struct mp_log *log,
+                                       const char *dir, int64_t max_size);
+bool demux_cache_write(struct demux_cache *cache, struct demux_packet *dp);
+struct demux_packet *demux_cache_read(struct demux_cache *cache,
+                                      struct demux_packet *dp);
+int64_t demux_cache_get_size(struct demux_cache *cache);
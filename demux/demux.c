@@ -31,12 +31,17 @@
 #include "config.h"
 #include "options/m_config.h"
 #include "options/m_option.h"
+#include "options/path.h"
 #include "mpv_talloc.h"
 #include "common/msg.h"
 #include "common/global.h"
+#include "common/stats.h"
+#include "misc/ctype.h"
 #include "osdep/threads.h"
+#include "osdep/timer.h"
 
 #include "stream/stream.h"
+#include "cache.h"
 #include "demux.h"
 #include "timeline.h"
 #include "stheader.h"
@@ -92,6 +97,8 @@ struct demux_opts {
     int access_references;
     int seekable_cache;
     int create_ccs;
+    char *cache_dir;
+    int cache_file_size;
 };
 
 #define OPT_BASE_STRUCT struct demux_opts
@@ -107,6 +114,8 @@ const struct m_sub_options demux_conf = {
         OPT_CHOICE("demuxer-seekable-cache", seekable_cache, 0,
                    ({"auto", -1}, {"no", 0}, {"yes", 1})),
         OPT_FLAG("sub-create-cc-track", create_ccs, 0),
+        OPT_STRING("demuxer-cache-dir", cache_dir, M_OPT_FILE),
+        OPT_INTRANGE("demuxer-cache-file-size", cache_file_size, 0, 0, INT_MAX),
         {0}
     },
     .size = sizeof(struct demux_opts),
@@ -117,11 +126,13 @@ const struct m_sub_options demux_conf = {
         .min_secs_cache = 10.0 * 60 * 60,
         .seekable_cache = -1,
         .access_references = 1,
+        .cache_file_size = 4 * 1024 * 1024, // 4 GB
     },
 };
 
 struct demux_internal {
     struct mp_log *log;
+    struct stats_ctx *stats;
 
     // The demuxer runs potentially in another thread, so we keep two demuxer
     // structs; the real demuxer can access the shadow struct only.
@@ -174,6 +185,13 @@ struct demux_internal {
     int seek_flags;             // flags for next seek (if seeking==true)
     double seek_pts;
 
+    // For network streams with a demuxer thread, this replaces the stream's
+    // cancel handle, so that a new seek can abort stream I/O (reads, or a
+    // low level seek) which it made useless. It's a slave of stream_cancel.
+    struct mp_cancel *seek_cancel;
+    struct mp_cancel *stream_cancel; // original demuxer->stream->cancel
+    bool thread_io;             // thread does I/O with the lock released
+
     // (fields for debugging)
     double seeking_in_progress; // low level seek state
     int low_level_seeks;        // number of started low level seeks
@@ -191,6 +209,9 @@ struct demux_internal {
     size_t total_bytes;         // total sum of packet data buffered
     size_t fw_bytes;            // sum of forward packet data in current_range
 
+    // If non-NULL, packet data behind the reader is moved to this file.
+    struct demux_cache *cache;
+
     // Range from which decoder is reading, and to which demuxer is appending.
     // This is never NULL. This is always ranges[num_ranges - 1].
     struct demux_cached_range *current_range;
@@ -201,6 +222,7 @@ struct demux_internal {
 
     // Cached state.
     bool force_cache_update;
+    int64_t last_cache_update;  // mp_time_us() of last update_cache()
     struct mp_tags *stream_metadata;
     struct stream_cache_info stream_cache_info;
     int64_t stream_size;
@@ -223,8 +245,6 @@ struct demux_cached_range {
     bool is_eof;            // set if the file ends with this range
 };
 
-#define MAX_INDEX_ENTRIES 16
-
 // A continuous list of cached packets for a single stream/range. There is one
 // for each stream and range. Also contains some state for use during demuxing
 // (keeping it across seeks makes it easier to resume demuxing).
@@ -234,6 +254,8 @@ struct demux_queue {
 
     struct demux_packet *head;
     struct demux_packet *tail;
+    size_t total_packs;     // number of packets in the list
+    size_t total_bytes;     // demux_packet_estimate_total_size() sum of them
 
     struct demux_packet *next_prune_target; // cached value for faster pruning
 
@@ -254,11 +276,15 @@ struct demux_queue {
     bool is_bof;            // started demuxing at beginning of file
     bool is_eof;            // received true EOF here
 
-    // incomplete index to somewhat speed up seek operations
-    // the entries in index[] must be in packet queue append/removal order
-    int num_index;          // valid index[] entries
-    double index_distance;  // minimum keyframe distance to add index element
-    struct demux_packet *index[MAX_INDEX_ENTRIES];
+    // keyframe index to speed up seek operations
+    // the entries in index[] must be in packet queue append/removal order, and
+    // are strictly sorted by kf_seek_pts (keyframes which would break this
+    // order are not added)
+    // index[index0] is the first valid entry; removed entries are compacted
+    // lazily, so removing the first entry is cheap
+    struct demux_packet **index;
+    int index0;             // first valid index[] entry
+    int num_index;          // index[] entries (including the removed ones)
 };
 
 struct demux_stream {
@@ -311,6 +337,9 @@ struct demux_stream {
 
 #define MP_ADD_PTS(a, b) ((a) == MP_NOPTS_VALUE ? (a) : ((a) + (b)))
 
+// Minimum time between stream state queries done while reading packets (in us).
+#define CACHE_UPDATE_INTERVAL (100 * 1000)
+
 static void demuxer_sort_chapters(demuxer_t *demuxer);
 static void *demux_thread(void *pctx);
 static void update_cache(struct demux_internal *in);
@@ -338,10 +367,12 @@ static void check_queue_consistency(struct demux_internal *in)
 
             size_t fw_bytes = 0;
             size_t fw_packs = 0;
+            size_t queue_bytes = 0;
+            size_t queue_packs = 0;
             bool is_forward = false;
             bool kf_found = false;
             bool npt_found = false;
-            int next_index = 0;
+            int next_index = queue->index0;
             for (struct demux_packet *dp = queue->head; dp; dp = dp->next) {
                 is_forward |= dp == queue->ds->reader_head;
                 kf_found |= dp == queue->keyframe_latest;
@@ -349,6 +380,8 @@ static void check_queue_consistency(struct demux_internal *in)
 
                 size_t bytes = demux_packet_estimate_total_size(dp);
                 total_bytes += bytes;
+                queue_bytes += bytes;
+                queue_packs += 1;
                 if (is_forward) {
                     fw_bytes += bytes;
                     fw_packs += 1;
@@ -365,7 +398,11 @@ static void check_queue_consistency(struct demux_internal *in)
             }
             if (!queue->head)
                 assert(!queue->tail);
+            assert(queue->total_bytes == queue_bytes);
+            assert(queue->total_packs == queue_packs);
             assert(next_index == queue->num_index);
+            for (int i = queue->index0 + 1; i < queue->num_index; i++)
+                assert(queue->index[i - 1]->kf_seek_pts < queue->index[i]->kf_seek_pts);
 
             // If the queue is currently used...
             if (queue->ds->queue == queue) {
@@ -481,6 +518,21 @@ static void update_seek_ranges(struct demux_cached_range *range)
         range->seek_start = range->seek_end = MP_NOPTS_VALUE;
 }
 
+static void remove_index_head(struct demux_queue *queue)
+{
+    queue->index0++;
+    if (queue->index0 == queue->num_index) {
+        queue->index0 = queue->num_index = 0;
+    } else if (queue->index0 >= 256 && queue->index0 >= queue->num_index / 2) {
+        // Compact the array; amortized O(1) per removed entry.
+        int num = queue->num_index - queue->index0;
+        memmove(queue->index, queue->index + queue->index0,
+                num * sizeof(queue->index[0]));
+        queue->index0 = 0;
+        queue->num_index = num;
+    }
+}
+
 // Remove queue->head from the queue. Does not update in->fw_bytes/in->fw_packs.
 static void remove_head_packet(struct demux_queue *queue)
 {
@@ -493,10 +545,14 @@ static void remove_head_packet(struct demux_queue *queue)
         queue->keyframe_latest = NULL;
     queue->is_bof = false;
 
-    queue->ds->in->total_bytes -= demux_packet_estimate_total_size(dp);
+    size_t bytes = demux_packet_estimate_total_size(dp);
+    queue->ds->in->total_bytes -= bytes;
+    queue->total_bytes -= bytes;
+    queue->total_packs -= 1;
+    mp_mem_account(MP_MEM_DEMUX_CACHE, -(int64_t)bytes);
 
-    if (queue->num_index && queue->index[0] == dp)
-        MP_TARRAY_REMOVE_AT(queue->index, queue->num_index, 0);
+    if (queue->index0 < queue->num_index && queue->index[queue->index0] == dp)
+        remove_index_head(queue);
 
     queue->head = dp->next;
     if (!queue->head)
@@ -513,18 +569,20 @@ static void clear_queue(struct demux_queue *queue)
     struct demux_packet *dp = queue->head;
     while (dp) {
         struct demux_packet *dn = dp->next;
-        in->total_bytes -= demux_packet_estimate_total_size(dp);
+        size_t bytes = demux_packet_estimate_total_size(dp);
+        in->total_bytes -= bytes;
+        mp_mem_account(MP_MEM_DEMUX_CACHE, -(int64_t)bytes);
         assert(ds->reader_head != dp);
         talloc_free(dp);
         dp = dn;
     }
     queue->head = queue->tail = NULL;
+    queue->total_bytes = queue->total_packs = 0;
     queue->next_prune_target = NULL;
     queue->keyframe_latest = NULL;
     queue->seek_start = queue->seek_end = queue->last_pruned = MP_NOPTS_VALUE;
 
-    queue->num_index = 0;
-    queue->index_distance = 1.0;
+    queue->index0 = queue->num_index = 0;
 
     queue->correct_dts = queue->correct_pos = true;
     queue->last_pos = -1;
@@ -838,6 +896,12 @@ void demux_start_thread(struct demuxer *demuxer)
     assert(demuxer == in->d_user);
 
     if (!in->threading) {
+        if (demuxer->is_network && demuxer->stream) {
+            in->stream_cancel = demuxer->stream->cancel;
+            in->seek_cancel = mp_cancel_new(in);
+            mp_cancel_set_parent(in->seek_cancel, in->stream_cancel);
+            demuxer->stream->cancel = in->seek_cancel;
+        }
         in->threading = true;
         if (pthread_create(&in->thread, NULL, demux_thread, in))
             in->threading = false;
@@ -858,6 +922,12 @@ void demux_stop_thread(struct demuxer *demuxer)
         in->threading = false;
         in->thread_terminate = false;
     }
+
+    if (in->seek_cancel) {
+        demuxer->stream->cancel = in->stream_cancel;
+        talloc_free(in->seek_cancel);
+        in->seek_cancel = NULL;
+    }
 }
 
 // The demuxer thread will call cb(ctx) if there's a new packet, or EOF is reached.
@@ -922,20 +992,64 @@ static void add_index_entry(struct demux_queue *queue, struct demux_packet *dp)
 {
     assert(dp->keyframe && dp->kf_seek_pts != MP_NOPTS_VALUE);
 
-    if (queue->num_index) {
+    if (queue->index0 < queue->num_index) {
         double prev = queue->index[queue->num_index - 1]->kf_seek_pts;
-        if (dp->kf_seek_pts < prev + queue->index_distance)
+        if (dp->kf_seek_pts <= prev)
             return;
     }
 
-    if (queue->num_index == MAX_INDEX_ENTRIES) {
-        for (int n = 0; n < MAX_INDEX_ENTRIES / 2; n++)
-            queue->index[n] = queue->index[n * 2];
-        queue->num_index = MAX_INDEX_ENTRIES / 2;
-        queue->index_distance *= 2;
+    MP_TARRAY_APPEND(queue, queue->index, queue->num_index, dp);
+}
+
+// Return whether a is before b in the stream (needs global_correct_dts/pos).
+static bool packet_is_before(struct demux_stream *ds, struct demux_packet *a,
+                             struct demux_packet *b)
+{
+    return ds->global_correct_dts ? a->dts < b->dts : a->pos < b->pos;
+}
+
+// Remove all packets from the start of q2 which are before end, except the
+// last keyframe in that region. Uses the keyframe index to find it with a
+// binary search, instead of comparing every packet.
+static void skip_to_join_point(struct demux_stream *ds, struct demux_queue *q2,
+                               struct demux_packet *end)
+{
+    int lo = q2->index0, hi = q2->num_index;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (packet_is_before(ds, q2->index[mid], end)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
+    if (lo == q2->index0)
+        return;
+
+    struct demux_packet *target = q2->index[lo - 1];
+    while (q2->head != target)
+        remove_head_packet(q2);
+}
 
-    queue->index[queue->num_index++] = dp;
+// Append the index entries of src to dst, which must be non-overlapping and
+// in packet order. Entries which would break the kf_seek_pts order are
+// skipped, like in add_index_entry().
+static void append_index(struct demux_queue *dst, struct demux_queue *src)
+{
+    int i = src->index0;
+    if (dst->index0 < dst->num_index) {
+        double prev = dst->index[dst->num_index - 1]->kf_seek_pts;
+        while (i < src->num_index && src->index[i]->kf_seek_pts <= prev)
+            i++;
+    }
+    int num = src->num_index - i;
+    if (num > 0) {
+        MP_TARRAY_GROW(dst, dst->index, dst->num_index + num);
+        memcpy(dst->index + dst->num_index, src->index + i,
+               num * sizeof(dst->index[0]));
+        dst->num_index += num;
+    }
+    src->index0 = src->num_index = 0;
 }
 
 // Check whether the next range in the list is, and if it appears to overlap,
@@ -988,6 +1102,8 @@ static void attempt_range_joining(struct demux_internal *in)
         struct demux_packet *end = q1->tail;
         bool join_point_found = !end; // no packets yet -> joining will work
         if (end) {
+            skip_to_join_point(ds, q2, end);
+
             while (q2->head) {
                 struct demux_packet *dp = q2->head;
 
@@ -1018,6 +1134,8 @@ static void attempt_range_joining(struct demux_internal *in)
                     // we'd remove it and use q2's packet, but the linked list
                     // makes this hard, so copy this missing metadata instead.
                     end->kf_seek_pts = dp->kf_seek_pts;
+                    if (end->keyframe && end->kf_seek_pts != MP_NOPTS_VALUE)
+                        add_index_entry(q1, end);
 
                     remove_head_packet(q2);
                     join_point_found = true;
@@ -1048,8 +1166,6 @@ static void attempt_range_joining(struct demux_internal *in)
     // Actually join the ranges. Now that we think it will work, mutate the
     // data associated with the current range.
 
-    in->fw_bytes = 0;
-
     for (int n = 0; n < in->num_streams; n++) {
         struct demux_queue *q1 = in->current_range->streams[n];
         struct demux_queue *q2 = next->streams[n];
@@ -1065,6 +1181,15 @@ static void attempt_range_joining(struct demux_internal *in)
             q1->tail = q2->tail;
         }
 
+        // All of q2 becomes forward buffer, unless the reader is not in q1.
+        if (ds->reader_head) {
+            ds->fw_packs += q2->total_packs;
+            ds->fw_bytes += q2->total_bytes;
+            in->fw_bytes += q2->total_bytes;
+        }
+        q1->total_packs += q2->total_packs;
+        q1->total_bytes += q2->total_bytes;
+
         q1->seek_end = q2->seek_end;
         q1->correct_dts &= q2->correct_dts;
         q1->correct_pos &= q2->correct_pos;
@@ -1077,15 +1202,11 @@ static void attempt_range_joining(struct demux_internal *in)
         q1->is_eof = q2->is_eof;
 
         q2->head = q2->tail = NULL;
+        q2->total_packs = q2->total_bytes = 0;
         q2->next_prune_target = NULL;
         q2->keyframe_latest = NULL;
 
-        for (int i = 0; i < q2->num_index; i++)
-            add_index_entry(q1, q2->index[i]);
-        q2->num_index = 0;
-
-        recompute_buffers(ds);
-        in->fw_bytes += ds->fw_bytes;
+        append_index(q1, q2);
 
         // For moving demuxer position.
         ds->refreshing = ds->selected;
@@ -1157,15 +1278,13 @@ static void adjust_seek_range_on_packet(struct demux_stream *ds,
         attempt_range_joining(ds->in);
 }
 
-void demux_add_packet(struct sh_stream *stream, demux_packet_t *dp)
+// Append the packet to the stream's queue (takes ownership of dp). Returns
+// whether the reader should be notified with the wakeup callback.
+// Must be called locked.
+static bool add_packet_locked(struct sh_stream *stream, demux_packet_t *dp)
 {
-    struct demux_stream *ds = stream ? stream->ds : NULL;
-    if (!dp || !dp->len || !ds) {
-        talloc_free(dp);
-        return;
-    }
+    struct demux_stream *ds = stream->ds;
     struct demux_internal *in = ds->in;
-    pthread_mutex_lock(&in->lock);
 
     in->initial_state = false;
 
@@ -1195,9 +1314,8 @@ void demux_add_packet(struct sh_stream *stream, demux_packet_t *dp)
     }
 
     if (drop) {
-        pthread_mutex_unlock(&in->lock);
         talloc_free(dp);
-        return;
+        return false;
     }
 
     queue->correct_pos &= dp->pos >= 0 && dp->pos > queue->last_pos;
@@ -1219,6 +1337,9 @@ void demux_add_packet(struct sh_stream *stream, demux_packet_t *dp)
 
     size_t bytes = demux_packet_estimate_total_size(dp);
     ds->in->total_bytes += bytes;
+    queue->total_bytes += bytes;
+    queue->total_packs += 1;
+    mp_mem_account(MP_MEM_DEMUX_CACHE, bytes);
     if (ds->reader_head) {
         ds->fw_packs++;
         ds->fw_bytes += bytes;
@@ -1274,8 +1395,49 @@ void demux_add_packet(struct sh_stream *stream, demux_packet_t *dp)
     }
 
     // Wake up if this was the first packet after start/possible underrun.
-    if (ds->in->wakeup_cb && ds->reader_head && !ds->reader_head->next)
-        ds->in->wakeup_cb(ds->in->wakeup_cb_ctx);
+    return ds->reader_head && !ds->reader_head->next;
+}
+
+void demux_add_packet(struct sh_stream *stream, demux_packet_t *dp)
+{
+    struct demux_stream *ds = stream ? stream->ds : NULL;
+    if (!dp || !dp->len || !ds) {
+        talloc_free(dp);
+        return;
+    }
+    struct demux_internal *in = ds->in;
+    pthread_mutex_lock(&in->lock);
+
+    if (add_packet_locked(stream, dp) && in->wakeup_cb)
+        in->wakeup_cb(in->wakeup_cb_ctx);
+    pthread_cond_signal(&in->wakeup);
+    pthread_mutex_unlock(&in->lock);
+}
+
+// Add multiple packets with a single lock operation and at most one wakeup.
+// dps[n]->stream must be set to the sh_stream.index of the stream the packet
+// belongs to. Otherwise, this is equivalent to calling demux_add_packet() on
+// each packet in order. Takes ownership of all packets.
+void demux_add_packets(struct demuxer *demuxer, struct demux_packet **dps,
+                       int num)
+{
+    struct demux_internal *in = demuxer->in;
+    bool wakeup = false;
+
+    pthread_mutex_lock(&in->lock);
+    for (int n = 0; n < num; n++) {
+        struct demux_packet *dp = dps[n];
+        if (!dp)
+            continue;
+        assert(dp->stream >= 0 && dp->stream < in->num_streams);
+        if (!dp->len) {
+            talloc_free(dp);
+            continue;
+        }
+        wakeup |= add_packet_locked(in->streams[dp->stream], dp);
+    }
+    if (wakeup && in->wakeup_cb)
+        in->wakeup_cb(in->wakeup_cb_ctx);
     pthread_cond_signal(&in->wakeup);
     pthread_mutex_unlock(&in->lock);
 }
@@ -1347,16 +1509,30 @@ static bool read_packet(struct demux_internal *in)
     // for disk or network I/O can take time.
     in->idle = false;
     in->initial_state = false;
+    in->thread_io = true;
+
+    // Querying the stream takes the stream cache's lock, and storing the result
+    // takes ours again, so don't do it for every packet. Explicit requests from
+    // the user thread (force_cache_update) are still served immediately.
+    bool query_cache = in->force_cache_update ||
+        mp_time_us() - in->last_cache_update >= CACHE_UPDATE_INTERVAL;
+    in->force_cache_update &= !query_cache;
+
     pthread_mutex_unlock(&in->lock);
 
     struct demuxer *demux = in->d_thread;
 
     bool eof = true;
-    if (demux->desc->fill_buffer && !demux_cancel_test(demux))
+    if (demux->desc->fill_buffer && !demux_cancel_test(demux)) {
+        stats_time_start(in->stats, "read-packet");
         eof = demux->desc->fill_buffer(demux) <= 0;
-    update_cache(in);
+        stats_time_end(in->stats, "read-packet");
+    }
+    if (query_cache || eof)
+        update_cache(in);
 
     pthread_mutex_lock(&in->lock);
+    in->thread_io = false;
 
     if (!in->seeking) {
         if (eof) {
@@ -1476,6 +1652,18 @@ static void execute_trackswitch(struct demux_internal *in)
     pthread_mutex_lock(&in->lock);
 }
 
+// Undo demux_seek() aborting superseded I/O. Called locked.
+static void reset_seek_cancel(struct demux_internal *in)
+{
+    if (!in->seek_cancel || !mp_cancel_test(in->seek_cancel) ||
+        mp_cancel_test(in->stream_cancel))
+        return;
+    mp_cancel_reset(in->seek_cancel);
+    // The real abort could have happened concurrently.
+    if (mp_cancel_test(in->stream_cancel))
+        mp_cancel_trigger(in->seek_cancel);
+}
+
 static void execute_seek(struct demux_internal *in)
 {
     int flags = in->seek_flags;
@@ -1485,6 +1673,9 @@ static void execute_seek(struct demux_internal *in)
     in->demux_ts = MP_NOPTS_VALUE;
     in->low_level_seeks += 1;
     in->initial_state = false;
+    in->thread_io = true;
+
+    reset_seek_cancel(in);
 
     pthread_mutex_unlock(&in->lock);
 
@@ -1497,6 +1688,7 @@ static void execute_seek(struct demux_internal *in)
 
     pthread_mutex_lock(&in->lock);
 
+    in->thread_io = false;
     in->seeking_in_progress = MP_NOPTS_VALUE;
 }
 
@@ -1535,6 +1727,7 @@ static void *demux_thread(void *pctx)
 {
     struct demux_internal *in = pctx;
     mpthread_set_name("demux");
+    mpthread_apply_opts(in->d_thread->global, in->log, "demux");
     pthread_mutex_lock(&in->lock);
     while (!in->thread_terminate) {
         if (thread_work(in))
@@ -1574,11 +1767,33 @@ static struct demux_packet *dequeue_packet(struct demux_stream *ds)
     ds->last_ret_dts = pkt->dts;
 
     // The returned packet is mutated etc. and will be owned by the user.
-    pkt = demux_copy_packet(pkt);
-    if (!pkt)
-        abort();
+    struct demux_packet *queued = pkt;
+    if (queued->is_cached) {
+        pkt = demux_cache_read(ds->in->cache, queued);
+        if (!pkt) {
+            MP_ERR(ds->in, "Lost packet in stream %d.\n", ds->index);
+            return NULL;
+        }
+    } else {
+        pkt = demux_copy_packet(queued);
+        if (!pkt)
+            abort();
+    }
     pkt->next = NULL;
 
+    // The queued packet is now part of the back buffer.
+    if (ds->in->cache) {
+        size_t bytes_prev = demux_packet_estimate_total_size(queued);
+        if (demux_cache_write(ds->in->cache, queued)) {
+            size_t bytes = demux_packet_estimate_total_size(queued);
+            ds->in->total_bytes -= bytes_prev;
+            ds->in->total_bytes += bytes;
+            ds->queue->total_bytes -= bytes_prev;
+            ds->queue->total_bytes += bytes;
+            mp_mem_account(MP_MEM_DEMUX_CACHE, (int64_t)bytes - bytes_prev);
+        }
+    }
+
     double ts = PTS_OR_DEF(pkt->dts, pkt->pts);
     if (ts != MP_NOPTS_VALUE)
         ds->base_ts = ts;
@@ -2051,6 +2266,7 @@ static struct demuxer *open_given_type(struct mpv_global *global,
     struct demux_internal *in = demuxer->in = talloc_ptrtype(demuxer, in);
     *in = (struct demux_internal){
         .log = demuxer->log,
+        .stats = stats_ctx_create(demuxer, demuxer->global, "demux"),
         .d_thread = talloc(demuxer, struct demuxer),
         .d_buffer = talloc(demuxer, struct demuxer),
         .d_user = demuxer,
@@ -2065,6 +2281,8 @@ static struct demuxer *open_given_type(struct mpv_global *global,
     pthread_mutex_init(&in->lock, NULL);
     pthread_cond_init(&in->wakeup, NULL);
 
+    demuxer->packet_pool = demux_packet_pool_create(demuxer);
+
     in->current_range = talloc_ptrtype(in, in->current_range);
     *in->current_range = (struct demux_cached_range){
         .seek_start = MP_NOPTS_VALUE,
@@ -2120,6 +2338,12 @@ static struct demuxer *open_given_type(struct mpv_global *global,
                 seekable = 1;
         }
         in->seekable_cache = seekable == 1;
+        if (in->seekable_cache && opts->cache_dir && opts->cache_dir[0]) {
+            char *dir = mp_get_user_path(NULL, global, opts->cache_dir);
+            in->cache = demux_cache_create(in, in->log, dir,
+                                           opts->cache_file_size * 1024LL);
+            talloc_free(dir);
+        }
         if (!(params && params->disable_timeline)) {
             struct timeline *tl = timeline_load(global, log, demuxer);
             if (tl) {
@@ -2147,6 +2371,78 @@ static const int d_request[] = {DEMUX_CHECK_REQUEST, -1};
 static const int d_force[]   = {DEMUX_CHECK_FORCE, -1};
 
 // params can be NULL
+// Remembers which demuxer opened the last file with a given file extension (or
+// MIME type, if there is no extension). The next file with the same key tries
+// that demuxer first, which skips the failing probes of the demuxers listed
+// before it. Only used for normal probing; forced demuxers bypass it.
+#define PROBE_CACHE_SIZE 16
+
+struct probe_cache_entry {
+    char key[40];
+    const struct demuxer_desc *desc;
+};
+
+static pthread_mutex_t probe_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct probe_cache_entry probe_cache[PROBE_CACHE_SIZE];
+static int probe_cache_next;
+
+static bool get_probe_key(struct stream *stream, char *key, size_t size)
+{
+    bstr path = bstr0(stream->url);
+    // Ignore query/fragment of network URLs ("file.mkv?token=...").
+    if (stream->is_network) {
+        int q = bstrcspn(path, "?#");
+        path = bstr_splice(path, 0, q);
+    }
+    int slash = bstrrchr(path, '/');
+    int dot = bstrrchr(path, '.');
+    if (dot >= 0 && dot > slash) {
+        bstr ext = bstr_cut(path, dot + 1);
+        if (ext.len > 0 && ext.len <= 10) {
+            snprintf(key, size, "ext:%.*s", BSTR_P(ext));
+            for (char *c = key; *c; c++)
+                *c = mp_tolower(*c);
+            return true;
+        }
+    }
+    if (stream->mime_type && stream->mime_type[0]) {
+        snprintf(key, size, "mime:%s", stream->mime_type);
+        return true;
+    }
+    return false;
+}
+
+static const struct demuxer_desc *probe_cache_get(const char *key)
+{
+    const struct demuxer_desc *desc = NULL;
+    pthread_mutex_lock(&probe_cache_lock);
+    for (int n = 0; n < PROBE_CACHE_SIZE; n++) {
+        if (probe_cache[n].desc && strcmp(probe_cache[n].key, key) == 0) {
+            desc = probe_cache[n].desc;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&probe_cache_lock);
+    return desc;
+}
+
+static void probe_cache_set(const char *key, const struct demuxer_desc *desc)
+{
+    pthread_mutex_lock(&probe_cache_lock);
+    struct probe_cache_entry *e = NULL;
+    for (int n = 0; n < PROBE_CACHE_SIZE; n++) {
+        if (probe_cache[n].desc && strcmp(probe_cache[n].key, key) == 0)
+            e = &probe_cache[n];
+    }
+    if (!e) {
+        e = &probe_cache[probe_cache_next];
+        probe_cache_next = (probe_cache_next + 1) % PROBE_CACHE_SIZE;
+        snprintf(e->key, sizeof(e->key), "%s", key);
+    }
+    e->desc = desc;
+    pthread_mutex_unlock(&probe_cache_lock);
+}
+
 struct demuxer *demux_open(struct stream *stream, struct demuxer_params *params,
                            struct mpv_global *global)
 {
@@ -2175,15 +2471,34 @@ struct demuxer *demux_open(struct stream *stream, struct demuxer_params *params,
         }
     }
 
+    char key[40];
+    bool use_cache = !check_desc && get_probe_key(stream, key, sizeof(key));
+    const struct demuxer_desc *hint = use_cache ? probe_cache_get(key) : NULL;
+    if (hint) {
+        mp_verbose(log, "Trying demuxer %s first (last match for %s).\n",
+                   hint->name, key);
+        demuxer = open_given_type(global, log, hint, stream, params,
+                                  DEMUX_CHECK_NORMAL);
+        if (demuxer) {
+            talloc_steal(demuxer, log);
+            log = NULL;
+            goto done;
+        }
+    }
+
     // Test demuxers from first to last, one pass for each check_levels[] entry
     for (int pass = 0; check_levels[pass] != -1; pass++) {
         enum demux_check level = check_levels[pass];
         mp_verbose(log, "Trying demuxers for level=%s.\n", d_level(level));
         for (int n = 0; demuxer_list[n]; n++) {
             const struct demuxer_desc *desc = demuxer_list[n];
+            if (desc == hint && level == DEMUX_CHECK_NORMAL)
+                continue; // already tried above
             if (!check_desc || desc == check_desc) {
                 demuxer = open_given_type(global, log, desc, stream, params, level);
                 if (demuxer) {
+                    if (use_cache && level == DEMUX_CHECK_NORMAL)
+                        probe_cache_set(key, desc);
                     talloc_steal(demuxer, log);
                     log = NULL;
                     goto done;
@@ -2297,12 +2612,19 @@ static void switch_current_range(struct demux_internal *in,
 static struct demux_packet *find_seek_target(struct demux_queue *queue,
                                              double pts, int flags)
 {
+    // Binary search for the last index entry with kf_seek_pts <= pts.
     struct demux_packet *start = queue->head;
-    for (int n = 0; n < queue->num_index; n++) {
-        if (queue->index[n]->kf_seek_pts > pts)
-            break;
-        start = queue->index[n];
+    int lo = queue->index0, hi = queue->num_index;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (queue->index[mid]->kf_seek_pts > pts) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
     }
+    if (lo > queue->index0)
+        start = queue->index[lo - 1];
 
     struct demux_packet *target = NULL;
     double target_diff = MP_NOPTS_VALUE;
@@ -2513,6 +2835,13 @@ int demux_seek(demuxer_t *demuxer, double seek_pts, int flags)
         in->seeking = true;
         in->seek_flags = flags;
         in->seek_pts = seek_pts;
+
+        // Whatever the thread is reading or seeking to right now will be
+        // discarded, so don't wait for the network to finish it.
+        if (in->thread_io && in->seek_cancel) {
+            MP_VERBOSE(in, "aborting superseded I/O\n");
+            mp_cancel_trigger(in->seek_cancel);
+        }
     }
 
     if (!in->threading && in->seeking)
@@ -2670,15 +2999,38 @@ int demuxer_add_attachment(demuxer_t *demuxer, char *name, char *type,
                                               struct demux_attachment,
                                               demuxer->num_attachments + 32);
 
+    struct demux_packet *dp = new_demux_packet_from(data, data_size);
+    if (!dp)
+        return -1;
+
     struct demux_attachment *att = &demuxer->attachments[demuxer->num_attachments];
     att->name = talloc_strdup(demuxer->attachments, name);
     att->type = talloc_strdup(demuxer->attachments, type);
-    att->data = talloc_memdup(demuxer->attachments, data, data_size);
-    att->data_size = data_size;
+    att->packet = talloc_steal(demuxer->attachments, dp);
+    att->data = dp->buffer;
+    att->data_size = dp->len;
 
     return demuxer->num_attachments++;
 }
 
+// Make dst a copy of src, allocated as children of ta_parent. The data itself
+// is not copied, but referenced; it stays valid until ta_parent is freed, even
+// if the demuxer is destroyed before that.
+void demux_copy_attachment(void *ta_parent, struct demux_attachment *dst,
+                           struct demux_attachment *src)
+{
+    *dst = (struct demux_attachment){
+        .name = talloc_strdup(ta_parent, src->name),
+        .type = talloc_strdup(ta_parent, src->type),
+    };
+    if (src->packet)
+        dst->packet = talloc_steal(ta_parent, demux_copy_packet(src->packet));
+    if (dst->packet) {
+        dst->data = dst->packet->buffer;
+        dst->data_size = dst->packet->len;
+    }
+}
+
 static int chapter_compare(const void *p1, const void *p2)
 {
     struct demux_chapter *c1 = (void *)p1;
@@ -2757,6 +3109,7 @@ static void update_cache(struct demux_internal *in)
     stream_control(stream, STREAM_CTRL_GET_CACHE_INFO, &stream_cache_info);
 
     pthread_mutex_lock(&in->lock);
+    in->last_cache_update = mp_time_us();
     in->stream_size = stream_size;
     in->stream_cache_info = stream_cache_info;
     if (stream_metadata) {
@@ -2828,10 +3181,12 @@ static int cached_demux_control(struct demux_internal *in, int cmd, void *arg)
             .ts_duration = -1,
             .total_bytes = in->total_bytes,
             .fw_bytes = in->fw_bytes,
+            .file_cache_bytes = in->cache ? demux_cache_get_size(in->cache) : -1,
             .seeking = in->seeking_in_progress,
             .low_level_seeks = in->low_level_seeks,
             .ts_last = in->demux_ts,
         };
+        demux_packet_pool_get_stats(in->d_user->packet_pool, &r->packet_pool);
         bool any_packets = false;
         for (int n = 0; n < in->num_streams; n++) {
             struct demux_stream *ds = in->streams[n]->ds;
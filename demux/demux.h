@@ -53,6 +53,8 @@ struct demux_ctrl_reader_state {
     double ts_end; // approx. timestamp of end of buffered range
     int64_t total_bytes;
     int64_t fw_bytes;
+    int64_t file_cache_bytes; // size of --demuxer-cache-dir file, or -1
+    struct demux_packet_pool_stats packet_pool;
     double seeking; // current low level seek target, or NOPTS
     int low_level_seeks; // number of started low level seeks
     double ts_last; // approx. timestamp of demuxer position
@@ -164,6 +166,9 @@ typedef struct demux_attachment
     char *type;
     void *data;
     unsigned int data_size;
+    // Refcounted owner of data. Copies made with demux_copy_attachment() share
+    // it instead of duplicating the data (font attachments can be large).
+    struct demux_packet *packet;
 } demux_attachment_t;
 
 struct demuxer_params {
@@ -224,6 +229,9 @@ typedef struct demuxer {
     struct mp_tags *metadata;
 
     void *priv;   // demuxer-specific internal data
+    // Demuxer implementations can use this with new_demux_packet_pooled() to
+    // recycle packet buffers. Can be used on the demuxer thread only.
+    struct demux_packet_pool *packet_pool;
     struct mpv_global *global;
     struct mp_log *log, *glog;
     struct demuxer_params *params;
@@ -249,6 +257,8 @@ void free_demuxer(struct demuxer *demuxer);
 void free_demuxer_and_stream(struct demuxer *demuxer);
 
 void demux_add_packet(struct sh_stream *stream, demux_packet_t *dp);
+void demux_add_packets(struct demuxer *demuxer, struct demux_packet **dps,
+                       int num);
 void demuxer_feed_caption(struct sh_stream *stream, demux_packet_t *dp);
 
 struct demux_packet *demux_read_packet(struct sh_stream *sh);
@@ -292,6 +302,8 @@ void demux_set_stream_autoselect(struct demuxer *demuxer, bool autoselect);
 
 void demuxer_help(struct mp_log *log);
 
+void demux_copy_attachment(void *ta_parent, struct demux_attachment *dst,
+                           struct demux_attachment *src);
 int demuxer_add_attachment(struct demuxer *demuxer, char *name,
                            char *type, void *data, size_t data_size);
 int demuxer_add_chapter(demuxer_t *demuxer, char *name,
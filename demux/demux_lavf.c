@@ -24,6 +24,10 @@
 #include <strings.h>
 #include <errno.h>
 #include <assert.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "config.h"
 
@@ -37,6 +41,8 @@
 #include <libavutil/display.h>
 #include <libavutil/opt.h>
 
+#include "osdep/io.h"
+
 #include "common/msg.h"
 #include "common/tags.h"
 #include "common/av_common.h"
@@ -73,6 +79,7 @@ struct demux_lavf_opts {
     int genptsmode;
     char *sub_cp;
     int rtsp_transport;
+    int hls_prefetch;
 };
 
 const struct m_sub_options demux_lavf_conf = {
@@ -98,6 +105,7 @@ const struct m_sub_options demux_lavf_conf = {
                 {"udp", 1},
                 {"tcp", 2},
                 {"http", 3})),
+        OPT_FLAG("hls-prefetch", hls_prefetch, 0),
         {0}
     },
     .size = sizeof(struct demux_lavf_opts),
@@ -111,6 +119,7 @@ const struct m_sub_options demux_lavf_conf = {
         .probescore = AVPROBE_SCORE_MAX/4 + 1,
         .sub_cp = "auto",
         .rtsp_transport = 2,
+        .hls_prefetch = 1,
     },
 };
 
@@ -316,19 +325,156 @@ static void list_formats(struct demuxer *demuxer)
         MP_INFO(demuxer, "%15s : %s\n", fmt->name, fmt->long_name);
 }
 
+// Remembers the detected charset of recently opened local subtitle files, so
+// that reloading them (or probing the same autoloaded candidates again) skips
+// reading the whole file for detection. Entries are only valid as long as
+// path, size and mtime match.
+#define CHARSET_CACHE_SIZE 16
+
+struct charset_cache_entry {
+    char *path;
+    char *user_cp;
+    int64_t size;
+    time_t mtime;
+    char cp[64];
+};
+
+static pthread_mutex_t charset_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct charset_cache_entry charset_cache[CHARSET_CACHE_SIZE];
+static int charset_cache_next;
+
+static struct charset_cache_entry *charset_cache_find(const char *path,
+                                                      const char *user_cp)
+{
+    for (int n = 0; n < CHARSET_CACHE_SIZE; n++) {
+        struct charset_cache_entry *e = &charset_cache[n];
+        if (e->path && strcmp(e->path, path) == 0 &&
+            strcmp(e->user_cp, user_cp) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static bool charset_cache_get(struct stat *st, const char *path,
+                              const char *user_cp, char *cp, size_t cp_size)
+{
+    bool found = false;
+    pthread_mutex_lock(&charset_cache_lock);
+    struct charset_cache_entry *e = charset_cache_find(path, user_cp);
+    if (e && e->size == st->st_size && e->mtime == st->st_mtime) {
+        snprintf(cp, cp_size, "%s", e->cp);
+        found = true;
+    }
+    pthread_mutex_unlock(&charset_cache_lock);
+    return found;
+}
+
+static void charset_cache_set(struct stat *st, const char *path,
+                              const char *user_cp, const char *cp)
+{
+    if (strlen(cp) >= sizeof(charset_cache[0].cp))
+        return;
+    pthread_mutex_lock(&charset_cache_lock);
+    struct charset_cache_entry *e = charset_cache_find(path, user_cp);
+    if (!e) {
+        e = &charset_cache[charset_cache_next];
+        charset_cache_next = (charset_cache_next + 1) % CHARSET_CACHE_SIZE;
+        talloc_free(e->path);
+        talloc_free(e->user_cp);
+        e->path = talloc_strdup(NULL, path);
+        e->user_cp = talloc_strdup(NULL, user_cp);
+    }
+    e->size = st->st_size;
+    e->mtime = st->st_mtime;
+    snprintf(e->cp, sizeof(e->cp), "%s", cp);
+    pthread_mutex_unlock(&charset_cache_lock);
+}
+
+// Convert the rest of the stream in chunks, without first reading all of the
+// input into memory. Returns .start==NULL on failure.
+static bstr convert_charset_stream(struct demuxer *demuxer,
+                                   struct mp_iconv *ic, int max_size)
+{
+    lavf_priv_t *priv = demuxer->priv;
+    void *tmp = talloc_new(NULL);
+    bstr res = {0};
+
+    bstr out = {0};
+    char *buf = talloc_size(tmp, 64 * 1024);
+    size_t left = 0;
+    while (1) {
+        int len = stream_read(priv->stream, buf + left, 64 * 1024 - left);
+        bstr in = {buf, left + len};
+        if (!mp_iconv_convert(ic, tmp, &out, &in, len <= 0) ||
+            out.len > (size_t)max_size)
+        {
+            talloc_free(out.start);
+            goto done;
+        }
+        if (len <= 0)
+            break;
+        left = in.len;
+        memmove(buf, in.start, left);
+    }
+    res = out;
+    talloc_steal(NULL, res.start);
+
+done:
+    talloc_free(tmp);
+    return res;
+}
+
 static void convert_charset(struct demuxer *demuxer)
 {
     lavf_priv_t *priv = demuxer->priv;
     char *cp = priv->opts->sub_cp;
     if (!cp || mp_charset_is_utf8(cp))
         return;
-    bstr data = stream_read_complete(priv->stream, NULL, 128 * 1024 * 1024);
+    const int max_size = 128 * 1024 * 1024;
+
+    char *user_cp = cp;
+    char cached_cp[64];
+    struct stat st;
+    bool use_cache = priv->stream->is_local_file &&
+                     stat(priv->stream->path, &st) == 0;
+    if (use_cache && charset_cache_get(&st, priv->stream->path, user_cp,
+                                       cached_cp, sizeof(cached_cp)))
+    {
+        cp = cached_cp;
+        MP_VERBOSE(demuxer, "Using cached subtitle charset '%s'.\n", cp);
+        if (mp_charset_is_utf8(cp) || mp_charset_is_utf16(cp))
+            return;
+        // Only real iconv codepages can be converted chunk-wise.
+        struct mp_iconv *ic = mp_iconv_create(NULL, demuxer->log, cp,
+                                              MP_ICONV_VERBOSE);
+        if (ic) {
+            int64_t start = stream_tell(priv->stream);
+            bstr conv = convert_charset_stream(demuxer, ic, max_size);
+            talloc_free(ic);
+            if (conv.start) {
+                MP_INFO(demuxer, "Using subtitle charset: %s\n", cp);
+                priv->stream = open_memory_stream_ref(conv.start, conv.len);
+                talloc_steal(priv->stream, conv.start);
+                priv->own_stream = true;
+                return;
+            }
+            // Retry with detection (the file might have been modified within
+            // the mtime granularity).
+            if (!stream_seek(priv->stream, start))
+                return;
+        }
+        cp = user_cp;
+    }
+
+    bstr data = stream_read_complete(priv->stream, NULL, max_size);
     if (!data.start) {
         MP_WARN(demuxer, "File too big (or error reading) - skip charset probing.\n");
         return;
     }
     void *alloc = data.start;
     cp = (char *)mp_charset_guess(priv, demuxer->log, data, cp, 0);
+    if (use_cache && cp)
+        charset_cache_set(&st, priv->stream->path, user_cp, cp);
     if (cp && !mp_charset_is_utf8(cp))
         MP_INFO(demuxer, "Using subtitle charset: %s\n", cp);
     // libavformat transparently converts UTF-16 to UTF-8
@@ -340,10 +486,12 @@ static void convert_charset(struct demuxer *demuxer)
             data = conv;
     }
     if (data.start) {
-        priv->stream = open_memory_stream(data.start, data.len);
+        priv->stream = open_memory_stream_ref(data.start, data.len);
+        talloc_steal(priv->stream, alloc);
         priv->own_stream = true;
+    } else {
+        talloc_free(alloc);
     }
-    talloc_free(alloc);
 }
 
 static char *remove_prefix(char *s, const char *const *prefixes)
@@ -858,6 +1006,14 @@ static int demux_open_lavf(demuxer_t *demuxer, enum demux_check check)
             av_dict_set(&dopts, "rtsp_transport", transport, 0);
     }
 
+    // Reuse the HTTP connection for segments, and start downloading the next
+    // segment while the current one is still being read. (Older FFmpeg
+    // versions ignore these.)
+    if (matches_avinputformat_name(priv, "hls") && lavfdopts->hls_prefetch) {
+        av_dict_set(&dopts, "http_persistent", "1", 0);
+        av_dict_set(&dopts, "http_multiple", "1", 0);
+    }
+
     guess_and_set_vobsub_name(demuxer, &dopts);
 
     if (priv->format_hack.fix_editlists)
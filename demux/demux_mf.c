@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <strings.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
@@ -30,6 +31,7 @@
 #include "options/m_config.h"
 #include "options/path.h"
 #include "misc/ctype.h"
+#include "misc/thread_pool.h"
 
 #include "stream/stream.h"
 #include "demux.h"
@@ -38,14 +40,32 @@
 
 #define MF_MAX_FILE_SIZE (1024 * 1024 * 256)
 
+#define MF_MAX_PREFETCH_THREADS 8
+
+struct mf_job {
+    struct mf *mf;
+    int frame;          // -1 if unused
+    bool busy;          // queued on the thread pool (owned by the worker)
+    bstr data;          // file contents, if !busy
+};
+
 typedef struct mf {
     struct mp_log *log;
+    struct mpv_global *global;
     struct sh_stream *sh;
     int curr_frame;
     int nr_of_files;
     char **names;
     // optional
     struct stream **streams;
+
+    // Files are read ahead in parallel if pool is set. The job for frame n
+    // is jobs[n % num_jobs].
+    struct mp_thread_pool *pool;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    struct mf_job *jobs;
+    int num_jobs;
 } mf_t;
 
 
@@ -173,6 +193,69 @@ static void demux_seek_mf(demuxer_t *demuxer, double seek_pts, int flags)
     mf->curr_frame = newpos;
 }
 
+static bstr read_file(struct mpv_global *global, const char *filename)
+{
+    bstr data = {0};
+    struct stream *stream = filename ? stream_open(filename, global) : NULL;
+    if (stream) {
+        data = stream_read_complete(stream, NULL, MF_MAX_FILE_SIZE);
+        free_stream(stream);
+    }
+    return data;
+}
+
+static void prefetch_fn(void *ctx)
+{
+    struct mf_job *job = ctx;
+    struct mf *mf = job->mf;
+
+    bstr data = read_file(mf->global, mf->names[job->frame]);
+
+    pthread_mutex_lock(&mf->lock);
+    job->data = data;
+    job->busy = false;
+    pthread_cond_broadcast(&mf->wakeup);
+    pthread_mutex_unlock(&mf->lock);
+}
+
+// Queue reading the files for the next num_jobs frames. Slots still busy
+// with a frame from before a seek are skipped, and requeued on the next call.
+// Called with mf->lock held.
+static void queue_prefetch(struct mf *mf)
+{
+    int end = MPMIN(mf->curr_frame + mf->num_jobs, mf->nr_of_files);
+    for (int n = mf->curr_frame; n < end; n++) {
+        struct mf_job *job = &mf->jobs[n % mf->num_jobs];
+        if (job->frame == n || job->busy)
+            continue;
+        talloc_free(job->data.start);
+        job->data = (bstr){0};
+        job->frame = n;
+        job->busy = true;
+        mp_thread_pool_queue(mf->pool, prefetch_fn, job);
+    }
+}
+
+static bstr get_prefetched(struct mf *mf)
+{
+    struct mf_job *job = &mf->jobs[mf->curr_frame % mf->num_jobs];
+
+    pthread_mutex_lock(&mf->lock);
+    while (1) {
+        queue_prefetch(mf);
+        if (job->frame == mf->curr_frame && !job->busy)
+            break;
+        pthread_cond_wait(&mf->wakeup, &mf->lock);
+    }
+    bstr data = job->data;
+    job->data = (bstr){0};
+    job->frame = -1;
+    queue_prefetch(mf);
+    pthread_mutex_unlock(&mf->lock);
+
+    return data;
+}
+
 // return value:
 //     0 = EOF or no stream found
 //     1 = successfully read a packet
@@ -182,38 +265,63 @@ static int demux_mf_fill_buffer(demuxer_t *demuxer)
     if (mf->curr_frame >= mf->nr_of_files)
         return 0;
 
-    struct stream *entry_stream = NULL;
-    if (mf->streams)
-        entry_stream = mf->streams[mf->curr_frame];
-    struct stream *stream = entry_stream;
-    if (!stream) {
-        char *filename = mf->names[mf->curr_frame];
-        if (filename)
-            stream = stream_open(filename, demuxer->global);
+    bstr data = {0};
+    if (mf->streams) {
+        struct stream *stream = mf->streams[mf->curr_frame];
+        stream_seek(stream, 0);
+        data = stream_read_complete(stream, NULL, MF_MAX_FILE_SIZE);
+    } else if (mf->pool) {
+        data = get_prefetched(mf);
+    } else {
+        data = read_file(demuxer->global, mf->names[mf->curr_frame]);
     }
 
-    if (stream) {
-        stream_seek(stream, 0);
-        bstr data = stream_read_complete(stream, NULL, MF_MAX_FILE_SIZE);
-        if (data.len) {
-            demux_packet_t *dp = new_demux_packet(data.len);
-            if (dp) {
-                memcpy(dp->buffer, data.start, data.len);
-                dp->pts = mf->curr_frame / mf->sh->codec->fps;
-                dp->keyframe = true;
-                demux_add_packet(mf->sh, dp);
-            }
+    if (data.len) {
+        demux_packet_t *dp = new_demux_packet(data.len);
+        if (dp) {
+            memcpy(dp->buffer, data.start, data.len);
+            dp->pts = mf->curr_frame / mf->sh->codec->fps;
+            dp->keyframe = true;
+            demux_add_packet(mf->sh, dp);
         }
-        talloc_free(data.start);
     }
-
-    if (stream && stream != entry_stream)
-        free_stream(stream);
+    talloc_free(data.start);
 
     mf->curr_frame++;
     return 1;
 }
 
+static void init_prefetch(struct mf *mf, int frames)
+{
+    if (frames < 2 || mf->streams || mf->nr_of_files < 2)
+        return;
+
+    mf->pool = mp_thread_pool_create(mf, MPMIN(frames, MF_MAX_PREFETCH_THREADS));
+    if (!mf->pool) {
+        MP_WARN(mf, "could not create prefetch threads\n");
+        return;
+    }
+    pthread_mutex_init(&mf->lock, NULL);
+    pthread_cond_init(&mf->wakeup, NULL);
+    mf->num_jobs = frames;
+    mf->jobs = talloc_zero_array(mf, struct mf_job, frames);
+    for (int n = 0; n < frames; n++)
+        mf->jobs[n] = (struct mf_job){ .mf = mf, .frame = -1 };
+}
+
+static void uninit_prefetch(struct mf *mf)
+{
+    if (!mf->pool)
+        return;
+    // Waits for all queued jobs.
+    talloc_free(mf->pool);
+    mf->pool = NULL;
+    for (int n = 0; n < mf->num_jobs; n++)
+        talloc_free(mf->jobs[n].data.start);
+    pthread_cond_destroy(&mf->wakeup);
+    pthread_mutex_destroy(&mf->lock);
+}
+
 // map file extension/type to a codec name
 
 static const struct {
@@ -308,8 +416,11 @@ static int demux_open_mf(demuxer_t *demuxer, enum demux_check check)
 
     double mf_fps;
     char *mf_type;
+    int mf_prefetch;
     mp_read_option_raw(demuxer->global, "mf-fps", &m_option_type_double, &mf_fps);
     mp_read_option_raw(demuxer->global, "mf-type", &m_option_type_string, &mf_type);
+    mp_read_option_raw(demuxer->global, "mf-prefetch", &m_option_type_int,
+                       &mf_prefetch);
 
     const char *codec = mp_map_mimetype_to_video_codec(demuxer->stream->mime_type);
     if (!codec || (mf_type && mf_type[0]))
@@ -319,6 +430,7 @@ static int demux_open_mf(demuxer_t *demuxer, enum demux_check check)
         goto error;
 
     mf->curr_frame = 0;
+    mf->global = demuxer->global;
 
     // create a new video stream header
     struct sh_stream *sh = demux_alloc_sh_stream(STREAM_VIDEO);
@@ -337,6 +449,8 @@ static int demux_open_mf(demuxer_t *demuxer, enum demux_check check)
     demuxer->seekable = true;
     demuxer->duration = mf->nr_of_files / mf->sh->codec->fps;
 
+    init_prefetch(mf, mf_prefetch);
+
     return 0;
 
 error:
@@ -345,6 +459,9 @@ error:
 
 static void demux_close_mf(demuxer_t *demuxer)
 {
+    mf_t *mf = demuxer->priv;
+    if (mf)
+        uninit_prefetch(mf);
 }
 
 const demuxer_desc_t demuxer_desc_mf = {
@@ -26,6 +26,7 @@
 #include <stdbool.h>
 #include <math.h>
 #include <assert.h>
+#include <limits.h>
 
 #include <libavutil/common.h>
 #include <libavutil/lzo.h>
@@ -188,6 +189,18 @@ typedef struct mkv_demuxer {
     bool index_complete;
     int index_mode;
 
+    // With lazy cues: the raw contents of the Cues element, and the byte
+    // offset and time of every CUES_GROUP_SIZE-th CuePoint within it. Only
+    // the groups from cues_loaded[0] to cues_loaded[1] (exclusive) are
+    // decoded into indexes[].
+    bstr lazy_cues;
+    struct mkv_cue_group {
+        int64_t pos;
+        int64_t time;
+    } *cue_groups;
+    int num_cue_groups;
+    int cues_loaded[2];
+
     int edition_id;
 
     struct header_elem {
@@ -207,10 +220,20 @@ typedef struct mkv_demuxer {
 
     bool eof_warning, keyframe_warning;
 
+    // probe_last_timestamp() was deferred until the first read or seek, and
+    // will restore the stream to this position.
+    bool duration_probe_pending;
+    int64_t duration_probe_pos;
+
     // Small queue of read but not yet returned packets. This is mostly
     // temporary data, and not normally larger than 0 or 1 elements.
     struct block_info *blocks;
     int num_blocks;
+
+    // Packets produced by the current block, added all at once with
+    // demux_add_packets() when the block was handled.
+    struct demux_packet **packets;
+    int num_packets;
 } mkv_demuxer_t;
 
 #define OPT_BASE_STRUCT struct demux_mkv_opts
@@ -220,6 +243,7 @@ struct demux_mkv_opts {
     double subtitle_preroll_secs_index;
     int probe_duration;
     int probe_start_time;
+    int lazy_cues;
 };
 
 const struct m_sub_options demux_mkv_conf = {
@@ -233,6 +257,8 @@ const struct m_sub_options demux_mkv_conf = {
         OPT_CHOICE("probe-video-duration", probe_duration, 0,
                    ({"no", 0}, {"yes", 1}, {"full", 2})),
         OPT_FLAG("probe-start-time", probe_start_time, 0),
+        OPT_CHOICE("lazy-cues", lazy_cues, 0,
+                   ({"no", 0}, {"yes", 1}, {"auto", 2})),
         {0}
     },
     .size = sizeof(struct demux_mkv_opts),
@@ -240,6 +266,7 @@ const struct m_sub_options demux_mkv_conf = {
         .subtitle_preroll = 2,
         .subtitle_preroll_secs = 1.0,
         .subtitle_preroll_secs_index = 10.0,
+        .lazy_cues = 2,
     },
 };
 
@@ -252,8 +279,20 @@ const struct m_sub_options demux_mkv_conf = {
 // (Subtitle packets added before first A/V keyframe packet is found with seek.)
 #define NUM_SUB_PREROLL_PACKETS 500
 
+// When reading header elements after the first cluster, gaps up to this size
+// between consecutive elements are read and discarded instead of seeking. On
+// network streams this turns the header reads into a single ranged request.
+#define MAX_HEADER_GAP (256 * 1024)
+
+// Number of CuePoints per group with lazy cues parsing.
+#define CUES_GROUP_SIZE 64
+// With --demuxer-mkv-lazy-cues=auto, Cues elements at least this large are
+// parsed lazily.
+#define LAZY_CUES_MIN_SIZE (1024 * 1024)
+
 static void probe_last_timestamp(struct demuxer *demuxer, int64_t start_pos);
 static void probe_first_timestamp(struct demuxer *demuxer);
+static void probe_deferred_duration(struct demuxer *demuxer);
 static int read_next_block_into_queue(demuxer_t *demuxer);
 static void free_block(struct block_info *block);
 
@@ -848,6 +887,161 @@ static void add_block_position(demuxer_t *demuxer, struct mkv_track *track,
     track->last_index_entry = mkv_d->num_indexes - 1;
 }
 
+static void add_cue_point(demuxer_t *demuxer, struct ebml_cue_point *cuepoint)
+{
+    mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
+
+    uint64_t time = cuepoint->cue_time;
+    for (int c = 0; c < cuepoint->n_cue_track_positions; c++) {
+        struct ebml_cue_track_positions *trackpos =
+            &cuepoint->cue_track_positions[c];
+        uint64_t pos = mkv_d->segment_start + trackpos->cue_cluster_position;
+        cue_index_add(demuxer, trackpos->cue_track, pos,
+                      time, trackpos->cue_duration);
+        mkv_d->index_has_durations |= trackpos->n_cue_duration > 0;
+        MP_DBG(demuxer, "|+ found cue point for track %"PRIu64": "
+               "timecode %"PRIu64", filepos: %"PRIu64""
+               "offset %"PRIu64", duration %"PRIu64"\n",
+               trackpos->cue_track, time, pos,
+               trackpos->cue_relative_position, trackpos->cue_duration);
+    }
+}
+
+// Decode the CuePoints of the lazy cues that cover the time range from
+// min_tc to max_tc (in Matroska timecode units) into mkv_d->indexes, replacing
+// the previously decoded entries. Includes one CuePoint group after the range,
+// so that forward seeks find an entry too.
+static void load_cues_range(demuxer_t *demuxer, int64_t min_tc, int64_t max_tc)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    struct mkv_cue_group *groups = mkv_d->cue_groups;
+    int num_groups = mkv_d->num_cue_groups;
+
+    if (!num_groups)
+        return;
+
+    // Find the first group that starts after min_tc.
+    int lo = 0, hi = num_groups;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (groups[mid].time <= min_tc) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    int start = MPMAX(lo - 1, 0);
+    int end = start;
+    while (end < num_groups && groups[end].time <= max_tc)
+        end++;
+    end = MPMIN(end + 1, num_groups);
+
+    if (start == mkv_d->cues_loaded[0] && end == mkv_d->cues_loaded[1])
+        return;
+
+    int64_t start_pos = groups[start].pos;
+    int64_t end_pos = end < num_groups ? groups[end].pos : mkv_d->lazy_cues.len;
+
+    MP_VERBOSE(demuxer, "Decoding cue point groups %d-%d.\n", start, end);
+
+    mkv_d->num_indexes = 0;
+    mkv_d->index_has_durations = false;
+
+    stream_t *ms = open_memory_stream_ref(mkv_d->lazy_cues.start + start_pos,
+                                          end_pos - start_pos);
+    while (1) {
+        uint32_t id = ebml_read_id(ms);
+        if (ms->eof)
+            break;
+        if (id != MATROSKA_ID_CUEPOINT) {
+            if (ebml_read_skip(demuxer->log, -1, ms))
+                break;
+            continue;
+        }
+        struct ebml_cue_point cuepoint = {0};
+        struct ebml_parse_ctx parse_ctx = {demuxer->log};
+        if (ebml_read_element(ms, &parse_ctx, &cuepoint,
+                              &ebml_cue_point_desc) < 0)
+            break;
+        add_cue_point(demuxer, &cuepoint);
+        talloc_free(parse_ctx.talloc_ctx);
+    }
+    free_stream(ms);
+
+    mkv_d->cues_loaded[0] = start;
+    mkv_d->cues_loaded[1] = end;
+}
+
+// Scan the raw Cues in mkv_d->lazy_cues and set up cue_groups. This reads
+// only the CueTime of each CuePoint. Returns false if the index looks broken.
+static bool scan_lazy_cues(demuxer_t *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    int64_t len = mkv_d->lazy_cues.len;
+    int num_points = 0;
+    bool sorted = true;
+    bool ok = false;
+    int64_t last_time = -1;
+
+    stream_t *ms = open_memory_stream_ref(mkv_d->lazy_cues.start, len);
+    while (1) {
+        int64_t pos = stream_tell(ms);
+        uint32_t id = ebml_read_id(ms);
+        if (ms->eof)
+            break;
+        uint64_t elem_len = ebml_read_length(ms);
+        if (ms->eof || elem_len == EBML_UINT_INVALID ||
+            elem_len > len - stream_tell(ms))
+            break;
+        int64_t end = stream_tell(ms) + elem_len;
+        if (id == MATROSKA_ID_CUEPOINT) {
+            uint64_t time = EBML_UINT_INVALID;
+            while (stream_tell(ms) < end) {
+                uint32_t sub_id = ebml_read_id(ms);
+                if (sub_id == MATROSKA_ID_CUETIME) {
+                    time = ebml_read_uint(ms);
+                    break;
+                }
+                if (ebml_read_skip(demuxer->log, end, ms))
+                    break;
+            }
+            if (time == EBML_UINT_INVALID || time > INT64_MAX) {
+                MP_WARN(demuxer, "Malformed CuePoint element\n");
+                goto done;
+            }
+            if (time / 1e9 > mkv_d->duration / mkv_d->tc_scale * 10 &&
+                mkv_d->duration != 0)
+                goto done;
+            sorted &= (int64_t)time >= last_time;
+            last_time = time;
+            if (num_points % CUES_GROUP_SIZE == 0) {
+                MP_TARRAY_APPEND(mkv_d, mkv_d->cue_groups, mkv_d->num_cue_groups,
+                    (struct mkv_cue_group){ .pos = pos, .time = time });
+            }
+            num_points++;
+        }
+        if (!stream_seek(ms, end))
+            break;
+    }
+    if (num_points <= 3) // probably too sparse and will just break seeking
+        goto done;
+
+    // CuePoints are supposed to be sorted. If they aren't, a single group
+    // makes load_cues_range() always decode all of them, which is correct.
+    if (!sorted) {
+        MP_WARN(demuxer, "Cues are not sorted.\n");
+        mkv_d->num_cue_groups = 1;
+        mkv_d->cue_groups[0].time = 0;
+    }
+
+    MP_VERBOSE(demuxer, "Found %d cue points, decoding lazily.\n", num_points);
+    ok = true;
+
+done:
+    free_stream(ms);
+    return ok;
+}
+
 static int demux_mkv_read_cues(demuxer_t *demuxer)
 {
     mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
@@ -858,6 +1052,32 @@ static int demux_mkv_read_cues(demuxer_t *demuxer)
         return 0;
     }
 
+    int64_t start_pos = stream_tell(s);
+    uint64_t len = ebml_read_length(s);
+    int lazy = mkv_d->opts->lazy_cues;
+    if (len != EBML_UINT_INVALID && len <= INT_MAX &&
+        (lazy == 1 || (lazy == 2 && len >= LAZY_CUES_MIN_SIZE)))
+    {
+        MP_VERBOSE(demuxer, "Reading cues for lazy parsing...\n");
+        void *data = talloc_size(mkv_d, len);
+        mkv_d->lazy_cues = (bstr){data, stream_read(s, data, len)};
+        mkv_d->cues_loaded[0] = mkv_d->cues_loaded[1] = -1;
+        if (mkv_d->lazy_cues.len < len || !scan_lazy_cues(demuxer)) {
+            MP_WARN(demuxer, "Discarding potentially broken or useless index.\n");
+            talloc_free(data);
+            mkv_d->lazy_cues = (bstr){0};
+            TA_FREEP(&mkv_d->cue_groups);
+            mkv_d->num_cue_groups = 0;
+            return 0;
+        }
+        // Do not attempt to create index on the fly.
+        mkv_d->index_complete = true;
+        load_cues_range(demuxer, 0, 0);
+        return 0;
+    }
+    if (!stream_seek(s, start_pos))
+        return -1;
+
     MP_VERBOSE(demuxer, "Parsing cues...\n");
     struct ebml_cues cues = {0};
     struct ebml_parse_ctx parse_ctx = {demuxer->log};
@@ -882,23 +1102,8 @@ static int demux_mkv_read_cues(demuxer_t *demuxer)
     mkv_d->num_indexes = MPMIN(1, mkv_d->num_indexes);
     mkv_d->index_has_durations = false;
 
-    for (int i = 0; i < cues.n_cue_point; i++) {
-        struct ebml_cue_point *cuepoint = &cues.cue_point[i];
-        uint64_t time = cuepoint->cue_time;
-        for (int c = 0; c < cuepoint->n_cue_track_positions; c++) {
-            struct ebml_cue_track_positions *trackpos =
-                &cuepoint->cue_track_positions[c];
-            uint64_t pos = mkv_d->segment_start + trackpos->cue_cluster_position;
-            cue_index_add(demuxer, trackpos->cue_track, pos,
-                          time, trackpos->cue_duration);
-            mkv_d->index_has_durations |= trackpos->n_cue_duration > 0;
-            MP_DBG(demuxer, "|+ found cue point for track %"PRIu64": "
-                   "timecode %"PRIu64", filepos: %"PRIu64""
-                   "offset %"PRIu64", duration %"PRIu64"\n",
-                   trackpos->cue_track, time, pos,
-                   trackpos->cue_relative_position, trackpos->cue_duration);
-        }
-    }
+    for (int i = 0; i < cues.n_cue_point; i++)
+        add_cue_point(demuxer, &cues.cue_point[i]);
 
     // Do not attempt to create index on the fly.
     mkv_d->index_complete = true;
@@ -1145,28 +1350,63 @@ static int demux_mkv_read_attachments(demuxer_t *demuxer)
 
     MP_VERBOSE(demuxer, "Parsing attachments...\n");
 
-    struct ebml_attachments attachments = {0};
-    struct ebml_parse_ctx parse_ctx = {demuxer->log};
-    if (ebml_read_element(s, &parse_ctx, &attachments,
-                          &ebml_attachments_desc) < 0)
+    // Walk the element manually instead of using ebml_read_element(), which
+    // would read all attached files (often tens of MB of fonts) into a single
+    // buffer first. This way, each file's data is read into its own buffer.
+    uint64_t length = ebml_read_length(s);
+    int64_t end = stream_tell(s) + length;
+    if (s->eof || length == EBML_UINT_INVALID || length >= INT64_MAX - end)
         return -1;
 
-    for (int i = 0; i < attachments.n_attached_file; i++) {
-        struct ebml_attached_file *attachment = &attachments.attached_file[i];
-        if (!attachment->file_name || !attachment->file_mime_type
-            || !attachment->n_file_data) {
-            MP_WARN(demuxer, "Malformed attachment\n");
+    struct ebml_view file;
+    while (ebml_read_view(s, end, &file)) {
+        int64_t file_end = file.pos + file.len;
+        if (file.id != MATROSKA_ID_ATTACHEDFILE) {
+            if (!stream_seek(s, file_end))
+                break;
             continue;
         }
-        char *name = attachment->file_name;
-        char *mime = attachment->file_mime_type;
-        demuxer_add_attachment(demuxer, name, mime, attachment->file_data.start,
-                               attachment->file_data.len);
-        MP_VERBOSE(demuxer, "Attachment: %s, %s, %zu bytes\n",
-                   name, mime, attachment->file_data.len);
+
+        void *tmp = talloc_new(NULL);
+        char *name = NULL, *mime = NULL;
+        struct ebml_view data = {0};
+        bool have_data = false;
+
+        struct ebml_view el;
+        while (ebml_read_view(s, file_end, &el)) {
+            switch (el.id) {
+            case MATROSKA_ID_FILENAME:
+                name = ebml_view_read(s, tmp, &el, 1024 * 1024).start;
+                break;
+            case MATROSKA_ID_FILEMIMETYPE:
+                mime = ebml_view_read(s, tmp, &el, 1024 * 1024).start;
+                break;
+            case MATROSKA_ID_FILEDATA:
+                data = el;
+                have_data = true;
+                break;
+            }
+            if (!stream_seek(s, el.pos + el.len))
+                break;
+        }
+
+        if (name && mime && have_data) {
+            struct bstr bin = ebml_view_read(s, tmp, &data, INT_MAX);
+            if (bin.start) {
+                demuxer_add_attachment(demuxer, name, mime, bin.start, bin.len);
+                MP_VERBOSE(demuxer, "Attachment: %s, %s, %zu bytes\n",
+                           name, mime, bin.len);
+            }
+        } else {
+            MP_WARN(demuxer, "Malformed attachment\n");
+        }
+        talloc_free(tmp);
+
+        if (!stream_seek(s, file_end))
+            break;
     }
 
-    talloc_free(parse_ctx.talloc_ctx);
+    stream_seek(s, end);
     return 0;
 }
 
@@ -1269,6 +1509,25 @@ skip:
     return 0;
 }
 
+// Like stream_seek(), but short forward seeks are done by reading the data in
+// between, so that the stream does not have to issue a new request.
+static bool seek_or_skip_gap(struct stream *s, int64_t pos)
+{
+    int64_t cur = stream_tell(s);
+    if (pos > cur && pos - cur <= MAX_HEADER_GAP) {
+        char buf[4096];
+        while (cur < pos) {
+            int r = stream_read(s, buf, MPMIN(pos - cur, sizeof(buf)));
+            if (r <= 0)
+                break;
+            cur += r;
+        }
+        if (cur == pos)
+            return true;
+    }
+    return stream_seek(s, pos);
+}
+
 static int read_deferred_element(struct demuxer *demuxer,
                                  struct header_elem *elem)
 {
@@ -1280,7 +1539,7 @@ static int read_deferred_element(struct demuxer *demuxer,
     MP_VERBOSE(demuxer, "Seeking to %"PRIu64" to read header element "
                "0x%"PRIx32".\n",
                elem->pos, elem->id);
-    if (!stream_seek(s, elem->pos)) {
+    if (!seek_or_skip_gap(s, elem->pos)) {
         MP_WARN(demuxer, "Failed to seek when reading header element.\n");
         return 0;
     }
@@ -1318,7 +1577,7 @@ static void add_coverart(struct demuxer *demuxer)
         struct sh_stream *sh = demux_alloc_sh_stream(STREAM_VIDEO);
         sh->demuxer_id = -1 - sh->index; // don't clash with mkv IDs
         sh->codec->codec = codec;
-        sh->attached_picture = new_demux_packet_from(att->data, att->data_size);
+        sh->attached_picture = demux_copy_packet(att->packet);
         if (sh->attached_picture) {
             sh->attached_picture->pts = 0;
             talloc_steal(sh, sh->attached_picture);
@@ -2117,8 +2376,16 @@ static int demux_mkv_open(demuxer_t *demuxer, enum demux_check check)
     process_tags(demuxer);
 
     probe_first_timestamp(demuxer);
-    if (mkv_d->opts->probe_duration)
-        probe_last_timestamp(demuxer, start_pos);
+    if (mkv_d->opts->probe_duration && demuxer->seekable) {
+        if (demuxer->is_network) {
+            // Seeking to the end of the file costs extra requests, which
+            // would delay opening; run it on the demuxer thread instead.
+            mkv_d->duration_probe_pending = true;
+            mkv_d->duration_probe_pos = start_pos;
+        } else {
+            probe_last_timestamp(demuxer, start_pos);
+        }
+    }
     probe_x264_garbage(demuxer);
 
     return 0;
@@ -2127,7 +2394,8 @@ static int demux_mkv_open(demuxer_t *demuxer, enum demux_check check)
 // Read the laced block data at the current stream position (until endpos as
 // indicated by the block length field) into individual buffers.
 static int demux_mkv_read_block_lacing(struct block_info *block, int type,
-                                       struct stream *s, uint64_t endpos)
+                                       struct stream *s, uint64_t endpos,
+                                       struct demux_packet_pool *pool)
 {
     int laces;
     uint32_t lace_size[MAX_NUM_LACES];
@@ -2196,7 +2464,7 @@ static int demux_mkv_read_block_lacing(struct block_info *block, int type,
         if (stream_tell(s) + size > endpos || size > (1 << 30))
             goto error;
         int pad = MPMAX(AV_INPUT_BUFFER_PADDING_SIZE, AV_LZO_INPUT_PADDING);
-        AVBufferRef *buf = av_buffer_alloc(size + pad);
+        AVBufferRef *buf = demux_packet_pool_get(pool, size + pad);
         if (!buf)
             goto error;
         buf->size = size;
@@ -2218,6 +2486,21 @@ static int demux_mkv_read_block_lacing(struct block_info *block, int type,
 }
 
 // Return whether the packet was handled & freed.
+static void queue_packet(demuxer_t *demuxer, struct sh_stream *stream,
+                         struct demux_packet *dp)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    dp->stream = stream->index;
+    MP_TARRAY_APPEND(mkv_d, mkv_d->packets, mkv_d->num_packets, dp);
+}
+
+static void flush_packets(demuxer_t *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    demux_add_packets(demuxer, mkv_d->packets, mkv_d->num_packets);
+    mkv_d->num_packets = 0;
+}
+
 static bool handle_realaudio(demuxer_t *demuxer, mkv_track_t *track,
                              struct demux_packet *orig)
 {
@@ -2310,7 +2593,7 @@ static bool handle_realaudio(demuxer_t *demuxer, mkv_track_t *track,
                 track->audio_timestamp[x * apk_usize / w];
             dp->pos = orig->pos + x;
             dp->keyframe = !x;   // Mark first packet as keyframe
-            demux_add_packet(track->stream, dp);
+            queue_packet(demuxer, track->stream, dp);
         }
     }
 
@@ -2438,7 +2721,7 @@ static void mkv_parse_and_add_packet(demuxer_t *demuxer, mkv_track_t *track,
             if (new) {
                 demux_packet_copy_attribs(new, dp);
                 talloc_free(dp);
-                demux_add_packet(stream, new);
+                queue_packet(demuxer, stream, new);
                 return;
             }
         }
@@ -2446,14 +2729,15 @@ static void mkv_parse_and_add_packet(demuxer_t *demuxer, mkv_track_t *track,
 
     if (strcmp(stream->codec->codec, "prores") == 0) {
         size_t newlen = dp->len + 8;
-        struct demux_packet *new = new_demux_packet(newlen);
+        struct demux_packet *new =
+            new_demux_packet_pooled(demuxer->packet_pool, newlen);
         if (new) {
             AV_WB32(new->buffer + 0, newlen);
             AV_WB32(new->buffer + 4, MKBETAG('i', 'c', 'p', 'f'));
             memcpy(new->buffer + 8, dp->buffer, dp->len);
             demux_packet_copy_attribs(new, dp);
             talloc_free(dp);
-            demux_add_packet(stream, new);
+            queue_packet(demuxer, stream, new);
             return;
         }
     }
@@ -2467,7 +2751,7 @@ static void mkv_parse_and_add_packet(demuxer_t *demuxer, mkv_track_t *track,
     }
 
     if (!track->parse || !track->av_parser || !track->av_parser_codec) {
-        demux_add_packet(stream, dp);
+        queue_packet(demuxer, stream, dp);
         return;
     }
 
@@ -2501,13 +2785,13 @@ static void mkv_parse_and_add_packet(demuxer_t *demuxer, mkv_track_t *track,
                 new->dts = track->av_parser->dts == AV_NOPTS_VALUE
                          ? MP_NOPTS_VALUE : track->av_parser->dts / tb;
             }
-            demux_add_packet(stream, new);
+            queue_packet(demuxer, stream, new);
         }
         pts = dts = AV_NOPTS_VALUE;
     }
 
     if (dp->len) {
-        demux_add_packet(stream, dp);
+        queue_packet(demuxer, stream, dp);
     } else {
         talloc_free(dp);
     }
@@ -2565,7 +2849,8 @@ static int read_block(demuxer_t *demuxer, int64_t end, struct block_info *block)
     block->filepos = stream_tell(s);
 
     int lace_type = (header_flags >> 1) & 0x03;
-    if (demux_mkv_read_block_lacing(block, lace_type, s, endpos))
+    if (demux_mkv_read_block_lacing(block, lace_type, s, endpos,
+                                    demuxer->packet_pool))
         goto exit;
 
     if (block->simple)
@@ -2702,6 +2987,8 @@ static int handle_block(demuxer_t *demuxer, struct block_info *block_info)
             filepos += data->size;
         }
 
+        flush_packets(demuxer);
+
         if (stream->type == STREAM_VIDEO) {
             mkv_d->v_skip_to_keyframe = 0;
             mkv_d->skip_to_timecode = INT64_MIN;
@@ -2897,6 +3184,8 @@ static int read_next_block(demuxer_t *demuxer, struct block_info *block)
 
 static int demux_mkv_fill_buffer(demuxer_t *demuxer)
 {
+    probe_deferred_duration(demuxer);
+
     for (;;) {
         int res;
         struct block_info block;
@@ -2971,6 +3260,14 @@ static struct mkv_index *seek_with_cues(struct demuxer *demuxer, int seek_id,
     struct mkv_demuxer *mkv_d = demuxer->priv;
     struct mkv_index *index = NULL;
 
+    if (mkv_d->num_cue_groups) {
+        double secs = MPMAX(mkv_d->opts->subtitle_preroll_secs,
+                            mkv_d->opts->subtitle_preroll_secs_index);
+        int64_t pre = MPMIN(INT64_MAX / 2, secs * 1e9 / mkv_d->tc_scale);
+        int64_t tc = target_timecode / mkv_d->tc_scale;
+        load_cues_range(demuxer, tc - pre, tc);
+    }
+
     int64_t min_diff = INT64_MIN;
     for (size_t i = 0; i < mkv_d->num_indexes; i++) {
         if (seek_id < 0 || mkv_d->indexes[i].tnum == seek_id) {
@@ -3040,6 +3337,8 @@ static struct mkv_index *seek_with_cues(struct demuxer *demuxer, int seek_id,
 
 static void demux_mkv_seek(demuxer_t *demuxer, double seek_pts, int flags)
 {
+    probe_deferred_duration(demuxer);
+
     mkv_demuxer_t *mkv_d = demuxer->priv;
     int64_t old_pos = stream_tell(demuxer->stream);
     uint64_t v_tnum = -1;
@@ -3100,6 +3399,7 @@ static void demux_mkv_seek(demuxer_t *demuxer, double seek_pts, int flags)
 
         mkv_index_t *index = NULL;
         if (mkv_d->index_complete) {
+            load_cues_range(demuxer, INT64_MIN, INT64_MAX);
             for (size_t i = 0; i < mkv_d->num_indexes; i++) {
                 if (mkv_d->indexes[i].tnum == v_tnum) {
                     if ((index == NULL)
@@ -3155,6 +3455,7 @@ static void probe_last_timestamp(struct demuxer *demuxer, int64_t start_pos)
     if (mkv_d->opts->probe_duration != 2) {
         read_deferred_cues(demuxer);
         if (mkv_d->index_complete) {
+            load_cues_range(demuxer, INT64_MAX, INT64_MAX);
             // Find last cluster that still has video packets
             int64_t target = 0;
             for (size_t i = 0; i < mkv_d->num_indexes; i++) {
@@ -3207,6 +3508,26 @@ static void probe_last_timestamp(struct demuxer *demuxer, int64_t start_pos)
     mkv_d->cluster_start = mkv_d->cluster_end = 0;
 }
 
+// Run a probe_last_timestamp() deferred by demux_mkv_open(). Since it seeks
+// back to the start of the data and discards queued blocks, this must happen
+// before anything was read (or right before a seek), and the player picks up
+// the new duration asynchronously.
+static void probe_deferred_duration(struct demuxer *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+
+    if (!mkv_d->duration_probe_pending)
+        return;
+    mkv_d->duration_probe_pending = false;
+
+    double duration = demuxer->duration;
+    probe_last_timestamp(demuxer, mkv_d->duration_probe_pos);
+    if (demuxer->duration != duration) {
+        MP_VERBOSE(demuxer, "Probed duration: %f\n", demuxer->duration);
+        demux_changed(demuxer, DEMUX_EVENT_DURATION);
+    }
+}
+
 static void probe_first_timestamp(struct demuxer *demuxer)
 {
     mkv_demuxer_t *mkv_d = demuxer->priv;
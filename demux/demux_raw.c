@@ -40,6 +40,13 @@
 
 #include "osdep/endian.h"
 
+#if HAVE_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libavutil/buffer.h>
+#endif
+
 struct demux_rawaudio_opts {
     struct m_channels channels;
     int samplerate;
@@ -130,8 +137,116 @@ struct priv {
     int frame_size;
     int read_frames;
     double frame_rate;
+    // If non-NULL, the file is mapped to memory, and video frames are returned
+    // as packets referencing the mapping, instead of being read into new
+    // packets. The decoder can then use the frame data without a copy.
+    struct AVBufferRef *map;
+    int64_t map_size;
+    int64_t map_pos;    // read position in the mapping
+};
+
+#if HAVE_POSIX
+struct file_map {
+    void *data;
+    size_t size;
 };
 
+static void free_file_map(void *opaque, uint8_t *data)
+{
+    struct file_map *m = opaque;
+    munmap(m->data, m->size);
+    free(m);
+}
+
+static void unref_file_map(void *opaque, uint8_t *data)
+{
+    struct AVBufferRef *map = opaque;
+    av_buffer_unref(&map);
+}
+
+static void release_map(void *ptr)
+{
+    struct priv *p = ptr;
+    // Packets and images still referencing the mapping keep it alive.
+    av_buffer_unref(&p->map);
+}
+
+// Only done on 64 bit systems, where address space is not a concern (like in
+// stream_file.c).
+static void map_file(struct demuxer *demuxer)
+{
+    struct priv *p = demuxer->priv;
+    struct stream *s = demuxer->stream;
+
+    if (!s->is_local_file || sizeof(void *) < 8)
+        return;
+
+    char *filename = mp_file_get_path(NULL, bstr0(s->url));
+    int fd = filename ? open(filename, O_RDONLY | O_CLOEXEC) : -1;
+    talloc_free(filename);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size >= p->frame_size)
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    struct file_map *m = malloc(sizeof(*m));
+    if (m) {
+        *m = (struct file_map){ .data = data, .size = st.st_size };
+        // The buffer size is meaningless (and may be >2GB), so leave it 0.
+        p->map = av_buffer_create(data, 0, free_file_map, m,
+                                  AV_BUFFER_FLAG_READONLY);
+    }
+    if (!p->map) {
+        free(m);
+        munmap(data, st.st_size);
+        return;
+    }
+    p->map_size = st.st_size;
+    p->map_pos = stream_tell(s);
+    talloc_set_destructor(p, release_map);
+    MP_VERBOSE(demuxer, "rawvideo: using memory mapped frames.\n");
+}
+
+// Return a packet referencing the next frame in the mapping, or NULL if that
+// is not possible (end of mapping reached, or out of memory).
+static struct demux_packet *get_mapped_packet(struct demuxer *demuxer)
+{
+    struct priv *p = demuxer->priv;
+
+    // Decoders may read AV_INPUT_BUFFER_PADDING_SIZE bytes past the end.
+    int64_t pos = p->map_pos;
+    if (pos + p->frame_size + AV_INPUT_BUFFER_PADDING_SIZE > p->map_size)
+        return NULL;
+
+    struct AVBufferRef *ref = av_buffer_ref(p->map);
+    if (!ref)
+        return NULL;
+    struct AVBufferRef *buf =
+        av_buffer_create(p->map->data + pos, p->frame_size, unref_file_map,
+                         ref, AV_BUFFER_FLAG_READONLY);
+    if (!buf) {
+        av_buffer_unref(&ref);
+        return NULL;
+    }
+    struct demux_packet *dp = new_demux_packet_from_buf(buf);
+    av_buffer_unref(&buf);
+    if (!dp)
+        return NULL;
+
+    dp->pos = pos;
+    dp->pts = (pos / p->frame_size) / p->frame_rate;
+    p->map_pos += p->frame_size;
+    return dp;
+}
+#endif
+
 static int generic_open(struct demuxer *demuxer)
 {
     struct stream *s = demuxer->stream;
@@ -266,6 +381,10 @@ static int demux_rawvideo_open(demuxer_t *demuxer, enum demux_check check)
         .read_frames = 1,
     };
 
+#if HAVE_POSIX
+    map_file(demuxer);
+#endif
+
     return generic_open(demuxer);
 }
 
@@ -273,10 +392,24 @@ static int raw_fill_buffer(demuxer_t *demuxer)
 {
     struct priv *p = demuxer->priv;
 
+#if HAVE_POSIX
+    if (p->map) {
+        struct demux_packet *dp = get_mapped_packet(demuxer);
+        if (dp) {
+            demux_add_packet(p->sh, dp);
+            return 1;
+        }
+        // Past the mapped part (e.g. the file was appended to): read normally.
+        if (stream_tell(demuxer->stream) != p->map_pos)
+            stream_seek(demuxer->stream, p->map_pos);
+    }
+#endif
+
     if (demuxer->stream->eof)
         return 0;
 
-    struct demux_packet *dp = new_demux_packet(p->frame_size * p->read_frames);
+    struct demux_packet *dp = new_demux_packet_pooled(demuxer->packet_pool,
+                                    p->frame_size * p->read_frames);
     if (!dp) {
         MP_ERR(demuxer, "Can't read packet.\n");
         return 1;
@@ -289,6 +422,7 @@ static int raw_fill_buffer(demuxer_t *demuxer)
     demux_packet_shorten(dp, len);
     demux_add_packet(p->sh, dp);
 
+    p->map_pos = stream_tell(demuxer->stream);
     return 1;
 }
 
@@ -306,6 +440,7 @@ static void raw_seek(demuxer_t *demuxer, double seek_pts, int flags)
     if (end && pos > end)
         pos = end;
     stream_seek(s, (pos / p->frame_size) * p->frame_size);
+    p->map_pos = stream_tell(s);
 }
 
 const demuxer_desc_t demuxer_desc_rawaudio = {
@@ -17,15 +17,21 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include "common/common.h"
 #include "common/msg.h"
+#include "osdep/threads.h"
 
 #include "demux.h"
 #include "timeline.h"
 #include "stheader.h"
 #include "stream/stream.h"
 
+// Start opening the next lazy segment in the background if the demuxer gets
+// closer than this to the end of the current segment (in seconds).
+#define PRELOAD_SECS 10.0
+
 struct segment {
     int index;
     double start, end;
@@ -66,6 +72,12 @@ struct priv {
     // Total number of packets received past end of segment. Used
     // to be clever about determining when to switch segments.
     int eos_packets;
+
+    // Set while preload_thread opens the demuxer for preload_seg. The result
+    // is in preload_d once the thread is joined.
+    pthread_t preload_thread;
+    struct segment *preload_seg;
+    struct demuxer *preload_d;
 };
 
 static bool target_stream_used(struct segment *seg, int target_index)
@@ -153,28 +165,87 @@ static void close_lazy_segments(struct demuxer *demuxer)
     }
 }
 
-static void reopen_lazy_segments(struct demuxer *demuxer)
+static struct demuxer *open_segment(struct demuxer *demuxer,
+                                    struct segment *seg)
 {
     struct priv *p = demuxer->priv;
 
-    if (p->current->d)
-        return;
-
-    close_lazy_segments(demuxer);
-
     struct demuxer_params params = {
         .init_fragment = p->tl->init_fragment,
         .skip_lavf_probing = true,
     };
-    p->current->d = demux_open_url(p->current->url, &params,
-                                   demuxer->stream->cancel, demuxer->global);
-    if (!p->current->d && !demux_cancel_test(demuxer))
+    struct demuxer *d = demux_open_url(seg->url, &params,
+                                       demuxer->stream->cancel, demuxer->global);
+    if (!d && !demux_cancel_test(demuxer))
         MP_ERR(demuxer, "failed to load segment\n");
+    if (d)
+        demux_disable_cache(d);
+    return d;
+}
+
+static void *preload_thread(void *arg)
+{
+    struct demuxer *demuxer = arg;
+    struct priv *p = demuxer->priv;
+    mpthread_set_name("timeline-preload");
+    p->preload_d = open_segment(demuxer, p->preload_seg);
+    return NULL;
+}
+
+static void start_preload(struct demuxer *demuxer, struct segment *seg)
+{
+    struct priv *p = demuxer->priv;
+
+    if (p->preload_seg || !seg->lazy || seg->d)
+        return;
+
+    MP_VERBOSE(demuxer, "preloading segment %d\n", seg->index);
+    p->preload_seg = seg;
+    p->preload_d = NULL;
+    if (pthread_create(&p->preload_thread, NULL, preload_thread, demuxer))
+        p->preload_seg = NULL;
+}
+
+// Wait until the preload thread is done, and make its result available.
+static void finish_preload(struct demuxer *demuxer)
+{
+    struct priv *p = demuxer->priv;
+
+    if (!p->preload_seg)
+        return;
+
+    pthread_join(p->preload_thread, NULL);
+    struct segment *seg = p->preload_seg;
+    p->preload_seg = NULL;
+    assert(!seg->d);
+    seg->d = p->preload_d;
+    p->preload_d = NULL;
+    associate_streams(demuxer, seg);
+}
+
+static void reopen_lazy_segments(struct demuxer *demuxer)
+{
+    struct priv *p = demuxer->priv;
+
+    finish_preload(demuxer);
+    close_lazy_segments(demuxer);
+
     if (p->current->d)
-        demux_disable_cache(p->current->d);
+        return;
+
+    p->current->d = open_segment(demuxer, p->current);
     associate_streams(demuxer, p->current);
 }
 
+static struct segment *next_segment(struct priv *p, struct segment *seg)
+{
+    for (int n = 0; n < p->num_segments - 1; n++) {
+        if (p->segments[n] == seg)
+            return p->segments[n + 1];
+    }
+    return NULL;
+}
+
 static void switch_segment(struct demuxer *demuxer, struct segment *new,
                            double start_pts, int flags, bool init)
 {
@@ -237,6 +308,14 @@ static int d_fill_buffer(struct demuxer *demuxer)
     if (!pkt || pkt->pts >= seg->end)
         p->eos_packets += 1;
 
+    // Open the next segment while the packets of the current one are still
+    // being played, so switching to it doesn't need to wait for the network.
+    if (pkt && pkt->pts != MP_NOPTS_VALUE && pkt->pts >= seg->end - PRELOAD_SECS) {
+        struct segment *next = next_segment(p, seg);
+        if (next)
+            start_preload(demuxer, next);
+    }
+
     // Test for EOF. Do this here to properly run into EOF even if other
     // streams are disabled etc. If it somehow doesn't manage to reach the end
     // after demuxing a high (bit arbitrary) number of packets, assume one of
@@ -259,13 +338,7 @@ static int d_fill_buffer(struct demuxer *demuxer)
     if (eos_reached || !pkt) {
         talloc_free(pkt);
 
-        struct segment *next = NULL;
-        for (int n = 0; n < p->num_segments - 1; n++) {
-            if (p->segments[n] == seg) {
-                next = p->segments[n + 1];
-                break;
-            }
-        }
+        struct segment *next = next_segment(p, seg);
         if (!next)
             return 0;
         switch_segment(demuxer, next, next->start, 0, true);
@@ -429,6 +502,7 @@ static void d_close(struct demuxer *demuxer)
     struct priv *p = demuxer->priv;
     struct demuxer *master = p->tl->demuxer;
     p->current = NULL;
+    finish_preload(demuxer);
     close_lazy_segments(demuxer);
     timeline_destroy(p->tl);
     free_demuxer(master);
@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <inttypes.h>
 #include <stddef.h>
@@ -191,6 +192,50 @@ invalid:
     return 1;
 }
 
+/*
+ * Read the ID and length of the element at the current stream position, and
+ * leave the stream at the start of its contents. The caller can then read the
+ * contents, or skip them with stream_seek(s, view->pos + view->len). This is
+ * for walking large master elements without reading them into memory as
+ * ebml_read_element() does. Returns false if no valid element could be read,
+ * or if it extends past end (ignored if end is -1).
+ */
+bool ebml_read_view(stream_t *s, int64_t end, struct ebml_view *view)
+{
+    if (end >= 0 && stream_tell(s) >= end)
+        return false;
+    view->id = ebml_read_id(s);
+    view->len = ebml_read_length(s);
+    view->pos = stream_tell(s);
+    if (s->eof || view->id == EBML_ID_INVALID || view->len == EBML_UINT_INVALID)
+        return false;
+    if (view->len >= INT64_MAX - view->pos ||
+        (end >= 0 && view->pos + view->len > end))
+        return false;
+    return true;
+}
+
+/*
+ * Read the contents referenced by view into a new buffer (allocated with
+ * talloc_ctx as parent, and with a 0 byte after the data). Returns an empty
+ * bstr (start==NULL) on errors or if the contents are larger than max_len.
+ */
+struct bstr ebml_view_read(stream_t *s, void *talloc_ctx,
+                           struct ebml_view *view, uint64_t max_len)
+{
+    if (view->len > max_len || view->len >= INT_MAX)
+        return (struct bstr){0};
+    if (!stream_seek(s, view->pos))
+        return (struct bstr){0};
+    char *buf = talloc_size(talloc_ctx, view->len + 1);
+    if (stream_read(s, buf, view->len) != view->len) {
+        talloc_free(buf);
+        return (struct bstr){0};
+    }
+    buf[view->len] = '\0';
+    return (struct bstr){buf, view->len};
+}
+
 /*
  * Skip to (probable) next cluster (MATROSKA_ID_CLUSTER) element start position.
  */
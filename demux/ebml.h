@@ -56,6 +56,13 @@ struct ebml_elem_desc {
     const struct ebml_field_desc *fields;
 };
 
+// Reference to the contents of an element in the stream, without reading it.
+struct ebml_view {
+    uint32_t id;
+    int64_t pos;        // file position of the element contents
+    uint64_t len;       // size of the contents
+};
+
 struct ebml_parse_ctx {
     struct mp_log *log;
     void *talloc_ctx;
@@ -90,4 +97,8 @@ int ebml_resync_cluster(struct mp_log *log, stream_t *s);
 int ebml_read_element(struct stream *s, struct ebml_parse_ctx *ctx,
                       void *target, const struct ebml_elem_desc *desc);
 
+bool ebml_read_view(stream_t *s, int64_t end, struct ebml_view *view);
+struct bstr ebml_view_read(stream_t *s, void *talloc_ctx,
+                           struct ebml_view *view, uint64_t max_len);
+
 #endif /* MPLAYER_EBML_H */
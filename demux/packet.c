@@ -19,14 +19,17 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
 
 #include <libavcodec/avcodec.h>
+#include <libavutil/common.h>
 #include <libavutil/intreadwrite.h>
 
 #include "config.h"
 
 #include "common/av_common.h"
 #include "common/common.h"
+#include "osdep/atomic.h"
 
 #include "packet.h"
 
@@ -103,6 +106,113 @@ struct demux_packet *new_demux_packet(size_t len)
     return new_demux_packet_from_avpacket(&pkt);
 }
 
+// Buffer sizes are rounded up to one of 4 size classes per power of 2, which
+// limits the wasted memory to 25%. Buffers outside of the covered range are
+// not pooled.
+#define POOL_MIN_LOG2 6     // 64 bytes
+#define POOL_MAX_LOG2 24    // 16 MB
+#define POOL_STEPS 4
+#define POOL_NUM_CLASSES ((POOL_MAX_LOG2 - POOL_MIN_LOG2) * POOL_STEPS)
+
+struct demux_packet_pool {
+    // Created on demand. Only the thread owning the pool (the demuxer thread)
+    // may call demux_packet_pool_get(); the buffers can be freed anywhere.
+    AVBufferPool *pools[POOL_NUM_CLASSES];
+    atomic_llong num_allocs, num_gets, num_bytes;
+};
+
+static void pool_destroy(void *ptr)
+{
+    struct demux_packet_pool *pool = ptr;
+    // Buffers still in use keep their AVBufferPool alive until they're freed.
+    for (int n = 0; n < POOL_NUM_CLASSES; n++)
+        av_buffer_pool_uninit(&pool->pools[n]);
+}
+
+struct demux_packet_pool *demux_packet_pool_create(void *ta_parent)
+{
+    struct demux_packet_pool *pool = talloc_zero(ta_parent, struct demux_packet_pool);
+    talloc_set_destructor(pool, pool_destroy);
+    atomic_store(&pool->num_allocs, 0);
+    atomic_store(&pool->num_gets, 0);
+    atomic_store(&pool->num_bytes, 0);
+    return pool;
+}
+
+static AVBufferRef *pool_alloc(void *opaque, int size)
+{
+    struct demux_packet_pool *pool = opaque;
+    atomic_fetch_add(&pool->num_allocs, 1);
+    atomic_fetch_add(&pool->num_bytes, size);
+    return av_buffer_alloc(size);
+}
+
+// Return a buffer with at least the given size. The returned buffer's size
+// field is set to the requested size, and its contents are uninitialized.
+// pool can be NULL, in which case this simply allocates a new buffer.
+struct AVBufferRef *demux_packet_pool_get(struct demux_packet_pool *pool,
+                                          size_t size)
+{
+    if (size > INT_MAX)
+        return NULL;
+
+    int log2 = size > 1 ? av_log2(size - 1) + 1 : 0; // ceil(log2(size))
+    if (!pool || log2 <= POOL_MIN_LOG2 || log2 > POOL_MAX_LOG2)
+        return av_buffer_alloc(size);
+
+    // Subdivide (1 << (log2 - 1), 1 << log2] into POOL_STEPS classes.
+    size_t step = ((size_t)1 << (log2 - 1)) / POOL_STEPS;
+    int sub = (size - ((size_t)1 << (log2 - 1)) + step - 1) / step - 1;
+    int index = (log2 - POOL_MIN_LOG2 - 1) * POOL_STEPS + sub;
+    assert(index >= 0 && index < POOL_NUM_CLASSES);
+    size_t class_size = ((size_t)1 << (log2 - 1)) + (sub + 1) * step;
+    assert(class_size >= size);
+
+    if (!pool->pools[index]) {
+        pool->pools[index] =
+            av_buffer_pool_init2(class_size, pool, pool_alloc, NULL);
+        if (!pool->pools[index])
+            return NULL;
+    }
+
+    AVBufferRef *buf = av_buffer_pool_get(pool->pools[index]);
+    if (!buf)
+        return NULL;
+    atomic_fetch_add(&pool->num_gets, 1);
+    buf->size = size;
+    return buf;
+}
+
+void demux_packet_pool_get_stats(struct demux_packet_pool *pool,
+                                 struct demux_packet_pool_stats *st)
+{
+    int64_t allocs = atomic_load(&pool->num_allocs);
+    *st = (struct demux_packet_pool_stats){
+        .allocs = allocs,
+        .reuses = MPMAX(atomic_load(&pool->num_gets) - allocs, 0),
+        .bytes = atomic_load(&pool->num_bytes),
+    };
+}
+
+// Like new_demux_packet(), but use a buffer from the pool (pool can be NULL).
+struct demux_packet *new_demux_packet_pooled(struct demux_packet_pool *pool,
+                                             size_t len)
+{
+    if (!pool)
+        return new_demux_packet(len);
+    if (len > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return NULL;
+    AVBufferRef *buf =
+        demux_packet_pool_get(pool, len + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!buf)
+        return NULL;
+    memset(buf->data + len, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    buf->size = len;
+    struct demux_packet *dp = new_demux_packet_from_buf(buf);
+    av_buffer_unref(&buf);
+    return dp;
+}
+
 void demux_packet_shorten(struct demux_packet *dp, size_t len)
 {
     assert(len <= dp->len);
@@ -131,6 +241,7 @@ void demux_packet_copy_attribs(struct demux_packet *dst, struct demux_packet *sr
 
 struct demux_packet *demux_copy_packet(struct demux_packet *dp)
 {
+    assert(!dp->is_cached); // use demux_cache_read()
     struct demux_packet *new = NULL;
     if (dp->avpacket) {
         new = new_demux_packet_from_avpacket(dp->avpacket);
@@ -157,6 +268,10 @@ struct demux_packet *demux_copy_packet(struct demux_packet *dp)
 size_t demux_packet_estimate_total_size(struct demux_packet *dp)
 {
     size_t size = ROUND_ALLOC(sizeof(struct demux_packet));
+    if (dp->is_cached) {
+        // Only the metadata is in memory (see demux/cache.c).
+        return size + ROUND_ALLOC(sizeof(AVPacket));
+    }
     size += ROUND_ALLOC(dp->len);
     if (dp->avpacket) {
         size += ROUND_ALLOC(sizeof(AVPacket));
@@ -44,11 +44,33 @@ typedef struct demux_packet {
     struct demux_packet *next;
     struct AVPacket *avpacket;   // keep the buffer allocation and sidedata
     double kf_seek_pts; // demux.c internal: seek pts for keyframe range
+
+    // demux/cache.c internal: if is_cached is set, the packet data is not in
+    // memory (buffer==NULL), and stored at cached_pos in the cache file
+    bool is_cached;
+    int64_t cached_pos;
 } demux_packet_t;
 
 struct AVBufferRef;
 
+// Recycles packet payload buffers in size classes (see packet.c).
+struct demux_packet_pool;
+
+struct demux_packet_pool_stats {
+    int64_t allocs;         // number of buffers newly allocated
+    int64_t reuses;         // number of buffers taken from the pool
+    int64_t bytes;          // total size of buffers owned by the pool
+};
+
+struct demux_packet_pool *demux_packet_pool_create(void *ta_parent);
+struct AVBufferRef *demux_packet_pool_get(struct demux_packet_pool *pool,
+                                          size_t size);
+void demux_packet_pool_get_stats(struct demux_packet_pool *pool,
+                                 struct demux_packet_pool_stats *st);
+
 struct demux_packet *new_demux_packet(size_t len);
+struct demux_packet *new_demux_packet_pooled(struct demux_packet_pool *pool,
+                                             size_t len);
 struct demux_packet *new_demux_packet_from_avpacket(struct AVPacket *avpkt);
 struct demux_packet *new_demux_packet_from(void *data, size_t len);
 struct demux_packet *new_demux_packet_from_buf(struct AVBufferRef *buf);
@@ -125,6 +125,10 @@ const struct mp_cmd_def mp_cmds[] = {
                       {"window", 1},
                       {"subtitles", 2})),
   }},
+  { MP_CMD_SCREENSHOT_THUMBNAILS, "screenshot-thumbnails", {
+      ARG_STRING, ARG_STRING, ARG_INT, ARG_TIME },
+    .vararg = true,
+  },
   { MP_CMD_SCREENSHOT_RAW, "screenshot-raw", {
       OARG_CHOICE(2, ({"video", 0},
                       {"window", 1},
@@ -204,6 +208,8 @@ const struct mp_cmd_def mp_cmds[] = {
       { ARG_INT, ARG_INT, ARG_INT, ARG_STRING, ARG_INT, ARG_STRING, ARG_INT,
         ARG_INT, ARG_INT }},
   { MP_CMD_OVERLAY_REMOVE, "overlay-remove", { ARG_INT } },
+  { MP_CMD_OVERLAY_THUMBNAIL, "overlay-thumbnail",
+      { ARG_INT, ARG_TIME, ARG_INT, ARG_INT }},
 
   { MP_CMD_WRITE_WATCH_LATER_CONFIG, "write-watch-later-config", },
 
@@ -49,6 +49,7 @@ enum mp_command_type {
     MP_CMD_SCREENSHOT,
     MP_CMD_SCREENSHOT_TO_FILE,
     MP_CMD_SCREENSHOT_RAW,
+    MP_CMD_SCREENSHOT_THUMBNAILS,
     MP_CMD_LOADFILE,
     MP_CMD_LOADLIST,
     MP_CMD_PLAYLIST_CLEAR,
@@ -107,6 +108,7 @@ enum mp_command_type {
 
     MP_CMD_OVERLAY_ADD,
     MP_CMD_OVERLAY_REMOVE,
+    MP_CMD_OVERLAY_THUMBNAIL,
 
     MP_CMD_WRITE_WATCH_LATER_CONFIG,
 
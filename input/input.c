@@ -67,6 +67,7 @@ struct cmd_bind {
     int keys[MP_MAX_KEY_DOWN];
     int num_keys;
     char *cmd;
+    struct mp_cmd *parsed; // cmd parsed at definition time (NULL if invalid)
     char *location;     // filename/line number of definition
     bool is_builtin;
     struct cmd_bind_section *owner;
@@ -93,6 +94,8 @@ struct active_section {
 
 struct cmd_queue {
     struct mp_cmd *first;
+    struct mp_cmd *last;
+    int num;
 };
 
 struct wheel_state {
@@ -238,21 +241,23 @@ static bool test_rect(struct mp_rect *rc, int x, int y)
 
 static int queue_count_cmds(struct cmd_queue *queue)
 {
-    int res = 0;
-    for (struct mp_cmd *cmd = queue->first; cmd; cmd = cmd->queue_next)
-        res++;
-    return res;
+    return queue->num;
 }
 
 static void queue_remove(struct cmd_queue *queue, struct mp_cmd *cmd)
 {
+    struct mp_cmd *prev = NULL;
     struct mp_cmd **p_prev = &queue->first;
     while (*p_prev != cmd) {
+        prev = *p_prev;
         p_prev = &(*p_prev)->queue_next;
     }
     // if this fails, cmd was not in the queue
     assert(*p_prev == cmd);
     *p_prev = cmd->queue_next;
+    if (queue->last == cmd)
+        queue->last = prev;
+    queue->num--;
 }
 
 static struct mp_cmd *queue_remove_head(struct cmd_queue *queue)
@@ -265,27 +270,26 @@ static struct mp_cmd *queue_remove_head(struct cmd_queue *queue)
 
 static void queue_add_tail(struct cmd_queue *queue, struct mp_cmd *cmd)
 {
-    struct mp_cmd **p_prev = &queue->first;
-    while (*p_prev)
-        p_prev = &(*p_prev)->queue_next;
-    *p_prev = cmd;
+    if (queue->last) {
+        queue->last->queue_next = cmd;
+    } else {
+        queue->first = cmd;
+    }
+    queue->last = cmd;
     cmd->queue_next = NULL;
+    queue->num++;
 }
 
 static struct mp_cmd *queue_peek_tail(struct cmd_queue *queue)
 {
-    struct mp_cmd *cur = queue->first;
-    while (cur && cur->queue_next)
-        cur = cur->queue_next;
-    return cur;
+    return queue->last;
 }
 
 static void append_bind_info(struct input_ctx *ictx, char **pmsg,
                              struct cmd_bind *bind)
 {
     char *msg = *pmsg;
-    struct mp_cmd *cmd = mp_input_parse_cmd(ictx, bstr0(bind->cmd),
-                                            bind->location);
+    struct mp_cmd *cmd = bind->parsed;
     bstr stripped = cmd ? cmd->original : bstr0(bind->cmd);
     msg = talloc_asprintf_append(msg, " '%.*s'", BSTR_P(stripped));
     if (!cmd)
@@ -296,7 +300,6 @@ static void append_bind_info(struct input_ctx *ictx, char **pmsg,
     msg = talloc_asprintf_append(msg, " in %s", bind->location);
     if (bind->is_builtin)
         msg = talloc_asprintf_append(msg, " (default)");
-    talloc_free(cmd);
     *pmsg = msg;
 }
 
@@ -474,7 +477,8 @@ static mp_cmd_t *get_cmd_from_keys(struct input_ctx *ictx, char *force_section,
         talloc_free(key_buf);
         return NULL;
     }
-    mp_cmd_t *ret = mp_input_parse_cmd(ictx, bstr0(cmd->cmd), cmd->location);
+    // Copy the command parsed by bind_keys(), instead of parsing it again.
+    mp_cmd_t *ret = mp_cmd_clone(cmd->parsed);
     if (ret) {
         ret->input_section = cmd->owner->section;
         ret->key_name = talloc_steal(ret, mp_input_get_key_combo_name(&code, 1));
@@ -851,13 +855,17 @@ void mp_input_set_mouse_pos_artificial(struct input_ctx *ictx, int x, int y)
         if (should_drop_cmd(ictx, cmd)) {
             talloc_free(cmd);
         } else {
-            // Coalesce with previous mouse move events (i.e. replace it)
+            // Coalesce with previous mouse move events (i.e. replace it).
+            // The player wasn't done with the queue yet, so it was already
+            // woken up, and there's no need to wake it up again.
             struct mp_cmd *tail = queue_peek_tail(&ictx->cmd_queue);
             if (tail && tail->mouse_move) {
                 queue_remove(&ictx->cmd_queue, tail);
                 talloc_free(tail);
+                queue_add_tail(&ictx->cmd_queue, cmd);
+            } else {
+                mp_input_queue_cmd(ictx, cmd);
             }
-            mp_input_queue_cmd(ictx, cmd);
         }
     }
     input_unlock(ictx);
@@ -960,6 +968,14 @@ void mp_input_wakeup(struct input_ctx *ictx)
     ictx->wakeup_cb(ictx->wakeup_ctx);
 }
 
+int mp_input_get_num_queued_cmds(struct input_ctx *ictx)
+{
+    input_lock(ictx);
+    int num = queue_count_cmds(&ictx->cmd_queue);
+    input_unlock(ictx);
+    return num;
+}
+
 mp_cmd_t *mp_input_read_cmd(struct input_ctx *ictx)
 {
     input_lock(ictx);
@@ -1091,6 +1107,7 @@ bool mp_input_test_dragging(struct input_ctx *ictx, int x, int y)
 static void bind_dealloc(struct cmd_bind *bind)
 {
     talloc_free(bind->cmd);
+    talloc_free(bind->parsed);
     talloc_free(bind->location);
 }
 
@@ -1183,8 +1200,12 @@ static void bind_keys(struct input_ctx *ictx, bool builtin, bstr section,
 
     bind_dealloc(bind);
 
+    // (This also prints warnings if the command is invalid.)
+    struct mp_cmd *parsed = mp_input_parse_cmd(ictx, command, loc);
+
     *bind = (struct cmd_bind) {
         .cmd = bstrdup0(bs->binds, command),
+        .parsed = talloc_steal(bs->binds, parsed),
         .location = talloc_strdup(bs->binds, loc),
         .owner = bs,
         .is_builtin = builtin,
@@ -1263,9 +1284,6 @@ static int parse_config(struct input_ctx *ictx, bool builtin, bstr data,
 
         bind_keys(ictx, builtin, section, keys, num_keys, command, cur_loc);
         n_binds++;
-
-        // Print warnings if invalid commands are encountered.
-        talloc_free(mp_input_parse_cmd(ictx, command, cur_loc));
     }
 
     talloc_free(cur_loc);
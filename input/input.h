@@ -174,6 +174,9 @@ int mp_input_queue_cmd(struct input_ctx *ictx, struct mp_cmd *cmd);
 // Return next queued command, or NULL.
 struct mp_cmd *mp_input_read_cmd(struct input_ctx *ictx);
 
+// Return the number of commands currently in the queue.
+int mp_input_get_num_queued_cmds(struct input_ctx *ictx);
+
 // Parse text and return corresponding struct mp_cmd.
 // The location parameter is for error messages.
 struct mp_cmd *mp_input_parse_cmd(struct input_ctx *ictx, bstr str,
@@ -280,4 +283,21 @@ char *mp_json_encode_event(struct mpv_event *event);
 struct mpv_handle;
 char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf);
 
+// Protocols that can be used on an IPC connection (see "ipc_format" command).
+enum mp_ipc_format {
+    MP_IPC_FORMAT_JSON = 0,     // newline-separated JSON or text commands
+    MP_IPC_FORMAT_MSGPACK,      // length-prefixed MessagePack frames
+};
+
+// Serialize the given mpv_event structure for the given mp_ipc_format.
+bstr mp_ipc_encode_event(void *ta_parent, struct mpv_event *event, int format);
+
+// Like mp_ipc_consume_next_command(), but for a connection that uses the
+// protocol *format, which might be changed by the command. The reply (if any)
+// is returned in *reply, allocated under ctx.
+// Returns 1 if a command was consumed, 0 if buf doesn't contain a complete
+// command yet, and -1 on unrecoverable protocol errors.
+int mp_ipc_consume_next_message(struct mpv_handle *client, void *ctx,
+                                bstr *buf, int *format, bstr *reply);
+
 #endif /* MPLAYER_INPUT_H */
@@ -62,11 +62,12 @@ struct client_arg {
     bool close_client_fd;
 
     bool writable;
+    int format; // enum mp_ipc_format
 };
 
-static int ipc_write_str(struct client_arg *client, const char *buf)
+static int ipc_write(struct client_arg *client, const void *data, size_t count)
 {
-    size_t count = strlen(buf);
+    const char *buf = data;
     while (count > 0) {
         ssize_t rc = send(client->client_fd, buf, count, MSG_NOSIGNAL);
         if (rc <= 0) {
@@ -146,14 +147,14 @@ static void *client_thread(void *p)
                 if (!arg->writable)
                     continue;
 
-                char *event_msg = mp_json_encode_event(event);
-                if (!event_msg) {
+                bstr event_msg = mp_ipc_encode_event(NULL, event, arg->format);
+                if (!event_msg.start) {
                     MP_ERR(arg, "Encoding error\n");
                     goto done;
                 }
 
-                rc = ipc_write_str(arg, event_msg);
-                talloc_free(event_msg);
+                rc = ipc_write(arg, event_msg.start, event_msg.len);
+                talloc_free(event_msg.start);
                 if (rc < 0) {
                     MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
                     goto done;
@@ -184,20 +185,26 @@ static void *client_thread(void *p)
 
                 bstr_xappend(NULL, &client_msg, append);
 
-                while (bstrchr(client_msg, '\n') != -1) {
-                    char *reply_msg = mp_ipc_consume_next_command(arg->client,
-                        NULL, &client_msg);
+                while (1) {
+                    bstr reply_msg;
+                    rc = mp_ipc_consume_next_message(arg->client, NULL,
+                                                     &client_msg, &arg->format,
+                                                     &reply_msg);
+                    if (rc < 0)
+                        goto done;
+                    if (rc == 0)
+                        break;
 
-                    if (reply_msg && arg->writable) {
-                        rc = ipc_write_str(arg, reply_msg);
+                    if (reply_msg.start && arg->writable) {
+                        rc = ipc_write(arg, reply_msg.start, reply_msg.len);
                         if (rc < 0) {
                             MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
-                            talloc_free(reply_msg);
+                            talloc_free(reply_msg.start);
                             goto done;
                         }
                     }
 
-                    talloc_free(reply_msg);
+                    talloc_free(reply_msg.start);
                 }
             }
         }
@@ -20,6 +20,7 @@
 #include "common/msg.h"
 #include "input/input.h"
 #include "misc/json.h"
+#include "misc/msgpack.h"
 #include "options/m_option.h"
 #include "options/options.h"
 #include "options/path.h"
@@ -179,12 +180,14 @@ static void mpv_event_to_node(void *ta_parent, mpv_event *event, mpv_node *dst)
 
 char *mp_json_encode_event(mpv_event *event)
 {
-    void *ta_parent = talloc_new(NULL);
+    void *ta_parent = talloc_new_arena(NULL);
     mpv_node event_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
 
     mpv_event_to_node(ta_parent, event, &event_node);
 
-    char *output = talloc_strdup(NULL, "");
+    // Most events fit, which avoids growing the buffer step by step.
+    char *output = talloc_size(NULL, 512);
+    output[0] = '\0';
     json_write(&output, &event_node);
     output = ta_talloc_strdup_append(output, "\n");
 
@@ -193,33 +196,28 @@ char *mp_json_encode_event(mpv_event *event)
     return output;
 }
 
-// Function is allowed to modify src[n].
-static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
-                                  char *src)
+// Maximum size of a MessagePack frame received from a client.
+#define MAX_MSGPACK_FRAME (64 * 1024 * 1024)
+
+// Execute the command in msg_node (which might be NULL if parsing the request
+// failed), and write the reply to reply_node. format is the connection's
+// protocol, and can be NULL if switching the protocol is not supported.
+static void execute_command_node(struct mpv_handle *client, void *ta_parent,
+                                 mpv_node *msg_node, mpv_node *reply_node,
+                                 int *format)
 {
     int rc;
     const char *cmd = NULL;
-    struct mp_log *log = mp_client_get_log(client);
-
-    mpv_node msg_node;
-    mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
     mpv_node *reqid_node = NULL;
 
-    rc = json_parse(ta_parent, &msg_node, &src, 50);
-    if (rc < 0) {
-        mp_err(log, "malformed JSON received: '%s'\n", src);
-        rc = MPV_ERROR_INVALID_PARAMETER;
-        goto error;
-    }
-
-    if (msg_node.format != MPV_FORMAT_NODE_MAP) {
+    if (!msg_node || msg_node->format != MPV_FORMAT_NODE_MAP) {
         rc = MPV_ERROR_INVALID_PARAMETER;
         goto error;
     }
 
-    reqid_node = mpv_node_map_get(&msg_node, "request_id");
+    reqid_node = mpv_node_map_get(msg_node, "request_id");
 
-    mpv_node *cmd_node = mpv_node_map_get(&msg_node, "command");
+    mpv_node *cmd_node = mpv_node_map_get(msg_node, "command");
     if (!cmd_node ||
         (cmd_node->format != MPV_FORMAT_NODE_ARRAY) ||
         !cmd_node->u.list->num)
@@ -238,15 +236,36 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
 
     if (!strcmp("client_name", cmd)) {
         const char *client_name = mpv_client_name(client);
-        mpv_node_map_add_string(ta_parent, &reply_node, "data", client_name);
+        mpv_node_map_add_string(ta_parent, reply_node, "data", client_name);
+        rc = MPV_ERROR_SUCCESS;
+    } else if (!strcmp("ipc_format", cmd)) {
+        if (cmd_node->u.list->num != 2 || !format) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        if (cmd_node->u.list->values[1].format != MPV_FORMAT_STRING) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        char *name = cmd_node->u.list->values[1].u.string;
+        if (!strcmp(name, "json")) {
+            *format = MP_IPC_FORMAT_JSON;
+        } else if (!strcmp(name, "msgpack")) {
+            *format = MP_IPC_FORMAT_MSGPACK;
+        } else {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
         rc = MPV_ERROR_SUCCESS;
     } else if (!strcmp("get_time_us", cmd)) {
         int64_t time_us = mpv_get_time_us(client);
-        mpv_node_map_add_int64(ta_parent, &reply_node, "data", time_us);
+        mpv_node_map_add_int64(ta_parent, reply_node, "data", time_us);
         rc = MPV_ERROR_SUCCESS;
     } else if (!strcmp("get_version", cmd)) {
         int64_t ver = mpv_client_api_version();
-        mpv_node_map_add_int64(ta_parent, &reply_node, "data", ver);
+        mpv_node_map_add_int64(ta_parent, reply_node, "data", ver);
         rc = MPV_ERROR_SUCCESS;
     } else if (!strcmp("get_property", cmd)) {
         mpv_node result_node;
@@ -264,7 +283,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         rc = mpv_get_property(client, cmd_node->u.list->values[1].u.string,
                               MPV_FORMAT_NODE, &result_node);
         if (rc >= 0) {
-            mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
+            mpv_node_map_add(ta_parent, reply_node, "data", &result_node);
             mpv_free_node_contents(&result_node);
         }
     } else if (!strcmp("get_property_string", cmd)) {
@@ -281,9 +300,9 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         char *result = mpv_get_property_string(client,
                                         cmd_node->u.list->values[1].u.string);
         if (!result) {
-            mpv_node_map_add_null(ta_parent, &reply_node, "data");
+            mpv_node_map_add_null(ta_parent, reply_node, "data");
         } else {
-            mpv_node_map_add_string(ta_parent, &reply_node, "data", result);
+            mpv_node_map_add_string(ta_parent, reply_node, "data", result);
             mpv_free(result);
         }
     } else if (!strcmp("set_property", cmd)) {
@@ -371,6 +390,36 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
 
         rc = mpv_unobserve_property(client,
                                     cmd_node->u.list->values[1].u.int64);
+    } else if (!strcmp("set_observe_property_rate", cmd) ||
+               !strcmp("set_observe_property_threshold", cmd))
+    {
+        if (cmd_node->u.list->num != 3) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        if (cmd_node->u.list->values[1].format != MPV_FORMAT_INT64) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        mpv_node *val = &cmd_node->u.list->values[2];
+        double v;
+        if (val->format == MPV_FORMAT_INT64) {
+            v = val->u.int64;
+        } else if (val->format == MPV_FORMAT_DOUBLE) {
+            v = val->u.double_;
+        } else {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        int64_t id = cmd_node->u.list->values[1].u.int64;
+        if (!strcmp("set_observe_property_rate", cmd)) {
+            rc = mpv_set_observe_property_rate(client, id, v);
+        } else {
+            rc = mpv_set_observe_property_threshold(client, id, v);
+        }
     } else if (!strcmp("request_log_messages", cmd)) {
         if (cmd_node->u.list->num != 2) {
             rc = MPV_ERROR_INVALID_PARAMETER;
@@ -422,7 +471,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
 
         rc = mpv_command_node(client, cmd_node, &result_node);
         if (rc >= 0)
-            mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
+            mpv_node_map_add(ta_parent, reply_node, "data", &result_node);
     }
 
 error:
@@ -431,10 +480,27 @@ error:
      * the original requests.
      */
     if (reqid_node) {
-        mpv_node_map_add(ta_parent, &reply_node, "request_id", reqid_node);
+        mpv_node_map_add(ta_parent, reply_node, "request_id", reqid_node);
     }
 
-    mpv_node_map_add_string(ta_parent, &reply_node, "error", mpv_error_string(rc));
+    mpv_node_map_add_string(ta_parent, reply_node, "error", mpv_error_string(rc));
+}
+
+// Function is allowed to modify src[n].
+static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
+                                  char *src, int *format)
+{
+    struct mp_log *log = mp_client_get_log(client);
+
+    mpv_node msg_node;
+    mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+
+    bool ok = json_parse(ta_parent, &msg_node, &src, 50) >= 0;
+    if (!ok)
+        mp_err(log, "malformed JSON received: '%s'\n", src);
+
+    execute_command_node(client, ta_parent, ok ? &msg_node : NULL, &reply_node,
+                         format);
 
     char *output = talloc_strdup(ta_parent, "");
     json_write(&output, &reply_node);
@@ -443,6 +509,55 @@ error:
     return output;
 }
 
+// Append node as length-prefixed MessagePack frame.
+static void msgpack_write_frame(void *ta_parent, bstr *dst, mpv_node *node)
+{
+    size_t start = dst->len;
+    bstr_xappend(ta_parent, dst, (bstr){(unsigned char *)"\0\0\0\0", 4});
+    msgpack_write(ta_parent, dst, node);
+    uint32_t len = dst->len - start - 4;
+    for (int n = 0; n < 4; n++)
+        dst->start[start + n] = len >> ((3 - n) * 8);
+}
+
+static bstr msgpack_execute_command(struct mpv_handle *client, void *ta_parent,
+                                    bstr src, int *format)
+{
+    struct mp_log *log = mp_client_get_log(client);
+
+    mpv_node msg_node;
+    mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+
+    bool ok = msgpack_parse(ta_parent, &msg_node, &src, 50) >= 0 && !src.len;
+    if (!ok)
+        mp_err(log, "malformed MessagePack frame received\n");
+
+    execute_command_node(client, ta_parent, ok ? &msg_node : NULL, &reply_node,
+                         format);
+
+    bstr output = {0};
+    msgpack_write_frame(ta_parent, &output, &reply_node);
+    return output;
+}
+
+bstr mp_ipc_encode_event(void *ta_parent, struct mpv_event *event, int format)
+{
+    if (format == MP_IPC_FORMAT_JSON) {
+        char *msg = mp_json_encode_event(event);
+        return bstr0(talloc_steal(ta_parent, msg));
+    }
+
+    void *tmp = talloc_new_arena(NULL);
+    mpv_node event_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+    mpv_event_to_node(tmp, event, &event_node);
+
+    bstr output = {0};
+    msgpack_write_frame(ta_parent, &output, &event_node);
+
+    talloc_free(tmp);
+    return output;
+}
+
 static char *text_execute_command(struct mpv_handle *client, void *tmp, char *src)
 {
     mpv_command_string(client, src);
@@ -450,15 +565,25 @@ static char *text_execute_command(struct mpv_handle *client, void *tmp, char *sr
     return NULL;
 }
 
-char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf)
+// Remove everything before rest (which must point into *buf) from *buf. The
+// buffer allocation is kept, so it can be reused for following input.
+static void consume_buffer(bstr *buf, bstr rest)
+{
+    memmove(buf->start, rest.start, rest.len);
+    buf->len = rest.len;
+    buf->start[buf->len] = '\0';
+}
+
+static char *consume_next_command(struct mpv_handle *client, void *ctx,
+                                  bstr *buf, int *format)
 {
-    void *tmp = talloc_new(NULL);
+    // All temporary allocations (the request and reply trees) are freed at once.
+    void *tmp = talloc_new_arena(NULL);
 
     bstr rest;
     bstr line = bstr_getline(*buf, &rest);
     char *line0 = bstrto0(tmp, line);
-    talloc_steal(tmp, buf->start);
-    *buf = bstrdup(NULL, rest);
+    consume_buffer(buf, rest);
 
     json_skip_whitespace(&line0);
 
@@ -466,12 +591,54 @@ char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *bu
     if (line0[0] == '\0' || line0[0] == '#') {
         // skip
     } else if (line0[0] == '{') {
-        reply_msg = json_execute_command(client, tmp, line0);
+        reply_msg = json_execute_command(client, tmp, line0, format);
     } else {
         reply_msg = text_execute_command(client, tmp, line0);
     }
 
-    talloc_steal(ctx, reply_msg);
+    // (Can't steal the reply out of the arena.)
+    reply_msg = talloc_strdup(ctx, reply_msg);
     talloc_free(tmp);
     return reply_msg;
 }
+
+char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf)
+{
+    return consume_next_command(client, ctx, buf, NULL);
+}
+
+int mp_ipc_consume_next_message(struct mpv_handle *client, void *ctx,
+                                bstr *buf, int *format, bstr *reply)
+{
+    *reply = (bstr){0};
+
+    if (*format == MP_IPC_FORMAT_JSON) {
+        if (bstrchr(*buf, '\n') < 0)
+            return 0;
+        char *msg = consume_next_command(client, ctx, buf, format);
+        *reply = bstr0(msg);
+        return 1;
+    }
+
+    if (buf->len < 4)
+        return 0;
+    uint32_t len = 0;
+    for (int n = 0; n < 4; n++)
+        len = (len << 8) | buf->start[n];
+    if (len > MAX_MSGPACK_FRAME) {
+        mp_err(mp_client_get_log(client), "MessagePack frame too large\n");
+        return -1;
+    }
+    if (buf->len - 4 < len)
+        return 0;
+
+    void *tmp = talloc_new_arena(NULL);
+    // msgpack_parse() copies everything it needs, so parse the frame in place.
+    bstr frame = bstr_splice(*buf, 4, 4 + len);
+    bstr out = msgpack_execute_command(client, tmp, frame, format);
+    *reply = (bstr){talloc_memdup(ctx, out.start, out.len), out.len};
+    consume_buffer(buf, bstr_cut(*buf, 4 + len));
+
+    talloc_free(tmp);
+    return 1;
+}
@@ -163,7 +163,7 @@ extern "C" {
  * Embedding the video window
  * --------------------------
  *
- * Using the opengl-cb API (in opengl_cb.h) is recommended. This API requires
+ * Using the render API (in render.h) is recommended. This API requires
  * you to create and maintain an OpenGL context, to which you can render
  * video using a specific API call. This API does not include keyboard or mouse
  * input directly.
@@ -209,7 +209,7 @@ extern "C" {
  * relational operators (<, >, <=, >=).
  */
 #define MPV_MAKE_VERSION(major, minor) (((major) << 16) | (minor) | 0UL)
-#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(1, 26)
+#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(1, 32)
 
 /**
  * The API user is allowed to "#define MPV_ENABLE_DEPRECATED 0" before
@@ -968,6 +968,17 @@ int mpv_command_node_async(mpv_handle *ctx, uint64_t reply_userdata,
 int mpv_set_property(mpv_handle *ctx, const char *name, mpv_format format,
                      void *data);
 
+/**
+ * Set multiple properties at once. This is equivalent to calling
+ * mpv_set_property() with MPV_FORMAT_NODE for each entry of the map, in order,
+ * except that all properties are set with a single access to the player core.
+ *
+ * @param properties a MPV_FORMAT_NODE_MAP that maps property names to values
+ * @return error code of the first property that could not be set, or 0 if all
+ *         of them were set (properties after a failing one are still set)
+ */
+int mpv_set_property_multi(mpv_handle *ctx, mpv_node *properties);
+
 /**
  * Convenience function to set a property to a string value.
  *
@@ -1036,6 +1047,30 @@ char *mpv_get_property_string(mpv_handle *ctx, const char *name);
  */
 char *mpv_get_property_osd_string(mpv_handle *ctx, const char *name);
 
+/**
+ * Read multiple properties at once. This is equivalent to calling
+ * mpv_get_property() for each of them, except that all properties are read
+ * with a single access to the player core, so the values are consistent with
+ * each other, and the overhead of repeated synchronization is avoided.
+ *
+ * The result is a MPV_FORMAT_NODE_MAP, which maps each property name to its
+ * value. If a property could not be read, its value has MPV_FORMAT_NONE. Free
+ * the result with mpv_free_node_contents().
+ *
+ * @param names array of property names, with num_names entries
+ * @param formats array of formats (see enum mpv_format) with num_names
+ *                entries, which selects the type of the value for each
+ *                property. MPV_FORMAT_STRING and MPV_FORMAT_OSD_STRING values
+ *                are returned as string nodes. Can be NULL, which is the same
+ *                as passing MPV_FORMAT_NODE for all properties.
+ * @param num_names number of properties
+ * @param[out] result map of property values
+ * @return error code; errors of individual properties are not reported here
+ */
+int mpv_get_property_multi(mpv_handle *ctx, const char **names,
+                           const mpv_format *formats, int num_names,
+                           mpv_node *result);
+
 /**
  * Get a property asynchronously. You will receive the result of the operation
  * as well as the property data with the MPV_EVENT_GET_PROPERTY_REPLY event.
@@ -1109,6 +1144,48 @@ int mpv_observe_property(mpv_handle *mpv, uint64_t reply_userdata,
  */
 int mpv_unobserve_property(mpv_handle *mpv, uint64_t registered_reply_userdata);
 
+/**
+ * Limit the rate of MPV_EVENT_PROPERTY_CHANGE events for all properties which
+ * were observed with the given reply_userdata. Changes that happen more often
+ * are coalesced: the property is not read again until the interval has passed,
+ * and then a single change event with the current value is returned. This is
+ * useful for properties which change very often, like "time-pos".
+ *
+ * The limit applies to properties observed before this call only.
+ *
+ * @param registered_reply_userdata ID that was passed to mpv_observe_property
+ * @param max_rate maximum number of change events per second for each of the
+ *                 properties, or 0 to remove the limit
+ * @return negative value is an error code, >=0 is number of affected
+ *         properties on success
+ */
+int mpv_set_observe_property_rate(mpv_handle *mpv,
+                                  uint64_t registered_reply_userdata,
+                                  double max_rate);
+
+/**
+ * Suppress MPV_EVENT_PROPERTY_CHANGE events for small changes of numeric
+ * properties which were observed with the given reply_userdata. A change is
+ * reported only if the new value differs from the value returned with the last
+ * change event by at least the given threshold. (Small changes accumulate, so
+ * the reported value never drifts by more than the threshold.)
+ *
+ * This applies to properties observed with MPV_FORMAT_INT64, MPV_FORMAT_DOUBLE
+ * and MPV_FORMAT_NODE (if the value is a number). Other properties and changes
+ * between available and unavailable are always reported. It can be combined
+ * with mpv_set_observe_property_rate().
+ *
+ * The threshold applies to properties observed before this call only.
+ *
+ * @param registered_reply_userdata ID that was passed to mpv_observe_property
+ * @param threshold minimum absolute change, or 0 to report all changes
+ * @return negative value is an error code, >=0 is number of affected
+ *         properties on success
+ */
+int mpv_set_observe_property_threshold(mpv_handle *mpv,
+                                       uint64_t registered_reply_userdata,
+                                       double threshold);
+
 typedef enum mpv_event_id {
     /**
      * Nothing happened. Happens on timeouts or sporadic wakeups.
@@ -0,0 +1,141 @@
+/* Copyright (C) 2018 the mpv developers
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef MPV_CLIENT_API_FRAME_TAP_H_
+#define MPV_CLIENT_API_FRAME_TAP_H_
+
+#include "client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Warning: this API is not stable yet.
+ *
+ * Overview
+ * --------
+ *
+ * This API lets a client receive the video frames the player displays, after
+ * decoding and video filtering, without decoding the video a second time (for
+ * example for analysis or thumbnails). The frames are tapped from the video
+ * output chain of the mpv instance the mpv_handle belongs to.
+ *
+ * Usage
+ * -----
+ *
+ * Call mpv_frame_tap_enable() to start receiving frames. Each newly filtered
+ * frame is then added to a per-mpv_handle queue, and the client is woken up
+ * the same way as for new events (mpv_set_wakeup_callback(), mpv_wait_event()
+ * returning). Call mpv_frame_tap_get() until it returns NULL to fetch the
+ * queued frames.
+ *
+ * The queue holds only references to the frames, so tapping a frame costs
+ * almost nothing on the playback thread. Hardware decoded frames are copied
+ * to system memory, converted and scaled in mpv_frame_tap_get(), on the thread
+ * calling it.
+ *
+ * Frame dropping
+ * --------------
+ *
+ * If the client doesn't fetch frames fast enough, the oldest queued frames are
+ * dropped. Playback is never slowed down by a client. mpv_frame.dropped tells
+ * how many frames were dropped before a frame.
+ *
+ * Note that with hardware decoding, queued frames keep decoder surfaces
+ * referenced, so use small queue sizes.
+ *
+ * Frames are also dropped when the video output chain is destroyed (e.g. on
+ * switching to the next file or disabling video).
+ */
+
+/**
+ * A video frame returned by mpv_frame_tap_get(). All fields are read-only, and
+ * the frame stays valid until mpv_frame_free() is called on it.
+ */
+typedef struct mpv_frame {
+    /**
+     * Image format name, e.g. "yuv420p" or "nv12". These are the same names
+     * as used by --vf=format.
+     */
+    const char *format;
+    /**
+     * Size of the frame in pixels.
+     */
+    int w, h;
+    /**
+     * Number of planes, and pointers and line sizes (in bytes) of each plane.
+     */
+    int num_planes;
+    unsigned char *planes[4];
+    int stride[4];
+    /**
+     * Playback time of the frame in seconds, on the same timeline as the
+     * "time-pos" property.
+     */
+    double pts;
+    /**
+     * Number of frames dropped between the previous returned frame and this
+     * one, because the queue was full.
+     */
+    int64_t dropped;
+    /**
+     * Private data; do not touch.
+     */
+    void *priv;
+} mpv_frame;
+
+/**
+ * Enable, reconfigure or disable the frame tap for this mpv_handle. Frames
+ * already queued are kept (up to the new queue size), and are converted to
+ * the new format and size when fetched.
+ *
+ * @param queue_size maximum number of queued frames (1-64), or 0 to
+ *                   disable the frame tap and drop all queued frames
+ * @param format image format name the frames are converted to, or NULL to
+ *               return frames in the format they were decoded/filtered in
+ *               (hardware decoded frames are returned in the format they are
+ *               copied to system memory in)
+ * @param max_w, max_h if >0, frames larger than this are downscaled to fit,
+ *                     keeping their aspect ratio
+ * @return error code (MPV_ERROR_INVALID_PARAMETER for unknown formats or
+ *         out of range parameters)
+ */
+int mpv_frame_tap_enable(mpv_handle *ctx, int queue_size, const char *format,
+                         int max_w, int max_h);
+
+/**
+ * Return the oldest queued frame, and remove it from the queue. This never
+ * blocks waiting for new frames.
+ *
+ * This function is thread-safe, but the conversion is done while the frame is
+ * not in the queue anymore, so multiple threads fetching frames from the same
+ * mpv_handle can return them out of order.
+ *
+ * @return the frame (free it with mpv_frame_free()), or NULL if no frame is
+ *         queued, the frame tap is disabled, or the conversion failed
+ */
+mpv_frame *mpv_frame_tap_get(mpv_handle *ctx);
+
+/**
+ * Free a frame returned by mpv_frame_tap_get(). Does nothing if frame is NULL.
+ */
+void mpv_frame_free(mpv_frame *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -27,6 +27,10 @@ extern "C" {
  * Overview
  * --------
  *
+ * Warning: this API is deprecated. New code should use render.h and
+ * render_gl.h. The functions here are implemented as a thin wrapper around
+ * the mpv_render_context API, and will be removed eventually.
+ *
  * This API can be used to make mpv render into a foreign OpenGL context. It
  * can be used to handle video display.
  *
@@ -139,6 +139,30 @@ typedef int64_t (*mpv_stream_cb_seek_fn)(void *cookie, int64_t offset);
  */
 typedef int64_t (*mpv_stream_cb_size_fn)(void *cookie);
 
+/**
+ * Prefetch callback used to implement a custom stream.
+ *
+ * This is a hint that mpv expects to read the given byte range soon. Streams
+ * with high latency can use it to start fetching the data in the background,
+ * so that later read_fn calls can be served without waiting. The callback
+ * must not block. mpv may never read the hinted range (e.g. if the user
+ * seeks), and ranges may overlap with previously hinted ones.
+ *
+ * Currently, mpv hints a fixed amount of data ahead of the current read
+ * position after opening, after each seek, and whenever reading has consumed
+ * half of the previously hinted range. This is an implementation detail and
+ * may change.
+ *
+ * This callback can be NULL.
+ *
+ * @param cookie opaque cookie identifying the stream,
+ *               returned from mpv_stream_cb_open_fn
+ * @param offset absolute stream position of the start of the range
+ * @param nbytes size of the range in bytes
+ */
+typedef void (*mpv_stream_cb_prefetch_fn)(void *cookie, int64_t offset,
+                                          uint64_t nbytes);
+
 /**
  * Close callback used to implement a custom stream.
  *
@@ -170,6 +194,12 @@ typedef struct mpv_stream_cb_info {
     mpv_stream_cb_seek_fn seek_fn;
     mpv_stream_cb_size_fn size_fn;
     mpv_stream_cb_close_fn close_fn;
+
+    /**
+     * Optional, added in API version 1.31. Set this only if the libmpv you
+     * run against has at least this version (see mpv_client_api_version()).
+     */
+    mpv_stream_cb_prefetch_fn prefetch_fn;
 } mpv_stream_cb_info;
 
 /**
@@ -26,6 +26,7 @@
 
 #include "config.h"
 
+#include "common/common.h"
 #include "common/msg.h"
 
 #if HAVE_UCHARDET
@@ -64,11 +65,16 @@ static const char *ms_bom_guess(bstr buf)
 }
 
 #if HAVE_UCHARDET
+// Amount of data given to uchardet. The statistics it uses settle long before
+// this, and typical subtitle files are smaller anyway.
+#define UCHARDET_MAX_PROBE (256 * 1024)
+
 static const char *mp_uchardet(void *talloc_ctx, struct mp_log *log, bstr buf)
 {
     uchardet_t det = uchardet_new();
     if (!det)
         return NULL;
+    buf = bstr_splice(buf, 0, MPMIN(buf.len, UCHARDET_MAX_PROBE));
     if (uchardet_handle_data(det, buf.start, buf.len) != 0) {
         uchardet_delete(det);
         return NULL;
@@ -147,29 +153,33 @@ const char *mp_charset_guess(void *talloc_ctx, struct mp_log *log,  bstr buf,
     return res;
 }
 
-// Use iconv to convert buf to UTF-8.
-// Returns buf.start==NULL on error. Returns buf if cp is NULL, or if there is
-// obviously no conversion required (e.g. if cp is "UTF-8").
-// Returns a newly allocated buffer if conversion is done and succeeds. The
-// buffer will be terminated with 0 for convenience (the terminating 0 is not
-// included in the returned length).
-// Free the returned buffer with talloc_free().
-//  buf: input data
-//  cp: iconv codepage (or NULL)
-//  flags: combination of MP_ICONV_* flags
-//  returns: buf (no conversion), .start==NULL (error), or allocated buffer
-bstr mp_iconv_to_utf8(struct mp_log *log, bstr buf, const char *cp, int flags)
-{
+struct mp_iconv {
+    struct mp_log *log;
+    char *cp;
+    int flags;
 #if HAVE_ICONV
-    if (!cp || !cp[0] || mp_charset_is_utf8(cp))
-        return buf;
-
-    if (strcasecmp(cp, "ASCII") == 0)
-        return buf;
+    iconv_t icdsc;
+#endif
+};
 
-    if (strcasecmp(cp, "UTF-8-BROKEN") == 0)
-        return bstr_sanitize_utf8_latin1(NULL, buf);
+#if HAVE_ICONV
+static void destroy_iconv(void *p)
+{
+    struct mp_iconv *ic = p;
+    iconv_close(ic->icdsc);
+}
+#endif
 
+// Create an incremental converter from cp to UTF-8. Returns NULL if cp is not
+// supported by iconv (or iconv is not available). Free with talloc_free().
+// Unlike mp_iconv_to_utf8(), this does not handle the pseudo codepages like
+// "UTF-8-BROKEN", and does not treat UTF-8 or ASCII as special case.
+//  cp: iconv codepage
+//  flags: combination of MP_ICONV_VERBOSE and MP_ICONV_ALLOW_CUTOFF
+struct mp_iconv *mp_iconv_create(void *talloc_ctx, struct mp_log *log,
+                                 const char *cp, int flags)
+{
+#if HAVE_ICONV
     // Force CP949 over EUC-KR since iconv distinguishes them and
     // EUC-KR causes error on CP949 encoded data
     if (strcasecmp(cp, "EUC-KR") == 0)
@@ -179,58 +189,126 @@ bstr mp_iconv_to_utf8(struct mp_log *log, bstr buf, const char *cp, int flags)
     if ((icdsc = iconv_open("UTF-8", cp)) == (iconv_t) (-1)) {
         if (flags & MP_ICONV_VERBOSE)
             mp_err(log, "Error opening iconv with codepage '%s'\n", cp);
-        goto failure;
+        return NULL;
     }
 
-    size_t size = buf.len;
-    size_t osize = size;
-    size_t ileft = size;
-    size_t oleft = size - 1;
+    struct mp_iconv *ic = talloc_ptrtype(talloc_ctx, ic);
+    *ic = (struct mp_iconv){
+        .log = log,
+        .cp = talloc_strdup(ic, cp),
+        .flags = flags,
+        .icdsc = icdsc,
+    };
+    talloc_set_destructor(ic, destroy_iconv);
+    return ic;
+#else
+    return NULL;
+#endif
+}
 
-    char *outbuf = talloc_size(NULL, osize);
-    char *ip = buf.start;
-    char *op = outbuf;
+// Convert the data in *in, and append the result to *out. out->start must be
+// NULL or a talloc allocation (parented to talloc_ctx if it's NULL); it is
+// reallocated as needed, and always terminated with 0 (not included in
+// out->len). *in is advanced past the consumed data. If final is false, an
+// incomplete multibyte sequence at the end of the input is left in *in, and
+// should be passed again, prepended to the next chunk of data.
+// Returns false on conversion errors.
+bool mp_iconv_convert(struct mp_iconv *ic, void *talloc_ctx, bstr *out,
+                      bstr *in, bool final)
+{
+#if HAVE_ICONV
+    size_t size = out->start ? talloc_get_size(out->start) : 0;
+    // Typically, at least as much output as input is needed.
+    size_t min_size = out->len + MPMAX(in->len, 16) + 1;
+    if (size < min_size) {
+        size = min_size;
+        out->start = talloc_realloc_size(talloc_ctx, out->start, size);
+    }
 
-    while (1) {
-        int clear = 0;
+    bool flushed = false;
+    while (!flushed) {
+        char *ip = (char *)in->start;
+        size_t ileft = in->len;
+        char *op = (char *)out->start + out->len;
+        size_t oleft = size - out->len - 1;
         size_t rc;
-        if (ileft)
-            rc = iconv(icdsc, &ip, &ileft, &op, &oleft);
-        else {
-            clear = 1; // clear the conversion state and leave
-            rc = iconv(icdsc, NULL, NULL, &op, &oleft);
+        if (ileft) {
+            rc = iconv(ic->icdsc, &ip, &ileft, &op, &oleft);
+        } else if (final) {
+            flushed = true; // clear the conversion state and leave
+            rc = iconv(ic->icdsc, NULL, NULL, &op, &oleft);
+        } else {
+            break;
         }
+        out->len = op - (char *)out->start;
+        *in = bstr_cut(*in, in->len - ileft);
         if (rc == (size_t) (-1)) {
             if (errno == E2BIG) {
-                size_t offset = op - outbuf;
-                outbuf = talloc_realloc_size(NULL, outbuf, osize + size);
-                op = outbuf + offset;
-                osize += size;
-                oleft += size;
+                flushed = false;
+                size += MPMAX(size / 2, 64);
+                out->start = talloc_realloc_size(talloc_ctx, out->start, size);
+            } else if (errno == EINVAL && !final) {
+                break; // incomplete multibyte sequence at the end of the chunk
             } else {
-                if (errno == EINVAL && (flags & MP_ICONV_ALLOW_CUTOFF)) {
+                if (errno == EINVAL && (ic->flags & MP_ICONV_ALLOW_CUTOFF)) {
                     // This is intended for cases where the input buffer is cut
                     // at a random byte position. If this happens in the middle
                     // of the buffer, it should still be an error. We say it's
                     // fine if the error is within 10 bytes of the end.
-                    if (ileft <= 10)
+                    if (in->len <= 10)
                         break;
                 }
-                if (flags & MP_ICONV_VERBOSE) {
-                    mp_err(log, "Error recoding text with codepage '%s'\n", cp);
+                if (ic->flags & MP_ICONV_VERBOSE) {
+                    mp_err(ic->log, "Error recoding text with codepage '%s'\n",
+                           ic->cp);
                 }
-                talloc_free(outbuf);
-                iconv_close(icdsc);
-                goto failure;
+                out->start[out->len] = 0;
+                return false;
             }
-        } else if (clear)
-            break;
+        }
     }
 
-    iconv_close(icdsc);
+    out->start[out->len] = 0;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Use iconv to convert buf to UTF-8.
+// Returns buf.start==NULL on error. Returns buf if cp is NULL, or if there is
+// obviously no conversion required (e.g. if cp is "UTF-8").
+// Returns a newly allocated buffer if conversion is done and succeeds. The
+// buffer will be terminated with 0 for convenience (the terminating 0 is not
+// included in the returned length).
+// Free the returned buffer with talloc_free().
+//  buf: input data
+//  cp: iconv codepage (or NULL)
+//  flags: combination of MP_ICONV_* flags
+//  returns: buf (no conversion), .start==NULL (error), or allocated buffer
+bstr mp_iconv_to_utf8(struct mp_log *log, bstr buf, const char *cp, int flags)
+{
+#if HAVE_ICONV
+    if (!cp || !cp[0] || mp_charset_is_utf8(cp))
+        return buf;
+
+    if (strcasecmp(cp, "ASCII") == 0)
+        return buf;
+
+    if (strcasecmp(cp, "UTF-8-BROKEN") == 0)
+        return bstr_sanitize_utf8_latin1(NULL, buf);
+
+    struct mp_iconv *ic = mp_iconv_create(NULL, log, cp, flags);
+    if (!ic)
+        goto failure;
 
-    outbuf[osize - oleft - 1] = 0;
-    return (bstr){outbuf, osize - oleft - 1};
+    bstr out = {0};
+    bstr in = buf;
+    bool ok = mp_iconv_convert(ic, NULL, &out, &in, true);
+    talloc_free(ic);
+    if (ok)
+        return out;
+    talloc_free(out.start);
 #endif
 
 failure:
@@ -5,6 +5,7 @@
 #include "misc/bstr.h"
 
 struct mp_log;
+struct mp_iconv;
 
 enum {
     MP_ICONV_VERBOSE = 1,       // print errors instead of failing silently
@@ -17,6 +18,10 @@ bool mp_charset_is_utf8(const char *user_cp);
 bool mp_charset_is_utf16(const char *user_cp);
 const char *mp_charset_guess(void *talloc_ctx, struct mp_log *log, bstr buf,
                              const char *user_cp, int flags);
+struct mp_iconv *mp_iconv_create(void *talloc_ctx, struct mp_log *log,
+                                 const char *cp, int flags);
+bool mp_iconv_convert(struct mp_iconv *ic, void *talloc_ctx, bstr *out,
+                      bstr *in, bool final);
 bstr mp_iconv_to_utf8(struct mp_log *log, bstr buf, const char *cp, int flags);
 
 #endif
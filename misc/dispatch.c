@@ -19,6 +19,7 @@
 #include <assert.h>
 
 #include "common/common.h"
+#include "common/stats.h"
 #include "osdep/threads.h"
 #include "osdep/timer.h"
 
@@ -26,6 +27,10 @@
 
 struct mp_dispatch_queue {
     struct mp_dispatch_item *head, *tail;
+    // Last item that is not a background item (head..last_normal are the
+    // normal items, the rest are background items).
+    struct mp_dispatch_item *last_normal;
+    struct stats_ctx *stats;
     pthread_mutex_t lock;
     pthread_cond_t cond;
     void (*wakeup_fn)(void *wakeup_ctx);
@@ -60,7 +65,9 @@ struct mp_dispatch_item {
     void *fn_data;
     bool asynchronous;
     bool mergeable;
+    bool background;
     bool completed;
+    int64_t enqueue_time;
     struct mp_dispatch_item *next;
 };
 
@@ -68,6 +75,7 @@ static void queue_dtor(void *p)
 {
     struct mp_dispatch_queue *queue = p;
     assert(!queue->head);
+    assert(!queue->last_normal);
     assert(!queue->idling);
     assert(!queue->lock_request);
     assert(!queue->frame);
@@ -110,6 +118,14 @@ void mp_dispatch_set_wakeup_fn(struct mp_dispatch_queue *queue,
     queue->wakeup_ctx = wakeup_ctx;
 }
 
+// Record how long items wait in the queue before they're run, as "wait" and
+// "wait-background" latency stats. stats must outlive the queue.
+void mp_dispatch_set_stats(struct mp_dispatch_queue *queue,
+                           struct stats_ctx *stats)
+{
+    queue->stats = stats;
+}
+
 static void mp_dispatch_append(struct mp_dispatch_queue *queue,
                                struct mp_dispatch_item *item)
 {
@@ -126,12 +142,25 @@ static void mp_dispatch_append(struct mp_dispatch_queue *queue,
         }
     }
 
-    if (queue->tail) {
-        queue->tail->next = item;
+    item->enqueue_time = queue->stats ? mp_time_us() : 0;
+
+    if (item->background) {
+        if (queue->tail) {
+            queue->tail->next = item;
+        } else {
+            queue->head = item;
+        }
+        queue->tail = item;
     } else {
-        queue->head = item;
+        // Insert before the background items.
+        struct mp_dispatch_item **pnext =
+            queue->last_normal ? &queue->last_normal->next : &queue->head;
+        item->next = *pnext;
+        *pnext = item;
+        if (!item->next)
+            queue->tail = item;
+        queue->last_normal = item;
     }
-    queue->tail = item;
 
     // Wake up the main thread; note that other threads might wait on this
     // condition for reasons, so broadcast the condition.
@@ -194,10 +223,28 @@ void mp_dispatch_enqueue_notify(struct mp_dispatch_queue *queue,
     mp_dispatch_append(queue, item);
 }
 
+// Like mp_dispatch_enqueue(), but the item is run only after all other items
+// queued at this point or later (that are not background items themselves).
+// Use this for work that is not time-critical and has no ordering requirements
+// relative to other items, so that it can't delay more important requests.
+void mp_dispatch_enqueue_background(struct mp_dispatch_queue *queue,
+                                    mp_dispatch_fn fn, void *fn_data)
+{
+    struct mp_dispatch_item *item = talloc_ptrtype(NULL, item);
+    *item = (struct mp_dispatch_item){
+        .fn = fn,
+        .fn_data = fn_data,
+        .asynchronous = true,
+        .background = true,
+    };
+    mp_dispatch_append(queue, item);
+}
+
 // Remove already queued item. Only items enqueued with the following functions
 // can be canceled:
 //  - mp_dispatch_enqueue()
 //  - mp_dispatch_enqueue_notify()
+//  - mp_dispatch_enqueue_background()
 // Items which were enqueued, and which are currently executing, can not be
 // canceled anymore. This function is mostly for being called from the same
 // context as mp_dispatch_queue_process(), where the "currently executing" case
@@ -208,6 +255,7 @@ void mp_dispatch_cancel_fn(struct mp_dispatch_queue *queue,
     pthread_mutex_lock(&queue->lock);
     struct mp_dispatch_item **pcur = &queue->head;
     queue->tail = NULL;
+    queue->last_normal = NULL;
     while (*pcur) {
         struct mp_dispatch_item *cur = *pcur;
         if (cur->fn == fn && cur->fn_data == fn_data) {
@@ -215,6 +263,8 @@ void mp_dispatch_cancel_fn(struct mp_dispatch_queue *queue,
             talloc_free(cur);
         } else {
             queue->tail = cur;
+            if (!cur->background)
+                queue->last_normal = cur;
             pcur = &cur->next;
         }
     }
@@ -286,7 +336,14 @@ void mp_dispatch_queue_process(struct mp_dispatch_queue *queue, double timeout)
             queue->head = item->next;
             if (!queue->head)
                 queue->tail = NULL;
+            if (queue->last_normal == item)
+                queue->last_normal = NULL;
             item->next = NULL;
+            if (queue->stats) {
+                stats_time_add(queue->stats,
+                               item->background ? "wait-background" : "wait",
+                               mp_time_us() - item->enqueue_time);
+            }
             // Unlock, because we want to allow other threads to queue items
             // while the dispatch item is processed.
             // At the same time, we must prevent other threads from returning
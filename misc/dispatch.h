@@ -3,17 +3,22 @@
 
 typedef void (*mp_dispatch_fn)(void *data);
 struct mp_dispatch_queue;
+struct stats_ctx;
 
 struct mp_dispatch_queue *mp_dispatch_create(void *talloc_parent);
 void mp_dispatch_set_wakeup_fn(struct mp_dispatch_queue *queue,
                                void (*wakeup_fn)(void *wakeup_ctx),
                                void *wakeup_ctx);
+void mp_dispatch_set_stats(struct mp_dispatch_queue *queue,
+                           struct stats_ctx *stats);
 void mp_dispatch_enqueue(struct mp_dispatch_queue *queue,
                          mp_dispatch_fn fn, void *fn_data);
 void mp_dispatch_enqueue_autofree(struct mp_dispatch_queue *queue,
                                   mp_dispatch_fn fn, void *fn_data);
 void mp_dispatch_enqueue_notify(struct mp_dispatch_queue *queue,
                                 mp_dispatch_fn fn, void *fn_data);
+void mp_dispatch_enqueue_background(struct mp_dispatch_queue *queue,
+                                    mp_dispatch_fn fn, void *fn_data);
 void mp_dispatch_cancel_fn(struct mp_dispatch_queue *queue,
                            mp_dispatch_fn fn, void *fn_data);
 void mp_dispatch_run(struct mp_dispatch_queue *queue,
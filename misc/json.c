@@ -228,7 +228,9 @@ static void write_json_str(bstr *b, unsigned char *str)
         if (!cur[0])
             break;
         bstr_xappend(NULL, b, (bstr){str, cur - str});
-        bstr_xappend_asprintf(NULL, b, "\\u%04x", (unsigned char)cur[0]);
+        char esc[8];
+        snprintf(esc, sizeof(esc), "\\u%04x", (unsigned char)cur[0]);
+        APPEND(b, esc);
         str = cur + 1;
     }
     APPEND(b, str);
@@ -253,9 +255,12 @@ static int json_append(bstr *b, const struct mpv_node *src, int indent)
     case MPV_FORMAT_FLAG:
         APPEND(b, src->u.flag ? "true" : "false");
         return 0;
-    case MPV_FORMAT_INT64:
-        bstr_xappend_asprintf(NULL, b, "%"PRId64, src->u.int64);
+    case MPV_FORMAT_INT64: {
+        char num[32];
+        snprintf(num, sizeof(num), "%"PRId64, src->u.int64);
+        APPEND(b, num);
         return 0;
+    }
     case MPV_FORMAT_DOUBLE:
         bstr_xappend_asprintf(NULL, b, "%f", src->u.double_);
         return 0;
@@ -0,0 +1,279 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* MessagePack parser and writer for mpv_node.
+ *
+ * Supports the types that map to mpv_node: nil, bool, integers, floats, str,
+ * array and map. bin is accepted as string. Map keys must be strings. Unsigned
+ * integers larger than INT64_MAX and ext types are rejected.
+ *
+ * Also see: https://github.com/msgpack/msgpack/blob/master/spec.md
+ */
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "common/common.h"
+
+#include "msgpack.h"
+
+static bool read_bytes(bstr *src, void *dst, size_t len)
+{
+    if (src->len < len)
+        return false;
+    memcpy(dst, src->start, len);
+    *src = bstr_cut(*src, len);
+    return true;
+}
+
+static bool read_be(bstr *src, int bytes, uint64_t *out)
+{
+    uint8_t buf[8];
+    if (!read_bytes(src, buf, bytes))
+        return false;
+    uint64_t v = 0;
+    for (int n = 0; n < bytes; n++)
+        v = (v << 8) | buf[n];
+    *out = v;
+    return true;
+}
+
+static int read_str(void *ta_parent, struct mpv_node *dst, bstr *src,
+                    uint64_t len)
+{
+    if (src->len < len)
+        return -1;
+    dst->format = MPV_FORMAT_STRING;
+    dst->u.string = bstrdup0(ta_parent, (bstr){src->start, len});
+    *src = bstr_cut(*src, len);
+    return 0;
+}
+
+static int read_sub(void *ta_parent, struct mpv_node *dst, bstr *src,
+                    uint64_t num, bool is_map, int max_depth)
+{
+    // Each entry needs at least 1 byte; reject bogus sizes early.
+    if (num > src->len)
+        return -1;
+    struct mpv_node_list *list = talloc_zero(ta_parent, struct mpv_node_list);
+    for (uint64_t n = 0; n < num; n++) {
+        if (is_map) {
+            struct mpv_node keynode;
+            if (msgpack_parse(list, &keynode, src, max_depth) < 0)
+                return -1;
+            if (keynode.format != MPV_FORMAT_STRING)
+                return -1; // key is not a string
+            MP_TARRAY_GROW(list, list->keys, list->num);
+            list->keys[list->num] = keynode.u.string;
+        }
+        MP_TARRAY_GROW(list, list->values, list->num);
+        if (msgpack_parse(list, &list->values[list->num], src, max_depth) < 0)
+            return -1;
+        list->num++;
+    }
+    dst->format = is_map ? MPV_FORMAT_NODE_MAP : MPV_FORMAT_NODE_ARRAY;
+    dst->u.list = list;
+    return 0;
+}
+
+/* Parse one MessagePack object from *src, and write the result into *dst.
+ * max_depth limits the recursion and tree depth.
+ * Returns:
+ *   0: success, *dst is valid, *src is advanced past the object
+ *  -1: failure, *dst is invalid, there may be dead allocs under ta_parent
+ * Unlike json_parse(), the result doesn't reference the input data.
+ */
+int msgpack_parse(void *ta_parent, struct mpv_node *dst, bstr *src,
+                  int max_depth)
+{
+    max_depth -= 1;
+    if (max_depth < 0)
+        return -1;
+
+    uint8_t c;
+    if (!read_bytes(src, &c, 1))
+        return -1;
+
+    uint64_t v;
+    if (c <= 0x7f) {
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = c;
+        return 0;
+    } else if (c >= 0xe0) {
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = (int8_t)c;
+        return 0;
+    } else if (c >= 0xa0 && c <= 0xbf) {
+        return read_str(ta_parent, dst, src, c & 0x1f);
+    } else if (c >= 0x90 && c <= 0x9f) {
+        return read_sub(ta_parent, dst, src, c & 0xf, false, max_depth);
+    } else if (c >= 0x80 && c <= 0x8f) {
+        return read_sub(ta_parent, dst, src, c & 0xf, true, max_depth);
+    }
+
+    switch (c) {
+    case 0xc0:
+        dst->format = MPV_FORMAT_NONE;
+        return 0;
+    case 0xc2:
+    case 0xc3:
+        dst->format = MPV_FORMAT_FLAG;
+        dst->u.flag = c == 0xc3;
+        return 0;
+    case 0xc4: case 0xd9: // bin8, str8
+        return read_be(src, 1, &v) ? read_str(ta_parent, dst, src, v) : -1;
+    case 0xc5: case 0xda: // bin16, str16
+        return read_be(src, 2, &v) ? read_str(ta_parent, dst, src, v) : -1;
+    case 0xc6: case 0xdb: // bin32, str32
+        return read_be(src, 4, &v) ? read_str(ta_parent, dst, src, v) : -1;
+    case 0xca: { // float32
+        if (!read_be(src, 4, &v))
+            return -1;
+        uint32_t bits = v;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        dst->format = MPV_FORMAT_DOUBLE;
+        dst->u.double_ = f;
+        return 0;
+    }
+    case 0xcb: { // float64
+        if (!read_be(src, 8, &v))
+            return -1;
+        double d;
+        memcpy(&d, &v, sizeof(d));
+        dst->format = MPV_FORMAT_DOUBLE;
+        dst->u.double_ = d;
+        return 0;
+    }
+    case 0xcc: case 0xcd: case 0xce: case 0xcf: { // uint8-64
+        if (!read_be(src, 1 << (c - 0xcc), &v) || v > INT64_MAX)
+            return -1;
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = v;
+        return 0;
+    }
+    case 0xd0: case 0xd1: case 0xd2: case 0xd3: { // int8-64
+        int bytes = 1 << (c - 0xd0);
+        if (!read_be(src, bytes, &v))
+            return -1;
+        // sign extend
+        if (bytes < 8 && (v & (1ULL << (bytes * 8 - 1))))
+            v |= ~0ULL << (bytes * 8);
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = (int64_t)v;
+        return 0;
+    }
+    case 0xdc: case 0xdd: // array16, array32
+        if (!read_be(src, c == 0xdc ? 2 : 4, &v))
+            return -1;
+        return read_sub(ta_parent, dst, src, v, false, max_depth);
+    case 0xde: case 0xdf: // map16, map32
+        if (!read_be(src, c == 0xde ? 2 : 4, &v))
+            return -1;
+        return read_sub(ta_parent, dst, src, v, true, max_depth);
+    }
+    return -1; // ext types and the unused 0xc1
+}
+
+static void write_be(void *ta_parent, bstr *b, uint8_t type, uint64_t v,
+                     int bytes)
+{
+    uint8_t buf[9] = {type};
+    for (int n = 0; n < bytes; n++)
+        buf[1 + n] = v >> ((bytes - 1 - n) * 8);
+    bstr_xappend(ta_parent, b, (bstr){buf, 1 + bytes});
+}
+
+static void write_len(void *ta_parent, bstr *b, uint64_t len, uint8_t fix,
+                      int fix_max, uint8_t type8, uint8_t type16,
+                      uint8_t type32)
+{
+    if (len <= fix_max) {
+        write_be(ta_parent, b, fix | len, 0, 0);
+    } else if (len <= 0xff && type8) {
+        write_be(ta_parent, b, type8, len, 1);
+    } else if (len <= 0xffff) {
+        write_be(ta_parent, b, type16, len, 2);
+    } else {
+        write_be(ta_parent, b, type32, len, 4);
+    }
+}
+
+static void write_str(void *ta_parent, bstr *b, const char *s)
+{
+    size_t len = strlen(s);
+    write_len(ta_parent, b, len, 0xa0, 31, 0xd9, 0xda, 0xdb);
+    bstr_xappend(ta_parent, b, (bstr){(unsigned char *)s, len});
+}
+
+static int msgpack_append(void *ta_parent, bstr *b, const struct mpv_node *src)
+{
+    switch (src->format) {
+    case MPV_FORMAT_NONE:
+        write_be(ta_parent, b, 0xc0, 0, 0);
+        return 0;
+    case MPV_FORMAT_FLAG:
+        write_be(ta_parent, b, src->u.flag ? 0xc3 : 0xc2, 0, 0);
+        return 0;
+    case MPV_FORMAT_INT64: {
+        int64_t v = src->u.int64;
+        if (v >= -32 && v <= 127) {
+            write_be(ta_parent, b, (uint8_t)v, 0, 0);
+        } else if (v >= INT32_MIN && v <= INT32_MAX) {
+            write_be(ta_parent, b, 0xd2, (uint32_t)v, 4);
+        } else {
+            write_be(ta_parent, b, 0xd3, (uint64_t)v, 8);
+        }
+        return 0;
+    }
+    case MPV_FORMAT_DOUBLE: {
+        uint64_t bits;
+        memcpy(&bits, &src->u.double_, sizeof(bits));
+        write_be(ta_parent, b, 0xcb, bits, 8);
+        return 0;
+    }
+    case MPV_FORMAT_STRING:
+        write_str(ta_parent, b, src->u.string);
+        return 0;
+    case MPV_FORMAT_NODE_ARRAY:
+    case MPV_FORMAT_NODE_MAP: {
+        struct mpv_node_list *list = src->u.list;
+        bool is_map = src->format == MPV_FORMAT_NODE_MAP;
+        if (is_map) {
+            write_len(ta_parent, b, list->num, 0x80, 15, 0, 0xde, 0xdf);
+        } else {
+            write_len(ta_parent, b, list->num, 0x90, 15, 0, 0xdc, 0xdd);
+        }
+        for (int n = 0; n < list->num; n++) {
+            if (is_map)
+                write_str(ta_parent, b, list->keys[n]);
+            if (msgpack_append(ta_parent, b, &list->values[n]) < 0)
+                return -1;
+        }
+        return 0;
+    }
+    }
+    return -1; // unknown format
+}
+
+/* Append the MessagePack encoding of src to *dst. Returns 0 on success, or -1
+ * if src contains unsupported node types.
+ */
+int msgpack_write(void *ta_parent, bstr *dst, struct mpv_node *src)
+{
+    return msgpack_append(ta_parent, dst, src);
+}
@@ -24,6 +24,7 @@
 struct work {
     void (*fn)(void *ctx);
     void *fn_ctx;
+    struct mp_thread_pool_group *group; // or NULL
 };
 
 struct mp_thread_pool {
@@ -32,6 +33,7 @@ struct mp_thread_pool {
 
     pthread_mutex_t lock;
     pthread_cond_t wakeup;
+    pthread_cond_t done;    // signaled when a group's last work item is done
 
     // --- the following fields are protected by lock
     bool terminate;
@@ -39,6 +41,21 @@ struct mp_thread_pool {
     int num_work;
 };
 
+// Run the work item; must be called locked, and returns locked.
+static void run_work(struct mp_thread_pool *pool, struct work work)
+{
+    pthread_mutex_unlock(&pool->lock);
+    work.fn(work.fn_ctx);
+    pthread_mutex_lock(&pool->lock);
+
+    if (work.group) {
+        assert(work.group->pending > 0);
+        work.group->pending -= 1;
+        if (!work.group->pending)
+            pthread_cond_broadcast(&pool->done);
+    }
+}
+
 static void *worker_thread(void *arg)
 {
     struct mp_thread_pool *pool = arg;
@@ -55,9 +72,7 @@ static void *worker_thread(void *arg)
         struct work work = pool->work[pool->num_work - 1];
         pool->num_work -= 1;
 
-        pthread_mutex_unlock(&pool->lock);
-        work.fn(work.fn_ctx);
-        pthread_mutex_lock(&pool->lock);
+        run_work(pool, work);
     }
     assert(pool->num_work == 0);
     pthread_mutex_unlock(&pool->lock);
@@ -78,6 +93,7 @@ static void thread_pool_dtor(void *ctx)
         pthread_join(pool->threads[n], NULL);
 
     assert(pool->num_work == 0);
+    pthread_cond_destroy(&pool->done);
     pthread_cond_destroy(&pool->wakeup);
     pthread_mutex_destroy(&pool->lock);
 }
@@ -96,6 +112,7 @@ struct mp_thread_pool *mp_thread_pool_create(void *ta_parent, int threads)
 
     pthread_mutex_init(&pool->lock, NULL);
     pthread_cond_init(&pool->wakeup, NULL);
+    pthread_cond_init(&pool->done, NULL);
 
     for (int n = 0; n < threads; n++) {
         pthread_t thread;
@@ -116,10 +133,49 @@ struct mp_thread_pool *mp_thread_pool_create(void *ta_parent, int threads)
 // pool destruction.
 void mp_thread_pool_queue(struct mp_thread_pool *pool, void (*fn)(void *ctx),
                           void *fn_ctx)
+{
+    mp_thread_pool_queue_group(pool, NULL, fn, fn_ctx);
+}
+
+// Like mp_thread_pool_queue(), but add the work item to the given group (or
+// no group if group is NULL).
+void mp_thread_pool_queue_group(struct mp_thread_pool *pool,
+                                struct mp_thread_pool_group *group,
+                                void (*fn)(void *ctx), void *fn_ctx)
 {
     pthread_mutex_lock(&pool->lock);
-    struct work work = {fn, fn_ctx};
+    struct work work = {fn, fn_ctx, group};
+    if (group)
+        group->pending += 1;
     MP_TARRAY_INSERT_AT(pool, pool->work, pool->num_work, 0, work);
     pthread_cond_signal(&pool->wakeup);
     pthread_mutex_unlock(&pool->lock);
 }
+
+// Wait until all work items in the group are done. Instead of blocking, the
+// calling thread runs the items of this group that no worker has started yet,
+// so waiting never takes longer than running the work itself, and the pool
+// can have one thread fewer than the amount of parallel work. The group can be
+// reused afterwards.
+void mp_thread_pool_wait(struct mp_thread_pool *pool,
+                         struct mp_thread_pool_group *group)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (group->pending) {
+        int found = -1;
+        for (int n = pool->num_work - 1; n >= 0; n--) {
+            if (pool->work[n].group == group) {
+                found = n;
+                break;
+            }
+        }
+        if (found >= 0) {
+            struct work work = pool->work[found];
+            MP_TARRAY_REMOVE_AT(pool->work, pool->num_work, found);
+            run_work(pool, work);
+        } else {
+            pthread_cond_wait(&pool->done, &pool->lock);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -3,8 +3,19 @@
 
 struct mp_thread_pool;
 
+// Set of work items that can be waited on with mp_thread_pool_wait(). Must be
+// zero-initialized. The fields are private to thread_pool.c.
+struct mp_thread_pool_group {
+    int pending;
+};
+
 struct mp_thread_pool *mp_thread_pool_create(void *ta_parent, int threads);
 void mp_thread_pool_queue(struct mp_thread_pool *pool, void (*fn)(void *ctx),
                           void *fn_ctx);
+void mp_thread_pool_queue_group(struct mp_thread_pool *pool,
+                                struct mp_thread_pool_group *group,
+                                void (*fn)(void *ctx), void *fn_ctx);
+void mp_thread_pool_wait(struct mp_thread_pool *pool,
+                         struct mp_thread_pool_group *group);
 
 #endif
@@ -58,6 +58,11 @@ struct m_config_shadow {
     pthread_mutex_t lock;
     struct m_config *root;
     char *data;
+    // Change counter, incremented on every write access. The values of
+    // m_config_group.ts and opt_ts are taken from it.
+    long long ts;
+    // Value of ts at the last write of each option (indexed like root->opts).
+    long long *opt_ts;
     struct m_config_cache **listeners;
     int num_listeners;
 };
@@ -67,7 +72,8 @@ struct m_config_group {
     const struct m_sub_options *group; // or NULL for top-level options
     int parent_group;   // index of parent group in m_config.groups
     void *opts;         // pointer to group user option struct
-    atomic_llong ts;    // incremented on every write access
+    atomic_llong ts;    // m_config_shadow.ts of the last write access to
+                        // an option in this group or a sub-group
 };
 
 struct m_profile {
@@ -166,6 +172,28 @@ static void config_destroy(void *p)
     }
 }
 
+static int compare_co_name(const void *pa, const void *pb)
+{
+    struct m_config_option *a = *(struct m_config_option **)pa;
+    struct m_config_option *b = *(struct m_config_option **)pb;
+    int r = strcmp(a->name, b->name);
+    // Keep duplicates in definition order; the first one wins on lookup.
+    return r ? r : (a > b) - (a < b);
+}
+
+// (Re)create the config->opts_by_name table. Must be called after
+// config->opts was changed.
+static void update_name_index(struct m_config *config)
+{
+    talloc_free(config->opts_by_name);
+    config->opts_by_name =
+        talloc_array(config, struct m_config_option *, config->num_opts);
+    for (int n = 0; n < config->num_opts; n++)
+        config->opts_by_name[n] = &config->opts[n];
+    qsort(config->opts_by_name, config->num_opts,
+          sizeof(config->opts_by_name[0]), compare_co_name);
+}
+
 struct m_config *m_config_new(void *talloc_ctx, struct mp_log *log,
                               size_t size, const void *defaults,
                               const struct m_option *options)
@@ -191,6 +219,7 @@ struct m_config *m_config_new(void *talloc_ctx, struct mp_log *log,
 
     if (options)
         add_options(config, NULL, config->optstruct, defaults, options);
+    update_name_index(config);
     return config;
 }
 
@@ -546,12 +575,19 @@ struct m_config_option *m_config_get_co_raw(const struct m_config *config,
     if (!name.len)
         return NULL;
 
-    for (int n = 0; n < config->num_opts; n++) {
-        struct m_config_option *co = &config->opts[n];
-        struct bstr coname = bstr0(co->name);
-        if (bstrcmp(coname, name) == 0)
-            return co;
+    // Binary search for the first entry >= name.
+    int lo = 0, hi = config->num_opts;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (bstrcmp(bstr0(config->opts_by_name[mid]->name), name) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
+    if (lo < config->num_opts &&
+        bstrcmp(bstr0(config->opts_by_name[lo]->name), name) == 0)
+        return config->opts_by_name[lo];
 
     return NULL;
 }
@@ -1193,6 +1229,8 @@ void m_config_create_shadow(struct m_config *config)
     config->shadow->data = talloc_zero_size(config->shadow, config->shadow_size);
 
     config->shadow->root = config;
+    config->shadow->opt_ts = talloc_zero_array(config->shadow, long long,
+                                               config->num_opts);
     pthread_mutex_init(&config->shadow->lock, NULL);
 
     config->global->config = config->shadow;
@@ -1251,6 +1289,9 @@ struct m_config_cache *m_config_cache_alloc(void *ta_parent,
 
     cache->ts = -1;
     cache->group = -1;
+    cache->opt_index = talloc_array(cache, int, config->num_opts);
+    for (int n = 0; n < config->num_opts; n++)
+        cache->opt_index[n] = n;
 
     for (int n = 0; n < config->num_groups; n++) {
         if (config->groups[n].group == group) {
@@ -1272,6 +1313,7 @@ struct m_config_cache *m_config_cache_alloc(void *ta_parent,
         for (int n = 0; n < num_opts; n++) {
             struct m_config_option *co = &config->opts[n];
             if (is_group_included(config, co->group, cache->group)) {
+                cache->opt_index[config->num_opts] = n;
                 config->opts[config->num_opts++] = *co;
             } else {
                 m_option_free(co->opt, co->data);
@@ -1281,6 +1323,7 @@ struct m_config_cache *m_config_cache_alloc(void *ta_parent,
             if (!is_group_included(config, n, cache->group))
                 TA_FREEP(&config->groups[n].opts);
         }
+        update_name_index(config);
     }
 
     m_config_cache_update(cache);
@@ -1292,18 +1335,24 @@ bool m_config_cache_update(struct m_config_cache *cache)
 {
     struct m_config_shadow *shadow = cache->shadow;
 
-    // Using atomics and checking outside of the lock - it's unknown whether
-    // this makes it faster or slower. Just cargo culting it.
+    // The common case is that nothing changed, so check the group's change
+    // counter without taking the lock. A stale value only delays the update
+    // to the next call (writers wake up listeners after the update).
     if (atomic_load(&shadow->root->groups[cache->group].ts) <= cache->ts)
         return false;
 
+    // Copy only options written since the last update. Option values can
+    // contain allocations that are freed when they are overwritten, so this
+    // must be done under the lock.
     pthread_mutex_lock(&shadow->lock);
-    cache->ts = atomic_load(&shadow->root->groups[cache->group].ts);
+    long long ts = atomic_load(&shadow->root->groups[cache->group].ts);
     for (int n = 0; n < cache->shadow_config->num_opts; n++) {
         struct m_config_option *co = &cache->shadow_config->opts[n];
-        if (co->shadow_offset >= 0)
+        if (co->shadow_offset >= 0 &&
+            shadow->opt_ts[cache->opt_index[n]] > cache->ts)
             m_option_copy(co->opt, co->data, shadow->data + co->shadow_offset);
     }
+    cache->ts = ts;
     pthread_mutex_unlock(&shadow->lock);
     return true;
 }
@@ -1313,19 +1362,11 @@ void m_config_notify_change_co(struct m_config *config,
 {
     struct m_config_shadow *shadow = config->shadow;
 
-    if (shadow) {
-        pthread_mutex_lock(&shadow->lock);
-        if (co->shadow_offset >= 0)
-            m_option_copy(co->opt, shadow->data + co->shadow_offset, co->data);
-        pthread_mutex_unlock(&shadow->lock);
-    }
-
     int changed = co->opt->flags & UPDATE_OPTS_MASK;
 
     int group = co->group;
     while (group >= 0) {
         struct m_config_group *g = &config->groups[group];
-        atomic_fetch_add(&g->ts, 1);
         if (g->group)
             changed |= g->group->change_flags;
         group = g->parent_group;
@@ -1333,6 +1374,18 @@ void m_config_notify_change_co(struct m_config *config,
 
     if (shadow) {
         pthread_mutex_lock(&shadow->lock);
+        long long ts = ++shadow->ts;
+        if (co->shadow_offset >= 0) {
+            m_option_copy(co->opt, shadow->data + co->shadow_offset, co->data);
+            shadow->opt_ts[co - config->opts] = ts;
+        }
+        // Publish the new counter only after the data was written, so
+        // m_config_cache_update() never misses a write.
+        for (group = co->group; group >= 0;) {
+            struct m_config_group *g = &config->groups[group];
+            atomic_store(&g->ts, ts);
+            group = g->parent_group;
+        }
         for (int n = 0; n < shadow->num_listeners; n++) {
             struct m_config_cache *cache = shadow->listeners[n];
             if (cache->wakeup_cb)
@@ -60,6 +60,8 @@ typedef struct m_config {
     // Registered options.
     struct m_config_option *opts; // all options, even suboptions
     int num_opts;
+    // Same as opts, but sorted by name (for m_config_get_co_raw()).
+    struct m_config_option **opts_by_name;
 
     // Creation parameters
     size_t size;
@@ -275,6 +277,7 @@ struct m_config_cache {
     struct m_config_shadow *shadow;
     struct m_config *shadow_config;
     long long ts;
+    int *opt_index; // shadow_config->opts index -> shadow->root->opts index
     int group;
     bool in_list;
     // --- Implicitly synchronized by setting/unsetting wakeup_cb.
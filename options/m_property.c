@@ -36,59 +36,103 @@
 #include "common/msg.h"
 #include "common/common.h"
 
-struct m_property *m_property_list_find(const struct m_property *list,
-                                        const char *name)
+static int compare_prop_name(const void *pa, const void *pb)
+{
+    const struct m_property *a = pa, *b = pb;
+    return strcmp(a->name, b->name);
+}
+
+void m_property_list_init(struct m_property_list *dst, struct m_property *list)
+{
+    int num = 0;
+    while (list[num].name)
+        num++;
+    qsort(list, num, sizeof(list[0]), compare_prop_name);
+    *dst = (struct m_property_list){ .props = list, .num_props = num };
+}
+
+int m_property_list_index(const struct m_property_list *list, bstr name)
 {
-    for (int n = 0; list && list[n].name; n++) {
-        if (strcmp(list[n].name, name) == 0)
-            return (struct m_property *)&list[n];
+    int lo = 0, hi = list->num_props;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int r = bstrcmp(bstr0(list->props[mid].name), name);
+        if (r == 0)
+            return mid;
+        if (r < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    return NULL;
+    return -1;
 }
 
-static int do_action(const struct m_property *prop_list, const char *name,
-                     int action, void *arg, void *ctx)
+struct m_property *m_property_list_find(const struct m_property_list *list,
+                                        const char *name)
+{
+    int index = m_property_list_index(list, bstr0(name));
+    return index >= 0 ? &list->props[index] : NULL;
+}
+
+// A resolved property name.
+struct prop_ref {
+    struct m_property *prop;    // NULL if the property does not exist
+    const char *key;            // sub-property path ("a/b" => "b"), or NULL
+};
+
+static struct prop_ref find_prop(const struct m_property_list *prop_list,
+                                 const char *name)
 {
-    struct m_property *prop;
-    struct m_property_action_arg ka;
     const char *sep = strchr(name, '/');
     if (sep && sep[1]) {
-        char base[128];
-        snprintf(base, sizeof(base), "%.*s", (int)(sep - name), name);
-        prop = m_property_list_find(prop_list, base);
-        ka = (struct m_property_action_arg) {
+        bstr base = {(unsigned char *)name, sep - name};
+        int index = m_property_list_index(prop_list, base);
+        return (struct prop_ref){
+            .prop = index >= 0 ? &prop_list->props[index] : NULL,
             .key = sep + 1,
+        };
+    }
+    return (struct prop_ref){ .prop = m_property_list_find(prop_list, name) };
+}
+
+static int do_action(const struct prop_ref *ref, int action, void *arg,
+                     void *ctx)
+{
+    struct m_property_action_arg ka;
+    if (!ref->prop)
+        return M_PROPERTY_UNKNOWN;
+    if (ref->key) {
+        ka = (struct m_property_action_arg) {
+            .key = ref->key,
             .action = action,
             .arg = arg,
         };
         action = M_PROPERTY_KEY_ACTION;
         arg = &ka;
-    } else
-        prop = m_property_list_find(prop_list, name);
-    if (!prop)
-        return M_PROPERTY_UNKNOWN;
-    return prop->call(ctx, prop, action, arg);
+    }
+    return ref->prop->call(ctx, ref->prop, action, arg);
 }
 
 // (as a hack, log can be NULL on read-only paths)
-int m_property_do(struct mp_log *log, const struct m_property *prop_list,
-                  const char *name, int action, void *arg, void *ctx)
+static int property_do(struct mp_log *log, const struct prop_ref *ref,
+                       const char *name, int action, void *arg, void *ctx)
 {
     union m_option_value val = {0};
     int r;
 
     struct m_option opt = {0};
-    r = do_action(prop_list, name, M_PROPERTY_GET_TYPE, &opt, ctx);
+    r = do_action(ref, M_PROPERTY_GET_TYPE, &opt, ctx);
     if (r <= 0)
         return r;
     assert(opt.type);
 
     switch (action) {
     case M_PROPERTY_PRINT: {
-        if ((r = do_action(prop_list, name, M_PROPERTY_PRINT, arg, ctx)) >= 0)
+        if ((r = do_action(ref, M_PROPERTY_PRINT, arg, ctx)) >= 0)
             return r;
         // Fallback to m_option
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(ref, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         char *str = m_option_pretty_print(&opt, &val);
         m_option_free(&opt, &val);
@@ -96,7 +140,7 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
         return str != NULL;
     }
     case M_PROPERTY_GET_STRING: {
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(ref, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         char *str = m_option_print(&opt, &val);
         m_option_free(&opt, &val);
@@ -105,45 +149,45 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
     }
     case M_PROPERTY_SET_STRING: {
         struct mpv_node node = { .format = MPV_FORMAT_STRING, .u.string = arg };
-        return m_property_do(log, prop_list, name, M_PROPERTY_SET_NODE, &node, ctx);
+        return property_do(log, ref, name, M_PROPERTY_SET_NODE, &node, ctx);
     }
     case M_PROPERTY_SWITCH: {
         if (!log)
             return M_PROPERTY_ERROR;
         struct m_property_switch_arg *sarg = arg;
-        if ((r = do_action(prop_list, name, M_PROPERTY_SWITCH, arg, ctx)) !=
+        if ((r = do_action(ref, M_PROPERTY_SWITCH, arg, ctx)) !=
             M_PROPERTY_NOT_IMPLEMENTED)
             return r;
         // Fallback to m_option
-        r = m_property_do(log, prop_list, name, M_PROPERTY_GET_CONSTRICTED_TYPE,
-                          &opt, ctx);
+        r = property_do(log, ref, name, M_PROPERTY_GET_CONSTRICTED_TYPE,
+                        &opt, ctx);
         if (r <= 0)
             return r;
         assert(opt.type);
         if (!opt.type->add)
             return M_PROPERTY_NOT_IMPLEMENTED;
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(ref, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         opt.type->add(&opt, &val, sarg->inc, sarg->wrap);
-        r = do_action(prop_list, name, M_PROPERTY_SET, &val, ctx);
+        r = do_action(ref, M_PROPERTY_SET, &val, ctx);
         m_option_free(&opt, &val);
         return r;
     }
     case M_PROPERTY_GET_CONSTRICTED_TYPE: {
-        if ((r = do_action(prop_list, name, action, arg, ctx)) >= 0)
+        if ((r = do_action(ref, action, arg, ctx)) >= 0)
             return r;
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET_TYPE, arg, ctx)) >= 0)
+        if ((r = do_action(ref, M_PROPERTY_GET_TYPE, arg, ctx)) >= 0)
             return r;
         return M_PROPERTY_NOT_IMPLEMENTED;
     }
     case M_PROPERTY_SET: {
-        return do_action(prop_list, name, M_PROPERTY_SET, arg, ctx);
+        return do_action(ref, M_PROPERTY_SET, arg, ctx);
     }
     case M_PROPERTY_GET_NODE: {
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET_NODE, arg, ctx)) !=
+        if ((r = do_action(ref, M_PROPERTY_GET_NODE, arg, ctx)) !=
             M_PROPERTY_NOT_IMPLEMENTED)
             return r;
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(ref, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         struct mpv_node *node = arg;
         int err = m_option_get_node(&opt, NULL, node, &val);
@@ -160,7 +204,7 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
     case M_PROPERTY_SET_NODE: {
         if (!log)
             return M_PROPERTY_ERROR;
-        if ((r = do_action(prop_list, name, M_PROPERTY_SET_NODE, arg, ctx)) !=
+        if ((r = do_action(ref, M_PROPERTY_SET_NODE, arg, ctx)) !=
             M_PROPERTY_NOT_IMPLEMENTED)
             return r;
         int err = m_option_set_node_or_string(log, &opt, name, &val, arg);
@@ -169,16 +213,23 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
         } else if (err < 0) {
             r = M_PROPERTY_INVALID_FORMAT;
         } else {
-            r = do_action(prop_list, name, M_PROPERTY_SET, &val, ctx);
+            r = do_action(ref, M_PROPERTY_SET, &val, ctx);
         }
         m_option_free(&opt, &val);
         return r;
     }
     default:
-        return do_action(prop_list, name, action, arg, ctx);
+        return do_action(ref, action, arg, ctx);
     }
 }
 
+int m_property_do(struct mp_log *log, const struct m_property_list *prop_list,
+                  const char *name, int action, void *arg, void *ctx)
+{
+    struct prop_ref ref = find_prop(prop_list, name);
+    return property_do(log, &ref, name, action, arg, ctx);
+}
+
 bool m_property_split_path(const char *path, bstr *prefix, char **rem)
 {
     char *next = strchr(path, '/');
@@ -206,16 +257,6 @@ static void m_property_unkey(int *action, void **arg)
     }
 }
 
-static int m_property_do_bstr(const struct m_property *prop_list, bstr name,
-                              int action, void *arg, void *ctx)
-{
-    char name0[64];
-    if (name.len >= sizeof(name0))
-        return M_PROPERTY_UNKNOWN;
-    snprintf(name0, sizeof(name0), "%.*s", BSTR_P(name));
-    return m_property_do(NULL, prop_list, name0, action, arg, ctx);
-}
-
 static void append_str(char **s, int *len, bstr append)
 {
     MP_TARRAY_GROW(NULL, *s, *len + append.len);
@@ -224,54 +265,72 @@ static void append_str(char **s, int *len, bstr append)
     *len = *len + append.len;
 }
 
-static int expand_property(const struct m_property *prop_list, char **ret,
-                           int *ret_len, bstr prop, bool silent_error, void *ctx)
+struct tmpl_item {
+    bool is_prop;
+    bstr text;              // !is_prop: literal text
+    // is_prop: a "${...}" group
+    char *name;
+    struct prop_ref ref;
+    bool silent_error;      // has a fallback string
+    bool cond_yes, test, raw, comp;
+    char *comp_with;
+    int end;                // index of the first item after the closing "}"
+};
+
+struct m_property_template {
+    struct tmpl_item *items;
+    int num_items;
+};
+
+static void add_prop_item(struct m_property_template *t,
+                          const struct m_property_list *prop_list,
+                          bstr prop, bool silent_error)
 {
-    bool cond_yes = bstr_eatstart0(&prop, "?");
-    bool cond_no = !cond_yes && bstr_eatstart0(&prop, "!");
-    bool test = cond_yes || cond_no;
-    bool raw = bstr_eatstart0(&prop, "=");
+    struct tmpl_item it = { .is_prop = true, .silent_error = silent_error };
+    it.cond_yes = bstr_eatstart0(&prop, "?");
+    bool cond_no = !it.cond_yes && bstr_eatstart0(&prop, "!");
+    it.test = it.cond_yes || cond_no;
+    it.raw = bstr_eatstart0(&prop, "=");
     bstr comp_with = {0};
-    bool comp = test && bstr_split_tok(prop, "==", &prop, &comp_with);
-    if (test && !comp)
-        raw = true;
-    int method = raw ? M_PROPERTY_GET_STRING : M_PROPERTY_PRINT;
+    it.comp = it.test && bstr_split_tok(prop, "==", &prop, &comp_with);
+    if (it.test && !it.comp)
+        it.raw = true;
+    it.comp_with = bstrto0(t, comp_with);
+    it.name = bstrto0(t, prop);
+    // Names that long are not accepted by m_properties_expand_string() for
+    // historical reasons.
+    if (prop.len < 64)
+        it.ref = find_prop(prop_list, it.name);
+    it.end = t->num_items + 1;
+    MP_TARRAY_APPEND(t, t->items, t->num_items, it);
+}
 
-    char *s = NULL;
-    int r = m_property_do_bstr(prop_list, prop, method, &s, ctx);
-    bool skip;
-    if (comp) {
-        skip = ((s && bstr_equals0(comp_with, s)) != cond_yes);
-    } else if (test) {
-        skip = (!!s != cond_yes);
-    } else {
-        skip = !!s;
-        char *append = s;
-        if (!s && !silent_error && !raw)
-            append = (r == M_PROPERTY_UNAVAILABLE) ? "(unavailable)" : "(error)";
-        append_str(ret, ret_len, bstr0(append));
+static void add_text(struct m_property_template *t, bool *open_text, bstr text)
+{
+    if (!*open_text) {
+        struct tmpl_item it = {0};
+        MP_TARRAY_APPEND(t, t->items, t->num_items, it);
+        *open_text = true;
     }
-    talloc_free(s);
-    return skip;
+    bstr_xappend(t, &t->items[t->num_items - 1].text, text);
 }
 
-char *m_properties_expand_string(const struct m_property *prop_list,
-                                 const char *str0, void *ctx)
+struct m_property_template *m_property_template_compile(void *ta_parent,
+        const struct m_property_list *prop_list, const char *str0)
 {
-    char *ret = NULL;
-    int ret_len = 0;
-    bool skip = false;
-    int level = 0, skip_level = 0;
+    struct m_property_template *t = talloc_zero(ta_parent,
+                                                struct m_property_template);
+    int *open = NULL;       // indexes of the unclosed "${" items
+    int num_open = 0;
+    bool open_text = false; // whether the last item can be appended to
     bstr str = bstr0(str0);
 
     while (str.len) {
-        if (level > 0 && bstr_eatstart0(&str, "}")) {
-            if (skip && level <= skip_level)
-                skip = false;
-            level--;
+        if (num_open > 0 && bstr_eatstart0(&str, "}")) {
+            t->items[open[--num_open]].end = t->num_items;
+            open_text = false;
         } else if (bstr_startswith0(str, "${") && bstr_find0(str, "}") >= 0) {
             str = bstr_cut(str, 2);
-            level++;
 
             // Assume ":" and "}" can't be part of the property name
             // => if ":" comes before "}", it must be for the fallback
@@ -280,14 +339,11 @@ char *m_properties_expand_string(const struct m_property *prop_list,
             str = bstr_cut(str, term_pos);
             bool have_fallback = bstr_eatstart0(&str, ":");
 
-            if (!skip) {
-                skip = expand_property(prop_list, &ret, &ret_len, name,
-                                       have_fallback, ctx);
-                if (skip)
-                    skip_level = level;
-            }
-        } else if (level == 0 && bstr_eatstart0(&str, "$>")) {
-            append_str(&ret, &ret_len, str);
+            MP_TARRAY_APPEND(NULL, open, num_open, t->num_items);
+            add_prop_item(t, prop_list, name, have_fallback);
+            open_text = false;
+        } else if (num_open == 0 && bstr_eatstart0(&str, "$>")) {
+            add_text(t, &open_text, str);
             break;
         } else {
             char c;
@@ -302,8 +358,54 @@ char *m_properties_expand_string(const struct m_property *prop_list,
                 str = bstr_cut(str, 1);
             }
 
-            if (!skip)
-                MP_TARRAY_APPEND(NULL, ret, ret_len, c);
+            add_text(t, &open_text, (bstr){(unsigned char *)&c, 1});
+        }
+    }
+
+    // Unclosed groups extend to the end of the string.
+    while (num_open > 0)
+        t->items[open[--num_open]].end = t->num_items;
+    talloc_free(open);
+
+    return t;
+}
+
+// Returns whether the contents of the group should be skipped.
+static bool expand_item(struct tmpl_item *it, char **ret, int *ret_len,
+                        void *ctx)
+{
+    int method = it->raw ? M_PROPERTY_GET_STRING : M_PROPERTY_PRINT;
+
+    char *s = NULL;
+    int r = property_do(NULL, &it->ref, it->name, method, &s, ctx);
+    bool skip;
+    if (it->comp) {
+        skip = ((s && strcmp(it->comp_with, s) == 0) != it->cond_yes);
+    } else if (it->test) {
+        skip = (!!s != it->cond_yes);
+    } else {
+        skip = !!s;
+        char *append = s;
+        if (!s && !it->silent_error && !it->raw)
+            append = (r == M_PROPERTY_UNAVAILABLE) ? "(unavailable)" : "(error)";
+        append_str(ret, ret_len, bstr0(append));
+    }
+    talloc_free(s);
+    return skip;
+}
+
+char *m_property_template_expand(struct m_property_template *t, void *ctx)
+{
+    char *ret = NULL;
+    int ret_len = 0;
+
+    for (int n = 0; n < t->num_items; ) {
+        struct tmpl_item *it = &t->items[n];
+        if (it->is_prop) {
+            n = expand_item(it, &ret, &ret_len, ctx) ? it->end : n + 1;
+        } else {
+            append_str(&ret, &ret_len, it->text);
+            n++;
         }
     }
 
@@ -311,6 +413,25 @@ char *m_properties_expand_string(const struct m_property *prop_list,
     return ret;
 }
 
+const char *m_property_template_get_name(struct m_property_template *t, int n)
+{
+    for (int i = 0; i < t->num_items; i++) {
+        if (t->items[i].is_prop && n-- == 0)
+            return t->items[i].name;
+    }
+    return NULL;
+}
+
+char *m_properties_expand_string(const struct m_property_list *prop_list,
+                                 const char *str0, void *ctx)
+{
+    struct m_property_template *t =
+        m_property_template_compile(NULL, prop_list, str0);
+    char *ret = m_property_template_expand(t, ctx);
+    talloc_free(t);
+    return ret;
+}
+
 void m_properties_print_help_list(struct mp_log *log,
                                   const struct m_property *list)
 {
@@ -494,6 +615,62 @@ int m_property_read_sub(const struct m_sub_property *props, int action, void *ar
 // count: number of items.
 // get_item: callback to access a single item.
 // ctx: userdata passed to get_item.
+// Items [start, start + count) as node array.
+static struct mpv_node read_list_node(int start, int count,
+                                      m_get_item_cb get_item, void *ctx)
+{
+    struct mpv_node node;
+    node.format = MPV_FORMAT_NODE_ARRAY;
+    node.u.list = talloc_zero(NULL, mpv_node_list);
+    node.u.list->num = count;
+    node.u.list->values = talloc_array(node.u.list, mpv_node, count);
+    for (int n = 0; n < count; n++) {
+        struct mpv_node *sub = &node.u.list->values[n];
+        sub->format = MPV_FORMAT_NONE;
+        int r;
+        r = get_item(start + n, M_PROPERTY_GET_NODE, sub, ctx);
+        if (r == M_PROPERTY_NOT_IMPLEMENTED) {
+            struct m_option opt = {0};
+            r = get_item(start + n, M_PROPERTY_GET_TYPE, &opt, ctx);
+            if (r != M_PROPERTY_OK)
+                goto err;
+            union m_option_value val = {0};
+            r = get_item(start + n, M_PROPERTY_GET, &val, ctx);
+            if (r != M_PROPERTY_OK)
+                goto err;
+            m_option_get_node(&opt, node.u.list, sub, &val);
+            m_option_free(&opt, &val);
+        err: ;
+        }
+    }
+    return node;
+}
+
+// Handle "range/START/COUNT" sub-properties.
+static int read_list_range(struct m_property_action_arg *ka, int count,
+                           m_get_item_cb get_item, void *ctx)
+{
+    char *end = NULL;
+    long long start = strtoll(ka->key, &end, 10);
+    if (end == ka->key || end[0] != '/')
+        return M_PROPERTY_UNKNOWN;
+    const char *s = end + 1;
+    long long num = strtoll(s, &end, 10);
+    if (end == s || end[0] || start < 0 || num < 0)
+        return M_PROPERTY_UNKNOWN;
+    switch (ka->action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)ka->arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET:
+        start = MPMIN(start, count);
+        num = MPMIN(num, count - start);
+        *(struct mpv_node *)ka->arg = read_list_node(start, num, get_item, ctx);
+        return M_PROPERTY_OK;
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
 int m_property_read_list(int action, void *arg, int count,
                          m_get_item_cb get_item, void *ctx)
 {
@@ -502,34 +679,9 @@ int m_property_read_list(int action, void *arg, int count,
     case M_PROPERTY_GET_TYPE:
         *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
         return M_PROPERTY_OK;
-    case M_PROPERTY_GET: {
-        struct mpv_node node;
-        node.format = MPV_FORMAT_NODE_ARRAY;
-        node.u.list = talloc_zero(NULL, mpv_node_list);
-        node.u.list->num = count;
-        node.u.list->values = talloc_array(node.u.list, mpv_node, count);
-        for (int n = 0; n < count; n++) {
-            struct mpv_node *sub = &node.u.list->values[n];
-            sub->format = MPV_FORMAT_NONE;
-            int r;
-            r = get_item(n, M_PROPERTY_GET_NODE, sub, ctx);
-            if (r == M_PROPERTY_NOT_IMPLEMENTED) {
-                struct m_option opt = {0};
-                r = get_item(n, M_PROPERTY_GET_TYPE, &opt, ctx);
-                if (r != M_PROPERTY_OK)
-                    goto err;
-                union m_option_value val = {0};
-                r = get_item(n, M_PROPERTY_GET, &val, ctx);
-                if (r != M_PROPERTY_OK)
-                    goto err;
-                m_option_get_node(&opt, node.u.list, sub, &val);
-                m_option_free(&opt, &val);
-            err: ;
-            }
-        }
-        *(struct mpv_node *)arg = node;
+    case M_PROPERTY_GET:
+        *(struct mpv_node *)arg = read_list_node(0, count, get_item, ctx);
         return M_PROPERTY_OK;
-    }
     case M_PROPERTY_PRINT: {
         // See m_property_read_sub() remarks.
         char *res = NULL;
@@ -561,6 +713,11 @@ int m_property_read_list(int action, void *arg, int count,
             }
             return M_PROPERTY_NOT_IMPLEMENTED;
         }
+        if (strncmp(ka->key, "range/", 6) == 0) {
+            struct m_property_action_arg r_ka = *ka;
+            r_ka.key = ka->key + 6;
+            return read_list_range(&r_ka, count, get_item, ctx);
+        }
         // This is expected of the form "123" or "123/rest"
         char *next = strchr(ka->key, '/');
         char *end = NULL;
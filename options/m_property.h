@@ -131,14 +131,27 @@ struct m_property {
     bool is_option;
 };
 
-struct m_property *m_property_list_find(const struct m_property *list,
+// A property list prepared for lookup by name.
+struct m_property_list {
+    struct m_property *props;   // sorted by name, terminated with a {0} item
+    int num_props;
+};
+
+// Sort the {0} terminated list in place, and set dst to reference it. The list
+// must not be changed afterwards.
+void m_property_list_init(struct m_property_list *dst, struct m_property *list);
+
+// Return the index of the property in list->props, or -1.
+int m_property_list_index(const struct m_property_list *list, bstr name);
+
+struct m_property *m_property_list_find(const struct m_property_list *list,
                                         const char *name);
 
 // Access a property.
 // action: one of m_property_action
 // ctx: opaque value passed through to property implementation
 // returns: one of mp_property_return
-int m_property_do(struct mp_log *log, const struct m_property* prop_list,
+int m_property_do(struct mp_log *log, const struct m_property_list *prop_list,
                   const char* property_name, int action, void* arg, void *ctx);
 
 // Given a path of the form "a/b/c", this function will set *prefix to "a",
@@ -163,9 +176,24 @@ void m_properties_print_help_list(struct mp_log *log,
 // STR is recursively expanded using the same rules.
 // "$$" can be used to escape "$", and "$}" to escape "}".
 // "$>" disables parsing of "$" for the rest of the string.
-char* m_properties_expand_string(const struct m_property *prop_list,
+char* m_properties_expand_string(const struct m_property_list *prop_list,
                                  const char *str, void *ctx);
 
+// A property string (as in m_properties_expand_string()), parsed once for
+// repeated expansion. Property names are resolved when parsing.
+struct m_property_template;
+
+// The returned template references prop_list, and must not outlive it.
+struct m_property_template *m_property_template_compile(void *ta_parent,
+        const struct m_property_list *prop_list, const char *str);
+
+// Return the expanded string (talloc'ed without parent).
+char *m_property_template_expand(struct m_property_template *t, void *ctx);
+
+// Return the name of the n-th property referenced by the template, or NULL if
+// n is out of range.
+const char *m_property_template_get_name(struct m_property_template *t, int n);
+
 // Trivial helpers for implementing properties.
 int m_property_flag_ro(int action, void* arg, int var);
 int m_property_int_ro(int action, void* arg, int var);
@@ -64,6 +64,9 @@ extern const struct m_sub_options tv_params_conf;
 extern const struct m_sub_options stream_cdda_conf;
 extern const struct m_sub_options stream_dvb_conf;
 extern const struct m_sub_options stream_lavf_conf;
+extern const struct m_sub_options stream_uring_conf;
+extern const struct m_sub_options stream_file_conf;
+extern const struct m_sub_options stream_smb_conf;
 extern const struct m_sub_options stream_cache_conf;
 extern const struct m_sub_options sws_conf;
 extern const struct m_sub_options drm_conf;
@@ -88,6 +91,7 @@ extern const struct m_obj_list ao_obj_list;
 extern const struct m_sub_options opengl_conf;
 extern const struct m_sub_options vulkan_conf;
 extern const struct m_sub_options spirv_conf;
+extern const struct m_sub_options thread_conf;
 extern const struct m_sub_options d3d11_conf;
 extern const struct m_sub_options d3d11va_conf;
 extern const struct m_sub_options angle_conf;
@@ -145,6 +149,8 @@ static const m_option_t mp_vo_opt_list[] = {
     OPT_FLAG("keepaspect-window", keepaspect_window, 0),
     OPT_FLAG("hidpi-window-scale", hidpi_window_scale, 0),
     OPT_FLAG("native-fs", native_fs, 0),
+    OPT_INTRANGE("video-render-ahead", render_ahead, 0, 0, 8),
+    OPT_INTRANGE("video-timing-spin", timing_spin, 0, 0, 1000),
 #if HAVE_X11
     OPT_CHOICE("x11-netwm", x11_netwm, 0,
                ({"auto", 0}, {"no", -1}, {"yes", 1})),
@@ -205,6 +211,7 @@ const struct m_sub_options mp_subtitle_sub_opts = {
         OPT_FLAG("sub-ass", ass_enabled, 0),
         OPT_FLAG("sub-filter-sdh", sub_filter_SDH, 0),
         OPT_FLAG("sub-filter-sdh-harder", sub_filter_SDH_harder, 0),
+        OPT_STRINGLIST("sub-filter-regex", sub_filter_regex, 0),
         OPT_FLOATRANGE("sub-scale", sub_scale, 0, 0, 100),
         OPT_FLOATRANGE("sub-ass-line-spacing", ass_line_spacing, 0, -1000, 1000),
         OPT_FLAG("sub-use-margins", sub_use_margins, 0),
@@ -267,6 +274,7 @@ const struct m_sub_options mp_osd_render_sub_opts = {
         OPT_FLOATRANGE("osd-scale", osd_scale, 0, 0, 100),
         OPT_FLAG("osd-scale-by-window", osd_scale_by_window, 0),
         OPT_FLAG("force-rgba-osd-rendering", force_rgba_osd, 0),
+        OPT_FLAG("osd-parallel-render", osd_parallel_render, 0),
         {0}
     },
     .size = sizeof(OPT_BASE_STRUCT),
@@ -341,6 +349,11 @@ const m_option_t mp_opts[] = {
     OPT_GENERAL(char**, "msg-level", msg_levels, CONF_PRE_PARSE | UPDATE_TERM,
                 .type = &m_option_type_msglevels),
     OPT_STRING("dump-stats", dump_stats, UPDATE_TERM | CONF_PRE_PARSE),
+    OPT_STRING("perf-stats-file", perf_stats_file, M_OPT_FILE),
+    OPT_STRING("benchmark-file", benchmark_file, M_OPT_FILE),
+    OPT_DOUBLE("perf-stats-interval", perf_stats_interval, M_OPT_RANGE,
+               .min = 0.01, .max = 3600),
+    OPT_STRING("trace-file", trace_file, M_OPT_FILE),
     OPT_FLAG("msg-color", msg_color, CONF_PRE_PARSE | UPDATE_TERM),
     OPT_STRING("log-file", log_file, CONF_PRE_PARSE | M_OPT_FILE | UPDATE_TERM),
     OPT_FLAG("msg-module", msg_module, UPDATE_TERM),
@@ -372,6 +385,7 @@ const m_option_t mp_opts[] = {
     OPT_STRING("ytdl-format", lua_ytdl_format, 0),
     OPT_KEYVALUELIST("ytdl-raw-options", lua_ytdl_raw_options, 0),
     OPT_FLAG("load-stats-overlay", lua_load_stats, UPDATE_BUILTIN_SCRIPTS),
+    OPT_STRING("lua-bytecode-cache", lua_bytecode_cache, M_OPT_FILE),
 #endif
 
 // ------------------------- stream options --------------------
@@ -430,12 +444,16 @@ const m_option_t mp_opts[] = {
     OPT_FLAG("track-auto-selection", stream_auto_sel, 0),
 
     OPT_STRING("lavfi-complex", lavfi_complex, UPDATE_LAVFI_COMPLEX),
+    OPT_INTRANGE("lavfi-complex-threads", lavfi_complex_threads, 0, 0, 64),
 
     OPT_CHOICE("audio-display", audio_display, 0,
                ({"no", 0}, {"attachment", 1})),
 
     OPT_CHOICE_OR_INT("hls-bitrate", hls_bitrate, 0, 0, INT_MAX,
-                      ({"no", -1}, {"min", 0}, {"max", INT_MAX})),
+                      ({"no", -1}, {"min", 0}, {"max", INT_MAX},
+                       {"adaptive", -2})),
+    OPT_DOUBLE("hls-adaptive-low", hls_adaptive_low, CONF_MIN, .min = 0),
+    OPT_DOUBLE("hls-adaptive-high", hls_adaptive_high, CONF_MIN, .min = 0),
 
     OPT_STRINGLIST("display-tags", display_tags, 0),
 
@@ -451,13 +469,15 @@ const m_option_t mp_opts[] = {
     OPT_STRING("audio-demuxer", audio_demuxer_name, 0),
     OPT_STRING("sub-demuxer", sub_demuxer_name, 0),
     OPT_FLAG("demuxer-thread", demuxer_thread, 0),
-    OPT_FLAG("prefetch-playlist", prefetch_open, 0),
+    OPT_CHOICE("prefetch-playlist", prefetch_open, 0,
+               ({"no", 0}, {"yes", 1}, {"full", 2})),
     OPT_FLAG("cache-pause", cache_pause, 0),
     OPT_FLAG("cache-pause-initial", cache_pause_initial, 0),
     OPT_FLOAT("cache-pause-wait", cache_pause_wait, M_OPT_MIN, .min = 0),
 
     OPT_DOUBLE("mf-fps", mf_fps, 0),
     OPT_STRING("mf-type", mf_type, 0),
+    OPT_INTRANGE("mf-prefetch", mf_prefetch, 0, 0, 64),
 #if HAVE_TV
     OPT_SUBSTRUCT("tv", tv_params, tv_params_conf, 0),
 #endif /* HAVE_TV */
@@ -465,6 +485,13 @@ const m_option_t mp_opts[] = {
     OPT_SUBSTRUCT("dvbin", stream_dvb_opts, stream_dvb_conf, 0),
 #endif
     OPT_SUBSTRUCT("", stream_lavf_opts, stream_lavf_conf, 0),
+#if HAVE_LIBURING
+    OPT_SUBSTRUCT("", stream_uring_opts, stream_uring_conf, 0),
+#endif
+    OPT_SUBSTRUCT("", stream_file_opts, stream_file_conf, 0),
+#if HAVE_LIBSMBCLIENT
+    OPT_SUBSTRUCT("", stream_smb_opts, stream_smb_conf, 0),
+#endif
 
 // ------------------------- a-v sync options --------------------
 
@@ -498,6 +525,9 @@ const m_option_t mp_opts[] = {
 
     OPT_STRING("ad", audio_decoders, 0),
     OPT_STRING("vd", video_decoders, 0),
+    OPT_FLAG("vd-queue-enable", vd_queue_enable, 0),
+    OPT_INTRANGE("vd-queue-max-frames", vd_queue_max_frames, 0, 1, 1000),
+    OPT_INTRANGE("vd-queue-max-bytes", vd_queue_max_bytes, 0, 0, INT_MAX),
 
     OPT_STRING("audio-spdif", audio_spdif, 0),
 
@@ -529,6 +559,8 @@ const m_option_t mp_opts[] = {
     OPT_PATHLIST("external-files", external_files, 0),
     OPT_CLI_ALIAS("external-file", "external-files-append"),
     OPT_FLAG("autoload-files", autoload_files, 0),
+    OPT_DOUBLE("external-file-timeout", external_file_timeout, M_OPT_MIN,
+               .min = 0),
     OPT_CHOICE("sub-auto", sub_auto, 0,
                ({"no", -1}, {"exact", 0}, {"fuzzy", 1}, {"all", 2})),
     OPT_CHOICE("audio-file-auto", audiofile_auto, 0,
@@ -570,6 +602,10 @@ const m_option_t mp_opts[] = {
                 {"weak", -1})),
     OPT_DOUBLE("audio-buffer", audio_buffer, M_OPT_MIN | M_OPT_MAX,
                .min = 0, .max = 10),
+    OPT_FLAG("audio-buffer-adaptive", audio_buffer_adaptive, 0),
+    OPT_DOUBLE("audio-clip-cache", audio_clip_cache, M_OPT_MIN | M_OPT_MAX,
+               .min = 0, .max = 600),
+    OPT_INTRANGE("audio-clip-cache-entries", audio_clip_cache_entries, 0, 1, 1000),
 
     OPT_STRING("title", wintitle, 0),
     OPT_STRING("force-media-title", media_title, 0),
@@ -591,6 +627,10 @@ const m_option_t mp_opts[] = {
                ({"0", 0}, {"1", 1}, {"2", 2}, {"3", 3})),
     OPT_INTRANGE("osd-duration", osd_duration, 0, 0, 3600000),
     OPT_FLAG("osd-fractions", osd_fractions, 0),
+    OPT_CHOICE("osd-stats", osd_stats, 0,
+               ({"no", 0}, {"playback", 1}, {"vo-passes", 2}, {"perf", 3})),
+    OPT_DOUBLE("osd-stats-interval", osd_stats_interval, M_OPT_RANGE,
+               .min = 0.05, .max = 3600),
 
     OPT_DOUBLE("sstep", step_sec, CONF_MIN, 0),
 
@@ -657,6 +697,8 @@ const m_option_t mp_opts[] = {
                ({"no", -1}, {"absolute", 0}, {"yes", 1}, {"always", 1})),
     OPT_FLOAT("hr-seek-demuxer-offset", hr_seek_demuxer_offset, 0),
     OPT_FLAG("hr-seek-framedrop", hr_seek_framedrop, 0),
+    OPT_FLAG("keyframe-scrub", keyframe_scrub, 0),
+    OPT_INTRANGE("frame-back-step-cache", backstep_cache, 0, 0, 1000),
     OPT_CHOICE_OR_INT("autosync", autosync, 0, 0, 10000,
                       ({"no", -1})),
 
@@ -692,6 +734,9 @@ const m_option_t mp_opts[] = {
     OPT_STRING("screenshot-template", screenshot_template, 0),
     OPT_STRING("screenshot-directory", screenshot_directory, M_OPT_FILE),
 
+    OPT_INTRANGE("thumbnail-count", thumbnail_count, 0, 0, 1000),
+    OPT_INTRANGE("thumbnail-width", thumbnail_width, 0, 16, 1024),
+
     OPT_STRING("record-file", record_file, M_OPT_FILE),
 
     OPT_SUBSTRUCT("", resample_opts, resample_config, 0),
@@ -700,6 +745,7 @@ const m_option_t mp_opts[] = {
 
     OPT_SUBSTRUCT("", vo, vo_sub_opts, 0),
     OPT_SUBSTRUCT("", demux_opts, demux_conf, 0),
+    OPT_SUBSTRUCT("", thread_opts, thread_conf, 0),
 
     OPT_SUBSTRUCT("", gl_video_opts, gl_video_conf, 0),
     OPT_SUBSTRUCT("", spirv_opts, spirv_conf, 0),
@@ -863,14 +909,18 @@ const m_option_t mp_opts[] = {
 const struct MPOpts mp_default_opts = {
     .use_terminal = 1,
     .msg_color = 1,
+    .perf_stats_interval = 1.0,
     .audio_driver_list = NULL,
     .audio_decoders = NULL,
     .video_decoders = NULL,
+    .vd_queue_max_frames = 3,
+    .vd_queue_max_bytes = 512 * 1024 * 1024,
     .softvol_max = 130,
     .softvol_volume = 100,
     .softvol_mute = 0,
     .gapless_audio = -1,
     .audio_buffer = 0.2,
+    .audio_clip_cache_entries = 16,
     .audio_device = "auto",
     .audio_client_name = "mpv",
     .wintitle = "${?media-title:${media-title}}${!media-title:No file} - mpv",
@@ -878,6 +928,7 @@ const struct MPOpts mp_default_opts = {
     .cursor_autohide_delay = 1000,
     .video_osd = 1,
     .osd_level = 1,
+    .osd_stats_interval = 1.0,
     .osd_duration = 1000,
 #if HAVE_LUA
     .lua_load_osc = 1,
@@ -900,6 +951,8 @@ const struct MPOpts mp_default_opts = {
     .autoload_files = 1,
     .demuxer_thread = 1,
     .hls_bitrate = INT_MAX,
+    .hls_adaptive_low = 5,
+    .hls_adaptive_high = 20,
     .cache_pause = 1,
     .cache_pause_wait = 1.0,
     .chapterrange = {-1, -1},
@@ -935,6 +988,7 @@ const struct MPOpts mp_default_opts = {
     .audiofile_auto = -1,
     .osd_bar_visible = 1,
     .screenshot_template = "mpv-shot%n",
+    .thumbnail_width = 200,
 
     .hwdec_api = HAVE_RPI ? "mmal" : "no",
     .hwdec_codecs = "h264,vc1,wmv3,hevc,mpeg2video,vp9",
@@ -947,6 +1001,7 @@ const struct MPOpts mp_default_opts = {
     .index_mode = 1,
 
     .mf_fps = 1.0,
+    .mf_prefetch = 4,
 
     .display_tags = (char **)(const char*[]){
         "Artist", "Album", "Album_Artist", "Comment", "Composer", "Genre",
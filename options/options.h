@@ -50,6 +50,9 @@ typedef struct mp_vo_opts {
 
     char *mmcss_profile;
 
+    int render_ahead;
+    int timing_spin;
+
     // vo_drm
     struct sws_opts *sws_opts;
     // vo_drm
@@ -64,6 +67,9 @@ struct mp_cache_opts {
     int back_buffer;
     char *file;
     int file_max;
+    char *dir;
+    int dir_max;
+    int retain;
 };
 
 // Subtitle options needed by the subtitle decoders/renderers.
@@ -87,6 +93,7 @@ struct mp_subtitle_opts {
     int sub_gray;
     int sub_filter_SDH;
     int sub_filter_SDH_harder;
+    char **sub_filter_regex;
     int ass_enabled;
     float ass_line_spacing;
     int ass_use_margins;
@@ -114,12 +121,17 @@ struct mp_osd_render_opts {
     int osd_scale_by_window;
     struct osd_style_opts *osd_style;
     int force_rgba_osd;
+    int osd_parallel_render;
 };
 
 typedef struct MPOpts {
     int property_print_help;
     int use_terminal;
     char *dump_stats;
+    char *perf_stats_file;
+    char *benchmark_file;
+    double perf_stats_interval;
+    char *trace_file;
     int verbose;
     int msg_really_quiet;
     char **msg_levels;
@@ -138,6 +150,7 @@ typedef struct MPOpts {
     char *lua_ytdl_format;
     char **lua_ytdl_raw_options;
     int lua_load_stats;
+    char *lua_bytecode_cache;
 
     int auto_load_scripts;
 
@@ -158,6 +171,9 @@ typedef struct MPOpts {
     float softvol_max;
     int gapless_audio;
     double audio_buffer;
+    int audio_buffer_adaptive;
+    double audio_clip_cache;
+    int audio_clip_cache_entries;
 
     mp_vo_opts *vo;
 
@@ -175,6 +191,9 @@ typedef struct MPOpts {
 
     char *audio_decoders;
     char *video_decoders;
+    int vd_queue_enable;
+    int vd_queue_max_frames;
+    int vd_queue_max_bytes;
     char *audio_spdif;
 
     struct mp_subtitle_opts *subs_rend;
@@ -183,6 +202,8 @@ typedef struct MPOpts {
     int osd_level;
     int osd_duration;
     int osd_fractions;
+    int osd_stats;
+    double osd_stats_interval;
     int video_osd;
 
     int untimed;
@@ -204,6 +225,8 @@ typedef struct MPOpts {
     char *force_configdir;
     int use_filedir_conf;
     int hls_bitrate;
+    double hls_adaptive_low;
+    double hls_adaptive_high;
     struct mp_cache_opts *stream_cache;
     int chapterrange[2];
     int edition_id;
@@ -216,6 +239,8 @@ typedef struct MPOpts {
     int hr_seek;
     float hr_seek_demuxer_offset;
     int hr_seek_framedrop;
+    int keyframe_scrub;
+    int backstep_cache;
     float audio_delay;
     float default_max_pts_correction;
     int autosync;
@@ -249,6 +274,7 @@ typedef struct MPOpts {
     int keep_open_pause;
     double image_display_duration;
     char *lavfi_complex;
+    int lavfi_complex_threads;
     int stream_id[2][STREAM_TYPE_COUNT];
     char **stream_lang[STREAM_TYPE_COUNT];
     int stream_auto_sel;
@@ -269,6 +295,8 @@ typedef struct MPOpts {
     struct image_writer_opts *screenshot_image_opts;
     char *screenshot_template;
     char *screenshot_directory;
+    int thumbnail_count;
+    int thumbnail_width;
 
     double force_fps;
     int index_mode;
@@ -288,6 +316,7 @@ typedef struct MPOpts {
     char **audiofile_paths;
     char **external_files;
     int autoload_files;
+    double external_file_timeout;
     int sub_auto;
     int audiofile_auto;
     int osd_bar_visible;
@@ -303,12 +332,16 @@ typedef struct MPOpts {
     struct cdda_params *stream_cdda_opts;
     struct dvb_params *stream_dvb_opts;
     struct stream_lavf_params *stream_lavf_opts;
+    struct uring_opts *stream_uring_opts;
+    struct stream_file_opts *stream_file_opts;
+    struct stream_smb_opts *stream_smb_opts;
 
     char *cdrom_device;
     char *bluray_device;
 
     double mf_fps;
     char *mf_type;
+    int mf_prefetch;
 
     struct demux_rawaudio_opts *demux_rawaudio;
     struct demux_rawvideo_opts *demux_rawvideo;
@@ -337,6 +370,7 @@ typedef struct MPOpts {
     struct opengl_opts *opengl_opts;
     struct vulkan_opts *vulkan_opts;
     struct spirv_opts *spirv_opts;
+    struct thread_opts *thread_opts;
     struct d3d11_opts *d3d11_opts;
     struct d3d11va_opts *d3d11va_opts;
     struct cocoa_opts *cocoa_opts;
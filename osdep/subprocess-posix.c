@@ -23,10 +23,12 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <signal.h>
+#include <pthread.h>
 
 #include "osdep/subprocess.h"
 
 #include "osdep/io.h"
+#include "osdep/threads.h"
 #include "common/common.h"
 #include "stream/stream.h"
 
@@ -55,23 +57,20 @@ static int sparse_poll(struct pollfd *fds, int num_fds, int timeout)
     return r;
 }
 
-int mp_subprocess(char **args, struct mp_cancel *cancel, void *ctx,
-                  subprocess_read_cb on_stdout, subprocess_read_cb on_stderr,
-                  char **error)
+// Start args[0] with stdin redirected to /dev/null. If p_stdout/p_stderr
+// are not NULL, the read end of a pipe connected to the child's stdout/stderr
+// is returned in p_stdout[0]/p_stderr[0]. Returns false on failure.
+static bool spawn(char **args, int p_stdout[2], int p_stderr[2], pid_t *out_pid)
 {
     posix_spawn_file_actions_t fa;
     bool fa_destroy = false;
-    int status = -1;
-    int p_stdout[2] = {-1, -1};
-    int p_stderr[2] = {-1, -1};
     int devnull = -1;
     pid_t pid = -1;
     bool spawned = false;
-    bool killed_by_us = false;
 
-    if (on_stdout && mp_make_cloexec_pipe(p_stdout) < 0)
+    if (p_stdout && mp_make_cloexec_pipe(p_stdout) < 0)
         goto done;
-    if (on_stderr && mp_make_cloexec_pipe(p_stderr) < 0)
+    if (p_stderr && mp_make_cloexec_pipe(p_stderr) < 0)
         goto done;
 
     devnull = open("/dev/null", O_RDONLY | O_CLOEXEC);
@@ -84,9 +83,9 @@ int mp_subprocess(char **args, struct mp_cancel *cancel, void *ctx,
     // redirect stdin/stdout/stderr
     if (posix_spawn_file_actions_adddup2(&fa, devnull, 0))
         goto done;
-    if (p_stdout[1] >= 0 && posix_spawn_file_actions_adddup2(&fa, p_stdout[1], 1))
+    if (p_stdout && posix_spawn_file_actions_adddup2(&fa, p_stdout[1], 1))
         goto done;
-    if (p_stderr[1] >= 0 && posix_spawn_file_actions_adddup2(&fa, p_stderr[1], 2))
+    if (p_stderr && posix_spawn_file_actions_adddup2(&fa, p_stderr[1], 2))
         goto done;
 
     if (posix_spawnp(&pid, args[0], &fa, NULL, args, environ)) {
@@ -94,10 +93,53 @@ int mp_subprocess(char **args, struct mp_cancel *cancel, void *ctx,
         goto done;
     }
     spawned = true;
+    *out_pid = pid;
 
-    SAFE_CLOSE(p_stdout[1]);
-    SAFE_CLOSE(p_stderr[1]);
+done:
+    if (fa_destroy)
+        posix_spawn_file_actions_destroy(&fa);
     SAFE_CLOSE(devnull);
+    int *pipes[2] = {p_stdout, p_stderr};
+    for (int n = 0; n < 2; n++) {
+        if (pipes[n]) {
+            SAFE_CLOSE(pipes[n][1]);
+            if (!spawned)
+                SAFE_CLOSE(pipes[n][0]);
+        }
+    }
+    return spawned;
+}
+
+// Translate a waitpid() status to the mp_subprocess() return value and error.
+static int exit_status(bool spawned, int status, bool killed_by_us,
+                       char **error)
+{
+    if (!spawned || (WIFEXITED(status) && WEXITSTATUS(status) == 127)) {
+        *error = "init";
+        return -1;
+    } else if (WIFEXITED(status)) {
+        *error = NULL;
+        return WEXITSTATUS(status);
+    } else {
+        *error = "killed";
+        return killed_by_us ? MP_SUBPROCESS_EKILLED_BY_US : -1;
+    }
+}
+
+int mp_subprocess(char **args, struct mp_cancel *cancel, void *ctx,
+                  subprocess_read_cb on_stdout, subprocess_read_cb on_stderr,
+                  char **error)
+{
+    int status = -1;
+    int p_stdout[2] = {-1, -1};
+    int p_stderr[2] = {-1, -1};
+    pid_t pid = -1;
+    bool killed_by_us = false;
+
+    bool spawned = spawn(args, on_stdout ? p_stdout : NULL,
+                         on_stderr ? p_stderr : NULL, &pid);
+    if (!spawned)
+        goto done;
 
     int *read_fds[2] = {&p_stdout[0], &p_stderr[0]};
     subprocess_read_cb read_cbs[2] = {on_stdout, on_stderr};
@@ -136,24 +178,259 @@ int mp_subprocess(char **args, struct mp_cancel *cancel, void *ctx,
     while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
 
 done:
-    if (fa_destroy)
-        posix_spawn_file_actions_destroy(&fa);
     SAFE_CLOSE(p_stdout[0]);
-    SAFE_CLOSE(p_stdout[1]);
     SAFE_CLOSE(p_stderr[0]);
-    SAFE_CLOSE(p_stderr[1]);
-    SAFE_CLOSE(devnull);
 
-    if (!spawned || (WIFEXITED(status) && WEXITSTATUS(status) == 127)) {
-        *error = "init";
-        status = -1;
-    } else if (WIFEXITED(status)) {
-        *error = NULL;
-        status = WEXITSTATUS(status);
+    return exit_status(spawned, status, killed_by_us, error);
+}
+
+struct group_child {
+    int64_t id;
+    pid_t pid;
+    int fds[2];         // read ends of stdout/stderr pipes, -1 if closed
+    bool killed_by_us;
+};
+
+struct mp_subprocess_group {
+    pthread_t thread;
+    int wakeup_pipe[2];
+    void (*wakeup_cb)(void *ctx);
+    void *wakeup_ctx;
+
+    // --- protected by lock
+    pthread_mutex_t lock;
+    bool terminate;
+    int64_t id_counter;
+    struct group_child **children;
+    int num_children;
+    struct mp_subprocess_event *events;
+    int num_events;
+};
+
+// Must be called locked.
+static void queue_event(struct mp_subprocess_group *g,
+                        struct mp_subprocess_event ev)
+{
+    MP_TARRAY_APPEND(g, g->events, g->num_events, ev);
+    if (g->wakeup_cb)
+        g->wakeup_cb(g->wakeup_ctx);
+}
+
+// Must be called locked.
+static void queue_output(struct mp_subprocess_group *g, int64_t id,
+                         enum mp_subprocess_event_type type,
+                         char *data, size_t size)
+{
+    // Merge with the previous event if it's output of the same kind, so that
+    // a slow reader doesn't cause lots of small events.
+    struct mp_subprocess_event *last =
+        g->num_events ? &g->events[g->num_events - 1] : NULL;
+    if (last && last->id == id && last->type == type) {
+        last->data = talloc_realloc_size(g, last->data, last->size + size);
+        memcpy(last->data + last->size, data, size);
+        last->size += size;
+        return;
+    }
+    queue_event(g, (struct mp_subprocess_event){
+        .id = id,
+        .type = type,
+        .data = talloc_memdup(g, data, size),
+        .size = size,
+    });
+}
+
+// Reap the child if it has closed its pipes and exited. If block is set, wait
+// for it to exit. Returns true if the child was removed. Must be called locked.
+static bool reap_child(struct mp_subprocess_group *g, int index, bool block)
+{
+    struct group_child *c = g->children[index];
+    if (c->fds[0] >= 0 || c->fds[1] >= 0)
+        return false;
+    int status = 0;
+    pid_t r;
+    while ((r = waitpid(c->pid, &status, block ? 0 : WNOHANG)) < 0 &&
+           errno == EINTR) {}
+    if (r == 0)
+        return false; // still running
+    struct mp_subprocess_event ev = {.id = c->id, .type = MP_SUBPROCESS_EVENT_EXIT};
+    ev.status = exit_status(r > 0, status, c->killed_by_us, &ev.error);
+    queue_event(g, ev);
+    talloc_free(c);
+    MP_TARRAY_REMOVE_AT(g->children, g->num_children, index);
+    return true;
+}
+
+static void *group_thread(void *p)
+{
+    struct mp_subprocess_group *g = p;
+    mpthread_set_name("subprocess");
+
+    struct pollfd *fds = NULL;
+    struct group_child **fd_child = NULL;
+    int num_fds = 0;
+
+    pthread_mutex_lock(&g->lock);
+    while (!g->terminate) {
+        // Children which closed their pipes, but didn't exit yet, are polled
+        // for termination periodically.
+        bool need_reap = false;
+        num_fds = 0;
+        MP_TARRAY_GROW(NULL, fds, g->num_children * 2);
+        MP_TARRAY_GROW(NULL, fd_child, g->num_children * 2);
+        fds[num_fds++] = (struct pollfd){.fd = g->wakeup_pipe[0], .events = POLLIN};
+        for (int n = g->num_children - 1; n >= 0; n--) {
+            struct group_child *c = g->children[n];
+            if (reap_child(g, n, false))
+                continue;
+            need_reap |= c->fds[0] < 0 && c->fds[1] < 0;
+            for (int i = 0; i < 2; i++) {
+                if (c->fds[i] >= 0) {
+                    fd_child[num_fds] = c;
+                    fds[num_fds++] = (struct pollfd){.fd = c->fds[i],
+                                                     .events = POLLIN};
+                }
+            }
+        }
+        pthread_mutex_unlock(&g->lock);
+
+        int r = poll(fds, num_fds, need_reap ? 50 : -1);
+
+        pthread_mutex_lock(&g->lock);
+        if (r < 0 && errno != EINTR)
+            break;
+        if (r <= 0)
+            continue;
+        if (fds[0].revents)
+            mp_flush_wakeup_pipe(g->wakeup_pipe[0]);
+        // (children are only removed by this thread, so fd_child is valid)
+        for (int n = 1; n < num_fds; n++) {
+            if (!fds[n].revents)
+                continue;
+            struct group_child *c = fd_child[n];
+            int i = c->fds[0] == fds[n].fd ? 0 : 1;
+            char buf[4096];
+            ssize_t len = read(c->fds[i], buf, sizeof(buf));
+            if (len < 0 && errno == EINTR)
+                continue;
+            if (len > 0) {
+                queue_output(g, c->id, i ? MP_SUBPROCESS_EVENT_STDERR
+                                         : MP_SUBPROCESS_EVENT_STDOUT,
+                             buf, len);
+            }
+            if (len <= 0)
+                SAFE_CLOSE(c->fds[i]);
+        }
+    }
+
+    // Terminating: kill everything that's left.
+    for (int n = g->num_children - 1; n >= 0; n--) {
+        struct group_child *c = g->children[n];
+        kill(c->pid, SIGKILL);
+        c->killed_by_us = true;
+        SAFE_CLOSE(c->fds[0]);
+        SAFE_CLOSE(c->fds[1]);
+        reap_child(g, n, true);
+    }
+    pthread_mutex_unlock(&g->lock);
+
+    talloc_free(fds);
+    talloc_free(fd_child);
+    return NULL;
+}
+
+struct mp_subprocess_group *mp_subprocess_group_create(void (*wakeup_cb)(void *ctx),
+                                                       void *wakeup_ctx)
+{
+    struct mp_subprocess_group *g = talloc_zero(NULL, struct mp_subprocess_group);
+    g->wakeup_cb = wakeup_cb;
+    g->wakeup_ctx = wakeup_ctx;
+    pthread_mutex_init(&g->lock, NULL);
+    if (mp_make_wakeup_pipe(g->wakeup_pipe) < 0)
+        goto error;
+    if (pthread_create(&g->thread, NULL, group_thread, g)) {
+        close(g->wakeup_pipe[0]);
+        close(g->wakeup_pipe[1]);
+        goto error;
+    }
+    return g;
+
+error:
+    pthread_mutex_destroy(&g->lock);
+    talloc_free(g);
+    return NULL;
+}
+
+static void wakeup_group(struct mp_subprocess_group *g)
+{
+    (void)write(g->wakeup_pipe[1], &(char){0}, 1);
+}
+
+void mp_subprocess_group_destroy(struct mp_subprocess_group *g)
+{
+    if (!g)
+        return;
+    pthread_mutex_lock(&g->lock);
+    g->terminate = true;
+    g->wakeup_cb = NULL;
+    pthread_mutex_unlock(&g->lock);
+    wakeup_group(g);
+    pthread_join(g->thread, NULL);
+    close(g->wakeup_pipe[0]);
+    close(g->wakeup_pipe[1]);
+    pthread_mutex_destroy(&g->lock);
+    talloc_free(g);
+}
+
+int64_t mp_subprocess_group_start(struct mp_subprocess_group *g, char **args)
+{
+    struct group_child *c = talloc_zero(NULL, struct group_child);
+    int p_stdout[2] = {-1, -1};
+    int p_stderr[2] = {-1, -1};
+    bool spawned = spawn(args, p_stdout, p_stderr, &c->pid);
+    c->fds[0] = p_stdout[0];
+    c->fds[1] = p_stderr[0];
+
+    pthread_mutex_lock(&g->lock);
+    c->id = ++g->id_counter;
+    int64_t id = c->id;
+    if (spawned) {
+        MP_TARRAY_APPEND(g, g->children, g->num_children, c);
     } else {
-        *error = "killed";
-        status = killed_by_us ? MP_SUBPROCESS_EKILLED_BY_US : -1;
+        struct mp_subprocess_event ev = {.id = id, .type = MP_SUBPROCESS_EVENT_EXIT};
+        ev.status = exit_status(false, 0, false, &ev.error);
+        queue_event(g, ev);
+        talloc_free(c);
+    }
+    pthread_mutex_unlock(&g->lock);
+
+    wakeup_group(g);
+    return id;
+}
+
+void mp_subprocess_group_kill(struct mp_subprocess_group *g, int64_t id)
+{
+    pthread_mutex_lock(&g->lock);
+    for (int n = 0; n < g->num_children; n++) {
+        struct group_child *c = g->children[n];
+        // (pid can't be reused yet, as the child is reaped under the lock)
+        if (c->id == id && !c->killed_by_us) {
+            kill(c->pid, SIGKILL);
+            c->killed_by_us = true;
+        }
     }
+    pthread_mutex_unlock(&g->lock);
+}
 
-    return status;
+bool mp_subprocess_group_read(struct mp_subprocess_group *g, void *ta_ctx,
+                              struct mp_subprocess_event *ev)
+{
+    pthread_mutex_lock(&g->lock);
+    bool r = g->num_events > 0;
+    if (r) {
+        *ev = g->events[0];
+        MP_TARRAY_REMOVE_AT(g->events, g->num_events, 0);
+        talloc_steal(ta_ctx, ev->data);
+    }
+    pthread_mutex_unlock(&g->lock);
+    return r;
 }
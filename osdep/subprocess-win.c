@@ -357,3 +357,28 @@ done:
     talloc_free(tmp);
     return status;
 }
+
+struct mp_subprocess_group *mp_subprocess_group_create(void (*wakeup_cb)(void *ctx),
+                                                       void *wakeup_ctx)
+{
+    return NULL;
+}
+
+void mp_subprocess_group_destroy(struct mp_subprocess_group *g)
+{
+}
+
+int64_t mp_subprocess_group_start(struct mp_subprocess_group *g, char **args)
+{
+    return -1;
+}
+
+void mp_subprocess_group_kill(struct mp_subprocess_group *g, int64_t id)
+{
+}
+
+bool mp_subprocess_group_read(struct mp_subprocess_group *g, void *ta_ctx,
+                              struct mp_subprocess_event *ev)
+{
+    return false;
+}
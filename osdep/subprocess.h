@@ -18,7 +18,9 @@
 #ifndef MP_SUBPROCESS_H_
 #define MP_SUBPROCESS_H_
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 struct mp_cancel;
 
@@ -36,4 +38,40 @@ int mp_subprocess(char **args, struct mp_cancel *cancel, void *ctx,
 struct mp_log;
 void mp_subprocess_detached(struct mp_log *log, char **args);
 
+// Runs any number of subprocesses, with the output of all of them read by a
+// single thread. Output and termination are queued as events; wakeup_cb is
+// called (from that thread) when new events are available.
+struct mp_subprocess_group;
+
+enum mp_subprocess_event_type {
+    MP_SUBPROCESS_EVENT_STDOUT,
+    MP_SUBPROCESS_EVENT_STDERR,
+    MP_SUBPROCESS_EVENT_EXIT,   // always the last event for a process
+};
+
+struct mp_subprocess_event {
+    int64_t id;
+    enum mp_subprocess_event_type type;
+    // STDOUT/STDERR: the data read (allocated with the read call's ta_ctx)
+    char *data;
+    size_t size;
+    // EXIT: same as mp_subprocess() return value and error
+    int status;
+    char *error;
+};
+
+// Returns NULL if not supported on this platform.
+struct mp_subprocess_group *mp_subprocess_group_create(void (*wakeup_cb)(void *ctx),
+                                                       void *wakeup_ctx);
+// Kills all processes that are still running.
+void mp_subprocess_group_destroy(struct mp_subprocess_group *g);
+// Returns an ID >0. If the process can't be started, an EXIT event with
+// error "init" is queued.
+int64_t mp_subprocess_group_start(struct mp_subprocess_group *g, char **args);
+// Kill the process. Its EXIT event will have status MP_SUBPROCESS_EKILLED_BY_US.
+void mp_subprocess_group_kill(struct mp_subprocess_group *g, int64_t id);
+// Return the next event. Returns false if there are none.
+bool mp_subprocess_group_read(struct mp_subprocess_group *g, void *ta_ctx,
+                              struct mp_subprocess_event *ev);
+
 #endif
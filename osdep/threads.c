@@ -16,14 +16,47 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <pthread.h>
 
 #include "config.h"
 
+#if HAVE_POSIX
+#include <sched.h>
+#endif
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "mpv_talloc.h"
+#include "options/m_config.h"
+#include "options/m_option.h"
+#include "misc/bstr.h"
+
 #include "threads.h"
 #include "timer.h"
 
+struct thread_opts {
+    char **affinity;
+    char **priority;
+};
+
+#define OPT_BASE_STRUCT struct thread_opts
+const struct m_sub_options thread_conf = {
+    .opts = (const struct m_option[]) {
+        OPT_KEYVALUELIST("thread-affinity", affinity, 0),
+        OPT_KEYVALUELIST("thread-priority", priority, 0),
+        {0}
+    },
+    .size = sizeof(struct thread_opts),
+};
+
 int mpthread_mutex_init_recursive(pthread_mutex_t *mutex)
 {
     pthread_mutexattr_t attr;
@@ -49,3 +82,115 @@ void mpthread_set_name(const char *name)
     pthread_setname_np(tname);
 #endif
 }
+
+static const char *find_role(char **list, const char *role)
+{
+    for (int n = 0; list && list[n] && list[n + 1]; n += 2) {
+        if (strcmp(list[n], role) == 0)
+            return list[n + 1];
+    }
+    for (int n = 0; list && list[n] && list[n + 1]; n += 2) {
+        if (strcmp(list[n], "all") == 0)
+            return list[n + 1];
+    }
+    return NULL;
+}
+
+static void apply_affinity(struct mp_log *log, const char *role,
+                           const char *val)
+{
+#if HAVE_PTHREAD_SETAFFINITY
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    bstr rest = bstr0(val);
+    while (rest.len) {
+        bstr item;
+        bstr_split_tok(rest, "+", &item, &rest);
+        bstr a, b;
+        if (!bstr_split_tok(item, "-", &a, &b))
+            b = a;
+        bstr ra, rb;
+        long long first = bstrtoll(a, &ra, 10);
+        long long last = bstrtoll(b, &rb, 10);
+        if (ra.len || rb.len || !a.len || !b.len || first < 0 ||
+            last < first || last >= CPU_SETSIZE)
+        {
+            mp_err(log, "Invalid CPU list '%s' for thread '%s'.\n", val, role);
+            return;
+        }
+        for (long long cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, &set);
+    }
+    int r = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (r) {
+        mp_warn(log, "Could not set CPU affinity of thread '%s': %s\n",
+                role, mp_strerror(r));
+    }
+#else
+    mp_warn(log, "Setting thread CPU affinity is not supported.\n");
+#endif
+}
+
+static void apply_priority(struct mp_log *log, const char *role,
+                           const char *val)
+{
+    bstr v = bstr0(val);
+    bstr kind, rest;
+    if (bstr_split_tok(v, "/", &kind, &rest) &&
+        (bstr_equals0(kind, "fifo") || bstr_equals0(kind, "rr")))
+    {
+#if HAVE_POSIX
+        int policy = bstr_equals0(kind, "fifo") ? SCHED_FIFO : SCHED_RR;
+        v = rest;
+        long long prio = bstrtoll(v, &rest, 10);
+        if (rest.len || !v.len || prio < sched_get_priority_min(policy) ||
+            prio > sched_get_priority_max(policy))
+        {
+            mp_err(log, "Invalid realtime priority '%s' for thread '%s'.\n",
+                   val, role);
+            return;
+        }
+        struct sched_param param = { .sched_priority = prio };
+        int r = pthread_setschedparam(pthread_self(), policy, &param);
+        if (r) {
+            mp_warn(log, "Could not set realtime priority of thread '%s': "
+                    "%s\n", role, mp_strerror(r));
+        }
+#else
+        mp_warn(log, "Realtime thread priorities are not supported.\n");
+#endif
+        return;
+    }
+
+    long long nice = bstrtoll(v, &rest, 10);
+    if (rest.len || !v.len || nice < -20 || nice > 19) {
+        mp_err(log, "Invalid priority '%s' for thread '%s'.\n", val, role);
+        return;
+    }
+#ifdef __linux__
+    // On Linux, nice values are per-thread when addressed by TID.
+    if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), nice) < 0) {
+        mp_warn(log, "Could not set nice level of thread '%s': %s\n",
+                role, mp_strerror(errno));
+    }
+#else
+    mp_warn(log, "Per-thread nice levels are not supported.\n");
+#endif
+}
+
+void mpthread_apply_opts(struct mpv_global *global, struct mp_log *log,
+                         const char *role)
+{
+    void *tmp = talloc_new(NULL);
+    struct thread_opts *opts = mp_get_config_group(tmp, global, &thread_conf);
+
+    const char *affinity = find_role(opts->affinity, role);
+    if (affinity)
+        apply_affinity(log, role, affinity);
+
+    const char *priority = find_role(opts->priority, role);
+    if (priority)
+        apply_priority(log, role, priority);
+
+    talloc_free(tmp);
+}
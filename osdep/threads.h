@@ -10,4 +10,12 @@ int mpthread_mutex_init_recursive(pthread_mutex_t *mutex);
 // Set thread name (for debuggers).
 void mpthread_set_name(const char *name);
 
+struct mpv_global;
+struct mp_log;
+
+// Apply the --thread-affinity and --thread-priority settings for the given
+// role (e.g. "ao", "vo") to the calling thread. Failures are only logged.
+void mpthread_apply_opts(struct mpv_global *global, struct mp_log *log,
+                         const char *role);
+
 #endif
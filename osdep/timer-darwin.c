@@ -36,6 +36,11 @@ void mp_sleep_us(int64_t us)
     mach_wait_until(deadline);
 }
 
+void mp_raw_sleep_until_us(uint64_t raw_us)
+{
+    mach_wait_until(raw_us / 1e6 / timebase_ratio);
+}
+
 uint64_t mp_raw_time_us(void)
 {
     return mach_absolute_time() * timebase_ratio * 1e6;
@@ -37,6 +37,13 @@ void mp_sleep_us(int64_t us)
     Sleep(us / 1000);
 }
 
+void mp_raw_sleep_until_us(uint64_t raw_us)
+{
+    uint64_t now = mp_raw_time_us();
+    if (raw_us > now)
+        mp_sleep_us(raw_us - now);
+}
+
 uint64_t mp_raw_time_us(void)
 {
     LARGE_INTEGER perf_count;
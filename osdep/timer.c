@@ -81,6 +81,16 @@ int64_t mp_add_timeout(int64_t time_us, double timeout_sec)
     return time_us + ti;
 }
 
+void mp_sleep_until_us(int64_t time_us, int64_t spin_us)
+{
+    int64_t sleep_until = time_us - MPMAX(spin_us, 0);
+    if (sleep_until > mp_time_us())
+        mp_raw_sleep_until_us(sleep_until + raw_time_offset);
+    while (mp_time_us() < time_us) {
+        // busy wait
+    }
+}
+
 static void get_realtime(struct timespec *out_ts)
 {
 #if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0
@@ -33,10 +33,18 @@ double mp_time_sec(void);
 // Provided by OS specific functions (timer-linux.c)
 void mp_raw_time_init(void);
 uint64_t mp_raw_time_us(void);
+// Sleep until mp_raw_time_us() would return at least raw_us. Uses an absolute
+// deadline where the OS supports it, so wakeup latency does not accumulate.
+void mp_raw_sleep_until_us(uint64_t raw_us);
 
 // Sleep in microseconds.
 void mp_sleep_us(int64_t us);
 
+// Sleep until mp_time_us() >= time_us. If spin_us is > 0, the last spin_us
+// microseconds before the deadline are busy-waited instead of slept, which
+// avoids the scheduler's wakeup slack at the cost of CPU time.
+void mp_sleep_until_us(int64_t time_us, int64_t spin_us);
+
 #define MP_START_TIME 10000000
 
 // Return the amount of time that has passed since the last call, in
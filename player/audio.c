@@ -83,8 +83,11 @@ static bool update_speed_filters(struct MPContext *mpctx)
     af_control_all(afs, AF_CONTROL_SET_PLAYBACK_SPEED, &(double){1});
     af_control_all(afs, AF_CONTROL_SET_PLAYBACK_SPEED_RESAMPLE, &(double){1});
 
+    // Keep an inserted speed filter around. It's a passthrough at normal
+    // speed, while removing it would renegotiate the whole filter chain -
+    // which is expensive when the speed is changed continuously.
     if (speed == 1.0)
-        return !af_find_by_label(afs, "playback-speed");
+        return true;
 
     // Compatibility: if the user uses --af=scaletempo, always use this
     // filter to change speed. Don't insert a second filter (any) either.
@@ -279,6 +282,7 @@ void reset_audio_state(struct MPContext *mpctx)
 {
     if (mpctx->ao_chain)
         ao_chain_reset_state(mpctx->ao_chain);
+    audio_cache_abort_capture(mpctx);
     mpctx->audio_status = mpctx->ao_chain ? STATUS_SYNCING : STATUS_EOF;
     mpctx->delay = 0;
     mpctx->audio_drop_throttle = 0;
@@ -328,6 +332,7 @@ static void ao_chain_uninit(struct ao_chain *ao_c)
 
 void uninit_audio_chain(struct MPContext *mpctx)
 {
+    audio_cache_abort_capture(mpctx);
     if (mpctx->ao_chain) {
         ao_chain_uninit(mpctx->ao_chain);
         mpctx->ao_chain = NULL;
@@ -550,23 +555,54 @@ init_error:
     error_on_track(mpctx, track);
 }
 
-int init_audio_decoder(struct MPContext *mpctx, struct track *track)
+static struct dec_audio *create_audio_decoder(struct MPContext *mpctx,
+                                              struct sh_stream *sh)
 {
-    assert(!track->d_audio);
-    if (!track->stream)
-        goto init_error;
-
-    track->d_audio = talloc_zero(NULL, struct dec_audio);
-    struct dec_audio *d_audio = track->d_audio;
+    struct dec_audio *d_audio = talloc_zero(NULL, struct dec_audio);
     d_audio->log = mp_log_new(d_audio, mpctx->log, "!ad");
     d_audio->global = mpctx->global;
     d_audio->opts = mpctx->opts;
-    d_audio->header = track->stream;
-    d_audio->codec = track->stream->codec;
+    d_audio->header = sh;
+    d_audio->codec = sh->codec;
 
     d_audio->try_spdif = true;
 
-    if (!audio_init_best_codec(d_audio))
+    if (!audio_init_best_codec(d_audio)) {
+        audio_uninit(d_audio);
+        return NULL;
+    }
+    return d_audio;
+}
+
+// Open the decoder for the preselected audio stream of a prefetched demuxer,
+// so that init_audio_decoder() can use it right away when the file starts.
+struct dec_audio *prefetch_audio_decoder(struct MPContext *mpctx,
+                                         struct demuxer *demuxer)
+{
+    for (int n = 0; n < demux_get_num_stream(demuxer); n++) {
+        struct sh_stream *sh = demux_get_stream(demuxer, n);
+        if (sh->type == STREAM_AUDIO && demux_stream_is_selected(sh)) {
+            MP_VERBOSE(mpctx, "Opening audio decoder for prefetched file.\n");
+            return create_audio_decoder(mpctx, sh);
+        }
+    }
+    return NULL;
+}
+
+int init_audio_decoder(struct MPContext *mpctx, struct track *track)
+{
+    assert(!track->d_audio);
+    if (!track->stream)
+        goto init_error;
+
+    struct dec_audio *prefetched = mpctx->prefetched_audio_dec;
+    if (prefetched && prefetched->header == track->stream) {
+        track->d_audio = prefetched;
+        mpctx->prefetched_audio_dec = NULL;
+    } else {
+        track->d_audio = create_audio_decoder(mpctx, track->stream);
+    }
+    if (!track->d_audio)
         goto init_error;
 
     return 1;
@@ -869,7 +905,7 @@ static bool copy_output(struct MPContext *mpctx, struct ao_chain *ao_c,
     return true;
 }
 
-static int decode_new_frame(struct ao_chain *ao_c)
+static int decode_new_frame(struct MPContext *mpctx, struct ao_chain *ao_c)
 {
     if (ao_c->input_frame)
         return AD_OK;
@@ -882,8 +918,12 @@ static int decode_new_frame(struct ao_chain *ao_c)
         res = audio_get_frame(ao_c->audio_src, &ao_c->input_frame);
     }
 
-    if (ao_c->input_frame)
+    if (ao_c->input_frame) {
         mp_aframe_config_copy(ao_c->input_format, ao_c->input_frame);
+        audio_cache_capture_frame(mpctx, ao_c->input_frame);
+    }
+    if (res == DATA_EOF)
+        audio_cache_finish_capture(mpctx);
 
     switch (res) {
     case DATA_OK:       return AD_OK;
@@ -925,7 +965,7 @@ static int filter_audio(struct MPContext *mpctx, struct mp_audio_buffer *outbuf,
         if (copy_output(mpctx, ao_c, minsamples, endpts, false, &eof))
             break;
 
-        res = decode_new_frame(ao_c);
+        res = decode_new_frame(mpctx, ao_c);
         if (res == AD_NO_PROGRESS)
             continue;
         if (res == AD_WAIT || res == AD_STARVE)
@@ -1051,7 +1091,7 @@ void fill_audio_out_buffers(struct MPContext *mpctx)
         // the format is already known.
         int r = AD_NO_PROGRESS;
         while (r == AD_NO_PROGRESS)
-            r = decode_new_frame(mpctx->ao_chain);
+            r = decode_new_frame(mpctx, mpctx->ao_chain);
         if (r == AD_WAIT)
             return; // continue later when new data is available
         if (r == AD_EOF) {
@@ -0,0 +1,288 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Cache for the fully decoded audio of short local files (--audio-clip-cache).
+ * While such a file plays from start to end, the decoder output is collected
+ * as packed PCM. On EOF it's wrapped into a WAV image and kept in a small LRU.
+ * Loading the same unchanged file again plays the WAV image from memory, which
+ * skips file access, format probing and the real decoder.
+ */
+
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <libavutil/intreadwrite.h>
+
+#include "osdep/io.h"
+#include "mpv_talloc.h"
+#include "common/common.h"
+#include "common/msg.h"
+#include "options/options.h"
+#include "options/path.h"
+#include "audio/aframe.h"
+#include "audio/chmap.h"
+#include "audio/format.h"
+#include "demux/demux.h"
+#include "stream/stream.h"
+
+#include "core.h"
+
+#define WAV_HEADER_SIZE 68
+
+struct clip {
+    char *path;
+    int64_t size;
+    int64_t mtime;
+    bstr wav;           // complete WAV file, including header
+};
+
+struct audio_cache {
+    struct clip **clips;    // most recently used first
+    int num_clips;
+
+    // Capture state for the currently playing file.
+    struct clip *capture;   // NULL if not capturing
+    int format;             // packed AF_FORMAT_*
+    struct mp_chmap chmap;
+    int rate;
+    double duration;        // captured so far, in seconds
+};
+
+static struct audio_cache *get_cache(struct MPContext *mpctx)
+{
+    if (!mpctx->audio_cache)
+        mpctx->audio_cache = talloc_zero(mpctx, struct audio_cache);
+    return mpctx->audio_cache;
+}
+
+static bool stat_file(const char *path, struct stat *st)
+{
+    return !mp_is_url(bstr0(path)) && stat(path, st) == 0 && S_ISREG(st->st_mode);
+}
+
+static void trim_cache(struct audio_cache *c, int max)
+{
+    while (c->num_clips > max) {
+        talloc_free(c->clips[c->num_clips - 1]);
+        c->num_clips--;
+    }
+}
+
+// If the file to be opened is in the cache, open a demuxer for the cached
+// audio and set it as mpctx->demuxer. Returns false if this did not happen.
+bool audio_cache_open(struct MPContext *mpctx)
+{
+    struct audio_cache *c = mpctx->audio_cache;
+    char *path = mpctx->stream_open_filename;
+    struct stat st;
+    if (!c || !c->num_clips || !mpctx->opts->audio_clip_cache ||
+        !stat_file(path, &st))
+        return false;
+
+    for (int n = 0; n < c->num_clips; n++) {
+        struct clip *clip = c->clips[n];
+        if (strcmp(clip->path, path) != 0)
+            continue;
+        if (clip->size != st.st_size || clip->mtime != st.st_mtime) {
+            MP_TARRAY_REMOVE_AT(c->clips, c->num_clips, n);
+            talloc_free(clip);
+            return false;
+        }
+        // Move to front.
+        MP_TARRAY_REMOVE_AT(c->clips, c->num_clips, n);
+        MP_TARRAY_INSERT_AT(c, c->clips, c->num_clips, 0, clip);
+
+        stream_t *s = open_memory_stream(clip->wav.start, clip->wav.len);
+        s->lavf_type = "wav";
+        struct demuxer_params params = {
+            .force_format = "lavf",
+        };
+        struct demuxer *demux = demux_open(s, &params, mpctx->global);
+        if (!demux) {
+            free_stream(s);
+            return false;
+        }
+        MP_VERBOSE(mpctx, "Playing decoded audio from clip cache.\n");
+        mpctx->demuxer = demux;
+        mpctx->playing_cached_audio = true;
+        return true;
+    }
+    return false;
+}
+
+// Called when the audio chain for the current file was set up, before any
+// initial seek. Starts collecting decoded audio if the file is eligible.
+void audio_cache_start_capture(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+    struct audio_cache *c = get_cache(mpctx);
+    struct demuxer *demux = mpctx->demuxer;
+    struct ao_chain *ao_c = mpctx->ao_chain;
+
+    TA_FREEP(&c->capture);
+
+    struct stat st;
+    if (!opts->audio_clip_cache || mpctx->playing_cached_audio || !demux ||
+        !ao_c || !ao_c->audio_src || mpctx->num_tracks != 1 ||
+        demux->duration <= 0 || demux->duration > opts->audio_clip_cache ||
+        !stat_file(mpctx->stream_open_filename, &st))
+        return;
+
+    c->capture = talloc_zero(c, struct clip);
+    *c->capture = (struct clip){
+        .path = talloc_strdup(c->capture, mpctx->stream_open_filename),
+        .size = st.st_size,
+        .mtime = st.st_mtime,
+    };
+    c->format = 0;
+    c->duration = 0;
+}
+
+// Called on seeks and audio chain teardown. The capture would not contain the
+// complete file anymore.
+void audio_cache_abort_capture(struct MPContext *mpctx)
+{
+    if (mpctx->audio_cache)
+        TA_FREEP(&mpctx->audio_cache->capture);
+}
+
+static bool append_frame(struct audio_cache *c, struct mp_aframe *frame)
+{
+    int format = mp_aframe_get_format(frame);
+    int packed = af_fmt_from_planar(format);
+    struct mp_chmap chmap;
+    if (!mp_aframe_get_chmap(frame, &chmap))
+        return false;
+
+    if (!c->format) {
+        if (packed != AF_FORMAT_U8 && packed != AF_FORMAT_S16 &&
+            packed != AF_FORMAT_S32 && packed != AF_FORMAT_FLOAT &&
+            packed != AF_FORMAT_DOUBLE)
+            return false;
+        if (!mp_chmap_is_waveext(&chmap))
+            return false;
+        c->format = packed;
+        c->chmap = chmap;
+        c->rate = mp_aframe_get_rate(frame);
+        // Header is written when the capture is finished.
+        c->capture->wav = (bstr){talloc_zero_size(c->capture, WAV_HEADER_SIZE),
+                                 WAV_HEADER_SIZE};
+    }
+
+    if (packed != c->format || !mp_chmap_equals(&chmap, &c->chmap) ||
+        mp_aframe_get_rate(frame) != c->rate)
+        return false;
+
+    int samples = mp_aframe_get_size(frame);
+    int bps = af_fmt_to_bytes(c->format);
+    size_t len = (size_t)samples * bps * chmap.num;
+    bstr *wav = &c->capture->wav;
+    wav->start = talloc_realloc_size(c->capture, wav->start, wav->len + len);
+    uint8_t *dst = wav->start + wav->len;
+    uint8_t **planes = mp_aframe_get_data_ro(frame);
+    if (af_fmt_is_planar(format)) {
+        for (int s = 0; s < samples; s++) {
+            for (int ch = 0; ch < chmap.num; ch++) {
+                memcpy(dst, planes[ch] + s * bps, bps);
+                dst += bps;
+            }
+        }
+    } else {
+        memcpy(dst, planes[0], len);
+    }
+    wav->len += len;
+
+    c->duration += mp_aframe_duration(frame);
+    return true;
+}
+
+// Called with every frame returned by the audio decoder.
+void audio_cache_capture_frame(struct MPContext *mpctx, struct mp_aframe *frame)
+{
+    struct audio_cache *c = mpctx->audio_cache;
+    if (!c || !c->capture)
+        return;
+
+    if (!append_frame(c, frame) ||
+        c->duration > mpctx->opts->audio_clip_cache + 1)
+        TA_FREEP(&c->capture);
+}
+
+static void write_wav_header(struct audio_cache *c)
+{
+    uint8_t *h = c->capture->wav.start;
+    size_t data_len = c->capture->wav.len - WAV_HEADER_SIZE;
+    int bps = af_fmt_to_bytes(c->format);
+    int channels = c->chmap.num;
+    bool is_float = af_fmt_is_float(c->format);
+
+    // Always use WAVE_FORMAT_EXTENSIBLE, so the channel layout is kept.
+    memcpy(h, "RIFF", 4);
+    AV_WL32(h + 4, WAV_HEADER_SIZE - 8 + data_len);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    AV_WL32(h + 16, 40);
+    AV_WL16(h + 20, 0xFFFE);
+    AV_WL16(h + 22, channels);
+    AV_WL32(h + 24, c->rate);
+    AV_WL32(h + 28, c->rate * bps * channels);
+    AV_WL16(h + 32, bps * channels);
+    AV_WL16(h + 34, bps * 8);
+    AV_WL16(h + 36, 22);
+    AV_WL16(h + 38, bps * 8);
+    AV_WL32(h + 40, mp_chmap_to_waveext(&c->chmap));
+    // KSDATAFORMAT_SUBTYPE_PCM/_IEEE_FLOAT
+    static const uint8_t guid[14] = {
+        0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00,
+        0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71,
+    };
+    AV_WL16(h + 44, is_float ? 3 : 1);
+    memcpy(h + 46, guid, sizeof(guid));
+    memcpy(h + 60, "data", 4);
+    AV_WL32(h + 64, data_len);
+}
+
+// Called when the audio decoder reached EOF. If the whole file was captured,
+// add it to the cache.
+void audio_cache_finish_capture(struct MPContext *mpctx)
+{
+    struct audio_cache *c = mpctx->audio_cache;
+    if (!c || !c->capture)
+        return;
+
+    struct clip *clip = c->capture;
+    c->capture = NULL;
+    if (!c->format || clip->wav.len - WAV_HEADER_SIZE > UINT32_MAX - 128) {
+        talloc_free(clip);
+        return;
+    }
+    write_wav_header(c);
+
+    for (int n = 0; n < c->num_clips; n++) {
+        if (strcmp(c->clips[n]->path, clip->path) == 0) {
+            talloc_free(c->clips[n]);
+            MP_TARRAY_REMOVE_AT(c->clips, c->num_clips, n);
+            break;
+        }
+    }
+    MP_TARRAY_INSERT_AT(c, c->clips, c->num_clips, 0, clip);
+    trim_cache(c, mpctx->opts->audio_clip_cache_entries);
+
+    MP_VERBOSE(mpctx, "Added %.1fs of decoded audio to the clip cache.\n",
+               c->duration);
+}
@@ -21,16 +21,19 @@
 #include <errno.h>
 #include <locale.h>
 #include <assert.h>
+#include <math.h>
 
 #include "common/common.h"
 #include "common/global.h"
 #include "common/msg.h"
 #include "common/msg_control.h"
+#include "common/stats.h"
 #include "common/global.h"
 #include "input/input.h"
 #include "input/cmd_list.h"
 #include "misc/ctype.h"
 #include "misc/dispatch.h"
+#include "misc/node.h"
 #include "misc/rendezvous.h"
 #include "options/m_config.h"
 #include "options/m_option.h"
@@ -41,6 +44,11 @@
 #include "osdep/timer.h"
 #include "osdep/io.h"
 #include "stream/stream.h"
+#include "video/img_format.h"
+#include "video/mp_image.h"
+#include "video/mp_image_pool.h"
+#include "video/sws_utils.h"
+#include "video/out/libmpv.h"
 
 #include "command.h"
 #include "core.h"
@@ -62,6 +70,7 @@
 
 struct mp_client_api {
     struct MPContext *mpctx;
+    struct stats_ctx *stats;
 
     pthread_mutex_t lock;
 
@@ -74,6 +83,8 @@ struct mp_client_api {
 
     struct mp_custom_protocol *custom_protocols;
     int num_custom_protocols;
+
+    struct mpv_render_context *render_context;
 };
 
 struct observe_property {
@@ -88,6 +99,9 @@ struct observe_property {
     bool dead;              // property unobserved while retrieving value
     bool new_value_valid, user_value_valid;
     union m_option_value new_value, user_value;
+    int64_t min_interval;   // minimum time between change events (us), or 0
+    int64_t last_event;     // time of the last change event (us)
+    double threshold;       // minimum change of numeric values, or 0
     struct mpv_handle *client;
 };
 
@@ -132,14 +146,17 @@ struct mpv_handle {
     int lowest_changed;     // attempt at making change processing incremental
     int properties_updating;
     uint64_t property_event_masks; // or-ed together event masks of all properties
+    int64_t property_deadline; // next time a rate limited change is due, or 0
 
     bool fuzzy_initialized; // see scripting.c wait_loaded()
     struct mp_log_buffer *messages;
+
+    struct frame_tap *frame_tap; // see mpv_frame_tap_enable(), or NULL
 };
 
 static bool gen_log_message_event(struct mpv_handle *ctx);
 static bool gen_property_change_event(struct mpv_handle *ctx);
-static void notify_property_events(struct mpv_handle *ctx, uint64_t event_mask);
+static bool notify_property_events(struct mpv_handle *ctx, uint64_t event_mask);
 
 void mp_clients_init(struct MPContext *mpctx)
 {
@@ -147,6 +164,8 @@ void mp_clients_init(struct MPContext *mpctx)
     *mpctx->clients = (struct mp_client_api) {
         .mpctx = mpctx,
     };
+    mpctx->clients->stats =
+        stats_ctx_create(mpctx->clients, mpctx->global, "client");
     mpctx->global->client_api = mpctx->clients;
     pthread_mutex_init(&mpctx->clients->lock, NULL);
 }
@@ -289,6 +308,11 @@ struct MPContext *mp_client_api_get_core(struct mp_client_api *api)
     return api->mpctx;
 }
 
+struct mpv_global *mp_client_get_global(struct mpv_handle *ctx)
+{
+    return ctx->mpctx->global;
+}
+
 static void wakeup_client(struct mpv_handle *ctx)
 {
     pthread_mutex_lock(&ctx->wakeup_lock);
@@ -369,7 +393,7 @@ void mpv_detach_destroy(mpv_handle *ctx)
     // causes a crash, block until all asynchronous requests were served.
     mpv_wait_async_requests(ctx);
 
-    osd_set_external(ctx->mpctx->osd, ctx, 0, 0, NULL);
+    osd_clear_external(ctx->mpctx->osd, ctx);
     mp_input_remove_sections_by_owner(ctx->mpctx->input, ctx->name);
 
     struct mp_client_api *clients = ctx->clients;
@@ -572,6 +596,9 @@ static int reserve_reply(struct mpv_handle *ctx)
     return res;
 }
 
+// Called with ctx->lock held. On success, the caller has to wake up the client
+// with wakeup_client(), preferably after releasing ctx->lock. This keeps the
+// wakeup callback and pipe write out of the section that blocks the client.
 static int append_event(struct mpv_handle *ctx, struct mpv_event event, bool copy)
 {
     if (ctx->num_events + ctx->reserved_events >= ctx->max_events)
@@ -580,16 +607,16 @@ static int append_event(struct mpv_handle *ctx, struct mpv_event event, bool cop
         dup_event_data(&event);
     ctx->events[(ctx->first_event + ctx->num_events) % ctx->max_events] = event;
     ctx->num_events++;
-    wakeup_client(ctx);
     return 0;
 }
 
 static int send_event(struct mpv_handle *ctx, struct mpv_event *event, bool copy)
 {
-    pthread_mutex_lock(&ctx->lock);
     uint64_t mask = 1ULL << event->event_id;
+    bool wakeup = false;
+    pthread_mutex_lock(&ctx->lock);
     if (ctx->property_event_masks & mask)
-        notify_property_events(ctx, mask);
+        wakeup = notify_property_events(ctx, mask);
     int r;
     if (!(ctx->event_mask & mask)) {
         r = 0;
@@ -600,9 +627,13 @@ static int send_event(struct mpv_handle *ctx, struct mpv_event *event, bool copy
         if (r < 0) {
             MP_ERR(ctx, "Too many events queued.\n");
             ctx->choked = true;
+        } else {
+            wakeup = true;
         }
     }
     pthread_mutex_unlock(&ctx->lock);
+    if (wakeup)
+        wakeup_client(ctx);
     return r;
 }
 
@@ -618,6 +649,9 @@ static void send_reply(struct mpv_handle *ctx, uint64_t userdata,
     ctx->reserved_events--;
     if (append_event(ctx, *event, false) < 0)
         abort(); // not reached
+    // Must be done with the lock held: once reserved_events is 0, the
+    // client could be destroyed as soon as the lock is released.
+    wakeup_client(ctx);
     pthread_mutex_unlock(&ctx->lock);
 }
 
@@ -781,8 +815,11 @@ mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
         // Pop item from message queue, and return as event.
         if (gen_log_message_event(ctx))
             break;
-        int r = wait_wakeup(ctx, deadline);
-        if (r == ETIMEDOUT)
+        int64_t wait_until = deadline;
+        if (ctx->property_deadline)
+            wait_until = MPMIN(wait_until, ctx->property_deadline);
+        int r = wait_wakeup(ctx, wait_until);
+        if (r == ETIMEDOUT && wait_until == deadline)
             break;
     }
     ctx->queued_wakeup = false;
@@ -976,7 +1013,10 @@ struct cmd_request {
 static void cmd_fn(void *data)
 {
     struct cmd_request *req = data;
+    struct stats_ctx *stats = req->mpctx->clients->stats;
+    stats_time_start(stats, "command");
     int r = run_command(req->mpctx, req->cmd, req->res);
+    stats_time_end(stats, "command");
     req->status = r >= 0 ? 0 : MPV_ERROR_COMMAND;
     talloc_free(req->cmd);
     if (req->reply_ctx) {
@@ -1132,6 +1172,55 @@ int mpv_set_property(mpv_handle *ctx, const char *name, mpv_format format,
     return req.status;
 }
 
+struct setproperty_multi_request {
+    struct MPContext *mpctx;
+    struct mpv_node_list *list;
+    int status;
+};
+
+static void setproperty_multi_fn(void *arg)
+{
+    struct setproperty_multi_request *req = arg;
+
+    req->status = 0;
+    for (int n = 0; n < req->list->num; n++) {
+        struct setproperty_request preq = {
+            .mpctx = req->mpctx,
+            .name = req->list->keys[n],
+            .format = MPV_FORMAT_NODE,
+            .data = &req->list->values[n],
+        };
+        setproperty_fn(&preq);
+        if (preq.status < 0 && req->status >= 0)
+            req->status = preq.status;
+    }
+}
+
+int mpv_set_property_multi(mpv_handle *ctx, mpv_node *properties)
+{
+    if (!properties || properties->format != MPV_FORMAT_NODE_MAP)
+        return MPV_ERROR_INVALID_PARAMETER;
+    struct mpv_node_list *list = properties->u.list;
+
+    if (!ctx->mpctx->initialized) {
+        int r = 0;
+        for (int n = 0; n < list->num; n++) {
+            int err = mpv_set_property(ctx, list->keys[n], MPV_FORMAT_NODE,
+                                       &list->values[n]);
+            if (err < 0 && r >= 0)
+                r = err;
+        }
+        return r;
+    }
+
+    struct setproperty_multi_request req = {
+        .mpctx = ctx->mpctx,
+        .list = list,
+    };
+    run_locked(ctx, setproperty_multi_fn, &req);
+    return req.status;
+}
+
 int mpv_set_property_string(mpv_handle *ctx, const char *name, const char *data)
 {
     return mpv_set_property(ctx, name, MPV_FORMAT_STRING, &data);
@@ -1293,6 +1382,95 @@ char *mpv_get_property_osd_string(mpv_handle *ctx, const char *name)
     return str;
 }
 
+struct getproperty_multi_request {
+    struct MPContext *mpctx;
+    const char **names;
+    const mpv_format *formats;
+    int num;
+    struct mpv_node *result;
+};
+
+static void getproperty_multi_fn(void *arg)
+{
+    struct getproperty_multi_request *req = arg;
+
+    node_init(req->result, MPV_FORMAT_NODE_MAP, NULL);
+    for (int n = 0; n < req->num; n++) {
+        mpv_format format = req->formats ? req->formats[n] : MPV_FORMAT_NODE;
+        union m_option_value val = {0};
+        struct getproperty_request preq = {
+            .mpctx = req->mpctx,
+            .name = req->names[n],
+            .format = format,
+            .data = &val,
+        };
+        getproperty_fn(&preq);
+
+        struct mpv_node *entry =
+            node_map_add(req->result, req->names[n], MPV_FORMAT_NONE);
+        if (preq.status < 0)
+            continue;
+        switch (format) {
+        case MPV_FORMAT_OSD_STRING:
+        case MPV_FORMAT_STRING:
+            entry->format = MPV_FORMAT_STRING;
+            entry->u.string = talloc_steal(req->result->u.list, val.string);
+            break;
+        case MPV_FORMAT_FLAG:
+            entry->format = MPV_FORMAT_FLAG;
+            entry->u.flag = val.flag;
+            break;
+        case MPV_FORMAT_INT64:
+            entry->format = MPV_FORMAT_INT64;
+            entry->u.int64 = val.int64;
+            break;
+        case MPV_FORMAT_DOUBLE:
+            entry->format = MPV_FORMAT_DOUBLE;
+            entry->u.double_ = val.double_;
+            break;
+        case MPV_FORMAT_NODE:
+            *entry = *(struct mpv_node *)&val;
+            if (entry->format == MPV_FORMAT_STRING) {
+                talloc_steal(req->result->u.list, entry->u.string);
+            } else if (entry->format == MPV_FORMAT_NODE_ARRAY ||
+                       entry->format == MPV_FORMAT_NODE_MAP)
+            {
+                talloc_steal(req->result->u.list, entry->u.list);
+            }
+            break;
+        default:
+            abort();
+        }
+    }
+}
+
+int mpv_get_property_multi(mpv_handle *ctx, const char **names,
+                           const mpv_format *formats, int num_names,
+                           mpv_node *result)
+{
+    if (!ctx->mpctx->initialized)
+        return MPV_ERROR_UNINITIALIZED;
+    if (!result || num_names < 0 || (num_names && !names))
+        return MPV_ERROR_INVALID_PARAMETER;
+    for (int n = 0; n < num_names; n++) {
+        if (!names[n])
+            return MPV_ERROR_INVALID_PARAMETER;
+        if (formats && (formats[n] == MPV_FORMAT_NONE ||
+                        !get_mp_type_get(formats[n])))
+            return MPV_ERROR_PROPERTY_FORMAT;
+    }
+
+    struct getproperty_multi_request req = {
+        .mpctx = ctx->mpctx,
+        .names = names,
+        .formats = formats,
+        .num = num_names,
+        .result = result,
+    };
+    run_locked(ctx, getproperty_multi_fn, &req);
+    return 0;
+}
+
 int mpv_get_property_async(mpv_handle *ctx, uint64_t ud, const char *name,
                            mpv_format format)
 {
@@ -1381,6 +1559,68 @@ int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
     return count;
 }
 
+int mpv_set_observe_property_rate(mpv_handle *ctx, uint64_t userdata,
+                                  double max_rate)
+{
+    if (!(max_rate >= 0))
+        return MPV_ERROR_INVALID_PARAMETER;
+    pthread_mutex_lock(&ctx->lock);
+    int count = 0;
+    for (int n = 0; n < ctx->num_properties; n++) {
+        struct observe_property *prop = ctx->properties[n];
+        if (prop->reply_id == userdata) {
+            prop->min_interval = max_rate > 0 ? MPMAX(1e6 / max_rate, 1) : 0;
+            count++;
+        }
+    }
+    ctx->lowest_changed = 0;
+    wakeup_client(ctx);
+    pthread_mutex_unlock(&ctx->lock);
+    return count;
+}
+
+int mpv_set_observe_property_threshold(mpv_handle *ctx, uint64_t userdata,
+                                       double threshold)
+{
+    if (!(threshold >= 0))
+        return MPV_ERROR_INVALID_PARAMETER;
+    pthread_mutex_lock(&ctx->lock);
+    int count = 0;
+    for (int n = 0; n < ctx->num_properties; n++) {
+        struct observe_property *prop = ctx->properties[n];
+        if (prop->reply_id == userdata) {
+            prop->threshold = threshold;
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return count;
+}
+
+// Wake up clients which have rate limited property changes that are due.
+// Called by the playloop.
+void mp_client_update_property_timers(struct MPContext *mpctx)
+{
+    struct mp_client_api *clients = mpctx->clients;
+    int64_t now = mp_time_us();
+
+    pthread_mutex_lock(&clients->lock);
+    for (int n = 0; n < clients->num_clients; n++) {
+        struct mpv_handle *client = clients->clients[n];
+        pthread_mutex_lock(&client->lock);
+        if (client->property_deadline) {
+            if (client->property_deadline <= now) {
+                client->property_deadline = 0;
+                wakeup_client(client);
+            } else {
+                mp_set_timeout(mpctx, (client->property_deadline - now) / 1e6);
+            }
+        }
+        pthread_mutex_unlock(&client->lock);
+    }
+    pthread_mutex_unlock(&clients->lock);
+}
+
 static void mark_property_changed(struct mpv_handle *client, int index)
 {
     struct observe_property *prop = client->properties[index];
@@ -1404,24 +1644,61 @@ void mp_client_property_change(struct MPContext *mpctx, const char *name)
             if (client->properties[i]->id == id)
                 mark_property_changed(client, i);
         }
-        if (client->lowest_changed < client->num_properties)
-            wakeup_client(client);
+        bool wakeup = client->lowest_changed < client->num_properties;
         pthread_mutex_unlock(&client->lock);
+        if (wakeup)
+            wakeup_client(client);
     }
 
     pthread_mutex_unlock(&clients->lock);
 }
 
 // Mark properties as changed in reaction to specific events.
-// Called with ctx->lock held.
-static void notify_property_events(struct mpv_handle *ctx, uint64_t event_mask)
+// Called with ctx->lock held. Returns whether the client needs a wakeup.
+static bool notify_property_events(struct mpv_handle *ctx, uint64_t event_mask)
 {
     for (int i = 0; i < ctx->num_properties; i++) {
         if (ctx->properties[i]->event_mask & event_mask)
             mark_property_changed(ctx, i);
     }
-    if (ctx->lowest_changed < ctx->num_properties)
-        wakeup_client(ctx);
+    return ctx->lowest_changed < ctx->num_properties;
+}
+
+// Get the value as number, if the property format is numeric.
+static bool get_numeric_value(union m_option_value *v, mpv_format format,
+                              double *out)
+{
+    switch (format) {
+    case MPV_FORMAT_INT64:
+        *out = v->int64;
+        return true;
+    case MPV_FORMAT_DOUBLE:
+        *out = v->double_;
+        return true;
+    case MPV_FORMAT_NODE: {
+        struct mpv_node *node = (struct mpv_node *)v;
+        if (node->format == MPV_FORMAT_INT64) {
+            *out = node->u.int64;
+            return true;
+        } else if (node->format == MPV_FORMAT_DOUBLE) {
+            *out = node->u.double_;
+            return true;
+        }
+        return false;
+    }
+    }
+    return false;
+}
+
+// Whether the difference between the last returned value and the new value is
+// below the property's threshold, i.e. the change should not be reported.
+static bool below_threshold(struct observe_property *prop)
+{
+    double a, b;
+    return prop->threshold > 0 &&
+           get_numeric_value(&prop->user_value, prop->format, &a) &&
+           get_numeric_value(&prop->new_value, prop->format, &b) &&
+           fabs(a - b) < prop->threshold;
 }
 
 static void update_prop(void *p)
@@ -1451,7 +1728,8 @@ static void update_prop(void *p)
     if (prop->user_value_valid != prop->new_value_valid) {
         prop->changed = true;
     } else if (prop->user_value_valid && prop->new_value_valid) {
-        if (!compare_value(&prop->user_value, &prop->new_value, prop->format))
+        if (!compare_value(&prop->user_value, &prop->new_value, prop->format) &&
+            !below_threshold(prop))
             prop->changed = true;
     }
     if (prop->dead)
@@ -1466,12 +1744,25 @@ static bool gen_property_change_event(struct mpv_handle *ctx)
 {
     if (!ctx->mpctx->initialized)
         return false;
+    int64_t now = mp_time_us();
+    int64_t old_deadline = ctx->property_deadline;
+    ctx->property_deadline = 0;
     int start = ctx->lowest_changed;
     ctx->lowest_changed = ctx->num_properties;
     for (int n = start; n < ctx->num_properties; n++) {
         struct observe_property *prop = ctx->properties[n];
         if ((prop->changed || prop->updating) && n < ctx->lowest_changed)
             ctx->lowest_changed = n;
+        if (prop->changed && prop->min_interval) {
+            // Rate limited: leave it marked, and don't even read the new
+            // value until the interval has passed.
+            int64_t next = prop->last_event + prop->min_interval;
+            if (now < next) {
+                if (!ctx->property_deadline || next < ctx->property_deadline)
+                    ctx->property_deadline = next;
+                continue;
+            }
+        }
         if (prop->changed) {
             bool get_value = prop->need_new_value;
             prop->need_new_value = false;
@@ -1479,12 +1770,14 @@ static bool gen_property_change_event(struct mpv_handle *ctx)
             if (prop->format && get_value) {
                 ctx->properties_updating++;
                 prop->updating = true;
-                mp_dispatch_enqueue(ctx->mpctx->dispatch, update_prop, prop);
+                mp_dispatch_enqueue_background(ctx->mpctx->dispatch,
+                                               update_prop, prop);
             } else {
                 const struct m_option *type = get_mp_type_get(prop->format);
                 prop->user_value_valid = prop->new_value_valid;
                 if (prop->new_value_valid)
                     m_option_copy(type, &prop->user_value, &prop->new_value);
+                prop->last_event = now;
                 ctx->cur_property_event = (struct mpv_event_property){
                     .name = prop->name,
                     .format = prop->user_value_valid ? prop->format : 0,
@@ -1500,6 +1793,10 @@ static bool gen_property_change_event(struct mpv_handle *ctx)
             }
         }
     }
+    // Make sure the playloop wakes us up when a deferred change is due, even
+    // if the client only waits on the wakeup callback.
+    if (ctx->property_deadline && !old_deadline)
+        mp_wakeup_core(ctx->mpctx);
     return false;
 }
 
@@ -1672,7 +1969,7 @@ int64_t mpv_get_time_us(mpv_handle *ctx)
     return mp_time_us();
 }
 
-// Used by vo_opengl_cb to synchronously uninitialize video.
+// Used by vo_libmpv to synchronously uninitialize video.
 void kill_video(struct mp_client_api *client_api)
 {
     struct MPContext *mpctx = client_api->mpctx;
@@ -1686,47 +1983,130 @@ void kill_video(struct mp_client_api *client_api)
     mp_dispatch_unlock(mpctx->dispatch);
 }
 
+// Used by vo_libmpv to set the current render context.
+bool mp_set_main_render_context(struct mp_client_api *client_api,
+                                struct mpv_render_context *ctx, bool active)
+{
+    assert(ctx);
+
+    pthread_mutex_lock(&client_api->lock);
+    bool is_set = !!client_api->render_context;
+    bool is_same = client_api->render_context == ctx;
+    // Can set if it doesn't remove another existing ctx.
+    bool res = is_same || !is_set;
+    if (res)
+        client_api->render_context = active ? ctx : NULL;
+    pthread_mutex_unlock(&client_api->lock);
+    return res;
+}
+
+// Used by vo_libmpv. Relies on guarantees by mp_render_context_acquire().
+struct mpv_render_context *
+mp_client_api_acquire_render_context(struct mp_client_api *ca)
+{
+    struct mpv_render_context *res = NULL;
+    pthread_mutex_lock(&ca->lock);
+    if (ca->render_context && mp_render_context_acquire(ca->render_context))
+        res = ca->render_context;
+    pthread_mutex_unlock(&ca->lock);
+    return res;
+}
+
+// Emulation of the old opengl_cb API on top of the render API.
+
 #include "libmpv/opengl_cb.h"
+#include "libmpv/render_gl.h"
+
+struct mpv_opengl_cb_context {
+    struct mpv_global *global;
+    mpv_opengl_cb_update_fn callback;
+    void *callback_ctx;
+    struct mpv_render_context *render;
+};
 
-#if HAVE_GL
 static mpv_opengl_cb_context *opengl_cb_get_context(mpv_handle *ctx)
 {
     mpv_opengl_cb_context *cb = ctx->mpctx->gl_cb_ctx;
     if (!cb) {
-        cb = mp_opengl_create(ctx->mpctx->global, ctx->clients);
+        cb = talloc_zero(NULL, struct mpv_opengl_cb_context);
+        cb->global = ctx->mpctx->global;
         ctx->mpctx->gl_cb_ctx = cb;
     }
     return cb;
 }
-#else
-static mpv_opengl_cb_context *opengl_cb_get_context(mpv_handle *ctx)
-{
-    return NULL;
-}
+
 void mpv_opengl_cb_set_update_callback(mpv_opengl_cb_context *ctx,
                                        mpv_opengl_cb_update_fn callback,
                                        void *callback_ctx)
 {
+    // This was a layering violation anyway.
+    ctx->callback = callback;
+    ctx->callback_ctx = callback_ctx;
+    if (ctx->render)
+        mpv_render_context_set_update_callback(ctx->render, callback, callback_ctx);
 }
+
 int mpv_opengl_cb_init_gl(mpv_opengl_cb_context *ctx, const char *exts,
                           mpv_opengl_cb_get_proc_address_fn get_proc_address,
                           void *get_proc_address_ctx)
 {
-    return MPV_ERROR_NOT_IMPLEMENTED;
+    if (ctx->render)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    mpv_opengl_init_params gl_params = {
+        .get_proc_address = get_proc_address,
+        .get_proc_address_ctx = get_proc_address_ctx,
+        .extra_exts = exts,
+    };
+    int adv = 1;
+    mpv_render_param params[] = {
+        {MPV_RENDER_PARAM_API_TYPE, MPV_RENDER_API_TYPE_OPENGL},
+        {MPV_RENDER_PARAM_OPENGL_INIT_PARAMS, &gl_params},
+        {MPV_RENDER_PARAM_ADVANCED_CONTROL, &adv},
+        {0}
+    };
+    int err = mp_render_context_create(&ctx->render, ctx->global, params);
+    if (err >= 0) {
+        mpv_render_context_set_update_callback(ctx->render, ctx->callback,
+                                               ctx->callback_ctx);
+    }
+    return err;
 }
+
 int mpv_opengl_cb_draw(mpv_opengl_cb_context *ctx, int fbo, int w, int h)
 {
-    return MPV_ERROR_NOT_IMPLEMENTED;
+    if (!ctx->render)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    mpv_opengl_fbo target = {
+        .fbo = fbo,
+        .w = w,
+        .h = abs(h),
+    };
+    int flip = h < 0;
+    mpv_render_param params[] = {
+        {MPV_RENDER_PARAM_OPENGL_FBO, &target},
+        {MPV_RENDER_PARAM_FLIP_Y, &flip},
+        {0}
+    };
+    return mpv_render_context_render(ctx->render, params);
 }
+
 int mpv_opengl_cb_report_flip(mpv_opengl_cb_context *ctx, int64_t time)
 {
-    return MPV_ERROR_NOT_IMPLEMENTED;
+    if (!ctx->render)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    mpv_render_context_report_swap(ctx->render);
+    return 0;
 }
+
 int mpv_opengl_cb_uninit_gl(mpv_opengl_cb_context *ctx)
 {
-    return MPV_ERROR_NOT_IMPLEMENTED;
+    mpv_render_context_free(ctx->render);
+    ctx->render = NULL;
+    return 0;
 }
-#endif
 
 int mpv_opengl_cb_render(mpv_opengl_cb_context *ctx, int fbo, int vp[4])
 {
@@ -1804,3 +2184,182 @@ bool mp_streamcb_lookup(struct mpv_global *g, const char *protocol,
     pthread_mutex_unlock(&clients->lock);
     return found;
 }
+
+// Queued frames and conversion parameters for the frame tap API.
+struct frame_tap {
+    int queue_size;
+    int imgfmt;             // 0 if frames are not converted
+    int max_w, max_h;       // 0 if unlimited
+    struct mp_image **queue; // oldest frame first
+    int num_queue;
+    int64_t dropped;        // since the last frame returned to the client
+};
+
+int mpv_frame_tap_enable(mpv_handle *ctx, int queue_size, const char *format,
+                         int max_w, int max_h)
+{
+    int imgfmt = format ? mp_imgfmt_from_name(bstr0(format)) : 0;
+    if (queue_size < 0 || queue_size > 64 || (format && !imgfmt) ||
+        (imgfmt && IMGFMT_IS_HWACCEL(imgfmt)) || max_w < 0 || max_h < 0)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    pthread_mutex_lock(&ctx->lock);
+    struct frame_tap *tap = ctx->frame_tap;
+    if (!queue_size) {
+        talloc_free(tap);
+        ctx->frame_tap = NULL;
+    } else {
+        if (!tap)
+            tap = ctx->frame_tap = talloc_zero(ctx, struct frame_tap);
+        tap->queue_size = queue_size;
+        tap->imgfmt = imgfmt;
+        tap->max_w = max_w;
+        tap->max_h = max_h;
+        while (tap->num_queue > queue_size) {
+            talloc_free(tap->queue[0]);
+            MP_TARRAY_REMOVE_AT(tap->queue, tap->num_queue, 0);
+            tap->dropped++;
+        }
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return 0;
+}
+
+// Called by the player for each frame queued for display. Adds a reference
+// to img to the queue of every client with an enabled frame tap.
+void mp_client_tap_frame(struct MPContext *mpctx, struct mp_image *img)
+{
+    struct mp_client_api *clients = mpctx->clients;
+
+    pthread_mutex_lock(&clients->lock);
+    for (int n = 0; n < clients->num_clients; n++) {
+        struct mpv_handle *ctx = clients->clients[n];
+        pthread_mutex_lock(&ctx->lock);
+        struct frame_tap *tap = ctx->frame_tap;
+        if (tap) {
+            if (tap->num_queue >= tap->queue_size) {
+                talloc_free(tap->queue[0]);
+                MP_TARRAY_REMOVE_AT(tap->queue, tap->num_queue, 0);
+                tap->dropped++;
+            }
+            struct mp_image *ref = mp_image_new_ref(img);
+            if (ref) {
+                talloc_steal(tap, ref);
+                MP_TARRAY_APPEND(tap, tap->queue, tap->num_queue, ref);
+            } else {
+                tap->dropped++;
+            }
+        }
+        pthread_mutex_unlock(&ctx->lock);
+        if (tap)
+            wakeup_client(ctx);
+    }
+    pthread_mutex_unlock(&clients->lock);
+}
+
+// Drop all queued frames. The queued references can point to buffers owned
+// by the decoder or the VO (direct rendering), so they must not outlive the
+// video chain.
+void mp_client_flush_frame_taps(struct MPContext *mpctx)
+{
+    struct mp_client_api *clients = mpctx->clients;
+
+    pthread_mutex_lock(&clients->lock);
+    for (int n = 0; n < clients->num_clients; n++) {
+        struct mpv_handle *ctx = clients->clients[n];
+        pthread_mutex_lock(&ctx->lock);
+        struct frame_tap *tap = ctx->frame_tap;
+        for (int i = 0; tap && i < tap->num_queue; i++)
+            talloc_free(tap->queue[i]);
+        if (tap)
+            tap->num_queue = 0;
+        pthread_mutex_unlock(&ctx->lock);
+    }
+    pthread_mutex_unlock(&clients->lock);
+}
+
+// Return a new image with the contents of img, converted to imgfmt (if not 0)
+// and scaled down to fit max_w/max_h (if not 0). The result never shares
+// buffers with img.
+static struct mp_image *convert_tap_frame(struct mp_image *img, int imgfmt,
+                                          int max_w, int max_h)
+{
+    struct mp_image *sw = NULL;
+    if (img->fmt.flags & MP_IMGFLAG_HWACCEL) {
+        sw = mp_image_hw_download(img, NULL);
+        if (!sw)
+            return NULL;
+        img = sw;
+    }
+
+    int w = img->w, h = img->h;
+    if (max_w && w > max_w) {
+        h = MPMAX((int64_t)h * max_w / w, 1);
+        w = max_w;
+    }
+    if (max_h && h > max_h) {
+        w = MPMAX((int64_t)w * max_h / h, 1);
+        h = max_h;
+    }
+    int fmt = imgfmt ? imgfmt : img->imgfmt;
+
+    struct mp_image *res = NULL;
+    if (w == img->w && h == img->h && fmt == img->imgfmt) {
+        res = sw ? sw : mp_image_new_copy(img);
+        sw = NULL;
+    } else {
+        res = mp_image_alloc(fmt, w, h);
+        if (res && mp_image_swscale(res, img, mp_sws_fast_flags) < 0)
+            TA_FREEP(&res);
+        if (res)
+            res->pts = img->pts;
+    }
+    talloc_free(sw);
+    return res;
+}
+
+mpv_frame *mpv_frame_tap_get(mpv_handle *ctx)
+{
+    pthread_mutex_lock(&ctx->lock);
+    struct frame_tap *tap = ctx->frame_tap;
+    if (!tap || !tap->num_queue) {
+        pthread_mutex_unlock(&ctx->lock);
+        return NULL;
+    }
+    struct mp_image *img = tap->queue[0];
+    MP_TARRAY_REMOVE_AT(tap->queue, tap->num_queue, 0);
+    talloc_steal(NULL, img);
+    int imgfmt = tap->imgfmt, max_w = tap->max_w, max_h = tap->max_h;
+    int64_t dropped = tap->dropped;
+    tap->dropped = 0;
+    pthread_mutex_unlock(&ctx->lock);
+
+    // Potentially expensive, so do it outside of the lock.
+    struct mp_image *res = convert_tap_frame(img, imgfmt, max_w, max_h);
+    talloc_free(img);
+    if (!res) {
+        MP_ERR(ctx, "Could not convert tapped frame.\n");
+        return NULL;
+    }
+
+    mpv_frame *frame = talloc_zero(NULL, mpv_frame);
+    *frame = (mpv_frame){
+        .format = talloc_strdup(frame, mp_imgfmt_to_name(res->imgfmt)),
+        .w = res->w,
+        .h = res->h,
+        .num_planes = res->num_planes,
+        .pts = res->pts,
+        .dropped = dropped,
+        .priv = talloc_steal(frame, res),
+    };
+    for (int n = 0; n < res->num_planes; n++) {
+        frame->planes[n] = res->planes[n];
+        frame->stride[n] = res->stride[n];
+    }
+    return frame;
+}
+
+void mpv_frame_free(mpv_frame *frame)
+{
+    talloc_free(frame);
+}
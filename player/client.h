@@ -5,6 +5,7 @@
 #include <stdbool.h>
 
 #include "libmpv/client.h"
+#include "libmpv/frame_tap.h"
 #include "libmpv/stream_cb.h"
 
 struct MPContext;
@@ -29,6 +30,7 @@ int mp_client_send_event_dup(struct MPContext *mpctx, const char *client_name,
                              int event, void *data);
 bool mp_client_event_is_registered(struct MPContext *mpctx, int event);
 void mp_client_property_change(struct MPContext *mpctx, const char *name);
+void mp_client_update_property_timers(struct MPContext *mpctx);
 
 struct mpv_handle *mp_new_client(struct mp_client_api *clients, const char *name);
 struct mp_log *mp_client_get_log(struct mpv_handle *ctx);
@@ -38,15 +40,25 @@ struct MPContext *mp_client_api_get_core(struct mp_client_api *api);
 // m_option.c
 void *node_get_alloc(struct mpv_node *node);
 
-// vo_opengl_cb.c
-struct mpv_opengl_cb_context;
+// vo_libmpv.c
 struct mpv_global;
-struct osd_state;
-struct mpv_opengl_cb_context *mp_opengl_create(struct mpv_global *g,
-                                               struct mp_client_api *client_api);
+struct mpv_render_context;
+struct mpv_render_param;
+struct mpv_global *mp_client_get_global(struct mpv_handle *ctx);
+int mp_render_context_create(struct mpv_render_context **res,
+                             struct mpv_global *g,
+                             struct mpv_render_param *params);
+bool mp_set_main_render_context(struct mp_client_api *client_api,
+                                struct mpv_render_context *ctx, bool active);
+struct mpv_render_context *
+mp_client_api_acquire_render_context(struct mp_client_api *ca);
 void kill_video(struct mp_client_api *client_api);
 
 bool mp_streamcb_lookup(struct mpv_global *g, const char *protocol,
                         void **out_user_data, mpv_stream_cb_open_ro_fn *out_fn);
 
+struct mp_image;
+void mp_client_tap_frame(struct MPContext *mpctx, struct mp_image *img);
+void mp_client_flush_frame_taps(struct MPContext *mpctx);
+
 #endif
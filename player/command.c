@@ -45,6 +45,7 @@
 #include "demux/demux.h"
 #include "demux/stheader.h"
 #include "common/playlist.h"
+#include "common/stats.h"
 #include "sub/osd.h"
 #include "sub/dec_sub.h"
 #include "options/m_option.h"
@@ -78,8 +79,14 @@
 #endif
 
 struct command_ctx {
-    // All properties, terminated with a {0} item.
-    struct m_property *properties;
+    // All properties, sorted by name.
+    struct m_property_list properties;
+
+    // For mp_property_expand_cached(): the serial number of the most recent
+    // change notification, per event and per property ID.
+    uint64_t change_serial;
+    uint64_t event_serial[64];
+    uint64_t *prop_serial;      // properties.num_props items
 
     bool is_idle;
 
@@ -111,6 +118,17 @@ struct command_ctx {
     char *cur_ipc_input;
 
     int silence_option_deprecations;
+
+    // Last reader state passed to mp_update_cache_state() (NULL if none), and
+    // the demuxer-cache-state value built from it (MPV_FORMAT_NONE if it
+    // wasn't read since the last change).
+    struct demux_ctrl_reader_state *cache_state;
+    struct mpv_node cache_state_node;
+    bool cache_state_changed;   // observers not notified of the change yet
+
+    // Cached value of the track-list property (MPV_FORMAT_NONE if it wasn't
+    // read since the tracks last changed).
+    struct mpv_node track_list_node;
 };
 
 struct overlay {
@@ -360,7 +378,7 @@ int mp_on_set_option(void *ctx, struct m_config_option *co, void *data, int flag
     // property implementation is trivial, and can break some obscure features
     // like --profile and --include if non-trivial flags are involved (which
     // the bridge would drop).
-    struct m_property *prop = m_property_list_find(cmd->properties, name);
+    struct m_property *prop = m_property_list_find(&cmd->properties, name);
     if (prop && prop->is_option)
         goto direct_option;
 
@@ -1654,6 +1672,40 @@ static int mp_property_cache_speed(void *ctx, struct m_property *prop,
     return m_property_int64_ro(action, arg, info.speed);
 }
 
+static int mp_property_cache_read_size(void *ctx, struct m_property *prop,
+                                       int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (!mpctx->demuxer)
+        return M_PROPERTY_UNAVAILABLE;
+
+    struct stream_cache_info info = {0};
+    demux_stream_control(mpctx->demuxer, STREAM_CTRL_GET_CACHE_INFO, &info);
+    if (info.size <= 0)
+        return M_PROPERTY_UNAVAILABLE;
+
+    if (action == M_PROPERTY_PRINT) {
+        *(char **)arg = format_file_size(info.read_size);
+        return M_PROPERTY_OK;
+    }
+    return m_property_int64_ro(action, arg, info.read_size);
+}
+
+static int mp_property_cache_latency(void *ctx, struct m_property *prop,
+                                     int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (!mpctx->demuxer)
+        return M_PROPERTY_UNAVAILABLE;
+
+    struct stream_cache_info info = {0};
+    demux_stream_control(mpctx->demuxer, STREAM_CTRL_GET_CACHE_INFO, &info);
+    if (info.size <= 0)
+        return M_PROPERTY_UNAVAILABLE;
+
+    return m_property_double_ro(action, arg, info.latency);
+}
+
 static int mp_property_cache_idle(void *ctx, struct m_property *prop,
                                   int action, void *arg)
 {
@@ -1714,11 +1766,12 @@ static int mp_property_demuxer_cache_idle(void *ctx, struct m_property *prop,
     return m_property_flag_ro(action, arg, s.idle);
 }
 
-static int mp_property_demuxer_cache_state(void *ctx, struct m_property *prop,
-                                           int action, void *arg)
+static int mp_property_thumbnails(void *ctx, struct m_property *prop,
+                                  int action, void *arg)
 {
     MPContext *mpctx = ctx;
-    if (!mpctx->demuxer)
+    struct thumbnails_info info;
+    if (!thumbnails_get_info(mpctx, &info))
         return M_PROPERTY_UNAVAILABLE;
 
     if (action == M_PROPERTY_GET_TYPE) {
@@ -1728,42 +1781,156 @@ static int mp_property_demuxer_cache_state(void *ctx, struct m_property *prop,
     if (action != M_PROPERTY_GET)
         return M_PROPERTY_NOT_IMPLEMENTED;
 
-    struct demux_ctrl_reader_state s;
-    if (demux_control(mpctx->demuxer, DEMUXER_CTRL_GET_READER_STATE, &s) < 1)
-        return M_PROPERTY_UNAVAILABLE;
-
     struct mpv_node *r = (struct mpv_node *)arg;
     node_init(r, MPV_FORMAT_NODE_MAP, NULL);
+    node_map_add_int64(r, "count", info.count);
+    node_map_add_int64(r, "ready", info.ready);
+    node_map_add_int64(r, "width", info.width);
+    node_map_add_int64(r, "height", info.height);
+    node_map_add_double(r, "duration", info.duration);
+    node_map_add_flag(r, "done", info.done);
+    return M_PROPERTY_OK;
+}
+
+static void build_cache_state_node(struct mpv_node *r,
+                                   struct demux_ctrl_reader_state *s)
+{
+    node_init(r, MPV_FORMAT_NODE_MAP, NULL);
 
     struct mpv_node *ranges =
         node_map_add(r, "seekable-ranges", MPV_FORMAT_NODE_ARRAY);
-    for (int n = 0; n < s.num_seek_ranges; n++) {
-        struct demux_seek_range *range = &s.seek_ranges[n];
+    for (int n = 0; n < s->num_seek_ranges; n++) {
+        struct demux_seek_range *range = &s->seek_ranges[n];
         struct mpv_node *sub = node_array_add(ranges, MPV_FORMAT_NODE_MAP);
         node_map_add_double(sub, "start", range->start);
         node_map_add_double(sub, "end", range->end);
     }
 
-    if (s.ts_end != MP_NOPTS_VALUE)
-        node_map_add_double(r, "cache-end", s.ts_end);
+    if (s->ts_end != MP_NOPTS_VALUE)
+        node_map_add_double(r, "cache-end", s->ts_end);
+
+    if (s->ts_reader != MP_NOPTS_VALUE)
+        node_map_add_double(r, "reader-pts", s->ts_reader);
+
+    node_map_add_flag(r, "eof", s->eof);
+    node_map_add_flag(r, "underrun", s->underrun);
+    node_map_add_flag(r, "idle", s->idle);
+    node_map_add_int64(r, "total-bytes", s->total_bytes);
+    node_map_add_int64(r, "fw-bytes", s->fw_bytes);
+    if (s->file_cache_bytes >= 0)
+        node_map_add_int64(r, "file-cache-bytes", s->file_cache_bytes);
+    if (s->seeking != MP_NOPTS_VALUE)
+        node_map_add_double(r, "debug-seeking", s->seeking);
+    node_map_add_int64(r, "debug-low-level-seeks", s->low_level_seeks);
+    node_map_add_int64(r, "debug-packet-pool-allocs", s->packet_pool.allocs);
+    node_map_add_int64(r, "debug-packet-pool-reuses", s->packet_pool.reuses);
+    node_map_add_int64(r, "debug-packet-pool-bytes", s->packet_pool.bytes);
+    if (s->ts_last != MP_NOPTS_VALUE)
+        node_map_add_double(r, "debug-ts-last", s->ts_last);
+}
+
+static int mp_property_demuxer_cache_state(void *ctx, struct m_property *prop,
+                                           int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    struct command_ctx *cmd = mpctx->command_ctx;
+    if (!mpctx->demuxer)
+        return M_PROPERTY_UNAVAILABLE;
+
+    if (action == M_PROPERTY_GET_TYPE) {
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    }
+    if (action != M_PROPERTY_GET)
+        return M_PROPERTY_NOT_IMPLEMENTED;
 
-    if (s.ts_reader != MP_NOPTS_VALUE)
-        node_map_add_double(r, "reader-pts", s.ts_reader);
+    // Normally, the playloop keeps the snapshot up to date.
+    if (cmd->cache_state) {
+        struct mpv_node *node = &cmd->cache_state_node;
+        if (node->format == MPV_FORMAT_NONE)
+            build_cache_state_node(node, cmd->cache_state);
+        m_option_copy(&(struct m_option){.type = CONF_TYPE_NODE}, arg, node);
+        return M_PROPERTY_OK;
+    }
 
-    node_map_add_flag(r, "eof", s.eof);
-    node_map_add_flag(r, "underrun", s.underrun);
-    node_map_add_flag(r, "idle", s.idle);
-    node_map_add_int64(r, "total-bytes", s.total_bytes);
-    node_map_add_int64(r, "fw-bytes", s.fw_bytes);
-    if (s.seeking != MP_NOPTS_VALUE)
-        node_map_add_double(r, "debug-seeking", s.seeking);
-    node_map_add_int64(r, "debug-low-level-seeks", s.low_level_seeks);
-    if (s.ts_last != MP_NOPTS_VALUE)
-        node_map_add_double(r, "debug-ts-last", s.ts_last);
+    struct demux_ctrl_reader_state s;
+    if (demux_control(mpctx->demuxer, DEMUXER_CTRL_GET_READER_STATE, &s) < 1)
+        return M_PROPERTY_UNAVAILABLE;
 
+    build_cache_state_node(arg, &s);
     return M_PROPERTY_OK;
 }
 
+// Changes which are reported to demuxer-cache-state observers immediately.
+static bool cache_state_major_change(struct demux_ctrl_reader_state *a,
+                                     struct demux_ctrl_reader_state *b)
+{
+    if (a->eof != b->eof || a->underrun != b->underrun || a->idle != b->idle ||
+        a->seeking != b->seeking || a->num_seek_ranges != b->num_seek_ranges)
+        return true;
+    for (int n = 0; n < a->num_seek_ranges; n++) {
+        if (a->seek_ranges[n].start != b->seek_ranges[n].start ||
+            a->seek_ranges[n].end != b->seek_ranges[n].end)
+            return true;
+    }
+    return false;
+}
+
+static bool cache_state_equal(struct demux_ctrl_reader_state *a,
+                              struct demux_ctrl_reader_state *b)
+{
+    return !cache_state_major_change(a, b) &&
+           a->ts_duration == b->ts_duration &&
+           a->ts_reader == b->ts_reader &&
+           a->ts_end == b->ts_end &&
+           a->total_bytes == b->total_bytes &&
+           a->fw_bytes == b->fw_bytes &&
+           a->file_cache_bytes == b->file_cache_bytes &&
+           a->packet_pool.allocs == b->packet_pool.allocs &&
+           a->packet_pool.reuses == b->packet_pool.reuses &&
+           a->packet_pool.bytes == b->packet_pool.bytes &&
+           a->low_level_seeks == b->low_level_seeks &&
+           a->ts_last == b->ts_last;
+}
+
+// Record the current demuxer reader state for the demuxer-cache-state property
+// (s==NULL if there is none). The property value is rebuilt on the next read
+// only if the state changed. Observers are notified of changes to the seek
+// ranges and flags right away, and of other changes (like advancing fw-bytes
+// or reader-pts) only if periodic is set, to avoid waking them up on every
+// playloop iteration.
+void mp_update_cache_state(struct MPContext *mpctx,
+                           struct demux_ctrl_reader_state *s, bool periodic)
+{
+    struct command_ctx *ctx = mpctx->command_ctx;
+
+    if (!s) {
+        TA_FREEP(&ctx->cache_state);
+        m_option_free(&(struct m_option){.type = CONF_TYPE_NODE},
+                      &ctx->cache_state_node);
+        ctx->cache_state_changed = false;
+        return;
+    }
+
+    if (!ctx->cache_state || !cache_state_equal(ctx->cache_state, s)) {
+        if (!ctx->cache_state) {
+            ctx->cache_state = talloc_ptrtype(ctx, ctx->cache_state);
+            periodic = true;
+        } else {
+            periodic |= cache_state_major_change(ctx->cache_state, s);
+        }
+        *ctx->cache_state = *s;
+        m_option_free(&(struct m_option){.type = CONF_TYPE_NODE},
+                      &ctx->cache_state_node);
+        ctx->cache_state_changed = true;
+    }
+
+    if (ctx->cache_state_changed && periodic) {
+        ctx->cache_state_changed = false;
+        mp_notify_property(mpctx, "demuxer-cache-state");
+    }
+}
+
 static int mp_property_demuxer_start_time(void *ctx, struct m_property *prop,
                                           int action, void *arg)
 {
@@ -1793,6 +1960,15 @@ static int mp_property_cache_buffering(void *ctx, struct m_property *prop,
     return m_property_int_ro(action, arg, state);
 }
 
+static int mp_property_hls_adaptive_bitrate(void *ctx, struct m_property *prop,
+                                            int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (mpctx->opts->hls_bitrate != -2 || !mpctx->abr_bitrate)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_int_ro(action, arg, mpctx->abr_bitrate);
+}
+
 static int mp_property_demuxer_is_network(void *ctx, struct m_property *prop,
                                           int action, void *arg)
 {
@@ -2017,6 +2193,15 @@ static int mp_property_ao(void *ctx, struct m_property *p, int action, void *arg
                                     mpctx->ao ? ao_get_name(mpctx->ao) : NULL);
 }
 
+static int mp_property_ao_buffer_target(void *ctx, struct m_property *p,
+                                        int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (!mpctx->ao)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_double_ro(action, arg, ao_get_buffer_target(mpctx->ao));
+}
+
 /// Audio delay (RW)
 static int mp_property_audio_delay(void *ctx, struct m_property *prop,
                                    int action, void *arg)
@@ -2304,6 +2489,17 @@ static int property_list_tracks(void *ctx, struct m_property *prop,
         *(char **)arg = res;
         return M_PROPERTY_OK;
     }
+    if (action == M_PROPERTY_GET) {
+        // Rebuilding the list is expensive with many tracks, and clients tend
+        // to re-read it often. command_event() invalidates it.
+        struct mpv_node *node = &mpctx->command_ctx->track_list_node;
+        if (node->format == MPV_FORMAT_NONE) {
+            m_property_read_list(action, node, mpctx->num_tracks,
+                                 get_track_entry, mpctx);
+        }
+        m_option_copy(&(struct m_option){.type = CONF_TYPE_NODE}, arg, node);
+        return M_PROPERTY_OK;
+    }
     return m_property_read_list(action, arg, mpctx->num_tracks,
                                 get_track_entry, mpctx);
 }
@@ -2911,6 +3107,65 @@ out:
     return ret;
 }
 
+static int mp_property_perf_stats(void *ctx, struct m_property *prop,
+                                  int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+
+    switch (action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET: {
+        struct mpv_node node;
+        stats_global_query(mpctx->global, NULL, &node);
+        *(struct mpv_node *)arg = node;
+        return M_PROPERTY_OK;
+    }
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
+static int mp_property_memory_usage(void *ctx, struct m_property *prop,
+                                    int action, void *arg)
+{
+    switch (action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET: {
+        struct mpv_node node;
+        node_init(&node, MPV_FORMAT_NODE_MAP, NULL);
+        mp_mem_query(&node);
+        *(struct mpv_node *)arg = node;
+        return M_PROPERTY_OK;
+    }
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
+static int mp_property_playloop_wakeups(void *ctx, struct m_property *prop,
+                                        int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+
+    switch (action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET: {
+        struct mpv_node *r = (struct mpv_node *)arg;
+        node_init(r, MPV_FORMAT_NODE_MAP, NULL);
+        for (int n = 0; n < mpctx->num_wakeup_stats; n++) {
+            struct mp_wakeup_stat *st = &mpctx->wakeup_stats[n];
+            node_map_add_int64(r, st->reason, st->count);
+        }
+        return M_PROPERTY_OK;
+    }
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
 static int mp_property_vo(void *ctx, struct m_property *p, int action, void *arg)
 {
     MPContext *mpctx = ctx;
@@ -3383,6 +3638,26 @@ static int mp_property_playlist(void *ctx, struct m_property *prop,
                                 get_playlist_entry, &p);
 }
 
+static int mp_property_playlist_change(void *ctx, struct m_property *prop,
+                                       int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    struct playlist_change *c = &mpctx->playlist_change;
+    if (!c->type)
+        return M_PROPERTY_UNAVAILABLE;
+
+    struct m_sub_property props[] = {
+        {"id",      SUB_PROP_INT64(c->id)},
+        {"type",    SUB_PROP_STR(c->type)},
+        {"index",   SUB_PROP_INT(c->index)},
+        {"count",   SUB_PROP_INT(c->count)},
+        {"to",      SUB_PROP_INT(c->to), .unavailable = strcmp(c->type, "move")},
+        {0}
+    };
+
+    return m_property_read_sub(props, action, arg);
+}
+
 static char *print_obj_osd_list(struct m_obj_settings *list)
 {
     char *res = NULL;
@@ -3824,9 +4099,9 @@ static int mp_property_list(void *ctx, struct m_property *prop,
     case M_PROPERTY_GET: {
         char **list = NULL;
         int num = 0;
-        for (int n = 0; cmd->properties[n].name; n++) {
-            MP_TARRAY_APPEND(NULL, list, num,
-                                talloc_strdup(NULL, cmd->properties[n].name));
+        for (int n = 0; n < cmd->properties.num_props; n++) {
+            const char *pname = cmd->properties.props[n].name;
+            MP_TARRAY_APPEND(NULL, list, num, talloc_strdup(NULL, pname));
         }
         MP_TARRAY_APPEND(NULL, list, num, NULL);
         *(char ***)arg = list;
@@ -3914,12 +4189,16 @@ static const struct m_property mp_properties_base[] = {
     {"cache-size", mp_property_cache_size},
     {"cache-idle", mp_property_cache_idle},
     {"cache-speed", mp_property_cache_speed},
+    {"cache-read-size", mp_property_cache_read_size},
+    {"cache-latency", mp_property_cache_latency},
     {"demuxer-cache-duration", mp_property_demuxer_cache_duration},
     {"demuxer-cache-time", mp_property_demuxer_cache_time},
     {"demuxer-cache-idle", mp_property_demuxer_cache_idle},
     {"demuxer-start-time", mp_property_demuxer_start_time},
     {"demuxer-cache-state", mp_property_demuxer_cache_state},
+    {"thumbnails", mp_property_thumbnails},
     {"cache-buffering-state", mp_property_cache_buffering},
+    {"hls-adaptive-bitrate", mp_property_hls_adaptive_bitrate},
     {"paused-for-cache", mp_property_paused_for_cache},
     {"demuxer-via-network", mp_property_demuxer_is_network},
     {"clock", mp_property_clock},
@@ -3933,6 +4212,7 @@ static const struct m_property mp_properties_base[] = {
     {"disc-title-list", mp_property_list_disc_titles},
 
     {"playlist", mp_property_playlist},
+    {"playlist-change", mp_property_playlist_change},
     {"playlist-pos", mp_property_playlist_pos},
     {"playlist-pos-1", mp_property_playlist_pos_1},
     M_PROPERTY_ALIAS("playlist-count", "playlist/count"),
@@ -3952,6 +4232,7 @@ static const struct m_property mp_properties_base[] = {
     {"audio-device", mp_property_audio_device},
     {"audio-device-list", mp_property_audio_devices},
     {"current-ao", mp_property_ao},
+    {"audio-buffer-target", mp_property_ao_buffer_target},
 
     // Video
     {"fullscreen", mp_property_fullscreen},
@@ -3972,6 +4253,9 @@ static const struct m_property mp_properties_base[] = {
     {"window-scale", mp_property_window_scale},
     {"vo-configured", mp_property_vo_configured},
     {"vo-passes", mp_property_vo_passes},
+    {"perf-stats", mp_property_perf_stats},
+    {"memory-usage", mp_property_memory_usage},
+    {"playloop-wakeups", mp_property_playloop_wakeups},
     {"current-vo", mp_property_vo},
     {"container-fps", mp_property_fps},
     {"estimated-vf-fps", mp_property_vf_fps},
@@ -4091,7 +4375,7 @@ static const char *const *const mp_event_property_change[] = {
       "vo-delayed-frame-count", "mistimed-frame-count", "vsync-ratio",
       "estimated-display-fps", "vsync-jitter", "sub-text", "audio-bitrate",
       "video-bitrate", "sub-bitrate", "decoder-frame-drop-count",
-      "frame-drop-count", "video-frame-info"),
+      "frame-drop-count", "video-frame-info", "audio-buffer-target"),
     E(MP_EVENT_DURATION_UPDATE, "duration"),
     E(MPV_EVENT_VIDEO_RECONFIG, "video-out-params", "video-params",
       "video-format", "video-codec", "video-bitrate", "dwidth", "dheight",
@@ -4110,12 +4394,13 @@ static const char *const *const mp_event_property_change[] = {
     E(MP_EVENT_CACHE_UPDATE, "cache", "cache-free", "cache-used", "cache-idle",
       "demuxer-cache-duration", "demuxer-cache-idle", "paused-for-cache",
       "demuxer-cache-time", "cache-buffering-state", "cache-speed",
-      "cache-percent"),
+      "cache-read-size", "cache-latency", "cache-percent",
+      "hls-adaptive-bitrate"),
     E(MP_EVENT_WIN_RESIZE, "window-scale", "osd-width", "osd-height", "osd-par"),
     E(MP_EVENT_WIN_STATE, "window-minimized", "display-names", "display-fps",
       "fullscreen"),
     E(MP_EVENT_CHANGE_PLAYLIST, "playlist", "playlist-pos", "playlist-pos-1",
-      "playlist-count", "playlist/count"),
+      "playlist-count", "playlist/count", "playlist-change"),
     E(MP_EVENT_CORE_IDLE, "core-idle", "eof-reached"),
 };
 #undef E
@@ -4161,11 +4446,14 @@ uint64_t mp_get_property_event_mask(const char *name)
 int mp_get_property_id(struct MPContext *mpctx, const char *name)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    for (int n = 0; ctx->properties[n].name; n++) {
-        if (match_property(ctx->properties[n].name, name))
-            return n;
-    }
-    return -1;
+    // Same as matching with match_property() against each property.
+    if (strncmp(name, "options/", 8) == 0)
+        name += 8;
+    bstr prefix = bstr0(name);
+    const char *sep = strchr(name, '/');
+    if (sep)
+        prefix.len = sep - name;
+    return m_property_list_index(&ctx->properties, prefix);
 }
 
 static bool is_property_set(int action, void *val)
@@ -4190,7 +4478,7 @@ static int mp_property_do_silent(const char *name, int action, void *val,
 {
     struct command_ctx *cmd = ctx->command_ctx;
     cmd->silence_option_deprecations += 1;
-    int r = m_property_do(ctx->log, cmd->properties, name, action, val, ctx);
+    int r = m_property_do(ctx->log, &cmd->properties, name, action, val, ctx);
     cmd->silence_option_deprecations -= 1;
     if (r == M_PROPERTY_OK && is_property_set(action, val))
         mp_notify_property(ctx, (char *)name);
@@ -4224,34 +4512,125 @@ int mp_property_do(const char *name, int action, void *val,
 char *mp_property_expand_string(struct MPContext *mpctx, const char *str)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    return m_properties_expand_string(ctx->properties, str, mpctx);
+    return m_properties_expand_string(&ctx->properties, str, mpctx);
 }
 
-// Before expanding properties, parse C-style escapes like "\n"
-char *mp_property_expand_escaped_string(struct MPContext *mpctx, const char *str)
+// Parse C-style escapes like "\n". Returns NULL on broken escapes.
+static char *parse_escapes(void *ta_parent, const char *str)
 {
-    void *tmp = talloc_new(NULL);
     bstr strb = bstr0(str);
     bstr dst = {0};
     while (strb.len) {
-        if (!mp_append_escaped_string(tmp, &dst, &strb)) {
-            talloc_free(tmp);
-            return talloc_strdup(NULL, "(broken escape sequences)");
-        }
+        if (!mp_append_escaped_string(ta_parent, &dst, &strb))
+            return NULL;
         // pass " through literally
         if (!bstr_eatstart0(&strb, "\""))
             break;
-        bstr_xappend(tmp, &dst, bstr0("\""));
+        bstr_xappend(ta_parent, &dst, bstr0("\""));
     }
-    char *r = mp_property_expand_string(mpctx, dst.start);
+    return dst.start ? (char *)dst.start : talloc_strdup(ta_parent, "");
+}
+
+// Before expanding properties, parse C-style escapes like "\n"
+char *mp_property_expand_escaped_string(struct MPContext *mpctx, const char *str)
+{
+    void *tmp = talloc_new(NULL);
+    char *s = parse_escapes(tmp, str);
+    char *r = s ? mp_property_expand_string(mpctx, s)
+                : talloc_strdup(NULL, "(broken escape sequences)");
     talloc_free(tmp);
     return r;
 }
 
+struct mp_property_template {
+    char *src;              // unparsed string (with escapes)
+    struct m_property_template *tmpl; // NULL on broken escapes
+    uint64_t event_mask;    // events which may change the result
+    int *ids;               // property IDs which may change the result
+    int num_ids;
+    bool always_update;     // references properties without notifications
+    char *text;             // last result, NULL if none yet
+    uint64_t text_serial;   // ctx->change_serial when text was expanded
+};
+
+static struct mp_property_template *create_template(struct MPContext *mpctx,
+                                                    const char *str)
+{
+    struct command_ctx *ctx = mpctx->command_ctx;
+    struct mp_property_template *t = talloc_zero(mpctx, struct mp_property_template);
+    t->src = talloc_strdup(t, str);
+
+    char *s = parse_escapes(t, str);
+    if (!s) {
+        t->text = talloc_strdup(t, "(broken escape sequences)");
+        return t;
+    }
+    t->tmpl = m_property_template_compile(t, &ctx->properties, s);
+
+    // Events with "*" change all properties, even unknown ones.
+    uint64_t all_mask = mp_get_property_event_mask("");
+    const char *name;
+    for (int n = 0; (name = m_property_template_get_name(t->tmpl, n)); n++) {
+        uint64_t mask = mp_get_property_event_mask(name);
+        int id = mp_get_property_id(mpctx, name);
+        if (id >= 0)
+            MP_TARRAY_APPEND(t, t->ids, t->num_ids, id);
+        // Properties backed by options report changes by ID. Others that are
+        // not listed in mp_event_property_change[] can change at any time.
+        bstr base = bstr0(name);
+        bstr_eatstart0(&base, "options/");
+        bstr_split_tok(base, "/", &base, &(bstr){0});
+        if (mask == all_mask && id >= 0 &&
+            !m_config_get_co(mpctx->mconfig, base))
+            t->always_update = true;
+        t->event_mask |= mask;
+    }
+    return t;
+}
+
+static bool template_changed(struct command_ctx *ctx,
+                             struct mp_property_template *t)
+{
+    if (!t->text || t->always_update)
+        return true;
+    for (int n = 0; n < 64; n++) {
+        if ((t->event_mask & (1ULL << n)) &&
+            ctx->event_serial[n] > t->text_serial)
+            return true;
+    }
+    for (int n = 0; n < t->num_ids; n++) {
+        if (ctx->prop_serial[t->ids[n]] > t->text_serial)
+            return true;
+    }
+    return false;
+}
+
+// Like mp_property_expand_escaped_string(), but keep the parsed string in
+// *cache, and reuse the previous result if no notification was sent for the
+// referenced properties since then. *cache is initially NULL, is replaced
+// if str changes, and is a talloc child of mpctx.
+char *mp_property_expand_cached(struct MPContext *mpctx,
+                                struct mp_property_template **cache,
+                                const char *str)
+{
+    struct command_ctx *ctx = mpctx->command_ctx;
+    struct mp_property_template *t = *cache;
+    if (!t || strcmp(t->src, str) != 0) {
+        talloc_free(t);
+        t = *cache = create_template(mpctx, str);
+    }
+    if (t->tmpl && template_changed(ctx, t)) {
+        talloc_free(t->text);
+        t->text = talloc_steal(t, m_property_template_expand(t->tmpl, mpctx));
+        t->text_serial = ctx->change_serial;
+    }
+    return talloc_strdup(NULL, t->text);
+}
+
 void property_print_help(struct MPContext *mpctx)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    m_properties_print_help_list(mpctx->log, ctx->properties);
+    m_properties_print_help_list(mpctx->log, ctx->properties.props);
 }
 
 /* List of default ways to show a property on OSD.
@@ -4675,6 +5054,24 @@ error:
     return r;
 }
 
+static int overlay_thumbnail(struct MPContext *mpctx, int id, double time,
+                             int x, int y)
+{
+    if (id < 0 || id >= 64) {
+        MP_ERR(mpctx, "overlay-thumbnail: invalid id %d\n", id);
+        return -1;
+    }
+    struct overlay overlay = {
+        .source = thumbnails_get(mpctx, time),
+        .x = x,
+        .y = y,
+    };
+    if (!overlay.source)
+        return -1;
+    replace_overlay(mpctx, id, &overlay);
+    return 0;
+}
+
 static void overlay_remove(struct MPContext *mpctx, int id)
 {
     struct command_ctx *cmd = mpctx->command_ctx;
@@ -5161,7 +5558,14 @@ int run_command(struct MPContext *mpctx, struct mp_cmd *cmd, struct mpv_node *re
                 mp_write_watch_later_conf(mpctx);
             mp_set_playlist_entry(mpctx, entry);
         }
-        mp_notify(mpctx, MP_EVENT_CHANGE_PLAYLIST, NULL);
+        if (append) {
+            mp_notify_playlist_change(mpctx, (struct playlist_change){
+                .type = "insert", .count = 1,
+                .index = playlist_entry_to_index(mpctx->playlist, entry)});
+        } else {
+            mp_notify_playlist_change(mpctx, (struct playlist_change){
+                .type = "reset", .count = 1});
+        }
         mp_wakeup_core(mpctx);
         break;
     }
@@ -5175,13 +5579,17 @@ int run_command(struct MPContext *mpctx, struct mp_cmd *cmd, struct mpv_node *re
             struct playlist_entry *new = pl->current;
             if (!append)
                 playlist_clear(mpctx->playlist);
+            int index = playlist_entry_count(mpctx->playlist);
+            int count = playlist_entry_count(pl);
             playlist_append_entries(mpctx->playlist, pl);
             talloc_free(pl);
 
             if (!append && mpctx->playlist->first)
                 mp_set_playlist_entry(mpctx, new ? new : mpctx->playlist->first);
 
-            mp_notify(mpctx, MP_EVENT_CHANGE_PLAYLIST, NULL);
+            mp_notify_playlist_change(mpctx, (struct playlist_change){
+                .type = append ? "insert" : "reset", .index = index,
+                .count = count});
             mp_wakeup_core(mpctx);
         } else {
             MP_ERR(mpctx, "Unable to load playlist %s.\n", filename);
@@ -5203,7 +5611,8 @@ int run_command(struct MPContext *mpctx, struct mp_cmd *cmd, struct mpv_node *re
             }
             playlist_remove(mpctx->playlist, e);
         }
-        mp_notify(mpctx, MP_EVENT_CHANGE_PLAYLIST, NULL);
+        mp_notify_playlist_change(mpctx, (struct playlist_change){
+            .type = "reset", .count = playlist_entry_count(mpctx->playlist)});
         mp_wakeup_core(mpctx);
         break;
     }
@@ -5218,8 +5627,10 @@ int run_command(struct MPContext *mpctx, struct mp_cmd *cmd, struct mpv_node *re
         // Can't play a removed entry
         if (mpctx->playlist->current == e && !mpctx->stop_play)
             mpctx->stop_play = PT_NEXT_ENTRY;
+        int index = playlist_entry_to_index(mpctx->playlist, e);
         playlist_remove(mpctx->playlist, e);
-        mp_notify(mpctx, MP_EVENT_CHANGE_PLAYLIST, NULL);
+        mp_notify_playlist_change(mpctx, (struct playlist_change){
+            .type = "remove", .index = index, .count = 1});
         mp_wakeup_core(mpctx);
         break;
     }
@@ -5231,14 +5642,22 @@ int run_command(struct MPContext *mpctx, struct mp_cmd *cmd, struct mpv_node *re
                                                               cmd->args[1].v.i);
         if (!e1)
             return -1;
+        struct playlist_change change = {
+            .type = "move",
+            .index = playlist_entry_to_index(mpctx->playlist, e1),
+            .count = 1,
+            .to = e2 ? playlist_entry_to_index(mpctx->playlist, e2)
+                     : playlist_entry_count(mpctx->playlist),
+        };
         playlist_move(mpctx->playlist, e1, e2);
-        mp_notify(mpctx, MP_EVENT_CHANGE_PLAYLIST, NULL);
+        mp_notify_playlist_change(mpctx, change);
         break;
     }
 
     case MP_CMD_PLAYLIST_SHUFFLE: {
         playlist_shuffle(mpctx->playlist);
-        mp_notify(mpctx, MP_EVENT_CHANGE_PLAYLIST, NULL);
+        mp_notify_playlist_change(mpctx, (struct playlist_change){
+            .type = "reset", .count = playlist_entry_count(mpctx->playlist)});
         break;
     }
 
@@ -5369,6 +5788,22 @@ int run_command(struct MPContext *mpctx, struct mp_cmd *cmd, struct mpv_node *re
                            async);
         break;
 
+    case MP_CMD_SCREENSHOT_THUMBNAILS: {
+        int width = cmd->args[2].v.i;
+        if (width < 1)
+            return -1;
+        double *times = talloc_array(NULL, double, cmd->nargs - 3);
+        for (int n = 3; n < cmd->nargs; n++)
+            times[n - 3] = cmd->args[n].v.d;
+        int written = screenshot_thumbnails(mpctx, cmd->args[0].v.s,
+                                            cmd->args[1].v.s, width, times,
+                                            cmd->nargs - 3);
+        talloc_free(times);
+        if (!written)
+            return -1;
+        break;
+    }
+
     case MP_CMD_SCREENSHOT_RAW: {
         if (!res)
             return -1;
@@ -5534,6 +5969,12 @@ int run_command(struct MPContext *mpctx, struct mp_cmd *cmd, struct mpv_node *re
         overlay_remove(mpctx, cmd->args[0].v.i);
         break;
 
+    case MP_CMD_OVERLAY_THUMBNAIL:
+        if (overlay_thumbnail(mpctx, cmd->args[0].v.i, cmd->args[1].v.d,
+                              cmd->args[2].v.i, cmd->args[3].v.i) < 0)
+            return -1;
+        break;
+
     case MP_CMD_COMMAND_LIST: {
         for (struct mp_cmd *sub = cmd->args[0].v.p; sub; sub = sub->queue_next)
             run_command(mpctx, sub, NULL);
@@ -5641,6 +6082,9 @@ int run_command(struct MPContext *mpctx, struct mp_cmd *cmd, struct mpv_node *re
 void command_uninit(struct MPContext *mpctx)
 {
     overlay_uninit(mpctx);
+    mp_update_cache_state(mpctx, NULL, false);
+    m_option_free(&(struct m_option){.type = CONF_TYPE_NODE},
+                  &mpctx->command_ctx->track_list_node);
     ao_hotplug_destroy(mpctx->command_ctx->hotplug);
     talloc_free(mpctx->command_ctx);
     mpctx->command_ctx = NULL;
@@ -5656,9 +6100,11 @@ void command_init(struct MPContext *mpctx)
 
     int num_base = MP_ARRAY_SIZE(mp_properties_base);
     int num_opts = m_config_get_co_count(mpctx->mconfig);
-    ctx->properties =
+    struct m_property *props =
         talloc_zero_array(ctx, struct m_property, num_base + num_opts + 1);
-    memcpy(ctx->properties, mp_properties_base, sizeof(mp_properties_base));
+    memcpy(props, mp_properties_base, sizeof(mp_properties_base));
+    // Sort the manual properties for the lookup below.
+    m_property_list_init(&ctx->properties, props);
 
     int count = num_base;
     for (int n = 0; n < num_opts; n++) {
@@ -5705,23 +6151,45 @@ void command_init(struct MPContext *mpctx)
 
         if (prop.name) {
             // The option might be covered by a manual property already.
-            if (m_property_list_find(ctx->properties, prop.name))
+            if (m_property_list_find(&ctx->properties, prop.name))
                 continue;
 
-            ctx->properties[count++] = prop;
+            props[count++] = prop;
         }
     }
+
+    m_property_list_init(&ctx->properties, props);
+    ctx->prop_serial =
+        talloc_zero_array(ctx, uint64_t, ctx->properties.num_props);
 }
 
 static void command_event(struct MPContext *mpctx, int event, void *arg)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
 
+    if (event >= 0 && event < MP_ARRAY_SIZE(ctx->event_serial))
+        ctx->event_serial[event] = ++ctx->change_serial;
+
     if (event == MPV_EVENT_START_FILE) {
         ctx->last_seek_pts = MP_NOPTS_VALUE;
         ctx->marked_pts = MP_NOPTS_VALUE;
     }
 
+    // Events that can come with changes to any field of track-list: tracks
+    // added/removed, selection, and decoder (re)initialization.
+    switch (event) {
+    case MPV_EVENT_START_FILE:
+    case MPV_EVENT_END_FILE:
+    case MPV_EVENT_FILE_LOADED:
+    case MPV_EVENT_TRACKS_CHANGED:
+    case MPV_EVENT_TRACK_SWITCHED:
+    case MPV_EVENT_VIDEO_RECONFIG:
+    case MPV_EVENT_AUDIO_RECONFIG:
+        m_option_free(&(struct m_option){.type = CONF_TYPE_NODE},
+                      &ctx->track_list_node);
+        break;
+    }
+
     if (event == MPV_EVENT_IDLE)
         ctx->is_idle = true;
     if (event == MPV_EVENT_START_FILE)
@@ -5740,6 +6208,8 @@ void handle_command_updates(struct MPContext *mpctx)
     // to recheck the state. Then the client(s) will read the property.
     if (ctx->hotplug && ao_hotplug_check_update(ctx->hotplug))
         mp_notify_property(mpctx, "audio-device-list");
+
+    mp_client_update_property_timers(mpctx);
 }
 
 void mp_notify(struct MPContext *mpctx, int event, void *arg)
@@ -5834,5 +6304,19 @@ void mp_option_change_callback(void *ctx, struct m_config_option *co, int flags)
 
 void mp_notify_property(struct MPContext *mpctx, const char *property)
 {
+    struct command_ctx *ctx = mpctx->command_ctx;
+    int id = mp_get_property_id(mpctx, property);
+    if (id >= 0)
+        ctx->prop_serial[id] = ++ctx->change_serial;
     mp_client_property_change(mpctx, property);
 }
+
+// Record the change for the "playlist-change" property, and notify observers
+// of all playlist properties.
+void mp_notify_playlist_change(struct MPContext *mpctx,
+                               struct playlist_change change)
+{
+    change.id = mpctx->playlist_change.id + 1;
+    mpctx->playlist_change = change;
+    mp_notify(mpctx, MP_EVENT_CHANGE_PLAYLIST, NULL);
+}
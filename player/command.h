@@ -25,6 +25,7 @@ struct mp_cmd;
 struct mp_log;
 struct mpv_node;
 struct m_config_option;
+struct demux_ctrl_reader_state;
 
 void command_init(struct MPContext *mpctx);
 void command_uninit(struct MPContext *mpctx);
@@ -32,6 +33,10 @@ void command_uninit(struct MPContext *mpctx);
 int run_command(struct MPContext *mpctx, struct mp_cmd *cmd, struct mpv_node *res);
 char *mp_property_expand_string(struct MPContext *mpctx, const char *str);
 char *mp_property_expand_escaped_string(struct MPContext *mpctx, const char *str);
+struct mp_property_template;
+char *mp_property_expand_cached(struct MPContext *mpctx,
+                                struct mp_property_template **cache,
+                                const char *str);
 void property_print_help(struct MPContext *mpctx);
 int mp_property_do(const char* name, int action, void* val,
                    struct MPContext *mpctx);
@@ -41,8 +46,13 @@ void mp_option_change_callback(void *ctx, struct m_config_option *co, int flags)
 
 void mp_notify(struct MPContext *mpctx, int event, void *arg);
 void mp_notify_property(struct MPContext *mpctx, const char *property);
+struct playlist_change;
+void mp_notify_playlist_change(struct MPContext *mpctx,
+                               struct playlist_change change);
 
 void handle_command_updates(struct MPContext *mpctx);
+void mp_update_cache_state(struct MPContext *mpctx,
+                           struct demux_ctrl_reader_state *s, bool periodic);
 
 int mp_get_property_id(struct MPContext *mpctx, const char *name);
 uint64_t mp_get_property_event_mask(const char *name);
@@ -16,10 +16,14 @@
  */
 
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
 #include <stdbool.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <libavutil/md5.h>
@@ -165,11 +169,50 @@ void mp_load_auto_profiles(struct MPContext *mpctx)
 
 #define MP_WATCH_LATER_CONF "watch_later"
 
-static char *mp_get_playback_resume_config_filename(struct MPContext *mpctx,
-                                                    const char *fname)
+// Playlists longer than this are checked for resume configs by listing the
+// watch_later directory.
+#define RESUME_SCAN_MIN_ENTRIES 8
+
+// In-memory index of the resume configs in the watch_later directory. It's
+// kept across playlist checks, and rebuilt only if the mtime of the directory
+// changed, so loading further playlists costs one stat() call.
+struct resume_index {
+    char *dir;
+    time_t mtime;
+    bool valid;
+    struct resume_index_entry {
+        uint8_t md5[16];
+        bool used;
+    } *entries;         // hash table, open addressing
+    unsigned size;      // number of entries (power of 2)
+};
+
+static char *get_watch_later_dir(struct MPContext *mpctx)
+{
+    if (!mpctx->cached_watch_later_configdir) {
+        char *wl_dir = mpctx->opts->watch_later_directory;
+        if (wl_dir && wl_dir[0]) {
+            mpctx->cached_watch_later_configdir =
+                mp_get_user_path(mpctx, mpctx->global, wl_dir);
+        }
+    }
+
+    if (!mpctx->cached_watch_later_configdir) {
+        mpctx->cached_watch_later_configdir =
+            mp_find_user_config_file(mpctx, mpctx->global, MP_WATCH_LATER_CONF);
+    }
+
+    return mpctx->cached_watch_later_configdir;
+}
+
+// Compute the MD5 that identifies the resume config of fname.
+// cwd is the current working directory; it's only used for local paths, and
+// can be NULL, in which case it's retrieved on demand.
+static bool get_resume_md5(struct MPContext *mpctx, const char *fname,
+                           const char *cwd, uint8_t md5[16])
 {
     struct MPOpts *opts = mpctx->opts;
-    char *res = NULL;
+    bool res = false;
     void *tmp = talloc_new(NULL);
     const char *realpath = fname;
     bstr bfname = bstr0(fname);
@@ -177,7 +220,8 @@ static char *mp_get_playback_resume_config_filename(struct MPContext *mpctx,
         if (opts->ignore_path_in_watch_later_config) {
             realpath = mp_basename(fname);
         } else {
-            char *cwd = mp_getcwd(tmp);
+            if (!cwd)
+                cwd = mp_getcwd(tmp);
             if (!cwd)
                 goto exit;
             realpath = mp_path_join(tmp, cwd, fname);
@@ -188,33 +232,39 @@ static char *mp_get_playback_resume_config_filename(struct MPContext *mpctx,
     if ((bstr_startswith0(bfname, "br://") || bstr_startswith0(bfname, "bd://") ||
          bstr_startswith0(bfname, "bluray://")) && opts->bluray_device)
         realpath = talloc_asprintf(tmp, "%s - %s", realpath, opts->bluray_device);
-    uint8_t md5[16];
     av_md5_sum(md5, realpath, strlen(realpath));
-    char *conf = talloc_strdup(tmp, "");
-    for (int i = 0; i < 16; i++)
-        conf = talloc_asprintf_append(conf, "%02X", md5[i]);
-
-    if (!mpctx->cached_watch_later_configdir) {
-        char *wl_dir = mpctx->opts->watch_later_directory;
-        if (wl_dir && wl_dir[0]) {
-            mpctx->cached_watch_later_configdir =
-                mp_get_user_path(mpctx, mpctx->global, wl_dir);
-        }
-    }
-
-    if (!mpctx->cached_watch_later_configdir) {
-        mpctx->cached_watch_later_configdir =
-            mp_find_user_config_file(mpctx, mpctx->global, MP_WATCH_LATER_CONF);
-    }
-
-    if (mpctx->cached_watch_later_configdir)
-        res = mp_path_join(NULL, mpctx->cached_watch_later_configdir, conf);
+    res = true;
 
 exit:
     talloc_free(tmp);
     return res;
 }
 
+// Return the name of the resume config file (without directory) for fname.
+static char *get_resume_config_name(struct MPContext *mpctx, void *ta_ctx,
+                                    const char *fname, const char *cwd)
+{
+    uint8_t md5[16];
+    if (!get_resume_md5(mpctx, fname, cwd, md5))
+        return NULL;
+    char *res = talloc_strdup(ta_ctx, "");
+    for (int i = 0; i < 16; i++)
+        res = talloc_asprintf_append(res, "%02X", md5[i]);
+    return res;
+}
+
+static char *mp_get_playback_resume_config_filename(struct MPContext *mpctx,
+                                                    const char *fname)
+{
+    char *res = NULL;
+    char *conf = get_resume_config_name(mpctx, NULL, fname, NULL);
+    char *dir = get_watch_later_dir(mpctx);
+    if (conf && dir)
+        res = mp_path_join(NULL, dir, conf);
+    talloc_free(conf);
+    return res;
+}
+
 static const char *const backup_properties[] = {
     "osd-level",
     //"loop",
@@ -412,23 +462,128 @@ void mp_load_playback_resume(struct MPContext *mpctx, const char *file)
     talloc_free(fname);
 }
 
+static struct resume_index_entry *index_find(struct resume_index *ix,
+                                             const uint8_t md5[16])
+{
+    // MD5 is well distributed, so its first bytes make a fine hash.
+    unsigned h = md5[0] | (md5[1] << 8) | (md5[2] << 16) | ((unsigned)md5[3] << 24);
+    for (unsigned n = 0; n < ix->size; n++) {
+        struct resume_index_entry *e = &ix->entries[(h + n) & (ix->size - 1)];
+        if (!e->used || memcmp(e->md5, md5, 16) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static bool parse_resume_config_name(const char *name, uint8_t md5[16])
+{
+    if (strlen(name) != 32)
+        return false;
+    for (int i = 0; i < 32; i++) {
+        char c = mp_toupper(name[i]);
+        int v;
+        if (c >= '0' && c <= '9') {
+            v = c - '0';
+        } else if (c >= 'A' && c <= 'F') {
+            v = c - 'A' + 10;
+        } else {
+            return false;
+        }
+        md5[i / 2] = (i % 2) ? (md5[i / 2] << 4) | v : v;
+    }
+    return true;
+}
+
+// Return the index of the watch_later directory, or NULL if it can't be read.
+static struct resume_index *get_resume_index(struct MPContext *mpctx)
+{
+    char *dirpath = get_watch_later_dir(mpctx);
+    struct stat st;
+    if (!dirpath || stat(dirpath, &st) != 0)
+        return NULL;
+
+    struct resume_index *ix = mpctx->resume_index;
+    if (ix && ix->valid && strcmp(ix->dir, dirpath) == 0 &&
+        ix->mtime == st.st_mtime)
+        return ix;
+
+    DIR *d = opendir(dirpath);
+    if (!d)
+        return NULL;
+
+    talloc_free(ix);
+    ix = mpctx->resume_index = talloc_zero(mpctx, struct resume_index);
+    ix->dir = talloc_strdup(ix, dirpath);
+    ix->mtime = st.st_mtime;
+    // Changes within the same second as the listing would not change the
+    // mtime, so such a listing is used once only.
+    ix->valid = time(NULL) > st.st_mtime;
+
+    struct resume_index_entry *names = NULL;
+    int num_names = 0;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        struct resume_index_entry e = {.used = true};
+        if (parse_resume_config_name(de->d_name, e.md5))
+            MP_TARRAY_APPEND(ix, names, num_names, e);
+    }
+    closedir(d);
+
+    ix->size = 16;
+    while (ix->size < num_names * 2)
+        ix->size *= 2;
+    ix->entries = talloc_zero_array(ix, struct resume_index_entry, ix->size);
+    for (int n = 0; n < num_names; n++)
+        *index_find(ix, names[n].md5) = names[n];
+    talloc_free(names);
+
+    MP_DBG(mpctx, "Indexed %d resume configs.\n", num_names);
+    return ix;
+}
+
 // Returns the first file that has a resume config.
 // Compared to hashing the playlist file or contents and managing separate
 // resume file for them, this is simpler, and also has the nice property
 // that appending to a playlist doesn't interfere with resuming (especially
 // if the playlist comes from the command line).
+// For longer playlists, an index of the watch_later directory is used, instead
+// of probing a file for every entry.
 struct playlist_entry *mp_check_playlist_resume(struct MPContext *mpctx,
                                                 struct playlist *playlist)
 {
     if (!mpctx->opts->position_resume)
         return NULL;
+    if (playlist->num_entries <= RESUME_SCAN_MIN_ENTRIES) {
+        for (struct playlist_entry *e = playlist->first; e; e = e->next) {
+            char *conf = mp_get_playback_resume_config_filename(mpctx,
+                                                                e->filename);
+            bool exists = conf && mp_path_exists(conf);
+            talloc_free(conf);
+            if (exists)
+                return e;
+        }
+        return NULL;
+    }
+
+    struct playlist_entry *res = NULL;
+    void *tmp = talloc_new(NULL);
+    struct resume_index *ix = get_resume_index(mpctx);
+    if (!ix)
+        goto done;
+
+    char *cwd = mp_getcwd(tmp);
     for (struct playlist_entry *e = playlist->first; e; e = e->next) {
-        char *conf = mp_get_playback_resume_config_filename(mpctx, e->filename);
-        bool exists = conf && mp_path_exists(conf);
-        talloc_free(conf);
-        if (exists)
-            return e;
+        uint8_t md5[16];
+        if (get_resume_md5(mpctx, e->filename, cwd, md5)) {
+            struct resume_index_entry *ie = index_find(ix, md5);
+            if (ie && ie->used) {
+                res = e;
+                break;
+            }
+        }
     }
-    return NULL;
-}
 
+done:
+    talloc_free(tmp);
+    return res;
+}
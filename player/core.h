@@ -19,6 +19,7 @@
 #define MPLAYER_MP_CORE_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <pthread.h>
 
 #include "osdep/atomic.h"
@@ -278,9 +279,19 @@ typedef struct MPContext {
     bool osd_force_update, osd_idle_update;
     char *osd_msg_text;
     bool osd_show_pos;
+    // Parsed --term-status-msg, --osd-status-msg and --osd-msgN strings.
+    struct mp_property_template *term_status_tmpl, *osd_status_tmpl;
+    struct mp_property_template *osd_msg_tmpl[3];
     struct osd_progbar_state osd_progbar;
 
     struct playlist *playlist;
+    // Last change to the playlist, see "playlist-change" property.
+    struct playlist_change {
+        int64_t id;         // incremented with each change
+        const char *type;   // "insert", "remove", "move", "reset"
+        int index, count;   // affected range (before the change for removes)
+        int to;             // for "move": index the entry was moved before
+    } playlist_change;
     struct playlist_entry *playing; // currently playing file
     char *filename; // immutable copy of playing->filename (or NULL)
     char *stream_open_filename;
@@ -331,6 +342,11 @@ typedef struct MPContext {
     struct mp_image *next_frames[VO_MAX_REQ_FRAMES + 1];
     int num_next_frames;
     struct mp_image *saved_frame;   // for hrseek_lastframe and hrseek_backstep
+    // Frames decoded by the last backstep seek (--frame-back-step-cache),
+    // sorted by pts.
+    struct mp_image **backstep_frames;
+    int num_backstep_frames;
+    bool backstep_cached;   // displayed frame was taken from backstep_frames
 
     enum playback_status video_status, audio_status;
     bool restart_complete;
@@ -350,6 +366,7 @@ typedef struct MPContext {
     int mistimed_frames_total;
     bool hrseek_active;     // skip all data until hrseek_pts
     bool hrseek_framedrop;  // allow decoder to drop frames before hrseek_pts
+    bool scrubbing;         // last seek was a --keyframe-scrub seek
     bool hrseek_lastframe;  // drop everything until last frame reached
     bool hrseek_backstep;   // go to frame before seek target
     double hrseek_pts;
@@ -397,6 +414,11 @@ typedef struct MPContext {
     double next_cache_update;
 
     double sleeptime;      // number of seconds to sleep before next iteration
+    const char *sleep_reason; // caller that set sleeptime (static string)
+
+    // Why mp_wait_events() returned, for the playloop-wakeups property.
+    struct mp_wakeup_stat *wakeup_stats;
+    int num_wakeup_stats;
 
     double mouse_timer;
     unsigned int mouse_event_ts;
@@ -434,6 +456,10 @@ typedef struct MPContext {
 
     bool paused_for_cache;
     double cache_stop_time;
+    // --hls-bitrate=adaptive state
+    int abr_bitrate;            // currently selected variant (0 if none)
+    double abr_last_switch;     // mp_time_sec() of the last variant switch
+    bool abr_buffer_ok;         // buffer was above the low mark since then
     int cache_buffer;
 
     // Set after showing warning about decoding being too slow for realtime
@@ -443,13 +469,39 @@ typedef struct MPContext {
     struct mp_recorder *recorder;
 
     char *cached_watch_later_configdir;
+    struct resume_index *resume_index;
+
+    struct audio_cache *audio_cache;
+    bool playing_cached_audio; // mpctx->demuxer is from audio_cache
 
     struct screenshot_ctx *screenshot_ctx;
+    struct thumbnails_ctx *thumbnails;
     struct command_ctx *command_ctx;
     struct encode_lavc_context *encode_lavc_ctx;
 
     struct mp_ipc_ctx *ipc_ctx;
 
+    // Directory listings for autoloading external files.
+    struct external_files_cache *external_files_cache;
+
+    // --perf-stats-file state.
+    FILE *perf_stats_file;
+    char *perf_stats_path;
+    double next_perf_stats;
+
+    // --osd-stats state.
+    int stats_overlay_page;
+    double next_stats_overlay;
+
+    // --benchmark-file state (only set during playback).
+    struct mp_benchmark *benchmark;
+
+    // --trace-file state.
+    FILE *trace_file;
+    char *trace_path;
+    int trace_tracks;
+    double next_trace_flush;
+
     struct mpv_opengl_cb_context *gl_cb_ctx;
 
     pthread_mutex_t lock;
@@ -467,10 +519,17 @@ typedef struct MPContext {
     char *open_url;
     char *open_format;
     int open_url_flags;
+    bool open_preselect; // select likely tracks and start demuxing early
     // --- All fields below are owned by open_thread, unless open_done was set
     //     to true.
     struct demuxer *open_res_demuxer;
     int open_res_error;
+    // Set by the main thread after open_done, for open_res_demuxer.
+    struct dec_audio *open_res_audio_dec;
+    bool open_res_audio_dec_tried;
+
+    // Audio decoder prepared for mpctx->demuxer by prefetching.
+    struct dec_audio *prefetched_audio_dec;
 } MPContext;
 
 // audio.c
@@ -490,6 +549,15 @@ void reinit_audio_chain_src(struct MPContext *mpctx, struct track *track);
 void audio_update_volume(struct MPContext *mpctx);
 void audio_update_balance(struct MPContext *mpctx);
 void reload_audio_output(struct MPContext *mpctx);
+struct dec_audio *prefetch_audio_decoder(struct MPContext *mpctx,
+                                         struct demuxer *demuxer);
+
+// audio_cache.c
+bool audio_cache_open(struct MPContext *mpctx);
+void audio_cache_start_capture(struct MPContext *mpctx);
+void audio_cache_abort_capture(struct MPContext *mpctx);
+void audio_cache_capture_frame(struct MPContext *mpctx, struct mp_aframe *frame);
+void audio_cache_finish_capture(struct MPContext *mpctx);
 
 // configfiles.c
 void mp_parse_cfgfiles(struct MPContext *mpctx);
@@ -564,9 +632,20 @@ void term_osd_set_subs(struct MPContext *mpctx, const char *text);
 void get_current_osd_sym(struct MPContext *mpctx, char *buf, size_t buf_size);
 void set_osd_bar_chapters(struct MPContext *mpctx, int type);
 
+// stats_overlay.c
+void update_stats_overlay(struct MPContext *mpctx);
+
 // playloop.c
+struct mp_wakeup_stat {
+    const char *reason;
+    int64_t count;
+};
+
 void mp_wait_events(struct MPContext *mpctx);
-void mp_set_timeout(struct MPContext *mpctx, double sleeptime);
+void mp_set_timeout_reason(struct MPContext *mpctx, double sleeptime,
+                           const char *reason);
+#define mp_set_timeout(mpctx, sleeptime) \
+    mp_set_timeout_reason(mpctx, sleeptime, __func__)
 void mp_wakeup_core(struct MPContext *mpctx);
 void mp_wakeup_core_cb(void *ctx);
 void mp_process_input(struct MPContext *mpctx);
@@ -592,6 +671,10 @@ int get_cache_buffering_percentage(struct MPContext *mpctx);
 void execute_queued_seek(struct MPContext *mpctx);
 void run_playloop(struct MPContext *mpctx);
 void mp_idle(struct MPContext *mpctx);
+void close_trace_file(struct MPContext *mpctx);
+void benchmark_start(struct MPContext *mpctx);
+void benchmark_frame(struct MPContext *mpctx);
+void benchmark_finish(struct MPContext *mpctx);
 void idle_loop(struct MPContext *mpctx);
 int handle_force_window(struct MPContext *mpctx, bool force);
 void seek_to_last_frame(struct MPContext *mpctx);
@@ -608,6 +691,20 @@ void mp_load_builtin_scripts(struct MPContext *mpctx);
 int mp_load_script(struct MPContext *mpctx, const char *fname);
 int mp_load_user_script(struct MPContext *mpctx, const char *fname);
 
+// thumbnails.c
+struct thumbnails_info {
+    int count;          // number of slots
+    int ready;          // number of slots generated so far
+    int width, height;  // size of each thumbnail (height 0 if none yet)
+    double duration;
+    bool done;          // generator finished or failed
+};
+void thumbnails_start(struct MPContext *mpctx);
+void thumbnails_stop(struct MPContext *mpctx);
+void thumbnails_update(struct MPContext *mpctx);
+bool thumbnails_get_info(struct MPContext *mpctx, struct thumbnails_info *info);
+struct mp_image *thumbnails_get(struct MPContext *mpctx, double time);
+
 // sub.c
 void reset_subtitle_state(struct MPContext *mpctx);
 void reinit_sub(struct MPContext *mpctx, struct track *track);
@@ -632,5 +729,6 @@ void uninit_video_chain(struct MPContext *mpctx);
 double calc_average_frame_duration(struct MPContext *mpctx);
 int init_video_decoder(struct MPContext *mpctx, struct track *track);
 void recreate_auto_filters(struct MPContext *mpctx);
+bool video_step_cached(struct MPContext *mpctx, int dir);
 
 #endif /* MPLAYER_MP_CORE_H */
@@ -20,6 +20,9 @@
 #include <strings.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "osdep/io.h"
 
@@ -104,7 +107,131 @@ static struct bstr guess_lang_from_filename(struct bstr name)
     return (struct bstr){name.start + i + 1, n};
 }
 
+// Maximum number of directory listings kept by struct external_files_cache.
+#define MAX_CACHED_DIRS 16
+
+// A directory entry with a known subtitle or audio file extension.
+struct dir_entry {
+    bstr name;          // UTF-8 file name
+    bstr name_trim;     // lower case name without extension, trimmed
+    int type;           // STREAM_SUB/STREAM_AUDIO
+};
+
+struct dir_listing {
+    char *path;
+    struct stat st;     // of the directory at scan time
+    time_t scan_time;
+    struct dir_entry *entries;
+    int num_entries;
+};
+
+struct external_files_cache {
+    // Most recently used listing last.
+    struct dir_listing **dirs;
+    int num_dirs;
+};
+
+// Cache for find_external_files(). Free with talloc_free().
+struct external_files_cache *external_files_cache_create(void *ta_parent)
+{
+    return talloc_zero(ta_parent, struct external_files_cache);
+}
+
+static struct dir_listing *scan_dir(struct mp_log *log, const char *path)
+{
+    struct dir_listing *dir = talloc_zero(NULL, struct dir_listing);
+    dir->path = talloc_strdup(dir, path);
+    dir->scan_time = time(NULL);
+    if (stat(path, &dir->st))
+        goto error;
+
+    DIR *d = opendir(path);
+    if (!d)
+        goto error;
+    mp_verbose(log, "Loading external files in %s\n", path);
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        struct bstr den = bstr0(de->d_name);
+        struct bstr dename = mp_iconv_to_utf8(log, den,
+                                              "UTF-8-MAC", MP_NO_LATIN1_FALLBACK);
+        int type = test_ext(bstr_get_ext(dename));
+        if (type >= 0) {
+            char *fullpath = mp_path_join_bstr(NULL, bstr0(path), dename);
+            bool exists = mp_path_exists(fullpath);
+            talloc_free(fullpath);
+            if (exists) {
+                struct dir_entry e = {
+                    .name = bstrdup(dir, dename),
+                    .type = type,
+                };
+                struct bstr noext = bstrdup(dir, bstr_strip_ext(e.name));
+                bstr_lower(noext);
+                e.name_trim = bstr_strip(noext);
+                MP_TARRAY_APPEND(dir, dir->entries, dir->num_entries, e);
+            }
+        }
+        if (den.start != dename.start)
+            talloc_free(dename.start);
+    }
+    closedir(d);
+    return dir;
+
+error:
+    talloc_free(dir);
+    return NULL;
+}
+
+// Return whether the directory may have changed since the listing was made.
+// Changes within the same second as the scan can't be detected with the
+// mtime, so such listings are never reused.
+static bool dir_changed(struct dir_listing *dir)
+{
+    struct stat st;
+    if (stat(dir->path, &st))
+        return true;
+    return st.st_mtime != dir->st.st_mtime || st.st_ino != dir->st.st_ino ||
+           st.st_dev != dir->st.st_dev ||
+           dir->st.st_mtime >= dir->scan_time - 1;
+}
+
+// Return the listing for the given directory. The result is either owned by
+// the cache, or must be freed by the caller (if *owned is set to true).
+static struct dir_listing *get_dir(struct external_files_cache *cache,
+                                   struct mp_log *log, const char *path,
+                                   bool *owned)
+{
+    *owned = !cache;
+    if (!cache)
+        return scan_dir(log, path);
+
+    for (int n = 0; n < cache->num_dirs; n++) {
+        struct dir_listing *dir = cache->dirs[n];
+        if (strcmp(dir->path, path) == 0) {
+            MP_TARRAY_REMOVE_AT(cache->dirs, cache->num_dirs, n);
+            if (!dir_changed(dir)) {
+                mp_verbose(log, "Using cached listing of %s\n", path);
+                MP_TARRAY_APPEND(cache, cache->dirs, cache->num_dirs, dir);
+                return dir;
+            }
+            talloc_free(dir);
+            break;
+        }
+    }
+
+    struct dir_listing *dir = scan_dir(log, path);
+    if (dir) {
+        if (cache->num_dirs >= MAX_CACHED_DIRS) {
+            talloc_free(cache->dirs[0]);
+            MP_TARRAY_REMOVE_AT(cache->dirs, cache->num_dirs, 0);
+        }
+        MP_TARRAY_APPEND(cache, cache->dirs, cache->num_dirs, dir);
+        talloc_steal(cache, dir);
+    }
+    return dir;
+}
+
 static void append_dir_subtitles(struct mpv_global *global,
+                                 struct external_files_cache *cache,
                                  struct subfn **slist, int *nsub,
                                  struct bstr path, const char *fname,
                                  int limit_fuzziness, int limit_type)
@@ -128,27 +255,19 @@ static void append_dir_subtitles(struct mpv_global *global,
     if (mp_is_url(bstr0(path0)))
         goto out;
 
-    DIR *d = opendir(path0);
-    if (!d)
+    bool owned;
+    struct dir_listing *dir = get_dir(cache, log, path0, &owned);
+    if (!dir)
         goto out;
-    mp_verbose(log, "Loading external files in %.*s\n", BSTR_P(path));
-    struct dirent *de;
-    while ((de = readdir(d))) {
-        void *tmpmem2 = talloc_new(tmpmem);
-        struct bstr den = bstr0(de->d_name);
-        struct bstr dename = mp_iconv_to_utf8(log, den,
-                                              "UTF-8-MAC", MP_NO_LATIN1_FALLBACK);
-        // retrieve various parts of the filename
-        struct bstr tmp_fname_noext = bstrdup(tmpmem2, bstr_strip_ext(dename));
-        bstr_lower(tmp_fname_noext);
-        struct bstr tmp_fname_ext = bstr_get_ext(dename);
-        struct bstr tmp_fname_trim = bstr_strip(tmp_fname_noext);
+    if (owned)
+        talloc_steal(tmpmem, dir);
 
-        if (den.start != dename.start)
-            talloc_steal(tmpmem2, dename.start);
+    for (int i = 0; i < dir->num_entries; i++) {
+        struct dir_entry *e = &dir->entries[i];
+        struct bstr tmp_fname_trim = e->name_trim;
 
         // check what it is (most likely)
-        int type = test_ext(tmp_fname_ext);
+        int type = e->type;
         char **langs = NULL;
         int fuzz = -1;
         switch (type) {
@@ -163,7 +282,7 @@ static void append_dir_subtitles(struct mpv_global *global,
         }
 
         if (fuzz < 0 || (limit_type >= 0 && limit_type != type))
-            goto next_sub;
+            continue;
 
         // we have a (likely) subtitle file
         // 0 = nothing
@@ -195,32 +314,25 @@ static void append_dir_subtitles(struct mpv_global *global,
             }
         }
 
-        mp_dbg(log, "Potential external file: \"%s\"  Priority: %d\n",
-               de->d_name, prio);
+        mp_dbg(log, "Potential external file: \"%.*s\"  Priority: %d\n",
+               BSTR_P(e->name), prio);
 
         if (prio) {
             prio += prio;
-            char *subpath = mp_path_join_bstr(*slist, path, dename);
-            if (mp_path_exists(subpath)) {
-                MP_TARRAY_GROW(NULL, *slist, *nsub);
-                struct subfn *sub = *slist + (*nsub)++;
-
-                // annoying and redundant
-                if (strncmp(subpath, "./", 2) == 0)
-                    subpath += 2;
-
-                sub->type     = type;
-                sub->priority = prio;
-                sub->fname    = subpath;
-                sub->lang     = lang.len ? bstrdup0(*slist, lang) : NULL;
-            } else
-                talloc_free(subpath);
+            char *subpath = mp_path_join_bstr(*slist, path, e->name);
+            MP_TARRAY_GROW(NULL, *slist, *nsub);
+            struct subfn *sub = *slist + (*nsub)++;
+
+            // annoying and redundant
+            if (strncmp(subpath, "./", 2) == 0)
+                subpath += 2;
+
+            sub->type     = type;
+            sub->priority = prio;
+            sub->fname    = subpath;
+            sub->lang     = lang.len ? bstrdup0(*slist, lang) : NULL;
         }
-
-    next_sub:
-        talloc_free(tmpmem2);
     }
-    closedir(d);
 
  out:
     talloc_free(tmpmem);
@@ -253,7 +365,8 @@ static void filter_subidx(struct subfn **slist, int *nsub)
     }
 }
 
-static void load_paths(struct mpv_global *global, struct subfn **slist,
+static void load_paths(struct mpv_global *global,
+                       struct external_files_cache *cache, struct subfn **slist,
                        int *nsubs, const char *fname, char **paths,
                        char *cfg_path, int type)
 {
@@ -262,7 +375,7 @@ static void load_paths(struct mpv_global *global, struct subfn **slist,
         char *path = mp_path_join_bstr(
             *slist, mp_dirname(fname),
             bstr0(expanded_path ? expanded_path : paths[i]));
-        append_dir_subtitles(global, slist, nsubs, bstr0(path),
+        append_dir_subtitles(global, cache, slist, nsubs, bstr0(path),
                              fname, 0, type);
         talloc_free(expanded_path);
     }
@@ -270,32 +383,37 @@ static void load_paths(struct mpv_global *global, struct subfn **slist,
     // Load subtitles in ~/.mpv/sub (or similar) limiting sub fuzziness
     char *mp_subdir = mp_find_config_file(NULL, global, cfg_path);
     if (mp_subdir) {
-        append_dir_subtitles(global, slist, nsubs, bstr0(mp_subdir), fname, 1,
-                             type);
+        append_dir_subtitles(global, cache, slist, nsubs, bstr0(mp_subdir),
+                             fname, 1, type);
     }
     talloc_free(mp_subdir);
 }
 
 // Return a list of subtitles and audio files found, sorted by priority.
 // Last element is terminated with a fname==NULL entry.
-struct subfn *find_external_files(struct mpv_global *global, const char *fname)
+// cache can be NULL. Otherwise, directory listings are reused from it if
+// the directory wasn't modified since.
+struct subfn *find_external_files(struct mpv_global *global,
+                                  struct external_files_cache *cache,
+                                  const char *fname)
 {
     struct MPOpts *opts = global->opts;
     struct subfn *slist = talloc_array_ptrtype(NULL, slist, 1);
     int n = 0;
 
     // Load subtitles from current media directory
-    append_dir_subtitles(global, &slist, &n, mp_dirname(fname), fname, 0, -1);
+    append_dir_subtitles(global, cache, &slist, &n, mp_dirname(fname), fname,
+                         0, -1);
 
     // Load subtitles in dirs specified by sub-paths option
     if (opts->sub_auto >= 0) {
-        load_paths(global, &slist, &n, fname, opts->sub_paths, "sub",
+        load_paths(global, cache, &slist, &n, fname, opts->sub_paths, "sub",
                    STREAM_SUB);
     }
 
     if (opts->audiofile_auto >= 0) {
-        load_paths(global, &slist, &n, fname, opts->audiofile_paths, "audio",
-                   STREAM_AUDIO);
+        load_paths(global, cache, &slist, &n, fname, opts->audiofile_paths,
+                   "audio", STREAM_AUDIO);
     }
 
     // Sort by name for filter_subidx()
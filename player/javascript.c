@@ -24,6 +24,7 @@
 #include <dirent.h>
 #include <math.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include <mujs.h>
 
@@ -33,6 +34,7 @@
 #include "options/m_property.h"
 #include "common/msg.h"
 #include "common/msg_control.h"
+#include "common/stats.h"
 #include "options/m_option.h"
 #include "input/input.h"
 #include "options/path.h"
@@ -452,6 +454,32 @@ static int s_init_js(js_State *J, struct script_ctx *ctx)
     return 0;
 }
 
+// mujs does not pass the old size to the allocator, so it's stored in front
+// of each allocation for memory accounting.
+union alloc_header {
+    size_t size;
+    long double align_ld;
+    int64_t align_i64;
+    void *align_ptr;
+};
+
+static void *mp_js_alloc(void *actx, void *ptr, int size)
+{
+    union alloc_header *h = ptr ? (union alloc_header *)ptr - 1 : NULL;
+    int64_t old_size = h ? h->size : 0;
+    if (size <= 0) {
+        free(h);
+        mp_mem_account(MP_MEM_SCRIPTS, -old_size);
+        return NULL;
+    }
+    union alloc_header *res = realloc(h, sizeof(*h) + size);
+    if (!res)
+        return NULL;
+    res->size = size;
+    mp_mem_account(MP_MEM_SCRIPTS, size - old_size);
+    return res + 1;
+}
+
 /**********************************************************************
  *  Initialization - booting the script
  *********************************************************************/
@@ -475,7 +503,7 @@ static int s_load_javascript(struct mpv_handle *client, const char *fname)
     };
 
     int r = -1;
-    js_State *J = js_newstate(NULL, NULL, 0);
+    js_State *J = js_newstate(mp_js_alloc, NULL, 0);
     if (!J || s_init_js(J, ctx))
         goto error_out;
 
@@ -719,7 +747,9 @@ static void script_set_osd_ass(js_State *J)
     int res_x = js_tonumber(J, 1);
     int res_y = js_tonumber(J, 2);
     const char *text = js_tostring(J, 3);
-    osd_set_external(ctx->mpctx->osd, ctx->client, res_x, res_y, (char *)text);
+    int layer = js_isundefined(J, 4) ? 0 : js_tonumber(J, 4);
+    osd_set_external(ctx->mpctx->osd, ctx->client, layer, res_x, res_y,
+                     (char *)text);
     mp_wakeup_core(ctx->mpctx);
     push_success(J);
 }
@@ -36,6 +36,7 @@
 #include "common/common.h"
 #include "common/av_common.h"
 #include "common/msg.h"
+#include "misc/thread_pool.h"
 
 #include "audio/format.h"
 #include "audio/aframe.h"
@@ -54,6 +55,11 @@
 struct lavfi {
     struct mp_log *log;
     char *graph_string;
+    int threads;
+
+    // Old graphs are destroyed on this (if not NULL), because uninitializing
+    // heavy filters can take a while, and would delay seeking.
+    struct mp_thread_pool *free_pool;
 
     struct mp_hwdec_devices *hwdec_devs;
 
@@ -110,6 +116,10 @@ struct lavfi_pad {
     struct mp_image *in_fmt_v;
     struct mp_aframe *in_fmt_a;
 
+    // in_fmt_* from before the last seek (see lavfi_seek_reset())
+    struct mp_image *prev_fmt_v;
+    struct mp_aframe *prev_fmt_a;
+
     // -- dir==LAVFI_OUT
 
     bool output_needed; // caller has signaled it needs new output
@@ -170,6 +180,9 @@ static void precreate_graph(struct lavfi *c)
     c->graph = avfilter_graph_alloc();
     if (!c->graph)
         abort();
+    // Must be set before any filters are added.
+    c->graph->nb_threads = c->threads;
+    c->graph->thread_type = AVFILTER_THREAD_SLICE;
     AVFilterInOut *in = NULL, *out = NULL;
     if (avfilter_graph_parse2(c->graph, c->graph_string, &in, &out) < 0) {
         c->graph = NULL;
@@ -191,8 +204,19 @@ static void precreate_graph(struct lavfi *c)
     }
 }
 
+static void free_graph_fn(void *ptr)
+{
+    AVFilterGraph *graph = ptr;
+    avfilter_graph_free(&graph);
+}
+
 static void free_graph(struct lavfi *c)
 {
+    if (c->graph && c->free_pool) {
+        // Nothing references the graph anymore after this function.
+        mp_thread_pool_queue(c->free_pool, free_graph_fn, c->graph);
+        c->graph = NULL;
+    }
     avfilter_graph_free(&c->graph);
     for (int n = 0; n < c->num_pads; n++) {
         struct lavfi_pad *pad = c->pads[n];
@@ -229,18 +253,19 @@ static void clear_data(struct lavfi *c)
         drop_pad_data(c->pads[n]);
 }
 
-void lavfi_seek_reset(struct lavfi *c)
+static void drop_prev_fmt(struct lavfi_pad *pad)
 {
-    free_graph(c);
-    clear_data(c);
-    precreate_graph(c);
+    TA_FREEP(&pad->prev_fmt_v);
+    TA_FREEP(&pad->prev_fmt_a);
 }
 
-struct lavfi *lavfi_create(struct mp_log *log, char *graph_string)
+struct lavfi *lavfi_create(struct mp_log *log, char *graph_string, int threads)
 {
     struct lavfi *c = talloc_zero(NULL, struct lavfi);
     c->log = log;
     c->graph_string = graph_string;
+    c->threads = threads;
+    c->free_pool = mp_thread_pool_create(c, 1);
     c->tmp_frame = av_frame_alloc();
     if (!c->tmp_frame)
         abort();
@@ -254,8 +279,10 @@ void lavfi_destroy(struct lavfi *c)
         return;
     free_graph(c);
     clear_data(c);
+    for (int n = 0; n < c->num_pads; n++)
+        drop_prev_fmt(c->pads[n]);
     av_frame_free(&c->tmp_frame);
-    talloc_free(c);
+    talloc_free(c); // waits until old graphs are freed
 }
 
 const char *lavfi_get_graph(struct lavfi *c)
@@ -390,9 +417,13 @@ static bool init_pads(struct lavfi *c)
                 goto error;
         } else {
             TA_FREEP(&pad->in_fmt_v); // potentially cleanup previous error state
+            TA_FREEP(&pad->in_fmt_a);
 
             pad->input_eof |= !pad->connected;
 
+            if (pad->pending_a || pad->pending_v)
+                drop_prev_fmt(pad);
+
             if (pad->pending_a) {
                 assert(pad->type == STREAM_AUDIO);
                 pad->in_fmt_a = mp_aframe_new_ref(pad->pending_a);
@@ -405,6 +436,11 @@ static bool init_pads(struct lavfi *c)
                 if (!pad->in_fmt_v)
                     goto error;
                 mp_image_unref_data(pad->in_fmt_v);
+            } else if (pad->prev_fmt_a || pad->prev_fmt_v) {
+                pad->in_fmt_a = pad->prev_fmt_a;
+                pad->in_fmt_v = pad->prev_fmt_v;
+                pad->prev_fmt_a = NULL;
+                pad->prev_fmt_v = NULL;
             } else if (pad->input_eof) {
                 // libavfilter makes this painful. Init it with a dummy config,
                 // just so we can tell it the stream is EOF.
@@ -547,6 +583,40 @@ static void init_graph(struct lavfi *c)
     }
 }
 
+// libavfilter can't flush a graph, so a new one has to be created to get rid
+// of data buffered from before the seek. But the input formats usually don't
+// change with seeking, so the new graph is configured with the old formats
+// right away. If the new data has a different format after all, the normal
+// format change handling recreates the graph.
+void lavfi_seek_reset(struct lavfi *c)
+{
+    bool reuse = c->initialized;
+    for (int n = 0; n < c->num_pads; n++) {
+        struct lavfi_pad *pad = c->pads[n];
+        drop_prev_fmt(pad);
+        // Hardware frames contexts are often recreated by the decoder.
+        if (pad->in_fmt_v && pad->in_fmt_v->hwctx)
+            reuse = false;
+        if (reuse) {
+            pad->prev_fmt_v = pad->in_fmt_v;
+            pad->prev_fmt_a = pad->in_fmt_a;
+            pad->in_fmt_v = NULL;
+            pad->in_fmt_a = NULL;
+        }
+    }
+    if (!reuse) {
+        for (int n = 0; n < c->num_pads; n++)
+            drop_prev_fmt(c->pads[n]);
+    }
+
+    free_graph(c);
+    clear_data(c);
+    precreate_graph(c);
+
+    if (reuse && !c->failed)
+        init_graph(c);
+}
+
 static void feed_input_pads(struct lavfi *c)
 {
     assert(c->initialized);
@@ -12,7 +12,7 @@ enum lavfi_direction {
     LAVFI_OUT,
 };
 
-struct lavfi *lavfi_create(struct mp_log *log, char *graph_string);
+struct lavfi *lavfi_create(struct mp_log *log, char *graph_string, int threads);
 const char *lavfi_get_graph(struct lavfi *c);
 void lavfi_destroy(struct lavfi *c);
 struct lavfi_pad *lavfi_find_pad(struct lavfi *c, char *name);
@@ -42,6 +42,7 @@
 #include "common/encode.h"
 #include "common/recorder.h"
 #include "input/input.h"
+#include "misc/thread_pool.h"
 
 #include "audio/decode/dec_audio.h"
 #include "audio/out/ao.h"
@@ -88,8 +89,13 @@ static void uninit_demuxer(struct MPContext *mpctx)
     }
     mpctx->num_tracks = 0;
 
+    audio_uninit(mpctx->prefetched_audio_dec);
+    mpctx->prefetched_audio_dec = NULL;
+
     free_demuxer_and_stream(mpctx->demuxer);
     mpctx->demuxer = NULL;
+    mp_update_cache_state(mpctx, NULL, false);
+    mpctx->playing_cached_audio = false;
 
     pthread_mutex_lock(&mpctx->lock);
     talloc_free(mpctx->demuxer_cancel);
@@ -345,11 +351,13 @@ static bool compare_track(struct track *t1, struct track *t2, char **langs,
         return t1->default_track;
     if (t1->attached_picture != t2->attached_picture)
         return !t1->attached_picture;
-    if (t1->stream && t2->stream && opts->hls_bitrate >= 0 &&
+    // Adaptive bitrate selection starts with the lowest bitrate.
+    int hls_bitrate = opts->hls_bitrate == -2 ? 0 : opts->hls_bitrate;
+    if (t1->stream && t2->stream && hls_bitrate >= 0 &&
         t1->stream->hls_bitrate != t2->stream->hls_bitrate)
     {
-        bool t1_ok = t1->stream->hls_bitrate <= opts->hls_bitrate;
-        bool t2_ok = t2->stream->hls_bitrate <= opts->hls_bitrate;
+        bool t1_ok = t1->stream->hls_bitrate <= hls_bitrate;
+        bool t2_ok = t2->stream->hls_bitrate <= hls_bitrate;
         if (t1_ok != t2_ok)
             return t1_ok;
         if (t1_ok && t2_ok)
@@ -573,19 +581,19 @@ bool mp_remove_track(struct MPContext *mpctx, struct track *track)
     return true;
 }
 
-// Add the given file as additional track. Only tracks of type "filter" are
-// included; pass STREAM_TYPE_COUNT to disable filtering.
-struct track *mp_add_external_file(struct MPContext *mpctx, char *filename,
-                                   enum stream_type filter)
+static const char *get_disp_filename(const char *filename)
 {
-    struct MPOpts *opts = mpctx->opts;
-    if (!filename)
-        return NULL;
-
-    char *disp_filename = filename;
-    if (strncmp(disp_filename, "memory://", 9) == 0)
-        disp_filename = "memory://"; // avoid noise
+    if (strncmp(filename, "memory://", 9) == 0)
+        return "memory://"; // avoid noise
+    return filename;
+}
 
+static struct demuxer *open_external_demuxer(struct MPContext *mpctx,
+                                             char *filename,
+                                             enum stream_type filter,
+                                             struct mp_cancel *cancel)
+{
+    struct MPOpts *opts = mpctx->opts;
     struct demuxer_params params = {0};
 
     switch (filter) {
@@ -597,10 +605,22 @@ struct track *mp_add_external_file(struct MPContext *mpctx, char *filename,
         break;
     }
 
-    struct demuxer *demuxer =
-        demux_open_url(filename, &params, mpctx->playback_abort, mpctx->global);
-    if (!demuxer)
-        goto err_out;
+    return demux_open_url(filename, &params, cancel, mpctx->global);
+}
+
+// Add the tracks of an opened external file. Takes ownership of demuxer.
+static struct track *add_external_demuxer(struct MPContext *mpctx,
+                                          struct demuxer *demuxer,
+                                          char *filename,
+                                          enum stream_type filter)
+{
+    struct MPOpts *opts = mpctx->opts;
+    const char *disp_filename = get_disp_filename(filename);
+
+    if (!demuxer) {
+        MP_ERR(mpctx, "Can not open external file %s.\n", disp_filename);
+        return NULL;
+    }
     enable_demux_thread(mpctx, demuxer);
 
     if (opts->rebase_start_time)
@@ -621,7 +641,7 @@ struct track *mp_add_external_file(struct MPContext *mpctx, char *filename,
         if (filter == STREAM_TYPE_COUNT)
             tname = "";
         MP_ERR(mpctx, "No %sstreams in file %s.\n", tname, disp_filename);
-        return false;
+        return NULL;
     }
 
     struct track *first = NULL;
@@ -638,17 +658,163 @@ struct track *mp_add_external_file(struct MPContext *mpctx, char *filename,
     }
 
     return first;
+}
+
+// Add the given file as additional track. Only tracks of type "filter" are
+// included; pass STREAM_TYPE_COUNT to disable filtering.
+struct track *mp_add_external_file(struct MPContext *mpctx, char *filename,
+                                   enum stream_type filter)
+{
+    if (!filename)
+        return NULL;
+
+    struct demuxer *demuxer =
+        open_external_demuxer(mpctx, filename, filter, mpctx->playback_abort);
+    return add_external_demuxer(mpctx, demuxer, filename, filter);
+}
+
+// Maximum number of external files opened at the same time.
+#define MAX_EXTERNAL_OPEN_THREADS 8
+
+struct external_batch {
+    struct MPContext *mpctx;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    int pending;            // protected by lock
+};
+
+struct external_file {
+    struct external_batch *batch;
+    char *filename;
+    enum stream_type filter;
+    char *lang;             // autoloaded files only
+    struct mp_cancel *cancel;
+    struct demuxer *demuxer;
+    bool timed_out;
+};
+
+static void external_open_fn(void *p)
+{
+    struct external_file *f = p;
+    struct external_batch *batch = f->batch;
+
+    f->demuxer = open_external_demuxer(batch->mpctx, f->filename, f->filter,
+                                       f->cancel);
+
+    pthread_mutex_lock(&batch->lock);
+    batch->pending--;
+    pthread_cond_signal(&batch->wakeup);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+// Open the given external files concurrently, and add their tracks in the
+// order of the list (so track IDs don't depend on which file opens first).
+// Each file is cancelled if playback is aborted, or on timeout.
+static void add_external_files(struct MPContext *mpctx,
+                               struct external_file *files, int num_files,
+                               bool auto_loaded)
+{
+    if (!num_files)
+        return;
+
+    void *tmp = talloc_new(NULL);
+    struct external_batch batch = {.mpctx = mpctx, .pending = num_files};
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.wakeup, NULL);
+
+    struct mp_thread_pool *pool = NULL;
+    if (num_files > 1) {
+        pool = mp_thread_pool_create(tmp, MPMIN(num_files,
+                                                MAX_EXTERNAL_OPEN_THREADS));
+    }
+
+    for (int n = 0; n < num_files; n++) {
+        files[n].batch = &batch;
+        files[n].cancel = mp_cancel_new(tmp);
+        mp_cancel_set_parent(files[n].cancel, mpctx->playback_abort);
+        if (pool) {
+            mp_thread_pool_queue(pool, external_open_fn, &files[n]);
+        } else {
+            external_open_fn(&files[n]);
+        }
+    }
+
+    // Playback abort is propagated to the files by the cancel parent. Only
+    // the timeout has to be handled here.
+    double timeout = mpctx->opts->external_file_timeout;
+    int64_t deadline = timeout > 0 ? mp_add_timeout(mp_time_us(), timeout) : 0;
+
+    pthread_mutex_lock(&batch.lock);
+    while (batch.pending) {
+        if (!deadline) {
+            pthread_cond_wait(&batch.wakeup, &batch.lock);
+            continue;
+        }
+        struct timespec ts = mp_time_us_to_timespec(deadline);
+        if (pthread_cond_timedwait(&batch.wakeup, &batch.lock, &ts) &&
+            mp_time_us() >= deadline)
+        {
+            for (int n = 0; n < num_files; n++) {
+                files[n].timed_out = true;
+                mp_cancel_trigger(files[n].cancel);
+            }
+            deadline = 0;
+        }
+    }
+    pthread_mutex_unlock(&batch.lock);
+
+    talloc_free(pool);
+    pthread_cond_destroy(&batch.wakeup);
+    pthread_mutex_destroy(&batch.lock);
 
-err_out:
-    MP_ERR(mpctx, "Can not open external file %s.\n", disp_filename);
-    return false;
+    for (int n = 0; n < num_files; n++) {
+        struct external_file *f = &files[n];
+        if (!f->demuxer && f->timed_out) {
+            MP_ERR(mpctx, "Timeout opening external file %s.\n",
+                   get_disp_filename(f->filename));
+            continue;
+        }
+        // The cancel handle must live as long as the stream.
+        if (f->demuxer)
+            talloc_steal(f->demuxer->stream, f->cancel);
+        struct track *track =
+            add_external_demuxer(mpctx, f->demuxer, f->filename, f->filter);
+        if (track && auto_loaded) {
+            track->auto_loaded = true;
+            if (!track->lang)
+                track->lang = talloc_strdup(track, f->lang);
+        }
+    }
+
+    talloc_free(tmp);
 }
 
-static void open_external_files(struct MPContext *mpctx, char **files,
-                                enum stream_type filter)
+static void open_external_files(struct MPContext *mpctx)
 {
-    for (int n = 0; files && files[n]; n++)
-        mp_add_external_file(mpctx, files[n], filter);
+    struct MPOpts *opts = mpctx->opts;
+    struct {
+        char **list;
+        enum stream_type filter;
+    } sources[] = {
+        {opts->audio_files, STREAM_AUDIO},
+        {opts->sub_name, STREAM_SUB},
+        {opts->external_files, STREAM_TYPE_COUNT},
+    };
+
+    struct external_file *files = NULL;
+    int num_files = 0;
+    for (int i = 0; i < MP_ARRAY_SIZE(sources); i++) {
+        for (int n = 0; sources[i].list && sources[i].list[n]; n++) {
+            struct external_file f = {
+                .filename = sources[i].list[n],
+                .filter = sources[i].filter,
+            };
+            MP_TARRAY_APPEND(NULL, files, num_files, f);
+        }
+    }
+
+    add_external_files(mpctx, files, num_files, false);
+    talloc_free(files);
 }
 
 void autoload_external_files(struct MPContext *mpctx)
@@ -666,7 +832,11 @@ void autoload_external_files(struct MPContext *mpctx)
                                     &stream_filename) > 0)
             base_filename = talloc_steal(tmp, stream_filename);
     }
-    struct subfn *list = find_external_files(mpctx->global, base_filename);
+    if (!mpctx->external_files_cache)
+        mpctx->external_files_cache = external_files_cache_create(mpctx);
+    struct subfn *list = find_external_files(mpctx->global,
+                                             mpctx->external_files_cache,
+                                             base_filename);
     talloc_steal(tmp, list);
 
     int sc[STREAM_TYPE_COUNT] = {0};
@@ -675,9 +845,10 @@ void autoload_external_files(struct MPContext *mpctx)
             sc[mpctx->tracks[n]->type]++;
     }
 
+    struct external_file *files = NULL;
+    int num_files = 0;
     for (int i = 0; list && list[i].fname; i++) {
         char *filename = list[i].fname;
-        char *lang = list[i].lang;
         for (int n = 0; n < mpctx->num_tracks; n++) {
             struct track *t = mpctx->tracks[n];
             if (t->demuxer && strcmp(t->demuxer->filename, filename) == 0)
@@ -687,15 +858,17 @@ void autoload_external_files(struct MPContext *mpctx)
             goto skip;
         if (list[i].type == STREAM_AUDIO && !sc[STREAM_VIDEO])
             goto skip;
-        struct track *track = mp_add_external_file(mpctx, filename, list[i].type);
-        if (track) {
-            track->auto_loaded = true;
-            if (!track->lang)
-                track->lang = talloc_strdup(track, lang);
-        }
+        struct external_file f = {
+            .filename = filename,
+            .filter = list[i].type,
+            .lang = list[i].lang,
+        };
+        MP_TARRAY_APPEND(tmp, files, num_files, f);
     skip:;
     }
 
+    add_external_files(mpctx, files, num_files, true);
+
     talloc_free(tmp);
 }
 
@@ -820,6 +993,27 @@ static void load_per_file_options(m_config_t *conf,
     }
 }
 
+// Select the streams that will most likely be played, and start reading
+// packets for them in the background. The track selection done on playback
+// start deselects them again if this guessed wrong.
+static void preselect_streams(struct demuxer *demuxer)
+{
+    struct sh_stream *sel[STREAM_TYPE_COUNT] = {0};
+    for (int n = 0; n < demux_get_num_stream(demuxer); n++) {
+        struct sh_stream *sh = demux_get_stream(demuxer, n);
+        if (sh->type != STREAM_VIDEO && sh->type != STREAM_AUDIO)
+            continue;
+        if (!sel[sh->type] || (sh->default_track && !sel[sh->type]->default_track))
+            sel[sh->type] = sh;
+    }
+    for (int t = 0; t < STREAM_TYPE_COUNT; t++) {
+        if (sel[t])
+            demuxer_select_track(demuxer, sel[t], MP_NOPTS_VALUE, true);
+    }
+    if (!demuxer->fully_read)
+        demux_start_thread(demuxer);
+}
+
 static void *open_demux_thread(void *ctx)
 {
     struct MPContext *mpctx = ctx;
@@ -834,6 +1028,8 @@ static void *open_demux_thread(void *ctx)
 
     if (mpctx->open_res_demuxer) {
         MP_VERBOSE(mpctx, "Opening done: %s\n", mpctx->open_url);
+        if (mpctx->open_preselect)
+            preselect_streams(mpctx->open_res_demuxer);
     } else {
         MP_VERBOSE(mpctx, "Opening failed or was aborted: %s\n", mpctx->open_url);
 
@@ -862,6 +1058,10 @@ static void cancel_open(struct MPContext *mpctx)
     TA_FREEP(&mpctx->open_url);
     TA_FREEP(&mpctx->open_format);
 
+    audio_uninit(mpctx->open_res_audio_dec);
+    mpctx->open_res_audio_dec = NULL;
+    mpctx->open_res_audio_dec_tried = false;
+
     if (mpctx->open_res_demuxer)
         free_demuxer_and_stream(mpctx->open_res_demuxer);
     mpctx->open_res_demuxer = NULL;
@@ -870,7 +1070,8 @@ static void cancel_open(struct MPContext *mpctx)
 }
 
 // Setup all the field to open this url, and make sure a thread is running.
-static void start_open(struct MPContext *mpctx, char *url, int url_flags)
+static void start_open(struct MPContext *mpctx, char *url, int url_flags,
+                       bool preselect)
 {
     cancel_open(mpctx);
 
@@ -883,6 +1084,7 @@ static void start_open(struct MPContext *mpctx, char *url, int url_flags)
     mpctx->open_url = talloc_strdup(NULL, url);
     mpctx->open_format = talloc_strdup(NULL, mpctx->opts->demuxer_name);
     mpctx->open_url_flags = url_flags;
+    mpctx->open_preselect = preselect && mpctx->opts->demuxer_thread;
     if (mpctx->opts->load_unsafe_playlists)
         mpctx->open_url_flags = 0;
 
@@ -919,7 +1121,7 @@ static void open_demux_reentrant(struct MPContext *mpctx)
     }
 
     if (!mpctx->open_active)
-        start_open(mpctx, url, mpctx->playing->stream_flags);
+        start_open(mpctx, url, mpctx->playing->stream_flags, false);
 
     // User abort should cancel the opener now.
     pthread_mutex_lock(&mpctx->lock);
@@ -938,6 +1140,8 @@ static void open_demux_reentrant(struct MPContext *mpctx)
         mpctx->demuxer = mpctx->open_res_demuxer;
         mpctx->open_res_demuxer = NULL;
         mpctx->open_cancel = NULL;
+        mpctx->prefetched_audio_dec = mpctx->open_res_audio_dec;
+        mpctx->open_res_audio_dec = NULL;
     } else {
         mpctx->error_playing = mpctx->open_res_error;
         pthread_mutex_lock(&mpctx->lock);
@@ -956,7 +1160,19 @@ void prefetch_next(struct MPContext *mpctx)
     struct playlist_entry *new_entry = mp_next_file(mpctx, +1, false, false);
     if (new_entry && !mpctx->open_active && new_entry->filename) {
         MP_VERBOSE(mpctx, "Prefetching: %s\n", new_entry->filename);
-        start_open(mpctx, new_entry->filename, new_entry->stream_flags);
+        start_open(mpctx, new_entry->filename, new_entry->stream_flags,
+                   mpctx->opts->prefetch_open == 2);
+    }
+
+    // With gapless audio, also get the audio decoder of the next file ready
+    // while the current file is still playing.
+    if (mpctx->open_active && mpctx->open_preselect &&
+        mpctx->opts->gapless_audio && !mpctx->open_res_audio_dec_tried &&
+        atomic_load(&mpctx->open_done) && mpctx->open_res_demuxer)
+    {
+        mpctx->open_res_audio_dec_tried = true;
+        mpctx->open_res_audio_dec =
+            prefetch_audio_decoder(mpctx, mpctx->open_res_demuxer);
     }
 }
 
@@ -1031,7 +1247,8 @@ static int reinit_complex_filters(struct MPContext *mpctx, bool force_uninit)
         goto done;
     }
 
-    mpctx->lavfi = lavfi_create(mpctx->log, graph);
+    mpctx->lavfi = lavfi_create(mpctx->log, graph,
+                                mpctx->opts->lavfi_complex_threads);
     if (!mpctx->lavfi)
         goto done;
 
@@ -1175,6 +1392,10 @@ static void play_current_file(struct MPContext *mpctx)
     mpctx->display_sync_error = 0.0;
     mpctx->display_sync_active = false;
     mpctx->seek = (struct seek_params){ 0 };
+    mpctx->scrubbing = false;
+    mpctx->abr_bitrate = 0;
+    mpctx->abr_last_switch = mp_time_sec();
+    mpctx->abr_buffer_ok = false;
 
     reset_playback_state(mpctx);
 
@@ -1230,7 +1451,8 @@ reopen_file:
         goto terminate_playback;
     }
 
-    open_demux_reentrant(mpctx);
+    if (!audio_cache_open(mpctx))
+        open_demux_reentrant(mpctx);
     if (!mpctx->stop_play && !mpctx->demuxer &&
         process_open_hooks(mpctx, "on_load_fail") >= 0 &&
         strcmp(mpctx->stream_open_filename, mpctx->filename) != 0)
@@ -1252,7 +1474,9 @@ reopen_file:
         for (struct playlist_entry *e = pl->first; e; e = e->next)
             e->stream_flags |= entry_stream_flags;
         transfer_playlist(mpctx, pl);
-        mp_notify_property(mpctx, "playlist");
+        mp_notify_playlist_change(mpctx, (struct playlist_change){
+            .type = "reset",
+            .count = playlist_entry_count(mpctx->playlist)});
         mpctx->error_playing = 2;
         goto terminate_playback;
     }
@@ -1264,9 +1488,7 @@ reopen_file:
     load_chapters(mpctx);
     add_demuxer_tracks(mpctx, mpctx->demuxer);
 
-    open_external_files(mpctx, opts->audio_files, STREAM_AUDIO);
-    open_external_files(mpctx, opts->sub_name, STREAM_SUB);
-    open_external_files(mpctx, opts->external_files, STREAM_TYPE_COUNT);
+    open_external_files(mpctx);
     autoload_external_files(mpctx);
 
     check_previous_track_selection(mpctx);
@@ -1323,6 +1545,7 @@ reopen_file:
 
     reinit_video_chain(mpctx);
     reinit_audio_chain(mpctx);
+    audio_cache_start_capture(mpctx);
     reinit_sub_all(mpctx);
 
     if (!mpctx->vo_chain && !mpctx->ao_chain && opts->stream_auto_sel) {
@@ -1344,6 +1567,7 @@ reopen_file:
     mpctx->playback_initialized = true;
     mp_notify(mpctx, MPV_EVENT_FILE_LOADED, NULL);
     update_screensaver_state(mpctx);
+    thumbnails_start(mpctx);
 
     if (mpctx->max_frames == 0) {
         if (!mpctx->stop_play)
@@ -1370,6 +1594,7 @@ reopen_file:
     open_recorder(mpctx, true);
 
     playback_start = mp_time_sec();
+    benchmark_start(mpctx);
     mpctx->error_playing = 0;
     mpctx->in_playloop = true;
     while (!mpctx->stop_play)
@@ -1380,6 +1605,8 @@ reopen_file:
 
 terminate_playback:
 
+    benchmark_finish(mpctx);
+
     update_core_idle_state(mpctx);
 
     process_unload_hooks(mpctx);
@@ -1395,6 +1622,7 @@ terminate_playback:
 
     mp_abort_playback_async(mpctx);
 
+    thumbnails_stop(mpctx);
     close_recorder(mpctx);
 
     // time to uninit all, except global stuff:
@@ -1574,7 +1802,7 @@ static void set_track_recorder_sink(struct track *track,
     if (track->d_sub)
         sub_set_recorder_sink(track->d_sub, sink);
     if (track->d_video)
-        track->d_video->recorder_sink = sink;
+        video_set_recorder_sink(track->d_video, sink);
     if (track->d_audio)
         track->d_audio->recorder_sink = sink;
     track->remux_sink = sink;
@@ -16,6 +16,7 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <sys/types.h>
@@ -28,6 +29,9 @@
 #include <lualib.h>
 #include <lauxlib.h>
 
+#include <libavutil/md5.h>
+
+
 #include "osdep/io.h"
 
 #include "mpv_talloc.h"
@@ -36,7 +40,10 @@
 #include "options/m_property.h"
 #include "common/msg.h"
 #include "common/msg_control.h"
+#include "common/stats.h"
 #include "options/m_option.h"
+#include "options/m_config.h"
+#include "options/options.h"
 #include "input/input.h"
 #include "options/path.h"
 #include "misc/bstr.h"
@@ -83,6 +90,7 @@ struct script_ctx {
     struct mp_log *log;
     struct mpv_handle *client;
     struct MPContext *mpctx;
+    struct mp_subprocess_group *subprocess_group;
 };
 
 #if LUA_VERSION_NUM <= 501
@@ -190,13 +198,115 @@ static int check_error(lua_State *L, int err)
 
 static void add_functions(struct script_ctx *ctx);
 
+static int write_bytecode(lua_State *L, const void *p, size_t sz, void *ud)
+{
+    return fwrite(p, sz, 1, ud) == 1 ? 0 : 1;
+}
+
+static int hash_bytecode(lua_State *L, const void *p, size_t sz, void *ud)
+{
+    av_md5_update(ud, p, sz);
+    return 0;
+}
+
+// Bytecode differs between Lua versions and builds (e.g. LuaJIT). The header
+// of a dumped empty chunk captures all of that, so it's part of the key.
+static void hash_lua_build(lua_State *L, struct AVMD5 *md5)
+{
+    if (!luaL_loadbuffer(L, "", 0, "="))
+        lua_dump(L, hash_bytecode, md5);
+    lua_pop(L, 1);
+}
+
+static char *bytecode_cache_path(void *ta_ctx, lua_State *L, const char *dir,
+                                 const char *src, size_t len,
+                                 const char *chunkname)
+{
+    struct AVMD5 *md5 = av_md5_alloc();
+    if (!md5)
+        return NULL;
+    av_md5_init(md5);
+    hash_lua_build(L, md5);
+    av_md5_update(md5, chunkname, strlen(chunkname) + 1);
+    av_md5_update(md5, src, len);
+    uint8_t sum[16];
+    av_md5_final(md5, sum);
+    av_free(md5);
+
+    char name[40];
+    for (int i = 0; i < 16; i++)
+        snprintf(name + i * 2, 3, "%02X", sum[i]);
+    strcat(name, ".luac");
+    return mp_path_join(ta_ctx, dir, name);
+}
+
+// Like luaL_loadbuffer(), but use the --lua-bytecode-cache if enabled.
+static int load_buffer_cached(lua_State *L, const char *src, size_t len,
+                              const char *chunkname)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    void *tmp = talloc_new(NULL);
+    struct MPOpts *opts = mp_get_config_group(tmp, ctx->mpctx->global, NULL);
+    char *dir = opts->lua_bytecode_cache && opts->lua_bytecode_cache[0]
+        ? mp_get_user_path(tmp, ctx->mpctx->global, opts->lua_bytecode_cache)
+        : NULL;
+    char *path = dir ? bytecode_cache_path(tmp, L, dir, src, len, chunkname)
+                     : NULL;
+
+    if (path && mp_path_exists(path)) {
+        bstr bc = stream_read_file(path, tmp, ctx->mpctx->global, 64 << 20);
+        if (bc.len) {
+            if (!luaL_loadbuffer(L, bc.start, bc.len, chunkname)) {
+                MP_DBG(ctx, "loaded %s from %s\n", chunkname, path);
+                talloc_free(tmp);
+                return 0;
+            }
+            MP_WARN(ctx, "ignoring broken bytecode cache entry %s\n", path);
+            lua_pop(L, 1);
+        }
+    }
+
+    int r = luaL_loadbuffer(L, src, len, chunkname);
+    if (!r && path) {
+        // Scripts load in parallel, so write a private file and rename it.
+        mp_mkdirp(dir);
+        char *tmp_path = talloc_asprintf(tmp, "%s.%p.tmp", path, (void *)ctx);
+        FILE *f = fopen(tmp_path, "wb");
+        if (f) {
+            bool ok = !lua_dump(L, write_bytecode, f);
+            ok &= fclose(f) == 0;
+            if (!ok || rename(tmp_path, path) < 0) {
+                MP_WARN(ctx, "could not write %s\n", path);
+                unlink(tmp_path);
+            }
+        }
+    }
+
+    talloc_free(tmp);
+    return r;
+}
+
 static void load_file(lua_State *L, const char *fname)
 {
     struct script_ctx *ctx = get_ctx(L);
     MP_DBG(ctx, "loading file %s\n", fname);
-    int r = luaL_loadfile(L, fname);
-    if (r)
+    void *tmp = talloc_new(NULL);
+    bstr src = stream_read_file(fname, tmp, ctx->mpctx->global, 64 << 20);
+    if (!src.start) {
+        talloc_free(tmp);
+        luaL_error(L, "cannot read %s", fname);
+    }
+    // Skip a "#!" line like luaL_loadfile(), but keep the line numbering.
+    if (bstr_startswith0(src, "#")) {
+        int nl = bstrchr(src, '\n');
+        src = bstr_cut(src, nl < 0 ? src.len : nl);
+    }
+    char *chunkname = talloc_asprintf(tmp, "@%s", fname);
+    if (load_buffer_cached(L, src.start, src.len, chunkname)) {
+        talloc_free(tmp);
         lua_error(L);
+    }
+    talloc_free(tmp);
     lua_call(L, 0, 0);
 }
 
@@ -208,7 +318,7 @@ static int load_builtin(lua_State *L)
     for (int n = 0; builtin_lua_scripts[n][0]; n++) {
         if (strcmp(name, builtin_lua_scripts[n][0]) == 0) {
             const char *script = builtin_lua_scripts[n][1];
-            if (luaL_loadbuffer(L, script, strlen(script), dispname))
+            if (load_buffer_cached(L, script, strlen(script), dispname))
                 lua_error(L);
             lua_call(L, 0, 1);
             return 1;
@@ -358,6 +468,31 @@ static int run_lua(lua_State *L)
     return 0;
 }
 
+// Like the lauxlib default allocator, but with memory accounting.
+static void *mp_lua_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    if (!ptr)
+        osize = 0; // Lua 5.2 passes the object type instead
+    if (nsize == 0) {
+        free(ptr);
+        mp_mem_account(MP_MEM_SCRIPTS, -(int64_t)osize);
+        return NULL;
+    }
+    void *res = realloc(ptr, nsize);
+    if (res)
+        mp_mem_account(MP_MEM_SCRIPTS, (int64_t)nsize - (int64_t)osize);
+    return res;
+}
+
+static int mp_lua_panic(lua_State *L)
+{
+    struct script_ctx *ctx;
+    lua_getallocf(L, (void **)&ctx);
+    const char *e = lua_tostring(L, -1);
+    MP_FATAL(ctx, "Lua panic: %s\n", e ? e : "(unknown)");
+    return 0;
+}
+
 static int load_lua(struct mpv_handle *client, const char *fname)
 {
     struct MPContext *mpctx = mp_client_get_core(client);
@@ -377,11 +512,12 @@ static int load_lua(struct mpv_handle *client, const char *fname)
         goto error_out;
     }
 
-    lua_State *L = ctx->state = luaL_newstate();
+    lua_State *L = ctx->state = lua_newstate(mp_lua_alloc, ctx);
     if (!L) {
         MP_FATAL(ctx, "Could not initialize Lua.\n");
         goto error_out;
     }
+    lua_atpanic(L, mp_lua_panic);
 
     if (mp_cpcall(L, run_lua, ctx)) {
         const char *err = "unknown error";
@@ -394,6 +530,7 @@ static int load_lua(struct mpv_handle *client, const char *fname)
     r = 0;
 
 error_out:
+    mp_subprocess_group_destroy(ctx->subprocess_group);
     if (ctx->state)
         lua_close(ctx->state);
     talloc_free(ctx);
@@ -467,12 +604,28 @@ static int script_resume_all(lua_State *L)
 
 static void pushnode(lua_State *L, mpv_node *node);
 
-static int script_wait_event(lua_State *L)
+static void push_property_data(lua_State *L, mpv_event_property *prop)
 {
-    struct script_ctx *ctx = get_ctx(L);
-
-    mpv_event *event = mpv_wait_event(ctx->client, luaL_optnumber(L, 1, 1e20));
+    switch (prop->format) {
+    case MPV_FORMAT_NODE:
+        pushnode(L, prop->data);
+        break;
+    case MPV_FORMAT_DOUBLE:
+        lua_pushnumber(L, *(double *)prop->data);
+        break;
+    case MPV_FORMAT_FLAG:
+        lua_pushboolean(L, *(int *)prop->data);
+        break;
+    case MPV_FORMAT_STRING:
+        lua_pushstring(L, *(char **)prop->data);
+        break;
+    default:
+        lua_pushnil(L);
+    }
+}
 
+static void push_event(lua_State *L, mpv_event *event)
+{
     lua_newtable(L); // event
     lua_pushstring(L, mpv_event_name(event->event_id)); // event name
     lua_setfield(L, -2, "event"); // event
@@ -536,29 +689,43 @@ static int script_wait_event(lua_State *L)
         mpv_event_property *prop = event->data;
         lua_pushstring(L, prop->name);
         lua_setfield(L, -2, "name");
-        switch (prop->format) {
-        case MPV_FORMAT_NODE:
-            pushnode(L, prop->data);
-            break;
-        case MPV_FORMAT_DOUBLE:
-            lua_pushnumber(L, *(double *)prop->data);
-            break;
-        case MPV_FORMAT_FLAG:
-            lua_pushboolean(L, *(int *)prop->data);
-            break;
-        case MPV_FORMAT_STRING:
-            lua_pushstring(L, *(char **)prop->data);
-            break;
-        default:
-            lua_pushnil(L);
-        }
+        push_property_data(L, prop);
         lua_setfield(L, -2, "data");
         break;
     }
     default: ;
     }
+}
 
-    // return event
+static int script_wait_event(lua_State *L)
+{
+    struct script_ctx *ctx = get_ctx(L);
+
+    mpv_event *event = mpv_wait_event(ctx->client, luaL_optnumber(L, 1, 1e20));
+
+    push_event(L, event);
+    return 1;
+}
+
+// Like wait_event, but return property changes as the values
+// "property-change", id, name, data instead of an event table. The event loop
+// uses this, so that observed properties don't create a table per change.
+static int script_raw_wait_event(lua_State *L)
+{
+    struct script_ctx *ctx = get_ctx(L);
+
+    mpv_event *event = mpv_wait_event(ctx->client, luaL_optnumber(L, 1, 1e20));
+
+    if (event->event_id == MPV_EVENT_PROPERTY_CHANGE && event->error >= 0) {
+        mpv_event_property *prop = event->data;
+        lua_pushstring(L, mpv_event_name(event->event_id));
+        lua_pushnumber(L, event->reply_userdata);
+        lua_pushstring(L, prop->name);
+        push_property_data(L, prop);
+        return 4;
+    }
+
+    push_event(L, event);
     return 1;
 }
 
@@ -966,9 +1133,11 @@ static int script_set_osd_ass(lua_State *L)
     int res_x = luaL_checkinteger(L, 1);
     int res_y = luaL_checkinteger(L, 2);
     const char *text = luaL_checkstring(L, 3);
+    int layer = luaL_optinteger(L, 4, 0);
     if (!text[0])
         text = " "; // force external OSD initialization
-    osd_set_external(ctx->mpctx->osd, ctx->client, res_x, res_y, (char *)text);
+    osd_set_external(ctx->mpctx->osd, ctx->client, layer, res_x, res_y,
+                     (char *)text);
     mp_wakeup_core(ctx->mpctx);
     return 0;
 }
@@ -1252,6 +1421,93 @@ static int script_subprocess_detached(lua_State *L)
     return 1;
 }
 
+static void wakeup_client(void *p)
+{
+    mpv_wakeup(p);
+}
+
+// All async subprocesses of a script share one thread, which reads their
+// output. Events are fetched with raw_subprocess_async_read().
+static int script_raw_subprocess_async(lua_State *L)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    luaL_checktype(L, 1, LUA_TTABLE);
+    void *tmp = mp_lua_PITA(L);
+
+    lua_getfield(L, 1, "args"); // args
+    int num_args = mp_lua_len(L, -1);
+    char *args[256];
+    if (num_args > MP_ARRAY_SIZE(args) - 1) // last needs to be NULL
+        luaL_error(L, "too many arguments");
+    if (num_args < 1)
+        luaL_error(L, "program name missing");
+    for (int n = 0; n < num_args; n++) {
+        lua_pushinteger(L, n + 1); // args n
+        lua_gettable(L, -2); // args arg
+        args[n] = talloc_strdup(tmp, lua_tostring(L, -1));
+        if (!args[n])
+            luaL_error(L, "program arguments must be strings");
+        lua_pop(L, 1); // args
+    }
+    args[num_args] = NULL;
+    lua_pop(L, 1); // -
+
+    if (!ctx->subprocess_group) {
+        ctx->subprocess_group =
+            mp_subprocess_group_create(wakeup_client, ctx->client);
+    }
+    if (!ctx->subprocess_group) {
+        lua_pushnil(L);
+        lua_pushstring(L, "unsupported");
+        return 2;
+    }
+
+    lua_pushnumber(L, mp_subprocess_group_start(ctx->subprocess_group, args));
+    return 1;
+}
+
+// Return the next event as: id, "stdout"/"stderr", data
+//                       or: id, "exit", status, error
+// Returns nothing if there are no events.
+static int script_raw_subprocess_async_read(lua_State *L)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    struct mp_subprocess_event ev;
+    if (!ctx->subprocess_group ||
+        !mp_subprocess_group_read(ctx->subprocess_group, NULL, &ev))
+        return 0;
+
+    lua_pushnumber(L, ev.id);
+    switch (ev.type) {
+    case MP_SUBPROCESS_EVENT_STDOUT:
+    case MP_SUBPROCESS_EVENT_STDERR:
+        lua_pushstring(L, ev.type == MP_SUBPROCESS_EVENT_STDOUT
+                          ? "stdout" : "stderr");
+        lua_pushlstring(L, ev.data, ev.size);
+        talloc_free(ev.data);
+        return 3;
+    case MP_SUBPROCESS_EVENT_EXIT:
+        lua_pushstring(L, "exit");
+        lua_pushinteger(L, ev.status);
+        if (ev.error) {
+            lua_pushstring(L, ev.error);
+        } else {
+            lua_pushnil(L);
+        }
+        return 4;
+    }
+    return 0;
+}
+
+static int script_raw_subprocess_async_kill(lua_State *L)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    int64_t id = luaL_checknumber(L, 1);
+    if (ctx->subprocess_group)
+        mp_subprocess_group_kill(ctx->subprocess_group, id);
+    return 0;
+}
+
 static int script_parse_json(lua_State *L)
 {
     mp_lua_optarg(L, 2);
@@ -1305,6 +1561,10 @@ static const struct fn_entry main_fns[] = {
     FN_ENTRY(resume),
     FN_ENTRY(resume_all),
     FN_ENTRY(wait_event),
+    FN_ENTRY(raw_wait_event),
+    FN_ENTRY(raw_subprocess_async),
+    FN_ENTRY(raw_subprocess_async_read),
+    FN_ENTRY(raw_subprocess_async_kill),
     FN_ENTRY(request_event),
     FN_ENTRY(find_config_file),
     FN_ENTRY(command),
@@ -412,6 +412,23 @@ mp.register_event("shutdown", function() mp.keep_running = false end)
 mp.register_event("client-message", message_dispatch)
 mp.register_event("property-change", property_change)
 
+-- Fast path for the event loop: property changes arrive as plain values, and
+-- an event table is created only if someone registered for the raw event.
+local function dispatch_property_change(id, name, data)
+    local handlers = event_handlers["property-change"]
+    if handlers and (#handlers > 1 or handlers[1] ~= property_change) then
+        local e = {event = "property-change", id = id, name = name, data = data}
+        for _, handler in ipairs(handlers) do
+            handler(e)
+        end
+        return
+    end
+    local prop = properties[id]
+    if prop then
+        prop(name, data)
+    end
+end
+
 -- called before the event loop goes back to sleep
 local idle_handlers = {}
 
@@ -461,6 +478,65 @@ local function call_event_handlers(e)
     end
 end
 
+-- async subprocesses, indexed by ID
+local async_subprocesses = {}
+local num_async_subprocesses = 0
+
+local function process_subprocess_events()
+    while true do
+        local id, what, data, err = mp.raw_subprocess_async_read()
+        if not id then
+            return
+        end
+        local p = async_subprocesses[id]
+        if p and what == "stdout" then
+            if p.t.on_stdout then
+                p.t.on_stdout(data)
+            elseif p.size < p.max_size then
+                p.stdout[#p.stdout + 1] = data
+                p.size = p.size + #data
+            end
+        elseif p and what == "stderr" then
+            if p.t.on_stderr then
+                p.t.on_stderr(data)
+            else
+                mp.msg.info((data:gsub("\n$", "")))
+            end
+        elseif p and what == "exit" then
+            async_subprocesses[id] = nil
+            num_async_subprocesses = num_async_subprocesses - 1
+            if p.cb then
+                p.cb({
+                    status = data,
+                    stdout = table.concat(p.stdout):sub(1, p.max_size),
+                    error = err,
+                    killed_by_us = data == -2,
+                })
+            end
+        end
+    end
+end
+
+local function subprocess_async(t, cb)
+    local id, err = mp.raw_subprocess_async(t)
+    if not id then
+        return nil, err
+    end
+    async_subprocesses[id] = {
+        t = t,
+        cb = cb,
+        stdout = {},
+        size = 0,
+        max_size = t.max_size or 64 * 1024 * 1024,
+    }
+    num_async_subprocesses = num_async_subprocesses + 1
+    return id
+end
+
+local function subprocess_async_kill(id)
+    mp.raw_subprocess_async_kill(id)
+end
+
 mp.use_suspend = false
 
 local suspend_warned = false
@@ -490,9 +566,15 @@ function mp.dispatch_events(allow_wait)
                 return
             end
         end
-        local e = mp.wait_event(wait)
+        local e, id, name, data = mp.raw_wait_event(wait)
         more_events = false
-        if e.event ~= "none" then
+        if num_async_subprocesses > 0 then
+            process_subprocess_events()
+        end
+        if e == "property-change" then
+            dispatch_property_change(id, name, data)
+            more_events = true
+        elseif e.event ~= "none" then
             call_event_handlers(e)
             more_events = true
         end
@@ -533,6 +615,9 @@ end
 
 local mp_utils = package.loaded["mp.utils"]
 
+mp_utils.subprocess_async = subprocess_async
+mp_utils.subprocess_async_kill = subprocess_async_kill
+
 function mp_utils.format_table(t, set)
     if not set then
         set = { [t] = true }
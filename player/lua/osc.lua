@@ -41,6 +41,8 @@ local user_opts = {
     timetotal = false,          -- display total time instead of remaining time?
     timems = false,             -- display timecodes with milliseconds?
     seekranges = true,          -- display seek ranges?
+    thumbnails = true,          -- show --thumbnail-count previews on the
+                                -- seekbar tooltip, if available
     visibility = "auto",        -- only used at init to set visibility_mode(...)
     boxmaxchars = 80,           -- title crop threshold for box layout
 }
@@ -132,6 +134,43 @@ function get_virt_mouse_pos()
     return x * sx, y * sy
 end
 
+-- seekbar thumbnail preview, shown with the overlay-thumbnail command
+local thumbnail_overlay_id = 63
+local thumbnail_shown = nil   -- last arguments sent, to skip redundant updates
+
+function show_thumbnail(pos, tx, ty)
+    local info = mp.get_property_native("thumbnails")
+    local duration = mp.get_property_number("duration")
+    if not info or info.ready == 0 or not duration then
+        hide_thumbnail()
+        return false
+    end
+    -- place it centered above the tooltip, in real OSD coordinates
+    local sx, sy = get_virt_scale_factor()
+    local osd_w = mp.get_osd_size()
+    local x = math.floor(tx / sx - info.width / 2)
+    x = math.max(0, math.min(x, osd_w - info.width))
+    local y = math.floor(ty / sy - info.height - 30)
+    if y < 0 then   -- topbar: put it below instead
+        y = math.floor(ty / sy + 30)
+    end
+    local slot = math.floor(pos / 100 * info.count)
+    local key = slot .. ":" .. info.ready .. ":" .. x .. ":" .. y
+    if thumbnail_shown ~= key then
+        mp.commandv("overlay-thumbnail", thumbnail_overlay_id,
+                    duration * pos / 100, x, y)
+        thumbnail_shown = key
+    end
+    return true
+end
+
+function hide_thumbnail()
+    if thumbnail_shown then
+        mp.commandv("overlay-remove", thumbnail_overlay_id)
+        thumbnail_shown = nil
+    end
+end
+
 function set_virt_mouse_area(x0, y0, x1, y1, name)
     local sx, sy = get_virt_scale_factor()
     mp.set_mouse_area(x0 / sx, y0 / sy, x1 / sx, y1 / sy, name)
@@ -503,7 +542,12 @@ end
 -- Element Rendering
 --
 
-function render_elements(master_ass)
+-- Elements whose content changes during playback (sliders, and buttons with
+-- function content, like the time codes) go to dynamic_ass, which is sent as
+-- a separate OSD layer. The rest only needs to be re-rendered by libass when
+-- the layout, alpha or mouse state changes.
+function render_elements(master_ass, dynamic_ass)
+    local thumbnail_visible = false
 
     for n=1, #elements do
         local element = elements[n]
@@ -662,6 +706,9 @@ function render_elements(master_ass)
 
                     elem_ass:append(tooltiplabel)
 
+                    if element.thumbnails then
+                        thumbnail_visible = show_thumbnail(sliderpos, tx, ty)
+                    end
                 end
             end
 
@@ -693,7 +740,16 @@ function render_elements(master_ass)
             elem_ass:append(buttontext)
         end
 
-        master_ass:merge(elem_ass)
+        if dynamic_ass and ((element.type == "slider") or
+            (type(element.content) == "function")) then
+            dynamic_ass:merge(elem_ass)
+        else
+            master_ass:merge(elem_ass)
+        end
+    end
+
+    if not thumbnail_visible then
+        hide_thumbnail()
     end
 end
 
@@ -1735,6 +1791,7 @@ function osc_init()
     ne = new_element("seekbar", "slider")
 
     ne.enabled = not (mp.get_property("percent-pos") == nil)
+    ne.thumbnails = user_opts.thumbnails
     ne.slider.markerF = function ()
         local duration = mp.get_property_number("duration", nil)
         if not (duration == nil) then
@@ -2002,6 +2059,8 @@ end
 function render_wipe()
     msg.trace("render_wipe()")
     mp.set_osd_ass(0, 0, "{}")
+    mp.set_osd_ass(0, 0, "{}", 1)
+    hide_thumbnail()
 end
 
 function render()
@@ -2106,18 +2165,20 @@ function render()
 
     -- actual rendering
     local ass = assdraw.ass_new()
+    local dynamic_ass = assdraw.ass_new()
 
     -- Messages
-    render_message(ass)
+    render_message(dynamic_ass)
 
     -- actual OSC
     if state.osc_visible then
-        render_elements(ass)
+        render_elements(ass, dynamic_ass)
     end
 
     -- submit
-    mp.set_osd_ass(osc_param.playresy * osc_param.display_aspect,
-                   osc_param.playresy, ass.text)
+    local res_x = osc_param.playresy * osc_param.display_aspect
+    mp.set_osd_ass(res_x, osc_param.playresy, ass.text)
+    mp.set_osd_ass(res_x, osc_param.playresy, dynamic_ass.text, 1)
 
 
 
@@ -2235,6 +2296,7 @@ function tick()
         ass:an(8)
         ass:append("Drop files or URLs to play here.")
         mp.set_osd_ass(640, 360, ass.text)
+        mp.set_osd_ass(640, 360, "", 1)
 
         if state.showhide_enabled then
             mp.disable_key_bindings("showhide")
@@ -2250,6 +2312,7 @@ function tick()
     else
         -- Flush OSD
         mp.set_osd_ass(osc_param.playresy, osc_param.playresy, "")
+        mp.set_osd_ass(osc_param.playresy, osc_param.playresy, "", 1)
     end
 end
 
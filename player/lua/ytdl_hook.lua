@@ -4,7 +4,9 @@ local options = require 'mp.options'
 
 local o = {
     exclude = "",
-    try_ytdl_first = false
+    try_ytdl_first = false,
+    cache_expiry = 600,
+    resolve_next = false,
 }
 options.read_options(o)
 
@@ -16,11 +18,55 @@ local ytdl = {
 
 local chapter_list = {}
 
+-- youtube-dl results, keyed by the full command line
+local result_cache = {}
+local result_cache_max = 50
+
 local function exec(args)
     local ret = utils.subprocess({args = args})
     return ret.status, ret.stdout, ret
 end
 
+local function prune_result_cache()
+    local now = mp.get_time()
+    local count = 0
+    for key, entry in pairs(result_cache) do
+        if now - entry.time > o.cache_expiry then
+            result_cache[key] = nil
+        else
+            count = count + 1
+        end
+    end
+    -- drop the oldest entries if it's still too big
+    while count > result_cache_max do
+        local oldest
+        for key, entry in pairs(result_cache) do
+            if not oldest or entry.time < result_cache[oldest].time then
+                oldest = key
+            end
+        end
+        result_cache[oldest] = nil
+        count = count - 1
+    end
+end
+
+-- Like exec(), but reuse successful results of the same command for
+-- o.cache_expiry seconds.
+local function exec_cached(args)
+    local key = table.concat(args, "\0")
+    local entry = result_cache[key]
+    if entry and mp.get_time() - entry.time <= o.cache_expiry then
+        msg.verbose("using cached youtube-dl result")
+        return 0, entry.json, {status = 0, stdout = entry.json}
+    end
+    local es, json, result = exec(args)
+    if o.cache_expiry > 0 and es >= 0 and json and json ~= "" then
+        result_cache[key] = {json = json, time = mp.get_time()}
+        prune_result_cache()
+    end
+    return es, json, result
+end
+
 -- return true if it was explicitly set on the command line
 local function option_was_set(name)
     return mp.get_property_bool("option-info/" ..name.. "/set-from-commandline",
@@ -345,69 +391,84 @@ local function add_single_video(json)
     end
 end
 
-mp.add_hook(o.try_ytdl_first and "on_load" or "on_load_fail", 10, function ()
-    local url = mp.get_property("stream-open-filename")
-    local start_time = os.clock()
-    if (url:find("ytdl://") == 1) or
-        ((url:find("https?://") == 1) and not is_blacklisted(url)) then
-
-        -- check for youtube-dl in mpv's config dir
-        if not (ytdl.searched) then
-            local exesuf = (package.config:sub(1,1) == '\\') and '.exe' or ''
-            local ytdl_mcd = mp.find_config_file("youtube-dl" .. exesuf)
-            if not (ytdl_mcd == nil) then
-                msg.verbose("found youtube-dl at: " .. ytdl_mcd)
-                ytdl.path = ytdl_mcd
-            end
-            ytdl.searched = true
-        end
+local function wants_ytdl(url)
+    return (url:find("ytdl://") == 1) or
+        ((url:find("https?://") == 1) and not is_blacklisted(url))
+end
 
-        -- strip ytdl://
-        if (url:find("ytdl://") == 1) then
-            url = url:sub(8)
+local function build_command(url)
+    -- check for youtube-dl in mpv's config dir
+    if not (ytdl.searched) then
+        local exesuf = (package.config:sub(1,1) == '\\') and '.exe' or ''
+        local ytdl_mcd = mp.find_config_file("youtube-dl" .. exesuf)
+        if not (ytdl_mcd == nil) then
+            msg.verbose("found youtube-dl at: " .. ytdl_mcd)
+            ytdl.path = ytdl_mcd
         end
+        ytdl.searched = true
+    end
 
-        local format = mp.get_property("options/ytdl-format")
-        local raw_options = mp.get_property_native("options/ytdl-raw-options")
-        local allsubs = true
+    -- strip ytdl://
+    if (url:find("ytdl://") == 1) then
+        url = url:sub(8)
+    end
 
-        local command = {
-            ytdl.path, "--no-warnings", "-J", "--flat-playlist",
-            "--sub-format", "ass/srt/best", "--no-playlist"
-        }
+    local format = mp.get_property("options/ytdl-format")
+    local raw_options = mp.get_property_native("options/ytdl-raw-options")
+    local allsubs = true
 
-        -- Checks if video option is "no", change format accordingly,
-        -- but only if user didn't explicitly set one
-        if (mp.get_property("options/vid") == "no")
-            and not option_was_set("ytdl-format") then
+    local command = {
+        ytdl.path, "--no-warnings", "-J", "--flat-playlist",
+        "--sub-format", "ass/srt/best", "--no-playlist"
+    }
 
-            format = "bestaudio/best"
-            msg.verbose("Video disabled. Only using audio")
-        end
+    -- Checks if video option is "no", change format accordingly,
+    -- but only if user didn't explicitly set one
+    if (mp.get_property("options/vid") == "no")
+        and not option_was_set("ytdl-format") then
 
-        if (format == "") then
-            format = "bestvideo+bestaudio/best"
-        end
-        table.insert(command, "--format")
-        table.insert(command, format)
+        format = "bestaudio/best"
+        msg.verbose("Video disabled. Only using audio")
+    end
 
-        for param, arg in pairs(raw_options) do
-            table.insert(command, "--" .. param)
-            if (arg ~= "") then
-                table.insert(command, arg)
-            end
-            if (param == "sub-lang") and (arg ~= "") then
-                allsubs = false
-            end
-        end
+    if (format == "") then
+        format = "bestvideo+bestaudio/best"
+    end
+    table.insert(command, "--format")
+    table.insert(command, format)
 
-        if (allsubs == true) then
-            table.insert(command, "--all-subs")
+    -- (sorted, so that the same options always give the same cache key)
+    local params = {}
+    for param, _ in pairs(raw_options) do
+        table.insert(params, param)
+    end
+    table.sort(params)
+    for _, param in ipairs(params) do
+        local arg = raw_options[param]
+        table.insert(command, "--" .. param)
+        if (arg ~= "") then
+            table.insert(command, arg)
+        end
+        if (param == "sub-lang") and (arg ~= "") then
+            allsubs = false
         end
-        table.insert(command, "--")
-        table.insert(command, url)
+    end
+
+    if (allsubs == true) then
+        table.insert(command, "--all-subs")
+    end
+    table.insert(command, "--")
+    table.insert(command, url)
+    return command
+end
+
+mp.add_hook(o.try_ytdl_first and "on_load" or "on_load_fail", 10, function ()
+    local url = mp.get_property("stream-open-filename")
+    local start_time = os.clock()
+    if wants_ytdl(url) then
+        local command = build_command(url)
         msg.debug("Running: " .. table.concat(command,' '))
-        local es, json, result = exec(command)
+        local es, json, result = exec_cached(command)
 
         if (es < 0) or (json == nil) or (json == "") then
             local err = "youtube-dl failed: "
@@ -544,6 +605,31 @@ mp.add_hook(o.try_ytdl_first and "on_load" or "on_load_fail", 10, function ()
 end)
 
 
+-- Resolve the next playlist entry while the current one plays, so that the
+-- hook finds the result in the cache. This blocks only this script.
+local function resolve_next()
+    local pos = mp.get_property_number("playlist-pos", -1)
+    if pos < 0 then
+        return
+    end
+    local url = mp.get_property("playlist/" .. (pos + 1) .. "/filename")
+    if not url then
+        return
+    end
+    -- without try_ytdl_first, http URLs are only passed to youtube-dl if
+    -- mpv can't open them
+    if not ((url:find("ytdl://") == 1) or (o.try_ytdl_first and wants_ytdl(url))) then
+        return
+    end
+    local command = build_command(url)
+    msg.verbose("Resolving next playlist entry: " .. url)
+    exec_cached(command)
+end
+
+if o.resolve_next and o.cache_expiry > 0 then
+    mp.register_event("file-loaded", resolve_next)
+end
+
 mp.add_hook("on_preloaded", 10, function ()
     if next(chapter_list) ~= nil then
         msg.verbose("Setting chapters")
@@ -42,6 +42,7 @@
 #include "common/msg.h"
 #include "common/msg_control.h"
 #include "common/global.h"
+#include "common/stats.h"
 #include "options/parse_configfile.h"
 #include "options/parse_commandline.h"
 #include "common/playlist.h"
@@ -55,7 +56,10 @@
 #include "stream/stream.h"
 #include "sub/osd.h"
 #include "video/decode/dec_video.h"
+#include "video/out/dither.h"
+#include "video/out/filter_kernels.h"
 #include "video/out/vo.h"
+#include "video/sws_utils.h"
 
 #include "core.h"
 #include "client.h"
@@ -200,11 +204,20 @@ void mp_destroy(struct MPContext *mpctx)
 
     mp_input_uninit(mpctx->input);
 
+    mp_image_swscale_flush_cache();
+    mp_compute_lut_flush_cache();
+    mp_dither_flush_cache();
+
     uninit_libav(mpctx->global);
 
     if (mpctx->autodetach)
         pthread_detach(pthread_self());
 
+    if (mpctx->perf_stats_file)
+        fclose(mpctx->perf_stats_file);
+    talloc_free(mpctx->perf_stats_path);
+    close_trace_file(mpctx);
+    stats_global_uninit(mpctx->global);
     mp_msg_uninit(mpctx->global);
     pthread_mutex_destroy(&mpctx->lock);
     talloc_free(mpctx);
@@ -333,6 +346,9 @@ struct MPContext *mp_create(void)
 
     // Nothing must call mp_msg*() and related before this
     mp_msg_init(mpctx->global);
+    stats_global_init(mpctx->global);
+    mp_dispatch_set_stats(mpctx->dispatch,
+                          stats_ctx_create(mpctx, mpctx->global, "main"));
     mpctx->log = mp_log_new(mpctx, mpctx->global->log, "!cplayer");
     mpctx->statusline = mp_log_new(mpctx, mpctx->log, "!statusline");
 
@@ -161,7 +161,8 @@ static char *get_term_status_msg(struct MPContext *mpctx)
     struct MPOpts *opts = mpctx->opts;
 
     if (opts->status_msg)
-        return mp_property_expand_escaped_string(mpctx, opts->status_msg);
+        return mp_property_expand_cached(mpctx, &mpctx->term_status_tmpl,
+                                         opts->status_msg);
 
     char *line = NULL;
 
@@ -423,7 +424,8 @@ static void sadd_osd_status(char **buffer, struct MPContext *mpctx, int level)
     char *msg = mpctx->opts->osd_msg[level - 1];
 
     if (msg && msg[0]) {
-        char *text = mp_property_expand_escaped_string(mpctx, msg);
+        char *text = mp_property_expand_cached(mpctx,
+                                &mpctx->osd_msg_tmpl[level - 1], msg);
         *buffer = talloc_strdup_append(*buffer, text);
         talloc_free(text);
     } else if (level >= 2) {
@@ -433,7 +435,8 @@ static void sadd_osd_status(char **buffer, struct MPContext *mpctx, int level)
         saddf(buffer, "%s ", sym);
         char *custom_msg = mpctx->opts->osd_status_msg;
         if (custom_msg && level == 3) {
-            char *text = mp_property_expand_escaped_string(mpctx, custom_msg);
+            char *text = mp_property_expand_cached(mpctx,
+                                    &mpctx->osd_status_tmpl, custom_msg);
             *buffer = talloc_strdup_append(*buffer, text);
             talloc_free(text);
         } else {
@@ -17,11 +17,17 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 #include <math.h>
 #include <assert.h>
 
 #include "config.h"
+
+#if HAVE_POSIX
+#include <sys/resource.h>
+#endif
 #include "mpv_talloc.h"
 
 #include "common/msg.h"
@@ -29,12 +35,16 @@
 #include "common/common.h"
 #include "common/encode.h"
 #include "common/recorder.h"
+#include "common/stats.h"
 #include "options/m_config.h"
 #include "options/m_property.h"
+#include "options/path.h"
 #include "common/playlist.h"
 #include "input/input.h"
 
 #include "misc/dispatch.h"
+#include "misc/json.h"
+#include "misc/node.h"
 #include "osdep/terminal.h"
 #include "osdep/timer.h"
 
@@ -51,20 +61,44 @@
 #include "client.h"
 #include "command.h"
 
+static void count_wakeup(struct MPContext *mpctx, const char *reason)
+{
+    for (int n = 0; n < mpctx->num_wakeup_stats; n++) {
+        struct mp_wakeup_stat *st = &mpctx->wakeup_stats[n];
+        if (st->reason == reason || strcmp(st->reason, reason) == 0) {
+            st->count++;
+            return;
+        }
+    }
+    struct mp_wakeup_stat st = {reason, 1};
+    MP_TARRAY_APPEND(mpctx, mpctx->wakeup_stats, mpctx->num_wakeup_stats, st);
+}
+
 // Wait until mp_wakeup_core() is called, since the last time
 // mp_wait_events() was called.
 void mp_wait_events(struct MPContext *mpctx)
 {
-    bool sleeping = mpctx->sleeptime > 0;
+    double timeout = mpctx->sleeptime;
+    bool sleeping = timeout > 0;
     if (sleeping)
         MP_STATS(mpctx, "start sleep");
 
+    double start = mp_time_sec();
     mpctx->in_dispatch = true;
 
-    mp_dispatch_queue_process(mpctx->dispatch, mpctx->sleeptime);
+    mp_dispatch_queue_process(mpctx->dispatch, timeout);
 
     mpctx->in_dispatch = false;
+
+    // If the timeout elapsed, blame whatever set it; anything else is an
+    // explicit wakeup (e.g. from another thread).
+    const char *reason = "wakeup";
+    if (isfinite(timeout) && mp_time_sec() - start >= timeout)
+        reason = mpctx->sleep_reason ? mpctx->sleep_reason : "timeout";
+    count_wakeup(mpctx, reason);
+
     mpctx->sleeptime = INFINITY;
+    mpctx->sleep_reason = NULL;
 
     if (sleeping)
         MP_STATS(mpctx, "end sleep");
@@ -73,9 +107,15 @@ void mp_wait_events(struct MPContext *mpctx)
 // Set the timeout used when the playloop goes to sleep. This means the
 // playloop will re-run as soon as the timeout elapses (or earlier).
 // mp_set_timeout(c, 0) is essentially equivalent to mp_wakeup_core(c).
-void mp_set_timeout(struct MPContext *mpctx, double sleeptime)
+// Usually called through the mp_set_timeout() macro, which passes the calling
+// function as reason (see playloop-wakeups property).
+void mp_set_timeout_reason(struct MPContext *mpctx, double sleeptime,
+                           const char *reason)
 {
-    mpctx->sleeptime = MPMIN(mpctx->sleeptime, sleeptime);
+    if (sleeptime < mpctx->sleeptime) {
+        mpctx->sleeptime = sleeptime;
+        mpctx->sleep_reason = reason;
+    }
 
     // Can't adjust timeout if called from mp_dispatch_queue_process().
     if (mpctx->in_dispatch && isfinite(sleeptime))
@@ -101,7 +141,12 @@ void mp_wakeup_core_cb(void *ctx)
 // API threads. This also resets the "wakeup" flag used with mp_wait_events().
 void mp_process_input(struct MPContext *mpctx)
 {
-    for (;;) {
+    // Run only the commands that are queued now (plus a possible autorepeat
+    // command). Anything queued while running them, like mouse movement
+    // while a script handles the previous one, wakes up the playloop again
+    // and is run on the next iteration, where it has been coalesced.
+    int num = mp_input_get_num_queued_cmds(mpctx->input) + 1;
+    for (int n = 0; n < num; n++) {
         mp_cmd_t *cmd = mp_input_read_cmd(mpctx->input);
         if (!cmd)
             break;
@@ -136,6 +181,16 @@ void update_core_idle_state(struct MPContext *mpctx)
 }
 
 // The value passed here is the new value for mpctx->opts->pause
+// Decode only keyframes (see --keyframe-scrub).
+static void set_keyframe_scrub(struct MPContext *mpctx, bool enable)
+{
+    mpctx->scrubbing = enable;
+    for (int n = 0; n < mpctx->num_tracks; n++) {
+        if (mpctx->tracks[n]->d_video)
+            video_set_keyframes_only(mpctx->tracks[n]->d_video, enable);
+    }
+}
+
 void set_pause_state(struct MPContext *mpctx, bool user_pause)
 {
     struct MPOpts *opts = mpctx->opts;
@@ -171,6 +226,24 @@ void set_pause_state(struct MPContext *mpctx, bool user_pause)
             mpctx->time_frame -= get_relative_time(mpctx);
         } else {
             (void)get_relative_time(mpctx); // ignore time that passed during pause
+
+            // The frames following the scrub position were never decoded, so
+            // restart decoding from the displayed keyframe.
+            // The decoder is still at the position before the cached frames
+            // were shown (see --frame-back-step-cache).
+            if (mpctx->backstep_cached && !mpctx->seek.type) {
+                queue_seek(mpctx, MPSEEK_ABSOLUTE, mpctx->video_pts,
+                           MPSEEK_VERY_EXACT, 0);
+                mpctx->backstep_cached = false;
+            }
+            if (mpctx->scrubbing && !mpctx->seek.type) {
+                double pts = get_current_time(mpctx);
+                if (pts != MP_NOPTS_VALUE) {
+                    queue_seek(mpctx, MPSEEK_ABSOLUTE, pts, MPSEEK_KEYFRAME, 0);
+                } else {
+                    set_keyframe_scrub(mpctx, false);
+                }
+            }
         }
     }
 
@@ -200,9 +273,25 @@ void add_step_frame(struct MPContext *mpctx, int dir)
     if (!mpctx->vo_chain)
         return;
     if (dir > 0) {
+        if (mpctx->backstep_cached) {
+            if (!video_step_cached(mpctx, 1)) {
+                // Past the end of the cached frames: restart decoding at the
+                // next frame, with the player staying paused.
+                struct mp_image **frames = mpctx->backstep_frames;
+                int num = mpctx->num_backstep_frames;
+                double step = num >= 2 ? frames[num - 1]->pts -
+                                         frames[num - 2]->pts : 0.02;
+                queue_seek(mpctx, MPSEEK_ABSOLUTE, mpctx->video_pts + step / 2,
+                           MPSEEK_VERY_EXACT, 0);
+                mpctx->backstep_cached = false;
+            }
+            return;
+        }
         mpctx->step_frames += 1;
         set_pause_state(mpctx, false);
     } else if (dir < 0) {
+        if (video_step_cached(mpctx, -1))
+            return;
         if (!mpctx->hrseek_active) {
             queue_seek(mpctx, MPSEEK_BACKSTEP, 0, MPSEEK_VERY_EXACT, 0);
             set_pause_state(mpctx, true);
@@ -292,6 +381,10 @@ static void mp_seek(MPContext *mpctx, struct seek_params seek)
                   opts->hr_seek > 0 || seek.exact >= MPSEEK_EXACT) &&
                  seek_pts != MP_NOPTS_VALUE;
 
+    // While paused, keyframe seeks only need to display the keyframe itself.
+    bool scrub = opts->keyframe_scrub && mpctx->paused && !hr_seek &&
+                 seek.exact == MPSEEK_KEYFRAME;
+
     if (seek.type == MPSEEK_FACTOR || seek.amount < 0 ||
         (seek.type == MPSEEK_ABSOLUTE && seek.amount < mpctx->last_chapter_pts))
         mpctx->last_chapter_seek = -2;
@@ -360,6 +453,8 @@ static void mp_seek(MPContext *mpctx, struct seek_params seek)
     if (mpctx->recorder)
         mp_recorder_mark_discontinuity(mpctx->recorder);
 
+    set_keyframe_scrub(mpctx, scrub);
+
     // When doing keyframe seeks (hr_seek=false) backwards (no SEEK_FORWARD),
     // then video can seek before the external audio track (because video seek
     // granularity is coarser than audio). The result would be playing video with
@@ -451,8 +546,12 @@ void execute_queued_seek(struct MPContext *mpctx)
          * try to finish showing a frame from one location before doing
          * another seek (which could lead to unchanging display). */
         bool delay = mpctx->seek.flags & MPSEEK_FLAG_DELAY;
+        // Keyframe-only scrub seeks are cheap, so let a new one supersede a
+        // seek that is still in flight much sooner.
+        double max_delay = mpctx->scrubbing &&
+                           mpctx->seek.exact == MPSEEK_KEYFRAME ? 0.1 : 0.3;
         if (delay && mpctx->video_status < STATUS_PLAYING &&
-            mp_time_sec() - mpctx->start_timestamp < 0.3)
+            mp_time_sec() - mpctx->start_timestamp < max_delay)
             return;
         mp_seek(mpctx, mpctx->seek);
         mpctx->seek = (struct seek_params){0};
@@ -617,6 +716,105 @@ static void handle_osd_redraw(struct MPContext *mpctx)
     vo_redraw(mpctx->video_out);
 }
 
+// Minimum time between switching to a higher bitrate, and to a lower one.
+#define ABR_UP_INTERVAL 10.0
+#define ABR_DOWN_INTERVAL 5.0
+
+// Return the track of the given type that belongs to the variant with the
+// next higher (dir>0) or lower (dir<0) bitrate than the given one.
+static struct track *find_abr_track(struct MPContext *mpctx,
+                                    enum stream_type type, int bitrate, int dir)
+{
+    struct track *best = NULL;
+    for (int n = 0; n < mpctx->num_tracks; n++) {
+        struct track *t = mpctx->tracks[n];
+        if (t->type != type || !t->stream || t->attached_picture ||
+            t->demuxer != mpctx->demuxer || t->stream->hls_bitrate <= 0)
+            continue;
+        int rate = t->stream->hls_bitrate;
+        if (dir > 0 ? rate <= bitrate : rate >= bitrate)
+            continue;
+        if (!best || (dir > 0 ? rate < best->stream->hls_bitrate
+                              : rate > best->stream->hls_bitrate))
+            best = t;
+    }
+    return best;
+}
+
+// Switch HLS variants depending on how much is buffered ahead.
+static void handle_adaptive_bitrate(struct MPContext *mpctx,
+                                    struct demux_ctrl_reader_state *s)
+{
+    struct MPOpts *opts = mpctx->opts;
+
+    if (opts->hls_bitrate != -2 || !mpctx->restart_complete || s->eof)
+        return;
+
+    // Video decides the variant, audio follows if it has matching variants.
+    enum stream_type type = STREAM_VIDEO;
+    struct track *cur = mpctx->current_track[0][type];
+    if (!cur || !cur->stream || cur->stream->hls_bitrate <= 0) {
+        type = STREAM_AUDIO;
+        cur = mpctx->current_track[0][type];
+    }
+    if (!cur || !cur->stream || cur->stream->hls_bitrate <= 0 ||
+        cur->demuxer != mpctx->demuxer)
+    {
+        mpctx->abr_bitrate = 0;
+        return;
+    }
+
+    int bitrate = cur->stream->hls_bitrate;
+    mpctx->abr_bitrate = bitrate;
+
+    double now = mp_time_sec();
+    double since_switch = now - mpctx->abr_last_switch;
+    // An idle demuxer has filled the cache completely.
+    double buffered = s->idle ? INFINITY : s->ts_duration;
+
+    // After a switch, the new variant's buffer starts out (nearly) empty. Don't
+    // mistake that for the connection being too slow.
+    if (buffered >= opts->hls_adaptive_low)
+        mpctx->abr_buffer_ok = true;
+
+    int dir = 0;
+    if ((s->underrun || (mpctx->abr_buffer_ok &&
+                         buffered < opts->hls_adaptive_low)) &&
+        since_switch >= ABR_DOWN_INTERVAL)
+        dir = -1;
+    if (buffered > opts->hls_adaptive_high && since_switch >= ABR_UP_INTERVAL)
+        dir = 1;
+    if (!dir)
+        return;
+
+    struct track *next = find_abr_track(mpctx, type, bitrate, dir);
+    if (!next)
+        return;
+
+    int new_rate = next->stream->hls_bitrate;
+    MP_INFO(mpctx, "Switching to %d bps variant (%.1f secs buffered).\n",
+            new_rate, s->idle ? -1 : s->ts_duration);
+    mpctx->abr_last_switch = now;
+    mpctx->abr_bitrate = new_rate;
+    mpctx->abr_buffer_ok = false;
+    mp_switch_track(mpctx, type, next, 0);
+
+    // Make the other track type follow, if it has the same variant.
+    enum stream_type other = type == STREAM_VIDEO ? STREAM_AUDIO : STREAM_VIDEO;
+    struct track *ocur = mpctx->current_track[0][other];
+    if (ocur && ocur->stream && ocur->stream->hls_bitrate > 0) {
+        for (int n = 0; n < mpctx->num_tracks; n++) {
+            struct track *t = mpctx->tracks[n];
+            if (t->type == other && t->stream && t->demuxer == mpctx->demuxer &&
+                t->stream->hls_bitrate == new_rate && t != ocur)
+            {
+                mp_switch_track(mpctx, other, t, 0);
+                break;
+            }
+        }
+    }
+}
+
 static void handle_pause_on_low_cache(struct MPContext *mpctx)
 {
     bool force_update = false;
@@ -630,7 +828,10 @@ static void handle_pause_on_low_cache(struct MPContext *mpctx)
     demux_stream_control(mpctx->demuxer, STREAM_CTRL_GET_CACHE_INFO, &c);
 
     struct demux_ctrl_reader_state s = {.idle = true, .ts_duration = -1};
-    demux_control(mpctx->demuxer, DEMUXER_CTRL_GET_READER_STATE, &s);
+    bool have_state =
+        demux_control(mpctx->demuxer, DEMUXER_CTRL_GET_READER_STATE, &s) > 0;
+
+    handle_adaptive_bitrate(mpctx, &s);
 
     int cache_buffer = 100;
     bool use_pause_on_low_cache = (c.size > 0 || mpctx->demuxer->is_network) &&
@@ -696,6 +897,8 @@ static void handle_pause_on_low_cache(struct MPContext *mpctx)
 
     if (force_update)
         mp_notify(mpctx, MP_EVENT_CACHE_UPDATE, NULL);
+
+    mp_update_cache_state(mpctx, have_state ? &s : NULL, force_update);
 }
 
 int get_cache_buffering_percentage(struct MPContext *mpctx)
@@ -759,6 +962,237 @@ static void handle_vo_events(struct MPContext *mpctx)
     }
 }
 
+// Append the perf-stats property contents to --perf-stats-file as one JSON
+// object per line, every --perf-stats-interval seconds.
+static void handle_perf_stats(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+    char *path = opts->perf_stats_file && opts->perf_stats_file[0]
+                 ? opts->perf_stats_file : NULL;
+
+    if (!path || !mpctx->perf_stats_path ||
+        strcmp(path, mpctx->perf_stats_path) != 0)
+    {
+        if (mpctx->perf_stats_file)
+            fclose(mpctx->perf_stats_file);
+        mpctx->perf_stats_file = NULL;
+        TA_FREEP(&mpctx->perf_stats_path);
+        if (!path)
+            return;
+        mpctx->perf_stats_path = talloc_strdup(NULL, path);
+        char *fname = mp_get_user_path(NULL, mpctx->global, path);
+        mpctx->perf_stats_file = fopen(fname, "ab");
+        if (!mpctx->perf_stats_file)
+            MP_ERR(mpctx, "Failed to open perf stats file '%s'\n", fname);
+        talloc_free(fname);
+        stats_global_enable(mpctx->global);
+        mpctx->next_perf_stats = 0;
+    }
+
+    if (!mpctx->perf_stats_file)
+        return;
+
+    double now = mp_time_sec();
+    if (now < mpctx->next_perf_stats) {
+        mp_set_timeout(mpctx, mpctx->next_perf_stats - now);
+        return;
+    }
+    mpctx->next_perf_stats = now + opts->perf_stats_interval;
+    mp_set_timeout(mpctx, opts->perf_stats_interval);
+
+    void *tmp = talloc_new(NULL);
+    struct mpv_node node;
+    node_init(&node, MPV_FORMAT_NODE_MAP, NULL);
+    talloc_steal(tmp, node.u.list);
+    node_map_add_double(&node, "time", now);
+    struct mpv_node *stats = node_map_add(&node, "stats", MPV_FORMAT_NONE);
+    stats_global_query(mpctx->global, node.u.list, stats);
+    char *s = talloc_strdup(tmp, "");
+    json_write(&s, &node);
+    fprintf(mpctx->perf_stats_file, "%s\n", s);
+    fflush(mpctx->perf_stats_file);
+    talloc_free(tmp);
+}
+
+struct mp_benchmark {
+    int64_t start;          // mp_time_us() when playback started
+    int64_t last_frame;     // mp_time_us() when the last frame was queued
+    double *frame_times;    // time between queued frames, in ms
+    int num_frame_times;
+    int64_t frames;
+    int64_t vo_drops_start;
+};
+
+// Start collecting data for --benchmark-file, if enabled.
+void benchmark_start(struct MPContext *mpctx)
+{
+    char *path = mpctx->opts->benchmark_file;
+    if (!path || !path[0] || mpctx->benchmark)
+        return;
+
+    stats_global_enable(mpctx->global);
+
+    struct mp_benchmark *b = talloc_zero(NULL, struct mp_benchmark);
+    b->start = mp_time_us();
+    if (mpctx->video_out)
+        b->vo_drops_start = vo_get_drop_count(mpctx->video_out);
+    mpctx->benchmark = b;
+}
+
+// Called when a video frame is queued to the VO.
+void benchmark_frame(struct MPContext *mpctx)
+{
+    struct mp_benchmark *b = mpctx->benchmark;
+    if (!b)
+        return;
+
+    int64_t now = mp_time_us();
+    if (b->last_frame) {
+        double t = (now - b->last_frame) / 1e3;
+        MP_TARRAY_APPEND(b, b->frame_times, b->num_frame_times, t);
+    }
+    b->last_frame = now;
+    b->frames++;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+// Append the results for the current file to --benchmark-file as one JSON
+// object per line, and stop collecting.
+void benchmark_finish(struct MPContext *mpctx)
+{
+    struct mp_benchmark *b = mpctx->benchmark;
+    if (!b)
+        return;
+    mpctx->benchmark = NULL;
+
+    double wall = (mp_time_us() - b->start) / 1e6;
+
+    void *tmp = talloc_new(NULL);
+    talloc_steal(tmp, b);
+    struct mpv_node node;
+    node_init(&node, MPV_FORMAT_NODE_MAP, NULL);
+    talloc_steal(tmp, node.u.list);
+
+    if (mpctx->filename)
+        node_map_add_string(&node, "file", mpctx->filename);
+    node_map_add_double(&node, "wall-time", wall);
+    node_map_add_int64(&node, "frames", b->frames);
+    node_map_add_double(&node, "fps", wall > 0 ? b->frames / wall : 0);
+    if (mpctx->vo_chain && mpctx->vo_chain->video_src) {
+        node_map_add_int64(&node, "decoder-frame-drops",
+                           mpctx->vo_chain->video_src->dropped_frames);
+    }
+    if (mpctx->video_out) {
+        node_map_add_int64(&node, "vo-frame-drops",
+                           vo_get_drop_count(mpctx->video_out) -
+                           b->vo_drops_start);
+    }
+
+    if (b->num_frame_times) {
+        qsort(b->frame_times, b->num_frame_times, sizeof(double), cmp_double);
+        struct mpv_node *ft = node_map_add(&node, "frame-time",
+                                           MPV_FORMAT_NODE_MAP);
+        static const struct { const char *name; double p; } pct[] = {
+            {"p50", 0.50}, {"p90", 0.90}, {"p99", 0.99}, {"max", 1.0},
+        };
+        double sum = 0;
+        for (int n = 0; n < b->num_frame_times; n++)
+            sum += b->frame_times[n];
+        node_map_add_double(ft, "avg", sum / b->num_frame_times);
+        for (int n = 0; n < MP_ARRAY_SIZE(pct); n++) {
+            int i = MPMIN(b->num_frame_times * pct[n].p, b->num_frame_times - 1);
+            node_map_add_double(ft, pct[n].name, b->frame_times[i]);
+        }
+    }
+
+#if HAVE_POSIX
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+#if defined(__APPLE__)
+        int64_t kb = ru.ru_maxrss / 1024; // bytes on OSX
+#else
+        int64_t kb = ru.ru_maxrss;
+#endif
+        node_map_add_int64(&node, "max-rss-kb", kb);
+    }
+#endif
+
+    struct mpv_node *stats = node_map_add(&node, "stats", MPV_FORMAT_NONE);
+    stats_global_query(mpctx->global, node.u.list, stats);
+
+    char *fname = mp_get_user_path(tmp, mpctx->global,
+                                   mpctx->opts->benchmark_file);
+    FILE *f = fopen(fname, "ab");
+    if (f) {
+        char *s = talloc_strdup(tmp, "");
+        json_write(&s, &node);
+        fprintf(f, "%s\n", s);
+        fclose(f);
+        MP_INFO(mpctx, "Benchmark: %"PRId64" frames in %.3fs (%.2f fps)\n",
+                b->frames, wall, wall > 0 ? b->frames / wall : 0);
+    } else {
+        MP_ERR(mpctx, "Failed to open benchmark file '%s'\n", fname);
+    }
+    talloc_free(tmp);
+}
+
+void close_trace_file(struct MPContext *mpctx)
+{
+    if (mpctx->trace_file) {
+        stats_global_set_tracing(mpctx->global, false);
+        stats_global_write_trace(mpctx->global, mpctx->trace_file,
+                                 &mpctx->trace_tracks);
+        // Terminate the array with an entry that needs no trailing comma.
+        fprintf(mpctx->trace_file, "{\"name\":\"process_name\",\"ph\":\"M\","
+                "\"pid\":1,\"args\":{\"name\":\"mpv\"}}]\n");
+        fclose(mpctx->trace_file);
+    }
+    mpctx->trace_file = NULL;
+    TA_FREEP(&mpctx->trace_path);
+}
+
+// Write buffered trace events to --trace-file. This is done from the playloop
+// instead of the recording threads, so that they never wait on file I/O.
+static void handle_trace_file(struct MPContext *mpctx)
+{
+    char *path = mpctx->opts->trace_file && mpctx->opts->trace_file[0]
+                 ? mpctx->opts->trace_file : NULL;
+
+    if (!path || !mpctx->trace_path || strcmp(path, mpctx->trace_path) != 0) {
+        close_trace_file(mpctx);
+        if (!path)
+            return;
+        mpctx->trace_path = talloc_strdup(NULL, path);
+        char *fname = mp_get_user_path(NULL, mpctx->global, path);
+        mpctx->trace_file = fopen(fname, "wb");
+        if (mpctx->trace_file) {
+            fprintf(mpctx->trace_file, "[\n");
+            mpctx->trace_tracks = 0;
+            mpctx->next_trace_flush = 0;
+            stats_global_set_tracing(mpctx->global, true);
+        } else {
+            MP_ERR(mpctx, "Failed to open trace file '%s'\n", fname);
+        }
+        talloc_free(fname);
+    }
+
+    if (!mpctx->trace_file)
+        return;
+
+    double now = mp_time_sec();
+    if (now >= mpctx->next_trace_flush) {
+        stats_global_write_trace(mpctx->global, mpctx->trace_file,
+                                 &mpctx->trace_tracks);
+        mpctx->next_trace_flush = now + 0.5;
+    }
+    mp_set_timeout(mpctx, mpctx->next_trace_flush - now);
+}
+
 static void handle_sstep(struct MPContext *mpctx)
 {
     struct MPOpts *opts = mpctx->opts;
@@ -893,7 +1327,6 @@ int handle_force_window(struct MPContext *mpctx, bool force)
             .input_ctx = mpctx->input,
             .osd = mpctx->osd,
             .encode_lavc_ctx = mpctx->encode_lavc_ctx,
-            .opengl_cb_context = mpctx->gl_cb_ctx,
             .wakeup_cb = mp_wakeup_core_cb,
             .wakeup_ctx = mpctx,
         };
@@ -1121,6 +1554,7 @@ void run_playloop(struct MPContext *mpctx)
     handle_cursor_autohide(mpctx);
     handle_vo_events(mpctx);
     handle_command_updates(mpctx);
+    thumbnails_update(mpctx);
 
     if (mpctx->lavfi) {
         if (lavfi_process(mpctx->lavfi))
@@ -1152,6 +1586,10 @@ void run_playloop(struct MPContext *mpctx)
 
     handle_sstep(mpctx);
 
+    handle_perf_stats(mpctx);
+    handle_trace_file(mpctx);
+    update_stats_overlay(mpctx);
+
     update_core_idle_state(mpctx);
 
     if (mpctx->stop_play)
@@ -1182,6 +1620,9 @@ void mp_idle(struct MPContext *mpctx)
     handle_vo_events(mpctx);
     update_osd_msg(mpctx);
     handle_osd_redraw(mpctx);
+    handle_perf_stats(mpctx);
+    handle_trace_file(mpctx);
+    update_stats_overlay(mpctx);
 }
 
 // Waiting for the slave master to send us a new file to play.
@@ -18,6 +18,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+
+#include <libavutil/cpu.h>
 
 #include "config.h"
 
@@ -31,10 +34,15 @@
 #include "misc/dispatch.h"
 #include "misc/thread_pool.h"
 #include "common/msg.h"
+#include "options/m_config.h"
 #include "options/path.h"
 #include "video/mp_image.h"
 #include "video/mp_image_pool.h"
 #include "video/decode/dec_video.h"
+#include "video/decode/vd.h"
+#include "video/sws_utils.h"
+#include "demux/demux.h"
+#include "demux/packet.h"
 #include "video/out/vo.h"
 #include "video/image_writer.h"
 #include "sub/osd.h"
@@ -44,18 +52,40 @@
 #define MODE_FULL_WINDOW 1
 #define MODE_SUBTITLES 2
 
+// Maximum number of encoder threads, and number of screenshots that can be
+// queued per thread before the player waits for them to be written.
+#define MAX_WRITER_THREADS 4
+#define MAX_QUEUED_PER_THREAD 2
+
 typedef struct screenshot_ctx {
     struct MPContext *mpctx;
 
     int mode;
     bool each_frame;
     bool osd;
+    bool async;
 
     int frameno;
 
     struct mp_thread_pool *thread_pool;
+    int num_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    int num_queued;             // protected by lock
 } screenshot_ctx;
 
+static void screenshot_ctx_destroy(void *ptr)
+{
+    screenshot_ctx *ctx = ptr;
+
+    // Joins the workers. (The player waits for all queued screenshots before
+    // this happens.)
+    talloc_free(ctx->thread_pool);
+    pthread_cond_destroy(&ctx->wakeup);
+    pthread_mutex_destroy(&ctx->lock);
+}
+
 void screenshot_init(struct MPContext *mpctx)
 {
     mpctx->screenshot_ctx = talloc(mpctx, screenshot_ctx);
@@ -63,6 +93,9 @@ void screenshot_init(struct MPContext *mpctx)
         .mpctx = mpctx,
         .frameno = 1,
     };
+    talloc_set_destructor(mpctx->screenshot_ctx, screenshot_ctx_destroy);
+    pthread_mutex_init(&mpctx->screenshot_ctx->lock, NULL);
+    pthread_cond_init(&mpctx->screenshot_ctx->wakeup, NULL);
 }
 
 static void screenshot_msg(screenshot_ctx *ctx, int status, const char *msg,
@@ -99,37 +132,48 @@ struct screenshot_item {
     const char *filename;
     struct mp_image *img;
     struct image_writer_opts opts;
+    bool ok;
 };
 
-#define LOCK(item) if (item->on_thread) mp_dispatch_lock(item->mpctx->dispatch);
-#define UNLOCK(item) if (item->on_thread) mp_dispatch_unlock(item->mpctx->dispatch);
-
-static void write_screenshot_thread(void *arg)
+// Runs on the playback thread.
+static void write_screenshot_done(void *arg)
 {
     struct screenshot_item *item = arg;
     screenshot_ctx *ctx = item->mpctx->screenshot_ctx;
 
-    LOCK(item)
-    screenshot_msg(ctx, MSGL_INFO, "Screenshot: '%s'", item->filename);
-    UNLOCK(item)
-
-    if (!item->img || !write_image(item->img, &item->opts, item->filename,
-                                   item->mpctx->log))
-    {
-        LOCK(item)
+    if (!item->ok)
         screenshot_msg(ctx, MSGL_ERR, "Error writing screenshot!");
-        UNLOCK(item)
-    }
 
     if (item->on_thread) {
-        mp_dispatch_lock(item->mpctx->dispatch);
         screenshot_msg(ctx, MSGL_V, "Screenshot writing done.");
         item->mpctx->outstanding_async -= 1;
         mp_wakeup_core(item->mpctx);
-        mp_dispatch_unlock(item->mpctx->dispatch);
     }
+}
+
+// Note that this never waits on the playback thread, because the playback
+// thread can wait on the workers in write_screenshot().
+static void write_screenshot_thread(void *arg)
+{
+    struct screenshot_item *item = arg;
+    screenshot_ctx *ctx = item->mpctx->screenshot_ctx;
 
-    talloc_free(item);
+    item->ok = item->img && write_image(item->img, &item->opts, item->filename,
+                                        item->mpctx->log);
+
+    if (item->on_thread) {
+        pthread_mutex_lock(&ctx->lock);
+        ctx->num_queued -= 1;
+        pthread_cond_broadcast(&ctx->wakeup);
+        pthread_mutex_unlock(&ctx->lock);
+
+        // Frees the item after the call.
+        mp_dispatch_enqueue_autofree(item->mpctx->dispatch,
+                                     write_screenshot_done, item);
+    } else {
+        write_screenshot_done(item);
+        talloc_free(item);
+    }
 }
 
 static void write_screenshot(struct MPContext *mpctx, struct mp_image *img,
@@ -147,10 +191,22 @@ static void write_screenshot(struct MPContext *mpctx, struct mp_image *img,
         .opts = opts ? *opts : *gopts,
     };
 
+    screenshot_msg(ctx, MSGL_INFO, "Screenshot: '%s'", item->filename);
+
     if (async) {
-        if (!ctx->thread_pool)
-            ctx->thread_pool = mp_thread_pool_create(ctx, 1);
+        if (!ctx->thread_pool) {
+            ctx->num_threads = MPCLAMP(av_cpu_count(), 1, MAX_WRITER_THREADS);
+            ctx->thread_pool = mp_thread_pool_create(ctx, ctx->num_threads);
+        }
         if (ctx->thread_pool) {
+            // Don't buffer an unbounded number of full size images if
+            // screenshots are taken faster than they can be written.
+            pthread_mutex_lock(&ctx->lock);
+            while (ctx->num_queued >= ctx->num_threads * MAX_QUEUED_PER_THREAD)
+                pthread_cond_wait(&ctx->wakeup, &ctx->lock);
+            ctx->num_queued += 1;
+            pthread_mutex_unlock(&ctx->lock);
+
             item->on_thread = true;
             mpctx->outstanding_async += 1;
             mp_thread_pool_queue(ctx->thread_pool, write_screenshot_thread, item);
@@ -453,6 +509,43 @@ end:
     ctx->osd = old_osd;
 }
 
+// Pipelined window screenshots for each-frame mode: start reading back the
+// current window contents (if start is set), and write the oldest readback
+// that has completed. If start is not set, wait for and write all pending
+// readbacks instead. Returns false if the VO doesn't support this.
+static bool screenshot_win_delayed(struct MPContext *mpctx, bool start)
+{
+    screenshot_ctx *ctx = mpctx->screenshot_ctx;
+    struct vo *vo = mpctx->video_out;
+
+    if (!vo || !vo->config_ok)
+        return false;
+
+    if (start)
+        vo_wait_frame(vo);
+
+    while (1) {
+        struct voctrl_screenshot_delayed args = {
+            .start = start,
+            .wait = !start,
+        };
+        if (vo_control(vo, VOCTRL_SCREENSHOT_WIN_DELAYED, &args) != VO_TRUE)
+            return false;
+        if (!args.res)
+            break;
+        struct image_writer_opts *opts = mpctx->opts->screenshot_image_opts;
+        char *filename = gen_fname(ctx, image_writer_file_ext(opts));
+        if (filename)
+            write_screenshot(mpctx, args.res, filename, NULL, ctx->async);
+        talloc_free(filename);
+        talloc_free(args.res);
+        if (start)
+            break;
+    }
+
+    return true;
+}
+
 void screenshot_request(struct MPContext *mpctx, int mode, bool each_frame,
                         bool osd, bool async)
 {
@@ -461,6 +554,10 @@ void screenshot_request(struct MPContext *mpctx, int mode, bool each_frame,
     if (mode == MODE_SUBTITLES && osd_get_render_subs_in_filter(mpctx->osd))
         mode = 0;
 
+    // Finish pipelined each-frame window screenshots before stopping.
+    if (ctx->each_frame && ctx->mode == MODE_FULL_WINDOW)
+        screenshot_win_delayed(mpctx, false);
+
     if (each_frame) {
         ctx->each_frame = !ctx->each_frame;
         if (!ctx->each_frame)
@@ -471,6 +568,7 @@ void screenshot_request(struct MPContext *mpctx, int mode, bool each_frame,
 
     ctx->mode = mode;
     ctx->osd = osd;
+    ctx->async = async;
 
     struct mp_image *image = screenshot_get(mpctx, mode);
 
@@ -494,6 +592,205 @@ void screenshot_flip(struct MPContext *mpctx)
     if (!ctx->each_frame)
         return;
 
+    if (ctx->mode == MODE_FULL_WINDOW && screenshot_win_delayed(mpctx, true))
+        return;
+
     ctx->each_frame = false;
-    screenshot_request(mpctx, ctx->mode, true, ctx->osd, false);
+    screenshot_request(mpctx, ctx->mode, true, ctx->osd, ctx->async);
+}
+
+// Decode the first keyframe from the demuxer's current position.
+static struct mp_image *decode_keyframe(struct dec_video *d_video,
+                                        struct sh_stream *sh)
+{
+    const struct vd_functions *vd = d_video->vd_driver;
+    struct demux_packet *pkt = NULL;
+
+    while (1) {
+        pkt = demux_read_packet(sh);
+        if (!pkt || pkt->keyframe)
+            break;
+        talloc_free(pkt);
+    }
+    if (!pkt)
+        return NULL;
+
+    // Send the keyframe followed by EOF, so that the decoder outputs it
+    // immediately instead of waiting for more packets (codec delay, frame
+    // threading). The decoder is reset for the next seek afterwards.
+    struct mp_image *mpi = NULL;
+    bool sent = false, drained = false;
+    while (!mpi) {
+        if (!sent) {
+            sent = vd->send_packet(d_video, pkt);
+        } else if (!drained) {
+            drained = vd->send_packet(d_video, NULL);
+        }
+        if (!vd->receive_frame(d_video, &mpi))
+            break;
+    }
+    talloc_free(pkt);
+    video_reset(d_video);
+    return mpi;
+}
+
+static struct mp_image *scale_thumbnail(struct mp_image *mpi, int imgfmt,
+                                        int width, int height)
+{
+    if (height <= 0) {
+        int d_w = mpi->w, d_h = mpi->h;
+        if (mpi->params.p_w > 0 && mpi->params.p_h > 0)
+            mp_image_params_get_dsize(&mpi->params, &d_w, &d_h);
+        height = MPMAX(1, (int)((int64_t)width * d_h / MPMAX(d_w, 1)));
+    }
+
+    struct mp_image *dst = mp_image_alloc(imgfmt, width, height);
+    if (!dst)
+        return NULL;
+    mp_image_copy_attributes(dst, mpi);
+    dst->params.p_w = dst->params.p_h = 1;
+    dst->params.color = (struct mp_colorspace){0};
+    mp_image_params_guess_csp(&dst->params);
+
+    if (mp_image_swscale(dst, mpi, mp_sws_fast_flags) < 0) {
+        talloc_free(dst);
+        return NULL;
+    }
+    return dst;
+}
+
+struct thumbnail_source {
+    struct mp_log *log;
+    struct demuxer *demuxer;
+    struct sh_stream *sh;
+    struct dec_video *d_video;
+    double duration;
+};
+
+static void destroy_thumbnail_source(void *p)
+{
+    struct thumbnail_source *src = p;
+    video_uninit(src->d_video);
+    free_demuxer_and_stream(src->demuxer);
+}
+
+struct thumbnail_source *thumbnail_source_open(void *ta_parent,
+                                               struct mpv_global *global,
+                                               struct mp_log *log,
+                                               const char *url,
+                                               int stream_flags,
+                                               struct mp_cancel *cancel)
+{
+    struct thumbnail_source *src = talloc_zero(ta_parent, struct thumbnail_source);
+    talloc_set_destructor(src, destroy_thumbnail_source);
+    src->log = log;
+
+    struct MPOpts *opts = mp_get_config_group(src, global, NULL);
+    // Software decoding only, and no decoder thread.
+    opts->hwdec_api = "no";
+    opts->vd_queue_enable = 0;
+
+    struct demuxer_params params = {
+        .stream_flags = stream_flags,
+        .disable_cache = true,
+    };
+    src->demuxer = demux_open_url(url, &params, cancel, global);
+    if (!src->demuxer) {
+        mp_err(log, "Could not open '%s'.\n", url);
+        goto error;
+    }
+    if (!src->demuxer->seekable) {
+        mp_err(log, "'%s' is not seekable.\n", url);
+        goto error;
+    }
+    demux_set_ts_offset(src->demuxer, -src->demuxer->start_time);
+    src->duration = src->demuxer->duration;
+
+    for (int n = 0; n < demux_get_num_stream(src->demuxer); n++) {
+        struct sh_stream *s = demux_get_stream(src->demuxer, n);
+        if (s->type == STREAM_VIDEO && !s->attached_picture) {
+            src->sh = s;
+            break;
+        }
+    }
+    if (!src->sh) {
+        mp_err(log, "No video stream in '%s'.\n", url);
+        goto error;
+    }
+    demuxer_select_track(src->demuxer, src->sh, MP_NOPTS_VALUE, true);
+
+    struct dec_video *d_video = talloc_zero(NULL, struct dec_video);
+    d_video->global = global;
+    d_video->log = mp_log_new(d_video, log, "!vd");
+    d_video->opts = opts;
+    d_video->header = src->sh;
+    d_video->codec = src->sh->codec;
+    d_video->fps = src->sh->codec->fps;
+    src->d_video = d_video;
+    if (!video_init_best_codec(d_video))
+        goto error;
+
+    return src;
+
+error:
+    talloc_free(src);
+    return NULL;
+}
+
+double thumbnail_source_get_duration(struct thumbnail_source *src)
+{
+    return src->duration;
+}
+
+struct mp_image *thumbnail_source_get(struct thumbnail_source *src,
+                                      double time, int imgfmt,
+                                      int width, int height)
+{
+    // Seeks backwards to the closest keyframe via the demuxer's index.
+    demux_seek(src->demuxer, time, 0);
+
+    struct mp_image *mpi = decode_keyframe(src->d_video, src->sh);
+    struct mp_image *img = mpi ? scale_thumbnail(mpi, imgfmt, width, height)
+                               : NULL;
+    talloc_free(mpi);
+    return img;
+}
+
+int screenshot_thumbnails(struct MPContext *mpctx, const char *url,
+                          const char *prefix, int width, double *times,
+                          int num_times)
+{
+    void *tmp = talloc_new(NULL);
+    struct mp_log *log = mp_log_new(tmp, mpctx->log, "thumbnails");
+    int written = 0;
+
+    struct thumbnail_source *src =
+        thumbnail_source_open(tmp, mpctx->global, log, url,
+                              mpctx->open_url_flags, NULL);
+    if (!src)
+        goto done;
+
+    struct image_writer_opts *wopts = mpctx->opts->screenshot_image_opts;
+    const char *ext = image_writer_file_ext(wopts);
+
+    for (int n = 0; n < num_times; n++) {
+        struct mp_image *img =
+            thumbnail_source_get(src, times[n], IMGFMT_BGR0, width, 0);
+        if (img) {
+            char *fname = talloc_asprintf(tmp, "%s%04d.%s", prefix, n + 1, ext);
+            if (write_image(img, wopts, fname, log)) {
+                mp_verbose(log, "Wrote '%s'.\n", fname);
+                written++;
+            }
+        } else {
+            mp_warn(log, "No frame at %f\n", times[n]);
+        }
+        talloc_free(img);
+    }
+
+    mp_info(log, "Wrote %d of %d thumbnails.\n", written, num_times);
+
+done:
+    talloc_free(tmp);
+    return written;
 }
@@ -21,6 +21,10 @@
 #include <stdbool.h>
 
 struct MPContext;
+struct mpv_global;
+struct mp_log;
+struct mp_cancel;
+struct thumbnail_source;
 
 // One time initialization at program start.
 void screenshot_init(struct MPContext *mpctx);
@@ -42,6 +46,31 @@ void screenshot_to_file(struct MPContext *mpctx, const char *filename, int mode,
 // mode is the same as in screenshot_request()
 struct mp_image *screenshot_get_rgb(struct MPContext *mpctx, int mode);
 
+// Write one image per entry in times (in seconds) to "<prefix><n>.<ext>",
+// using the keyframe at or before each time, scaled to the given width.
+// Opens url separately, and doesn't touch the current playback state.
+// Returns the number of images written.
+int screenshot_thumbnails(struct MPContext *mpctx, const char *url,
+                          const char *prefix, int width, double *times,
+                          int num_times);
+
+// Open url with a separate demuxer and software decoder for extracting
+// keyframes. Blocks. Can be used from any thread. Free with talloc_free().
+struct thumbnail_source *thumbnail_source_open(void *ta_parent,
+                                               struct mpv_global *global,
+                                               struct mp_log *log,
+                                               const char *url,
+                                               int stream_flags,
+                                               struct mp_cancel *cancel);
+// Duration as reported by the demuxer (<= 0 if unknown).
+double thumbnail_source_get_duration(struct thumbnail_source *src);
+// Return the keyframe at or before time (in seconds, relative to the start of
+// the file), converted to imgfmt and scaled to the given size. If height is
+// <= 0, it is computed from the width and the display aspect ratio.
+struct mp_image *thumbnail_source_get(struct thumbnail_source *src,
+                                      double time, int imgfmt,
+                                      int width, int height);
+
 // Called by the playback core code when a new frame is displayed.
 void screenshot_flip(struct MPContext *mpctx);
 
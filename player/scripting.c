@@ -107,7 +107,9 @@ static void wait_loaded(struct MPContext *mpctx)
     mp_wakeup_core(mpctx); // avoid lost wakeups during waiting
 }
 
-int mp_load_script(struct MPContext *mpctx, const char *fname)
+// Start loading the script. If wait is false, the caller must call
+// wait_loaded() later.
+static int load_script(struct MPContext *mpctx, const char *fname, bool wait)
 {
     char *ext = mp_splitext(fname, NULL);
     const struct mp_scripting *backend = NULL;
@@ -149,20 +151,33 @@ int mp_load_script(struct MPContext *mpctx, const char *fname)
         return -1;
     }
 
-    wait_loaded(mpctx);
-    MP_DBG(mpctx, "Done loading %s.\n", fname);
+    if (wait) {
+        wait_loaded(mpctx);
+        MP_DBG(mpctx, "Done loading %s.\n", fname);
+    }
 
     return 0;
 }
 
-int mp_load_user_script(struct MPContext *mpctx, const char *fname)
+int mp_load_script(struct MPContext *mpctx, const char *fname)
+{
+    return load_script(mpctx, fname, true);
+}
+
+static int load_user_script(struct MPContext *mpctx, const char *fname,
+                            bool wait)
 {
     char *path = mp_get_user_path(NULL, mpctx->global, fname);
-    int ret = mp_load_script(mpctx, path);
+    int ret = load_script(mpctx, path, wait);
     talloc_free(path);
     return ret;
 }
 
+int mp_load_user_script(struct MPContext *mpctx, const char *fname)
+{
+    return load_user_script(mpctx, fname, true);
+}
+
 static int compare_filename(const void *pa, const void *pb)
 {
     char *a = (char *)pa;
@@ -223,26 +238,31 @@ void mp_load_builtin_scripts(struct MPContext *mpctx)
     load_builtin_script(mpctx, mpctx->opts->lua_load_stats, "@stats.lua");
 }
 
+// All scripts are started first and initialize in parallel. Their client
+// names are still assigned in the order the scripts are listed.
 void mp_load_scripts(struct MPContext *mpctx)
 {
     // Load scripts from options
     char **files = mpctx->opts->script_files;
     for (int n = 0; files && files[n]; n++) {
         if (files[n][0])
-            mp_load_user_script(mpctx, files[n]);
+            load_user_script(mpctx, files[n], false);
     }
-    if (!mpctx->opts->auto_load_scripts)
-        return;
-
-    // Load all scripts
-    void *tmp = talloc_new(NULL);
-    char **scriptsdir = mp_find_all_config_files(tmp, mpctx->global, "scripts");
-    for (int i = 0; scriptsdir && scriptsdir[i]; i++) {
-        files = list_script_files(tmp, scriptsdir[i]);
-        for (int n = 0; files && files[n]; n++)
-            mp_load_script(mpctx, files[n]);
+    if (mpctx->opts->auto_load_scripts) {
+        // Load all scripts
+        void *tmp = talloc_new(NULL);
+        char **scriptsdir = mp_find_all_config_files(tmp, mpctx->global,
+                                                     "scripts");
+        for (int i = 0; scriptsdir && scriptsdir[i]; i++) {
+            files = list_script_files(tmp, scriptsdir[i]);
+            for (int n = 0; files && files[n]; n++)
+                load_script(mpctx, files[n], false);
+        }
+        talloc_free(tmp);
     }
-    talloc_free(tmp);
+
+    wait_loaded(mpctx);
+    MP_DBG(mpctx, "Done loading scripts.\n");
 }
 
 #if HAVE_CPLUGINS
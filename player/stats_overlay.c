@@ -0,0 +1,265 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Native statistics overlay (--osd-stats). This shows roughly the same data as
+ * the stats.lua script, but reads it directly from the player state, the VO
+ * and the stats registry, instead of going through the property and client
+ * API layers. The text is rebuilt every --osd-stats-interval seconds only, and
+ * osd_set_external() re-renders the ASS track only if the text changed.
+ */
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "mpv_talloc.h"
+#include "common/common.h"
+#include "common/stats.h"
+#include "libmpv/client.h"
+#include "options/options.h"
+#include "options/path.h"
+#include "osdep/timer.h"
+#include "demux/demux.h"
+#include "sub/osd.h"
+#include "audio/aframe.h"
+#include "audio/chmap.h"
+#include "audio/decode/dec_audio.h"
+#include "video/decode/dec_video.h"
+#include "video/decode/vd.h"
+#include "video/filter/vf.h"
+#include "video/mp_image.h"
+#include "video/out/vo.h"
+
+#include "core.h"
+
+enum {
+    PAGE_NONE,
+    PAGE_PLAYBACK,
+    PAGE_VO_PASSES,
+    PAGE_PERF,
+};
+
+// Above script overlays with the default layer 0.
+#define STATS_OSD_LAYER 1000
+
+#define HEADER "{\\an7}{\\fs9}{\\bord0.8}{\\3c&H262626&}{\\1c&HFFFFFF&}"
+
+#define saddf(var, ...) (*(var) = talloc_asprintf_append((*var), __VA_ARGS__))
+
+// Append in, with ASS override blocks and escapes disabled.
+static void add_escaped(char **buf, const char *in)
+{
+    for (const char *s = in; *s; s++) {
+        if (*s == '{') {
+            *buf = talloc_strdup_append(*buf, "\\{");
+        } else if (*s == '\\') {
+            // Prevent sequences like \N; a word joiner breaks them up.
+            *buf = talloc_strdup_append(*buf, "\\\xE2\x81\xA0");
+        } else if (*s != '\n') {
+            *buf = talloc_strndup_append(*buf, s, 1);
+        }
+    }
+}
+
+static void add_label(char **buf, const char *label)
+{
+    saddf(buf, "\\N{\\b1}%s{\\b0} ", label);
+}
+
+static void add_playback(struct MPContext *mpctx, char **buf)
+{
+    struct vo *vo = mpctx->video_out;
+
+    if (mpctx->filename) {
+        add_label(buf, "File:");
+        add_escaped(buf, mp_basename(mpctx->filename));
+    }
+
+    struct demux_ctrl_reader_state s;
+    if (mpctx->demuxer &&
+        demux_control(mpctx->demuxer, DEMUXER_CTRL_GET_READER_STATE, &s) > 0)
+    {
+        add_label(buf, "Cache:");
+        if (s.ts_duration >= 0)
+            saddf(buf, "%.1fs ", s.ts_duration);
+        saddf(buf, "%" PRId64 " KiB%s", s.fw_bytes / 1024,
+              s.underrun ? " (underrun)" : "");
+    }
+
+    struct track *vtrack = mpctx->current_track[0][STREAM_VIDEO];
+    struct dec_video *vd = vtrack ? vtrack->d_video : NULL;
+    struct vo_chain *vo_c = mpctx->vo_chain;
+    if (vd && vd->decoder_desc) {
+        add_label(buf, "Video:");
+        add_escaped(buf, vd->decoder_desc);
+        char *hwdec = NULL;
+        video_vd_control(vd, VDCTRL_GET_HWDEC, &hwdec);
+        if (hwdec)
+            saddf(buf, " (hwdec: %s)", hwdec);
+    }
+    if (vo_c && vo_c->vf->input_params.imgfmt) {
+        struct mp_image_params *p = &vo_c->vf->input_params;
+        add_label(buf, "Resolution:");
+        saddf(buf, "%dx%d %s", p->w, p->h, mp_imgfmt_to_name(p->imgfmt));
+    }
+    if (vo_c && vo) {
+        double frame_duration = calc_average_frame_duration(mpctx);
+        double vsync = vo_get_estimated_vsync_interval(vo);
+        add_label(buf, "FPS:");
+        if (frame_duration > 0)
+            saddf(buf, "%.3f ", 1.0 / frame_duration);
+        saddf(buf, "(display: %.3f", vo_get_display_fps(vo));
+        if (vsync > 0)
+            saddf(buf, ", estimated %.3f", 1.0 / vsync);
+        saddf(buf, ")");
+        double jitter = vo_get_estimated_vsync_jitter(vo);
+        if (jitter >= 0) {
+            add_label(buf, "Vsync jitter:");
+            saddf(buf, "%.3f", jitter);
+        }
+        add_label(buf, "Dropped frames:");
+        saddf(buf, "%" PRId64 " (decoder: %d) Delayed: %" PRId64,
+              vo_get_drop_count(vo), vo_c->video_src->dropped_frames,
+              vo_get_delayed_count(vo));
+        if (mpctx->display_sync_active)
+            saddf(buf, " Mistimed: %d", mpctx->mistimed_frames_total);
+    }
+
+    struct track *atrack = mpctx->current_track[0][STREAM_AUDIO];
+    struct dec_audio *da = atrack ? atrack->d_audio : NULL;
+    struct ao_chain *ao_c = mpctx->ao_chain;
+    if (da && da->decoder_desc) {
+        add_label(buf, "Audio:");
+        add_escaped(buf, da->decoder_desc);
+        struct mp_aframe *fmt = ao_c ? ao_c->input_format : NULL;
+        if (fmt && mp_aframe_config_is_valid(fmt)) {
+            struct mp_chmap chmap = {0};
+            mp_aframe_get_chmap(fmt, &chmap);
+            saddf(buf, " %d Hz %s", mp_aframe_get_rate(fmt),
+                  mp_chmap_to_str(&chmap));
+        }
+    }
+    if (ao_c && vo_c) {
+        add_label(buf, "A-V:");
+        saddf(buf, "%.3f", mpctx->last_av_difference);
+    }
+}
+
+static void add_passes(char **buf, const char *title, struct mp_frame_perf *f)
+{
+    if (!f->count)
+        return;
+    add_label(buf, title);
+    saddf(buf, "(last/avg/peak in us)");
+    for (int n = 0; n < f->count; n++) {
+        struct mp_pass_perf *p = &f->perf[n];
+        saddf(buf, "\\N  %5" PRIu64 " %5" PRIu64 " %5" PRIu64 "  ",
+              p->last / 1000, p->avg / 1000, p->peak / 1000);
+        add_escaped(buf, f->desc[n] ? f->desc[n] : "");
+    }
+}
+
+static void add_vo_passes(struct MPContext *mpctx, char **buf)
+{
+    struct vo *vo = mpctx->video_out;
+    struct voctrl_performance_data *data = talloc_ptrtype(NULL, data);
+    if (vo && vo_control(vo, VOCTRL_PERFORMANCE_DATA, data) > 0) {
+        add_passes(buf, "Frame timings (fresh):", &data->fresh);
+        add_passes(buf, "Frame timings (redraw):", &data->redraw);
+    } else {
+        add_label(buf, "No VO performance data available.");
+    }
+    talloc_free(data);
+}
+
+static struct mpv_node *map_get(struct mpv_node *map, const char *key)
+{
+    if (map->format != MPV_FORMAT_NODE_MAP)
+        return NULL;
+    for (int n = 0; n < map->u.list->num; n++) {
+        if (strcmp(map->u.list->keys[n], key) == 0)
+            return &map->u.list->values[n];
+    }
+    return NULL;
+}
+
+static void add_perf(struct MPContext *mpctx, char **buf)
+{
+    void *tmp = talloc_new(NULL);
+    struct mpv_node stats;
+    stats_global_query(mpctx->global, tmp, &stats);
+    struct mpv_node_list *list = stats.u.list;
+    for (int n = 0; n < list->num; n++) {
+        add_label(buf, list->keys[n]);
+        struct mpv_node_list *entries = list->values[n].u.list;
+        for (int i = 0; i < entries->num; i++) {
+            struct mpv_node *e = &entries->values[i];
+            saddf(buf, "\\N  %s:", entries->keys[i]);
+            struct mpv_node *v;
+            if ((v = map_get(e, "count")))
+                saddf(buf, " count=%" PRId64, v->u.int64);
+            if ((v = map_get(e, "value")))
+                saddf(buf, " value=%" PRId64, v->u.int64);
+            if ((v = map_get(e, "time-avg")))
+                saddf(buf, " avg=%.3fms", v->u.double_);
+            if ((v = map_get(e, "time-max")))
+                saddf(buf, " max=%.3fms", v->u.double_);
+        }
+    }
+    if (!list->num)
+        add_label(buf, "No stats recorded.");
+    talloc_free(tmp);
+}
+
+// Show, update, or remove the --osd-stats overlay.
+void update_stats_overlay(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+    int page = opts->osd_stats;
+
+    if (!page) {
+        if (mpctx->stats_overlay_page) {
+            osd_set_external(mpctx->osd, &mpctx->stats_overlay_page,
+                             STATS_OSD_LAYER, 0, 0, NULL);
+            mpctx->stats_overlay_page = PAGE_NONE;
+        }
+        return;
+    }
+
+    double now = mp_time_sec();
+    if (page == mpctx->stats_overlay_page && now < mpctx->next_stats_overlay) {
+        mp_set_timeout(mpctx, mpctx->next_stats_overlay - now);
+        return;
+    }
+    mpctx->stats_overlay_page = page;
+    mpctx->next_stats_overlay = now + opts->osd_stats_interval;
+    mp_set_timeout(mpctx, opts->osd_stats_interval);
+
+    char *text = talloc_strdup(NULL, HEADER);
+    switch (page) {
+    case PAGE_PLAYBACK:     add_playback(mpctx, &text); break;
+    case PAGE_VO_PASSES:    add_vo_passes(mpctx, &text); break;
+    case PAGE_PERF:         add_perf(mpctx, &text); break;
+    }
+    // Strip the line break in front of the first entry.
+    char *first = strstr(text, "\\N");
+    if (first && first == text + strlen(HEADER))
+        memmove(first, first + 2, strlen(first + 2) + 1);
+    osd_set_external(mpctx->osd, &mpctx->stats_overlay_page, STATS_OSD_LAYER,
+                     0, 0, text);
+    talloc_free(text);
+}
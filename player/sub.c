@@ -146,12 +146,8 @@ static struct attachment_list *get_all_attachments(struct MPContext *mpctx)
         prev_demuxer = t->demuxer;
         for (int i = 0; i < t->demuxer->num_attachments; i++) {
             struct demux_attachment *att = &t->demuxer->attachments[i];
-            struct demux_attachment copy = {
-                .name = talloc_strdup(list, att->name),
-                .type = talloc_strdup(list, att->type),
-                .data = talloc_memdup(list, att->data, att->data_size),
-                .data_size = att->data_size,
-            };
+            struct demux_attachment copy;
+            demux_copy_attachment(list, &copy, att);
             MP_TARRAY_APPEND(list, list->entries, list->num_entries, copy);
         }
     }
@@ -0,0 +1,282 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "mpv_talloc.h"
+
+#include "common/common.h"
+#include "common/global.h"
+#include "common/msg.h"
+#include "demux/demux.h"
+#include "options/options.h"
+#include "osdep/threads.h"
+#include "stream/stream.h"
+#include "video/mp_image.h"
+
+#include "command.h"
+#include "core.h"
+#include "screenshot.h"
+
+// Background generation of seekbar thumbnails for the current file. The file
+// is opened a second time, and one keyframe per slot is decoded, scaled down,
+// and stored in a sprite atlas in memory.
+struct thumbnails_ctx {
+    struct mp_log *log;
+    struct mpv_global *global;
+    char *url;
+    int stream_flags;
+    int count;
+    int width;
+
+    pthread_t thread;
+    struct mp_cancel *cancel;
+    atomic_bool changed;        // new thumbnails since last thumbnails_update()
+    struct MPContext *mpctx;    // only for mp_wakeup_core()
+
+    pthread_mutex_t lock;
+    // --- the following members are protected by lock
+    bool terminate;
+    bool done;
+    double duration;
+    int height;                 // 0 until the first thumbnail was decoded
+    int cols;
+    struct mp_image *atlas;     // cols * slot width, rows * slot height
+    bool *ready;                // per slot
+    int num_ready;
+};
+
+static void store_thumbnail(struct thumbnails_ctx *ctx, int slot,
+                            struct mp_image *img)
+{
+    pthread_mutex_lock(&ctx->lock);
+    if (!ctx->atlas) {
+        int rows = (ctx->count + ctx->cols - 1) / ctx->cols;
+        ctx->height = img->h;
+        ctx->atlas = mp_image_alloc(IMGFMT_BGRA, ctx->width * ctx->cols,
+                                    ctx->height * rows);
+        if (ctx->atlas)
+            talloc_steal(ctx, ctx->atlas);
+    }
+    if (ctx->atlas && img->w == ctx->width && img->h == ctx->height) {
+        int x = (slot % ctx->cols) * ctx->width;
+        int y = (slot / ctx->cols) * ctx->height;
+        uint8_t *dst = ctx->atlas->planes[0] + y * ctx->atlas->stride[0] + x * 4;
+        memcpy_pic(dst, img->planes[0], img->w * 4, img->h,
+                   ctx->atlas->stride[0], img->stride[0]);
+        // The OSD expects premultiplied alpha; make the frame opaque.
+        for (int py = 0; py < img->h; py++) {
+            uint8_t *line = dst + py * ctx->atlas->stride[0];
+            for (int px = 0; px < img->w; px++)
+                line[px * 4 + 3] = 0xFF;
+        }
+        if (!ctx->ready[slot])
+            ctx->num_ready++;
+        ctx->ready[slot] = true;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static bool generate_slot(struct thumbnails_ctx *ctx,
+                          struct thumbnail_source *src, int slot)
+{
+    pthread_mutex_lock(&ctx->lock);
+    bool terminate = ctx->terminate;
+    bool ready = ctx->ready[slot];
+    int height = ctx->height;
+    pthread_mutex_unlock(&ctx->lock);
+    if (terminate)
+        return false;
+    if (ready)
+        return true;
+
+    double time = (slot + 0.5) * ctx->duration / ctx->count;
+    struct mp_image *img =
+        thumbnail_source_get(src, time, IMGFMT_BGRA, ctx->width, height);
+    if (img) {
+        store_thumbnail(ctx, slot, img);
+        atomic_store(&ctx->changed, true);
+        mp_wakeup_core(ctx->mpctx);
+    } else {
+        MP_VERBOSE(ctx, "No frame at %f\n", time);
+    }
+    talloc_free(img);
+    return true;
+}
+
+static void *thumbnails_thread(void *p)
+{
+    struct thumbnails_ctx *ctx = p;
+    mpthread_set_name("thumbnails");
+
+    struct thumbnail_source *src =
+        thumbnail_source_open(NULL, ctx->global, ctx->log, ctx->url,
+                              ctx->stream_flags, ctx->cancel);
+    double duration = src ? thumbnail_source_get_duration(src) : 0;
+    if (src && !(duration > 0))
+        MP_WARN(ctx, "Unknown duration, not generating thumbnails.\n");
+
+    if (src && duration > 0) {
+        pthread_mutex_lock(&ctx->lock);
+        ctx->duration = duration;
+        pthread_mutex_unlock(&ctx->lock);
+
+        // Coarse to fine, so the whole seekbar has some preview early on.
+        int step = 1;
+        while (step < ctx->count)
+            step *= 2;
+        for (; step >= 1; step /= 2) {
+            for (int n = 0; n < ctx->count; n += step) {
+                if (!generate_slot(ctx, src, n))
+                    goto done;
+            }
+        }
+        MP_VERBOSE(ctx, "Generated %d of %d thumbnails.\n", ctx->num_ready,
+                   ctx->count);
+    }
+
+done:
+    talloc_free(src);
+    pthread_mutex_lock(&ctx->lock);
+    ctx->done = true;
+    pthread_mutex_unlock(&ctx->lock);
+    atomic_store(&ctx->changed, true);
+    mp_wakeup_core(ctx->mpctx);
+    return NULL;
+}
+
+static void destroy_thumbnails(void *p)
+{
+    struct thumbnails_ctx *ctx = p;
+    pthread_mutex_destroy(&ctx->lock);
+}
+
+void thumbnails_start(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+
+    thumbnails_stop(mpctx);
+
+    if (opts->thumbnail_count < 1 || !mpctx->vo_chain ||
+        mpctx->vo_chain->is_coverart || !mpctx->demuxer ||
+        !mpctx->demuxer->seekable || mpctx->demuxer->is_network)
+        return;
+
+    struct thumbnails_ctx *ctx = talloc_zero(NULL, struct thumbnails_ctx);
+    talloc_set_destructor(ctx, destroy_thumbnails);
+    *ctx = (struct thumbnails_ctx){
+        .log = mp_log_new(ctx, mpctx->log, "thumbnails"),
+        .global = mpctx->global,
+        .url = talloc_strdup(ctx, mpctx->stream_open_filename),
+        .stream_flags = mpctx->open_url_flags,
+        .count = opts->thumbnail_count,
+        .width = opts->thumbnail_width,
+        .cancel = mp_cancel_new(ctx),
+        .mpctx = mpctx,
+        .cols = MPMAX(1, (int)ceil(sqrt(opts->thumbnail_count))),
+    };
+    ctx->ready = talloc_zero_array(ctx, bool, ctx->count);
+    atomic_init(&ctx->changed, false);
+    pthread_mutex_init(&ctx->lock, NULL);
+
+    if (pthread_create(&ctx->thread, NULL, thumbnails_thread, ctx)) {
+        talloc_free(ctx);
+        return;
+    }
+    mpctx->thumbnails = ctx;
+    mp_notify_property(mpctx, "thumbnails");
+}
+
+void thumbnails_stop(struct MPContext *mpctx)
+{
+    struct thumbnails_ctx *ctx = mpctx->thumbnails;
+    if (!ctx)
+        return;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->terminate = true;
+    pthread_mutex_unlock(&ctx->lock);
+    mp_cancel_trigger(ctx->cancel);
+    pthread_join(ctx->thread, NULL);
+
+    talloc_free(ctx);
+    mpctx->thumbnails = NULL;
+    mp_notify_property(mpctx, "thumbnails");
+}
+
+void thumbnails_update(struct MPContext *mpctx)
+{
+    struct thumbnails_ctx *ctx = mpctx->thumbnails;
+    if (ctx && atomic_exchange(&ctx->changed, false))
+        mp_notify_property(mpctx, "thumbnails");
+}
+
+bool thumbnails_get_info(struct MPContext *mpctx, struct thumbnails_info *info)
+{
+    struct thumbnails_ctx *ctx = mpctx->thumbnails;
+    if (!ctx)
+        return false;
+
+    pthread_mutex_lock(&ctx->lock);
+    *info = (struct thumbnails_info){
+        .count = ctx->count,
+        .ready = ctx->num_ready,
+        .width = ctx->width,
+        .height = ctx->height,
+        .duration = ctx->duration,
+        .done = ctx->done,
+    };
+    pthread_mutex_unlock(&ctx->lock);
+    return true;
+}
+
+struct mp_image *thumbnails_get(struct MPContext *mpctx, double time)
+{
+    struct thumbnails_ctx *ctx = mpctx->thumbnails;
+    if (!ctx)
+        return NULL;
+
+    struct mp_image *res = NULL;
+    pthread_mutex_lock(&ctx->lock);
+    if (ctx->num_ready && ctx->duration > 0) {
+        int slot = MPCLAMP((int)(time / ctx->duration * ctx->count),
+                           0, ctx->count - 1);
+        // Use the nearest slot that was generated so far.
+        for (int d = 0; d < ctx->count; d++) {
+            if (slot - d >= 0 && ctx->ready[slot - d]) {
+                slot = slot - d;
+                break;
+            }
+            if (slot + d < ctx->count && ctx->ready[slot + d]) {
+                slot = slot + d;
+                break;
+            }
+        }
+        res = mp_image_alloc(IMGFMT_BGRA, ctx->width, ctx->height);
+        if (res) {
+            int x = (slot % ctx->cols) * ctx->width;
+            int y = (slot / ctx->cols) * ctx->height;
+            memcpy_pic(res->planes[0], ctx->atlas->planes[0] +
+                       y * ctx->atlas->stride[0] + x * 4, ctx->width * 4,
+                       ctx->height, res->stride[0], ctx->atlas->stride[0]);
+        }
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return res;
+}
@@ -45,6 +45,7 @@
 #include "video/out/vo.h"
 #include "audio/decode/dec_audio.h"
 
+#include "client.h"
 #include "core.h"
 #include "command.h"
 #include "screenshot.h"
@@ -154,7 +155,9 @@ static void filter_reconfig(struct MPContext *mpctx, struct vo_chain *vo_c)
         }
     }
 
-    if (mpctx->opts->deinterlace)
+    // Prefer deinterlacing in the VO (no readback or copy for hwdec).
+    int deint = mpctx->opts->deinterlace;
+    if (vo_control(vo_c->vo, VOCTRL_SET_DEINTERLACE, &deint) != VO_TRUE && deint)
         probe_deint_filters(vo_c);
 }
 
@@ -193,6 +196,87 @@ static void recreate_video_filters(struct MPContext *mpctx)
     set_allowed_vo_formats(vo_c);
 }
 
+static void clear_backstep_cache(struct MPContext *mpctx)
+{
+    for (int n = 0; n < mpctx->num_backstep_frames; n++)
+        talloc_free(mpctx->backstep_frames[n]);
+    mpctx->num_backstep_frames = 0;
+    mpctx->backstep_cached = false;
+}
+
+// Remember a frame decoded while seeking for a backstep, so that further
+// backsteps within the same range can be served without seeking.
+static void add_backstep_frame(struct MPContext *mpctx, struct mp_image *img)
+{
+    int max = mpctx->opts->backstep_cache;
+    if (!max || img->pts == MP_NOPTS_VALUE)
+        return;
+    if (mpctx->num_backstep_frames &&
+        img->pts <= mpctx->backstep_frames[mpctx->num_backstep_frames - 1]->pts)
+        return; // keep it strictly sorted
+    if (mpctx->num_backstep_frames >= max) {
+        talloc_free(mpctx->backstep_frames[0]);
+        MP_TARRAY_REMOVE_AT(mpctx->backstep_frames, mpctx->num_backstep_frames, 0);
+    }
+    MP_TARRAY_APPEND(mpctx, mpctx->backstep_frames, mpctx->num_backstep_frames,
+                     mp_image_new_ref(img));
+}
+
+// Step to the previous (dir<0) or next (dir>0) frame using the frames cached
+// by the last backstep seek. Returns false if the frame is not available and
+// the caller must seek normally.
+bool video_step_cached(struct MPContext *mpctx, int dir)
+{
+    struct vo *vo = mpctx->video_out;
+    if (!mpctx->vo_chain || !mpctx->paused || mpctx->seek.type ||
+        mpctx->hrseek_active || mpctx->video_status < STATUS_READY ||
+        mpctx->video_pts == MP_NOPTS_VALUE || !vo_is_ready_for_frame(vo, -1))
+        return false;
+
+    int cur = -1;
+    for (int n = 0; n < mpctx->num_backstep_frames; n++) {
+        if (fabs(mpctx->backstep_frames[n]->pts - mpctx->video_pts) < 0.001) {
+            cur = n;
+            break;
+        }
+    }
+    int idx = cur + (dir < 0 ? -1 : 1);
+    if (cur < 0 || idx < 0 || idx >= mpctx->num_backstep_frames)
+        return false;
+    struct mp_image *img = mpctx->backstep_frames[idx];
+
+    struct mp_image_params *p = vo->params;
+    if (!p || !mp_image_params_equal(&img->params, p))
+        return false;
+
+    MP_VERBOSE(mpctx, "Showing cached frame at %f.\n", img->pts);
+
+    osd_set_force_video_pts(mpctx->osd, MP_NOPTS_VALUE);
+    update_subtitles(mpctx, img->pts);
+
+    struct vo_frame dummy = {
+        .pts = mp_time_us(),
+        .duration = -1,
+        .still = true,
+        .num_frames = 1,
+        .num_vsyncs = 1,
+        .frames = {img},
+    };
+    vo_queue_frame(vo, vo_frame_ref(&dummy));
+
+    mpctx->video_pts = img->pts;
+    mpctx->last_vo_pts = img->pts;
+    mpctx->playback_pts = img->pts;
+    // The decoder and the frame queue are still at the old position.
+    mpctx->backstep_cached = true;
+
+    mpctx->osd_force_update = true;
+    update_osd_msg(mpctx);
+    mp_notify(mpctx, MPV_EVENT_TICK, NULL);
+    mp_wakeup_core(mpctx);
+    return true;
+}
+
 int reinit_video_filters(struct MPContext *mpctx)
 {
     struct vo_chain *vo_c = mpctx->vo_chain;
@@ -202,6 +286,7 @@ int reinit_video_filters(struct MPContext *mpctx)
     bool need_reconfig = vo_c->vf->initialized != 0;
 
     recreate_video_filters(mpctx);
+    clear_backstep_cache(mpctx);
 
     if (need_reconfig)
         filter_reconfig(mpctx, vo_c);
@@ -237,6 +322,7 @@ void reset_video_state(struct MPContext *mpctx)
         mp_image_unrefp(&mpctx->next_frames[n]);
     mpctx->num_next_frames = 0;
     mp_image_unrefp(&mpctx->saved_frame);
+    clear_backstep_cache(mpctx);
 
     mpctx->delay = 0;
     mpctx->time_frame = 0;
@@ -289,6 +375,7 @@ void uninit_video_chain(struct MPContext *mpctx)
 {
     if (mpctx->vo_chain) {
         reset_video_state(mpctx);
+        mp_client_flush_frame_taps(mpctx);
         vo_chain_uninit(mpctx->vo_chain);
         mpctx->vo_chain = NULL;
 
@@ -312,8 +399,10 @@ int init_video_decoder(struct MPContext *mpctx, struct track *track)
     d_video->header = track->stream;
     d_video->codec = track->stream->codec;
     d_video->fps = d_video->header->codec->fps;
+    d_video->wakeup_cb = mp_wakeup_core_cb;
+    d_video->wakeup_ctx = mpctx;
 
-    // Note: at least mpv_opengl_cb_uninit_gl() relies on being able to get
+    // Note: at least mpv_render_context_free() relies on being able to get
     //       rid of all references to the VO by destroying the VO chain. Thus,
     //       decoders not linked to vo_chain must not use the hwdec context.
     if (mpctx->vo_chain) {
@@ -364,7 +453,6 @@ void reinit_video_chain_src(struct MPContext *mpctx, struct track *track)
             .input_ctx = mpctx->input,
             .osd = mpctx->osd,
             .encode_lavc_ctx = mpctx->encode_lavc_ctx,
-            .opengl_cb_context = mpctx->gl_cb_ctx,
             .wakeup_cb = mp_wakeup_core_cb,
             .wakeup_ctx = mpctx,
         };
@@ -717,6 +805,7 @@ static void add_new_frame(struct MPContext *mpctx, struct mp_image *frame)
 {
     assert(mpctx->num_next_frames < MP_ARRAY_SIZE(mpctx->next_frames));
     assert(frame);
+    mp_client_tap_frame(mpctx, frame);
     mpctx->next_frames[mpctx->num_next_frames++] = frame;
     if (mpctx->num_next_frames == 1)
         handle_new_frame(mpctx);
@@ -765,8 +854,10 @@ static int video_output_image(struct MPContext *mpctx)
                 mp_image_setrefp(&mpctx->saved_frame, img);
             } else if (hrseek && img->pts < mpctx->hrseek_pts - .005) {
                 /* just skip - but save if backstep active */
-                if (mpctx->hrseek_backstep)
+                if (mpctx->hrseek_backstep) {
                     mp_image_setrefp(&mpctx->saved_frame, img);
+                    add_backstep_frame(mpctx, img);
+                }
             } else if (mpctx->video_status == STATUS_SYNCING &&
                        mpctx->playback_pts != MP_NOPTS_VALUE &&
                        img->pts < mpctx->playback_pts && !vo_c->is_coverart)
@@ -780,6 +871,7 @@ static int video_output_image(struct MPContext *mpctx)
                     } else {
                         MP_WARN(mpctx, "Backstep failed.\n");
                     }
+                    add_backstep_frame(mpctx, img);
                     mpctx->hrseek_backstep = false;
                 }
                 add_new_frame(mpctx, img);
@@ -1388,6 +1480,7 @@ void write_video(struct MPContext *mpctx)
     update_osd_msg(mpctx);
 
     vo_queue_frame(vo, frame);
+    benchmark_frame(mpctx);
 
     // The frames were shifted down; "initialize" the new first entry.
     if (mpctx->num_next_frames >= 1)
@@ -20,11 +20,12 @@
 // cache is being slow.
 #define CACHE_WAIT_TIME 1.0
 
-// The time the cache sleeps in idle mode. This controls how often the cache
-// retries reading from the stream after EOF has reached (in case the stream is
-// actually readable again, for example if data has been appended to a file).
-// Note that if this timeout is too low, the player will waste too much CPU
-// when player is paused.
+// The time the cache sleeps in idle mode after EOF has been reached. This
+// controls how often the cache retries reading from the stream (in case the
+// stream is actually readable again, for example if data has been appended to
+// a file). Note that if this timeout is too low, the player will waste too
+// much CPU when player is paused. If idle for other reasons (buffer full),
+// the cache sleeps until the reader or a control wakes it up.
 #define CACHE_IDLE_SLEEP_TIME 1.0
 
 // Time in seconds the cache updates "cached" controls. Note that idle mode
@@ -32,6 +33,20 @@
 // the cache is active.
 #define CACHE_UPDATE_CONTROLS_TIME 2.0
 
+// Range of the size of a single read from the underlying stream. The read size
+// is doubled while reads return the full requested amount faster than
+// CACHE_READ_TIME_FAST, and halved when a read blocks for longer than
+// CACHE_READ_TIME_SLOW. Large reads save syscalls on fast local media, while
+// small reads make data available to the player sooner on slow links.
+#define CACHE_MIN_READ_SIZE (16 * 1024)
+#define CACHE_MAX_READ_SIZE (4 * 1024 * 1024)
+#define CACHE_READ_TIME_FAST 0.005
+#define CACHE_READ_TIME_SLOW 0.1
+
+// Granularity of data kept after it was dropped from the ringbuffer on a seek
+// (--cache-retain). Blocks are aligned to multiples of this in the file.
+#define CACHE_BLOCK_SIZE (256 * 1024)
+
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -54,6 +69,7 @@
 
 #include "common/msg.h"
 #include "common/tags.h"
+#include "common/stats.h"
 #include "options/options.h"
 
 #include "stream.h"
@@ -74,6 +90,9 @@ const struct m_sub_options stream_cache_conf = {
         OPT_INTRANGE("cache-backbuffer", back_buffer, 0, 0, 0x7fffffff),
         OPT_STRING("cache-file", file, M_OPT_FILE),
         OPT_INTRANGE("cache-file-size", file_max, 0, 0, 0x7fffffff),
+        OPT_STRING("cache-dir", dir, M_OPT_FILE),
+        OPT_INTRANGE("cache-dir-size", dir_max, 0, 0, 0x7fffffff),
+        OPT_INTRANGE("cache-retain", retain, 0, 0, 0x7fffffff),
         {0}
     },
     .size = sizeof(struct mp_cache_opts),
@@ -84,9 +103,18 @@ const struct m_sub_options stream_cache_conf = {
         .seek_min = 500,
         .back_buffer = 10000,
         .file_max = 1024 * 1024,
+        .dir_max = 4 * 1024 * 1024,
     },
 };
 
+// A piece of file data that was dropped from the ringbuffer, and may be copied
+// back if the reader seeks into it again.
+struct cache_block {
+    int64_t pos;            // file position (multiple of CACHE_BLOCK_SIZE)
+    uint64_t last_used;     // for LRU eviction
+    unsigned char *data;    // CACHE_BLOCK_SIZE bytes
+};
+
 // Note: (struct priv*)(cache->priv)->cache == cache
 struct priv {
     pthread_t cache_thread;
@@ -100,9 +128,11 @@ struct priv {
     int64_t buffer_size;    // size of the allocated buffer memory
     int64_t back_size;      // keep back_size amount of old bytes for backward seek
     int64_t seek_limit;     // keep filling cache if distance is less that seek limit
+    int64_t seek_min;       // lower bound for seek_limit (--cache-seek-min)
     bool seekable;          // underlying stream is seekable
 
     struct mp_log *log;
+    struct mpv_global *global;
 
     // Owned by the main thread
     stream_t *cache;        // wrapper stream, used by demuxer etc.
@@ -127,6 +157,8 @@ struct priv {
     int64_t speed_start;    // start time (us) for calculating download speed
     int64_t speed_amount;   // bytes read since speed_start
     double speed;
+    int64_t read_size;      // current size of reads from the stream
+    double latency;         // average time (in seconds) a read call takes
 
     bool enable_readahead;  // actively read beyond read() position
     int64_t read_filepos;   // client read position (mirrors cache->pos)
@@ -137,6 +169,12 @@ struct priv {
 
     bool read_seek_failed;  // let a read fail because an async seek failed
 
+    // Retained blocks of previously cached, disjoint file ranges
+    struct cache_block *blocks;
+    int num_blocks;
+    int max_blocks;         // from --cache-retain
+    uint64_t block_age;
+
     int control;            // requested STREAM_CTRL_... or CACHE_CTRL_...
     void *control_arg;      // temporary for executing STREAM_CTRLs
     int control_res;
@@ -190,6 +228,31 @@ static void cache_drop_contents(struct priv *s)
     s->start_pts = MP_NOPTS_VALUE;
 }
 
+static void free_blocks(struct priv *s)
+{
+    for (int n = 0; n < s->num_blocks; n++)
+        free(s->blocks[n].data);
+    mp_mem_account(MP_MEM_STREAM_CACHE, -(int64_t)s->num_blocks * CACHE_BLOCK_SIZE);
+    s->num_blocks = 0;
+}
+
+static struct cache_block *find_block(struct priv *s, int64_t pos)
+{
+    for (int n = 0; n < s->num_blocks; n++) {
+        struct cache_block *b = &s->blocks[n];
+        if (pos >= b->pos && pos < b->pos + CACHE_BLOCK_SIZE)
+            return b;
+    }
+    return NULL;
+}
+
+static void remove_block(struct priv *s, struct cache_block *b)
+{
+    free(b->data);
+    *b = s->blocks[s->num_blocks - 1];
+    s->num_blocks--;
+}
+
 static void update_speed(struct priv *s)
 {
     int64_t now = mp_time_us();
@@ -200,6 +263,30 @@ static void update_speed(struct priv *s)
     }
 }
 
+// Adapt the read size and the seek limit to the time the last read took.
+// requested is the number of bytes asked for, len the number actually read.
+static void update_read_params(struct priv *s, int64_t requested, int len,
+                               double time)
+{
+    if (len <= 0)
+        return;
+
+    s->latency = s->latency > 0 ? s->latency * 0.875 + time * 0.125 : time;
+
+    if (len >= requested && requested >= s->read_size &&
+        time < CACHE_READ_TIME_FAST)
+    {
+        s->read_size = MPMIN(s->read_size * 2, CACHE_MAX_READ_SIZE);
+    } else if (time > CACHE_READ_TIME_SLOW) {
+        s->read_size = MPMAX(s->read_size / 2, CACHE_MIN_READ_SIZE);
+    }
+
+    // Reading ahead is cheaper than seeking if the amount of data can be
+    // downloaded in about the time a new request would take.
+    int64_t limit = MPMAX(s->seek_min, s->speed * s->latency * 2);
+    s->seek_limit = MPMIN(limit, s->buffer_size - FILL_LIMIT);
+}
+
 // Copy at most dst_size from the cache at the given absolute file position pos.
 // Return number of bytes that could actually be read.
 // Does not advance the file position, or change anything else.
@@ -244,6 +331,77 @@ static bool needs_seek(struct priv *s, int64_t pos)
     return pos < s->min_filepos || pos > s->max_filepos + s->seek_limit;
 }
 
+// Move the full blocks of the current ringbuffer contents to the retained
+// block list, newest data first, evicting the least recently used blocks.
+// Runs in the cache thread, before the ringbuffer contents are dropped.
+static void save_blocks(struct priv *s)
+{
+    if (!s->max_blocks || !s->seekable)
+        return;
+
+    int64_t end = s->max_filepos / CACHE_BLOCK_SIZE * CACHE_BLOCK_SIZE;
+    int saved = 0;
+    for (int64_t pos = end - CACHE_BLOCK_SIZE;
+         pos >= s->min_filepos && saved < s->max_blocks;
+         pos -= CACHE_BLOCK_SIZE)
+    {
+        struct cache_block *b = find_block(s, pos);
+        if (!b) {
+            if (s->num_blocks < s->max_blocks) {
+                unsigned char *data = malloc(CACHE_BLOCK_SIZE);
+                if (!data)
+                    break;
+                mp_mem_account(MP_MEM_STREAM_CACHE, CACHE_BLOCK_SIZE);
+                MP_TARRAY_APPEND(s, s->blocks, s->num_blocks,
+                                 (struct cache_block){.data = data});
+                b = &s->blocks[s->num_blocks - 1];
+            } else {
+                b = &s->blocks[0];
+                for (int n = 1; n < s->num_blocks; n++) {
+                    if (s->blocks[n].last_used < b->last_used)
+                        b = &s->blocks[n];
+                }
+                // Don't evict blocks saved by this call.
+                if (b->last_used > s->block_age - saved)
+                    break;
+            }
+        }
+        b->pos = pos;
+        b->last_used = ++s->block_age;
+        size_t r = read_buffer(s, b->data, CACHE_BLOCK_SIZE, pos);
+        assert(r == CACHE_BLOCK_SIZE);
+        saved++;
+    }
+    if (saved) {
+        MP_VERBOSE(s, "Retained %d KiB of dropped cache (%d KiB total).\n",
+                   saved * (CACHE_BLOCK_SIZE / 1024),
+                   s->num_blocks * (CACHE_BLOCK_SIZE / 1024));
+    }
+}
+
+// Copy the retained blocks starting at the one that contains read_filepos back
+// into the (empty) ringbuffer, as long as they are contiguous. The underlying
+// stream then continues reading after the restored data.
+// Runs in the cache thread, right after the ringbuffer contents were dropped.
+static void restore_blocks(struct priv *s)
+{
+    struct cache_block *b = find_block(s, s->read_filepos);
+    if (!b)
+        return;
+
+    s->offset = s->min_filepos = s->max_filepos = b->pos;
+    int64_t limit = s->buffer_size - s->back_size;
+    while (b && s->max_filepos - s->min_filepos + CACHE_BLOCK_SIZE <= limit) {
+        memcpy(&s->buffer[s->max_filepos - s->offset], b->data,
+               CACHE_BLOCK_SIZE);
+        s->max_filepos += CACHE_BLOCK_SIZE;
+        remove_block(s, b);
+        b = find_block(s, s->max_filepos);
+    }
+    MP_VERBOSE(s, "Restored cached range %"PRId64"-%"PRId64".\n",
+               s->min_filepos, s->max_filepos);
+}
+
 static bool cache_update_stream_position(struct priv *s)
 {
     int64_t read = s->read_filepos;
@@ -254,7 +412,9 @@ static bool cache_update_stream_position(struct priv *s)
         MP_VERBOSE(s, "Dropping cache at pos %"PRId64", "
                    "cached range: %"PRId64"-%"PRId64".\n", read,
                    s->min_filepos, s->max_filepos);
+        save_blocks(s);
         cache_drop_contents(s);
+        restore_blocks(s);
     }
 
     if (stream_tell(s->stream) != s->max_filepos && s->seekable) {
@@ -314,7 +474,7 @@ static void cache_fill(struct priv *s)
         space = s->buffer_size - pos;
 
     // limit read size (or else would block and read the entire buffer in 1 call)
-    space = FFMIN(space, s->stream->read_chunk);
+    space = FFMIN(space, s->read_size);
 
     // back+newb+space <= buffer_size
     int64_t back2 = s->buffer_size - (space + newb); // max back size
@@ -322,9 +482,11 @@ static void cache_fill(struct priv *s)
         s->min_filepos = read - back2;
 
     // The read call might take a long time and block, so drop the lock.
+    double start = mp_time_sec();
     pthread_mutex_unlock(&s->mutex);
     len = stream_read_partial(s->stream, &s->buffer[pos], space);
     pthread_mutex_lock(&s->mutex);
+    update_read_params(s, space, len, mp_time_sec() - start);
 
     // Do this after reading a block, because at least libdvdnav updates the
     // stream position only after actually reading something after a seek.
@@ -408,6 +570,7 @@ static int resize_cache(struct priv *s, int64_t size)
     }
 
     free(s->buffer);
+    mp_mem_account(MP_MEM_STREAM_CACHE, buffer_size - s->buffer_size);
 
     s->buffer_size = buffer_size;
     s->buffer = buffer;
@@ -458,6 +621,8 @@ static int cache_get_cached_control(stream_t *cache, int cmd, void *arg)
             .fill = s->max_filepos - s->read_filepos,
             .idle = s->idle,
             .speed = llrint(s->speed),
+            .read_size = s->read_size,
+            .latency = s->latency,
         };
         return STREAM_OK;
     case STREAM_CTRL_SET_READAHEAD:
@@ -537,6 +702,7 @@ static void cache_execute_control(struct priv *s)
         s->read_min = s->read_filepos;
         s->control_flush = true;
         cache_drop_contents(s);
+        free_blocks(s);
     }
 
     update_cached_controls(s);
@@ -548,6 +714,7 @@ static void *cache_thread(void *arg)
 {
     struct priv *s = arg;
     mpthread_set_name("cache");
+    mpthread_apply_opts(s->global, s->log, "cache");
     pthread_mutex_lock(&s->mutex);
     update_cached_controls(s);
     double last = mp_time_sec();
@@ -570,8 +737,12 @@ static void *cache_thread(void *arg)
             s->control = CACHE_CTRL_NONE;
         }
         if (s->idle && s->control == CACHE_CTRL_NONE) {
-            struct timespec ts = mp_rel_time_to_timespec(CACHE_IDLE_SLEEP_TIME);
-            pthread_cond_timedwait(&s->wakeup, &s->mutex, &ts);
+            if (s->eof) {
+                struct timespec ts = mp_rel_time_to_timespec(CACHE_IDLE_SLEEP_TIME);
+                pthread_cond_timedwait(&s->wakeup, &s->mutex, &ts);
+            } else {
+                pthread_cond_wait(&s->wakeup, &s->mutex);
+            }
         }
     }
     pthread_cond_signal(&s->wakeup);
@@ -620,7 +791,7 @@ static int cache_fill_buffer(struct stream *cache, char *buffer, int max_len)
         // can actually read new data)
         s->bytes_until_wakeup -= readb;
         if (s->bytes_until_wakeup <= 0) {
-            s->bytes_until_wakeup = MPMAX(FILL_LIMIT, s->stream->read_chunk);
+            s->bytes_until_wakeup = MPMAX(FILL_LIMIT, s->read_size);
             pthread_cond_signal(&s->wakeup);
         }
     }
@@ -725,7 +896,9 @@ static void cache_uninit(stream_t *cache)
     }
     pthread_mutex_destroy(&s->mutex);
     pthread_cond_destroy(&s->wakeup);
+    free_blocks(s);
     free(s->buffer);
+    mp_mem_account(MP_MEM_STREAM_CACHE, -s->buffer_size);
     talloc_free(s);
 }
 
@@ -739,6 +912,7 @@ int stream_cache_init(stream_t *cache, stream_t *stream,
 
     struct priv *s = talloc_zero(NULL, struct priv);
     s->log = cache->log;
+    s->global = cache->global;
     s->eof_pos = -1;
     s->enable_readahead = true;
 
@@ -746,8 +920,11 @@ int stream_cache_init(stream_t *cache, stream_t *stream,
 
     s->speed_start = mp_time_us();
 
-    s->seek_limit = opts->seek_min * 1024ULL;
+    s->seek_min = s->seek_limit = opts->seek_min * 1024ULL;
+    s->read_size = MPCLAMP(stream->read_chunk, CACHE_MIN_READ_SIZE,
+                           CACHE_MAX_READ_SIZE);
     s->back_size = opts->back_buffer * 1024ULL;
+    s->max_blocks = opts->retain * 1024ULL / CACHE_BLOCK_SIZE;
 
     s->stream_size = stream_get_size(stream);
 
@@ -15,8 +15,17 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "config.h"
+
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <libavutil/md5.h>
 
 #include "osdep/io.h"
 
@@ -24,18 +33,42 @@
 #include "common/msg.h"
 
 #include "options/options.h"
+#include "options/path.h"
 
 #include "stream.h"
 
+#if HAVE_LIBURING
+#include "uring.h"
+#endif
+
 #define BLOCK_SIZE 1024LL
 #define BLOCK_ALIGN(p) ((p) & ~(BLOCK_SIZE - 1))
 
+// Header of the ".bits" file next to each file in --cache-dir, followed by
+// the block_bits array.
+#define HEADER_MAGIC "mpvfc01"
+
+struct cache_header {
+    char magic[8];
+    int64_t size;           // stream size, must match to reuse the entry
+    int64_t cached;         // number of bytes in blocks marked as read
+};
+
 struct priv {
     struct stream *original;
     FILE *cache_file;
+    // If non-NULL, cache_file is accessed only through this (--file-io-uring).
+    struct mp_uring_file *uring;
     uint8_t *block_bits;    // 1 bit for each BLOCK_SIZE, whether block was read
+    size_t block_bits_size;
     int64_t size;           // currently known size
     int64_t max_size;       // max. size for block_bits and cache_file
+
+    // Only set for --cache-dir
+    char *dir;
+    char *bits_path;
+    int64_t cached;         // bytes in blocks marked as read
+    int64_t dir_max;        // max. total size of the cache directory
 };
 
 static bool test_bit(struct priv *p, int64_t pos)
@@ -55,6 +88,27 @@ static void set_bit(struct priv *p, int64_t pos, bool bit)
     p->block_bits[block / 8] = (p->block_bits[block / 8] & ~m) | (bit ? m : 0);
 }
 
+static int read_cache(struct priv *p, int64_t pos, char *buffer, int len)
+{
+#if HAVE_LIBURING
+    if (p->uring)
+        return MPMAX(mp_uring_file_read(p->uring, pos, buffer, len), 0);
+#endif
+    if (fseeko(p->cache_file, pos, SEEK_SET))
+        return -1;
+    return fread(buffer, 1, len, p->cache_file);
+}
+
+static bool write_cache(struct priv *p, int64_t pos, char *buffer, int len)
+{
+#if HAVE_LIBURING
+    if (p->uring)
+        return mp_uring_file_write(p->uring, pos, buffer, len);
+#endif
+    return fseeko(p->cache_file, pos, SEEK_SET) == 0 &&
+           fwrite(buffer, len, 1, p->cache_file) == 1;
+}
+
 static int fill_buffer(stream_t *s, char *buffer, int max_len)
 {
     struct priv *p = s->priv;
@@ -72,6 +126,11 @@ static int fill_buffer(stream_t *s, char *buffer, int max_len)
             set_bit(p, BLOCK_ALIGN(p->size), 0);
         p->size = MPMIN(p->max_size, new_size);
     }
+    // align/limit to blocks
+    max_len = MPMIN(max_len, BLOCK_SIZE - (s->pos % BLOCK_SIZE));
+    // Limit to max. known file size
+    if (p->size >= 0)
+        max_len = MPMIN(max_len, p->size - s->pos);
     int64_t aligned = BLOCK_ALIGN(s->pos);
     if (!test_bit(p, aligned)) {
         char tmp[BLOCK_SIZE];
@@ -85,20 +144,17 @@ static int fill_buffer(stream_t *s, char *buffer, int max_len)
                 return -1;
             }
         }
-        if (fseeko(p->cache_file, aligned, SEEK_SET))
-            return -1;
-        if (fwrite(tmp, r, 1, p->cache_file) != 1)
+        if (r <= 0 || !write_cache(p, aligned, tmp, r))
             return -1;
         set_bit(p, aligned, 1);
+        p->cached += r;
+        // Serve the block directly instead of reading it back.
+        int skip = s->pos - aligned;
+        max_len = MPMAX(MPMIN(max_len, r - skip), 0);
+        memcpy(buffer, tmp + skip, max_len);
+        return max_len;
     }
-    if (fseeko(p->cache_file, s->pos, SEEK_SET))
-        return -1;
-    // align/limit to blocks
-    max_len = MPMIN(max_len, BLOCK_SIZE - (s->pos % BLOCK_SIZE));
-    // Limit to max. known file size
-    if (p->size >= 0)
-        max_len = MPMIN(max_len, p->size - s->pos);
-    return fread(buffer, 1, max_len, p->cache_file);
+    return read_cache(p, s->pos, buffer, max_len);
 }
 
 static int seek(stream_t *s, int64_t newpos)
@@ -112,42 +168,205 @@ static int control(stream_t *s, int cmd, void *arg)
     return stream_control(p->original, cmd, arg);
 }
 
+static bool read_header(const char *path, struct cache_header *h)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    bool ok = fread(h, sizeof(*h), 1, f) == 1 &&
+              memcmp(h->magic, HEADER_MAGIC, sizeof(h->magic)) == 0;
+    fclose(f);
+    return ok;
+}
+
+static void save_bits(stream_t *s)
+{
+    struct priv *p = s->priv;
+    struct cache_header h = {.magic = HEADER_MAGIC, .size = p->size,
+                             .cached = p->cached};
+    FILE *f = fopen(p->bits_path, "wb");
+    if (!f || fwrite(&h, sizeof(h), 1, f) != 1 ||
+        fwrite(p->block_bits, p->block_bits_size, 1, f) != 1)
+    {
+        MP_WARN(s, "can't write '%s'\n", p->bits_path);
+    }
+    if (f)
+        fclose(f);
+}
+
+struct dir_entry {
+    char *path;             // data file; the ".bits" file is path + ".bits"
+    int64_t cached;
+    time_t mtime;
+};
+
+static int compare_mtime(const void *a, const void *b)
+{
+    const struct dir_entry *e1 = a, *e2 = b;
+    return e1->mtime < e2->mtime ? -1 : (e1->mtime > e2->mtime ? 1 : 0);
+}
+
+// Delete the least recently used entries until the --cache-dir total is
+// below --cache-dir-size. The entry of the stream itself is never deleted.
+static void evict_entries(stream_t *s)
+{
+    struct priv *p = s->priv;
+    DIR *d = opendir(p->dir);
+    if (!d)
+        return;
+
+    void *tmp = talloc_new(NULL);
+    struct dir_entry *entries = NULL;
+    int num_entries = 0;
+    int64_t total = p->cached;
+
+    struct dirent *ep;
+    while ((ep = readdir(d))) {
+        char *bits = mp_path_join(tmp, p->dir, ep->d_name);
+        bstr root = bstr0(bits);
+        if (ep->d_name[0] == '.' || strcmp(bits, p->bits_path) == 0 ||
+            !bstr_eatend0(&root, ".bits"))
+            continue;
+        struct cache_header h;
+        struct stat st;
+        if (!read_header(bits, &h) || stat(bits, &st) != 0)
+            continue;
+        struct dir_entry e = {bstrdup0(tmp, root), h.cached, st.st_mtime};
+        MP_TARRAY_APPEND(tmp, entries, num_entries, e);
+        total += h.cached;
+    }
+    closedir(d);
+
+    qsort(entries, num_entries, sizeof(entries[0]), compare_mtime);
+    for (int n = 0; n < num_entries && total > p->dir_max; n++) {
+        MP_VERBOSE(s, "removing cache entry '%s'\n", entries[n].path);
+        unlink(entries[n].path);
+        unlink(talloc_asprintf(tmp, "%s.bits", entries[n].path));
+        total -= entries[n].cached;
+    }
+
+    talloc_free(tmp);
+}
+
 static void s_close(stream_t *s)
 {
     struct priv *p = s->priv;
+#if HAVE_LIBURING
+    TA_FREEP(&p->uring); // waits for queued writes
+#endif
     if (p->cache_file)
         fclose(p->cache_file);
+    if (p->bits_path) {
+        save_bits(s);
+        evict_entries(s);
+    }
     talloc_free(p);
 }
 
+// Open the --cache-dir entry for the stream, reusing the blocks from a
+// previous session if the entry is still valid for the stream.
+static FILE *open_dir_entry(stream_t *cache, stream_t *stream,
+                            struct mp_cache_opts *opts)
+{
+    struct priv *p = cache->priv;
+
+    // There is no ETag or Last-Modified from libavformat, so the URL and the
+    // size are what identifies the contents.
+    int64_t size = stream_get_size(stream);
+    if (size <= 0 || size > p->max_size) {
+        MP_VERBOSE(cache, "not using --cache-dir for this stream\n");
+        return NULL;
+    }
+
+    p->dir = mp_get_user_path(p, stream->global, opts->dir);
+    mp_mkdirp(p->dir);
+    p->dir_max = opts->dir_max * 1024LL;
+
+    char *key = talloc_asprintf(p, "%s %"PRId64, stream->url, size);
+    uint8_t md5[16];
+    av_md5_sum(md5, key, strlen(key));
+    char name[33];
+    for (int i = 0; i < 16; i++)
+        snprintf(name + i * 2, 3, "%02X", md5[i]);
+    char *path = mp_path_join(p, p->dir, name);
+    p->bits_path = talloc_asprintf(p, "%s.bits", path);
+
+    struct cache_header h;
+    FILE *f = NULL;
+    bool valid = read_header(p->bits_path, &h) && h.size == size;
+    if (valid) {
+        FILE *bits = fopen(p->bits_path, "rb");
+        valid = bits && fseeko(bits, sizeof(h), SEEK_SET) == 0 &&
+                fread(p->block_bits, p->block_bits_size, 1, bits) == 1;
+        if (bits)
+            fclose(bits);
+    }
+    if (valid)
+        f = fopen(path, "rb+");
+    if (f) {
+        p->cached = h.cached;
+        MP_VERBOSE(cache, "reusing %"PRId64" bytes from '%s'\n", h.cached, path);
+    } else {
+        memset(p->block_bits, 0, p->block_bits_size);
+        f = fopen(path, "wb+");
+    }
+    if (!f) {
+        MP_ERR(cache, "can't open cache file '%s'\n", path);
+        p->bits_path = NULL;
+        return NULL;
+    }
+    p->size = size;
+    return f;
+}
+
 // return 1 on success, 0 if disabled, -1 on error
 int stream_file_cache_init(stream_t *cache, stream_t *stream,
                            struct mp_cache_opts *opts)
 {
-    if (!opts->file || !opts->file[0] || opts->file_max < 1)
+    bool use_dir = (!opts->file || !opts->file[0]) && opts->dir &&
+                   opts->dir[0] && stream->is_network;
+    if ((!use_dir && (!opts->file || !opts->file[0])) || opts->file_max < 1)
         return 0;
 
     if (!stream->seekable) {
+        if (use_dir)
+            return 0;
         MP_ERR(cache, "can't cache unseekable stream\n");
         return -1;
     }
 
-    bool use_anon_file = strcmp(opts->file, "TMP") == 0;
-    FILE *file = use_anon_file ? tmpfile() : fopen(opts->file, "wb+");
-    if (!file) {
-        MP_ERR(cache, "can't open cache file '%s'\n", opts->file);
-        return -1;
-    }
-
     struct priv *p = talloc_zero(NULL, struct priv);
 
     cache->priv = p;
     p->original = stream;
-    p->cache_file = file;
     p->max_size = opts->file_max * 1024LL;
 
     // file_max can be INT_MAX, so this is at most about 256MB
-    p->block_bits = talloc_zero_size(p, (p->max_size / BLOCK_SIZE + 1) / 8 + 1);
+    p->block_bits_size = (p->max_size / BLOCK_SIZE + 1) / 8 + 1;
+    p->block_bits = talloc_zero_size(p, p->block_bits_size);
+
+    FILE *file;
+    if (use_dir) {
+        file = open_dir_entry(cache, stream, opts);
+        if (!file) {
+            talloc_free(p);
+            cache->priv = NULL;
+            return 0;
+        }
+    } else {
+        bool use_anon_file = strcmp(opts->file, "TMP") == 0;
+        file = use_anon_file ? tmpfile() : fopen(opts->file, "wb+");
+        if (!file) {
+            MP_ERR(cache, "can't open cache file '%s'\n", opts->file);
+            talloc_free(p);
+            cache->priv = NULL;
+            return -1;
+        }
+    }
+    p->cache_file = file;
+#if HAVE_LIBURING
+    p->uring = mp_uring_file_create(p, cache->global, cache->log, fileno(file));
+#endif
 
     cache->seek = seek;
     cache->fill_buffer = fill_buffer;
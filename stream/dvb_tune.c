@@ -346,6 +346,69 @@ int dvb_get_pmt_pid(dvb_priv_t *priv, int devno, int service_id)
     return pmt_pid;
 }
 
+int dvb_get_pmt_es_pids(dvb_priv_t *priv, int devno, int service_id,
+                        int pmt_pid, int *pids, int max)
+{
+    char demux_dev[PATH_MAX];
+    snprintf(demux_dev, sizeof(demux_dev), "/dev/dvb/adapter%d/demux0", devno);
+
+    /* Match table_id 0x02 (PMT) and the program number of the service. */
+    struct dmx_sct_filter_params fparams;
+
+    memset(&fparams, 0x00, sizeof(fparams));
+    fparams.pid = pmt_pid;
+    fparams.filter.filter[0] = 0x02;
+    fparams.filter.mask[0] = 0xff;
+    fparams.filter.filter[1] = (service_id >> 8) & 0xff;
+    fparams.filter.mask[1] = 0xff;
+    fparams.filter.filter[2] = service_id & 0xff;
+    fparams.filter.mask[2] = 0xff;
+    fparams.timeout = 2000;
+    fparams.flags = DMX_IMMEDIATE_START | DMX_CHECK_CRC | DMX_ONESHOT;
+
+    int pmt_fd;
+    if ((pmt_fd = open(demux_dev, O_RDWR | O_CLOEXEC)) < 0) {
+        MP_ERR(priv, "Opening PMT DEMUX failed, error: %d\n", errno);
+        return -1;
+    }
+
+    if (ioctl(pmt_fd, DMX_SET_FILTER, &fparams) < 0) {
+        MP_ERR(priv, "ioctl DMX_SET_FILTER failed, error: %d\n", errno);
+        close(pmt_fd);
+        return -1;
+    }
+
+    unsigned char buft[4096];
+    int bytes_read = read(pmt_fd, buft, sizeof(buft));
+    if (bytes_read < 0 && errno == EOVERFLOW)
+        bytes_read = read(pmt_fd, buft, sizeof(buft));
+    close(pmt_fd);
+    if (bytes_read < 16) {
+        MP_ERR(priv, "PMT: read_sections: read error: %d\n", errno);
+        return -1;
+    }
+
+    int section_length = ((buft[1] & 0x0f) << 8) | buft[2];
+    int end = section_length + 3;
+    if (end > bytes_read)
+        end = bytes_read;
+    end -= 4; // CRC32
+
+    int cnt = 0;
+    int pcr_pid = ((buft[8] & 0x1f) << 8) | buft[9];
+    if (pcr_pid != 0x1fff && cnt < max)
+        pids[cnt++] = pcr_pid;
+
+    /* Skip the program info descriptors, then walk the elementary streams. */
+    int pos = 12 + (((buft[10] & 0x0f) << 8) | buft[11]);
+    while (pos + 5 <= end && cnt < max) {
+        pids[cnt++] = ((buft[pos + 1] & 0x1f) << 8) | buft[pos + 2];
+        pos += 5 + (((buft[pos + 3] & 0x0f) << 8) | buft[pos + 4]);
+    }
+
+    return cnt;
+}
+
 static void print_status(dvb_priv_t *priv, fe_status_t festatus)
 {
     MP_VERBOSE(priv, "FE_STATUS:");
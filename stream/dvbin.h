@@ -127,6 +127,7 @@ typedef struct {
     char *cfg_file;
 
     int cfg_full_transponder;
+    char **cfg_extra_progs;
 } dvb_priv_t;
 
 
@@ -24,6 +24,7 @@
 
 #include <strings.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include <libavutil/common.h>
 #include "osdep/atomic.h"
@@ -386,6 +387,12 @@ int stream_read_partial(stream_t *s, char *buf, int buf_size)
         // Also, small reads will be more efficient with buffering & copying
         if (!s->sector_size && buf_size >= STREAM_BUFFER_SIZE)
             return stream_read_unbuffered(s, buf, buf_size);
+        // With sectors, read as many whole sectors as fit (the cache relies
+        // on this to read in large chunks from disc streams).
+        if (s->sector_size && buf_size >= s->sector_size * 2) {
+            int len = buf_size / s->sector_size * s->sector_size;
+            return stream_read_unbuffered(s, buf, len);
+        }
         if (!stream_fill_buffer(s))
             return 0;
     }
@@ -593,7 +600,7 @@ void free_stream(stream_t *s)
     talloc_free(s);
 }
 
-stream_t *open_memory_stream(void *data, int len)
+static stream_t *create_memory_stream(void *data, int len, int ctrl)
 {
     assert(len >= 0);
     struct mpv_global *dummy = talloc_zero(NULL, struct mpv_global);
@@ -601,10 +608,23 @@ stream_t *open_memory_stream(void *data, int len)
     stream_t *s = stream_open("memory://", dummy);
     assert(s);
     talloc_steal(s, dummy);
-    stream_control(s, STREAM_CTRL_SET_CONTENTS, &(bstr){data, len});
+    stream_control(s, ctrl, &(bstr){data, len});
     return s;
 }
 
+stream_t *open_memory_stream(void *data, int len)
+{
+    return create_memory_stream(data, len, STREAM_CTRL_SET_CONTENTS);
+}
+
+// Like open_memory_stream(), but reference the data instead of copying it.
+// The caller must keep data valid and unchanged until the stream is freed
+// (e.g. by talloc_steal()ing it to the stream).
+stream_t *open_memory_stream_ref(void *data, int len)
+{
+    return create_memory_stream(data, len, STREAM_CTRL_SET_CONTENTS_REF);
+}
+
 static stream_t *open_cache(stream_t *orig, const char *name)
 {
     stream_t *cache = new_stream();
@@ -841,19 +861,74 @@ struct bstr stream_read_file(const char *filename, void *talloc_ctx,
     return res;
 }
 
-#ifndef __MINGW32__
 struct mp_cancel {
     atomic_bool triggered;
+#ifdef __MINGW32__
+    HANDLE event;
+#else
     int wakeup_pipe[2];
+#endif
+    // --- protected by cancel_tree_lock
+    struct mp_cancel *parent;
+    struct mp_cancel **slaves;
+    int num_slaves;
 };
 
+// Protects the parent/slave relations of all mp_cancel instances.
+static pthread_mutex_t cancel_tree_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void cancel_signal(struct mp_cancel *c)
+{
+    atomic_store(&c->triggered, true);
+#ifdef __MINGW32__
+    SetEvent(c->event);
+#else
+    (void)write(c->wakeup_pipe[1], &(char){0}, 1);
+#endif
+}
+
+// Call with cancel_tree_lock held.
+static void cancel_trigger_locked(struct mp_cancel *c)
+{
+    cancel_signal(c);
+    for (int n = 0; n < c->num_slaves; n++)
+        cancel_trigger_locked(c->slaves[n]);
+}
+
+// Call with cancel_tree_lock held.
+static void cancel_remove_from_parent(struct mp_cancel *c)
+{
+    struct mp_cancel *parent = c->parent;
+    if (!parent)
+        return;
+    for (int n = 0; n < parent->num_slaves; n++) {
+        if (parent->slaves[n] == c) {
+            MP_TARRAY_REMOVE_AT(parent->slaves, parent->num_slaves, n);
+            break;
+        }
+    }
+    c->parent = NULL;
+}
+
 static void cancel_destroy(void *p)
 {
     struct mp_cancel *c = p;
+
+    pthread_mutex_lock(&cancel_tree_lock);
+    cancel_remove_from_parent(c);
+    for (int n = 0; n < c->num_slaves; n++)
+        c->slaves[n]->parent = NULL;
+    pthread_mutex_unlock(&cancel_tree_lock);
+    talloc_free(c->slaves);
+
+#ifdef __MINGW32__
+    CloseHandle(c->event);
+#else
     if (c->wakeup_pipe[0] >= 0) {
         close(c->wakeup_pipe[0]);
         close(c->wakeup_pipe[1]);
     }
+#endif
 }
 
 struct mp_cancel *mp_cancel_new(void *talloc_ctx)
@@ -861,21 +936,46 @@ struct mp_cancel *mp_cancel_new(void *talloc_ctx)
     struct mp_cancel *c = talloc_ptrtype(talloc_ctx, c);
     talloc_set_destructor(c, cancel_destroy);
     *c = (struct mp_cancel){.triggered = ATOMIC_VAR_INIT(false)};
+#ifdef __MINGW32__
+    c->event = CreateEventW(NULL, TRUE, FALSE, NULL);
+#else
     mp_make_wakeup_pipe(c->wakeup_pipe);
+#endif
     return c;
 }
 
-// Request abort.
+// Request abort. This also triggers all slaves (see mp_cancel_set_parent()).
 void mp_cancel_trigger(struct mp_cancel *c)
 {
-    atomic_store(&c->triggered, true);
-    (void)write(c->wakeup_pipe[1], &(char){0}, 1);
+    pthread_mutex_lock(&cancel_tree_lock);
+    cancel_trigger_locked(c);
+    pthread_mutex_unlock(&cancel_tree_lock);
+}
+
+// Make slave get triggered whenever parent is triggered (including if parent
+// is already triggered). Triggering slave doesn't affect parent. Pass NULL to
+// remove the relation. The relation is removed automatically if either of them
+// is destroyed.
+void mp_cancel_set_parent(struct mp_cancel *slave, struct mp_cancel *parent)
+{
+    pthread_mutex_lock(&cancel_tree_lock);
+    cancel_remove_from_parent(slave);
+    if (parent) {
+        MP_TARRAY_APPEND(NULL, parent->slaves, parent->num_slaves, slave);
+        slave->parent = parent;
+        if (mp_cancel_test(parent))
+            cancel_trigger_locked(slave);
+    }
+    pthread_mutex_unlock(&cancel_tree_lock);
 }
 
 // Restore original state. (Allows reusing a mp_cancel.)
 void mp_cancel_reset(struct mp_cancel *c)
 {
     atomic_store(&c->triggered, false);
+#ifdef __MINGW32__
+    ResetEvent(c->event);
+#else
     // Flush it fully.
     while (1) {
         int r = read(c->wakeup_pipe[0], &(char[256]){0}, 256);
@@ -884,6 +984,7 @@ void mp_cancel_reset(struct mp_cancel *c)
         if (r <= 0)
             break;
     }
+#endif
 }
 
 // Return whether the caller should abort.
@@ -897,74 +998,33 @@ bool mp_cancel_test(struct mp_cancel *c)
 // false. timeout==0 polls, timeout<0 waits forever.
 bool mp_cancel_wait(struct mp_cancel *c, double timeout)
 {
+#ifdef __MINGW32__
+    return WaitForSingleObject(c->event, timeout < 0 ? INFINITE : timeout * 1000)
+            == WAIT_OBJECT_0;
+#else
     struct pollfd fd = { .fd = c->wakeup_pipe[0], .events = POLLIN };
     poll(&fd, 1, timeout * 1000);
     return fd.revents & POLLIN;
+#endif
 }
 
-// The FD becomes readable if mp_cancel_test() would return true.
-// Don't actually read from it, just use it for poll().
-int mp_cancel_get_fd(struct mp_cancel *c)
-{
-    return c->wakeup_pipe[0];
-}
-
-#else
-
-struct mp_cancel {
-    atomic_bool triggered;
-    HANDLE event;
-};
-
-static void cancel_destroy(void *p)
-{
-    struct mp_cancel *c = p;
-    CloseHandle(c->event);
-}
-
-struct mp_cancel *mp_cancel_new(void *talloc_ctx)
-{
-    struct mp_cancel *c = talloc_ptrtype(talloc_ctx, c);
-    talloc_set_destructor(c, cancel_destroy);
-    *c = (struct mp_cancel){.triggered = ATOMIC_VAR_INIT(false)};
-    c->event = CreateEventW(NULL, TRUE, FALSE, NULL);
-    return c;
-}
-
-void mp_cancel_trigger(struct mp_cancel *c)
-{
-    atomic_store(&c->triggered, true);
-    SetEvent(c->event);
-}
-
-void mp_cancel_reset(struct mp_cancel *c)
-{
-    atomic_store(&c->triggered, false);
-    ResetEvent(c->event);
-}
-
-bool mp_cancel_test(struct mp_cancel *c)
-{
-    return c ? atomic_load_explicit(&c->triggered, memory_order_relaxed) : false;
-}
-
-bool mp_cancel_wait(struct mp_cancel *c, double timeout)
-{
-    return WaitForSingleObject(c->event, timeout < 0 ? INFINITE : timeout * 1000)
-            == WAIT_OBJECT_0;
-}
-
+#ifdef __MINGW32__
 void *mp_cancel_get_event(struct mp_cancel *c)
 {
     return c->event;
 }
+#endif
 
+// The FD becomes readable if mp_cancel_test() would return true.
+// Don't actually read from it, just use it for poll().
 int mp_cancel_get_fd(struct mp_cancel *c)
 {
+#ifdef __MINGW32__
     return -1;
-}
-
+#else
+    return c->wakeup_pipe[0];
 #endif
+}
 
 char **stream_get_proto_list(void)
 {
@@ -59,6 +59,7 @@ enum stream_ctrl {
 
     // stream_memory.c
     STREAM_CTRL_SET_CONTENTS,
+    STREAM_CTRL_SET_CONTENTS_REF,
 
     // stream_rar.c
     STREAM_CTRL_GET_BASE_FILENAME,
@@ -110,6 +111,8 @@ struct stream_cache_info {
     int64_t fill;
     bool idle;
     int64_t speed;
+    int64_t read_size;  // current size of reads from the source stream
+    double latency;     // average duration of a read from the source stream
 };
 
 struct stream_lang_req {
@@ -250,6 +253,7 @@ struct stream *stream_create(const char *url, int flags,
 struct stream *stream_open(const char *filename, struct mpv_global *global);
 stream_t *open_output_stream(const char *filename, struct mpv_global *global);
 stream_t *open_memory_stream(void *data, int len);
+stream_t *open_memory_stream_ref(void *data, int len);
 
 void mp_url_unescape_inplace(char *buf);
 char *mp_url_escape(void *talloc_ctx, const char *s, const char *ok);
@@ -259,6 +263,7 @@ void mp_cancel_trigger(struct mp_cancel *c);
 bool mp_cancel_test(struct mp_cancel *c);
 bool mp_cancel_wait(struct mp_cancel *c, double timeout);
 void mp_cancel_reset(struct mp_cancel *c);
+void mp_cancel_set_parent(struct mp_cancel *slave, struct mp_cancel *parent);
 void *mp_cancel_get_event(struct mp_cancel *c); // win32 HANDLE
 int mp_cancel_get_fd(struct mp_cancel *c);
 
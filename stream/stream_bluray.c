@@ -50,6 +50,9 @@
 #include "video/mp_image.h"
 
 #define BLURAY_SECTOR_SIZE     6144
+// Initial read size for the cache; libbluray reads across clip boundaries
+// within a single bd_read() call.
+#define BLURAY_READ_CHUNK      (32 * BLURAY_SECTOR_SIZE)
 
 #define BLURAY_DEFAULT_ANGLE      0
 #define BLURAY_DEFAULT_CHAPTER    0
@@ -451,6 +454,7 @@ static int bluray_stream_open_internal(stream_t *s)
     s->close       = bluray_stream_close;
     s->control     = bluray_stream_control;
     s->sector_size = BLURAY_SECTOR_SIZE;
+    s->read_chunk  = BLURAY_READ_CHUNK;
     s->priv        = b;
     s->demuxer     = "+disc";
 
@@ -18,20 +18,45 @@
 #include "player/client.h"
 #include "libmpv/stream_cb.h"
 
+// Amount of data hinted ahead of the read position with prefetch_fn.
+#define PREFETCH_SIZE (4 * 1024 * 1024)
+
 struct priv {
     mpv_stream_cb_info info;
+    int64_t pos;            // current position of the user stream
+    int64_t prefetch_end;   // end of the last hinted range
 };
 
+static void prefetch(struct priv *p, int64_t pos)
+{
+    if (!p->info.prefetch_fn)
+        return;
+    p->info.prefetch_fn(p->info.cookie, pos, PREFETCH_SIZE);
+    p->prefetch_end = pos + PREFETCH_SIZE;
+}
+
 static int fill_buffer(stream_t *s, char *buffer, int max_len)
 {
     struct priv *p = s->priv;
-    return (int)p->info.read_fn(p->info.cookie, buffer, (size_t)max_len);
+    int r = (int)p->info.read_fn(p->info.cookie, buffer, (size_t)max_len);
+    if (r > 0) {
+        p->pos += r;
+        // Keep at least half of the prefetch range ahead of the reader.
+        if (p->prefetch_end - p->pos < PREFETCH_SIZE / 2)
+            prefetch(p, MPMAX(p->prefetch_end, p->pos));
+    }
+    return r;
 }
 
 static int seek(stream_t *s, int64_t newpos)
 {
     struct priv *p = s->priv;
-    return p->info.seek_fn(p->info.cookie, newpos) >= 0;
+    if (p->info.seek_fn(p->info.cookie, newpos) < 0)
+        return 0;
+    p->pos = newpos;
+    if (newpos < p->prefetch_end - PREFETCH_SIZE || newpos >= p->prefetch_end)
+        prefetch(p, newpos);
+    return 1;
 }
 
 static int control(stream_t *s, int cmd, void *arg)
@@ -60,7 +85,7 @@ static void s_close(stream_t *s)
 
 static int open_cb(stream_t *stream)
 {
-    struct priv *p = talloc_ptrtype(stream, p);
+    struct priv *p = talloc_zero(stream, struct priv);
     stream->priv = p;
 
     bstr bproto = mp_split_proto(bstr0(stream->url), NULL);
@@ -98,6 +123,8 @@ static int open_cb(stream_t *stream)
     stream->read_chunk = 64 * 1024;
     stream->close = s_close;
 
+    prefetch(p, 0);
+
     return STREAM_OK;
 }
 
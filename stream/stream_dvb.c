@@ -77,6 +77,7 @@ const struct m_sub_options stream_dvb_conf = {
         OPT_INTRANGE("timeout", cfg_timeout, 0, 1, 30),
         OPT_STRING("file", cfg_file, M_OPT_FILE),
         OPT_FLAG("full-transponder", cfg_full_transponder, 0),
+        OPT_STRINGLIST("extra-progs", cfg_extra_progs, 0),
         {0}
     },
     .size = sizeof(dvb_priv_t),
@@ -760,6 +761,113 @@ static int dvb_streaming_read(stream_t *stream, char *buffer, int size)
     return pos;
 }
 
+static bool add_pid(stream_t *stream, int *pids, int *pids_cnt, int pid)
+{
+    for (int i = 0; i < *pids_cnt; i++) {
+        if (pids[i] == pid)
+            return true;
+    }
+    if (*pids_cnt >= DMX_FILTER_SIZE) {
+        MP_WARN(stream, "Maximum number of PIDs reached, not filtering PID %d.\n",
+                pid);
+        return false;
+    }
+    pids[(*pids_cnt)++] = pid;
+    return true;
+}
+
+// Add the PIDs of the channel to the filter list. On first use, this resolves
+// the PMT-PID, and adds the streams listed in the PMT to the channel's PIDs.
+static void add_channel_pids(stream_t *stream, int devno,
+                             dvb_channel_t *channel, int *pids, int *pids_cnt)
+{
+    dvb_priv_t *priv = stream->priv;
+
+    for (int i = 0; i < channel->pids_cnt; i++) {
+        if (channel->pids[i] != -1)
+            continue;
+        /* We need the PMT-PID in addition.
+           If it has not yet beem resolved, do it now. */
+        MP_VERBOSE(stream, "DVB_SET_CHANNEL: PMT-PID for service %d "
+                   "not resolved yet, parsing PAT...\n", channel->service_id);
+        int pmt_pid = dvb_get_pmt_pid(priv, devno, channel->service_id);
+        MP_VERBOSE(stream, "DVB_SET_CHANNEL: Found PMT-PID: %d\n", pmt_pid);
+        channel->pids[i] = pmt_pid;
+        if (pmt_pid == -1)
+            break;
+
+        /* The channels.conf often lists only some of the audio PIDs, and
+           no subtitles. Take all elementary streams from the PMT. */
+        int es_pids[DMX_FILTER_SIZE];
+        int es_cnt = dvb_get_pmt_es_pids(priv, devno, channel->service_id,
+                                         pmt_pid, es_pids, DMX_FILTER_SIZE);
+        for (int n = 0; n < es_cnt; n++) {
+            bool found = false;
+            for (int j = 0; j < channel->pids_cnt; j++)
+                found |= channel->pids[j] == es_pids[n];
+            if (found || channel->pids_cnt >= DMX_FILTER_SIZE)
+                continue;
+            MP_VERBOSE(stream, "DVB_SET_CHANNEL: Adding PID %d from PMT\n",
+                       es_pids[n]);
+            channel->pids[channel->pids_cnt++] = es_pids[n];
+        }
+        break;
+    }
+
+    for (int i = 0; i < channel->pids_cnt; i++) {
+        if (channel->pids[i] == -1) {
+            // In case PMT was not resolved, skip it here.
+            MP_ERR(stream, "DVB_SET_CHANNEL: PMT-PID not found, "
+                           "teletext-decoding may fail.\n");
+            continue;
+        }
+        if (!add_pid(stream, pids, pids_cnt, channel->pids[i]))
+            break;
+    }
+}
+
+// Add the PIDs of the --dvbin-extra-progs channels, which are received
+// alongside the main channel (e.g. for recording them with --stream-record).
+static void add_extra_progs_pids(stream_t *stream, int devno,
+                                 dvb_channels_list_t *list,
+                                 dvb_channel_t *channel, int *pids,
+                                 int *pids_cnt)
+{
+    dvb_priv_t *priv = stream->priv;
+
+    for (int n = 0; priv->cfg_extra_progs && priv->cfg_extra_progs[n]; n++) {
+        char *progname = priv->cfg_extra_progs[n];
+        dvb_channel_t *extra = NULL;
+        for (unsigned int i = 0; i < list->NUM_CHANNELS; i++) {
+            if (!strcmp(list->channels[i].name, progname)) {
+                extra = &list->channels[i];
+                break;
+            }
+        }
+        if (!extra) {
+            MP_WARN(stream, "Extra program '%s' not found.\n", progname);
+            continue;
+        }
+        if (extra == channel)
+            continue;
+        if (extra->freq != channel->freq || extra->pol != channel->pol ||
+            extra->frontend != channel->frontend ||
+            extra->stream_id != channel->stream_id)
+        {
+            MP_WARN(stream, "Extra program '%s' is not on the transponder of "
+                    "'%s', skipping.\n", progname, channel->name);
+            continue;
+        }
+        if (extra->pids_cnt == 1 && extra->pids[0] == 8192) {
+            MP_WARN(stream, "Extra program '%s' requests the full transponder, "
+                    "skipping.\n", progname);
+            continue;
+        }
+        MP_VERBOSE(stream, "Adding PIDs of extra program '%s'.\n", progname);
+        add_channel_pids(stream, devno, extra, pids, pids_cnt);
+    }
+}
+
 int dvb_set_channel(stream_t *stream, unsigned int adapter, unsigned int n)
 {
     dvb_channels_list_t *new_list;
@@ -836,33 +944,21 @@ int dvb_set_channel(stream_t *stream, unsigned int adapter, unsigned int n)
     state->cur_adapter = adapter;
     state->cur_frontend = channel->frontend;
 
-    if (channel->service_id != -1) {
-        /* We need the PMT-PID in addition.
-           If it has not yet beem resolved, do it now. */
-        for (i = 0; i < channel->pids_cnt; i++) {
-            if (channel->pids[i] == -1) {
-                MP_VERBOSE(stream, "DVB_SET_CHANNEL: PMT-PID for service %d "
-                           "not resolved yet, parsing PAT...\n",
-                           channel->service_id);
-                int pmt_pid = dvb_get_pmt_pid(priv, adapter, channel->service_id);
-                MP_VERBOSE(stream, "DVB_SET_CHANNEL: Found PMT-PID: %d\n",
-                           pmt_pid);
-                channel->pids[i] = pmt_pid;
-            }
-        }
-    }
+    int pids[DMX_FILTER_SIZE];
+    int pids_cnt = 0;
+    add_channel_pids(stream, devno, channel, pids, &pids_cnt);
+    if (!(pids_cnt == 1 && pids[0] == 8192))
+        add_extra_progs_pids(stream, devno, new_list, channel, pids, &pids_cnt);
+
+    // close or open demux_fds if the PMT or extra programs changed the count
+    if (!dvb_fix_demuxes(priv, pids_cnt))
+        return 0;
 
     // sets demux filters and restart the stream
-    for (i = 0; i < channel->pids_cnt; i++) {
-        if (channel->pids[i] == -1) {
-            // In case PMT was not resolved, skip it here.
-            MP_ERR(stream, "DVB_SET_CHANNEL: PMT-PID not found, "
-                           "teletext-decoding may fail.\n");
-        } else {
-            if (!dvb_set_ts_filt(priv, state->demux_fds[i], channel->pids[i],
-                                 DMX_PES_OTHER))
-                return 0;
-        }
+    for (i = 0; i < pids_cnt; i++) {
+        if (!dvb_set_ts_filt(priv, state->demux_fds[i], pids[i],
+                             DMX_PES_OTHER))
+            return 0;
     }
 
     return 1;
@@ -30,14 +30,23 @@
 #include <poll.h>
 #endif
 
+#if HAVE_POSIX
+#include <sys/mman.h>
+#endif
+
 #include "osdep/io.h"
 
 #include "common/common.h"
 #include "common/msg.h"
 #include "stream.h"
+#include "options/m_config.h"
 #include "options/m_option.h"
 #include "options/path.h"
 
+#if HAVE_LIBURING
+#include "uring.h"
+#endif
+
 #if HAVE_BSD_FSTATFS
 #include <sys/param.h>
 #include <sys/mount.h>
@@ -57,15 +66,87 @@
 #endif
 #endif
 
+// With memory mapped files, how much data after a seek target is announced to
+// the kernel with MADV_WILLNEED.
+#define MMAP_WILLNEED_SIZE (8 * 1024 * 1024)
+
+// With --file-page-cache=no, data behind the read position is dropped from the
+// page cache in units of this (same as the block size in cache.c).
+#define DROP_CACHE_BLOCK_SIZE (256 * 1024)
+
+struct stream_file_opts {
+    int page_cache;
+};
+
+#define OPT_BASE_STRUCT struct stream_file_opts
+const struct m_sub_options stream_file_conf = {
+    .opts = (const m_option_t[]) {
+        OPT_FLAG("file-page-cache", page_cache, 0),
+        {0}
+    },
+    .size = sizeof(struct stream_file_opts),
+    .defaults = &(const struct stream_file_opts){
+        .page_cache = 1,
+    },
+};
+
 struct priv {
     int fd;
     bool close;
     bool use_poll;
+    // If non-NULL, the file is mapped to memory, and read from the mapping.
+    void *map;
+    int64_t map_size;
+    // If non-NULL, the file is read with io_uring (--file-io-uring).
+    struct mp_uring_file *uring;
+    int64_t pos;        // current read position in map and io_uring mode
+    // If true, data before drop_pos was already dropped from the page cache.
+    bool drop_cache;
+    int64_t drop_pos;
 };
 
+// Tell the kernel that the file data up to end won't be needed again.
+static void drop_page_cache(struct priv *p, int64_t end)
+{
+#if HAVE_POSIX_FADVISE
+    int64_t block = end / DROP_CACHE_BLOCK_SIZE * DROP_CACHE_BLOCK_SIZE;
+    if (p->drop_cache && block > p->drop_pos) {
+        posix_fadvise(p->fd, p->drop_pos, block - p->drop_pos,
+                      POSIX_FADV_DONTNEED);
+        p->drop_pos = block;
+    }
+#endif
+}
+
 static int fill_buffer(stream_t *s, char *buffer, int max_len)
 {
     struct priv *p = s->priv;
+#if HAVE_POSIX
+    if (p->map) {
+        int r;
+        if (p->pos < p->map_size) {
+            r = MPMIN(max_len, p->map_size - p->pos);
+            memcpy(buffer, (char *)p->map + p->pos, r);
+        } else {
+            // The file was appended to after it was mapped.
+            r = pread(p->fd, buffer, max_len, p->pos);
+        }
+        if (r <= 0)
+            return -1;
+        p->pos += r;
+        return r;
+    }
+#endif
+#if HAVE_LIBURING
+    if (p->uring) {
+        int r = mp_uring_file_read(p->uring, p->pos, buffer, max_len);
+        if (r <= 0)
+            return -1;
+        p->pos += r;
+        drop_page_cache(p, p->pos);
+        return r;
+    }
+#endif
 #ifndef __MINGW32__
     if (p->use_poll) {
         int c = s->cancel ? mp_cancel_get_fd(s->cancel) : -1;
@@ -79,7 +160,10 @@ static int fill_buffer(stream_t *s, char *buffer, int max_len)
     }
 #endif
     int r = read(p->fd, buffer, max_len);
-    return (r <= 0) ? -1 : r;
+    if (r <= 0)
+        return -1;
+    drop_page_cache(p, s->pos + r);
+    return r;
 }
 
 static int write_buffer(stream_t *s, char *buffer, int len)
@@ -100,6 +184,25 @@ static int write_buffer(stream_t *s, char *buffer, int len)
 static int seek(stream_t *s, int64_t newpos)
 {
     struct priv *p = s->priv;
+    p->drop_pos = newpos / DROP_CACHE_BLOCK_SIZE * DROP_CACHE_BLOCK_SIZE;
+#if HAVE_POSIX
+    if (p->map) {
+        p->pos = newpos;
+        if (newpos < p->map_size) {
+            long page = sysconf(_SC_PAGESIZE);
+            int64_t start = page > 0 ? newpos / page * page : 0;
+            int64_t len = MPMIN(p->map_size - start, MMAP_WILLNEED_SIZE);
+            madvise((char *)p->map + start, len, MADV_WILLNEED);
+        }
+        return 1;
+    }
+#endif
+#if HAVE_LIBURING
+    if (p->uring) {
+        p->pos = newpos;
+        return 1;
+    }
+#endif
     return lseek(p->fd, newpos, SEEK_SET) != (off_t)-1;
 }
 
@@ -123,6 +226,13 @@ static int control(stream_t *s, int cmd, void *arg)
 static void s_close(stream_t *s)
 {
     struct priv *p = s->priv;
+#if HAVE_POSIX
+    if (p->map)
+        munmap(p->map, p->map_size);
+#endif
+#if HAVE_LIBURING
+    TA_FREEP(&p->uring);
+#endif
     if (p->close)
         close(p->fd);
 }
@@ -319,6 +429,49 @@ static int open_f(stream_t *stream)
     if (check_stream_network(p->fd))
         stream->streaming = true;
 
+#if HAVE_POSIX_FADVISE
+    // Keep streaming reads of regular files out of the page cache.
+    struct stream_file_opts *opts =
+        mp_get_config_group(stream, stream->global, &stream_file_conf);
+    struct stat dst;
+    if (!write && !opts->page_cache && fstat(p->fd, &dst) == 0 &&
+        S_ISREG(dst.st_mode))
+    {
+        p->drop_cache = true;
+        MP_VERBOSE(stream, "Dropping read data from the page cache.\n");
+    }
+    talloc_free(opts);
+#endif
+
+#if HAVE_LIBURING
+    // Queue reads of regular files ahead asynchronously. Unlike the mmap path
+    // below, this is also useful for network filesystems, where blocking reads
+    // on a page fault can take long.
+    struct stat ust;
+    if (!write && p->close && fstat(p->fd, &ust) == 0 && S_ISREG(ust.st_mode))
+        p->uring = mp_uring_file_create(p, stream->global, stream->log, p->fd);
+#endif
+
+#if HAVE_POSIX
+    // Map local regular files to memory. This replaces a read() syscall per
+    // chunk with page faults, which the kernel can serve with its readahead.
+    // Only done on 64 bit systems, where address space is not a concern.
+    struct stat st;
+    // Mapped pages can't be dropped from the page cache.
+    if (!write && p->close && !p->uring && !p->drop_cache &&
+        !stream->streaming && sizeof(void *) >= 8 &&
+        fstat(p->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, p->fd, 0);
+        if (map != MAP_FAILED) {
+            p->map = map;
+            p->map_size = st.st_size;
+            madvise(p->map, p->map_size, MADV_SEQUENTIAL);
+            MP_VERBOSE(stream, "File is memory mapped.\n");
+        }
+    }
+#endif
+
     return STREAM_OK;
 }
 
@@ -46,6 +46,7 @@ struct stream_lavf_params {
     char *tls_cert_file;
     char *tls_key_file;
     double timeout;
+    int keep_alive;
 };
 
 const struct m_sub_options stream_lavf_conf = {
@@ -61,11 +62,13 @@ const struct m_sub_options stream_lavf_conf = {
         OPT_STRING("tls-cert-file", tls_cert_file, M_OPT_FILE),
         OPT_STRING("tls-key-file", tls_key_file, M_OPT_FILE),
         OPT_DOUBLE("network-timeout", timeout, M_OPT_MIN, .min = 0),
+        OPT_FLAG("http-keep-alive", keep_alive, 0),
         {0}
     },
     .size = sizeof(struct stream_lavf_params),
     .defaults = &(const struct stream_lavf_params){
         .useragent = (char *)mpv_version,
+        .keep_alive = 1,
     },
 };
 
@@ -218,6 +221,10 @@ void mp_setup_av_network_options(AVDictionary **dict, struct mpv_global *global,
     if (strlen(cust_headers))
         av_dict_set(dict, "headers", cust_headers, 0);
     av_dict_set(dict, "icy", "1", 0);
+    // Keep the connection open, so that seeks (new range requests) on the same
+    // AVIOContext can avoid a new TCP/TLS handshake if the server allows it.
+    if (opts->keep_alive)
+        av_dict_set(dict, "multiple_requests", "1", 0);
     // So far, every known protocol uses microseconds for this
     if (opts->timeout > 0) {
         char buf[80];
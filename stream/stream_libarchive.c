@@ -345,14 +345,100 @@ bool mp_archive_next_entry(struct mp_archive *mpa)
     return success;
 }
 
+// Number of archive instances kept open at older positions in the entry.
+#define MAX_CHECKPOINTS 2
+
+// An archive instance left at some position in the entry. It keeps the
+// decompressor state, so seeking to or after it doesn't need to start over.
+struct checkpoint {
+    struct mp_archive *mpa;
+    struct stream *src;     // primary volume, owned by this instance
+    int64_t pos;
+};
+
 struct priv {
     struct mp_archive *mpa;
     bool broken_seek;
     struct stream *src;
     int64_t entry_size;
     char *entry_name;
+    char *base;             // URL of src
+    struct checkpoint checkpoints[MAX_CHECKPOINTS];
+    int num_checkpoints;
 };
 
+static void free_checkpoint(struct checkpoint *cp)
+{
+    mp_archive_free(cp->mpa);
+    free_stream(cp->src);
+}
+
+static void add_checkpoint(struct priv *p, struct checkpoint cp)
+{
+    if (p->num_checkpoints == MAX_CHECKPOINTS) {
+        // Drop the one closest to the start, where reopening is cheapest.
+        int min = 0;
+        for (int n = 1; n < p->num_checkpoints; n++) {
+            if (p->checkpoints[n].pos < p->checkpoints[min].pos)
+                min = n;
+        }
+        if (cp.pos < p->checkpoints[min].pos) {
+            free_checkpoint(&cp);
+            return;
+        }
+        free_checkpoint(&p->checkpoints[min]);
+        p->checkpoints[min] = p->checkpoints[--p->num_checkpoints];
+    }
+    p->checkpoints[p->num_checkpoints++] = cp;
+}
+
+// Replace the current archive instance with the checkpoint closest before
+// newpos, if it's closer than the current position (or the current position
+// is after newpos). The current instance becomes a checkpoint itself.
+static void resume_checkpoint(stream_t *s, int64_t newpos)
+{
+    struct priv *p = s->priv;
+    int best = -1;
+    for (int n = 0; n < p->num_checkpoints; n++) {
+        int64_t pos = p->checkpoints[n].pos;
+        if (pos <= newpos && (newpos < s->pos || pos > s->pos) &&
+            (best < 0 || pos > p->checkpoints[best].pos))
+            best = n;
+    }
+    if (best < 0)
+        return;
+
+    struct checkpoint cp = p->checkpoints[best];
+    p->checkpoints[best] = p->checkpoints[--p->num_checkpoints];
+    struct checkpoint cur = {p->mpa, p->src, s->pos};
+    if (cur.mpa) {
+        add_checkpoint(p, cur);
+    } else {
+        free_checkpoint(&cur);
+    }
+    p->mpa = cp.mpa;
+    p->src = cp.src;
+    s->pos = cp.pos;
+    MP_VERBOSE(s, "resuming archive at %"PRId64"\n", s->pos);
+}
+
+// Keep the current archive instance as checkpoint before reopening, which
+// requires a separate source stream. Only done for local files, since each
+// instance keeps the volumes open.
+static void save_checkpoint(stream_t *s)
+{
+    struct priv *p = s->priv;
+    if (!p->mpa || p->src->is_network || s->pos <= 0)
+        return;
+    struct stream *src = stream_create(p->base, STREAM_READ | STREAM_SAFE_ONLY,
+                                       s->cancel, s->global);
+    if (!src)
+        return;
+    add_checkpoint(p, (struct checkpoint){p->mpa, p->src, s->pos});
+    p->mpa = NULL;
+    p->src = src;
+}
+
 static int reopen_archive(stream_t *s)
 {
     struct priv *p = s->priv;
@@ -413,10 +499,12 @@ static int archive_entry_seek(stream_t *s, int64_t newpos)
             return -1;
     }
     // libarchive can't seek in most formats.
+    resume_checkpoint(s, newpos);
     if (newpos < s->pos) {
         // Hack seeking backwards into working by reopening the archive and
         // starting over.
         MP_VERBOSE(s, "trying to reopen archive for performing seek\n");
+        save_checkpoint(s);
         if (reopen_archive(s) < STREAM_OK)
             return -1;
         s->pos = 0;
@@ -451,6 +539,8 @@ static int archive_entry_seek(stream_t *s, int64_t newpos)
 static void archive_entry_close(stream_t *s)
 {
     struct priv *p = s->priv;
+    for (int n = 0; n < p->num_checkpoints; n++)
+        free_checkpoint(&p->checkpoints[n]);
     mp_archive_free(p->mpa);
     free_stream(p->src);
 }
@@ -484,6 +574,7 @@ static int archive_entry_open(stream_t *stream)
     *name++ = '\0';
     p->entry_name = name;
     mp_url_unescape_inplace(base);
+    p->base = base;
 
     p->src = stream_create(base, STREAM_READ | STREAM_SAFE_ONLY,
                            stream->cancel, stream->global);
@@ -21,6 +21,7 @@
 
 struct priv {
     bstr data;
+    void *alloc;    // owned copy of the data, or NULL if it's referenced
 };
 
 static int fill_buffer(stream_t *s, char* buffer, int len)
@@ -46,10 +47,15 @@ static int control(stream_t *s, int cmd, void *arg)
     case STREAM_CTRL_GET_SIZE:
         *(int64_t *)arg = p->data.len;
         return 1;
-    case STREAM_CTRL_SET_CONTENTS: ;
+    case STREAM_CTRL_SET_CONTENTS:
+    case STREAM_CTRL_SET_CONTENTS_REF: ;
         bstr *data = (bstr *)arg;
-        talloc_free(p->data.start);
-        p->data = bstrdup(s, *data);
+        TA_FREEP(&p->alloc);
+        p->data = *data;
+        if (cmd == STREAM_CTRL_SET_CONTENTS) {
+            p->data = bstrdup(s, *data);
+            p->alloc = p->data.start;
+        }
         return 1;
     }
     return STREAM_UNSUPPORTED;
@@ -67,16 +73,20 @@ static int open_f(stream_t *stream)
     struct priv *p = talloc_zero(stream, struct priv);
     stream->priv = p;
 
-    // Initial data
+    // Initial data. stream->url lives as long as the stream, so plain
+    // memory:// data can be served from it directly.
     bstr data = bstr0(stream->url);
     bool use_hex = bstr_eatstart0(&data, "hex://");
     if (!use_hex)
         bstr_eatstart0(&data, "memory://");
-    stream_control(stream, STREAM_CTRL_SET_CONTENTS, &data);
+    stream_control(stream, STREAM_CTRL_SET_CONTENTS_REF, &data);
 
-    if (use_hex && !bstr_decode_hex(stream, p->data, &p->data)) {
-        MP_FATAL(stream, "Invalid data.\n");
-        return STREAM_ERROR;
+    if (use_hex) {
+        if (!bstr_decode_hex(stream, data, &p->data)) {
+            MP_FATAL(stream, "Invalid data.\n");
+            return STREAM_ERROR;
+        }
+        p->alloc = p->data.start;
     }
 
     return STREAM_OK;
@@ -21,18 +21,78 @@
 
 #include <libsmbclient.h>
 #include <unistd.h>
+#include <pthread.h>
 
+#include "common/common.h"
 #include "common/msg.h"
 #include "stream.h"
+#include "options/m_config.h"
 #include "options/m_option.h"
+#include "osdep/threads.h"
 
 #include "config.h"
 #if !HAVE_GPL
 #error GPL only
 #endif
 
+// Size of each read request in pipelined mode.
+#define SMB_CHUNK_SIZE (128 * 1024)
+
+struct stream_smb_opts {
+    int read_depth;
+};
+
+#define OPT_BASE_STRUCT struct stream_smb_opts
+const struct m_sub_options stream_smb_conf = {
+    .opts = (const struct m_option[]) {
+        OPT_INTRANGE("smb-read-depth", read_depth, 0, 1, 16),
+        {0}
+    },
+    .size = sizeof(struct stream_smb_opts),
+    .defaults = &(const struct stream_smb_opts){
+        .read_depth = 1,
+    },
+};
+
+enum chunk_state {
+  CHUNK_FREE,       // unused
+  CHUNK_QUEUED,     // waiting for a worker
+  CHUNK_READING,    // a worker is reading into it
+  CHUNK_DONE,       // data (or EOF/error) is available
+};
+
+struct chunk {
+  enum chunk_state state;
+  bool stale;       // a seek happened while reading; discard result
+  int64_t pos;
+  int len;          // valid bytes if CHUNK_DONE, <= 0 on EOF/error
+  char *data;
+};
+
+// Each worker has its own libsmbclient context and file handle, because a
+// context must not be used by multiple threads at once.
+struct worker {
+  struct priv *p;
+  pthread_t thread;
+  bool thread_running;
+  SMBCCTX *ctx;
+  SMBCFILE *file;
+  int64_t pos;      // position of file, or -1 if unknown
+};
+
 struct priv {
     int fd;
+
+    // Pipelined reads (--smb-read-depth > 1). Protected by lock.
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    bool terminate;
+    struct worker *workers;
+    int num_workers;
+    struct chunk *chunks;
+    int num_chunks;
+    int64_t pos;        // read position of the stream
+    int64_t next_pos;   // position of the next chunk to queue
 };
 
 static void smb_auth_fn(const char *server, const char *share,
@@ -72,6 +132,203 @@ static int fill_buffer(stream_t *s, char* buffer, int max_len){
   return (r <= 0) ? -1 : r;
 }
 
+static int worker_read(struct worker *w, int64_t pos, char *buf, int len)
+{
+  if (w->pos != pos &&
+      smbc_getFunctionLseek(w->ctx)(w->ctx, w->file, pos, SEEK_SET) < 0)
+    return -1;
+  w->pos = -1;
+  int total = 0;
+  while (total < len) {
+    ssize_t r = smbc_getFunctionRead(w->ctx)(w->ctx, w->file, buf + total,
+                                             len - total);
+    if (r < 0)
+      return total ? total : -1;
+    if (r == 0)
+      break;
+    total += r;
+  }
+  w->pos = pos + total;
+  return total;
+}
+
+static void *worker_thread(void *arg)
+{
+  struct worker *w = arg;
+  struct priv *p = w->p;
+  mpthread_set_name("smb");
+
+  pthread_mutex_lock(&p->lock);
+  while (!p->terminate) {
+    struct chunk *c = NULL;
+    for (int n = 0; n < p->num_chunks; n++) {
+      if (p->chunks[n].state == CHUNK_QUEUED) {
+        c = &p->chunks[n];
+        break;
+      }
+    }
+    if (!c) {
+      pthread_cond_wait(&p->wakeup, &p->lock);
+      continue;
+    }
+    c->state = CHUNK_READING;
+    int64_t pos = c->pos;
+    pthread_mutex_unlock(&p->lock);
+
+    int r = worker_read(w, pos, c->data, SMB_CHUNK_SIZE);
+
+    pthread_mutex_lock(&p->lock);
+    c->len = r;
+    c->state = c->stale ? CHUNK_FREE : CHUNK_DONE;
+    c->stale = false;
+    pthread_cond_broadcast(&p->wakeup);
+  }
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
+}
+
+// Queue reads for all free chunks following the current read position.
+static void queue_chunks(struct priv *p)
+{
+  bool queued = false;
+  for (int n = 0; n < p->num_chunks; n++) {
+    struct chunk *c = &p->chunks[n];
+    if (c->state == CHUNK_FREE) {
+      c->state = CHUNK_QUEUED;
+      c->pos = p->next_pos;
+      p->next_pos += SMB_CHUNK_SIZE;
+      queued = true;
+    }
+  }
+  if (queued)
+    pthread_cond_broadcast(&p->wakeup);
+}
+
+static struct chunk *find_chunk(struct priv *p, int64_t pos)
+{
+  for (int n = 0; n < p->num_chunks; n++) {
+    struct chunk *c = &p->chunks[n];
+    int len = c->state == CHUNK_DONE ? c->len : SMB_CHUNK_SIZE;
+    if (c->state != CHUNK_FREE && !c->stale && pos >= c->pos &&
+        pos < c->pos + MPMAX(len, 1))
+      return c;
+  }
+  return NULL;
+}
+
+static int fill_buffer_pipelined(stream_t *s, char* buffer, int max_len)
+{
+  struct priv *p = s->priv;
+  int r = -1;
+  pthread_mutex_lock(&p->lock);
+
+  struct chunk *c = find_chunk(p, p->pos);
+  if (!c) {
+    // Not a continuation of the queued reads: drop them, restart at pos.
+    for (int n = 0; n < p->num_chunks; n++) {
+      struct chunk *o = &p->chunks[n];
+      if (o->state == CHUNK_READING) {
+        o->stale = true;
+      } else {
+        o->state = CHUNK_FREE;
+      }
+    }
+    p->next_pos = p->pos;
+  }
+  while (!c) {
+    // All chunks might still be busy with stale reads.
+    queue_chunks(p);
+    c = find_chunk(p, p->pos);
+    if (!c)
+      pthread_cond_wait(&p->wakeup, &p->lock);
+  }
+
+  while (c->state != CHUNK_DONE)
+    pthread_cond_wait(&p->wakeup, &p->lock);
+  if (c->len > 0 && p->pos < c->pos + c->len) {
+    r = MPMIN(max_len, c->pos + c->len - p->pos);
+    memcpy(buffer, c->data + (p->pos - c->pos), r);
+    p->pos += r;
+  }
+  // Consumed, or EOF/error (retried on the next call).
+  if (r < 0 || p->pos == c->pos + c->len)
+    c->state = CHUNK_FREE;
+  queue_chunks(p);
+
+  pthread_mutex_unlock(&p->lock);
+  return r;
+}
+
+static int seek_pipelined(stream_t *s, int64_t newpos)
+{
+  struct priv *p = s->priv;
+  pthread_mutex_lock(&p->lock);
+  p->pos = newpos;
+  pthread_mutex_unlock(&p->lock);
+  return 1;
+}
+
+static void uninit_pipeline(struct priv *p)
+{
+  pthread_mutex_lock(&p->lock);
+  p->terminate = true;
+  pthread_cond_broadcast(&p->wakeup);
+  pthread_mutex_unlock(&p->lock);
+
+  for (int n = 0; n < p->num_workers; n++) {
+    struct worker *w = &p->workers[n];
+    if (w->thread_running)
+      pthread_join(w->thread, NULL);
+    if (w->file)
+      smbc_getFunctionClose(w->ctx)(w->ctx, w->file);
+    if (w->ctx)
+      smbc_free_context(w->ctx, 1);
+  }
+  p->num_workers = 0;
+  pthread_cond_destroy(&p->wakeup);
+  pthread_mutex_destroy(&p->lock);
+}
+
+static bool init_pipeline(stream_t *s, int depth)
+{
+  struct priv *p = s->priv;
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->wakeup, NULL);
+
+  p->chunks = talloc_zero_array(p, struct chunk, depth);
+  p->num_chunks = depth;
+  for (int n = 0; n < depth; n++)
+    p->chunks[n].data = talloc_size(p, SMB_CHUNK_SIZE);
+
+  p->workers = talloc_zero_array(p, struct worker, depth);
+  for (int n = 0; n < depth; n++) {
+    struct worker *w = &p->workers[p->num_workers++];
+    w->p = p;
+    w->pos = 0;
+    w->ctx = smbc_new_context();
+    if (!w->ctx)
+      goto fail;
+    smbc_setFunctionAuthData(w->ctx, smb_auth_fn);
+    if (!smbc_init_context(w->ctx)) {
+      smbc_free_context(w->ctx, 1);
+      w->ctx = NULL;
+      goto fail;
+    }
+    w->file = smbc_getFunctionOpen(w->ctx)(w->ctx, s->url, O_RDONLY, 0);
+    if (!w->file)
+      goto fail;
+    if (pthread_create(&w->thread, NULL, worker_thread, w))
+      goto fail;
+    w->thread_running = true;
+  }
+  return true;
+
+fail:
+  MP_WARN(s, "Could not set up pipelined reads, using normal reads.\n");
+  uninit_pipeline(p);
+  return false;
+}
+
 static int write_buffer(stream_t *s, char* buffer, int len) {
   struct priv *p = s->priv;
   int r;
@@ -88,6 +345,8 @@ static int write_buffer(stream_t *s, char* buffer, int len) {
 
 static void close_f(stream_t *s){
   struct priv *p = s->priv;
+  if (p->num_workers)
+    uninit_pipeline(p);
   smbc_close(p->fd);
 }
 
@@ -139,6 +398,18 @@ static int open_f (stream_t *stream)
   stream->read_chunk = 128 * 1024;
   stream->streaming = true;
 
+  // Keep multiple reads in flight, so that throughput is not bound by the
+  // round trip time of each request.
+  struct stream_smb_opts *opts =
+    mp_get_config_group(stream, stream->global, &stream_smb_conf);
+  if (!write && opts->read_depth > 1 && init_pipeline(stream, opts->read_depth)) {
+    MP_VERBOSE(stream, "Using %d outstanding reads.\n", opts->read_depth);
+    stream->fill_buffer = fill_buffer_pipelined;
+    if (stream->seek)
+      stream->seek = seek_pipelined;
+  }
+  talloc_free(opts);
+
   return STREAM_OK;
 }
 
@@ -69,6 +69,7 @@ static const tvi_info_t *const tvi_driver_list[]={
 const struct m_sub_options tv_params_conf = {
     .opts = (const m_option_t[]) {
         OPT_FLAG("immediatemode", immediate, 0),
+        OPT_FLAG("zerocopy", zerocopy, 0),
         OPT_FLAG("audio", audio, 0),
         OPT_INT("audiorate", audiorate, 0),
         OPT_STRING("driver", driver, 0),
@@ -50,6 +50,7 @@ typedef struct tv_params {
     char **channels;
     int audio;
     int immediate;
+    int zerocopy;
     int audiorate;
     int audio_id;
     int amode;
@@ -180,6 +181,9 @@ typedef struct {
 #define TVI_CONTROL_VID_SET_GAIN        0x11f
 #define TVI_CONTROL_VID_GET_GAIN        0x120
 #define TVI_CONTROL_VID_SET_WIDTH_HEIGHT        0x121
+/* Return the next frame as new demux packet (struct demux_packet **). If not
+ * supported, grab_video_frame() is used. */
+#define TVI_CONTROL_VID_GRAB_PACKET     0x122
 
 /* TUNER controls */
 #define TVI_CONTROL_TUN_GET_FREQ        0x201
@@ -53,9 +53,12 @@ known issues:
 #if HAVE_LIBV4L2
 #include <libv4l2.h>
 #endif
+
+#include <libavutil/buffer.h>
 #include "common/msg.h"
 #include "common/common.h"
 #include "audio/format.h"
+#include "demux/packet.h"
 #include "tv.h"
 #include "audio_in.h"
 
@@ -94,6 +97,25 @@ struct map {
 };
 
 #define BUFFER_COUNT 6
+// With --tv-zerocopy, always leave at least this many buffers to the driver.
+#define ZEROCOPY_MIN_QUEUED 2
+
+/* Capture buffers referenced by demux packets (--tv-zerocopy). This is
+   shared with the packets, which can outlive the tvi instance. */
+struct zc_state {
+    pthread_mutex_t             lock;
+    int                         refs;  ///< 1 for priv_t, 1 per held buffer
+    int                         fd;    ///< -1 once the device is closed
+    int                         count;
+    void                        **addr;
+    size_t                      *len;
+    bool                        *held; ///< buffer is referenced by a packet
+};
+
+struct zc_ref {
+    struct zc_state             *zc;
+    int                         index;
+};
 
 /** video ringbuffer entry */
 typedef struct {
@@ -138,6 +160,7 @@ typedef struct priv {
     volatile int                video_cnt;
     pthread_t                   video_grabber_thread;
     pthread_mutex_t             video_buffer_mutex;
+    struct zc_state             *zc;
 
     /* audio */
     char                        *audio_dev;
@@ -187,6 +210,9 @@ typedef struct tt_stream_props_s{
 
 static void *audio_grabber(void *data);
 static void *video_grabber(void *data);
+static struct demux_packet *grab_video_packet(priv_t *priv);
+static bool zc_init(priv_t *priv);
+static void zc_uninit(priv_t *priv);
 
 /**********************************************************************\
 
@@ -649,6 +675,11 @@ static int do_control(priv_t *priv, int cmd, void *arg)
     case TVI_CONTROL_IMMEDIATE:
         priv->immediate_mode = 1;
         return TVI_CONTROL_TRUE;
+    case TVI_CONTROL_VID_GRAB_PACKET:
+        if (!priv->zc)
+            return TVI_CONTROL_UNKNOWN;
+        *(struct demux_packet **)arg = grab_video_packet(priv);
+        return TVI_CONTROL_TRUE;
     case TVI_CONTROL_VID_GET_FPS:
         *(float *)arg = getfps(priv);
         MP_VERBOSE(priv, "get fps: %f\n", *(float *)arg);
@@ -990,9 +1021,13 @@ static int uninit(priv_t *priv)
     }
 
     /* unmap all buffers */
-    for (i = 0; i < priv->mapcount; i++) {
-        if (v4l2_munmap(priv->map[i].addr, priv->map[i].len) < 0) {
-            MP_ERR(priv, "munmap capture buffer failed: %s\n", mp_strerror(errno));
+    if (priv->zc) {
+        zc_uninit(priv);
+    } else {
+        for (i = 0; i < priv->mapcount; i++) {
+            if (v4l2_munmap(priv->map[i].addr, priv->map[i].len) < 0) {
+                MP_ERR(priv, "munmap capture buffer failed: %s\n", mp_strerror(errno));
+            }
         }
     }
 
@@ -1369,6 +1404,15 @@ static int start(priv_t *priv)
         }
     }
 
+    /* hand out capture buffers directly, if possible */
+    if (priv->tv_param->zerocopy) {
+        if (!priv->immediate_mode || priv->tv_param->automute > 0) {
+            MP_WARN(priv, "zerocopy requires immediatemode without automute.\n");
+        } else if (!zc_init(priv)) {
+            MP_WARN(priv, "cannot enable zerocopy mode.\n");
+        }
+    }
+
     /* start audio thread */
     priv->shutdown = 0;
     priv->audio_skew_measure_time = 0;
@@ -1581,6 +1625,181 @@ static void *video_grabber(void *data)
 }
 
 #define MAX_LOOP 500
+
+/* drop a reference to zc; zc->lock must be held, and is released */
+static void zc_unref(struct zc_state *zc)
+{
+    bool last = --zc->refs == 0;
+    pthread_mutex_unlock(&zc->lock);
+    if (last) {
+        pthread_mutex_destroy(&zc->lock);
+        free(zc->addr);
+        free(zc->len);
+        free(zc->held);
+        free(zc);
+    }
+}
+
+static bool zc_init(priv_t *priv)
+{
+    struct zc_state *zc = calloc(1, sizeof(*zc));
+    if (!zc)
+        return false;
+    zc->addr = calloc(priv->mapcount, sizeof(zc->addr[0]));
+    zc->len = calloc(priv->mapcount, sizeof(zc->len[0]));
+    zc->held = calloc(priv->mapcount, sizeof(zc->held[0]));
+    if (!zc->addr || !zc->len || !zc->held) {
+        free(zc->addr);
+        free(zc->len);
+        free(zc->held);
+        free(zc);
+        return false;
+    }
+    pthread_mutex_init(&zc->lock, NULL);
+    zc->refs = 1;
+    zc->fd = priv->video_fd;
+    zc->count = priv->mapcount;
+    for (int i = 0; i < priv->mapcount; i++) {
+        zc->addr[i] = priv->map[i].addr;
+        zc->len[i] = priv->map[i].len;
+    }
+    priv->zc = zc;
+    MP_VERBOSE(priv, "passing capture buffers to the decoder without copying\n");
+    return true;
+}
+
+/* buffers still referenced by packets are unmapped when they are released */
+static void zc_uninit(priv_t *priv)
+{
+    struct zc_state *zc = priv->zc;
+    pthread_mutex_lock(&zc->lock);
+    zc->fd = -1;
+    for (int i = 0; i < zc->count; i++) {
+        if (!zc->held[i])
+            v4l2_munmap(zc->addr[i], zc->len[i]);
+    }
+    priv->zc = NULL;
+    zc_unref(zc);
+}
+
+static void zc_free_buffer(void *opaque, uint8_t *data)
+{
+    struct zc_ref *ref = opaque;
+    struct zc_state *zc = ref->zc;
+    int i = ref->index;
+    free(ref);
+
+    pthread_mutex_lock(&zc->lock);
+    zc->held[i] = false;
+    if (zc->fd >= 0) {
+        struct v4l2_buffer buf = {
+            .index = i,
+            .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+            .memory = V4L2_MEMORY_MMAP,
+        };
+        v4l2_ioctl(zc->fd, VIDIOC_QBUF, &buf);
+    } else {
+        v4l2_munmap(zc->addr[i], zc->len[i]);
+    }
+    zc_unref(zc);
+}
+
+static bool video_ready(priv_t *priv, int timeout_ms)
+{
+    fd_set rdset;
+    FD_ZERO(&rdset);
+    FD_SET(priv->video_fd, &rdset);
+    struct timeval timeout = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    return select(priv->video_fd + 1, &rdset, NULL, NULL, &timeout) > 0 &&
+           FD_ISSET(priv->video_fd, &rdset);
+}
+
+/* zerocopy mode: capture in the demuxer thread, without ringbuffer */
+static struct demux_packet *grab_video_packet(priv_t *priv)
+{
+    struct zc_state *zc = priv->zc;
+
+    if (!priv->streamon) {
+        if (v4l2_ioctl(priv->video_fd, VIDIOC_STREAMON, &(priv->format.type)) < 0) {
+            MP_ERR(priv, "ioctl streamon failed: %s\n", mp_strerror(errno));
+            return NULL;
+        }
+        priv->streamon = 1;
+    }
+
+    if (!video_ready(priv, MAX_LOOP))
+        return NULL;
+
+    struct v4l2_buffer buf = {
+        .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+        .memory = V4L2_MEMORY_MMAP,
+    };
+    if (v4l2_ioctl(priv->video_fd, VIDIOC_DQBUF, &buf) < 0) {
+        MP_ERR(priv, "ioctl dequeue buffer failed: %s\n", mp_strerror(errno));
+        return NULL;
+    }
+
+    /* if the player fell behind, skip to the most recent frame */
+    while (video_ready(priv, 0)) {
+        struct v4l2_buffer next = {
+            .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+            .memory = V4L2_MEMORY_MMAP,
+        };
+        if (v4l2_ioctl(priv->video_fd, VIDIOC_DQBUF, &next) < 0)
+            break;
+        v4l2_ioctl(priv->video_fd, VIDIOC_QBUF, &buf);
+        buf = next;
+    }
+
+    long long ts = buf.timestamp.tv_sec * 1000000LL + buf.timestamp.tv_usec;
+    if (!priv->frames++)
+        priv->first_frame = ts;
+    priv->curr_frame = ts;
+
+    void *addr = priv->map[buf.index].addr;
+    struct demux_packet *dp = NULL;
+
+    /* copy if the player holds on to so many buffers that capture would stall */
+    pthread_mutex_lock(&zc->lock);
+    int queued = zc->count - 1;
+    for (int i = 0; i < zc->count; i++)
+        queued -= zc->held[i];
+    struct zc_ref *ref = NULL;
+    /* compressed formats need input padding, which the buffers don't have */
+    uint32_t pixfmt = priv->format.fmt.pix.pixelformat;
+    bool compressed = pixfmt == V4L2_PIX_FMT_MJPEG || pixfmt == V4L2_PIX_FMT_JPEG;
+    if (queued >= ZEROCOPY_MIN_QUEUED && !compressed)
+        ref = malloc(sizeof(*ref));
+    if (ref) {
+        *ref = (struct zc_ref){zc, buf.index};
+        zc->held[buf.index] = true;
+        zc->refs++;
+    }
+    pthread_mutex_unlock(&zc->lock);
+
+    if (ref) {
+        AVBufferRef *avbuf = av_buffer_create(addr, buf.bytesused, zc_free_buffer,
+                                              ref, AV_BUFFER_FLAG_READONLY);
+        if (avbuf) {
+            dp = new_demux_packet_from_buf(avbuf);
+            av_buffer_unref(&avbuf);
+        } else {
+            zc_free_buffer(ref, addr);
+        }
+    } else {
+        dp = new_demux_packet_from(addr, buf.bytesused);
+        if (v4l2_ioctl(priv->video_fd, VIDIOC_QBUF, &buf) < 0)
+            MP_ERR(priv, "ioctl queue buffer failed: %s\n", mp_strerror(errno));
+    }
+
+    if (dp)
+        dp->pts = (ts - priv->first_frame) * 1e-6;
+    return dp;
+}
+
 static double grab_video_frame(priv_t *priv, char *buffer, int len)
 {
     int loop_cnt = 0;
@@ -0,0 +1,301 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <liburing.h>
+
+#include "mpv_talloc.h"
+#include "common/common.h"
+#include "common/msg.h"
+#include "options/m_config.h"
+#include "options/m_option.h"
+
+#include "uring.h"
+
+// Number and size of the read-ahead requests kept in flight.
+#define READ_BUFFERS 4
+#define READ_BUFFER_SIZE (256 * 1024)
+// How much data after a read-ahead restart is announced with POSIX_FADV_WILLNEED.
+#define WILLNEED_SIZE (8 * 1024 * 1024)
+// Max. number of queued writes; further writes wait for one to finish.
+#define MAX_WRITES 16
+
+#define RING_ENTRIES 32
+
+struct uring_opts {
+    int enable;
+};
+
+#define OPT_BASE_STRUCT struct uring_opts
+const struct m_sub_options stream_uring_conf = {
+    .opts = (const m_option_t[]) {
+        OPT_FLAG("file-io-uring", enable, 0),
+        {0}
+    },
+    .size = sizeof(struct uring_opts),
+};
+
+struct request {
+    bool write;
+    bool pending;
+    int64_t pos;
+    int len;        // write: size of data; read: valid bytes once finished
+    char *data;
+};
+
+struct mp_uring_file {
+    struct mp_log *log;
+    struct io_uring ring;
+    int fd;
+    int in_flight;  // submitted, but completion not seen yet
+    bool error;     // a write failed
+
+    struct request reads[READ_BUFFERS];
+    int64_t read_ahead_pos; // file position after the last queued read
+
+    struct request writes[MAX_WRITES];
+};
+
+// Wait for one request to finish.
+static bool wait_completion(struct mp_uring_file *f)
+{
+    struct io_uring_cqe *cqe;
+    int r;
+    do {
+        r = io_uring_wait_cqe(&f->ring, &cqe);
+    } while (r == -EINTR);
+    if (r < 0) {
+        MP_ERR(f, "io_uring: %s\n", mp_strerror(-r));
+        f->error = true;
+        return false;
+    }
+
+    struct request *req = io_uring_cqe_get_data(cqe);
+    int res = cqe->res;
+    io_uring_cqe_seen(&f->ring, cqe);
+    f->in_flight--;
+
+    if (!req)
+        return true; // fadvise, ignore result
+    req->pending = false;
+    if (req->write) {
+        // On failure (e.g. opcode unsupported by the kernel), retry the old way.
+        if (res != req->len && pwrite(f->fd, req->data, req->len, req->pos)
+                                    != req->len)
+        {
+            MP_ERR(f, "write error: %s\n", mp_strerror(res < 0 ? -res : EIO));
+            f->error = true;
+        }
+    } else {
+        req->len = res;
+    }
+    return true;
+}
+
+static bool wait_requests(struct mp_uring_file *f, struct request *reqs, int num)
+{
+    for (int n = 0; n < num; n++) {
+        while (reqs[n].pending) {
+            if (!wait_completion(f))
+                return false;
+        }
+    }
+    return true;
+}
+
+static struct io_uring_sqe *get_sqe(struct mp_uring_file *f)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&f->ring);
+    if (!sqe) {
+        // Submission queue full; can happen only with unsubmitted entries.
+        io_uring_submit(&f->ring);
+        sqe = io_uring_get_sqe(&f->ring);
+    }
+    if (sqe)
+        f->in_flight++;
+    return sqe;
+}
+
+static void queue_fadvise(struct mp_uring_file *f, int64_t pos, int64_t len,
+                          int advice)
+{
+    struct io_uring_sqe *sqe = get_sqe(f);
+    if (!sqe)
+        return;
+    io_uring_prep_fadvise(sqe, f->fd, pos, len, advice);
+    io_uring_sqe_set_data(sqe, NULL);
+}
+
+static void queue_read(struct mp_uring_file *f, struct request *req, int64_t pos)
+{
+    req->pos = pos;
+    req->len = 0;
+    struct io_uring_sqe *sqe = get_sqe(f);
+    if (!sqe)
+        return; // stays a finished read with no data
+    io_uring_prep_read(sqe, f->fd, req->data, READ_BUFFER_SIZE, pos);
+    io_uring_sqe_set_data(sqe, req);
+    req->pending = true;
+}
+
+static struct request *find_read(struct mp_uring_file *f, int64_t pos)
+{
+    for (int n = 0; n < READ_BUFFERS; n++) {
+        struct request *req = &f->reads[n];
+        int len = req->pending ? READ_BUFFER_SIZE : MPMAX(req->len, 0);
+        if (pos >= req->pos && pos < req->pos + len)
+            return req;
+    }
+    return NULL;
+}
+
+int mp_uring_file_read(struct mp_uring_file *f, int64_t pos, void *buf, int len)
+{
+    // Queued reads must see the data of previous writes.
+    if (!wait_requests(f, f->writes, MAX_WRITES))
+        return -1;
+
+    struct request *req = find_read(f, pos);
+    if (!req) {
+        // Not a continuation of the previous reads (seek or EOF): throw away
+        // the read-ahead and restart it at pos.
+        if (!wait_requests(f, f->reads, READ_BUFFERS))
+            return -1;
+        for (int n = 0; n < READ_BUFFERS; n++)
+            queue_read(f, &f->reads[n], pos + n * (int64_t)READ_BUFFER_SIZE);
+        f->read_ahead_pos = pos + READ_BUFFERS * (int64_t)READ_BUFFER_SIZE;
+        queue_fadvise(f, f->read_ahead_pos, WILLNEED_SIZE, POSIX_FADV_WILLNEED);
+        io_uring_submit(&f->ring);
+        req = &f->reads[0];
+    }
+
+    while (req->pending) {
+        if (!wait_completion(f))
+            return -1;
+    }
+
+    if (req->len < 0) {
+        // Failed request (maybe the kernel doesn't support the opcode).
+        req->len = 0;
+        return pread(f->fd, buf, len, pos);
+    }
+    if (pos >= req->pos + req->len)
+        return 0; // short read, EOF
+
+    int r = MPMIN(len, req->pos + req->len - pos);
+    memcpy(buf, req->data + (pos - req->pos), r);
+
+    // Fully consumed; reuse the buffer for the next piece of read-ahead.
+    if (pos + r == req->pos + READ_BUFFER_SIZE) {
+        queue_read(f, req, f->read_ahead_pos);
+        f->read_ahead_pos += READ_BUFFER_SIZE;
+        io_uring_submit(&f->ring);
+    }
+
+    return r;
+}
+
+bool mp_uring_file_write(struct mp_uring_file *f, int64_t pos,
+                         const void *data, int len)
+{
+    // Keep the read-ahead consistent with the file contents.
+    for (int n = 0; n < READ_BUFFERS; n++) {
+        struct request *req = &f->reads[n];
+        if (pos >= req->pos + READ_BUFFER_SIZE || pos + len <= req->pos)
+            continue;
+        if (!wait_requests(f, req, 1))
+            return false;
+        int64_t start = MPMAX(pos, req->pos);
+        int64_t end = MPMIN(pos + len, req->pos + MPMAX(req->len, 0));
+        if (start < end)
+            memcpy(req->data + (start - req->pos), (char *)data + (start - pos),
+                   end - start);
+    }
+
+    struct request *w = NULL;
+    while (!w && !f->error) {
+        for (int n = 0; n < MAX_WRITES; n++) {
+            if (!f->writes[n].pending) {
+                w = &f->writes[n];
+                break;
+            }
+        }
+        if (!w && !wait_completion(f))
+            return false;
+    }
+    if (f->error)
+        return false;
+
+    w->data = talloc_realloc_size(f, w->data, len);
+    memcpy(w->data, data, len);
+    w->pos = pos;
+    w->len = len;
+    w->write = true;
+
+    struct io_uring_sqe *sqe = get_sqe(f);
+    if (!sqe)
+        return pwrite(f->fd, w->data, len, pos) == len;
+    io_uring_prep_write(sqe, f->fd, w->data, len, pos);
+    io_uring_sqe_set_data(sqe, w);
+    w->pending = true;
+    io_uring_submit(&f->ring);
+    return true;
+}
+
+static void destroy_file(void *ptr)
+{
+    struct mp_uring_file *f = ptr;
+    // The kernel may still write to the read buffers.
+    while (f->in_flight > 0 && wait_completion(f)) {}
+    io_uring_queue_exit(&f->ring);
+}
+
+struct mp_uring_file *mp_uring_file_create(void *ta_parent,
+                                           struct mpv_global *global,
+                                           struct mp_log *log, int fd)
+{
+    struct uring_opts *opts = mp_get_config_group(NULL, global,
+                                                  &stream_uring_conf);
+    bool enable = opts->enable;
+    talloc_free(opts);
+    if (!enable)
+        return NULL;
+
+    struct mp_uring_file *f = talloc_zero(ta_parent, struct mp_uring_file);
+    f->log = log;
+    f->fd = fd;
+    int r = io_uring_queue_init(RING_ENTRIES, &f->ring, 0);
+    if (r < 0) {
+        MP_VERBOSE(f, "io_uring not available: %s\n", mp_strerror(-r));
+        talloc_free(f);
+        return NULL;
+    }
+    talloc_set_destructor(f, destroy_file);
+
+    for (int n = 0; n < READ_BUFFERS; n++)
+        f->reads[n].data = talloc_size(f, READ_BUFFER_SIZE);
+
+    queue_fadvise(f, 0, 0, POSIX_FADV_SEQUENTIAL);
+    io_uring_submit(&f->ring);
+
+    MP_VERBOSE(f, "Using io_uring.\n");
+    return f;
+}
@@ -0,0 +1,31 @@
+#ifndef MP_STREAM_URING_H
+#define MP_STREAM_URING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct mpv_global;
+struct mp_log;
+
+// Asynchronous I/O on a file descriptor with io_uring (Linux only). Reads are
+// served from a queue of read-ahead requests; writes are submitted and return
+// immediately. All functions must be called from the same thread.
+struct mp_uring_file;
+
+// Returns NULL if --file-io-uring is disabled, or the kernel does not support
+// io_uring. The caller should use normal read()/write() calls then.
+// fd is not closed when the returned object is freed with talloc_free().
+struct mp_uring_file *mp_uring_file_create(void *ta_parent,
+                                           struct mpv_global *global,
+                                           struct mp_log *log, int fd);
+
+// Read up to len bytes at pos. Returns the number of bytes read, 0 on EOF,
+// and -1 on error (like pread()).
+int mp_uring_file_read(struct mp_uring_file *f, int64_t pos, void *buf, int len);
+
+// Queue a write of len bytes at pos. The data is copied. Returns false on
+// error; this includes errors from previously queued writes.
+bool mp_uring_file_write(struct mp_uring_file *f, int64_t pos,
+                         const void *data, int len);
+
+#endif
@@ -30,6 +30,7 @@
 #include "common/common.h"
 #include "common/global.h"
 #include "common/msg.h"
+#include "common/stats.h"
 #include "options/path.h"
 #include "ass_mp.h"
 #include "img_convert.h"
@@ -188,17 +189,25 @@ static void draw_ass_rgba(unsigned char *src, int src_w, int src_h,
 struct mp_ass_packer {
     struct sub_bitmap *cached_parts; // only for the array memory
     struct mp_image *cached_img;
+    int64_t cached_img_size; // accounted as MP_MEM_SUBTITLES
     struct sub_bitmaps cached_subs;
     bool cached_subs_valid;
     struct sub_bitmap rgba_imgs[MP_SUB_BB_LIST_MAX];
     struct bitmap_packer *packer;
 };
 
+static void packer_destructor(void *ptr)
+{
+    struct mp_ass_packer *p = ptr;
+    mp_mem_account(MP_MEM_SUBTITLES, -p->cached_img_size);
+}
+
 // Free with talloc_free().
 struct mp_ass_packer *mp_ass_packer_alloc(void *ta_parent)
 {
     struct mp_ass_packer *p = talloc_zero(ta_parent, struct mp_ass_packer);
     p->packer = talloc_zero(p, struct bitmap_packer);
+    talloc_set_destructor(p, packer_destructor);
     return p;
 }
 
@@ -223,10 +232,15 @@ static bool pack(struct mp_ass_packer *p, struct sub_bitmaps *res, int imgfmt)
                           p->cached_img->imgfmt != imgfmt)
     {
         talloc_free(p->cached_img);
+        mp_mem_account(MP_MEM_SUBTITLES, -p->cached_img_size);
+        p->cached_img_size = 0;
         p->cached_img = mp_image_alloc(imgfmt, p->packer->w, p->packer->h);
         if (!p->cached_img)
             return false;
         talloc_steal(p, p->cached_img);
+        p->cached_img_size = MPMAX(0,
+            mp_image_get_alloc_size(imgfmt, p->packer->w, p->packer->h, 1));
+        mp_mem_account(MP_MEM_SUBTITLES, p->cached_img_size);
     }
 
     res->packed = p->cached_img;
@@ -32,6 +32,7 @@
 #include "common/msg.h"
 #include "common/recorder.h"
 #include "osdep/threads.h"
+#include "osdep/timer.h"
 
 extern const struct sd_functions sd_ass;
 extern const struct sd_functions sd_lavc;
@@ -69,8 +70,20 @@ struct dec_sub {
     struct sd *sd;
 
     struct demux_packet *new_segment;
+
+    // Background preloading (see sub_preload()). Packets not yet decoded.
+    pthread_t preload_thread;
+    bool preload_thread_valid;
+    bool preload_terminate;
+    struct demux_packet **preload_pkts;
+    int num_preload_pkts;
+    int preload_pos;
 };
 
+// Number of preloaded packets decoded at once before letting others access
+// the decoder (e.g. for rendering).
+#define PRELOAD_BATCH 64
+
 static void update_subtitle_speed(struct dec_sub *sub)
 {
     struct mp_subtitle_opts *opts = sub->opts;
@@ -119,10 +132,28 @@ void sub_unlock(struct dec_sub *sub)
     pthread_mutex_unlock(&sub->lock);
 }
 
+static void stop_preload(struct dec_sub *sub)
+{
+    pthread_mutex_lock(&sub->lock);
+    sub->preload_terminate = true;
+    pthread_mutex_unlock(&sub->lock);
+
+    if (sub->preload_thread_valid)
+        pthread_join(sub->preload_thread, NULL);
+    sub->preload_thread_valid = false;
+
+    for (int n = sub->preload_pos; n < sub->num_preload_pkts; n++)
+        talloc_free(sub->preload_pkts[n]);
+    talloc_free(sub->preload_pkts);
+    sub->preload_pkts = NULL;
+    sub->num_preload_pkts = sub->preload_pos = 0;
+}
+
 void sub_destroy(struct dec_sub *sub)
 {
     if (!sub)
         return;
+    stop_preload(sub);
     sub_reset(sub);
     sub->sd->driver->uninit(sub->sd);
     talloc_free(sub->sd);
@@ -230,6 +261,47 @@ bool sub_can_preload(struct dec_sub *sub)
     return r;
 }
 
+// Decode up to PRELOAD_BATCH preloaded packets. Returns false if done.
+// Called locked.
+static bool decode_preloaded(struct dec_sub *sub)
+{
+    // If the decoder dropped the preloaded state (e.g. on seeks with
+    // --sub-clear-on-seek), packets are read from the demuxer normally.
+    if (!sub->sd->preload_ok || sub->preload_terminate)
+        return false;
+
+    int end = MPMIN(sub->preload_pos + PRELOAD_BATCH, sub->num_preload_pkts);
+    for (; sub->preload_pos < end; sub->preload_pos++) {
+        struct demux_packet *pkt = sub->preload_pkts[sub->preload_pos];
+        sub->sd->driver->decode(sub->sd, pkt);
+        talloc_free(pkt);
+    }
+    return sub->preload_pos < sub->num_preload_pkts;
+}
+
+static void *preload_thread(void *arg)
+{
+    struct dec_sub *sub = arg;
+    mpthread_set_name("subpreload");
+
+    while (1) {
+        pthread_mutex_lock(&sub->lock);
+        bool more = decode_preloaded(sub);
+        pthread_mutex_unlock(&sub->lock);
+        if (!more)
+            break;
+        // Mutexes aren't fair; make sure the renderer gets a chance to lock.
+        mp_sleep_us(100);
+    }
+
+    MP_VERBOSE(sub, "Preloading done.\n");
+    return NULL;
+}
+
+// Read all packets from the (fully read) demuxer stream. Reading the packets
+// is cheap, but decoding them can take very long for big files (especially
+// with libass), so that is done on a separate thread. The track can be used
+// right away, and the events fill in while playback continues.
 void sub_preload(struct dec_sub *sub)
 {
     pthread_mutex_lock(&sub->lock);
@@ -240,8 +312,17 @@ void sub_preload(struct dec_sub *sub)
         struct demux_packet *pkt = demux_read_packet(sub->sh);
         if (!pkt)
             break;
-        sub->sd->driver->decode(sub->sd, pkt);
-        talloc_free(pkt);
+        MP_TARRAY_APPEND(sub, sub->preload_pkts, sub->num_preload_pkts, pkt);
+    }
+
+    // Decode the start synchronously, which also makes small files
+    // behave exactly as before.
+    if (decode_preloaded(sub)) {
+        if (pthread_create(&sub->preload_thread, NULL, preload_thread, sub)) {
+            while (decode_preloaded(sub)) {}
+        } else {
+            sub->preload_thread_valid = true;
+        }
     }
 
     pthread_mutex_unlock(&sub->lock);
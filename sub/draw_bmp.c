@@ -55,6 +55,7 @@ struct mp_draw_sub_cache
     struct part *parts[MAX_OSD_PARTS];
     struct mp_image *upsample_img;
     struct mp_image upsample_temp;
+    uint8_t *alpha420; // subsampled alpha for draw_ass_420()
 };
 
 
@@ -64,15 +65,31 @@ static bool get_sub_area(struct mp_rect bb, struct mp_image *temp,
                          struct sub_bitmap *sb, struct mp_image *out_area,
                          int *out_src_x, int *out_src_y);
 
-#define CONDITIONAL 1
+// The blend loops skip fully transparent spans of this many pixels, and
+// process all other pixels unconditionally. With alpha=0, the blend formulas
+// return dst unchanged, so this is exact. Avoiding a per-pixel branch lets the
+// compiler vectorize the inner loops.
+#define BLEND_SPAN 16
+
+// Return whether a[0..n-1] are all 0.
+static inline bool is_transparent(const uint8_t *a, int n)
+{
+    uint8_t acc = 0;
+    for (int i = 0; i < n; i++)
+        acc |= a[i];
+    return !acc;
+}
 
 #define BLEND_CONST_ALPHA(TYPE)                                                 \
     TYPE *dst_r = dst_rp;                                                       \
-    for (int x = 0; x < w; x++) {                                               \
-        uint32_t srcap = srca_r[x];                                             \
-        if (CONDITIONAL && !srcap) continue;                                    \
-        srcap *= srcamul; /* now 0..65025 */                                    \
-        dst_r[x] = (srcp * srcap + dst_r[x] * (65025 - srcap) + 32512) / 65025; \
+    for (int x0 = 0; x0 < w; x0 += BLEND_SPAN) {                                \
+        int x1 = MPMIN(x0 + BLEND_SPAN, w);                                     \
+        if (is_transparent(srca_r + x0, x1 - x0)) continue;                     \
+        for (int x = x0; x < x1; x++) {                                         \
+            uint32_t srcap = srca_r[x] * srcamul; /* now 0..65025 */            \
+            dst_r[x] = (srcp * srcap + dst_r[x] * (65025 - srcap) + 32512)      \
+                       / 65025;                                                 \
+        }                                                                       \
     }
 
 // dst = srcp * (srca * srcamul) + dst * (1 - (srca * srcamul))
@@ -95,10 +112,14 @@ static void blend_const_alpha(void *dst, int dst_stride, int srcp,
 
 #define BLEND_SRC_ALPHA(TYPE)                                                   \
     TYPE *dst_r = dst_rp, *src_r = src_rp;                                      \
-    for (int x = 0; x < w; x++) {                                               \
-        uint32_t srcap = srca_r[x];                                             \
-        if (CONDITIONAL && !srcap) continue;                                    \
-        dst_r[x] = (src_r[x] * srcap + dst_r[x] * (255 - srcap) + 127) / 255;   \
+    for (int x0 = 0; x0 < w; x0 += BLEND_SPAN) {                                \
+        int x1 = MPMIN(x0 + BLEND_SPAN, w);                                     \
+        if (is_transparent(srca_r + x0, x1 - x0)) continue;                     \
+        for (int x = x0; x < x1; x++) {                                         \
+            uint32_t srcap = srca_r[x];                                         \
+            dst_r[x] = (src_r[x] * srcap + dst_r[x] * (255 - srcap) + 127)      \
+                       / 255;                                                   \
+        }                                                                       \
     }
 
 // dst = src * srca + dst * (1 - srca)
@@ -120,9 +141,14 @@ static void blend_src_alpha(void *dst, int dst_stride, void *src,
 
 #define BLEND_SRC_DST_MUL(TYPE, MAX)                                            \
     TYPE *dst_r = dst_rp;                                                       \
-    for (int x = 0; x < w; x++) {                                               \
-        uint16_t srcp = src_r[x] * srcmul; /* now 0..65025 */                   \
-        dst_r[x] = (srcp * (MAX) + dst_r[x] * (65025 - srcp) + 32512) / 65025;  \
+    for (int x0 = 0; x0 < w; x0 += BLEND_SPAN) {                                \
+        int x1 = MPMIN(x0 + BLEND_SPAN, w);                                     \
+        if (is_transparent(src_r + x0, x1 - x0)) continue;                      \
+        for (int x = x0; x < x1; x++) {                                         \
+            uint32_t srcp = src_r[x] * srcmul; /* now 0..65025 */               \
+            dst_r[x] = (srcp * (MAX) + dst_r[x] * (65025 - srcp) + 32512)       \
+                       / 65025;                                                 \
+        }                                                                       \
     }
 
 // dst = src * srcmul + dst * (1 - src * srcmul)
@@ -246,21 +272,56 @@ static void draw_rgba(struct mp_draw_sub_cache *cache, struct mp_rect bb,
     }
 }
 
-static void draw_ass(struct mp_draw_sub_cache *cache, struct mp_rect bb,
-                     struct mp_image *temp, int bits, struct sub_bitmaps *sbs)
+struct ass_csp {
+    bool need_conv;
+    struct mp_cmat rgb2yuv;
+    int texture_bits;
+};
+
+// texture_bits is the range the pixel values in img use.
+static void init_ass_csp(struct ass_csp *csp, struct mp_image *img, int bits,
+                         int texture_bits)
 {
     struct mp_csp_params cspar = MP_CSP_PARAMS_DEFAULTS;
-    mp_csp_set_image_params(&cspar, &temp->params);
+    mp_csp_set_image_params(&cspar, &img->params);
     cspar.levels_out = MP_CSP_LEVELS_PC; // RGB (libass.color)
     cspar.input_bits = bits;
-    cspar.texture_bits = (bits + 7) / 8 * 8;
-
-    struct mp_cmat yuv2rgb, rgb2yuv;
-    bool need_conv = temp->fmt.flags & MP_IMGFLAG_YUV;
-    if (need_conv) {
+    cspar.texture_bits = texture_bits;
+
+    *csp = (struct ass_csp){
+        .need_conv = img->fmt.flags & MP_IMGFLAG_YUV,
+        .texture_bits = texture_bits,
+    };
+    if (csp->need_conv) {
+        struct mp_cmat yuv2rgb;
         mp_get_csp_matrix(&cspar, &yuv2rgb);
-        mp_invert_cmat(&rgb2yuv, &yuv2rgb);
+        mp_invert_cmat(&csp->rgb2yuv, &yuv2rgb);
     }
+}
+
+// Return the alpha multiplier, and write the plane values to color_yuv.
+static int get_ass_color(struct ass_csp *csp, struct sub_bitmap *sb,
+                         int color_yuv[3])
+{
+    int r = (sb->libass.color >> 24) & 0xFF;
+    int g = (sb->libass.color >> 16) & 0xFF;
+    int b = (sb->libass.color >> 8) & 0xFF;
+    if (csp->need_conv) {
+        int rgb[3] = {r, g, b};
+        mp_map_fixp_color(&csp->rgb2yuv, 8, rgb, csp->texture_bits, color_yuv);
+    } else {
+        color_yuv[0] = g;
+        color_yuv[1] = b;
+        color_yuv[2] = r;
+    }
+    return 255 - (sb->libass.color & 0xFF);
+}
+
+static void draw_ass(struct mp_draw_sub_cache *cache, struct mp_rect bb,
+                     struct mp_image *temp, int bits, struct sub_bitmaps *sbs)
+{
+    struct ass_csp csp;
+    init_ass_csp(&csp, temp, bits, (bits + 7) / 8 * 8);
 
     for (int i = 0; i < sbs->num_parts; ++i) {
         struct sub_bitmap *sb = &sbs->parts[i];
@@ -270,19 +331,8 @@ static void draw_ass(struct mp_draw_sub_cache *cache, struct mp_rect bb,
         if (!get_sub_area(bb, temp, sb, &dst, &src_x, &src_y))
             continue;
 
-        int r = (sb->libass.color >> 24) & 0xFF;
-        int g = (sb->libass.color >> 16) & 0xFF;
-        int b = (sb->libass.color >> 8) & 0xFF;
-        int a = 255 - (sb->libass.color & 0xFF);
         int color_yuv[3];
-        if (need_conv) {
-            int rgb[3] = {r, g, b};
-            mp_map_fixp_color(&rgb2yuv, 8, rgb, cspar.texture_bits, color_yuv);
-        } else {
-            color_yuv[0] = g;
-            color_yuv[1] = b;
-            color_yuv[2] = r;
-        }
+        int a = get_ass_color(&csp, sb, color_yuv);
 
         int bytes = (bits + 7) / 8;
         uint8_t *alpha_p = (uint8_t *)sb->bitmap + src_y * sb->stride + src_x;
@@ -297,6 +347,81 @@ static void draw_ass(struct mp_draw_sub_cache *cache, struct mp_rect bb,
     }
 }
 
+// Whether draw_ass_420() can be used on this format.
+static bool is_direct_420(struct mp_image *img)
+{
+    struct mp_imgfmt_desc desc = img->fmt;
+    int want = MP_IMGFLAG_YUV_P | MP_IMGFLAG_NE;
+    return (desc.flags & want) == want && !(desc.flags & MP_IMGFLAG_ALPHA) &&
+           desc.num_planes == 3 && desc.chroma_xs == 1 && desc.chroma_ys == 1 &&
+           desc.component_bits >= 8 && desc.component_bits <= 16;
+}
+
+// Like draw_ass(), but blend directly into a 4:2:0 image. Luma is blended at
+// full resolution, chroma with the alpha averaged over each 2x2 block. This is
+// equivalent to upsampling chroma with nearest neighbour, blending, and then
+// downsampling with a box filter, as the chroma_up()/chroma_down() path does.
+static void draw_ass_420(struct mp_draw_sub_cache *cache, struct mp_rect bb,
+                         struct mp_image *img, struct sub_bitmaps *sbs)
+{
+    int bits = img->fmt.component_bits;
+    int bytes = img->fmt.bytes[0];
+    struct ass_csp csp;
+    init_ass_csp(&csp, img, bits, bits);
+
+    for (int i = 0; i < sbs->num_parts; ++i) {
+        struct sub_bitmap *sb = &sbs->parts[i];
+
+        // coordinates are relative to the bbox
+        struct mp_rect rc = {sb->x - bb.x0, sb->y - bb.y0};
+        rc.x1 = rc.x0 + sb->w;
+        rc.y1 = rc.y0 + sb->h;
+        if (!mp_rect_intersection(&rc, &(struct mp_rect){0, 0, img->w, img->h}))
+            continue;
+        int w = rc.x1 - rc.x0, h = rc.y1 - rc.y0;
+        uint8_t *alpha_p = (uint8_t *)sb->bitmap +
+                           (rc.y0 - (sb->y - bb.y0)) * sb->stride +
+                           (rc.x0 - (sb->x - bb.x0));
+
+        int color_yuv[3];
+        int a = get_ass_color(&csp, sb, color_yuv);
+
+        blend_const_alpha(img->planes[0] + rc.y0 * img->stride[0] + rc.x0 * bytes,
+                          img->stride[0], color_yuv[0], alpha_p, sb->stride, a,
+                          w, h, bytes);
+
+        // Chroma area covered by the bitmap, and the average alpha per
+        // chroma sample (luma samples outside of the bitmap count as 0).
+        int cx0 = rc.x0 >> 1, cy0 = rc.y0 >> 1;
+        int cw = ((rc.x1 + 1) >> 1) - cx0, ch = ((rc.y1 + 1) >> 1) - cy0;
+        MP_TARRAY_GROW(cache, cache->alpha420, cw * ch);
+        uint8_t *ca = cache->alpha420;
+        for (int y = 0; y < ch; y++) {
+            for (int x = 0; x < cw; x++) {
+                int sum = 0;
+                for (int j = 0; j < 2; j++) {
+                    int ly = (cy0 + y) * 2 + j;
+                    if (ly < rc.y0 || ly >= rc.y1)
+                        continue;
+                    uint8_t *row = alpha_p + (ly - rc.y0) * sb->stride;
+                    for (int k = 0; k < 2; k++) {
+                        int lx = (cx0 + x) * 2 + k;
+                        if (lx >= rc.x0 && lx < rc.x1)
+                            sum += row[lx - rc.x0];
+                    }
+                }
+                ca[y * cw + x] = (sum + 2) / 4;
+            }
+        }
+
+        for (int p = 1; p < 3; p++) {
+            blend_const_alpha(img->planes[p] + cy0 * img->stride[p] + cx0 * bytes,
+                              img->stride[p], color_yuv[p], ca, cw, a,
+                              cw, ch, bytes);
+        }
+    }
+}
+
 static void get_swscale_alignment(const struct mp_image *img, int *out_xstep,
                                   int *out_ystep)
 {
@@ -518,6 +643,12 @@ void mp_draw_sub_bitmaps(struct mp_draw_sub_cache **cache, struct mp_image *dst,
 
         struct mp_image dst_region = *dst;
         mp_image_crop_rc(&dst_region, bb);
+
+        if (sbs->format == SUBBITMAP_LIBASS && is_direct_420(&dst_region)) {
+            draw_ass_420(cache_, bb, &dst_region, sbs);
+            continue;
+        }
+
         struct mp_image *temp = chroma_up(cache_, format, &dst_region);
         if (!temp)
             continue; // on OOM, skip region
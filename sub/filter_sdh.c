@@ -18,6 +18,13 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+
+#include "config.h"
+
+#if HAVE_POSIX
+#include <regex.h>
+#endif
+
 #include "misc/ctype.h"
 #include "common/common.h"
 #include "common/msg.h"
@@ -36,6 +43,37 @@ struct buffer {
     int pos;
 };
 
+struct sd_filter_sdh {
+    struct sd *sd;
+    int text_field;     // number of the ASS field with the text, -1 if unknown
+
+    // Lookup tables for the characters accepted by skip_speaker_label() and
+    // skip_parenthesed(), which depend on --sub-filter-sdh-harder.
+    int tables_harder;
+    bool label_chars[256];
+    bool paren_chars[256];
+
+#if HAVE_POSIX
+    regex_t *regexes;
+    int num_regexes;
+#endif
+};
+
+static void build_tables(struct sd_filter_sdh *f, int harder)
+{
+    for (int c = 0; c < 256; c++) {
+        bool alnum = (mp_isalpha(c) && (harder || mp_isupper(c) || c == 'l')) ||
+                     mp_isdigit(c);
+        f->label_chars[c] = alnum || strchr(" '#.,", c) ||
+                            (harder && (c == '(' || c == ')'));
+        f->paren_chars[c] = alnum || strchr(" '#.,-\"\\", c);
+        // strchr() matches the terminating \0 too
+        f->label_chars[c] &= c != 0;
+        f->paren_chars[c] &= c != 0;
+    }
+    f->tables_harder = harder;
+}
+
 static void init_buf(struct buffer *buf, int length)
 {
     buf->string = talloc_size(NULL, length);
@@ -99,9 +137,9 @@ static void copy_ass(struct sd *sd, char **rpp, struct buffer *buf)
 // if no label was found read pointer and write position in buffer
 // will be unchanged
 // otherwise they point to next position after label and next write position
-static void skip_speaker_label(struct sd *sd, char **rpp, struct buffer *buf)
+static void skip_speaker_label(struct sd *sd, const bool *chars, char **rpp,
+                               struct buffer *buf)
 {
-    int filter_harder = sd->opts->sub_filter_SDH_harder;
     char *rp = *rpp;
     int old_pos = buf->pos;
 
@@ -121,12 +159,7 @@ static void skip_speaker_label(struct sd *sd, char **rpp, struct buffer *buf)
     while (*rp && rp[0] != ':') {
         if (rp[0] == '{') {
             copy_ass(sd, &rp, buf);
-        } else if ((mp_isalpha(rp[0]) &&
-                    (filter_harder || mp_isupper(rp[0]) || rp[0] == 'l')) ||
-                   mp_isdigit(rp[0]) ||
-                   rp[0] == ' ' || rp[0] == '\'' ||
-                   (filter_harder && (rp[0] == '(' || rp[0] == ')')) ||
-                   rp[0] == '#' || rp[0] == '.' || rp[0] == ',') {
+        } else if (chars[(unsigned char)rp[0]]) {
             rp++;
         } else {
             buf->pos = old_pos;
@@ -227,9 +260,9 @@ static bool skip_bracketed(struct sd *sd, char **rpp, struct buffer *buf)
 // return true if paranthesed text was removed.
 // if not valid SDH read pointer and write buffer position will be unchanged
 // otherwise they point to next position after text and next write position
-static bool skip_parenthesed(struct sd *sd, char **rpp, struct buffer *buf)
+static bool skip_parenthesed(struct sd *sd, const bool *chars, char **rpp,
+                             struct buffer *buf)
 {
-    int filter_harder = sd->opts->sub_filter_SDH_harder;
     char *rp = *rpp;
     int old_pos = buf->pos;
 
@@ -239,12 +272,7 @@ static bool skip_parenthesed(struct sd *sd, char **rpp, struct buffer *buf)
     while (*rp && rp[0] != ')') {
         if (rp[0] == '{') {
             copy_ass(sd, &rp, buf);
-        } else if ((mp_isalpha(rp[0]) &&
-                    (filter_harder || mp_isupper(rp[0]) || rp[0] == 'l')) ||
-                   mp_isdigit(rp[0]) ||
-                   rp[0] == ' ' || rp[0] == '\'' || rp[0] == '#' ||
-                   rp[0] == '.' || rp[0] == ',' ||
-                   rp[0] == '-' || rp[0] == '"' || rp[0] == '\\') {
+        } else if (chars[(unsigned char)rp[0]]) {
             if (!mp_isdigit(rp[0]))
                 only_digits = false;
             rp++;
@@ -318,41 +346,139 @@ static void remove_leading_hyphen_space(struct sd *sd, int start_pos, struct buf
     }
 }
 
-// Filter ASS formatted string for SDH
+static void destroy_filter(void *ptr)
+{
+#if HAVE_POSIX
+    struct sd_filter_sdh *f = ptr;
+    for (int n = 0; n < f->num_regexes; n++)
+        regfree(&f->regexes[n]);
+#endif
+}
+
+// Create the filter state for a subtitle track. This parses the ASS format
+// line and compiles --sub-filter-regex patterns once, instead of per event.
 //
 // Parameters:
-//     format       format line from ASS configuration
-//     n_ignored    number of comma to skip as preprocessing have removed them
-//     data         ASS line. null terminated string if length == 0
-//     length       length of ASS input if not null terminated, 0 otherwise
-//
-// Returns  a talloc allocated string with filtered ASS data (may be the same
-// content as original if no SDH was found) which must be released
-// by caller using talloc_free.
-//
-// Returns NULL if filtering resulted in all of ASS data being removed so no
-// subtitle should be output
-char *filter_SDH(struct sd *sd, char *format, int n_ignored, char *data, int length)
+//     ta_parent    talloc parent of the returned struct
+//     format       format line from ASS configuration, can be NULL
+struct sd_filter_sdh *filter_SDH_create(struct sd *sd, void *ta_parent,
+                                        char *format)
 {
-    if (!format) {
+    struct sd_filter_sdh *f = talloc_zero(ta_parent, struct sd_filter_sdh);
+    talloc_set_destructor(f, destroy_filter);
+    f->sd = sd;
+    f->text_field = -1;
+    build_tables(f, sd->opts->sub_filter_SDH_harder);
+
+    if (format) {
+        // scan format line to find the number of the field where the text is
+        int comma = 0;
+        for (char *c = format; *c; c++) {
+            if (*c == ',') {
+                comma++;
+                if (strncasecmp(c + 1, "Text", 4) == 0)
+                    break;
+            }
+        }
+        f->text_field = comma;
+    } else {
         MP_VERBOSE(sd, "SDH filtering not possible - format missing\n");
-        return length ? talloc_strndup(NULL, data, length) : talloc_strdup(NULL, data);
     }
 
-    // need null terminated string
-    char *ass = length ? talloc_strndup(NULL, data, length) : data;
+    char **list = sd->opts->sub_filter_regex;
+    for (int n = 0; list && list[n]; n++) {
+#if HAVE_POSIX
+        MP_TARRAY_GROW(f, f->regexes, f->num_regexes);
+        regex_t *re = &f->regexes[f->num_regexes];
+        int err = regcomp(re, list[n], REG_EXTENDED | REG_ICASE | REG_NOSUB);
+        if (err) {
+            char errbuf[512];
+            regerror(err, re, errbuf, sizeof(errbuf));
+            MP_ERR(sd, "Regular expression error: '%s': %s\n", list[n], errbuf);
+            continue;
+        }
+        f->num_regexes++;
+#else
+        MP_ERR(sd, "--sub-filter-regex is not supported on this platform.\n");
+        break;
+#endif
+    }
 
-    int comma = 0;
-    // scan format line to find the number of the field where the text is
-    for (char *c = format; *c; c++) {
-        if (*c == ',') {
-            comma++;
-            if (strncasecmp(c + 1, "Text", 4) == 0)
-                break;
+    return f;
+}
+
+// Return the start of the text field in an ASS line, or NULL.
+static char *find_text(struct sd_filter_sdh *f, int n_ignored, char *rp)
+{
+    if (f->text_field < 0)
+        return NULL;
+    for (int k = 0; k < f->text_field - n_ignored; k++) {
+        rp = strchr(rp, ',');
+        if (!rp)
+            return NULL;
+        rp++;
+    }
+    return rp;
+}
+
+#if HAVE_POSIX
+// Return whether the text field matches any of the --sub-filter-regex
+// patterns. The patterns are applied to the text without override tags, with
+// line breaks as \n.
+static bool match_regex(struct sd_filter_sdh *f, int n_ignored, char *ass)
+{
+    char *rp = find_text(f, n_ignored, ass);
+    if (!rp)
+        return false;
+
+    char *text = talloc_size(NULL, strlen(rp) + 1);
+    char *wp = text;
+    while (*rp) {
+        if (rp[0] == '{') {
+            char *end = strchr(rp, '}');
+            if (end) {
+                rp = end + 1;
+                continue;
+            }
         }
+        if (rp[0] == '\\' && (rp[1] == 'N' || rp[1] == 'n')) {
+            *wp++ = '\n';
+            rp += 2;
+            continue;
+        }
+        *wp++ = *rp++;
     }
+    *wp = '\0';
+
+    bool match = false;
+    for (int n = 0; n < f->num_regexes && !match; n++)
+        match = regexec(&f->regexes[n], text, 0, NULL, 0) == 0;
+    talloc_free(text);
+    return match;
+}
+#endif
+
+// Filter ASS formatted string for SDH
+//
+// Parameters:
+//     n_ignored    number of comma to skip as preprocessing have removed them
+//     ass          ASS line, null terminated, not modified
+//
+// Returns a new talloc allocated string with the filtered data, ass itself if
+// filtering is not possible, or NULL if all of the data was removed.
+static char *filter_SDH_text(struct sd_filter_sdh *f, int n_ignored, char *ass)
+{
+    struct sd *sd = f->sd;
+
+    if (f->text_field < 0)
+        return ass;
+
+    int harder = sd->opts->sub_filter_SDH_harder;
+    if (harder != f->tables_harder)
+        build_tables(f, harder);
+
     // if preprocessed line some fields are skipped
-    comma -= n_ignored;
+    int comma = f->text_field - n_ignored;
 
     struct buffer writebuf;
     struct buffer *buf = &writebuf;
@@ -373,7 +499,7 @@ char *filter_SDH(struct sd *sd, char *format, int n_ignored, char *data, int len
     if (!*rp) {
         talloc_free(buf->string);
         MP_VERBOSE(sd, "SDH filtering not possible - cannot find text field\n");
-        return length ? ass : talloc_strdup(NULL, ass);
+        return ass;
     }
 
     bool contains_text = false;  // true if non SDH text was found
@@ -388,7 +514,7 @@ char *filter_SDH(struct sd *sd, char *format, int n_ignored, char *data, int len
         wp_line_start = buf->pos;
 
         // skip any speaker label
-        skip_speaker_label(sd, &rp, buf);
+        skip_speaker_label(sd, f->label_chars, &rp, buf);
 
         // go through the rest of the line looking for SDH in () or []
         while (*rp && !(rp[0] == '\\' && rp[1] == 'N')) {
@@ -400,7 +526,7 @@ char *filter_SDH(struct sd *sd, char *format, int n_ignored, char *data, int len
                     line_with_text =  true;
                 }
             } else if (rp[0] == '(') {
-                if (!skip_parenthesed(sd, &rp, buf)) {
+                if (!skip_parenthesed(sd, f->paren_chars, &rp, buf)) {
                     append(sd, buf, rp[0]);
                     rp++;
                     line_with_text =  true;
@@ -439,8 +565,6 @@ char *filter_SDH(struct sd *sd, char *format, int n_ignored, char *data, int len
     } else {
         contains_text = true;
     }
-    if (length)
-        talloc_free(ass);
     if (contains_text) {
         // the ASS data contained normal text after filtering
         append(sd, buf, '\0'); // '\0' terminate
@@ -451,3 +575,40 @@ char *filter_SDH(struct sd *sd, char *format, int n_ignored, char *data, int len
         return NULL;
     }
 }
+
+// Filter ASS formatted string for SDH (if --sub-filter-sdh is enabled), and
+// drop it if it matches a --sub-filter-regex pattern.
+//
+// Parameters:
+//     n_ignored    number of comma to skip as preprocessing have removed them
+//     data         ASS line. null terminated string if length == 0
+//     length       length of ASS input if not null terminated, 0 otherwise
+//
+// Returns  a talloc allocated string with filtered ASS data (may be the same
+// content as original if no SDH was found) which must be released
+// by caller using talloc_free.
+//
+// Returns NULL if filtering resulted in all of ASS data being removed so no
+// subtitle should be output
+char *filter_SDH(struct sd_filter_sdh *f, int n_ignored, char *data, int length)
+{
+    // need null terminated string
+    char *ass = length ? talloc_strndup(NULL, data, length) : data;
+
+    char *res = ass;
+    if (f->sd->opts->sub_filter_SDH)
+        res = filter_SDH_text(f, n_ignored, ass);
+    if (res == data)
+        res = talloc_strdup(NULL, data);
+    if (ass != data && ass != res)
+        talloc_free(ass);
+
+#if HAVE_POSIX
+    if (res && f->num_regexes && match_regex(f, n_ignored, res)) {
+        talloc_free(res);
+        res = NULL;
+    }
+#endif
+
+    return res;
+}
@@ -32,6 +32,7 @@
 #include "options/options.h"
 #include "common/global.h"
 #include "common/msg.h"
+#include "misc/thread_pool.h"
 #include "player/client.h"
 #include "player/command.h"
 #include "osd.h"
@@ -147,6 +148,7 @@ void osd_free(struct osd_state *osd)
 {
     if (!osd)
         return;
+    talloc_free(osd->render_pool);
     osd_destroy_backend(osd);
     pthread_mutex_destroy(&osd->lock);
     talloc_free(osd);
@@ -293,6 +295,42 @@ static void render_object(struct osd_state *osd, struct osd_object *obj,
     out_imgs->change_id = obj->vo_change_id;
 }
 
+struct render_job {
+    struct osd_state *osd;
+    struct osd_object *obj;
+    struct mp_osd_res res;
+    double video_pts;
+    const bool *formats;
+    struct sub_bitmaps imgs;
+};
+
+static void render_job_fn(void *p)
+{
+    struct render_job *job = p;
+    render_object(job->osd, job->obj, job->res, job->video_pts, job->formats,
+                  &job->imgs);
+}
+
+// Render the given objects concurrently. Each object has its own libass
+// instance (or none), so they're independent of each other. Returns false if
+// no worker threads are available.
+static bool render_parallel(struct osd_state *osd, struct render_job *jobs,
+                            int num_jobs)
+{
+    if (!osd->render_pool)
+        osd->render_pool = mp_thread_pool_create(osd, MAX_OSD_PARTS - 1);
+    if (!osd->render_pool)
+        return false;
+
+    // The calling thread renders the objects no worker has picked up yet.
+    struct mp_thread_pool_group group = {0};
+    for (int n = 0; n < num_jobs; n++)
+        mp_thread_pool_queue_group(osd->render_pool, &group, render_job_fn,
+                                   &jobs[n]);
+    mp_thread_pool_wait(osd->render_pool, &group);
+    return true;
+}
+
 // draw_flags is a bit field of OSD_DRAW_* constants
 void osd_draw(struct osd_state *osd, struct mp_osd_res res,
               double video_pts, int draw_flags,
@@ -307,6 +345,9 @@ void osd_draw(struct osd_state *osd, struct mp_osd_res res,
     if (draw_flags & OSD_DRAW_SUB_FILTER)
         draw_flags |= OSD_DRAW_SUB_ONLY;
 
+    struct render_job jobs[MAX_OSD_PARTS];
+    int num_jobs = 0;
+
     for (int n = 0; n < MAX_OSD_PARTS; n++) {
         struct osd_object *obj = osd->objs[n];
 
@@ -322,14 +363,32 @@ void osd_draw(struct osd_state *osd, struct mp_osd_res res,
         if (obj->sub)
             sub_lock(obj->sub);
 
-        struct sub_bitmaps imgs;
-        render_object(osd, obj, res, video_pts, formats, &imgs);
-        if (imgs.num_parts > 0) {
-            if (formats[imgs.format]) {
-                cb(cb_ctx, &imgs);
+        jobs[num_jobs++] = (struct render_job){
+            .osd = osd,
+            .obj = obj,
+            .res = res,
+            .video_pts = video_pts,
+            .formats = formats,
+        };
+    }
+
+    if (!(osd->opts->osd_parallel_render && num_jobs > 1 &&
+          render_parallel(osd, jobs, num_jobs)))
+    {
+        for (int n = 0; n < num_jobs; n++)
+            render_job_fn(&jobs[n]);
+    }
+
+    for (int n = 0; n < num_jobs; n++) {
+        struct osd_object *obj = jobs[n].obj;
+        struct sub_bitmaps *imgs = &jobs[n].imgs;
+
+        if (imgs->num_parts > 0) {
+            if (formats[imgs->format]) {
+                cb(cb_ctx, imgs);
             } else {
                 MP_ERR(osd, "Can't render OSD part %d (format %d).\n",
-                       obj->type, imgs.format);
+                       obj->type, imgs->format);
             }
         }
 
@@ -28,6 +28,7 @@
 #include "misc/bstr.h"
 #include "common/common.h"
 #include "common/msg.h"
+#include "osdep/threads.h"
 #include "osd.h"
 #include "osd_state.h"
 
@@ -41,8 +42,56 @@ static const char osd_font_pfb[] =
 
 #define ASS_USE_OSD_FONT "{\\fnmpv-osd-symbols}"
 
+// Initializing the font provider can take very long if fontconfig needs to
+// build its cache. Do it once on a separate thread, so that the cache is warm
+// by the time the OSD renders, and rendering doesn't block meanwhile.
+static void *fonts_thread(void *arg)
+{
+    struct osd_state *osd = arg;
+    mpthread_set_name("osd/fonts");
+
+    struct mp_log *log = mp_log_new(NULL, osd->log, "libass");
+    ASS_Library *library = mp_ass_init(osd->global, log);
+    ASS_Renderer *render = ass_renderer_init(library);
+    if (render) {
+        mp_ass_configure_fonts(render, osd->fonts_style, osd->global, log);
+        ass_renderer_done(render);
+    }
+    ass_library_done(library);
+    talloc_free(log);
+
+    pthread_mutex_lock(&osd->fonts_lock);
+    osd->fonts_ready = true;
+    pthread_cond_broadcast(&osd->fonts_wakeup);
+    pthread_mutex_unlock(&osd->fonts_lock);
+
+    pthread_mutex_lock(&osd->lock);
+    osd->want_redraw_notification = true;
+    pthread_mutex_unlock(&osd->lock);
+    return NULL;
+}
+
 void osd_init_backend(struct osd_state *osd)
 {
+    pthread_mutex_init(&osd->fonts_lock, NULL);
+    pthread_cond_init(&osd->fonts_wakeup, NULL);
+
+    // Only the font family matters for font setup.
+    osd->fonts_style = talloc_zero(osd, struct osd_style_opts);
+    osd->fonts_style->font = talloc_strdup(osd, osd->opts->osd_style->font);
+
+    osd->fonts_thread_running =
+        !pthread_create(&osd->fonts_thread, NULL, fonts_thread, osd);
+    if (!osd->fonts_thread_running)
+        osd->fonts_ready = true;
+}
+
+static bool fonts_ready(struct osd_state *osd)
+{
+    pthread_mutex_lock(&osd->fonts_lock);
+    bool r = osd->fonts_ready;
+    pthread_mutex_unlock(&osd->fonts_lock);
+    return r;
 }
 
 static void create_ass_renderer(struct osd_state *osd, struct ass_state *ass)
@@ -50,6 +99,13 @@ static void create_ass_renderer(struct osd_state *osd, struct ass_state *ass)
     if (ass->render)
         return;
 
+    // Rendering doesn't get here before the background setup is done, but
+    // e.g. osd_get_text_size() does.
+    pthread_mutex_lock(&osd->fonts_lock);
+    while (!osd->fonts_ready)
+        pthread_cond_wait(&osd->fonts_wakeup, &osd->fonts_lock);
+    pthread_mutex_unlock(&osd->fonts_lock);
+
     ass->log = mp_log_new(NULL, osd->log, "libass");
     ass->library = mp_ass_init(osd->global, ass->log);
     ass_add_font(ass->library, "mpv-osd-symbols", (void *)osd_font_pfb,
@@ -87,6 +143,11 @@ static void destroy_external(struct osd_external *ext)
 
 void osd_destroy_backend(struct osd_state *osd)
 {
+    if (osd->fonts_thread_running)
+        pthread_join(osd->fonts_thread, NULL);
+    pthread_cond_destroy(&osd->fonts_wakeup);
+    pthread_mutex_destroy(&osd->fonts_lock);
+
     for (int n = 0; n < MAX_OSD_PARTS; n++) {
         struct osd_object *obj = osd->objs[n];
         destroy_ass_renderer(&obj->ass);
@@ -498,14 +559,17 @@ static void update_external(struct osd_state *osd, struct osd_object *obj,
     }
 }
 
-void osd_set_external(struct osd_state *osd, void *id, int res_x, int res_y,
-                      char *text)
+// Each (id, layer) pair is a separate overlay with its own ASS track, so a
+// client can update one layer without libass re-parsing and re-rendering the
+// others. Higher layers are drawn above lower ones.
+void osd_set_external(struct osd_state *osd, void *id, int layer,
+                      int res_x, int res_y, char *text)
 {
     pthread_mutex_lock(&osd->lock);
     struct osd_object *obj = osd->objs[OSDTYPE_EXTERNAL];
     struct osd_external *entry = 0;
     for (int n = 0; n < obj->num_externals; n++) {
-        if (obj->externals[n].id == id) {
+        if (obj->externals[n].id == id && obj->externals[n].layer == layer) {
             entry = &obj->externals[n];
             break;
         }
@@ -514,9 +578,13 @@ void osd_set_external(struct osd_state *osd, void *id, int res_x, int res_y,
         goto done;
 
     if (!entry) {
-        struct osd_external new = { .id = id };
-        MP_TARRAY_APPEND(obj, obj->externals, obj->num_externals, new);
-        entry = &obj->externals[obj->num_externals - 1];
+        // Keep the list sorted by layer, which is the render order.
+        int index = obj->num_externals;
+        while (index > 0 && obj->externals[index - 1].layer > layer)
+            index--;
+        struct osd_external new = { .id = id, .layer = layer };
+        MP_TARRAY_INSERT_AT(obj, obj->externals, obj->num_externals, index, new);
+        entry = &obj->externals[index];
     }
 
     if (!text) {
@@ -544,6 +612,22 @@ done:
     pthread_mutex_unlock(&osd->lock);
 }
 
+// Remove all layers of the given id.
+void osd_clear_external(struct osd_state *osd, void *id)
+{
+    pthread_mutex_lock(&osd->lock);
+    struct osd_object *obj = osd->objs[OSDTYPE_EXTERNAL];
+    for (int n = obj->num_externals - 1; n >= 0; n--) {
+        if (obj->externals[n].id == id) {
+            destroy_external(&obj->externals[n]);
+            MP_TARRAY_REMOVE_AT(obj->externals, obj->num_externals, n);
+            obj->changed = true;
+            osd->want_redraw_notification = true;
+        }
+    }
+    pthread_mutex_unlock(&osd->lock);
+}
+
 static void append_ass(struct ass_state *ass, struct mp_osd_res *res,
                        ASS_Image **img_list, bool *changed)
 {
@@ -565,6 +649,13 @@ static void append_ass(struct ass_state *ass, struct mp_osd_res *res,
 void osd_object_get_bitmaps(struct osd_state *osd, struct osd_object *obj,
                             int format, struct sub_bitmaps *out_imgs)
 {
+    // Show nothing until fonts are set up. The pending OSD state is kept, and
+    // a redraw is requested when the fonts are ready.
+    if (!fonts_ready(osd)) {
+        *out_imgs = (struct sub_bitmaps) {0};
+        return;
+    }
+
     if (obj->type == OSDTYPE_OSD && obj->osd_changed)
         update_osd(osd, obj);
 
@@ -57,6 +57,7 @@ struct osd_object {
 
 struct osd_external {
     void *id;
+    int layer;
     char *text;
     int res_x, res_y;
     struct ass_state ass;
@@ -79,6 +80,17 @@ struct osd_state {
     struct mp_log *log;
 
     struct mp_draw_sub_cache *draw_cache;
+
+    // for --osd-parallel-render, created on demand
+    struct mp_thread_pool *render_pool;
+
+    // osd_libass.c: font setup (fontconfig cache) done in the background
+    pthread_t fonts_thread;
+    bool fonts_thread_running;
+    pthread_mutex_t fonts_lock;
+    pthread_cond_t fonts_wakeup;
+    bool fonts_ready;           // protected by fonts_lock
+    struct osd_style_opts *fonts_style;
 };
 
 // defined in osd_libass.c and osd_dummy.c
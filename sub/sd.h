@@ -50,6 +50,9 @@ char **lavc_conv_decode(struct lavc_conv *priv, struct demux_packet *packet);
 void lavc_conv_reset(struct lavc_conv *priv);
 void lavc_conv_uninit(struct lavc_conv *priv);
 
-char *filter_SDH(struct sd *sd, char *format, int n_ignored, char *data, int length);
+struct sd_filter_sdh;
+struct sd_filter_sdh *filter_SDH_create(struct sd *sd, void *ta_parent,
+                                        char *format);
+char *filter_SDH(struct sd_filter_sdh *f, int n_ignored, char *data, int length);
 
 #endif
@@ -36,6 +36,13 @@
 #include "ass_mp.h"
 #include "sd.h"
 
+// Reference to an ass_track event, for the sorted event index.
+struct ev_ref {
+    long long start;
+    long long max_end;  // maximum end time of this and all previous refs
+    int idx;            // index into ASS_Track.events
+};
+
 struct sd_ass_priv {
     struct ass_library *ass_library;
     struct ass_renderer *ass_renderer;
@@ -46,12 +53,23 @@ struct sd_ass_priv {
     bool on_top;
     struct mp_ass_packer *packer;
     struct sub_bitmap *bs;
+    // bs contains the mangled version of the last packer output, done with
+    // these settings
+    bool bs_valid;
+    int bs_color_compat;
+    struct mp_image_params bs_params;
     char last_text[500];
     struct mp_image_params video_params;
     struct mp_image_params last_params;
     int64_t *seen_packets;
     int num_seen_packets;
     bool duration_unknown;
+    // ass_track events sorted by start time (see update_index())
+    struct ev_ref *index;
+    int num_index;
+    bool index_dirty;
+    int *found;         // for find_events()
+    struct sd_filter_sdh *filter;
 };
 
 static void mangle_colors(struct sd *sd, struct sub_bitmaps *parts);
@@ -226,10 +244,26 @@ static bool check_packet_seen(struct sd *sd, int64_t pos)
 
 #define UNKNOWN_DURATION (INT_MAX / 1000)
 
+// Return the --sub-filter-sdh/--sub-filter-regex filter, or NULL if disabled.
+static struct sd_filter_sdh *get_filter(struct sd *sd)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+    struct mp_subtitle_opts *opts = sd->opts;
+    if (!opts->sub_filter_SDH &&
+        !(opts->sub_filter_regex && opts->sub_filter_regex[0]))
+        return NULL;
+    if (!ctx->filter) {
+        ctx->filter = filter_SDH_create(sd, ctx,
+                                        ctx->ass_track->event_format);
+    }
+    return ctx->filter;
+}
+
 static void decode(struct sd *sd, struct demux_packet *packet)
 {
     struct sd_ass_priv *ctx = sd->priv;
     ASS_Track *track = ctx->ass_track;
+    struct sd_filter_sdh *filter = get_filter(sd);
     if (ctx->converter) {
         if (!sd->opts->sub_clear_on_seek && packet->pos >= 0 &&
             check_packet_seen(sd, packet->pos))
@@ -244,14 +278,15 @@ static void decode(struct sd *sd, struct demux_packet *packet)
         char **r = lavc_conv_decode(ctx->converter, packet);
         for (int n = 0; r && r[n]; n++) {
             char *ass_line = r[n];
-            if (sd->opts->sub_filter_SDH)
-                ass_line = filter_SDH(sd, track->event_format, 0, ass_line, 0);
+            if (filter)
+                ass_line = filter_SDH(filter, 0, ass_line, 0);
             if (ass_line)
                 ass_process_data(track, ass_line, strlen(ass_line));
-            if (sd->opts->sub_filter_SDH)
+            if (filter)
                 talloc_free(ass_line);
         }
         if (ctx->duration_unknown) {
+            ctx->index_dirty = true;
             for (int n = 0; n < track->n_events - 1; n++) {
                 if (track->events[n].Duration == UNKNOWN_DURATION * 1000) {
                     track->events[n].Duration = track->events[n + 1].Start -
@@ -264,15 +299,15 @@ static void decode(struct sd *sd, struct demux_packet *packet)
         // for discarding duplicate (already seen) packets.
         char *ass_line = packet->buffer;
         int ass_len = packet->len;
-        if (sd->opts->sub_filter_SDH) {
-            ass_line = filter_SDH(sd, track->event_format, 1, ass_line, ass_len);
+        if (filter) {
+            ass_line = filter_SDH(filter, 1, ass_line, ass_len);
             ass_len = ass_line ? strlen(ass_line) : 0;
         }
         if (ass_line)
             ass_process_chunk(track, ass_line, ass_len,
                               llrint(packet->pts * 1000),
                               llrint(packet->duration * 1000));
-        if (sd->opts->sub_filter_SDH)
+        if (filter)
             talloc_free(ass_line);
     }
 }
@@ -360,6 +395,91 @@ static bool has_overrides(char *s)
 
 #define END(ev) ((ev)->Start + (ev)->Duration)
 
+static int cmp_ev_ref(const void *a, const void *b)
+{
+    const struct ev_ref *ra = a, *rb = b;
+    if (ra->start != rb->start)
+        return ra->start < rb->start ? -1 : 1;
+    return ra->idx - rb->idx;
+}
+
+// Bring the event index up to date with ass_track. New events are normally
+// appended in order, which is cheap; anything else rebuilds the index.
+static void update_index(struct sd *sd)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+    ASS_Track *track = ctx->ass_track;
+
+    if (ctx->index_dirty || track->n_events < ctx->num_index) {
+        ctx->num_index = 0;
+        ctx->index_dirty = false;
+    }
+    if (ctx->num_index == track->n_events)
+        return;
+
+    MP_TARRAY_GROW(ctx, ctx->index, track->n_events);
+
+    bool sorted = true;
+    for (int n = ctx->num_index; n < track->n_events; n++) {
+        ASS_Event *ev = &track->events[n];
+        if (n && ctx->index[n - 1].start > ev->Start)
+            sorted = false;
+        ctx->index[n] = (struct ev_ref){ .start = ev->Start, .idx = n,
+                                         .max_end = END(ev) };
+    }
+    int first = ctx->num_index;
+    if (!sorted) {
+        qsort(ctx->index, track->n_events, sizeof(ctx->index[0]), cmp_ev_ref);
+        first = 0;
+    }
+    for (int n = first; n < track->n_events; n++) {
+        ASS_Event *ev = &track->events[ctx->index[n].idx];
+        long long prev = n ? ctx->index[n - 1].max_end : END(ev);
+        ctx->index[n].max_end = MPMAX(prev, END(ev));
+    }
+    ctx->num_index = track->n_events;
+}
+
+// Find all events in ass_track that overlap with [lo, hi] (inclusive), i.e.
+// Start <= hi && END >= lo. Returns the number of events, and the event
+// indexes in *out, in track order.
+static int find_events(struct sd *sd, long long lo, long long hi, int **out)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+    ASS_Track *track = ctx->ass_track;
+
+    update_index(sd);
+
+    // First ref with start > hi.
+    int a = 0, b = ctx->num_index;
+    while (a < b) {
+        int mid = a + (b - a) / 2;
+        if (ctx->index[mid].start > hi) {
+            b = mid;
+        } else {
+            a = mid + 1;
+        }
+    }
+
+    int num = 0;
+    for (int n = a - 1; n >= 0 && ctx->index[n].max_end >= lo; n--) {
+        int idx = ctx->index[n].idx;
+        if (END(&track->events[idx]) >= lo) {
+            MP_TARRAY_GROW(ctx, ctx->found, num);
+            ctx->found[num++] = idx;
+        }
+    }
+
+    // Restore track order (usually only a few events).
+    for (int i = 1; i < num; i++) {
+        for (int j = i; j > 0 && ctx->found[j - 1] > ctx->found[j]; j--)
+            MPSWAP(int, ctx->found[j - 1], ctx->found[j]);
+    }
+
+    *out = ctx->found;
+    return num;
+}
+
 static long long find_timestamp(struct sd *sd, double pts)
 {
     struct sd_ass_priv *priv = sd->priv;
@@ -379,13 +499,12 @@ static long long find_timestamp(struct sd *sd, double pts)
     // Find the "current" event.
     ASS_Event *ev[2] = {0};
     int n_ev = 0;
-    for (int n = 0; n < track->n_events; n++) {
-        ASS_Event *event = &track->events[n];
-        if (ts >= event->Start - threshold && ts <= END(event) + threshold) {
-            if (n_ev >= MP_ARRAY_SIZE(ev))
-                return ts; // multiple overlaps - give up (probably complex subs)
-            ev[n_ev++] = event;
-        }
+    int *found;
+    int num_found = find_events(sd, ts - threshold, ts + threshold, &found);
+    for (int n = 0; n < num_found; n++) {
+        if (n_ev >= MP_ARRAY_SIZE(ev))
+            return ts; // multiple overlaps - give up (probably complex subs)
+        ev[n_ev++] = &track->events[found[n]];
     }
 
     if (n_ev != 2)
@@ -460,6 +579,7 @@ static void get_bitmaps(struct sd *sd, struct mp_osd_res dim, int format,
     long long ts = find_timestamp(sd, pts);
     if (ctx->duration_unknown && pts != MP_NOPTS_VALUE) {
         mp_ass_flush_old_events(track, ts);
+        ctx->index_dirty = true;
         ctx->num_seen_packets = 0;
         sd->preload_ok = false;
     }
@@ -472,12 +592,27 @@ static void get_bitmaps(struct sd *sd, struct mp_osd_res dim, int format,
     mp_ass_packer_pack(ctx->packer, &imgs, 1, changed, format, res);
 
     if (!converted && res->num_parts > 0) {
-        // mangle_colors() modifies the color field, so copy the thing.
-        MP_TARRAY_GROW(ctx, ctx->bs, res->num_parts);
-        memcpy(ctx->bs, res->parts, sizeof(ctx->bs[0]) * res->num_parts);
+        // mangle_colors() modifies the color field, so copy the thing. If
+        // the packer returned its cached images, the previous copy is still
+        // good, unless the color settings changed.
+        bool reuse = ctx->bs_valid && !res->change_id &&
+            ctx->bs_color_compat == opts->ass_vsfilter_color_compat &&
+            mp_image_params_equal(&ctx->bs_params, &ctx->video_params);
+        if (!reuse) {
+            MP_TARRAY_GROW(ctx, ctx->bs, res->num_parts);
+            memcpy(ctx->bs, res->parts, sizeof(ctx->bs[0]) * res->num_parts);
+            res->parts = ctx->bs;
+
+            mangle_colors(sd, res);
+
+            ctx->bs_valid = true;
+            ctx->bs_color_compat = opts->ass_vsfilter_color_compat;
+            ctx->bs_params = ctx->video_params;
+            res->change_id = 1; // colors might have changed
+        }
         res->parts = ctx->bs;
-
-        mangle_colors(sd, res);
+    } else {
+        ctx->bs_valid = false;
     }
 }
 
@@ -564,8 +699,10 @@ static char *get_text(struct sd *sd, double pts)
 
     struct buf b = {ctx->last_text, sizeof(ctx->last_text) - 1};
 
-    for (int i = 0; i < track->n_events; ++i) {
-        ASS_Event *event = track->events + i;
+    int *found;
+    int num_found = find_events(sd, ipts, ipts, &found);
+    for (int i = 0; i < num_found; ++i) {
+        ASS_Event *event = track->events + found[i];
         if (ipts >= event->Start && ipts < event->Start + event->Duration) {
             if (event->Text) {
                 int start = b.len;
@@ -631,6 +768,7 @@ static void reset(struct sd *sd)
     struct sd_ass_priv *ctx = sd->priv;
     if (sd->opts->sub_clear_on_seek || ctx->duration_unknown) {
         ass_flush_events(ctx->ass_track);
+        ctx->index_dirty = true;
         ctx->num_seen_packets = 0;
         sd->preload_ok = false;
     }
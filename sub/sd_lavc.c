@@ -50,6 +50,13 @@ struct sub {
     double pts;
     double endpts;
     int64_t id;
+    // inbitmaps positioned for the last get_bitmaps() call, which can be
+    // reused as long as the parameters below stay the same
+    struct sub_bitmap *outbitmaps;
+    bool out_valid;
+    struct mp_osd_res out_res;
+    int out_w, out_h;
+    double out_par;
 };
 
 struct seekpoint {
@@ -61,7 +68,6 @@ struct sd_lavc_priv {
     AVCodecContext *avctx;
     AVRational pkt_timebase;
     struct sub subs[MAX_QUEUE]; // most recent event first
-    struct sub_bitmap *outbitmaps;
     int64_t displayed_id;
     int64_t new_id;
     struct mp_image_params video_params;
@@ -140,6 +146,7 @@ static void alloc_sub(struct sd_lavc_priv *priv)
     priv->subs[0].count = 0;
     priv->subs[0].src_w = 0;
     priv->subs[0].src_h = 0;
+    priv->subs[0].out_valid = false;
     priv->subs[0].id = priv->new_id++;
 }
 
@@ -410,19 +417,9 @@ static void get_bitmaps(struct sd *sd, struct mp_osd_res d, int format,
     if (!current)
         return;
 
-    MP_TARRAY_GROW(priv, priv->outbitmaps, current->count);
-    for (int n = 0; n < current->count; n++)
-        priv->outbitmaps[n] = current->inbitmaps[n];
-
-    res->parts = priv->outbitmaps;
-    res->num_parts = current->count;
     if (priv->displayed_id != current->id)
         res->change_id++;
     priv->displayed_id = current->id;
-    res->packed = current->data;
-    res->packed_w = current->bound_w;
-    res->packed_h = current->bound_h;
-    res->format = SUBBITMAP_RGBA;
 
     double video_par = 0;
     if (priv->avctx->codec_id == AV_CODEC_ID_DVD_SUBTITLE &&
@@ -447,7 +444,33 @@ static void get_bitmaps(struct sd *sd, struct mp_osd_res d, int format,
         w = priv->video_params.w;
         h = priv->video_params.h;
     }
-    osd_rescale_bitmaps(res, w, h, d, video_par);
+
+    // The sub is usually displayed for many frames with the same parameters.
+    if (!current->out_valid || !osd_res_equals(current->out_res, d) ||
+        current->out_w != w || current->out_h != h ||
+        current->out_par != video_par)
+    {
+        MP_TARRAY_GROW(priv, current->outbitmaps, current->count);
+        for (int n = 0; n < current->count; n++)
+            current->outbitmaps[n] = current->inbitmaps[n];
+        struct sub_bitmaps imgs = {
+            .parts = current->outbitmaps,
+            .num_parts = current->count,
+        };
+        osd_rescale_bitmaps(&imgs, w, h, d, video_par);
+        current->out_valid = true;
+        current->out_res = d;
+        current->out_w = w;
+        current->out_h = h;
+        current->out_par = video_par;
+    }
+
+    res->parts = current->outbitmaps;
+    res->num_parts = current->count;
+    res->packed = current->data;
+    res->packed_w = current->bound_w;
+    res->packed_h = current->bound_h;
+    res->format = SUBBITMAP_RGBA;
 }
 
 static bool accepts_packet(struct sd *sd, double min_pts)
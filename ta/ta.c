@@ -64,11 +64,38 @@ struct ta_ext_header {
     struct ta_header *header;  // points back to normal header
     struct ta_header children; // list of children, with this as sentinel
     void (*destructor)(void *);
+    // If set, new children are allocated from this arena.
+    struct ta_arena *arena;
+    // If set, the allocation itself is part of the arena's memory (and the
+    // ext header and the header are allocated together with it).
+    bool arena_owned;
 };
 
 // ta_ext_header.children.size is set to this
 #define CHILDREN_SENTINEL ((size_t)-1)
 
+union aligned_ext_header {
+    struct ta_ext_header ext;
+    char align_min[(sizeof(struct ta_ext_header) + MIN_ALIGN - 1) & ~(MIN_ALIGN - 1)];
+};
+
+// Size of the normal arena blocks. Larger allocations get their own block.
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+struct ta_arena_block {
+    struct ta_arena_block *prev;
+    size_t size, used;
+};
+
+union aligned_arena_block {
+    struct ta_arena_block block;
+    char align_min[(sizeof(struct ta_arena_block) + MIN_ALIGN - 1) & ~(MIN_ALIGN - 1)];
+};
+
+struct ta_arena {
+    struct ta_arena_block *blocks; // most recent block first
+};
+
 static void ta_dbg_add(struct ta_header *h);
 static void ta_dbg_check_header(struct ta_header *h);
 static void ta_dbg_remove(struct ta_header *h);
@@ -120,6 +147,9 @@ bool ta_set_parent(void *ptr, void *ta_parent)
     struct ta_ext_header *parent_eh = get_or_alloc_ext_header(ta_parent);
     if (ta_parent && !parent_eh) // do nothing on OOM
         return false;
+    // Arena memory must not outlive the arena.
+    assert(!(ch->ext && ch->ext->arena_owned) ||
+           (parent_eh && parent_eh->arena == ch->ext->arena));
     // Unlink from previous parent
     if (ch->next) {
         ch->next->prev = ch->prev;
@@ -137,6 +167,16 @@ bool ta_set_parent(void *ptr, void *ta_parent)
     return true;
 }
 
+static void *arena_alloc(void *ta_parent, struct ta_arena *arena, size_t size,
+                         bool zero);
+static void *arena_realloc(void *ptr, size_t size);
+
+static struct ta_arena *get_arena(void *ta_parent)
+{
+    struct ta_header *h = get_header(ta_parent);
+    return h && h->ext ? h->ext->arena : NULL;
+}
+
 /* Allocate size bytes of memory. If ta_parent is not NULL, this is used as
  * parent allocation (if ta_parent is freed, this allocation is automatically
  * freed as well). size==0 allocates a block of size 0 (i.e. returns non-NULL).
@@ -146,6 +186,9 @@ void *ta_alloc_size(void *ta_parent, size_t size)
 {
     if (size >= MAX_ALLOC)
         return NULL;
+    struct ta_arena *arena = get_arena(ta_parent);
+    if (arena)
+        return arena_alloc(ta_parent, arena, size, false);
     struct ta_header *h = malloc(sizeof(union aligned_header) + size);
     if (!h)
         return NULL;
@@ -166,6 +209,9 @@ void *ta_zalloc_size(void *ta_parent, size_t size)
 {
     if (size >= MAX_ALLOC)
         return NULL;
+    struct ta_arena *arena = get_arena(ta_parent);
+    if (arena)
+        return arena_alloc(ta_parent, arena, size, true);
     struct ta_header *h = calloc(1, sizeof(union aligned_header) + size);
     if (!h)
         return NULL;
@@ -205,6 +251,8 @@ void *ta_realloc_size(void *ta_parent, void *ptr, size_t size)
     struct ta_header *old_h = h;
     if (h->size == size)
         return ptr;
+    if (h->ext && h->ext->arena_owned)
+        return arena_realloc(ptr, size);
     ta_dbg_remove(h);
     h = realloc(h, sizeof(union aligned_header) + size);
     ta_dbg_add(h ? h : old_h);
@@ -266,10 +314,146 @@ void ta_free(void *ptr)
         h->prev->next = h->next;
     }
     ta_dbg_remove(h);
+    struct ta_ext_header *eh = h->ext;
+    if (eh && eh->arena_owned)
+        return; // memory is released with the arena
+    if (eh && eh->arena) {
+        struct ta_arena_block *block = eh->arena->blocks;
+        while (block) {
+            struct ta_arena_block *prev = block->prev;
+            free(block);
+            block = prev;
+        }
+        free(eh->arena);
+    }
     free(h->ext);
     free(h);
 }
 
+/* Create a new empty allocation (like ta_new_context()), whose direct and
+ * indirect children are bump-allocated from large memory blocks. The memory
+ * blocks are released at once when the arena is freed. Individually freeing
+ * or reallocating children is allowed, but doesn't return memory.
+ *
+ * This is meant for temporary allocations that are all freed together, such
+ * as parsing and formatting results. Allocations from the arena must not be
+ * moved to a parent outside of the arena (or set to have no parent), because
+ * their memory is owned by the arena. Moving other allocations into the arena
+ * is fine.
+ *
+ * Returns NULL on OOM.
+ */
+void *ta_new_arena(void *ta_parent)
+{
+    void *ptr = ta_alloc_size(ta_parent, 0);
+    struct ta_ext_header *eh = get_or_alloc_ext_header(ptr);
+    struct ta_arena *arena = eh ? malloc(sizeof(*arena)) : NULL;
+    if (!arena) {
+        ta_free(ptr);
+        return NULL;
+    }
+    *arena = (struct ta_arena){0};
+    eh->arena = arena;
+    return ptr;
+}
+
+static void *arena_alloc(void *ta_parent, struct ta_arena *arena, size_t size,
+                         bool zero)
+{
+    size_t hsize = sizeof(union aligned_ext_header) + sizeof(union aligned_header);
+    if (size >= MAX_ALLOC - hsize - MIN_ALIGN)
+        return NULL;
+    size_t alloc_size = (hsize + size + MIN_ALIGN - 1) & ~(size_t)(MIN_ALIGN - 1);
+
+    struct ta_arena_block *block = arena->blocks;
+    if (!block || block->size - block->used < alloc_size) {
+        size_t block_size = ARENA_BLOCK_SIZE;
+        bool own_block = alloc_size > ARENA_BLOCK_SIZE / 4;
+        if (own_block)
+            block_size = alloc_size;
+        size_t bsize = sizeof(union aligned_arena_block);
+        if (block_size > MAX_ALLOC - bsize)
+            return NULL;
+        block = malloc(bsize + block_size);
+        if (!block)
+            return NULL;
+        *block = (struct ta_arena_block){.size = block_size};
+        if (own_block && arena->blocks) {
+            // Keep bump-allocating from the current block.
+            block->prev = arena->blocks->prev;
+            arena->blocks->prev = block;
+        } else {
+            block->prev = arena->blocks;
+            arena->blocks = block;
+        }
+    }
+
+    char *mem = (char *)((union aligned_arena_block *)block + 1) + block->used;
+    block->used += alloc_size;
+
+    struct ta_ext_header *eh = &((union aligned_ext_header *)mem)->ext;
+    struct ta_header *h =
+        (struct ta_header *)(mem + sizeof(union aligned_ext_header));
+    *h = (struct ta_header) {.size = size, .ext = eh};
+    *eh = (struct ta_ext_header) {
+        .header = h,
+        .children = {
+            .next = &eh->children,
+            .prev = &eh->children,
+            .size = CHILDREN_SENTINEL,
+            .ext = eh,
+        },
+        .arena = arena,
+        .arena_owned = true,
+    };
+    ta_dbg_add(h);
+    void *ptr = PTR_FROM_HEADER(h);
+    if (zero)
+        memset(ptr, 0, size);
+    if (ta_parent)
+        ta_set_parent(ptr, ta_parent);
+    return ptr;
+}
+
+static void *arena_realloc(void *ptr, size_t size)
+{
+    struct ta_header *h = get_header(ptr);
+    if (size <= h->size) {
+        h->size = size;
+        return ptr;
+    }
+
+    struct ta_ext_header *eh = h->ext;
+    void *new_ptr = arena_alloc(NULL, eh->arena, size, false);
+    if (!new_ptr)
+        return NULL;
+    struct ta_header *new_h = get_header(new_ptr);
+    struct ta_ext_header *new_eh = new_h->ext;
+    memcpy(new_ptr, ptr, h->size);
+
+    // Move the old header state over, and fix all links to it.
+    ta_dbg_remove(new_h);
+    ta_dbg_remove(h);
+    *new_h = *h;
+    *new_eh = *eh;
+    new_h->size = size;
+    new_h->ext = new_eh;
+    new_eh->header = new_h;
+    new_eh->children.ext = new_eh;
+    ta_dbg_add(new_h);
+    if (new_h->next) {
+        new_h->next->prev = new_h;
+        new_h->prev->next = new_h;
+    }
+    if (eh->children.next == &eh->children) {
+        new_eh->children.next = new_eh->children.prev = &new_eh->children;
+    } else {
+        new_eh->children.next->prev = &new_eh->children;
+        new_eh->children.prev->next = &new_eh->children;
+    }
+    return new_ptr;
+}
+
 /* Set a destructor that is to be called when the given allocation is freed.
  * (Whether the allocation is directly freed with ta_free() or indirectly by
  * freeing its parent does not matter.) There is only one destructor. If an
@@ -0,0 +1,53 @@
+#include "test_helpers.h"
+#include "common/common.h"
+#include "misc/msgpack.h"
+
+static void test_msgpack_roundtrip(void **state) {
+    void *ta = talloc_new(NULL);
+
+    struct mpv_node_list list = {0};
+    struct mpv_node root = {.format = MPV_FORMAT_NODE_MAP, .u.list = &list};
+    char *keys[] = {"a", "b", "c", "d", "e"};
+    struct mpv_node values[] = {
+        {.format = MPV_FORMAT_INT64, .u.int64 = -5},
+        {.format = MPV_FORMAT_INT64, .u.int64 = 1LL << 40},
+        {.format = MPV_FORMAT_DOUBLE, .u.double_ = 0.25},
+        {.format = MPV_FORMAT_STRING, .u.string = "hello"},
+        {.format = MPV_FORMAT_FLAG, .u.flag = 1},
+    };
+    list.keys = keys;
+    list.values = values;
+    list.num = MP_ARRAY_SIZE(values);
+
+    bstr buf = {0};
+    assert_int_equal(msgpack_write(ta, &buf, &root), 0);
+
+    struct mpv_node res;
+    bstr src = buf;
+    assert_int_equal(msgpack_parse(ta, &res, &src, 10), 0);
+    assert_int_equal(src.len, 0);
+    assert_int_equal(res.format, MPV_FORMAT_NODE_MAP);
+    assert_int_equal(res.u.list->num, list.num);
+    for (int n = 0; n < list.num; n++)
+        assert_string_equal(res.u.list->keys[n], keys[n]);
+    struct mpv_node *v = res.u.list->values;
+    assert_int_equal(v[0].u.int64, -5);
+    assert_true(v[1].u.int64 == 1LL << 40);
+    assert_double_equal(v[2].u.double_, 0.25);
+    assert_string_equal(v[3].u.string, "hello");
+    assert_int_equal(v[4].format, MPV_FORMAT_FLAG);
+    assert_int_equal(v[4].u.flag, 1);
+
+    // Truncated input must fail.
+    src = (bstr){buf.start, buf.len - 1};
+    assert_int_equal(msgpack_parse(ta, &res, &src, 10), -1);
+
+    talloc_free(ta);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_msgpack_roundtrip),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -26,6 +26,7 @@
 #include "options/options.h"
 #include "common/msg.h"
 
+#include "osdep/threads.h"
 #include "osdep/timer.h"
 
 #include "stream/stream.h"
@@ -57,9 +58,45 @@ const vd_functions_t * const mpcodecs_vd_drivers[] = {
     NULL
 };
 
-void video_reset(struct dec_video *d_video)
+// Wait until the decoder thread is idle, and keep it from decoding until
+// release_decoder() is called.
+static void hold_decoder(struct dec_video *d_video)
+{
+    if (!d_video->thread_valid)
+        return;
+    pthread_mutex_lock(&d_video->lock);
+    d_video->hold++;
+    while (d_video->busy)
+        pthread_cond_wait(&d_video->wakeup, &d_video->lock);
+    pthread_mutex_unlock(&d_video->lock);
+}
+
+static void release_decoder(struct dec_video *d_video)
 {
-    video_vd_control(d_video, VDCTRL_RESET, NULL);
+    if (!d_video->thread_valid)
+        return;
+    pthread_mutex_lock(&d_video->lock);
+    d_video->hold--;
+    pthread_cond_broadcast(&d_video->wakeup);
+    pthread_mutex_unlock(&d_video->lock);
+}
+
+static void flush_queue(struct dec_video *d_video)
+{
+    pthread_mutex_lock(&d_video->lock);
+    for (int n = 0; n < d_video->num_queue; n++)
+        talloc_free(d_video->queue[n]);
+    d_video->num_queue = 0;
+    d_video->queue_bytes = 0;
+    d_video->queue_state = DATA_AGAIN;
+    d_video->queue_start_pts = MP_NOPTS_VALUE;
+    pthread_mutex_unlock(&d_video->lock);
+}
+
+static void reset_decoder(struct dec_video *d_video)
+{
+    if (d_video->vd_driver)
+        d_video->vd_driver->control(d_video, VDCTRL_RESET, NULL);
     d_video->first_packet_pdts = MP_NOPTS_VALUE;
     d_video->start_pts = MP_NOPTS_VALUE;
     d_video->decoded_pts = MP_NOPTS_VALUE;
@@ -78,18 +115,41 @@ void video_reset(struct dec_video *d_video)
     d_video->start = d_video->end = MP_NOPTS_VALUE;
 }
 
+void video_reset(struct dec_video *d_video)
+{
+    hold_decoder(d_video);
+    if (d_video->thread_valid)
+        flush_queue(d_video);
+    reset_decoder(d_video);
+    release_decoder(d_video);
+}
+
 int video_vd_control(struct dec_video *d_video, int cmd, void *arg)
 {
+    int r = CONTROL_UNKNOWN;
+    hold_decoder(d_video);
     const struct vd_functions *vd = d_video->vd_driver;
     if (vd)
-        return vd->control(d_video, cmd, arg);
-    return CONTROL_UNKNOWN;
+        r = vd->control(d_video, cmd, arg);
+    release_decoder(d_video);
+    return r;
 }
 
 void video_uninit(struct dec_video *d_video)
 {
     if (!d_video)
         return;
+    if (d_video->thread_valid) {
+        pthread_mutex_lock(&d_video->lock);
+        d_video->terminate = true;
+        pthread_cond_broadcast(&d_video->wakeup);
+        pthread_mutex_unlock(&d_video->lock);
+        pthread_join(d_video->thread, NULL);
+        d_video->thread_valid = false;
+        flush_queue(d_video);
+        pthread_cond_destroy(&d_video->wakeup);
+        pthread_mutex_destroy(&d_video->lock);
+    }
     mp_image_unrefp(&d_video->current_mpi);
     if (d_video->vd_driver) {
         MP_VERBOSE(d_video, "Uninit video.\n");
@@ -141,7 +201,7 @@ bool video_init_best_codec(struct dec_video *d_video)
     struct MPOpts *opts = d_video->opts;
 
     assert(!d_video->vd_driver);
-    video_reset(d_video);
+    reset_decoder(d_video);
     d_video->has_broken_packet_pts = -10; // needs 10 packets to reach decision
 
     struct mp_decoder_entry *decoder = NULL;
@@ -365,7 +425,7 @@ static bool receive_frame(struct dec_video *d_video, struct mp_image **out_image
         mpi->pts != MP_NOPTS_VALUE && d_video->fps > 0)
     {
         int delay = -1;
-        video_vd_control(d_video, VDCTRL_GET_BFRAMES, &delay);
+        d_video->vd_driver->control(d_video, VDCTRL_GET_BFRAMES, &delay);
         mpi->pts -= MPMAX(delay, 0) / d_video->fps;
     }
 
@@ -375,23 +435,59 @@ static bool receive_frame(struct dec_video *d_video, struct mp_image **out_image
 
 void video_reset_params(struct dec_video *d_video)
 {
+    hold_decoder(d_video);
     d_video->last_format = (struct mp_image_params){0};
+    release_decoder(d_video);
 }
 
 void video_get_dec_params(struct dec_video *d_video, struct mp_image_params *p)
 {
+    hold_decoder(d_video);
     *p = d_video->dec_format;
+    release_decoder(d_video);
+}
+
+void video_set_recorder_sink(struct dec_video *d_video,
+                             struct mp_recorder_sink *sink)
+{
+    hold_decoder(d_video);
+    d_video->recorder_sink = sink;
+    release_decoder(d_video);
 }
 
 void video_set_framedrop(struct dec_video *d_video, bool enabled)
 {
-    d_video->framedrop_enabled = enabled;
+    if (d_video->thread_valid) {
+        pthread_mutex_lock(&d_video->lock);
+        d_video->queue_framedrop = enabled;
+        pthread_mutex_unlock(&d_video->lock);
+    } else {
+        d_video->framedrop_enabled = enabled;
+    }
+}
+
+// Skip all frames except keyframes. (Used for --keyframe-scrub.)
+void video_set_keyframes_only(struct dec_video *d_video, bool enabled)
+{
+    if (d_video->thread_valid) {
+        pthread_mutex_lock(&d_video->lock);
+        d_video->queue_keyframes_only = enabled;
+        pthread_mutex_unlock(&d_video->lock);
+    } else {
+        d_video->keyframes_only = enabled;
+    }
 }
 
 // Frames before the start timestamp can be dropped. (Used for hr-seek.)
 void video_set_start(struct dec_video *d_video, double start_pts)
 {
-    d_video->start_pts = start_pts;
+    if (d_video->thread_valid) {
+        pthread_mutex_lock(&d_video->lock);
+        d_video->queue_start_pts = start_pts;
+        pthread_mutex_unlock(&d_video->lock);
+    } else {
+        d_video->start_pts = start_pts;
+    }
 }
 
 static bool is_new_segment(struct dec_video *d_video, struct demux_packet *p)
@@ -431,6 +527,8 @@ static void feed_packet(struct dec_video *d_video)
     {
         framedrop_type = 2;
     }
+    if (d_video->keyframes_only)
+        framedrop_type = 3;
 
     d_video->vd_driver->control(d_video, VDCTRL_SET_FRAMEDROP, &framedrop_type);
 
@@ -483,7 +581,7 @@ static void read_frame(struct dec_video *d_video)
         d_video->new_segment = NULL;
 
         if (d_video->codec == new_segment->codec) {
-            video_reset(d_video);
+            reset_decoder(d_video);
         } else {
             d_video->codec = new_segment->codec;
             d_video->vd_driver->uninit(d_video);
@@ -499,7 +597,7 @@ static void read_frame(struct dec_video *d_video)
     }
 }
 
-void video_work(struct dec_video *d_video)
+static void decode_step(struct dec_video *d_video)
 {
     read_frame(d_video);
     if (!d_video->current_mpi) {
@@ -510,12 +608,8 @@ void video_work(struct dec_video *d_video)
     }
 }
 
-// Fetch an image decoded with video_work(). Returns one of:
-//  DATA_OK:    *out_mpi is set to a new image
-//  DATA_WAIT:  waiting for demuxer; will receive a wakeup signal
-//  DATA_EOF:   end of file, no more frames to be expected
-//  DATA_AGAIN: dropped frame or something similar
-int video_get_frame(struct dec_video *d_video, struct mp_image **out_mpi)
+static int get_decoded_frame(struct dec_video *d_video,
+                             struct mp_image **out_mpi)
 {
     *out_mpi = NULL;
     if (d_video->current_mpi) {
@@ -527,3 +621,130 @@ int video_get_frame(struct dec_video *d_video, struct mp_image **out_mpi)
         return DATA_AGAIN;
     return d_video->current_state;
 }
+
+static int64_t frame_bytes(struct mp_image *img)
+{
+    int64_t size = 0;
+    for (int n = 0; n < img->num_planes; n++)
+        size += (int64_t)abs(img->stride[n]) * mp_image_plane_h(img, n);
+    return size;
+}
+
+static bool locked_queue_full(struct dec_video *d_video)
+{
+    struct MPOpts *opts = d_video->opts;
+    return d_video->num_queue >= opts->vd_queue_max_frames ||
+           (opts->vd_queue_max_bytes &&
+            d_video->queue_bytes >= opts->vd_queue_max_bytes);
+}
+
+static void *decode_thread(void *ptr)
+{
+    struct dec_video *d_video = ptr;
+
+    mpthread_set_name("vd");
+    mpthread_apply_opts(d_video->global, d_video->log, "vd");
+
+    pthread_mutex_lock(&d_video->lock);
+    while (!d_video->terminate) {
+        int state = d_video->queue_state;
+        bool stalled = (state == DATA_WAIT && !d_video->kick) ||
+                       state == DATA_EOF;
+        if (d_video->hold || stalled || locked_queue_full(d_video)) {
+            pthread_cond_wait(&d_video->wakeup, &d_video->lock);
+            continue;
+        }
+
+        d_video->kick = false;
+        d_video->start_pts = d_video->queue_start_pts;
+        d_video->framedrop_enabled = d_video->queue_framedrop;
+        d_video->keyframes_only = d_video->queue_keyframes_only;
+        d_video->busy = true;
+        pthread_mutex_unlock(&d_video->lock);
+
+        struct mp_image *mpi;
+        decode_step(d_video);
+        state = get_decoded_frame(d_video, &mpi);
+
+        pthread_mutex_lock(&d_video->lock);
+        if (mpi) {
+            MP_TARRAY_APPEND(d_video, d_video->queue, d_video->num_queue, mpi);
+            d_video->queue_bytes += frame_bytes(mpi);
+        }
+        d_video->queue_state = state;
+        d_video->busy = false;
+        pthread_cond_broadcast(&d_video->wakeup);
+
+        // On DATA_WAIT, the demuxer wakes up the player, which then kicks us
+        // with video_work().
+        if ((mpi || state == DATA_EOF) && d_video->wakeup_cb) {
+            pthread_mutex_unlock(&d_video->lock);
+            d_video->wakeup_cb(d_video->wakeup_ctx);
+            pthread_mutex_lock(&d_video->lock);
+        }
+    }
+    pthread_mutex_unlock(&d_video->lock);
+    return NULL;
+}
+
+static void start_thread(struct dec_video *d_video)
+{
+    pthread_mutex_init(&d_video->lock, NULL);
+    pthread_cond_init(&d_video->wakeup, NULL);
+    d_video->queue_state = DATA_AGAIN;
+    d_video->queue_start_pts = d_video->start_pts;
+    d_video->queue_framedrop = d_video->framedrop_enabled;
+    d_video->queue_keyframes_only = d_video->keyframes_only;
+    if (pthread_create(&d_video->thread, NULL, decode_thread, d_video)) {
+        MP_ERR(d_video, "Could not create decoder thread.\n");
+        pthread_cond_destroy(&d_video->wakeup);
+        pthread_mutex_destroy(&d_video->lock);
+        return;
+    }
+    d_video->thread_valid = true;
+    MP_VERBOSE(d_video, "Decoding on a separate thread.\n");
+}
+
+void video_work(struct dec_video *d_video)
+{
+    if (d_video->opts->vd_queue_enable && !d_video->thread_valid &&
+        d_video->vd_driver && !d_video->current_mpi)
+        start_thread(d_video);
+
+    if (d_video->thread_valid) {
+        pthread_mutex_lock(&d_video->lock);
+        d_video->kick = true;
+        pthread_cond_broadcast(&d_video->wakeup);
+        pthread_mutex_unlock(&d_video->lock);
+        return;
+    }
+
+    decode_step(d_video);
+}
+
+// Fetch an image decoded with video_work(). Returns one of:
+//  DATA_OK:    *out_mpi is set to a new image
+//  DATA_WAIT:  waiting for demuxer or decoder thread; will receive a wakeup
+//  DATA_EOF:   end of file, no more frames to be expected
+//  DATA_AGAIN: dropped frame or something similar
+int video_get_frame(struct dec_video *d_video, struct mp_image **out_mpi)
+{
+    if (!d_video->thread_valid)
+        return get_decoded_frame(d_video, out_mpi);
+
+    *out_mpi = NULL;
+    pthread_mutex_lock(&d_video->lock);
+    int r = d_video->queue_state;
+    if (d_video->num_queue) {
+        *out_mpi = d_video->queue[0];
+        MP_TARRAY_REMOVE_AT(d_video->queue, d_video->num_queue, 0);
+        d_video->queue_bytes -= frame_bytes(*out_mpi);
+        pthread_cond_broadcast(&d_video->wakeup);
+        r = DATA_OK;
+    } else if (r != DATA_EOF) {
+        // The thread is still decoding, and will wake us up.
+        r = DATA_WAIT;
+    }
+    pthread_mutex_unlock(&d_video->lock);
+    return r;
+}
@@ -19,6 +19,8 @@
 #define MPLAYER_DEC_VIDEO_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include "demux/stheader.h"
 #include "video/hwdec.h"
@@ -45,6 +47,11 @@ struct dec_video {
 
     struct mp_recorder_sink *recorder_sink;
 
+    // Called from the decoder thread (--vd-queue-enable) if a frame or EOF
+    // becomes available. Must be set before the first video_work() call.
+    void (*wakeup_cb)(void *ctx);
+    void *wakeup_ctx;
+
     // Internal (shared with vd_lavc.c).
 
     void *priv; // for free use by vd_driver
@@ -77,9 +84,30 @@ struct dec_video {
     struct demux_packet *new_segment;
     struct demux_packet *packet;
     bool framedrop_enabled;
+    bool keyframes_only;
     bool may_decoder_framedrop;
     struct mp_image *current_mpi;
     int current_state;
+
+    // Decoder thread. While it's busy, it owns all fields above. The API
+    // functions only touch them while hold > 0 and busy is false.
+    pthread_t thread;
+    bool thread_valid;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+
+    // --- the following members are protected by lock
+    struct mp_image **queue;    // decoded frames, oldest first
+    int num_queue;
+    int64_t queue_bytes;
+    int queue_state;            // DATA_* result of the last decode step
+    bool busy;
+    bool kick;                  // retry after DATA_WAIT
+    bool terminate;
+    int hold;
+    double queue_start_pts;     // video_set_start() value
+    bool queue_framedrop;       // video_set_framedrop() value
+    bool queue_keyframes_only;  // video_set_keyframes_only() value
 };
 
 struct mp_decoder_list *video_decoder_list(void);
@@ -92,10 +120,13 @@ int video_get_frame(struct dec_video *d_video, struct mp_image **out_mpi);
 
 void video_set_framedrop(struct dec_video *d_video, bool enabled);
 void video_set_start(struct dec_video *d_video, double start_pts);
+void video_set_keyframes_only(struct dec_video *d_video, bool enabled);
 
 int video_vd_control(struct dec_video *d_video, int cmd, void *arg);
 void video_reset(struct dec_video *d_video);
 void video_reset_params(struct dec_video *d_video);
+void video_set_recorder_sink(struct dec_video *d_video,
+                             struct mp_recorder_sink *sink);
 void video_get_dec_params(struct dec_video *d_video, struct mp_image_params *p);
 
 #endif /* MPLAYER_DEC_VIDEO_H */
@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <pthread.h>
 #include <assert.h>
 #include <stdbool.h>
@@ -35,6 +36,8 @@
 #include "misc/bstr.h"
 #include "common/av_common.h"
 #include "common/codecs.h"
+#include "common/stats.h"
+#include "osdep/timer.h"
 
 #include "video/fmt-conversion.h"
 
@@ -68,6 +71,12 @@ static enum AVPixelFormat get_format_hwdec(struct AVCodecContext *avctx,
 // interpolation, this value has to be increased too.
 #define HWDEC_EXTRA_SURFACES 6
 
+// --vd-lavc-threads=adaptive: number of frames to skip after (re)opening the
+// decoder, number of frames to measure, and how often to retune per stream.
+#define TUNE_SKIP_FRAMES 10
+#define TUNE_FRAMES 50
+#define TUNE_MAX_COUNT 3
+
 #define OPT_BASE_STRUCT struct vd_lavc_params
 
 struct vd_lavc_params {
@@ -107,7 +116,8 @@ const struct m_sub_options vd_lavc_conf = {
         OPT_DISCARD("skipidct", skip_idct, 0),
         OPT_DISCARD("skipframe", skip_frame, 0),
         OPT_DISCARD("framedrop", framedrop, 0),
-        OPT_INT("threads", threads, M_OPT_MIN, .min = 0),
+        OPT_CHOICE_OR_INT("threads", threads, 0, 0, INT_MAX,
+                          ({"adaptive", -1})),
         OPT_FLAG("bitexact", bitexact, 0),
         OPT_FLAG("assume-old-x264", old_x264, 0),
         OPT_FLAG("check-hw-profile", check_hw_profile, 0),
@@ -146,6 +156,7 @@ struct hwdec_info {
 
 typedef struct lavc_ctx {
     struct mp_log *log;
+    struct stats_ctx *stats;
     struct MPOpts *opts;
     AVCodecContext *avctx;
     AVFrame *pic;
@@ -183,9 +194,21 @@ typedef struct lavc_ctx {
     int hwdec_fail_count;
 
     struct mp_image_pool *hwdec_swpool;
+    bool hwdec_swpool_dr_failed;
 
     AVBufferRef *cached_hw_frames_ctx;
 
+    // --vd-lavc-threads=adaptive. tune_threads==0 means use the default.
+    int tune_threads, tune_type;
+    int tune_frames;            // frames decoded since measuring started
+    double tune_time;           // time spent in libavcodec calls
+    double tune_duration;       // duration of the measured frames
+    double decode_time;         // time spent in libavcodec for the next frame
+    int tune_count;             // number of retunes for this stream
+    int tune_w, tune_h, tune_imgfmt;
+    bool retune_pending;        // reopen decoder on the next keyframe
+    bool retune_draining;       // draining old decoder before reopening
+
     // --- The following fields are protected by dr_lock.
     pthread_mutex_t dr_lock;
     bool dr_failed;
@@ -367,6 +390,18 @@ static bool hwdec_codec_allowed(struct dec_video *vd, const char *codec)
     return false;
 }
 
+// Make the VO load the interop for this hwdec. If the surface format is known,
+// only interops that can map it are loaded.
+static void request_hwdec_devs(struct dec_video *vd, struct hwdec_info *hwdec)
+{
+    int imgfmt = pixfmt2imgfmt(hwdec->pix_fmt);
+    if (imgfmt) {
+        hwdec_devices_request(vd->hwdec_devs, imgfmt);
+    } else {
+        hwdec_devices_request_all(vd->hwdec_devs);
+    }
+}
+
 static AVBufferRef *hwdec_create_dev(struct dec_video *vd,
                                      struct hwdec_info *hwdec,
                                      bool autoprobe)
@@ -387,7 +422,7 @@ static AVBufferRef *hwdec_create_dev(struct dec_video *vd,
             return ref;
         }
     } else if (vd->hwdec_devs) {
-        hwdec_devices_request_all(vd->hwdec_devs);
+        request_hwdec_devs(vd, hwdec);
         return hwdec_devices_get_lavc(vd->hwdec_devs, hwdec->lavc_device);
     }
 
@@ -455,7 +490,7 @@ static void select_and_set_hwdec(struct dec_video *vd)
                 // Most likely METHOD_INTERNAL, which often use delay-loaded
                 // VO support as well.
                 if (vd->hwdec_devs)
-                    hwdec_devices_request_all(vd->hwdec_devs);
+                    request_hwdec_devs(vd, hwdec);
             }
 
             ctx->use_hwdec = true;
@@ -523,12 +558,95 @@ static void force_fallback(struct dec_video *vd)
     init_avctx(vd);
 }
 
+static void reset_tuning(struct dec_video *vd)
+{
+    vd_ffmpeg_ctx *ctx = vd->priv;
+    ctx->tune_frames = 0;
+    ctx->tune_time = ctx->tune_duration = 0;
+    ctx->tune_count = 0;
+    ctx->retune_pending = false;
+}
+
+// Decide whether the threading mode fits the measured decoding load, and if
+// not, request reopening the decoder with a better setup.
+static void update_tuning(struct dec_video *vd, struct mp_image *mpi,
+                          double time)
+{
+    vd_ffmpeg_ctx *ctx = vd->priv;
+    AVCodecContext *avctx = ctx->avctx;
+    struct vd_lavc_params *opts = ctx->opts->vd_lavc_params;
+
+    if (opts->threads >= 0 || ctx->use_hwdec || !avctx->active_thread_type)
+        return;
+
+    // Stream change - measure again.
+    if (mpi->w != ctx->tune_w || mpi->h != ctx->tune_h ||
+        mpi->imgfmt != ctx->tune_imgfmt)
+    {
+        reset_tuning(vd);
+        ctx->tune_w = mpi->w;
+        ctx->tune_h = mpi->h;
+        ctx->tune_imgfmt = mpi->imgfmt;
+    }
+
+    if (ctx->retune_pending || ctx->tune_count >= TUNE_MAX_COUNT ||
+        ctx->framedrop_flags)
+        return;
+
+    ctx->tune_frames++;
+    if (ctx->tune_frames <= TUNE_SKIP_FRAMES)
+        return;
+
+    double duration = vd->fps > 0 ? 1.0 / vd->fps : mpi->pkt_duration;
+    if (!(duration > 0))
+        duration = 1.0 / 25;
+    ctx->tune_time += time;
+    ctx->tune_duration += duration;
+    if (ctx->tune_frames < TUNE_SKIP_FRAMES + TUNE_FRAMES)
+        return;
+
+    // Fraction of real time the caller is blocked in the decoder.
+    double load = ctx->tune_time / ctx->tune_duration;
+    int threads = avctx->thread_count;
+    MP_VERBOSE(vd, "Decoding load %.2f with %d threads (%s).\n", load,
+               threads, avctx->active_thread_type == FF_THREAD_FRAME
+                        ? "frame" : "slice");
+
+    if (avctx->active_thread_type == FF_THREAD_FRAME) {
+        // Frame threading adds a frame of latency per thread. If even a
+        // single thread could comfortably keep up, use slice threading with
+        // just enough threads instead.
+        double single = load * threads;
+        if (single < 0.5) {
+            ctx->tune_type = FF_THREAD_SLICE;
+            ctx->tune_threads = MPCLAMP((int)ceil(single * 4), 1, threads);
+            ctx->retune_pending = true;
+        }
+    } else if (load > 0.75) {
+        // Falling behind. Go back to the default (frame threading).
+        ctx->tune_type = 0;
+        ctx->tune_threads = 0;
+        ctx->retune_pending = true;
+    }
+
+    if (ctx->retune_pending) {
+        MP_VERBOSE(vd, "Switching to %s threading.\n",
+                   ctx->tune_threads ? "slice" : "default");
+        ctx->tune_count++;
+    }
+    ctx->tune_frames = 0;
+    ctx->tune_time = ctx->tune_duration = 0;
+}
+
 static void reinit(struct dec_video *vd)
 {
     vd_ffmpeg_ctx *ctx = vd->priv;
 
     uninit_avctx(vd);
 
+    reset_tuning(vd);
+    ctx->tune_threads = 0;
+
     select_and_set_hwdec(vd);
 
     bool use_hwdec = ctx->use_hwdec;
@@ -537,15 +655,38 @@ static void reinit(struct dec_video *vd)
         force_fallback(vd);
 }
 
+// Allocate images for copy-back hwdec. With --vd-lavc-dr, the download goes
+// straight into VO memory, so that uploading it again is (nearly) free.
+static struct mp_image *hwdec_swpool_alloc(void *data, int fmt, int w, int h)
+{
+    struct dec_video *vd = data;
+    vd_ffmpeg_ctx *ctx = vd->priv;
+    struct mp_image *img = NULL;
+
+    if (vd->vo && ctx->opts->vd_lavc_params->dr && !ctx->hwdec_swpool_dr_failed) {
+        // av_hwframe_transfer_data() has no alignment requirements; use what
+        // the software converters like.
+        img = vo_get_image(vd->vo, fmt, w, h, 64);
+        if (!img) {
+            MP_VERBOSE(vd, "DR for hwdec copy-back failed - disabling.\n");
+            ctx->hwdec_swpool_dr_failed = true;
+        }
+    }
+
+    return img ? img : mp_image_alloc(fmt, w, h);
+}
+
 static int init(struct dec_video *vd, const char *decoder)
 {
     vd_ffmpeg_ctx *ctx;
     ctx = vd->priv = talloc_zero(NULL, vd_ffmpeg_ctx);
     ctx->log = vd->log;
+    ctx->stats = stats_ctx_create(ctx, vd->global, "vd_lavc");
     ctx->opts = vd->opts;
     ctx->decoder = talloc_strdup(ctx, decoder);
     ctx->hwdec_devs = vd->hwdec_devs;
     ctx->hwdec_swpool = mp_image_pool_new(ctx);
+    mp_image_pool_set_allocator(ctx->hwdec_swpool, hwdec_swpool_alloc, vd);
     ctx->dr_pool = mp_image_pool_new(ctx);
 
     pthread_mutex_init(&ctx->dr_lock, NULL);
@@ -628,9 +769,14 @@ static void init_avctx(struct dec_video *vd)
         if (ctx->hwdec.copying)
             ctx->max_delay_queue = HWDEC_DELAY_QUEUE_COUNT;
         ctx->hw_probing = true;
+    } else if (lavc_param->threads < 0 && ctx->tune_threads) {
+        avctx->thread_count = ctx->tune_threads;
+        avctx->thread_type = ctx->tune_type;
     } else {
-        mp_set_avcodec_threads(vd->log, avctx, lavc_param->threads);
+        mp_set_avcodec_threads(vd->log, avctx, MPMAX(lavc_param->threads, 0));
     }
+    ctx->tune_frames = 0;
+    ctx->tune_time = ctx->tune_duration = 0;
 
     if (!ctx->use_hwdec && vd->vo && lavc_param->dr) {
         avctx->opaque = vd;
@@ -711,6 +857,8 @@ static void flush_all(struct dec_video *vd)
         talloc_free(ctx->requeue_packets[n]);
     ctx->num_requeue_packets = 0;
 
+    ctx->retune_draining = false;
+
     reset_avctx(vd);
 }
 
@@ -949,6 +1097,8 @@ static bool prepare_decoding(struct dec_video *vd)
         // Can be much more aggressive for true intra codecs.
         if (ctx->intra_only)
             avctx->skip_frame = AVDISCARD_ALL;
+    } else if (drop == 3) {
+        avctx->skip_frame = AVDISCARD_NONKEY;   // keyframe scrubbing
     } else {
         avctx->skip_frame = ctx->skip_frame;    // normal playback
     }
@@ -987,7 +1137,11 @@ static bool do_send_packet(struct dec_video *vd, struct demux_packet *pkt)
     AVPacket avpkt;
     mp_set_av_packet(&avpkt, pkt, &ctx->codec_timebase);
 
+    double t = mp_time_sec();
+    stats_time_start(ctx->stats, "send-packet");
     int ret = avcodec_send_packet(avctx, pkt ? &avpkt : NULL);
+    stats_time_end(ctx->stats, "send-packet");
+    ctx->decode_time += mp_time_sec() - t;
     if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
         return false;
 
@@ -1013,6 +1167,16 @@ static bool send_packet(struct dec_video *vd, struct demux_packet *pkt)
         return false;
     }
 
+    if (ctx->retune_draining)
+        return false;
+
+    if (ctx->retune_pending && pkt && pkt->keyframe) {
+        // Drain the decoder, so it can be reopened without losing frames.
+        if (do_send_packet(vd, NULL))
+            ctx->retune_draining = true;
+        return false;
+    }
+
     return do_send_packet(vd, pkt);
 }
 
@@ -1025,8 +1189,24 @@ static bool decode_frame(struct dec_video *vd)
     if (!prepare_decoding(vd))
         return true;
 
+    double t = mp_time_sec();
+    stats_time_start(ctx->stats, "decode");
     int ret = avcodec_receive_frame(avctx, ctx->pic);
-    if (ret == AVERROR_EOF) {
+    stats_time_end(ctx->stats, "decode");
+    ctx->decode_time += mp_time_sec() - t;
+    if (ret == AVERROR_EOF && ctx->retune_draining) {
+        // All frames were returned; reopen with the new threading setup. The
+        // keyframe that triggered this is sent again by send_packet().
+        ctx->retune_draining = false;
+        ctx->retune_pending = false;
+        uninit_avctx(vd);
+        init_avctx(vd);
+        if (!ctx->avctx) {
+            ctx->tune_threads = 0;
+            init_avctx(vd);
+        }
+        return true;
+    } else if (ret == AVERROR_EOF) {
         // If flushing was initialized earlier and has ended now, make it start
         // over in case we get new packets at some point in the future.
         reset_avctx(vd);
@@ -1103,6 +1283,9 @@ static bool receive_frame(struct dec_video *vd, struct mp_image **out_image)
     if (!res)
         return progress;
 
+    update_tuning(vd, res, ctx->decode_time);
+    ctx->decode_time = 0;
+
     if (ctx->use_hwdec && ctx->hwdec.copying && res->hwctx) {
         struct mp_image *sw = mp_image_hw_download(res, ctx->hwdec_swpool);
         mp_image_unrefp(&res);
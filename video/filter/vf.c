@@ -29,6 +29,7 @@
 #include "common/common.h"
 #include "common/global.h"
 #include "common/msg.h"
+#include "common/stats.h"
 #include "options/m_option.h"
 #include "options/m_config.h"
 
@@ -401,7 +402,10 @@ int vf_filter_frame(struct vf_chain *c, struct mp_image *img)
         return -1;
     }
     assert(mp_image_params_equal(&img->params, &c->input_params));
-    return vf_do_filter(c->first, img);
+    stats_time_start(c->stats, "filter");
+    int r = vf_do_filter(c->first, img);
+    stats_time_end(c->stats, "filter");
+    return r;
 }
 
 // Similar to vf_output_frame(), but only ensure that the filter "until" has
@@ -445,7 +449,10 @@ static int vf_output_frame_until(struct vf_chain *c, struct vf_instance *until,
 //  returns: -1: error, 0: no output, 1: output available
 int vf_output_frame(struct vf_chain *c, bool eof)
 {
-    return vf_output_frame_until(c, c->last, eof);
+    stats_time_start(c->stats, "output");
+    int r = vf_output_frame_until(c, c->last, eof);
+    stats_time_end(c->stats, "output");
+    return r;
 }
 
 struct mp_image *vf_read_output_frame(struct vf_chain *c)
@@ -761,6 +768,7 @@ struct vf_chain *vf_new(struct mpv_global *global)
         .log = mp_log_new(c, global->log, "!vf"),
         .global = global,
     };
+    c->stats = stats_ctx_create(c, global, "vf");
     static const struct vf_info in = { .name = "in" };
     c->first = talloc(c, struct vf_instance);
     *c->first = (struct vf_instance) {
@@ -125,6 +125,7 @@ struct vf_chain {
     struct mp_log *log;
     struct MPOpts *opts;
     struct mpv_global *global;
+    struct stats_ctx *stats;
     struct mp_hwdec_devices *hwdec_devs;
 
     // This is a dirty hack.
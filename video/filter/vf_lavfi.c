@@ -24,6 +24,7 @@
 #include <inttypes.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include <libavutil/avstring.h>
 #include <libavutil/hwcontext.h>
@@ -43,6 +44,7 @@
 #include "common/msg.h"
 #include "options/m_option.h"
 #include "common/tags.h"
+#include "osdep/threads.h"
 
 #include "video/hwdec.h"
 #include "video/img_format.h"
@@ -70,6 +72,14 @@ struct vf_priv_s {
     AVFilterContext *in;
     AVFilterContext *out;
     bool eof;
+    // Set once data was sent to the graph. libavfilter can't flush a graph,
+    // so on seek resets, it has to be recreated if this is set.
+    bool graph_used;
+
+    // Input parameters of the last successfully created graph. Kept after
+    // destroy_graph(), so that it can be recreated when needed.
+    struct mp_image_params graph_params;
+    AVBufferRef *graph_hwframes;
 
     AVRational timebase_in;
     AVRational timebase_out;
@@ -77,6 +87,27 @@ struct vf_priv_s {
 
     struct mp_tags *metadata;
 
+    // With buffered-frames > 0, the graph is run on a separate thread. While
+    // the thread is busy, only it can access the graph (and the fields above).
+    // Other code can access it only while hold > 0 and busy is false.
+    pthread_t thread;
+    bool thread_valid;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+
+    // --- the following members are protected by lock
+    struct mp_image **in_queue; // oldest first
+    int num_in_queue;
+    bool in_eof;                // EOF not yet sent to the graph
+    bool eof_queued;            // EOF was queued (until reset)
+    bool graph_eof;             // copy of eof, updated by the thread
+    struct mp_image **out_queue;
+    int num_out_queue;
+    bool busy;
+    bool failed;
+    bool terminate;
+    int hold;
+
     // for the lw wrapper
     void *old_priv;
     int (*lw_reconfig_cb)(struct vf_instance *vf,
@@ -87,6 +118,7 @@ struct vf_priv_s {
     char *cfg_graph;
     int64_t cfg_sws_flags;
     char **cfg_avopts;
+    int cfg_buffered;
 
     char *cfg_filter_name;
     char **cfg_filter_opts;
@@ -104,9 +136,52 @@ static void destroy_graph(struct vf_instance *vf)
     }
 
     p->eof = false;
+    p->graph_used = false;
+}
+
+// Wait until the filter thread is idle, and keep it from accessing the graph
+// until release_graph() is called.
+static void hold_graph(struct vf_instance *vf)
+{
+    struct vf_priv_s *p = vf->priv;
+    if (!p->thread_valid)
+        return;
+    pthread_mutex_lock(&p->lock);
+    p->hold++;
+    while (p->busy)
+        pthread_cond_wait(&p->wakeup, &p->lock);
+    pthread_mutex_unlock(&p->lock);
 }
 
-static bool recreate_graph(struct vf_instance *vf, struct mp_image_params *fmt)
+static void release_graph(struct vf_instance *vf)
+{
+    struct vf_priv_s *p = vf->priv;
+    if (!p->thread_valid)
+        return;
+    pthread_mutex_lock(&p->lock);
+    p->hold--;
+    pthread_cond_broadcast(&p->wakeup);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Drop all frames queued for or by the filter thread.
+static void flush_queues(struct vf_instance *vf)
+{
+    struct vf_priv_s *p = vf->priv;
+    pthread_mutex_lock(&p->lock);
+    for (int n = 0; n < p->num_in_queue; n++)
+        talloc_free(p->in_queue[n]);
+    p->num_in_queue = 0;
+    for (int n = 0; n < p->num_out_queue; n++)
+        talloc_free(p->out_queue[n]);
+    p->num_out_queue = 0;
+    p->in_eof = p->eof_queued = p->graph_eof = false;
+    p->failed = false;
+    pthread_mutex_unlock(&p->lock);
+}
+
+static bool recreate_graph(struct vf_instance *vf, struct mp_image_params *fmt,
+                           AVBufferRef *hwframes)
 {
     void *tmp = talloc_new(NULL);
     struct vf_priv_s *p = vf->priv;
@@ -119,6 +194,10 @@ static bool recreate_graph(struct vf_instance *vf, struct mp_image_params *fmt)
     }
 
     destroy_graph(vf);
+    struct mp_image_params params = *fmt;
+    p->graph_params = (struct mp_image_params){0};
+    AVBufferRef *hwframes_ref = hwframes ? av_buffer_ref(hwframes) : NULL;
+    av_buffer_unref(&p->graph_hwframes);
 
     AVFilterGraph *graph = avfilter_graph_alloc();
     if (!graph)
@@ -150,7 +229,7 @@ static bool recreate_graph(struct vf_instance *vf, struct mp_image_params *fmt)
     in_params->sample_aspect_ratio.num = fmt->p_w;
     in_params->sample_aspect_ratio.den = fmt->p_h;
     // Assume it's ignored for non-hwaccel formats.
-    in_params->hw_frames_ctx = vf->in_hwframes_ref;
+    in_params->hw_frames_ctx = hwframes_ref;
 
     ret = av_buffersrc_parameters_set(in, in_params);
     av_free(in_params);
@@ -220,6 +299,8 @@ static bool recreate_graph(struct vf_instance *vf, struct mp_image_params *fmt)
     p->in = in;
     p->out = out;
     p->graph = graph;
+    p->graph_params = params;
+    p->graph_hwframes = hwframes_ref;
 
     assert(out->nb_inputs == 1);
     assert(in->nb_outputs == 1);
@@ -230,16 +311,54 @@ static bool recreate_graph(struct vf_instance *vf, struct mp_image_params *fmt)
 error:
     MP_FATAL(vf, "Can't configure libavfilter graph.\n");
     avfilter_graph_free(&graph);
+    av_buffer_unref(&hwframes_ref);
     talloc_free(tmp);
     return false;
 }
 
+// Create the graph again if reset() destroyed it.
+static bool restore_graph(struct vf_instance *vf)
+{
+    struct vf_priv_s *p = vf->priv;
+    if (p->graph)
+        return true;
+    if (!p->graph_params.imgfmt)
+        return false;
+    struct mp_image_params params = p->graph_params;
+    AVBufferRef *hwframes =
+        p->graph_hwframes ? av_buffer_ref(p->graph_hwframes) : NULL;
+    bool ok = recreate_graph(vf, &params, hwframes);
+    av_buffer_unref(&hwframes);
+    return ok;
+}
+
+// A graph that has received data is destroyed, and only created again when
+// it's actually needed. This avoids creating it twice on a format change,
+// where reconfig() follows directly.
 static void reset(vf_instance_t *vf)
 {
     struct vf_priv_s *p = vf->priv;
-    struct mp_image_params *f = &vf->fmt_in;
-    if (p->graph && f->imgfmt)
-        recreate_graph(vf, f);
+    hold_graph(vf);
+    if (p->thread_valid)
+        flush_queues(vf);
+    if (p->graph && p->graph_used)
+        destroy_graph(vf);
+    release_graph(vf);
+}
+
+// Whether the graph can be used for new input parameters as it is. The buffer
+// source only uses some of the parameters; changes of others (like colorspace
+// tags) don't require a new graph.
+static bool graph_is_reusable(struct vf_instance *vf, struct mp_image_params *in)
+{
+    struct vf_priv_s *p = vf->priv;
+    struct mp_image_params *g = &p->graph_params;
+    AVBufferRef *hw = vf->in_hwframes_ref;
+    return p->graph && !p->graph_used && !p->lw_reconfig_cb &&
+           g->imgfmt == in->imgfmt && g->w == in->w && g->h == in->h &&
+           g->p_w == in->p_w && g->p_h == in->p_h &&
+           (hw ? hw->data : NULL) ==
+                (p->graph_hwframes ? p->graph_hwframes->data : NULL);
 }
 
 static int reconfig(struct vf_instance *vf, struct mp_image_params *in,
@@ -254,7 +373,18 @@ static int reconfig(struct vf_instance *vf, struct mp_image_params *in,
             return -1;
     }
 
-    if (!recreate_graph(vf, in))
+    hold_graph(vf);
+    bool ok = true;
+    if (graph_is_reusable(vf, in)) {
+        MP_VERBOSE(vf, "lavfi: reusing graph\n");
+        p->graph_params = *in;
+    } else {
+        if (p->thread_valid)
+            flush_queues(vf);
+        ok = recreate_graph(vf, in, vf->in_hwframes_ref);
+    }
+    release_graph(vf);
+    if (!ok)
         return -1;
 
     AVFilterLink *l_out = p->out->inputs[0];
@@ -329,7 +459,8 @@ static void get_metadata_from_av_frame(struct vf_instance *vf, AVFrame *frame)
 #endif
 }
 
-static int filter_ext(struct vf_instance *vf, struct mp_image *mpi)
+// Send a frame (or EOF if mpi==NULL) to the graph.
+static int send_input(struct vf_instance *vf, struct mp_image *mpi)
 {
     struct vf_priv_s *p = vf->priv;
 
@@ -340,7 +471,7 @@ static int filter_ext(struct vf_instance *vf, struct mp_image *mpi)
         reset(vf);
     }
 
-    if (!p->graph)
+    if (!restore_graph(vf))
         return -1;
 
     if (!mpi) {
@@ -349,6 +480,7 @@ static int filter_ext(struct vf_instance *vf, struct mp_image *mpi)
         p->eof = true;
     }
 
+    p->graph_used = true;
     AVFrame *frame = mp_to_av(vf, mpi);
     int r = av_buffersrc_add_frame(p->in, frame) < 0 ? -1 : 0;
     av_frame_free(&frame);
@@ -356,10 +488,15 @@ static int filter_ext(struct vf_instance *vf, struct mp_image *mpi)
     return r;
 }
 
-static int filter_out(struct vf_instance *vf)
+// Read a frame from the graph. Returns 1 if *out was set, 0 if no frame is
+// available, and -1 on errors.
+static int read_output(struct vf_instance *vf, struct mp_image **out)
 {
     struct vf_priv_s *p = vf->priv;
 
+    if (!p->graph)
+        return 0; // destroyed by reset(), no input sent yet
+
     AVFrame *frame = av_frame_alloc();
     int err = av_buffersink_get_frame(p->out, frame);
     if (err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
@@ -377,8 +514,183 @@ static int filter_out(struct vf_instance *vf)
     }
 
     get_metadata_from_av_frame(vf, frame);
-    vf_add_output_frame(vf, av_to_mp(vf, frame));
-    return 0;
+    *out = av_to_mp(vf, frame);
+    return *out ? 1 : 0;
+}
+
+static void *filter_thread(void *ptr)
+{
+    struct vf_instance *vf = ptr;
+    struct vf_priv_s *p = vf->priv;
+
+    mpthread_set_name("lavfi");
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->terminate) {
+        if (p->hold || p->failed || p->num_out_queue >= p->cfg_buffered ||
+            !(p->num_in_queue || p->in_eof))
+        {
+            pthread_cond_wait(&p->wakeup, &p->lock);
+            continue;
+        }
+
+        struct mp_image *mpi = NULL;
+        if (p->num_in_queue) {
+            mpi = p->in_queue[0];
+            MP_TARRAY_REMOVE_AT(p->in_queue, p->num_in_queue, 0);
+        } else {
+            p->in_eof = false;
+        }
+        p->busy = true;
+        pthread_cond_broadcast(&p->wakeup);
+        pthread_mutex_unlock(&p->lock);
+
+        int r = send_input(vf, mpi);
+        struct mp_image **out = NULL;
+        int num_out = 0;
+        while (r >= 0) {
+            struct mp_image *img = NULL;
+            r = read_output(vf, &img);
+            if (r < 1)
+                break;
+            MP_TARRAY_APPEND(NULL, out, num_out, img);
+        }
+
+        pthread_mutex_lock(&p->lock);
+        for (int n = 0; n < num_out; n++)
+            MP_TARRAY_APPEND(p, p->out_queue, p->num_out_queue, out[n]);
+        talloc_free(out);
+        p->failed |= r < 0;
+        p->graph_eof = p->eof;
+        p->busy = false;
+        pthread_cond_broadcast(&p->wakeup);
+        pthread_mutex_unlock(&p->lock);
+
+        if (vf->chain->wakeup_callback)
+            vf->chain->wakeup_callback(vf->chain->wakeup_callback_ctx);
+
+        pthread_mutex_lock(&p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static bool locked_is_idle(struct vf_priv_s *p)
+{
+    return !p->busy && !p->num_in_queue && !p->in_eof;
+}
+
+static void locked_read_queue(struct vf_instance *vf, int max)
+{
+    struct vf_priv_s *p = vf->priv;
+    int num = MPMIN(max, p->num_out_queue);
+    for (int n = 0; n < num; n++)
+        vf_add_output_frame(vf, p->out_queue[n]);
+    for (int n = num; n < p->num_out_queue; n++)
+        p->out_queue[n - num] = p->out_queue[n];
+    p->num_out_queue -= num;
+    if (num)
+        pthread_cond_broadcast(&p->wakeup);
+}
+
+static int filter_ext_threaded(struct vf_instance *vf, struct mp_image *mpi)
+{
+    struct vf_priv_s *p = vf->priv;
+    int ret = 0;
+
+    pthread_mutex_lock(&p->lock);
+
+    if (mpi && (p->eof_queued || p->graph_eof)) {
+        // See send_input(). Let the thread finish the old data first.
+        while (!locked_is_idle(p) && !p->failed) {
+            locked_read_queue(vf, INT_MAX);
+            pthread_cond_wait(&p->wakeup, &p->lock);
+        }
+        locked_read_queue(vf, INT_MAX);
+        pthread_mutex_unlock(&p->lock);
+        reset(vf);
+        pthread_mutex_lock(&p->lock);
+    }
+
+    if (mpi) {
+        // Keep returning output while waiting, so the thread can't get stuck
+        // on a full output queue.
+        while (p->num_in_queue >= p->cfg_buffered && !p->failed) {
+            locked_read_queue(vf, INT_MAX);
+            pthread_cond_wait(&p->wakeup, &p->lock);
+        }
+        if (p->failed) {
+            talloc_free(mpi);
+        } else {
+            MP_TARRAY_APPEND(p, p->in_queue, p->num_in_queue, mpi);
+        }
+    } else if (!p->eof_queued) {
+        p->in_eof = p->eof_queued = true;
+    }
+    if (p->failed)
+        ret = -1;
+
+    pthread_cond_broadcast(&p->wakeup);
+    pthread_mutex_unlock(&p->lock);
+    return ret;
+}
+
+// Return 1 output frame, or none if the filter probably needs new input.
+static int filter_out_threaded(struct vf_instance *vf)
+{
+    struct vf_priv_s *p = vf->priv;
+    int ret = 0;
+
+    pthread_mutex_lock(&p->lock);
+    while (1) {
+        if (p->num_out_queue) {
+            locked_read_queue(vf, 1);
+            break;
+        }
+        if (p->failed) {
+            ret = -1;
+            break;
+        }
+        if (locked_is_idle(p))
+            break;
+        // Let the caller send more input while the thread is busy, unless
+        // we're draining.
+        if (!p->eof_queued && p->num_in_queue < p->cfg_buffered)
+            break;
+        pthread_cond_wait(&p->wakeup, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return ret;
+}
+
+static bool needs_input(struct vf_instance *vf)
+{
+    struct vf_priv_s *p = vf->priv;
+    pthread_mutex_lock(&p->lock);
+    bool r = !p->eof_queued && !p->failed &&
+             p->num_in_queue < p->cfg_buffered &&
+             vf->num_out_queued + p->num_out_queue < p->cfg_buffered;
+    pthread_mutex_unlock(&p->lock);
+    return r;
+}
+
+static int filter_ext(struct vf_instance *vf, struct mp_image *mpi)
+{
+    struct vf_priv_s *p = vf->priv;
+    if (p->thread_valid)
+        return filter_ext_threaded(vf, mpi);
+    return send_input(vf, mpi);
+}
+
+static int filter_out(struct vf_instance *vf)
+{
+    struct vf_priv_s *p = vf->priv;
+    if (p->thread_valid)
+        return filter_out_threaded(vf);
+    struct mp_image *img = NULL;
+    int r = read_output(vf, &img);
+    vf_add_output_frame(vf, img);
+    return r < 0 ? -1 : 0;
 }
 
 static int control(vf_instance_t *vf, int request, void *data)
@@ -388,29 +700,48 @@ static int control(vf_instance_t *vf, int request, void *data)
         reset(vf);
         return CONTROL_OK;
     case VFCTRL_COMMAND: {
-        if (!vf->priv->graph)
-            break;
         char **args = data;
-        return avfilter_graph_send_command(vf->priv->graph, "all",
-                                           args[0], args[1], &(char){0}, 0, 0)
-                >= 0 ? CONTROL_OK : CONTROL_ERROR;
+        hold_graph(vf);
+        int r = -1;
+        if (restore_graph(vf)) {
+            r = avfilter_graph_send_command(vf->priv->graph, "all",
+                                            args[0], args[1], &(char){0}, 0, 0);
+        }
+        release_graph(vf);
+        return r >= 0 ? CONTROL_OK : CONTROL_ERROR;
     }
-    case VFCTRL_GET_METADATA:
+    case VFCTRL_GET_METADATA: {
+        int r = CONTROL_NA;
+        hold_graph(vf);
         if (vf->priv && vf->priv->metadata) {
             *(struct mp_tags *)data = *vf->priv->metadata;
-            return CONTROL_OK;
-        } else {
-            return CONTROL_NA;
+            r = CONTROL_OK;
         }
+        release_graph(vf);
+        return r;
+    }
     }
     return CONTROL_UNKNOWN;
 }
 
 static void uninit(struct vf_instance *vf)
 {
-    if (!vf->priv)
+    struct vf_priv_s *p = vf->priv;
+    if (!p)
         return;
+    if (p->thread_valid) {
+        pthread_mutex_lock(&p->lock);
+        p->terminate = true;
+        pthread_cond_broadcast(&p->wakeup);
+        pthread_mutex_unlock(&p->lock);
+        pthread_join(p->thread, NULL);
+        p->thread_valid = false;
+        flush_queues(vf);
+    }
+    pthread_cond_destroy(&p->wakeup);
+    pthread_mutex_destroy(&p->lock);
     destroy_graph(vf);
+    av_buffer_unref(&p->graph_hwframes);
 }
 
 static int vf_open(vf_instance_t *vf)
@@ -425,6 +756,9 @@ static int vf_open(vf_instance_t *vf)
     vf->control = control;
     vf->uninit = uninit;
 
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wakeup, NULL);
+
     if (p->is_bridge) {
         if (!p->cfg_filter_name) {
             MP_ERR(vf, "Filter name not set!\n");
@@ -436,6 +770,13 @@ static int vf_open(vf_instance_t *vf)
         }
     }
 
+    if (p->cfg_buffered > 0) {
+        vf->needs_input = needs_input;
+        if (pthread_create(&p->thread, NULL, filter_thread, vf))
+            return 0;
+        p->thread_valid = true;
+    }
+
     return 1;
 }
 
@@ -482,6 +823,7 @@ static const m_option_t vf_opts_fields[] = {
     OPT_STRING("graph", cfg_graph, M_OPT_MIN, .min = 1),
     OPT_INT64("sws-flags", cfg_sws_flags, 0),
     OPT_KEYVALUELIST("o", cfg_avopts, 0),
+    OPT_INTRANGE("buffered-frames", cfg_buffered, 0, 0, 100),
     {0}
 };
 
@@ -507,6 +849,7 @@ const vf_info_t vf_info_lavfi_bridge = {
         OPT_KEYVALUELIST("opts", cfg_filter_opts, 0),
         OPT_INT64("sws-flags", cfg_sws_flags, 0),
         OPT_KEYVALUELIST("o", cfg_avopts, 0),
+        OPT_INTRANGE("buffered-frames", cfg_buffered, 0, 0, 100),
         {0}
     },
     .priv_defaults = &(const struct vf_priv_s){
@@ -21,6 +21,7 @@
 #include <inttypes.h>
 #include <pthread.h>
 #include <limits.h>
+#include <math.h>
 #include <assert.h>
 
 #include <VapourSynth.h>
@@ -32,8 +33,10 @@
 #include "config.h"
 
 #include "common/msg.h"
+#include "common/tags.h"
 #include "options/m_option.h"
 #include "options/path.h"
+#include "osdep/timer.h"
 
 #include "video/img_format.h"
 #include "video/mp_image.h"
@@ -71,6 +74,10 @@ struct vf_priv_s {
     struct mp_image **requested;// frame callback results (can point to dummy_img)
                                 // requested[0] is the frame to return first
     int max_requests;           // upper bound for requested[] array
+    double *request_time;       // mp_time_sec() when requested[n] was requested
+    int window;                 // number of requests to keep in flight
+    double avg_latency;         // average time per request (0 if unknown)
+    double avg_duration;        // average output frame duration (0 if unknown)
     bool failed;                // frame callback returned with an error
     bool shutdown;              // ask node to return
     bool eof;                   // drain remaining data
@@ -78,12 +85,16 @@ struct vf_priv_s {
     bool initializing;          // filters are being built
     bool in_node_active;        // node might still be called
 
+    struct mp_tags *metadata;   // for VFCTRL_GET_METADATA
+
     // --- options
     char *cfg_file;
     int cfg_maxbuffer;
     int cfg_maxrequests;
 };
 
+#define REQUESTS_ADAPTIVE -2
+
 // priv->requested[n] points to this if a request for frame n is in-progress
 static const struct mp_image dummy_img;
 
@@ -263,6 +274,10 @@ static void VS_CC vs_frame_done(void *userData, const VSFrameRef *f, int n,
     MP_TRACE(vf, "filtered frame %d (%d)\n", n, index);
     assert(p->requested[index] == &dummy_img);
 
+    double latency = mp_time_sec() - p->request_time[index];
+    p->avg_latency = p->avg_latency ? p->avg_latency * 0.9 + latency * 0.1
+                                    : latency;
+
     struct mp_image *res = NULL;
     if (f) {
         struct mp_image img = map_vs_frame(p, f, false);
@@ -295,6 +310,28 @@ static bool locked_need_input(struct vf_instance *vf)
     return p->num_buffered < MP_TALLOC_AVAIL(p->buffered);
 }
 
+// With concurrent-frames=adaptive, size the request window so that there are
+// enough requests in flight to filter in realtime (time per request divided by
+// frame duration), but not more, as each request costs memory.
+static void locked_update_window(struct vf_instance *vf)
+{
+    struct vf_priv_s *p = vf->priv;
+
+    if (p->cfg_maxrequests != REQUESTS_ADAPTIVE ||
+        !p->avg_latency || !p->avg_duration)
+        return;
+
+    int target = ceil(p->avg_latency / p->avg_duration * 1.2);
+    target = MPCLAMP(target, 1, p->max_requests);
+    // Change slowly to avoid oscillating.
+    int window = p->window + (target > p->window) - (target < p->window);
+    if (window != p->window) {
+        MP_DBG(vf, "using %d concurrent requests (%.1f ms per frame).\n",
+               window, p->avg_latency * 1e3);
+    }
+    p->window = window;
+}
+
 // Return true if progress was made.
 static bool locked_read_output(struct vf_instance *vf)
 {
@@ -308,12 +345,19 @@ static bool locked_read_output(struct vf_instance *vf)
             double duration = out->pts;
             out->pts = p->out_pts;
             p->out_pts += duration;
+            if (duration > 0) {
+                p->avg_duration = p->avg_duration
+                    ? p->avg_duration * 0.9 + duration * 0.1 : duration;
+            }
         }
         vf_add_output_frame(vf, out);
-        for (int n = 0; n < p->max_requests - 1; n++)
+        for (int n = 0; n < p->max_requests - 1; n++) {
             p->requested[n] = p->requested[n + 1];
+            p->request_time[n] = p->request_time[n + 1];
+        }
         p->requested[p->max_requests - 1] = NULL;
         p->out_frameno++;
+        locked_update_window(vf);
         r = true;
     }
 
@@ -322,11 +366,12 @@ static bool locked_read_output(struct vf_instance *vf)
         return r;
 
     // Request new future frames as far as possible.
-    for (int n = 0; n < p->max_requests; n++) {
+    for (int n = 0; n < p->window; n++) {
         if (!p->requested[n]) {
             // Note: this assumes getFrameAsync() will never call
             //       infiltGetFrame (if it does, we would deadlock)
             p->requested[n] = (struct mp_image *)&dummy_img;
+            p->request_time[n] = mp_time_sec();
             p->failed = false;
             MP_TRACE(vf, "requesting frame %d (%d)\n", p->out_frameno + n, n);
             p->vsapi->getFrameAsync(p->out_frameno + n, p->out_node,
@@ -421,7 +466,7 @@ static bool needs_input(struct vf_instance *vf)
     bool r = false;
     pthread_mutex_lock(&p->lock);
     locked_read_output(vf);
-    r = vf->num_out_queued < p->max_requests && locked_need_input(vf);
+    r = vf->num_out_queued < p->window && locked_need_input(vf);
     pthread_mutex_unlock(&p->lock);
     return r;
 }
@@ -718,6 +763,22 @@ static int control(vf_instance_t *vf, int request, void *data)
         if (p->out_node && reinit_vs(vf) < 0)
             return CONTROL_ERROR;
         return CONTROL_OK;
+    case VFCTRL_GET_METADATA: {
+        pthread_mutex_lock(&p->lock);
+        mp_tags_clear(p->metadata);
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%d", p->window);
+        mp_tags_set_str(p->metadata, "concurrent-frames", buf);
+        snprintf(buf, sizeof(buf), "%f", p->avg_latency * 1e3);
+        mp_tags_set_str(p->metadata, "frame-time-ms", buf);
+        if (p->avg_latency > 0) {
+            snprintf(buf, sizeof(buf), "%f", p->window / p->avg_latency);
+            mp_tags_set_str(p->metadata, "max-fps", buf);
+        }
+        pthread_mutex_unlock(&p->lock);
+        *(struct mp_tags *)data = *p->metadata;
+        return CONTROL_OK;
+    }
     }
     return CONTROL_UNKNOWN;
 }
@@ -756,10 +817,15 @@ static int vf_open(vf_instance_t *vf)
     p->max_requests = p->cfg_maxrequests;
     if (p->max_requests < 0)
         p->max_requests = av_cpu_count();
-    MP_VERBOSE(vf, "using %d concurrent requests.\n", p->max_requests);
+    MP_VERBOSE(vf, "using %s%d concurrent requests.\n",
+               p->cfg_maxrequests == REQUESTS_ADAPTIVE ? "up to " : "",
+               p->max_requests);
+    p->window = p->max_requests;
     int maxbuffer = p->cfg_maxbuffer * p->max_requests;
     p->buffered = talloc_array(vf, struct mp_image *, maxbuffer);
     p->requested = talloc_zero_array(vf, struct mp_image *, p->max_requests);
+    p->request_time = talloc_zero_array(vf, double, p->max_requests);
+    p->metadata = talloc_zero(vf, struct mp_tags);
     return 1;
 }
 
@@ -768,7 +834,8 @@ static const m_option_t vf_opts_fields[] = {
     OPT_STRING("file", cfg_file, M_OPT_FILE),
     OPT_INTRANGE("buffered-frames", cfg_maxbuffer, 0, 1, 9999, OPTDEF_INT(4)),
     OPT_CHOICE_OR_INT("concurrent-frames", cfg_maxrequests, 0, 1, 99,
-                      ({"auto", -1}), OPTDEF_INT(-1)),
+                      ({"auto", -1}, {"adaptive", REQUESTS_ADAPTIVE}),
+                      OPTDEF_INT(-1)),
     {0}
 };
 
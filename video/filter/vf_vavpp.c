@@ -339,7 +339,6 @@ static int reconfig(struct vf_instance *vf, struct mp_image_params *in,
     struct vf_priv_s *p = vf->priv;
 
     flush_frames(vf);
-    av_buffer_unref(&p->hw_pool);
 
     p->params = *in;
     *out = *in;
@@ -359,6 +358,16 @@ static int reconfig(struct vf_instance *vf, struct mp_image_params *in,
         out->hw_subfmt = IMGFMT_NV12;
     }
 
+    // Reconfiguring the filter chain doesn't necessarily change the video
+    // parameters, so try to keep the already allocated output surfaces.
+    if (p->hw_pool) {
+        AVHWFramesContext *hw_frames = (void *)p->hw_pool->data;
+        if (hw_frames->sw_format == imgfmt2pixfmt(out->hw_subfmt) &&
+            hw_frames->width == src_w && hw_frames->height == src_h)
+            return 0;
+    }
+    av_buffer_unref(&p->hw_pool);
+
     p->hw_pool = av_hwframe_ctx_alloc(p->av_device_ref);
     if (!p->hw_pool)
         return -1;
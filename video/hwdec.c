@@ -13,7 +13,7 @@ struct mp_hwdec_devices {
     struct mp_hwdec_ctx **hwctxs;
     int num_hwctxs;
 
-    void (*load_api)(void *ctx);
+    void (*load_api)(void *ctx, int imgfmt);
     void *load_api_ctx;
 };
 
@@ -82,7 +82,7 @@ void hwdec_devices_remove(struct mp_hwdec_devices *devs, struct mp_hwdec_ctx *ct
 }
 
 void hwdec_devices_set_loader(struct mp_hwdec_devices *devs,
-    void (*load_api)(void *ctx), void *load_api_ctx)
+    void (*load_api)(void *ctx, int imgfmt), void *load_api_ctx)
 {
     devs->load_api = load_api;
     devs->load_api_ctx = load_api_ctx;
@@ -91,7 +91,13 @@ void hwdec_devices_set_loader(struct mp_hwdec_devices *devs,
 void hwdec_devices_request_all(struct mp_hwdec_devices *devs)
 {
     if (devs->load_api && !hwdec_devices_get_first(devs))
-        devs->load_api(devs->load_api_ctx);
+        devs->load_api(devs->load_api_ctx, 0);
+}
+
+void hwdec_devices_request(struct mp_hwdec_devices *devs, int imgfmt)
+{
+    if (devs->load_api)
+        devs->load_api(devs->load_api_ctx, imgfmt);
 }
 
 char *hwdec_devices_get_names(struct mp_hwdec_devices *devs)
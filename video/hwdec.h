@@ -46,13 +46,19 @@ void hwdec_devices_remove(struct mp_hwdec_devices *devs, struct mp_hwdec_ctx *ct
 // Can be used to enable lazy loading of an API with hwdec_devices_request().
 // If used at all, this must be set/unset during initialization/uninitialization,
 // as concurrent use with hwdec_devices_request() is a race condition.
+// load_api is called with the imgfmt passed to hwdec_devices_request(), or 0
+// if all devices should be loaded.
 void hwdec_devices_set_loader(struct mp_hwdec_devices *devs,
-    void (*load_api)(void *ctx), void *load_api_ctx);
+    void (*load_api)(void *ctx, int imgfmt), void *load_api_ctx);
 
 // Cause VO to lazily load all devices, and will block until this is done (even
 // if not available).
 void hwdec_devices_request_all(struct mp_hwdec_devices *devs);
 
+// Like hwdec_devices_request_all(), but load only the devices needed for the
+// given hardware surface IMGFMT_. Other devices can still be loaded later.
+void hwdec_devices_request(struct mp_hwdec_devices *devs, int imgfmt);
+
 // Return "," concatenated list (for introspection/debugging). Use talloc_free().
 char *hwdec_devices_get_names(struct mp_hwdec_devices *devs);
 
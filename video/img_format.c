@@ -453,6 +453,81 @@ bool mp_get_regular_imgfmt(struct mp_regular_imgfmt *dst, int imgfmt)
     return true;
 }
 
+bool mp_get_packed_imgfmt(struct mp_packed_imgfmt *dst, int imgfmt)
+{
+    struct mp_packed_imgfmt res = {0};
+
+    const AVPixFmtDescriptor *pixdesc =
+        av_pix_fmt_desc_get(imgfmt2pixfmt(imgfmt));
+
+    // The bit positions are computed for little endian words.
+    bool is_le = *(char *)&(uint32_t){1};
+
+    if (!pixdesc || !is_le || (pixdesc->flags & AV_PIX_FMT_FLAG_BITSTREAM) ||
+        (pixdesc->flags & AV_PIX_FMT_FLAG_HWACCEL) ||
+        (pixdesc->flags & AV_PIX_FMT_FLAG_PAL) ||
+        (pixdesc->flags & AV_PIX_FMT_FLAG_PLANAR) ||
+        (pixdesc->flags & AV_PIX_FMT_FLAG_BE) ||
+        pixdesc->nb_components < 3 ||
+        pixdesc->nb_components > MP_NUM_COMPONENTS ||
+        pixdesc->log2_chroma_h != 0 ||
+        mp_imgfmt_get_component_type(imgfmt) != MP_COMPONENT_TYPE_UINT)
+        return false;
+
+#if LIBAVUTIL_VERSION_MICRO >= 100
+    if (pixdesc->flags & AV_PIX_FMT_FLAG_BAYER)
+        return false;
+#endif
+
+    const AVComponentDescriptor *comp0 = &pixdesc->comp[0];
+
+    if (pixdesc->log2_chroma_w == 0) {
+        res.layout = MP_PACKED_WORD;
+        res.word_size = comp0->step;
+        if (res.word_size != 1 && res.word_size != 2 && res.word_size != 4)
+            return false;
+        for (int n = 0; n < pixdesc->nb_components; n++) {
+            const AVComponentDescriptor *comp = &pixdesc->comp[n];
+            int pos = comp->offset * 8 + comp->shift;
+            if (comp->plane != 0 || comp->step != res.word_size ||
+                comp->depth < 1 || pos + comp->depth > res.word_size * 8)
+                return false;
+            res.depth[n] = comp->depth;
+            res.shift[n] = pos;
+        }
+    } else if (pixdesc->log2_chroma_w == 1 && pixdesc->nb_components == 3) {
+        res.layout = MP_PACKED_422;
+        res.word_size = comp0->step / 2;
+        if (res.word_size != 1 && res.word_size != 2)
+            return false;
+        int used = 0;
+        for (int n = 0; n < 3; n++) {
+            const AVComponentDescriptor *comp = &pixdesc->comp[n];
+            // Luma is repeated every 2 components, chroma every 4.
+            int step = (n ? 4 : 2) * res.word_size;
+            int pos = comp->offset / res.word_size;
+            if (comp->plane != 0 || comp->step != step ||
+                comp->offset % res.word_size || pos >= (n ? 4 : 2) ||
+                comp->depth < 1 || comp->depth + comp->shift > res.word_size * 8)
+                return false;
+            res.depth[n] = comp->depth;
+            res.shift[n] = comp->shift;
+            used |= (1 << pos) | (n ? 0 : 1 << (pos + 2));
+        }
+        res.pos_422[0] = comp0->offset / res.word_size;
+        res.pos_422[1] = pixdesc->comp[1].offset / res.word_size;
+        res.pos_422[2] = res.pos_422[0] + 2;
+        res.pos_422[3] = pixdesc->comp[2].offset / res.word_size;
+        if (used != 15)
+            return false;
+    } else {
+        return false;
+    }
+
+    *dst = res;
+    return true;
+}
+
 
 // Find a format that has the given flags set with the following configuration.
 int mp_imgfmt_find(int xs, int ys, int planes, int component_bits, int flags)
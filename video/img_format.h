@@ -140,6 +140,40 @@ struct mp_regular_imgfmt {
 
 bool mp_get_regular_imgfmt(struct mp_regular_imgfmt *dst, int imgfmt);
 
+enum mp_packed_layout {
+    MP_PACKED_NONE = 0,
+    // Each pixel is a little endian word, with the components as bit fields
+    // (e.g. RGB565, X2RGB10).
+    MP_PACKED_WORD,
+    // Packed 4:2:2, each pair of pixels is stored as 4 components of equal
+    // size (e.g. Y0 Cb Y1 Cr for YUYV), possibly with padding bits (Y210).
+    MP_PACKED_422,
+};
+
+// This describes single plane formats with components that are not byte
+// aligned, or interleaved with subsampled chroma, which can't be described by
+// mp_regular_imgfmt. They can be read as integer textures and unpacked in a
+// shader.
+struct mp_packed_imgfmt {
+    enum mp_packed_layout layout;
+
+    // MP_PACKED_WORD: size of a pixel in bytes (1, 2 or 4).
+    // MP_PACKED_422: size of a component in bytes (1 or 2).
+    uint8_t word_size;
+
+    // Per component (0 is luminance/red, 1 is Cb/green, 2 is Cr/blue, 3 is
+    // alpha): number of bits, and position of the LSB within the word. Absent
+    // components have depth 0.
+    uint8_t depth[MP_NUM_COMPONENTS];
+    uint8_t shift[MP_NUM_COMPONENTS];
+
+    // MP_PACKED_422 only: index of Y0, Cb, Y1, Cr within the 4 components of
+    // a pixel pair.
+    uint8_t pos_422[4];
+};
+
+bool mp_get_packed_imgfmt(struct mp_packed_imgfmt *dst, int imgfmt);
+
 enum mp_imgfmt {
     IMGFMT_NONE = 0,
 
@@ -310,6 +310,17 @@ struct mp_image *mp_image_new_ref(struct mp_image *img)
     talloc_set_destructor(new, mp_image_destructor);
     *new = *img;
 
+    // If all planes are part of the same allocation (the AVBufferRefs point
+    // to the same AVBuffer), a single reference keeps them all alive. This
+    // saves an allocation per plane for each reference.
+    bool single = true;
+    for (int p = 1; p < MP_MAX_PLANES && new->bufs[p]; p++)
+        single &= new->bufs[p]->buffer == new->bufs[0]->buffer;
+    if (single) {
+        for (int p = 1; p < MP_MAX_PLANES; p++)
+            new->bufs[p] = NULL;
+    }
+
     bool fail = false;
     for (int p = 0; p < MP_MAX_PLANES; p++) {
         if (new->bufs[p]) {
@@ -29,6 +29,7 @@
 #include "mpv_talloc.h"
 
 #include "common/common.h"
+#include "common/stats.h"
 
 #include "fmt-conversion.h"
 #include "mp_image.h"
@@ -38,6 +39,10 @@ static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
 #define pool_lock() pthread_mutex_lock(&pool_mutex)
 #define pool_unlock() pthread_mutex_unlock(&pool_mutex)
 
+// Free unused images that were not handed out during the last POOL_TRIM_AGE
+// mp_image_pool_get() calls.
+#define POOL_TRIM_AGE 128
+
 // Thread-safety: the pool itself is not thread-safe, but pool-allocated images
 // can be referenced and unreferenced from other threads. (As long as the image
 // destructors are thread-safe.)
@@ -53,6 +58,7 @@ struct mp_image_pool {
 
     bool use_lru;
     unsigned int lru_counter;
+    unsigned int last_trim;
 };
 
 // Used to gracefully handle the case when the pool is freed while image
@@ -62,8 +68,16 @@ struct image_flags {
     bool referenced;            // outside mp_image reference exists
     bool pool_alive;            // the mp_image_pool references this
     unsigned int order;         // for LRU allocation (basically a timestamp)
+    size_t mem_size;            // accounted as MP_MEM_IMAGE_POOLS
 };
 
+// Freed together with the pool image.
+static void image_flags_destructor(void *ptr)
+{
+    struct image_flags *it = ptr;
+    mp_mem_account(MP_MEM_IMAGE_POOLS, -(int64_t)it->mem_size);
+}
+
 static void image_pool_destructor(void *ptr)
 {
     struct mp_image_pool *pool = ptr;
@@ -169,11 +183,45 @@ struct mp_image *mp_image_pool_get_no_alloc(struct mp_image_pool *pool, int fmt,
 void mp_image_pool_add(struct mp_image_pool *pool, struct mp_image *new)
 {
     struct image_flags *it = talloc_ptrtype(new, it);
-    *it = (struct image_flags) { .pool_alive = true };
+    *it = (struct image_flags) {
+        .pool_alive = true,
+        .mem_size = new->bufs[0] ? new->bufs[0]->size : 0,
+    };
+    talloc_set_destructor(it, image_flags_destructor);
+    mp_mem_account(MP_MEM_IMAGE_POOLS, it->mem_size);
     new->priv = it;
     MP_TARRAY_APPEND(pool, pool->images, pool->num_images, new);
 }
 
+// Drop images which apparently are not needed anymore, e.g. after the consumer
+// of the pool started to hold fewer images at once. (Without this, a pool
+// would keep the peak number of images forever.)
+static void pool_trim(struct mp_image_pool *pool)
+{
+    if (pool->lru_counter - pool->last_trim < POOL_TRIM_AGE)
+        return;
+    pool->last_trim = pool->lru_counter;
+
+    // LRU pools are used for hw surfaces, which are expensive to recreate.
+    if (pool->use_lru)
+        return;
+
+    for (int n = pool->num_images - 1; n >= 0; n--) {
+        struct mp_image *img = pool->images[n];
+        struct image_flags *it = img->priv;
+        pool_lock();
+        bool unused = !it->referenced &&
+                      pool->lru_counter - it->order > POOL_TRIM_AGE;
+        if (unused)
+            it->pool_alive = false;
+        pool_unlock();
+        if (unused) {
+            talloc_free(img);
+            MP_TARRAY_REMOVE_AT(pool->images, pool->num_images, n);
+        }
+    }
+}
+
 // Return a new image of given format/size. The only difference to
 // mp_image_alloc() is that there is a transparent mechanism to recycle image
 // data allocations through this pool.
@@ -202,6 +250,8 @@ struct mp_image *mp_image_pool_get(struct mp_image_pool *pool, int fmt,
         mp_image_pool_add(pool, new);
         new = mp_image_pool_get_no_alloc(pool, fmt, w, h);
     }
+    if (new)
+        pool_trim(pool);
     return new;
 }
 
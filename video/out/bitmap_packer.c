@@ -23,6 +23,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <limits.h>
+#include <string.h>
 
 #include <libavutil/common.h>
 
@@ -126,6 +127,88 @@ static int pack_rectangles(struct pos *in, struct pos *out, int num_rects,
     return num_rects ? -1 : y;
 }
 
+struct size_entry {
+    uint32_t size;
+    int index;
+};
+
+static int cmp_size_entry(const void *pa, const void *pb)
+{
+    const struct size_entry *a = pa, *b = pb;
+    if (a->size != b->size)
+        return a->size < b->size ? -1 : 1;
+    return a->index - b->index;
+}
+
+static void get_size_entries(struct size_entry *e, struct pos *in, int count)
+{
+    for (int i = 0; i < count; i++)
+        e[i] = (struct size_entry){((uint32_t)in[i].x << 16) | in[i].y, i};
+    qsort(e, count, sizeof(e[0]), cmp_size_entry);
+}
+
+// Try to place each rectangle at the position of a rectangle with the same
+// size from the previous call. Input sizes must include the padding. Returns
+// false (and leaves the result undefined) if not all rectangles can be placed.
+static bool reuse_placement(struct bitmap_packer *packer)
+{
+    if (!packer->prev_count || packer->count > packer->prev_count)
+        return false;
+
+    void *tmp = talloc_new(NULL);
+    struct size_entry *cur = talloc_array(tmp, struct size_entry, packer->count);
+    struct size_entry *prev = talloc_array(tmp, struct size_entry,
+                                           packer->prev_count);
+    get_size_entries(cur, packer->in, packer->count);
+    get_size_entries(prev, packer->prev_in, packer->prev_count);
+
+    // Both lists are sorted by size, so matching entries can be found with a
+    // single merge pass.
+    bool ok = true;
+    int p = 0;
+    for (int i = 0; i < packer->count; i++) {
+        while (p < packer->prev_count && prev[p].size < cur[i].size)
+            p++;
+        if (p == packer->prev_count || prev[p].size != cur[i].size) {
+            ok = false;
+            break;
+        }
+        packer->result[cur[i].index] = packer->prev_result[prev[p].index];
+        p++;
+    }
+
+    talloc_free(tmp);
+
+    if (!ok)
+        return false;
+
+    int used_width = 0, used_height = 0;
+    for (int i = 0; i < packer->count; i++) {
+        struct pos r = packer->result[i], in = packer->in[i];
+        if (in.x && in.y) {
+            used_width = FFMAX(used_width, r.x - packer->padding + in.x);
+            used_height = FFMAX(used_height, r.y - packer->padding + in.y);
+        }
+    }
+    packer->used_width = FFMIN(used_width, packer->w);
+    packer->used_height = FFMIN(used_height, packer->h);
+    return true;
+}
+
+static void save_placement(struct bitmap_packer *packer)
+{
+    if (packer->count > packer->prev_count) {
+        packer->prev_in = talloc_realloc(packer, packer->prev_in, struct pos,
+                                         packer->count);
+        packer->prev_result = talloc_realloc(packer, packer->prev_result,
+                                             struct pos, packer->count);
+    }
+    memcpy(packer->prev_in, packer->in, packer->count * sizeof(struct pos));
+    memcpy(packer->prev_result, packer->result,
+           packer->count * sizeof(struct pos));
+    packer->prev_count = packer->count;
+}
+
 int packer_pack(struct bitmap_packer *packer)
 {
     if (packer->count == 0)
@@ -147,6 +230,8 @@ int packer_pack(struct bitmap_packer *packer)
         xmax = FFMAX(xmax, in[i].x);
         ymax = FFMAX(ymax, in[i].y);
     }
+    if (xmax <= packer->w && ymax <= packer->h && reuse_placement(packer))
+        return 0;
     if (xmax > packer->w)
         packer->w = 1 << (av_log2(xmax - 1) + 1);
     if (ymax > packer->h)
@@ -167,6 +252,7 @@ int packer_pack(struct bitmap_packer *packer)
                     packer->result[i].y += packer->padding;
                 }
             }
+            save_placement(packer);
             return packer->w != w_orig || packer->h != h_orig;
         }
         int w_max = packer->w_max > 0 ? packer->w_max : INT_MAX;
@@ -21,6 +21,10 @@ struct bitmap_packer {
     // internal
     int *scratch;
     int asize;
+    // placement of the previous packer_pack() call
+    struct pos *prev_in;
+    struct pos *prev_result;
+    int prev_count;
 };
 
 struct sub_bitmaps;
@@ -43,6 +47,9 @@ void packer_set_size(struct bitmap_packer *packer, int size);
  * Resulting packing will be written in packer->result.
  * w and h will be increased if necessary for successful packing.
  * There is a strong guarantee that w and h will be powers of 2 (or set to 0).
+ * If every rectangle has the same size as one of the rectangles of the previous
+ * call, the previous positions are reused, so that the placement of unchanged
+ * bitmaps is stable across calls.
  * Return value is -1 if packing failed because w and h were set to max
  * values but that wasn't enough, 1 if w or h was increased, and 0 otherwise.
  */
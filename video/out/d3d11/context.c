@@ -17,6 +17,7 @@
 
 #include "common/msg.h"
 #include "options/m_config.h"
+#include "osdep/timer.h"
 #include "osdep/windows_utils.h"
 
 #include "video/out/gpu/context.h"
@@ -68,6 +69,17 @@ struct priv {
     struct ra_tex *backbuffer;
     ID3D11Device *device;
     IDXGISwapChain *swapchain;
+    UINT swapchain_flags;
+    // Signaled when the swapchain can accept a new frame, or NULL
+    HANDLE frame_latency_waitable;
+
+    // Presentation feedback state, from the previous frame statistics
+    int64_t qpc_freq;
+    int64_t vsync_duration_qpc;
+    UINT last_sync_refresh_count;
+    int64_t last_sync_qpc_time;
+    UINT last_present_count;
+    UINT last_present_refresh_count;
 };
 
 static struct mp_image *d3d11_screenshot(struct ra_swapchain *sw)
@@ -104,7 +116,7 @@ static bool resize(struct ra_ctx *ctx)
     ra_tex_free(ctx->ra, &p->backbuffer);
 
     hr = IDXGISwapChain_ResizeBuffers(p->swapchain, 0, ctx->vo->dwidth,
-        ctx->vo->dheight, DXGI_FORMAT_UNKNOWN, 0);
+        ctx->vo->dheight, DXGI_FORMAT_UNKNOWN, p->swapchain_flags);
     if (FAILED(hr)) {
         MP_FATAL(ctx, "Couldn't resize swapchain: %s\n", mp_HRESULT_to_str(hr));
         return false;
@@ -133,6 +145,15 @@ static bool d3d11_start_frame(struct ra_swapchain *sw, struct ra_fbo *out_fbo)
     if (!p->backbuffer)
         return false;
 
+    // Block until the swapchain can queue another frame, instead of rendering
+    // the frame and then blocking in Present(). This keeps the latency at
+    // --swapchain-depth frames.
+    if (p->frame_latency_waitable) {
+        DWORD r = WaitForSingleObjectEx(p->frame_latency_waitable, 1000, TRUE);
+        if (r == WAIT_TIMEOUT)
+            MP_VERBOSE(sw->ctx, "Timeout waiting for swapchain\n");
+    }
+
     *out_fbo = (struct ra_fbo) {
         .tex = p->backbuffer,
         .flip = false,
@@ -153,6 +174,69 @@ static void d3d11_swap_buffers(struct ra_swapchain *sw)
     IDXGISwapChain_Present(p->swapchain, p->opts->sync_interval, 0);
 }
 
+static void d3d11_get_vsync(struct ra_swapchain *sw, struct vo_vsync_info *info)
+{
+    struct priv *p = sw->priv;
+    HRESULT hr;
+
+    // Frame statistics count refreshes, which is meaningless without vsync
+    if (p->opts->sync_interval == 0)
+        return;
+
+    DXGI_FRAME_STATISTICS stats;
+    hr = IDXGISwapChain_GetFrameStatistics(p->swapchain, &stats);
+    if (hr == DXGI_ERROR_FRAME_STATISTICS_DISJOINT) {
+        // The counters were reset (e.g. on a mode change), so start over
+        p->vsync_duration_qpc = 0;
+        p->last_sync_refresh_count = 0;
+        p->last_present_count = 0;
+        return;
+    }
+    if (FAILED(hr))
+        return;
+
+    if (p->last_sync_refresh_count &&
+        stats.SyncRefreshCount > p->last_sync_refresh_count)
+    {
+        p->vsync_duration_qpc =
+            (stats.SyncQPCTime.QuadPart - p->last_sync_qpc_time) /
+            (stats.SyncRefreshCount - p->last_sync_refresh_count);
+    }
+    p->last_sync_refresh_count = stats.SyncRefreshCount;
+    p->last_sync_qpc_time = stats.SyncQPCTime.QuadPart;
+
+    // Each present should be shown for exactly sync_interval refreshes. Any
+    // refreshes beyond that repeated the previous frame.
+    if (p->last_present_count) {
+        UINT presents = stats.PresentCount - p->last_present_count;
+        UINT refreshes = stats.PresentRefreshCount - p->last_present_refresh_count;
+        int64_t expected = (int64_t)presents * p->opts->sync_interval;
+        info->skipped_vsyncs = MPMAX((int64_t)refreshes - expected, 0);
+    }
+    p->last_present_count = stats.PresentCount;
+    p->last_present_refresh_count = stats.PresentRefreshCount;
+
+    if (!p->vsync_duration_qpc || !p->qpc_freq)
+        return;
+
+    // Extrapolate from the last frame with known display time to the last
+    // frame we queued.
+    UINT last_queued;
+    hr = IDXGISwapChain_GetLastPresentCount(p->swapchain, &last_queued);
+    if (FAILED(hr))
+        return;
+    int64_t display_qpc = stats.SyncQPCTime.QuadPart -
+        (int64_t)(stats.SyncRefreshCount - stats.PresentRefreshCount) *
+            p->vsync_duration_qpc +
+        (int64_t)(last_queued - stats.PresentCount) *
+            p->opts->sync_interval * p->vsync_duration_qpc;
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    info->last_queue_display_time = mp_time_us() +
+        (display_qpc - now.QuadPart) * 1000000 / p->qpc_freq;
+}
+
 static int d3d11_control(struct ra_ctx *ctx, int *events, int request, void *arg)
 {
     int ret = vo_w32_control(ctx->vo, events, request, arg);
@@ -168,6 +252,9 @@ static void d3d11_uninit(struct ra_ctx *ctx)
     struct priv *p = ctx->priv;
 
     ra_tex_free(ctx->ra, &p->backbuffer);
+    if (p->frame_latency_waitable)
+        CloseHandle(p->frame_latency_waitable);
+    p->frame_latency_waitable = NULL;
     SAFE_RELEASE(p->swapchain);
     vo_w32_uninit(ctx->vo);
     SAFE_RELEASE(p->device);
@@ -183,6 +270,7 @@ static const struct ra_swapchain_fns d3d11_swapchain = {
     .start_frame  = d3d11_start_frame,
     .submit_frame = d3d11_submit_frame,
     .swap_buffers = d3d11_swap_buffers,
+    .get_vsync    = d3d11_get_vsync,
 };
 
 static bool d3d11_init(struct ra_ctx *ctx)
@@ -190,6 +278,10 @@ static bool d3d11_init(struct ra_ctx *ctx)
     struct priv *p = ctx->priv = talloc_zero(ctx, struct priv);
     p->opts = mp_get_config_group(ctx, ctx->global, &d3d11_conf);
 
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    p->qpc_freq = freq.QuadPart;
+
     struct ra_swapchain *sw = ctx->swapchain = talloc_zero(ctx, struct ra_swapchain);
     sw->priv = p;
     sw->ctx = ctx;
@@ -219,6 +311,7 @@ static bool d3d11_init(struct ra_ctx *ctx)
         .width = ctx->vo->dwidth,
         .height = ctx->vo->dheight,
         .flip = p->opts->flip,
+        .waitable = true,
         // Add one frame for the backbuffer and one frame of "slack" to reduce
         // contention with the window manager when acquiring the backbuffer
         .length = ctx->opts.swapchain_depth + 2,
@@ -227,6 +320,24 @@ static bool d3d11_init(struct ra_ctx *ctx)
     if (!mp_d3d11_create_swapchain(p->device, ctx->log, &scopts, &p->swapchain))
         goto error;
 
+    DXGI_SWAP_CHAIN_DESC scd = {0};
+    IDXGISwapChain_GetDesc(p->swapchain, &scd);
+    p->swapchain_flags = scd.Flags;
+    if (scd.Flags & DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT) {
+        IDXGISwapChain2 *swapchain2 = NULL;
+        HRESULT hr = IDXGISwapChain_QueryInterface(p->swapchain,
+            &IID_IDXGISwapChain2, (void**)&swapchain2);
+        if (SUCCEEDED(hr)) {
+            // The device-wide frame latency doesn't apply to waitable
+            // swapchains, so set it here.
+            IDXGISwapChain2_SetMaximumFrameLatency(swapchain2,
+                                                   ctx->opts.swapchain_depth);
+            p->frame_latency_waitable =
+                IDXGISwapChain2_GetFrameLatencyWaitableObject(swapchain2);
+            SAFE_RELEASE(swapchain2);
+        }
+    }
+
     p->backbuffer = get_backbuffer(ctx);
     if (!p->backbuffer)
         goto error;
@@ -1217,7 +1217,7 @@ static bool compile_glsl(struct ra *ra, enum glsl_shader type,
     int64_t start_us = mp_time_us();
 
     bstr spv_module;
-    if (!spirv->fns->compile_glsl(spirv, ta_ctx, type, glsl, &spv_module))
+    if (!spirv_compile_glsl(spirv, ta_ctx, type, glsl, &spv_module))
         goto done;
 
     int64_t shaderc_us = mp_time_us();
@@ -2260,6 +2260,7 @@ struct ra *ra_d3d11_create(ID3D11Device *dev, struct mp_log *log,
     if (p->fl >= D3D_FEATURE_LEVEL_11_0) {
         ra->caps |= RA_CAP_COMPUTE | RA_CAP_BUF_RW;
         ra->max_shmem = 32 * 1024;
+        ra->max_compute_group_threads = D3D11_CS_THREAD_GROUP_MAX_THREADS_PER_GROUP;
     }
 
     if (p->fl >= D3D_FEATURE_LEVEL_11_1) {
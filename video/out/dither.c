@@ -27,10 +27,12 @@
 #include <string.h>
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
 
 #include <libavutil/lfg.h>
 
 #include "mpv_talloc.h"
+#include "common/common.h"
 #include "dither.h"
 
 #define MAX_SIZEB 8
@@ -150,18 +152,57 @@ static void makeuniform(struct ctx *k)
     }
 }
 
-// out_matrix is a reactangular tsize * tsize array, where tsize = (1 << size).
-void mp_make_fruit_dither_matrix(float *out_matrix, int size)
+// Matrices for the common sizes, generated at build time by TOOLS/dither.py.
+// Entry n is the value at index n of the output, times size2.
+#include "video/out/dither_matrix.inc"
+
+// Matrices for the remaining sizes, computed on first use.
+static pthread_mutex_t fruit_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static float *fruit_cache[MAX_SIZEB + 1];
+
+static float *compute_fruit_matrix(int size)
 {
     struct ctx *k = talloc_zero(NULL, struct ctx);
     makegauss(k, size);
     makeuniform(k);
+    float *res = talloc_array(NULL, float, k->size2);
     float invscale = k->size2;
     for(index_t y = 0; y < k->size; y++) {
         for(index_t x = 0; x < k->size; x++)
-            out_matrix[x + y * k->size] = k->unimat[XY(k, x, y)] / invscale;
+            res[x + y * k->size] = k->unimat[XY(k, x, y)] / invscale;
     }
     talloc_free(k);
+    return res;
+}
+
+// out_matrix is a reactangular tsize * tsize array, where tsize = (1 << size).
+void mp_make_fruit_dither_matrix(float *out_matrix, int size)
+{
+    assert(size >= 1 && size <= MAX_SIZEB);
+    unsigned int size2 = 1u << (size * 2);
+
+    if (size < MP_ARRAY_SIZE(fruit_dither_builtin) && fruit_dither_builtin[size]) {
+        const uint16_t *m = fruit_dither_builtin[size];
+        float invscale = size2;
+        for (index_t c = 0; c < size2; c++)
+            out_matrix[c] = m[c] / invscale;
+        return;
+    }
+
+    pthread_mutex_lock(&fruit_cache_lock);
+    if (!fruit_cache[size])
+        fruit_cache[size] = compute_fruit_matrix(size);
+    memcpy(out_matrix, fruit_cache[size], size2 * sizeof(float));
+    pthread_mutex_unlock(&fruit_cache_lock);
+}
+
+// Free the matrices cached by mp_make_fruit_dither_matrix().
+void mp_dither_flush_cache(void)
+{
+    pthread_mutex_lock(&fruit_cache_lock);
+    for (int n = 0; n <= MAX_SIZEB; n++)
+        TA_FREEP(&fruit_cache[n]);
+    pthread_mutex_unlock(&fruit_cache_lock);
 }
 
 void mp_make_ordered_dither_matrix(unsigned char *m, int size)
@@ -1,2 +1,3 @@
 void mp_make_fruit_dither_matrix(float *out_matrix, int size);
+void mp_dither_flush_cache(void);
 void mp_make_ordered_dither_matrix(unsigned char *m, int size);
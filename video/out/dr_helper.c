@@ -0,0 +1,185 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <libavutil/buffer.h>
+
+#include "mpv_talloc.h"
+#include "misc/dispatch.h"
+#include "osdep/timer.h"
+#include "video/mp_image.h"
+
+#include "dr_helper.h"
+
+struct dr_helper {
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+
+    struct mp_dispatch_queue *dispatch;
+    dr_helper_get_image_fn get_image;
+    void *get_image_ctx;
+    void (*wakeup_cb)(void *ctx);
+    void *wakeup_ctx;
+
+    // --- Protected by lock
+    bool pending;               // request waiting for the owner thread
+    bool running;               // request being served by the owner thread
+    int imgfmt, w, h, stride_align;
+    struct mp_image *res;
+};
+
+struct free_dr_context {
+    struct dr_helper *dr;
+    AVBufferRef *ref;
+};
+
+static void dr_helper_destroy(void *ptr)
+{
+    struct dr_helper *dr = ptr;
+
+    pthread_cond_destroy(&dr->wakeup);
+    pthread_mutex_destroy(&dr->lock);
+}
+
+struct dr_helper *dr_helper_create(void *ta_parent,
+                                   struct mp_dispatch_queue *dispatch,
+                                   dr_helper_get_image_fn get_image,
+                                   void *get_image_ctx,
+                                   void (*wakeup)(void *ctx),
+                                   void *wakeup_ctx)
+{
+    struct dr_helper *dr = talloc_ptrtype(ta_parent, dr);
+    talloc_set_destructor(dr, dr_helper_destroy);
+    *dr = (struct dr_helper){
+        .dispatch = dispatch,
+        .get_image = get_image,
+        .get_image_ctx = get_image_ctx,
+        .wakeup_cb = wakeup,
+        .wakeup_ctx = wakeup_ctx,
+    };
+    pthread_mutex_init(&dr->lock, NULL);
+    pthread_cond_init(&dr->wakeup, NULL);
+    return dr;
+}
+
+// Runs on the owner thread. (fn_data is free'd by the dispatch queue.)
+static void dr_thread_free(void *ptr)
+{
+    struct free_dr_context *ctx = ptr;
+
+    av_buffer_unref(&ctx->ref);
+}
+
+static void free_dr_buffer_on_dr_thread(void *opaque, uint8_t *data)
+{
+    struct free_dr_context *ctx = opaque;
+
+    // Asynchronous, so that releasing an image never blocks on the owner
+    // thread. This also works if the owner thread is the caller.
+    mp_dispatch_enqueue_autofree(ctx->dr->dispatch, dr_thread_free, ctx);
+}
+
+static void dr_thread_get_image(void *ptr)
+{
+    struct dr_helper *dr = ptr;
+
+    pthread_mutex_lock(&dr->lock);
+    if (!dr->pending) {
+        // Request timed out and was abandoned.
+        pthread_mutex_unlock(&dr->lock);
+        return;
+    }
+    dr->pending = false;
+    dr->running = true;
+    int imgfmt = dr->imgfmt, w = dr->w, h = dr->h;
+    int stride_align = dr->stride_align;
+    pthread_mutex_unlock(&dr->lock);
+
+    struct mp_image *res =
+        dr->get_image(dr->get_image_ctx, imgfmt, w, h, stride_align);
+
+    if (res) {
+        // Same requirements and trick as in vo.c: alias the original ref, so
+        // that the real unref can be deferred to this thread.
+        assert(res->bufs[0]);
+        assert(!res->bufs[1]);
+        assert(mp_image_is_writeable(res));
+
+        struct free_dr_context *ctx = talloc_zero(NULL, struct free_dr_context);
+        *ctx = (struct free_dr_context){
+            .dr = dr,
+            .ref = res->bufs[0],
+        };
+
+        AVBufferRef *new_ref = av_buffer_create(ctx->ref->data, ctx->ref->size,
+                                                free_dr_buffer_on_dr_thread,
+                                                ctx, 0);
+        if (!new_ref)
+            abort(); // tiny malloc OOM
+
+        res->bufs[0] = new_ref;
+    }
+
+    pthread_mutex_lock(&dr->lock);
+    dr->res = res;
+    dr->running = false;
+    pthread_cond_broadcast(&dr->wakeup);
+    pthread_mutex_unlock(&dr->lock);
+}
+
+struct mp_image *dr_helper_get_image(struct dr_helper *dr, int imgfmt,
+                                     int w, int h, int stride_align,
+                                     double timeout)
+{
+    pthread_mutex_lock(&dr->lock);
+    assert(!dr->pending && !dr->running && !dr->res);
+    dr->pending = true;
+    dr->imgfmt = imgfmt;
+    dr->w = w;
+    dr->h = h;
+    dr->stride_align = stride_align;
+    pthread_mutex_unlock(&dr->lock);
+
+    mp_dispatch_enqueue(dr->dispatch, dr_thread_get_image, dr);
+    if (dr->wakeup_cb)
+        dr->wakeup_cb(dr->wakeup_ctx);
+
+    struct timespec ts = mp_rel_time_to_timespec(timeout);
+
+    pthread_mutex_lock(&dr->lock);
+    while (dr->pending || dr->running) {
+        if (dr->running) {
+            // Allocation is in progress; it can't be abandoned anymore.
+            pthread_cond_wait(&dr->wakeup, &dr->lock);
+        } else if (pthread_cond_timedwait(&dr->wakeup, &dr->lock, &ts)) {
+            if (dr->pending) {
+                // The queued dispatch item will notice and do nothing.
+                dr->pending = false;
+                break;
+            }
+        }
+    }
+    struct mp_image *res = dr->res;
+    dr->res = NULL;
+    pthread_mutex_unlock(&dr->lock);
+
+    return res;
+}
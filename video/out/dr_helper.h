@@ -0,0 +1,35 @@
+#ifndef MP_DR_HELPER_H_
+#define MP_DR_HELPER_H_
+
+struct dr_helper;
+struct mp_image;
+struct mp_dispatch_queue;
+
+typedef struct mp_image *(*dr_helper_get_image_fn)(void *ctx, int imgfmt,
+                                                   int w, int h,
+                                                   int stride_align);
+
+// This helps VOs to implement vo_driver.get_image if the renderer is owned by
+// a thread other than the VO thread (e.g. because it belongs to a libmpv API
+// user). get_image is always called on the thread that processes dispatch,
+// and the returned images are always freed on that thread as well, no matter
+// where the last reference is released. Images can stay alive after the VO is
+// destroyed, so this must outlive the VO, and the owner thread must keep
+// processing dispatch until all images are gone.
+//  wakeup: called after a request was queued, to ask the owner thread to
+//          process dispatch (must not call back into the dr_helper)
+struct dr_helper *dr_helper_create(void *ta_parent,
+                                   struct mp_dispatch_queue *dispatch,
+                                   dr_helper_get_image_fn get_image,
+                                   void *get_image_ctx,
+                                   void (*wakeup)(void *ctx),
+                                   void *wakeup_ctx);
+
+// Allocate an image on the owner thread. This waits up to timeout seconds for
+// the owner thread to pick up the request, and returns NULL on timeout or
+// failure. Must not be called from multiple threads at the same time.
+struct mp_image *dr_helper_get_image(struct dr_helper *dr, int imgfmt,
+                                     int w, int h, int stride_align,
+                                     double timeout);
+
+#endif
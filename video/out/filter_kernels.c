@@ -26,9 +26,11 @@
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "filter_kernels.h"
 #include "common/common.h"
+#include "mpv_talloc.h"
 
 // NOTE: all filters are designed for discrete convolution
 
@@ -141,6 +143,53 @@ static void mp_compute_weights(struct filter_kernel *filter, double f,
         out_w[n] /= sum;
 }
 
+static bool param_equal(double a, double b)
+{
+    return a == b || (isnan(a) && isnan(b));
+}
+
+static bool window_equal(const struct filter_window *a,
+                         const struct filter_window *b)
+{
+    return a->weight == b->weight &&
+           param_equal(a->radius, b->radius) &&
+           param_equal(a->params[0], b->params[0]) &&
+           param_equal(a->params[1], b->params[1]) &&
+           param_equal(a->blur, b->blur) &&
+           param_equal(a->taper, b->taper);
+}
+
+// Return whether mp_compute_lut() produces the same output for both filters
+// (both must have been initialized with mp_init_filter()).
+bool mp_filter_lut_equal(const struct filter_kernel *a,
+                         const struct filter_kernel *b)
+{
+    if (a->polar != b->polar || !window_equal(&a->f, &b->f) ||
+        !window_equal(&a->w, &b->w) || !param_equal(a->clamp, b->clamp) ||
+        !param_equal(a->value_cutoff, b->value_cutoff))
+        return false;
+    // Polar LUTs are indexed by radius only.
+    return a->polar || (a->size == b->size && a->filter_scale == b->filter_scale);
+}
+
+static void compute_lut(struct filter_kernel *filter, int count, int stride,
+                        float *out_array);
+
+// LUTs computed by mp_compute_lut(), most recently used first. Scalers are
+// reinitialized on every scale factor change (e.g. while resizing the window),
+// and EWA LUTs in particular are expensive to compute, while the result hardly
+// ever changes.
+#define LUT_CACHE_SIZE 8
+
+struct lut_cache_entry {
+    struct filter_kernel filter;
+    int count, stride;
+    float *data;
+};
+
+static pthread_mutex_t lut_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct lut_cache_entry *lut_cache[LUT_CACHE_SIZE];
+
 // Fill the given array with weights for the range [0.0, 1.0]. The array is
 // interpreted as rectangular array of count * filter->size items, with a
 // stride of `stride` floats in between each array element. (For polar filters,
@@ -151,8 +200,61 @@ static void mp_compute_weights(struct filter_kernel *filter, double f,
 // center, so out_array[0] will end up at 0.5 / count instead of 0.0.
 // Correct lookup requires a linear coordinate mapping from [0.0, 1.0] to
 // [0.5 / count, 1.0 - 0.5 / count].
+//
+// The result is cached, so calling this repeatedly with the same filter
+// parameters is cheap.
 void mp_compute_lut(struct filter_kernel *filter, int count, int stride,
                     float *out_array)
+{
+    size_t size = (filter->polar ? count : count * stride) * sizeof(float);
+
+    pthread_mutex_lock(&lut_cache_lock);
+    for (int n = 0; n < LUT_CACHE_SIZE; n++) {
+        struct lut_cache_entry *e = lut_cache[n];
+        if (e && e->count == count && (filter->polar || e->stride == stride) &&
+            mp_filter_lut_equal(&e->filter, filter))
+        {
+            memcpy(out_array, e->data, size);
+            filter->radius_cutoff = e->filter.radius_cutoff;
+            for (int i = n; i > 0; i--)
+                lut_cache[i] = lut_cache[i - 1];
+            lut_cache[0] = e;
+            pthread_mutex_unlock(&lut_cache_lock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&lut_cache_lock);
+
+    compute_lut(filter, count, stride, out_array);
+
+    struct lut_cache_entry *e = talloc_ptrtype(NULL, e);
+    *e = (struct lut_cache_entry){
+        .filter = *filter,
+        .count = count,
+        .stride = stride,
+        .data = talloc_memdup(e, out_array, size),
+    };
+
+    pthread_mutex_lock(&lut_cache_lock);
+    struct lut_cache_entry *old = lut_cache[LUT_CACHE_SIZE - 1];
+    for (int n = LUT_CACHE_SIZE - 1; n > 0; n--)
+        lut_cache[n] = lut_cache[n - 1];
+    lut_cache[0] = e;
+    pthread_mutex_unlock(&lut_cache_lock);
+    talloc_free(old);
+}
+
+// Free all LUTs cached by mp_compute_lut().
+void mp_compute_lut_flush_cache(void)
+{
+    pthread_mutex_lock(&lut_cache_lock);
+    for (int n = 0; n < LUT_CACHE_SIZE; n++)
+        TA_FREEP(&lut_cache[n]);
+    pthread_mutex_unlock(&lut_cache_lock);
+}
+
+static void compute_lut(struct filter_kernel *filter, int count, int stride,
+                        float *out_array)
 {
     if (filter->polar) {
         filter->radius_cutoff = 0.0;
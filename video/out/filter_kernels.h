@@ -52,5 +52,8 @@ bool mp_init_filter(struct filter_kernel *filter, const int *sizes,
                     double scale);
 void mp_compute_lut(struct filter_kernel *filter, int count, int stride,
                     float *out_array);
+void mp_compute_lut_flush_cache(void);
+bool mp_filter_lut_equal(const struct filter_kernel *a,
+                         const struct filter_kernel *b);
 
 #endif /* MPLAYER_FILTER_KERNELS_H */
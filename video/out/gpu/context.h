@@ -72,6 +72,14 @@ struct ra_swapchain_fns {
     // Retrieves a screenshot of the framebuffer. Optional.
     struct mp_image *(*screenshot)(struct ra_swapchain *sw);
 
+    // Asynchronous variant of screenshot(). screenshot_start() begins reading
+    // back the current framebuffer contents, and returns false if this is not
+    // possible or too many readbacks are pending. screenshot_fetch() returns
+    // the oldest pending readback once it has completed (blocking until then
+    // if wait is set), or NULL. Both are optional.
+    bool (*screenshot_start)(struct ra_swapchain *sw);
+    struct mp_image *(*screenshot_fetch)(struct ra_swapchain *sw, bool wait);
+
     // Called when rendering starts. Returns NULL on failure. This must be
     // followed by submit_frame, to submit the rendered frame. This function
     // can also fail sporadically, and such errors should be ignored unless
@@ -86,6 +94,9 @@ struct ra_swapchain_fns {
     // Performs a buffer swap. This blocks for as long as necessary to meet
     // params.swapchain_depth, or until the next vblank (for vsynced contexts)
     void (*swap_buffers)(struct ra_swapchain *sw);
+
+    // See vo_driver.get_vsync. Optional.
+    void (*get_vsync)(struct ra_swapchain *sw, struct vo_vsync_info *info);
 };
 
 // Create and destroy a ra_ctx. This also takes care of creating and destroying
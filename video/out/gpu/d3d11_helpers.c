@@ -217,7 +217,7 @@ done:
 static HRESULT create_swapchain_1_2(ID3D11Device *dev, IDXGIFactory2 *factory,
                                     struct mp_log *log,
                                     struct d3d11_swapchain_opts *opts,
-                                    bool flip, DXGI_FORMAT format,
+                                    bool flip, bool waitable, DXGI_FORMAT format,
                                     IDXGISwapChain **swapchain_out)
 {
     IDXGISwapChain *swapchain = NULL;
@@ -235,6 +235,8 @@ static HRESULT create_swapchain_1_2(ID3D11Device *dev, IDXGIFactory2 *factory,
     if (flip) {
         desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
         desc.BufferCount = opts->length;
+        if (waitable)
+            desc.Flags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
     } else {
         desc.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
         desc.BufferCount = 1;
@@ -316,12 +318,13 @@ bool mp_d3d11_create_swapchain(ID3D11Device *dev, struct mp_log *log,
         factory2 = NULL;
 
     bool flip = factory2 && opts->flip;
+    bool waitable = flip && opts->waitable;
 
     // Return here to retry creating the swapchain
     do {
         if (factory2) {
             // Create a DXGI 1.2+ (Windows 8+) swap chain if possible
-            hr = create_swapchain_1_2(dev, factory2, log, opts, flip,
+            hr = create_swapchain_1_2(dev, factory2, log, opts, flip, waitable,
                                       DXGI_FORMAT_R8G8B8A8_UNORM, &swapchain);
         } else {
             // Fall back to DXGI 1.1 (Windows 7)
@@ -331,6 +334,13 @@ bool mp_d3d11_create_swapchain(ID3D11Device *dev, struct mp_log *log,
         if (SUCCEEDED(hr))
             break;
 
+        if (waitable) {
+            // Not supported before Windows 8.1
+            mp_dbg(log, "Failed to create waitable swapchain, trying without\n");
+            waitable = false;
+            continue;
+        }
+
         if (flip) {
             mp_dbg(log, "Failed to create flip-model swapchain, trying bitblt\n");
             flip = false;
@@ -357,7 +367,9 @@ bool mp_d3d11_create_swapchain(ID3D11Device *dev, struct mp_log *log,
     DXGI_SWAP_CHAIN_DESC scd = {0};
     IDXGISwapChain_GetDesc(swapchain, &scd);
     if (scd.SwapEffect == DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL) {
-        mp_verbose(log, "Using flip-model presentation\n");
+        mp_verbose(log, "Using flip-model presentation%s\n",
+                   (scd.Flags & DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT)
+                   ? " with frame latency waitable object" : "");
     } else {
         mp_verbose(log, "Using bitblt-model presentation\n");
     }
@@ -22,6 +22,7 @@
 #include <windows.h>
 #include <d3d11.h>
 #include <dxgi1_2.h>
+#include <dxgi1_3.h>
 
 #include "video/mp_image.h"
 
@@ -66,6 +67,10 @@ struct d3d11_swapchain_opts {
     // Use DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL if possible
     bool flip;
 
+    // With flip-model, create the swapchain with a frame latency waitable
+    // object if possible (DXGI 1.3, Windows 8.1+)
+    bool waitable;
+
     // Number of surfaces in the swapchain
     int length;
 
@@ -27,6 +27,7 @@
 
 extern const struct ra_hwdec_driver ra_hwdec_vaegl;
 extern const struct ra_hwdec_driver ra_hwdec_vaglx;
+extern const struct ra_hwdec_driver ra_hwdec_vaapi_vk;
 extern const struct ra_hwdec_driver ra_hwdec_videotoolbox;
 extern const struct ra_hwdec_driver ra_hwdec_vdpau;
 extern const struct ra_hwdec_driver ra_hwdec_dxva2egl;
@@ -45,6 +46,9 @@ const struct ra_hwdec_driver *const ra_hwdec_drivers[] = {
 #if HAVE_VAAPI_EGL
     &ra_hwdec_vaegl,
 #endif
+#if HAVE_VAAPI_VULKAN
+    &ra_hwdec_vaapi_vk,
+#endif
 #if HAVE_VIDEOTOOLBOX_GL || HAVE_IOS_GL
     &ra_hwdec_videotoolbox,
 #endif
@@ -17,6 +17,7 @@
 
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "mpv_talloc.h"
 
@@ -28,6 +29,7 @@
 #include "common/msg.h"
 #include "options/m_option.h"
 #include "options/path.h"
+#include "misc/thread_pool.h"
 #include "video/csputils.h"
 #include "lcms.h"
 
@@ -39,6 +41,29 @@
 #include <libavutil/sha.h>
 #include <libavutil/mem.h>
 
+// A 3D LUT generation request. All parameters are copied, so the job can run
+// on a worker thread without touching struct gl_lcms.
+struct lut3d_job {
+    struct mp_log *log;
+    struct mpv_global *global;
+
+    void *icc_data;
+    size_t icc_size;
+    struct AVBufferRef *vid_profile;
+    enum mp_csp_prim prim;
+    enum mp_csp_trc trc;
+    int use_embedded;
+    int intent;
+    int contrast;
+    char *cache_dir;
+    int size[3];
+
+    // --- the following fields are protected by gl_lcms.lock
+    bool done;
+    bool abandoned; // owner lost interest; the worker frees the job
+    struct lut3d *lut; // result, NULL on failure
+};
+
 struct gl_lcms {
     void *icc_data;
     size_t icc_size;
@@ -52,6 +77,10 @@ struct gl_lcms {
     struct mp_log *log;
     struct mpv_global *global;
     struct mp_icc_opts *opts;
+
+    struct mp_thread_pool *pool; // NULL => generate synchronously
+    pthread_mutex_t lock;
+    struct lut3d_job *job; // pending or finished request
 };
 
 static bool parse_3dlut_size(const char *arg, int *p1, int *p2, int *p3)
@@ -101,7 +130,7 @@ const struct m_sub_options mp_icc_conf = {
 static void lcms2_error_handler(cmsContext ctx, cmsUInt32Number code,
                                 const char *msg)
 {
-    struct gl_lcms *p = cmsGetContextUserData(ctx);
+    struct lut3d_job *p = cmsGetContextUserData(ctx);
     MP_ERR(p, "lcms2: %s\n", msg);
 }
 
@@ -132,9 +161,36 @@ static void load_profile(struct gl_lcms *p)
     p->current_profile = talloc_strdup(p, p->opts->profile);
 }
 
+static void lut3d_job_destructor(void *ptr)
+{
+    struct lut3d_job *job = ptr;
+    av_buffer_unref(&job->vid_profile);
+}
+
+// Detach the current job. If it's still running, the worker frees it.
+static void abandon_job(struct gl_lcms *p)
+{
+    if (!p->job)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    bool done = p->job->done;
+    p->job->abandoned = true;
+    pthread_mutex_unlock(&p->lock);
+
+    if (done)
+        talloc_free(p->job);
+    p->job = NULL;
+}
+
 static void gl_lcms_destructor(void *ptr)
 {
     struct gl_lcms *p = ptr;
+    // Blocks until running jobs are done.
+    talloc_free(p->pool);
+    p->pool = NULL;
+    abandon_job(p);
+    pthread_mutex_destroy(&p->lock);
     av_buffer_unref(&p->vid_profile);
 }
 
@@ -149,6 +205,8 @@ struct gl_lcms *gl_lcms_init(void *talloc_ctx, struct mp_log *log,
         .log = log,
         .opts = opts,
     };
+    pthread_mutex_init(&p->lock, NULL);
+    p->pool = mp_thread_pool_create(p, 1);
     gl_lcms_update_options(p);
     return p;
 }
@@ -222,11 +280,11 @@ bool gl_lcms_has_profile(struct gl_lcms *p)
     return p->icc_size > 0;
 }
 
-static cmsHPROFILE get_vid_profile(struct gl_lcms *p, cmsContext cms,
+static cmsHPROFILE get_vid_profile(struct lut3d_job *p, cmsContext cms,
                                    cmsHPROFILE disp_profile,
                                    enum mp_csp_prim prim, enum mp_csp_trc trc)
 {
-    if (p->opts->use_embedded && p->vid_profile) {
+    if (p->use_embedded && p->vid_profile) {
         // Try using the embedded ICC profile
         cmsHPROFILE prof = cmsOpenProfileFromMemTHR(cms, p->vid_profile->data,
                                                     p->vid_profile->size);
@@ -297,9 +355,9 @@ static cmsHPROFILE get_vid_profile(struct gl_lcms *p, cmsContext cms,
         cmsDeleteTransform(xyz2src);
 
         // Contrast limiting
-        if (p->opts->contrast > 0) {
+        if (p->contrast > 0) {
             for (int i = 0; i < 3; i++)
-                src_black[i] = MPMAX(src_black[i], 1.0 / p->opts->contrast);
+                src_black[i] = MPMAX(src_black[i], 1.0 / p->contrast);
         }
 
         // Built-in contrast failsafe
@@ -341,33 +399,12 @@ static cmsHPROFILE get_vid_profile(struct gl_lcms *p, cmsContext cms,
     return vid_profile;
 }
 
-bool gl_lcms_get_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d,
-                       enum mp_csp_prim prim, enum mp_csp_trc trc,
-                       struct AVBufferRef *vid_profile)
+// Generate the LUT for the job's parameters. Runs on the worker thread.
+static struct lut3d *generate_lut3d(struct lut3d_job *p)
 {
-    int s_r, s_g, s_b;
-    bool result = false;
-
-    p->changed = false;
-    p->current_prim = prim;
-    p->current_trc = trc;
-
-    // We need to hold on to a reference to the video's ICC profile for as long
-    // as we still need to perform equality checking, so generate a new
-    // reference here
-    av_buffer_unref(&p->vid_profile);
-    if (vid_profile) {
-        MP_VERBOSE(p, "Got an embedded ICC profile.\n");
-        p->vid_profile = av_buffer_ref(vid_profile);
-        if (!p->vid_profile)
-            abort();
-    }
-
-    if (!parse_3dlut_size(p->opts->size_str, &s_r, &s_g, &s_b))
-        return false;
-
-    if (!gl_lcms_has_profile(p))
-        return false;
+    int s_r = p->size[0], s_g = p->size[1], s_b = p->size[2];
+    enum mp_csp_prim prim = p->prim;
+    enum mp_csp_trc trc = p->trc;
 
     void *tmp = talloc_new(NULL);
     uint16_t *output = talloc_array(tmp, uint16_t, s_r * s_g * s_b * 4);
@@ -375,14 +412,14 @@ bool gl_lcms_get_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d,
     cmsContext cms = NULL;
 
     char *cache_file = NULL;
-    if (p->opts->cache_dir && p->opts->cache_dir[0]) {
+    if (p->cache_dir && p->cache_dir[0]) {
         // Gamma is included in the header to help uniquely identify it,
         // because we may change the parameter in the future or make it
         // customizable, same for the primaries.
         char *cache_info = talloc_asprintf(tmp,
                 "ver=1.4, intent=%d, size=%dx%dx%d, prim=%d, trc=%d, "
                 "contrast=%d\n",
-                p->opts->intent, s_r, s_g, s_b, prim, trc, p->opts->contrast);
+                p->intent, s_r, s_g, s_b, prim, trc, p->contrast);
 
         uint8_t hash[32];
         struct AVSHA *sha = av_sha_alloc();
@@ -390,13 +427,13 @@ bool gl_lcms_get_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d,
             abort();
         av_sha_init(sha, 256);
         av_sha_update(sha, cache_info, strlen(cache_info));
-        if (vid_profile)
-            av_sha_update(sha, vid_profile->data, vid_profile->size);
+        if (p->vid_profile)
+            av_sha_update(sha, p->vid_profile->data, p->vid_profile->size);
         av_sha_update(sha, p->icc_data, p->icc_size);
         av_sha_final(sha, hash);
         av_free(sha);
 
-        char *cache_dir = mp_get_user_path(tmp, p->global, p->opts->cache_dir);
+        char *cache_dir = mp_get_user_path(tmp, p->global, p->cache_dir);
         cache_file = talloc_strdup(tmp, "");
         for (int i = 0; i < sizeof(hash); i++)
             cache_file = talloc_asprintf_append(cache_file, "%02X", hash[i]);
@@ -436,7 +473,7 @@ bool gl_lcms_get_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d,
 
     cmsHTRANSFORM trafo = cmsCreateTransformTHR(cms, vid_hprofile, TYPE_RGB_16,
                                                 profile, TYPE_RGBA_16,
-                                                p->opts->intent,
+                                                p->intent,
                                                 cmsFLAGS_HIGHRESPRECALC |
                                                 cmsFLAGS_BLACKPOINTCOMPENSATION);
     cmsCloseProfile(profile);
@@ -477,9 +514,6 @@ done: ;
         .size = {s_r, s_g, s_b},
     };
 
-    *result_lut3d = lut;
-    result = true;
-
 error_exit:
 
     if (cms)
@@ -489,7 +523,118 @@ error_exit:
         MP_FATAL(p, "Error loading ICC profile.\n");
 
     talloc_free(tmp);
-    return result;
+    return lut;
+}
+
+struct lut3d_work {
+    struct gl_lcms *owner;
+    struct lut3d_job *job;
+};
+
+static void lut3d_job_fn(void *ctx)
+{
+    struct lut3d_work *work = ctx;
+    struct gl_lcms *p = work->owner;
+    struct lut3d_job *job = work->job;
+    talloc_free(work);
+
+    struct lut3d *lut = generate_lut3d(job);
+
+    pthread_mutex_lock(&p->lock);
+    job->lut = talloc_steal(job, lut);
+    job->done = true;
+    bool abandoned = job->abandoned;
+    pthread_mutex_unlock(&p->lock);
+
+    if (abandoned)
+        talloc_free(job);
+}
+
+// Request the 3D LUT for the given parameters. The LUT is generated on a
+// worker thread, so this returns false with *pending set until the result
+// is available; the caller should call this again later (without using any
+// previously returned LUT for the new parameters). Returns false with
+// *pending unset on failure.
+bool gl_lcms_get_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d,
+                       enum mp_csp_prim prim, enum mp_csp_trc trc,
+                       struct AVBufferRef *vid_profile, bool *pending)
+{
+    *pending = false;
+
+    if (p->job && !gl_lcms_has_changed(p, prim, trc, vid_profile)) {
+        // Poll the request for the current parameters
+        pthread_mutex_lock(&p->lock);
+        bool done = p->job->done;
+        pthread_mutex_unlock(&p->lock);
+        if (!done) {
+            *pending = true;
+            return false;
+        }
+        struct lut3d *lut = talloc_steal(NULL, p->job->lut);
+        talloc_free(p->job);
+        p->job = NULL;
+        *result_lut3d = lut;
+        return !!lut;
+    }
+
+    abandon_job(p);
+
+    int s_r, s_g, s_b;
+
+    p->changed = false;
+    p->current_prim = prim;
+    p->current_trc = trc;
+
+    // We need to hold on to a reference to the video's ICC profile for as long
+    // as we still need to perform equality checking, so generate a new
+    // reference here
+    av_buffer_unref(&p->vid_profile);
+    if (vid_profile) {
+        MP_VERBOSE(p, "Got an embedded ICC profile.\n");
+        p->vid_profile = av_buffer_ref(vid_profile);
+        if (!p->vid_profile)
+            abort();
+    }
+
+    if (!parse_3dlut_size(p->opts->size_str, &s_r, &s_g, &s_b))
+        return false;
+
+    if (!gl_lcms_has_profile(p))
+        return false;
+
+    struct lut3d_job *job = talloc_ptrtype(NULL, job);
+    talloc_set_destructor(job, lut3d_job_destructor);
+    *job = (struct lut3d_job) {
+        .log = p->log,
+        .global = p->global,
+        .icc_data = talloc_memdup(job, p->icc_data, p->icc_size),
+        .icc_size = p->icc_size,
+        .vid_profile = vid_profile ? av_buffer_ref(vid_profile) : NULL,
+        .prim = prim,
+        .trc = trc,
+        .use_embedded = p->opts->use_embedded,
+        .intent = p->opts->intent,
+        .contrast = p->opts->contrast,
+        .cache_dir = talloc_strdup(job, p->opts->cache_dir),
+        .size = {s_r, s_g, s_b},
+    };
+    if (vid_profile && !job->vid_profile)
+        abort();
+
+    if (!p->pool) {
+        struct lut3d *lut = generate_lut3d(job);
+        talloc_free(job);
+        *result_lut3d = lut;
+        return !!lut;
+    }
+
+    p->job = job;
+    struct lut3d_work *work = talloc_ptrtype(NULL, work);
+    *work = (struct lut3d_work){ .owner = p, .job = job };
+    mp_thread_pool_queue(p->pool, lut3d_job_fn, work);
+
+    *pending = true;
+    return false;
 }
 
 #else /* HAVE_LCMS2 */
@@ -523,8 +668,9 @@ bool gl_lcms_has_profile(struct gl_lcms *p)
 
 bool gl_lcms_get_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d,
                        enum mp_csp_prim prim, enum mp_csp_trc trc,
-                       struct AVBufferRef *vid_profile)
+                       struct AVBufferRef *vid_profile, bool *pending)
 {
+    *pending = false;
     return false;
 }
 
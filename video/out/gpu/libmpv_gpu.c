@@ -0,0 +1,228 @@
+#include <assert.h>
+
+#include "config.h"
+#include "hwdec.h"
+#include "libmpv_gpu.h"
+#include "video.h"
+#include "video/out/libmpv.h"
+
+static const struct libmpv_gpu_context_fns *context_backends[] = {
+#if HAVE_GL
+    &libmpv_gpu_context_gl,
+#endif
+    NULL
+};
+
+struct priv {
+    struct libmpv_gpu_context *context;
+
+    // renderers[0] is the main view, and is always set after init. The other
+    // views are created on demand, and render from renderers[0]'s textures.
+    struct gl_video *renderers[MP_RENDER_MAX_VIEWS];
+
+    // For initializing additional views.
+    bstr icc_profile;
+    int ambient_lux;
+    bool ambient_lux_set;
+};
+
+static struct gl_video *get_renderer(struct render_backend *ctx, int view)
+{
+    struct priv *p = ctx->priv;
+
+    assert(view >= 0 && view < MP_RENDER_MAX_VIEWS);
+    if (!p->renderers[view]) {
+        struct gl_video *r =
+            gl_video_init(p->context->ra_ctx->ra, ctx->log, ctx->global);
+        gl_video_set_upload_source(r, p->renderers[0]);
+        if (p->icc_profile.len)
+            gl_video_set_icc_profile(r, bstrdup(NULL, p->icc_profile));
+        if (p->ambient_lux_set)
+            gl_video_set_ambient_lux(r, p->ambient_lux);
+        p->renderers[view] = r;
+    }
+    return p->renderers[view];
+}
+
+static int init(struct render_backend *ctx, mpv_render_param *params)
+{
+    ctx->priv = talloc_zero(ctx, struct priv);
+    struct priv *p = ctx->priv;
+
+    char *api = get_mpv_render_param(params, MPV_RENDER_PARAM_API_TYPE, NULL);
+    if (!api)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    for (int n = 0; context_backends[n]; n++) {
+        const struct libmpv_gpu_context_fns *backend = context_backends[n];
+        if (strcmp(backend->api_name, api) == 0) {
+            p->context = talloc_zero(p, struct libmpv_gpu_context);
+            *p->context = (struct libmpv_gpu_context){
+                .global = ctx->global,
+                .log = ctx->log,
+                .fns = backend,
+            };
+            break;
+        }
+    }
+
+    if (!p->context)
+        return MPV_ERROR_NOT_IMPLEMENTED;
+
+    int err = p->context->fns->init(p->context, params);
+    if (err < 0)
+        return err;
+
+    p->renderers[0] =
+        gl_video_init(p->context->ra_ctx->ra, ctx->log, ctx->global);
+
+    ctx->hwdec_devs = hwdec_devices_create();
+    gl_video_load_hwdecs(p->renderers[0], ctx->hwdec_devs, true);
+    ctx->driver_caps = VO_CAP_ROTATE90;
+    return 0;
+}
+
+static bool check_format(struct render_backend *ctx, int imgfmt)
+{
+    struct priv *p = ctx->priv;
+
+    return gl_video_check_format(p->renderers[0], imgfmt);
+}
+
+static int set_parameter(struct render_backend *ctx, mpv_render_param param)
+{
+    struct priv *p = ctx->priv;
+
+    switch (param.type) {
+    case MPV_RENDER_PARAM_ICC_PROFILE: {
+        mpv_byte_array *data = param.data;
+        bstr icc = {data->data, data->size};
+        talloc_free(p->icc_profile.start);
+        p->icc_profile = bstrdup(p, icc);
+        for (int n = 0; n < MP_RENDER_MAX_VIEWS; n++) {
+            if (p->renderers[n])
+                gl_video_set_icc_profile(p->renderers[n], bstrdup(NULL, icc));
+        }
+        return 0;
+    }
+    case MPV_RENDER_PARAM_AMBIENT_LIGHT: {
+        int lux = *(int *)param.data;
+        p->ambient_lux = lux;
+        p->ambient_lux_set = true;
+        for (int n = 0; n < MP_RENDER_MAX_VIEWS; n++) {
+            if (p->renderers[n])
+                gl_video_set_ambient_lux(p->renderers[n], lux);
+        }
+        return 0;
+    }
+    default:
+        return MPV_ERROR_NOT_IMPLEMENTED;
+    }
+}
+
+static void reconfig(struct render_backend *ctx, int view,
+                     struct mp_image_params *params)
+{
+    gl_video_config(get_renderer(ctx, view), params);
+}
+
+static void reset(struct render_backend *ctx, int view)
+{
+    gl_video_reset(get_renderer(ctx, view));
+}
+
+static void update_external(struct render_backend *ctx, int view,
+                            struct vo *vo)
+{
+    struct gl_video *renderer = get_renderer(ctx, view);
+
+    gl_video_set_osd_source(renderer, vo ? vo->osd : NULL);
+    // All views are fed from the same queue; the main view configures it.
+    if (vo && view == 0)
+        gl_video_configure_queue(renderer, vo);
+}
+
+static void resize(struct render_backend *ctx, int view, struct mp_rect *src,
+                   struct mp_rect *dst, struct mp_osd_res *osd)
+{
+    gl_video_resize(get_renderer(ctx, view), src, dst, osd);
+}
+
+static int get_target_size(struct render_backend *ctx, mpv_render_param *params,
+                           int *out_w, int *out_h)
+{
+    struct priv *p = ctx->priv;
+
+    // Mapping the surface is cheap, better than adding new backend entrypoints.
+    struct ra_tex *tex;
+    int err = p->context->fns->wrap_fbo(p->context, params, &tex);
+    if (err < 0)
+        return err;
+    *out_w = tex->params.w;
+    *out_h = tex->params.h;
+    return 0;
+}
+
+static int render(struct render_backend *ctx, int view,
+                  mpv_render_param *params, struct vo_frame *frame)
+{
+    struct priv *p = ctx->priv;
+    struct gl_video *renderer = get_renderer(ctx, view);
+
+    // Mandatory parameters.
+    struct ra_tex *tex;
+    int err = p->context->fns->wrap_fbo(p->context, params, &tex);
+    if (err < 0)
+        return err;
+
+    int depth = GET_MPV_RENDER_PARAM(params, MPV_RENDER_PARAM_DEPTH, int, 0);
+    gl_video_set_fb_depth(renderer, depth);
+
+    bool flip = GET_MPV_RENDER_PARAM(params, MPV_RENDER_PARAM_FLIP_Y, int, 0);
+
+    struct ra_fbo target = {.tex = tex, .flip = flip};
+    gl_video_render_frame(renderer, frame, target);
+
+    p->context->fns->done_frame(p->context, frame->display_synced);
+
+    return 0;
+}
+
+static struct mp_image *get_image(struct render_backend *ctx, int imgfmt,
+                                  int w, int h, int stride_align)
+{
+    struct priv *p = ctx->priv;
+
+    return gl_video_get_image(p->renderers[0], imgfmt, w, h, stride_align);
+}
+
+static void destroy(struct render_backend *ctx)
+{
+    struct priv *p = ctx->priv;
+
+    // The additional views reference the main view's textures and hwdecs.
+    for (int n = MP_RENDER_MAX_VIEWS - 1; n >= 0; n--)
+        gl_video_uninit(p->renderers[n]);
+
+    hwdec_devices_destroy(ctx->hwdec_devs);
+
+    if (p->context) {
+        p->context->fns->destroy(p->context);
+        talloc_free(p->context->priv);
+        talloc_free(p->context);
+    }
+}
+
+const struct render_backend_fns render_backend_gpu = {
+    .init = init,
+    .check_format = check_format,
+    .set_parameter = set_parameter,
+    .reconfig = reconfig,
+    .reset = reset,
+    .update_external = update_external,
+    .resize = resize,
+    .get_target_size = get_target_size,
+    .render = render,
+    .get_image = get_image,
+    .destroy = destroy,
+};
@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <limits.h>
+#include <string.h>
 
 #include <libavutil/common.h>
 
@@ -49,16 +50,28 @@ static const struct ra_renderpass_input vertex_vao[] = {
     {"ass_color", RA_VARTYPE_BYTE_UNORM, 4, 1, offsetof(struct vertex, ass_color)},
 };
 
+// Granularity (in pixels) at which changed texture regions are detected.
+#define OSD_TILE_W 256
+#define OSD_TILE_H 32
+
 struct mpgl_osd_part {
     enum sub_bitmap_format format;
     int change_id;
     struct ra_tex *texture;
     int w, h;
+    // Copy of the texture contents, used to upload changed regions only.
+    uint8_t *shadow;
+    int shadow_stride;
+    bool shadow_valid;
     int num_subparts;
     int prev_num_subparts;
     struct sub_bitmap *subparts;
+    bool subparts_valid;    // subparts is a copy of the images for change_id
     int num_vertices;
     struct vertex *vertices;
+    // Transforms the vertices were generated with (valid if num_vert_t > 0).
+    struct gl_transform vert_t[4];
+    int num_vert_t;
 };
 
 struct mpgl_osd {
@@ -120,6 +133,78 @@ static int next_pow2(int v)
     return INT_MAX;
 }
 
+static bool upload_rect(struct mpgl_osd *ctx, struct mpgl_osd_part *osd,
+                        struct sub_bitmaps *imgs, struct mp_rect rc)
+{
+    struct ra *ra = ctx->ra;
+    int bpp = osd->texture->params.format->pixel_size;
+
+    struct ra_tex_upload_params params = {
+        .tex = osd->texture,
+        .src = (uint8_t *)imgs->packed->planes[0] +
+               rc.y0 * imgs->packed->stride[0] + rc.x0 * bpp,
+        .rc = &rc,
+        .stride = imgs->packed->stride[0],
+    };
+
+    if (!ra->fns->tex_upload(ra, &params))
+        return false;
+
+    // Keep the shadow copy in sync with the texture.
+    memcpy_pic(osd->shadow + rc.y0 * osd->shadow_stride + rc.x0 * bpp,
+               params.src, (rc.x1 - rc.x0) * bpp, rc.y1 - rc.y0,
+               osd->shadow_stride, imgs->packed->stride[0]);
+    return true;
+}
+
+// Return whether the given region of the packed image differs from the data
+// that was uploaded last.
+static bool region_changed(struct mpgl_osd_part *osd, struct sub_bitmaps *imgs,
+                           int x0, int y0, int x1, int y1, int bpp)
+{
+    for (int y = y0; y < y1; y++) {
+        uint8_t *src = (uint8_t *)imgs->packed->planes[0] +
+                       y * imgs->packed->stride[0] + x0 * bpp;
+        uint8_t *dst = osd->shadow + y * osd->shadow_stride + x0 * bpp;
+        if (memcmp(src, dst, (x1 - x0) * bpp))
+            return true;
+    }
+    return false;
+}
+
+// Upload only the tiles that changed since the last upload. For each row of
+// tiles, adjacent changed tiles are merged into a single upload.
+static bool upload_changed(struct mpgl_osd *ctx, struct mpgl_osd_part *osd,
+                           struct sub_bitmaps *imgs)
+{
+    int bpp = osd->texture->params.format->pixel_size;
+    int w = imgs->packed_w, h = imgs->packed_h;
+
+    for (int y = 0; y < h; y += OSD_TILE_H) {
+        int y1 = MPMIN(y + OSD_TILE_H, h);
+        int run_start = -1;
+        for (int x = 0; x <= w; x += OSD_TILE_W) {
+            int x1 = MPMIN(x + OSD_TILE_W, w);
+            bool changed = x < w && region_changed(osd, imgs, x, y, x1, y1, bpp);
+            if (changed && run_start < 0)
+                run_start = x;
+            if (!changed && run_start >= 0) {
+                struct mp_rect rc = {run_start, y, x, y1};
+                if (!upload_rect(ctx, osd, imgs, rc))
+                    return false;
+                run_start = -1;
+            }
+        }
+        if (run_start >= 0) {
+            struct mp_rect rc = {run_start, y, w, y1};
+            if (!upload_rect(ctx, osd, imgs, rc))
+                return false;
+        }
+    }
+
+    return true;
+}
+
 static bool upload_osd(struct mpgl_osd *ctx, struct mpgl_osd_part *osd,
                        struct sub_bitmaps *imgs)
 {
@@ -165,17 +250,20 @@ static bool upload_osd(struct mpgl_osd *ctx, struct mpgl_osd_part *osd,
         osd->texture = ra_tex_create(ra, &params);
         if (!osd->texture)
             goto done;
-    }
 
-    struct ra_tex_upload_params params = {
-        .tex = osd->texture,
-        .src = imgs->packed->planes[0],
-        .invalidate = true,
-        .rc = &(struct mp_rect){0, 0, imgs->packed_w, imgs->packed_h},
-        .stride = imgs->packed->stride[0],
-    };
+        talloc_free(osd->shadow);
+        osd->shadow_stride = osd->w * fmt->pixel_size;
+        osd->shadow = talloc_size(osd, osd->shadow_stride * osd->h);
+        osd->shadow_valid = false;
+    }
 
-    ok = ra->fns->tex_upload(ra, &params);
+    if (osd->shadow_valid) {
+        ok = upload_changed(ctx, osd, imgs);
+    } else {
+        ok = upload_rect(ctx, osd, imgs,
+                         (struct mp_rect){0, 0, imgs->packed_w, imgs->packed_h});
+    }
+    osd->shadow_valid = ok;
 
 done:
     return ok;
@@ -196,13 +284,19 @@ static void gen_osd_cb(void *pctx, struct sub_bitmaps *imgs)
             ok = false;
 
         osd->change_id = imgs->change_id;
+        osd->subparts_valid = false;
         ctx->change_flag = true;
     }
     osd->num_subparts = ok ? imgs->num_parts : 0;
 
-    MP_TARRAY_GROW(osd, osd->subparts, osd->num_subparts);
-    memcpy(osd->subparts, imgs->parts,
-           osd->num_subparts * sizeof(osd->subparts[0]));
+    // Unchanged images (same change_id) need neither a copy nor new vertices.
+    if (!osd->subparts_valid) {
+        MP_TARRAY_GROW(osd, osd->subparts, osd->num_subparts);
+        memcpy(osd->subparts, imgs->parts,
+               osd->num_subparts * sizeof(osd->subparts[0]));
+        osd->subparts_valid = ok;
+        osd->num_vert_t = 0;
+    }
 }
 
 bool mpgl_osd_draw_prepare(struct mpgl_osd *ctx, int index,
@@ -295,8 +389,8 @@ void mpgl_osd_draw_finish(struct mpgl_osd *ctx, int index,
     int div[2];
     get_3d_side_by_side(ctx->stereo_mode, div);
 
-    part->num_vertices = 0;
-
+    struct gl_transform ts[4];
+    int num_t = 0;
     for (int x = 0; x < div[0]; x++) {
         for (int y = 0; y < div[1]; y++) {
             struct gl_transform t;
@@ -307,10 +401,20 @@ void mpgl_osd_draw_finish(struct mpgl_osd *ctx, int index,
             t.t[0] += a_x * t.m[0][0] + a_y * t.m[1][0];
             t.t[1] += a_x * t.m[0][1] + a_y * t.m[1][1];
 
-            generate_verts(part, t);
+            ts[num_t++] = t;
         }
     }
 
+    if (num_t != part->num_vert_t ||
+        memcmp(ts, part->vert_t, num_t * sizeof(ts[0])) != 0)
+    {
+        part->num_vertices = 0;
+        for (int n = 0; n < num_t; n++)
+            generate_verts(part, ts[n]);
+        memcpy(part->vert_t, ts, num_t * sizeof(ts[0]));
+        part->num_vert_t = num_t;
+    }
+
     const int *factors = &blend_factors[part->format][0];
     gl_sc_blend(sc, factors[0], factors[1], factors[2], factors[3]);
 
@@ -1,18 +1,27 @@
 #include "common/common.h"
 #include "common/msg.h"
+#include "common/stats.h"
 #include "video/img_format.h"
 
 #include "ra.h"
 
 struct ra_tex *ra_tex_create(struct ra *ra, const struct ra_tex_params *params)
 {
-    return ra->fns->tex_create(ra, params);
+    struct ra_tex *tex = ra->fns->tex_create(ra, params);
+    if (tex) {
+        tex->mem_size = (size_t)params->w * MPMAX(params->h, 1) *
+                        MPMAX(params->d, 1) * params->format->pixel_size;
+        mp_mem_account(MP_MEM_GPU_TEXTURES, tex->mem_size);
+    }
+    return tex;
 }
 
 void ra_tex_free(struct ra *ra, struct ra_tex **tex)
 {
-    if (*tex)
+    if (*tex) {
+        mp_mem_account(MP_MEM_GPU_TEXTURES, -(int64_t)(*tex)->mem_size);
         ra->fns->tex_destroy(ra, *tex);
+    }
     *tex = NULL;
 }
 
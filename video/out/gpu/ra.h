@@ -26,6 +26,10 @@ struct ra {
     // time.
     size_t max_shmem;
 
+    // Maximum number of threads (invocations) in a compute shader work group.
+    // Set by the RA backend at init time.
+    int max_compute_group_threads;
+
     // Maximum push constant size. Set by the RA backend at init time.
     size_t max_pushc_size;
 
@@ -134,6 +138,8 @@ struct ra_tex {
     // All fields are read-only after creation.
     struct ra_tex_params params;
     void *priv;
+    // Set by ra_tex_create() for memory accounting (0 for wrapped textures).
+    size_t mem_size;
 };
 
 struct ra_tex_upload_params {
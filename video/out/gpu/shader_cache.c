@@ -4,13 +4,23 @@
 #include <string.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <unistd.h>
 
 #include <libavutil/sha.h>
 #include <libavutil/mem.h>
 
+#include "config.h"
+
 #include "osdep/io.h"
 
+#if HAVE_POSIX
+#include <utime.h>
+#endif
+
 #include "common/common.h"
+#include "misc/ctype.h"
 #include "options/path.h"
 #include "stream/stream.h"
 #include "shader_cache.h"
@@ -57,6 +67,8 @@ struct sc_entry {
     struct timer_pool *timer;
     struct ra_buf *ubo;
     int ubo_index; // for ra_renderpass_input_val.index
+    void *ubo_data; // CPU copy of the UBO contents
+    size_t ubo_dirty_start, ubo_dirty_end; // range not yet uploaded to ubo
     void *pushc;
 };
 
@@ -100,11 +112,17 @@ struct gl_shader_cache {
 
     bool error_state; // true if an error occurred
 
+    // See gl_sc_set_compile_limit()
+    int compile_limit;
+    int num_compiled;
+    bool compile_deferred;
+
     // temporary buffers (avoids frequent reallocations)
     bstr tmp[6];
 
     // For the disk-cache.
     char *cache_dir;
+    int64_t cache_max_size; // in bytes, 0 means unlimited
     struct mpv_global *global; // can be NULL
 };
 
@@ -470,18 +488,38 @@ static const char *vao_glsl_type(const struct ra_renderpass_input *e)
     }
 }
 
-static void update_ubo(struct ra *ra, struct ra_buf *ubo, struct sc_uniform *u)
+// Only updates the CPU copy of the UBO; see flush_ubo().
+static void update_ubo(struct sc_entry *e, struct sc_uniform *u)
 {
     uintptr_t src = (uintptr_t) &u->v;
-    size_t dst = u->offset;
+    uintptr_t dst = (uintptr_t) e->ubo_data + (ptrdiff_t) u->offset;
     struct ra_layout src_layout = ra_renderpass_input_layout(&u->input);
     struct ra_layout dst_layout = u->layout;
 
     for (int i = 0; i < u->input.dim_m; i++) {
-        ra->fns->buf_update(ra, ubo, dst, (void *)src, src_layout.stride);
+        memcpy((void *)dst, (void *)src, src_layout.stride);
         src += src_layout.stride;
         dst += dst_layout.stride;
     }
+
+    e->ubo_dirty_start = MPMIN(e->ubo_dirty_start, u->offset);
+    e->ubo_dirty_end = MPMAX(e->ubo_dirty_end, u->offset + u->layout.size);
+}
+
+// Upload all changed UBO contents with a single buf_update call.
+static void flush_ubo(struct ra *ra, struct sc_entry *e)
+{
+    if (e->ubo_dirty_start >= e->ubo_dirty_end)
+        return;
+
+    // ra_buf.buf_update requires 4 byte alignment for the offset and size
+    size_t start = e->ubo_dirty_start & ~(size_t)3;
+    size_t end = MPMIN(MP_ALIGN_UP(e->ubo_dirty_end, 4), e->ubo->params.size);
+    ra->fns->buf_update(ra, e->ubo, start, (char *)e->ubo_data + start,
+                        end - start);
+
+    e->ubo_dirty_start = SIZE_MAX;
+    e->ubo_dirty_end = 0;
 }
 
 static void update_pushc(struct ra *ra, void *pushc, struct sc_uniform *u)
@@ -527,7 +565,7 @@ static void update_uniform(struct gl_shader_cache *sc, struct sc_entry *e,
     }
     case SC_UNIFORM_TYPE_UBO:
         assert(e->ubo);
-        update_ubo(sc->ra, e->ubo, u);
+        update_ubo(e, u);
         break;
     case SC_UNIFORM_TYPE_PUSHC:
         assert(e->pushc);
@@ -537,10 +575,94 @@ static void update_uniform(struct gl_shader_cache *sc, struct sc_entry *e,
     }
 }
 
-void gl_sc_set_cache_dir(struct gl_shader_cache *sc, const char *dir)
+void gl_sc_set_compile_limit(struct gl_shader_cache *sc, int limit)
+{
+    sc->compile_limit = limit;
+    sc->num_compiled = 0;
+    sc->compile_deferred = false;
+}
+
+bool gl_sc_compile_deferred(struct gl_shader_cache *sc)
+{
+    return sc->compile_deferred;
+}
+
+void gl_sc_set_cache_dir(struct gl_shader_cache *sc, const char *dir,
+                         int64_t max_size)
 {
     talloc_free(sc->cache_dir);
     sc->cache_dir = talloc_strdup(sc, dir);
+    sc->cache_max_size = max_size;
+}
+
+// Cache file names are the hex-encoded SHA-256 of the cache key. Only files
+// following this pattern are considered for eviction, so that unrelated files
+// in the cache directory are never deleted.
+static bool is_cache_filename(const char *name)
+{
+    if (strlen(name) != 256 / 8 * 2)
+        return false;
+    for (int n = 0; name[n]; n++) {
+        if (!mp_isdigit(name[n]) && !(name[n] >= 'A' && name[n] <= 'F'))
+            return false;
+    }
+    return true;
+}
+
+struct sc_cache_file {
+    char *path;
+    int64_t size;
+    time_t mtime;
+};
+
+static int compare_cache_file(const void *pa, const void *pb)
+{
+    const struct sc_cache_file *a = pa, *b = pb;
+    return a->mtime > b->mtime ? 1 : (a->mtime < b->mtime ? -1 : 0);
+}
+
+// Delete the least recently used cache files until the total size of the
+// cache directory is below the configured limit. Cache hits refresh the mtime
+// of the file (where supported), so this approximates LRU eviction.
+static void sc_prune_disk_cache(struct gl_shader_cache *sc, const char *dir)
+{
+    if (sc->cache_max_size <= 0)
+        return;
+
+    void *tmp = talloc_new(NULL);
+    struct sc_cache_file *files = NULL;
+    int num_files = 0;
+    int64_t total = 0;
+
+    DIR *d = opendir(dir);
+    if (!d)
+        goto done;
+    struct dirent *ep;
+    while ((ep = readdir(d))) {
+        if (!is_cache_filename(ep->d_name))
+            continue;
+        char *path = mp_path_join(tmp, dir, ep->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+        struct sc_cache_file f = {path, st.st_size, st.st_mtime};
+        MP_TARRAY_APPEND(tmp, files, num_files, f);
+        total += f.size;
+    }
+    closedir(d);
+
+    if (total <= sc->cache_max_size)
+        goto done;
+
+    qsort(files, num_files, sizeof(files[0]), compare_cache_file);
+    for (int n = 0; n < num_files && total > sc->cache_max_size; n++) {
+        MP_DBG(sc, "Evicting shader cache file: %s\n", files[n].path);
+        if (unlink(files[n].path) == 0)
+            total -= files[n].size;
+    }
+
+done:
+    talloc_free(tmp);
 }
 
 static bool create_pass(struct gl_shader_cache *sc, struct sc_entry *entry)
@@ -550,7 +672,7 @@ static bool create_pass(struct gl_shader_cache *sc, struct sc_entry *entry)
     void *tmp = talloc_new(NULL);
     struct ra_renderpass_params params = sc->params;
 
-    const char *cache_header = "mpv shader cache v1\n";
+    const char *cache_header = "mpv shader cache v2\n";
     char *cache_filename = NULL;
     char *cache_dir = NULL;
 
@@ -564,6 +686,16 @@ static bool create_pass(struct gl_shader_cache *sc, struct sc_entry *entry)
         av_sha_init(sha, 256);
         av_sha_update(sha, entry->total.start, entry->total.len);
 
+        // The compiled program blobs are only valid for the same kind of
+        // backend, so make the RA configuration part of the cache key too.
+        char *ra_key = talloc_asprintf(tmp, "ra glsl=%d es=%d vk=%d caps=%"
+                                       PRIx64 " pushc=%zu shmem=%zu\n",
+                                       sc->ra->glsl_version, sc->ra->glsl_es,
+                                       sc->ra->glsl_vulkan, sc->ra->caps,
+                                       sc->ra->max_pushc_size,
+                                       sc->ra->max_shmem);
+        av_sha_update(sha, ra_key, strlen(ra_key));
+
         uint8_t hash[256 / 8];
         av_sha_final(sha, hash);
         av_free(sha);
@@ -577,8 +709,13 @@ static bool create_pass(struct gl_shader_cache *sc, struct sc_entry *entry)
             MP_DBG(sc, "Trying to load shader from disk...\n");
             struct bstr cachedata =
                 stream_read_file(cache_filename, tmp, sc->global, 1000000000);
-            if (bstr_eatstart0(&cachedata, cache_header))
+            if (bstr_eatstart0(&cachedata, cache_header)) {
                 params.cached_program = cachedata;
+#if HAVE_POSIX
+                // Mark as recently used for sc_prune_disk_cache().
+                utime(cache_filename, NULL);
+#endif
+            }
         }
     }
 
@@ -613,6 +750,10 @@ static bool create_pass(struct gl_shader_cache *sc, struct sc_entry *entry)
             MP_ERR(sc, "Failed creating uniform buffer!\n");
             goto error;
         }
+
+        entry->ubo_data = talloc_zero_size(entry, sc->ubo_size);
+        entry->ubo_dirty_start = SIZE_MAX;
+        entry->ubo_dirty_end = 0;
     }
 
     entry->pass = sc->ra->fns->renderpass_create(sc->ra, &params);
@@ -631,6 +772,8 @@ static bool create_pass(struct gl_shader_cache *sc, struct sc_entry *entry)
                 fwrite(nc.start, nc.len, 1, out);
                 fclose(out);
             }
+
+            sc_prune_disk_cache(sc, cache_dir);
         }
     }
 
@@ -899,7 +1042,18 @@ static void gl_sc_generate(struct gl_shader_cache *sc,
             break;
         }
     }
+    if (!entry && sc->compile_limit > 0 &&
+        sc->num_compiled >= sc->compile_limit)
+    {
+        // Over budget; the caller is expected to render something cheaper
+        // and retry later. This is not an error.
+        MP_DBG(sc, "deferring shader compilation\n");
+        sc->compile_deferred = true;
+        sc->current_shader = NULL;
+        return;
+    }
     if (!entry) {
+        sc->num_compiled++;
         if (sc->num_entries == SC_MAX_ENTRIES)
             sc_flush_cache(sc);
         entry = talloc_ptrtype(NULL, entry);
@@ -949,6 +1103,7 @@ static void gl_sc_generate(struct gl_shader_cache *sc,
 
     // If we're using a UBO, make sure to bind it as well
     if (sc->ubo_size) {
+        flush_ubo(sc->ra, entry);
         struct ra_renderpass_input_val ubo_val = {
             .index = entry->ubo_index,
             .data = &entry->ubo,
@@ -59,4 +59,11 @@ struct mp_pass_perf gl_sc_dispatch_compute(struct gl_shader_cache *sc,
 // The application can call this on errors, to reset the current shader. This
 // is normally done implicitly by gl_sc_dispatch_*
 void gl_sc_reset(struct gl_shader_cache *sc);
-void gl_sc_set_cache_dir(struct gl_shader_cache *sc, const char *dir);
+// Limit the number of new shaders that may be compiled until the next call of
+// this function (0 means no limit). Dispatches that would require compiling
+// a shader beyond the limit are skipped, and gl_sc_compile_deferred() returns
+// true. This does not set the error state.
+void gl_sc_set_compile_limit(struct gl_shader_cache *sc, int limit);
+bool gl_sc_compile_deferred(struct gl_shader_cache *sc);
+void gl_sc_set_cache_dir(struct gl_shader_cache *sc, const char *dir,
+                         int64_t max_size);
@@ -76,3 +76,46 @@ bool spirv_compiler_init(struct ra_ctx *ctx)
     MP_ERR(ctx, "Failed initializing SPIR-V compiler!\n");
     return false;
 }
+
+// Number of compiled shaders kept in memory. Many passes share the same vertex
+// shader, and passes are recreated with the same source e.g. when the
+// renderer is reinitialized.
+#define SPIRV_CACHE_SIZE 64
+
+struct spirv_cache_entry {
+    enum glsl_shader type;
+    bstr glsl;
+    bstr spirv;
+};
+
+bool spirv_compile_glsl(struct spirv_compiler *spirv, void *tactx,
+                        enum glsl_shader type, const char *glsl,
+                        struct bstr *out_spirv)
+{
+    bstr src = bstr0(glsl);
+    for (int n = spirv->num_cache - 1; n >= 0; n--) {
+        struct spirv_cache_entry *e = spirv->cache[n];
+        if (e->type == type && bstr_equals(e->glsl, src)) {
+            MP_TARRAY_REMOVE_AT(spirv->cache, spirv->num_cache, n);
+            MP_TARRAY_APPEND(spirv, spirv->cache, spirv->num_cache, e);
+            *out_spirv = bstrdup(tactx, e->spirv);
+            return true;
+        }
+    }
+
+    if (!spirv->fns->compile_glsl(spirv, tactx, type, glsl, out_spirv))
+        return false;
+
+    if (spirv->num_cache >= SPIRV_CACHE_SIZE) {
+        talloc_free(spirv->cache[0]);
+        MP_TARRAY_REMOVE_AT(spirv->cache, spirv->num_cache, 0);
+    }
+    struct spirv_cache_entry *e = talloc_ptrtype(spirv, e);
+    *e = (struct spirv_cache_entry){
+        .type = type,
+        .glsl = bstrdup(e, src),
+        .spirv = bstrdup(e, *out_spirv),
+    };
+    MP_TARRAY_APPEND(spirv, spirv->cache, spirv->num_cache, e);
+    return true;
+}
@@ -22,6 +22,10 @@ struct spirv_compiler {
     int glsl_version;         // GLSL version supported
     int compiler_version;     // for cache invalidation, may be left as 0
     int ra_caps;              // RA_CAP_* provided by this implementation, if any
+
+    // Private to spirv.c: recently compiled shaders (see spirv_compile_glsl())
+    struct spirv_cache_entry **cache;
+    int num_cache;
 };
 
 struct spirv_compiler_fns {
@@ -39,3 +43,10 @@ struct spirv_compiler_fns {
 // Initializes ctx->spirv to a valid SPIR-V compiler, or returns false on
 // failure. Cleanup will be handled by ra_ctx_destroy.
 bool spirv_compiler_init(struct ra_ctx *ctx);
+
+// Compile GLSL to SPIR-V with spirv->fns->compile_glsl, reusing the result of
+// a previous compilation of the same source if possible. The result is
+// allocated under tactx.
+bool spirv_compile_glsl(struct spirv_compiler *spirv, void *tactx,
+                        enum glsl_shader type, const char *glsl,
+                        struct bstr *out_spirv);
@@ -159,6 +159,40 @@ done:
     return true;
 }
 
+bool szexpr_uses_tex(struct szexp expr[MAX_SZEXP_SIZE], struct bstr name)
+{
+    for (int i = 0; i < MAX_SZEXP_SIZE && expr[i].tag != SZEXP_END; i++) {
+        if ((expr[i].tag == SZEXP_VAR_W || expr[i].tag == SZEXP_VAR_H) &&
+            bstr_equals(expr[i].val.varname, name))
+            return true;
+    }
+    return false;
+}
+
+static bool no_lookup(void *priv, struct bstr var, float size[2])
+{
+    return false;
+}
+
+bool szexpr_fold_const(struct mp_log *log, struct szexp expr[MAX_SZEXP_SIZE],
+                       float *result)
+{
+    for (int i = 0; i < MAX_SZEXP_SIZE && expr[i].tag != SZEXP_END; i++) {
+        if (expr[i].tag == SZEXP_VAR_W || expr[i].tag == SZEXP_VAR_H)
+            return false;
+    }
+
+    float res;
+    if (!eval_szexpr(log, NULL, no_lookup, expr, &res))
+        return false;
+
+    for (int i = 0; i < MAX_SZEXP_SIZE; i++)
+        expr[i] = (struct szexp){0};
+    expr[0] = (struct szexp){ SZEXP_CONST, { .cval = res }};
+    *result = res;
+    return true;
+}
+
 static bool parse_hook(struct mp_log *log, struct bstr *body,
                        struct gl_user_shader_hook *out)
 {
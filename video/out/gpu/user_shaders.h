@@ -93,4 +93,12 @@ bool eval_szexpr(struct mp_log *log, void *priv,
                  bool (*lookup)(void *priv, struct bstr var, float size[2]),
                  struct szexp expr[MAX_SZEXP_SIZE], float *result);
 
+// Returns whether the szexp looks up the size of the named texture.
+bool szexpr_uses_tex(struct szexp expr[MAX_SZEXP_SIZE], struct bstr name);
+
+// If the szexp doesn't depend on any texture sizes, evaluate it, replace it
+// with the resulting constant, and return true.
+bool szexpr_fold_const(struct mp_log *log, struct szexp expr[MAX_SZEXP_SIZE],
+                       float *result);
+
 #endif
@@ -42,6 +42,7 @@
 #include "video/out/aspect.h"
 #include "video/out/dither.h"
 #include "video/out/vo.h"
+#include "video/fmt-conversion.h"
 
 // scale/cscale arguments that map directly to shader filter routines.
 // Note that the convolution filters are not included in this list.
@@ -74,9 +75,11 @@ struct texplane {
 
 struct video_image {
     struct texplane planes[4];
+    struct texplane packed;     // raw texture if p->packed is used
     struct mp_image *mpi;       // original input image
     uint64_t id;                // unique ID identifying mpi contents
     bool hwdec_mapped;
+    bool shared;                // planes are owned by p->upload_source
 };
 
 enum plane_type {
@@ -125,6 +128,9 @@ struct tex_hook {
     void (*hook)(struct gl_video *p, struct image img, // generates GLSL
                  struct gl_transform *trans, void *priv);
     bool (*cond)(struct gl_video *p, struct image img, void *priv);
+    // Optional. Returns whether the hook looks at the size of the named
+    // texture (e.g. in its condition), which makes it a user of the texture.
+    bool (*uses_tex)(void *priv, const char *name);
 };
 
 struct surface {
@@ -135,6 +141,19 @@ struct surface {
 
 #define SURFACES_MAX 10
 
+// Number of calls to pass_render_frame() after which an intermediate texture
+// that was not rendered to is considered unused and gets freed.
+#define PASS_TEX_MAX_IDLE 100
+
+// Maximum number of 2x box reduction passes before the main scaler
+#define PREREDUCE_MAX 8
+
+struct pass_tex_usage {
+    struct ra_tex *tex;
+    uint64_t last_used;
+    bool seen;
+};
+
 struct cached_file {
     char *path;
     struct bstr body;
@@ -173,6 +192,7 @@ struct gl_video {
 
     struct ra_tex *lut_3d_texture;
     bool use_lut_3d;
+    bool lut_3d_pending;
     int lut_3d_size[3];
 
     struct ra_tex *dither_texture;
@@ -182,6 +202,11 @@ struct gl_video {
     struct ra_imgfmt_desc ra_format;            // texture format
     int plane_count;
 
+    // For formats uploaded as single integer texture and unpacked by a shader;
+    // ra_format then describes the planes after unpacking.
+    struct mp_packed_imgfmt packed;             // layout is 0 if unused
+    const struct ra_format *packed_format;      // raw texture format
+
     bool is_gray;
     bool has_alpha;
     char color_swizzle[5];
@@ -197,6 +222,10 @@ struct gl_video {
     bool dumb_mode;
     bool forced_dumb_mode;
 
+    bool deint_requested;       // see gl_video_set_deinterlace()
+    bool deint_active;          // deinterlace the current frame
+    uint64_t deint_last_id;     // video_image.id of deint_last_tex
+
     // Cached vertex array, to avoid re-allocation per frame. For simplicity,
     // our vertex format is simply a list of `vertex_pt`s, since this greatly
     // simplifies offset calculation at the cost of (unneeded) flexibility.
@@ -208,15 +237,25 @@ struct gl_video {
     struct ra_tex *merge_tex[4];
     struct ra_tex *scale_tex[4];
     struct ra_tex *integer_tex[4];
+    struct ra_tex *unpack_tex[4];
     struct ra_tex *indirect_tex;
+    struct ra_tex *prereduce_tex[PREREDUCE_MAX];
     struct ra_tex *blend_subs_tex;
     struct ra_tex *screen_tex;
     struct ra_tex *output_tex;
     struct ra_tex *vdpau_deinterleave_tex[2];
+    struct ra_tex *deint_tex[4];        // deinterlaced planes
+    struct ra_tex *deint_last_tex[4];   // planes of the last new frame
+    struct ra_tex *deint_prev_tex[4];   // planes of the frame before that
     struct ra_tex **hook_textures;
     int num_hook_textures;
     int idx_hook_textures;
 
+    // when the intermediate textures were last rendered to, see gc_pass_tex()
+    struct pass_tex_usage *pass_tex_usage;
+    int num_pass_tex_usage;
+    uint64_t pass_render_count;
+
     struct ra_buf *hdr_peak_ssbo;
     struct surface surfaces[SURFACES_MAX];
 
@@ -230,6 +269,7 @@ struct gl_video {
     int surface_now;
     int frames_drawn;
     bool is_interpolated;
+    bool compile_pending;
     bool output_tex_valid;
 
     // state for configured scalers
@@ -278,8 +318,16 @@ struct gl_video {
     int num_files;
 
     bool hwdec_interop_loading_done;
+    // Interop drivers for which loading was attempted (for lazy loading).
+    const struct ra_hwdec_driver **hwdec_drivers_tried;
+    int num_hwdec_drivers_tried;
     struct ra_hwdec **hwdecs;
     int num_hwdecs;
+    bool hwdecs_borrowed;       // hwdecs are owned by upload_source
+
+    // If set, reuse the frames uploaded by this instance (see
+    // gl_video_set_upload_source()).
+    struct gl_video *upload_source;
 
     struct ra_hwdec_mapper *hwdec_mapper;
     struct ra_hwdec *hwdec_overlay;
@@ -318,6 +366,7 @@ static const struct gl_video_opts gl_video_opts_def = {
     .tone_mapping_desat = 1.0,
     .early_flush = -1,
     .hwdec_interop = "auto",
+    .shader_cache_size = 128 * 1024 * 1024,
 };
 
 static int validate_scaler_opt(struct mp_log *log, const m_option_t *opt,
@@ -401,11 +450,14 @@ const struct m_sub_options gl_video_conf = {
         OPT_CLI_ALIAS("glsl-shader", "glsl-shaders-append"),
         OPT_FLAG("deband", deband, 0),
         OPT_SUBSTRUCT("deband", deband_opts, deband_conf, 0),
+        OPT_FLAG("gpu-deinterlace", deinterlace, 0),
         OPT_FLOAT("sharpen", unsharp, 0),
         OPT_INTRANGE("gpu-tex-pad-x", tex_pad_x, 0, 0, 4096),
         OPT_INTRANGE("gpu-tex-pad-y", tex_pad_y, 0, 0, 4096),
         OPT_SUBSTRUCT("", icc_opts, mp_icc_conf, 0),
         OPT_STRING("gpu-shader-cache-dir", shader_cache_dir, 0),
+        OPT_INTRANGE("gpu-shader-cache-size", shader_cache_size, 0, 0, INT_MAX),
+        OPT_INTRANGE("gpu-shader-compile-limit", shader_compile_limit, 0, 0, 1000),
         OPT_STRING_VALIDATE("gpu-hwdec-interop", hwdec_interop, 0,
                              ra_hwdec_validate_opt),
         OPT_REPLACED("opengl-hwdec-interop", "gpu-hwdec-interop"),
@@ -516,9 +568,16 @@ static void uninit_rendering(struct gl_video *p)
         ra_tex_free(p->ra, &p->merge_tex[n]);
         ra_tex_free(p->ra, &p->scale_tex[n]);
         ra_tex_free(p->ra, &p->integer_tex[n]);
+        ra_tex_free(p->ra, &p->unpack_tex[n]);
+        ra_tex_free(p->ra, &p->deint_tex[n]);
+        ra_tex_free(p->ra, &p->deint_last_tex[n]);
+        ra_tex_free(p->ra, &p->deint_prev_tex[n]);
     }
+    p->deint_last_id = 0;
 
     ra_tex_free(p->ra, &p->indirect_tex);
+    for (int n = 0; n < PREREDUCE_MAX; n++)
+        ra_tex_free(p->ra, &p->prereduce_tex[n]);
     ra_tex_free(p->ra, &p->blend_subs_tex);
     ra_tex_free(p->ra, &p->screen_tex);
     ra_tex_free(p->ra, &p->output_tex);
@@ -529,6 +588,8 @@ static void uninit_rendering(struct gl_video *p)
     for (int n = 0; n < p->num_hook_textures; n++)
         ra_tex_free(p->ra, &p->hook_textures[n]);
 
+    p->num_pass_tex_usage = 0;
+
     for (int n = 0; n < 2; n++)
         ra_tex_free(p->ra, &p->vdpau_deinterleave_tex[n]);
 
@@ -587,11 +648,18 @@ static bool gl_video_get_lut3d(struct gl_video *p, enum mp_csp_prim prim,
     }
 
     struct lut3d *lut3d = NULL;
-    if (!fmt || !gl_lcms_get_lut3d(p->cms, &lut3d, prim, trc, icc) || !lut3d) {
-        p->use_lut_3d = false;
+    bool pending = false;
+    if (!gl_lcms_get_lut3d(p->cms, &lut3d, prim, trc, icc, &pending) || !lut3d) {
+        // Use the normal color management path until the LUT is ready. The
+        // old texture was for different parameters, so it can't be used.
+        ra_tex_free(p->ra, &p->lut_3d_texture);
+        p->lut_3d_pending = pending;
+        if (!pending)
+            p->use_lut_3d = false;
         return false;
     }
 
+    p->lut_3d_pending = false;
     ra_tex_free(p->ra, &p->lut_3d_texture);
 
     struct ra_tex_params params = {
@@ -723,9 +791,13 @@ static void pass_get_images(struct gl_video *p, struct video_image *vimg,
                                          msb_valid_bits,
                                          p->ra_format.component_bits);
 
+    struct texplane *planes = vimg->planes;
+    if (vimg->shared)
+        planes = p->upload_source->image.planes;
+
     memset(img, 0, 4 * sizeof(img[0]));
     for (int n = 0; n < p->plane_count; n++) {
-        struct texplane *t = &vimg->planes[n];
+        struct texplane *t = &planes[n];
 
         enum plane_type type = PLANE_NONE;
         for (int i = 0; i < 4; i++) {
@@ -808,6 +880,41 @@ static int find_comp(struct ra_imgfmt_desc *desc, int component)
     return -1;
 }
 
+// Describe a format for which mp_get_packed_imgfmt() succeeds. desc is set to
+// the planes as produced by pass_unpack_video(), *raw to the texture format
+// used for uploading.
+static bool get_packed_desc(struct ra *ra, int imgfmt,
+                            struct mp_packed_imgfmt *pk,
+                            const struct ra_format **raw,
+                            struct ra_imgfmt_desc *desc)
+{
+    if (ra->glsl_version < 130 || !mp_get_packed_imgfmt(pk, imgfmt))
+        return false;
+
+    bool is_422 = pk->layout == MP_PACKED_422;
+    *raw = ra_find_uint_format(ra, pk->word_size, is_422 ? 4 : 1);
+    if (!*raw)
+        return false;
+
+    // The unpacked values are normalized like unorm textures of this depth.
+    *desc = (struct ra_imgfmt_desc){
+        .component_bits = pk->depth[0],
+        .chroma_w = is_422 ? 2 : 1,
+        .chroma_h = 1,
+    };
+    if (is_422) {
+        desc->num_planes = 2;
+        desc->components[0][0] = 1;
+        desc->components[1][0] = 2;
+        desc->components[1][1] = 3;
+    } else {
+        desc->num_planes = 1;
+        for (int c = 0; c < 4; c++)
+            desc->components[0][c] = pk->depth[c] ? c + 1 : 0;
+    }
+    return true;
+}
+
 static void init_video(struct gl_video *p)
 {
     p->use_integer_conversion = false;
@@ -839,7 +946,13 @@ static void init_video(struct gl_video *p)
     }
 
     p->ra_format = (struct ra_imgfmt_desc){0};
-    ra_get_imgfmt_desc(p->ra, p->image_params.imgfmt, &p->ra_format);
+    p->packed = (struct mp_packed_imgfmt){0};
+    if (!ra_get_imgfmt_desc(p->ra, p->image_params.imgfmt, &p->ra_format) &&
+        !p->hwdec_active)
+    {
+        get_packed_desc(p->ra, p->image_params.imgfmt, &p->packed,
+                        &p->packed_format, &p->ra_format);
+    }
 
     p->plane_count = p->ra_format.num_planes;
 
@@ -874,12 +987,20 @@ static void init_video(struct gl_video *p)
         struct mp_image layout = {0};
         mp_image_set_params(&layout, &p->image_params);
 
-        for (int n = 0; n < p->plane_count; n++) {
+        int num_tex = p->packed.layout ? 1 : p->plane_count;
+        for (int n = 0; n < num_tex; n++) {
             struct texplane *plane = &vimg->planes[n];
             const struct ra_format *format = p->ra_format.planes[n];
 
+            if (p->packed.layout) {
+                plane = &vimg->packed;
+                format = p->packed_format;
+            }
+
             plane->w = mp_image_plane_w(&layout, n);
             plane->h = mp_image_plane_h(&layout, n);
+            if (p->packed.layout == MP_PACKED_422)
+                plane->w = (plane->w + 1) / 2; // 1 texel per pixel pair
 
             struct ra_tex_params params = {
                 .dimensions = 2,
@@ -902,6 +1023,13 @@ static void init_video(struct gl_video *p)
 
             p->use_integer_conversion |= format->ctype == RA_CTYPE_UINT;
         }
+
+        // The textures of the planes are created by pass_unpack_video().
+        for (int n = 0; p->packed.layout && n < p->plane_count; n++) {
+            int cw = n ? p->ra_format.chroma_w : 1;
+            vimg->planes[n].w = (p->image_params.w + cw - 1) / cw;
+            vimg->planes[n].h = p->image_params.h;
+        }
     }
 
     debug_check_gl(p, "after video texture creation");
@@ -962,6 +1090,7 @@ static void unref_current_image(struct gl_video *p)
     }
 
     vimg->id = 0;
+    vimg->shared = false;
 
     mp_image_unrefp(&vimg->mpi);
 
@@ -988,9 +1117,14 @@ static void uninit_video(struct gl_video *p)
     unmap_overlay(p);
     unref_current_image(p);
 
-    for (int n = 0; n < p->plane_count; n++) {
-        struct texplane *plane = &vimg->planes[n];
-        ra_tex_free(p->ra, &plane->tex);
+    if (p->packed.layout) {
+        // The planes point to p->unpack_tex[], freed by uninit_rendering().
+        ra_tex_free(p->ra, &vimg->packed.tex);
+    } else {
+        for (int n = 0; n < p->plane_count; n++) {
+            struct texplane *plane = &vimg->planes[n];
+            ra_tex_free(p->ra, &plane->tex);
+        }
     }
     *vimg = (struct video_image){0};
 
@@ -1224,6 +1358,91 @@ static void finish_pass_fbo(struct gl_video *p, struct ra_fbo fbo,
     cleanup_binds(p);
 }
 
+static struct pass_tex_usage *find_pass_tex_usage(struct gl_video *p,
+                                                  struct ra_tex *tex)
+{
+    for (int n = 0; n < p->num_pass_tex_usage; n++) {
+        if (p->pass_tex_usage[n].tex == tex)
+            return &p->pass_tex_usage[n];
+    }
+    return NULL;
+}
+
+static void pass_tex_used(struct gl_video *p, struct ra_tex *tex)
+{
+    struct pass_tex_usage *u = find_pass_tex_usage(p, tex);
+    if (!u) {
+        MP_TARRAY_APPEND(p, p->pass_tex_usage, p->num_pass_tex_usage,
+                         (struct pass_tex_usage){ .tex = tex });
+        u = &p->pass_tex_usage[p->num_pass_tex_usage - 1];
+    }
+    u->last_used = p->pass_render_count;
+}
+
+// Free *tex if it hasn't been rendered to for a while.
+static void gc_pass_tex_slot(struct gl_video *p, struct ra_tex **tex)
+{
+    if (!*tex)
+        return;
+
+    struct pass_tex_usage *u = find_pass_tex_usage(p, *tex);
+    if (!u) {
+        // Not rendered to via finish_pass_tex() yet; start aging it now.
+        pass_tex_used(p, *tex);
+        u = find_pass_tex_usage(p, *tex);
+    }
+
+    if (p->pass_render_count - u->last_used > PASS_TEX_MAX_IDLE) {
+        MP_DBG(p, "Freeing unused %dx%d intermediate texture.\n",
+               (*tex)->params.w, (*tex)->params.h);
+        ra_tex_free(p->ra, tex);
+        return;
+    }
+
+    u->seen = true;
+}
+
+// Free intermediate textures which are not needed by the current rendering
+// configuration anymore, e.g. after removing user shaders, disabling
+// --blend-subtitles, or when a different scaler path is used. Otherwise they
+// would stay allocated until the next full reinit. Textures used for every
+// rendered frame are never affected. The interpolation surfaces are managed
+// by the interpolation code, and are not freed here.
+static void gc_pass_tex(struct gl_video *p)
+{
+    for (int n = 0; n < p->num_pass_tex_usage; n++)
+        p->pass_tex_usage[n].seen = false;
+
+    for (int n = 0; n < 4; n++) {
+        gc_pass_tex_slot(p, &p->merge_tex[n]);
+        gc_pass_tex_slot(p, &p->scale_tex[n]);
+        gc_pass_tex_slot(p, &p->integer_tex[n]);
+        gc_pass_tex_slot(p, &p->unpack_tex[n]);
+        gc_pass_tex_slot(p, &p->deint_tex[n]);
+    }
+
+    gc_pass_tex_slot(p, &p->indirect_tex);
+    for (int n = 0; n < PREREDUCE_MAX; n++)
+        gc_pass_tex_slot(p, &p->prereduce_tex[n]);
+    gc_pass_tex_slot(p, &p->blend_subs_tex);
+    gc_pass_tex_slot(p, &p->screen_tex);
+
+    for (int n = 0; n < SCALER_COUNT; n++)
+        gc_pass_tex_slot(p, &p->scaler[n].sep_fbo);
+
+    for (int n = 0; n < p->num_hook_textures; n++)
+        gc_pass_tex_slot(p, &p->hook_textures[n]);
+
+    // Forget textures that were freed or replaced in the meantime.
+    for (int n = p->num_pass_tex_usage - 1; n >= 0; n--) {
+        bool keep = p->pass_tex_usage[n].seen;
+        for (int i = 0; i < SURFACES_MAX && !keep; i++)
+            keep = p->pass_tex_usage[n].tex == p->surfaces[i].tex;
+        if (!keep)
+            MP_TARRAY_REMOVE_AT(p->pass_tex_usage, p->num_pass_tex_usage, n);
+    }
+}
+
 // dst_fbo: this will be used for rendering; possibly reallocating the whole
 //          FBO, if the required parameters have changed
 // w, h: required FBO target dimension, and also defines the target rectangle
@@ -1237,6 +1456,8 @@ static void finish_pass_tex(struct gl_video *p, struct ra_tex **dst_tex,
         return;
     }
 
+    pass_tex_used(p, *dst_tex);
+
     // If RA_CAP_PARALLEL_COMPUTE is set, try to prefer compute shaders
     // over fragment shaders wherever possible.
     if (!p->pass_compute.active && (p->ra->caps & RA_CAP_PARALLEL_COMPUTE))
@@ -1304,6 +1525,7 @@ static void uninit_scaler(struct gl_video *p, struct scaler *scaler)
     ra_tex_free(p->ra, &scaler->lut);
     scaler->kernel = NULL;
     scaler->initialized = false;
+    scaler->polar_block.valid = false;
 }
 
 static void hook_prelude(struct gl_video *p, const char *name, int id,
@@ -1497,30 +1719,33 @@ found:
 // load the result back into vec4 color. Offsets applied by the hooks are
 // accumulated in tex_trans, and the FBO is dimensioned according
 // to p->texture_w/h
-static void pass_opt_hook_point(struct gl_video *p, const char *name,
-                                struct gl_transform *tex_trans)
+// Returns whether any hook hooks or binds the named texture
+static bool hook_point_used(struct gl_video *p, const char *name)
 {
-    if (!name)
-        return;
-
     for (int i = 0; i < p->num_tex_hooks; i++) {
         struct tex_hook *hook = &p->tex_hooks[i];
 
         for (int h = 0; h < SHADER_MAX_HOOKS; h++) {
             if (hook->hook_tex[h] && strcmp(hook->hook_tex[h], name) == 0)
-                goto found;
+                return true;
         }
 
         for (int b = 0; b < SHADER_MAX_BINDS; b++) {
             if (hook->bind_tex[b] && strcmp(hook->bind_tex[b], name) == 0)
-                goto found;
+                return true;
         }
     }
 
+    return false;
+}
+
+static void pass_opt_hook_point(struct gl_video *p, const char *name,
+                                struct gl_transform *tex_trans)
+{
     // Nothing uses this texture, don't bother storing it
-    return;
+    if (!name || !hook_point_used(p, name))
+        return;
 
-found: ;
     struct ra_tex **tex = next_hook_tex(p);
     finish_pass_tex(p, tex, p->texture_w, p->texture_h);
     struct image img = image_wrap(*tex, PLANE_RGB, p->components);
@@ -1592,6 +1817,14 @@ static void reinit_scaler(struct gl_video *p, struct scaler *scaler,
         scaler->initialized)
         return;
 
+    // Keep the old LUT texture around; if only the scale factor changed, the
+    // LUT is often still the same (always for polar scalers).
+    struct ra_tex *old_lut = scaler->lut;
+    struct filter_kernel old_kernel = scaler->kernel_storage;
+    bool have_old_kernel = scaler->kernel && old_lut;
+    int old_lut_size = scaler->lut_size;
+    scaler->lut = NULL;
+
     uninit_scaler(p, scaler);
 
     scaler->conf = *conf;
@@ -1603,8 +1836,10 @@ static void reinit_scaler(struct gl_video *p, struct scaler *scaler,
     scaler->initialized = true;
 
     const struct filter_kernel *t_kernel = mp_find_filter_kernel(conf->kernel.name);
-    if (!t_kernel)
+    if (!t_kernel) {
+        ra_tex_free(p->ra, &old_lut);
         return;
+    }
 
     scaler->kernel_storage = *t_kernel;
     scaler->kernel = &scaler->kernel_storage;
@@ -1641,6 +1876,17 @@ static void reinit_scaler(struct gl_video *p, struct scaler *scaler,
 
     scaler->insufficient = !mp_init_filter(scaler->kernel, sizes, scale_factor);
 
+    scaler->lut_size = 1 << p->opts.scaler_lut_size;
+
+    if (have_old_kernel && old_lut_size == scaler->lut_size &&
+        mp_filter_lut_equal(&old_kernel, scaler->kernel))
+    {
+        scaler->kernel->radius_cutoff = old_kernel.radius_cutoff;
+        scaler->lut = old_lut;
+        return;
+    }
+    ra_tex_free(p->ra, &old_lut);
+
     int size = scaler->kernel->size;
     int num_components = size > 2 ? 4 : size;
     const struct ra_format *fmt = ra_find_float16_format(p->ra, num_components);
@@ -1650,8 +1896,6 @@ static void reinit_scaler(struct gl_video *p, struct scaler *scaler,
     int stride = width * num_components;
     assert(size <= stride);
 
-    scaler->lut_size = 1 << p->opts.scaler_lut_size;
-
     float *weights = talloc_array(NULL, float, scaler->lut_size * stride);
     mp_compute_lut(scaler->kernel, scaler->lut_size, stride, weights);
 
@@ -1706,6 +1950,89 @@ static void pass_sample_separated(struct gl_video *p, struct image src,
 
 // Picks either the compute shader version or the regular sampler version
 // depending on hardware support
+// Choose the compute shader work group size for polar sampling. Every group
+// loads an iw*ih input tile (the bw*bh output block plus the kernel's padding)
+// into shmem, so small blocks waste most of their loads on the overlap with
+// neighbouring groups, while large ones need a lot of shmem and reduce the
+// number of groups that can be resident at once. Pick the candidate with the
+// fewest loads per output pixel, preferring tiles that use at most half of the
+// available shmem. The result depends only on the kernel size and the scaling
+// ratio, so it's cached in the scaler. Returns false if nothing fits.
+static bool pick_polar_block(struct gl_video *p, struct scaler *scaler,
+                             int bound, int padding, int components,
+                             float ratiox, float ratioy)
+{
+    struct scaler *s = scaler;
+    if (s->polar_block.valid && s->polar_block.bound == bound &&
+        s->polar_block.components == components &&
+        s->polar_block.ratiox == ratiox && s->polar_block.ratioy == ratioy)
+        return s->polar_block.bw > 0;
+
+    // Drivers which don't report a limit are guaranteed to support at least
+    // this many threads (GL and Vulkan minimum).
+    int max_threads = p->ra->max_compute_group_threads;
+    if (max_threads <= 0)
+        max_threads = 128;
+
+    static const int widths[] = {8, 16, 32, 64};
+    static const int threads[] = {64, 128, 256};
+
+    int best_bw = 0, best_bh = 0, best_iw = 0, best_ih = 0;
+    double best_cost = 0;
+    bool best_small = false;
+
+    for (int t = 0; t < MP_ARRAY_SIZE(threads); t++) {
+        if (threads[t] > max_threads)
+            continue;
+        for (int n = 0; n < MP_ARRAY_SIZE(widths); n++) {
+            int bw = widths[n], bh = threads[t] / bw;
+            if (bh < 1)
+                continue;
+
+            // We need to sample everything from base_min to base_max, so make
+            // sure we have enough room in shmem
+            int iw = (int)ceil(bw / ratiox) + padding + 1,
+                ih = (int)ceil(bh / ratioy) + padding + 1;
+            size_t shmem_req = (size_t)iw * ih * components * sizeof(float);
+            if (shmem_req > p->ra->max_shmem)
+                continue;
+
+            bool small = shmem_req <= p->ra->max_shmem / 2;
+            double cost = (double)iw * ih / (bw * bh);
+
+            // On ties, prefer blocks at least as wide as a warp (32 threads
+            // on nvidia), since row loads then coalesce better.
+            bool better = !best_bw || (small && !best_small) ||
+                          (small == best_small && (cost < best_cost ||
+                           (cost == best_cost && bw >= 32 && best_bw < 32)));
+            if (better) {
+                best_bw = bw;
+                best_bh = bh;
+                best_iw = iw;
+                best_ih = ih;
+                best_cost = cost;
+                best_small = small;
+            }
+        }
+    }
+
+    s->polar_block.valid = true;
+    s->polar_block.bound = bound;
+    s->polar_block.components = components;
+    s->polar_block.ratiox = ratiox;
+    s->polar_block.ratioy = ratioy;
+    s->polar_block.bw = best_bw;
+    s->polar_block.bh = best_bh;
+    s->polar_block.iw = best_iw;
+    s->polar_block.ih = best_ih;
+
+    if (best_bw) {
+        MP_DBG(p, "polar compute block for %s: %dx%d (tile %dx%d)\n",
+               s->conf.kernel.name, best_bw, best_bh, best_iw, best_ih);
+    }
+    return best_bw > 0;
+}
+
 static void pass_dispatch_sample_polar(struct gl_video *p, struct scaler *scaler,
                                        struct image img, int w, int h)
 {
@@ -1720,24 +2047,14 @@ static void pass_dispatch_sample_polar(struct gl_video *p, struct scaler *scaler
     float ratiox = (float)w / img.w,
           ratioy = (float)h / img.h;
 
-    // For performance we want to load at least as many pixels
-    // horizontally as there are threads in a warp (32 for nvidia), as
-    // well as enough to take advantage of shmem parallelism
-    const int warp_size = 32, threads = 256;
-    int bw = warp_size;
-    int bh = threads / bw;
-
-    // We need to sample everything from base_min to base_max, so make sure
-    // we have enough room in shmem
-    int iw = (int)ceil(bw / ratiox) + padding + 1,
-        ih = (int)ceil(bh / ratioy) + padding + 1;
-
-    int shmem_req = iw * ih * img.components * sizeof(float);
-    if (shmem_req > p->ra->max_shmem)
+    if (!pick_polar_block(p, scaler, bound, padding, img.components,
+                          ratiox, ratioy))
         goto fallback;
 
+    int bw = scaler->polar_block.bw, bh = scaler->polar_block.bh;
     pass_is_compute(p, bw, bh);
-    pass_compute_polar(p->sc, scaler, img.components, bw, bh, iw, ih);
+    pass_compute_polar(p->sc, scaler, img.components, bw, bh,
+                       scaler->polar_block.iw, scaler->polar_block.ih);
     return;
 
 fallback:
@@ -1913,9 +2230,30 @@ static void user_hook(struct gl_video *p, struct image img,
     gl_transform_trans(shader->offset, trans);
 }
 
+static bool user_hook_uses_tex(void *priv, const char *name)
+{
+    struct gl_user_shader_hook *shader = priv;
+
+    return szexpr_uses_tex(shader->width, bstr0(name)) ||
+           szexpr_uses_tex(shader->height, bstr0(name)) ||
+           szexpr_uses_tex(shader->cond, bstr0(name));
+}
+
 static bool add_user_hook(void *priv, struct gl_user_shader_hook hook)
 {
     struct gl_video *p = priv;
+
+    // Expressions not depending on texture sizes need to be evaluated only
+    // once, and a constantly false condition disables the pass entirely.
+    float res;
+    szexpr_fold_const(p->log, hook.width, &res);
+    szexpr_fold_const(p->log, hook.height, &res);
+    if (szexpr_fold_const(p->log, hook.cond, &res) && !res) {
+        MP_VERBOSE(p, "Skipping user shader %.*s: condition is never true.\n",
+                   BSTR_P(hook.pass_desc));
+        return true;
+    }
+
     struct gl_user_shader_hook *copy = talloc_ptrtype(p, copy);
     *copy = hook;
 
@@ -1924,6 +2262,7 @@ static bool add_user_hook(void *priv, struct gl_user_shader_hook hook)
         .components = hook.components,
         .hook = user_hook,
         .cond = user_hook_cond,
+        .uses_tex = user_hook_uses_tex,
         .priv = copy,
     };
 
@@ -1961,6 +2300,51 @@ static void load_user_shaders(struct gl_video *p, char **shaders)
     }
 }
 
+// A hook is dead if it only SAVEs to a named texture which nothing else
+// binds or looks at. (The saved textures are only visible to other hooks.)
+static bool hook_is_dead(struct gl_video *p, struct tex_hook *hook)
+{
+    const char *name = hook->save_tex;
+    if (!name || strcmp(name, "HOOKED") == 0)
+        return false;
+
+    for (int h = 0; h < SHADER_MAX_HOOKS; h++) {
+        if (hook->hook_tex[h] && strcmp(hook->hook_tex[h], name) == 0)
+            return false; // replaces the hooked texture
+    }
+
+    if (hook_point_used(p, name))
+        return false;
+
+    for (int i = 0; i < p->num_tex_hooks; i++) {
+        struct tex_hook *other = &p->tex_hooks[i];
+        if (other->uses_tex && other->uses_tex(other->priv, name))
+            return false;
+    }
+
+    return true;
+}
+
+// Remove hooks whose results are never used. Removing a hook can make the
+// hooks feeding it dead as well, so repeat until nothing changes.
+static void prune_dead_hooks(struct gl_video *p)
+{
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = p->num_tex_hooks - 1; i >= 0; i--) {
+            struct tex_hook *hook = &p->tex_hooks[i];
+            if (!hook_is_dead(p, hook))
+                continue;
+            MP_VERBOSE(p, "Removing hook saving unused texture %s.\n",
+                       hook->save_tex);
+            talloc_free(hook->priv);
+            MP_TARRAY_REMOVE_AT(p->tex_hooks, p->num_tex_hooks, i);
+            changed = true;
+        }
+    }
+}
+
 static void gl_video_setup_hooks(struct gl_video *p)
 {
     gl_video_reset_hooks(p);
@@ -1982,6 +2366,148 @@ static void gl_video_setup_hooks(struct gl_video *p)
     }
 
     load_user_shaders(p, p->opts.user_shaders);
+
+    prune_dead_hooks(p);
+}
+
+static void reset_deinterlace(struct gl_video *p)
+{
+    for (int n = 0; n < 4; n++) {
+        ra_tex_free(p->ra, &p->deint_last_tex[n]);
+        ra_tex_free(p->ra, &p->deint_prev_tex[n]);
+    }
+    p->deint_last_id = 0;
+}
+
+// Deinterlace the planes returned by pass_get_images() in place. This works on
+// the physical planes (before rotation, merging, or integer conversion), so
+// that the fields are always texture rows. The previous frame is kept
+// in deint_prev_tex, which requires copying each new frame once.
+static void pass_deinterlace_planes(struct gl_video *p, struct image img[4])
+{
+    struct video_image *vimg = &p->image;
+    struct texplane *planes = vimg->shared ? p->upload_source->image.planes
+                                           : vimg->planes;
+    bool new_frame = vimg->id != p->deint_last_id;
+    if (new_frame) {
+        for (int n = 0; n < 4; n++)
+            MPSWAP(struct ra_tex *, p->deint_prev_tex[n], p->deint_last_tex[n]);
+        p->deint_last_id = vimg->id;
+    }
+
+    // Keep the first field, i.e. interpolate the rows of the second field.
+    int keep = vimg->mpi->fields & MP_IMGFIELD_TOP_FIRST ? 0 : 1;
+
+    for (int n = 0; n < p->plane_count; n++) {
+        struct texplane *t = &planes[n];
+        if (img[n].type == PLANE_NONE || !t->tex)
+            continue;
+
+        struct image src = img[n];
+        src.transform = identity_trans;
+        src.w = t->w;
+        src.h = t->h;
+
+        // copy_image() does this itself, but DEINT_CUR_tex() does not.
+        struct image cur = src;
+        if (cur.tex->params.format->ctype == RA_CTYPE_UINT) {
+            uint64_t tex_max = 1ull << p->ra_format.component_bits;
+            cur.multiplier *= 1.0 / (tex_max - 1);
+        }
+
+        // Previous frame, or the current one if there is none yet (the
+        // temporal check then allows no difference, which is just bob).
+        struct image prev = cur;
+        struct ra_tex *prev_tex = p->deint_prev_tex[n];
+        if (prev_tex && prev_tex->params.w == t->w && prev_tex->params.h == t->h)
+            prev = image_wrap(prev_tex, cur.type, cur.components);
+
+        hook_prelude(p, "DEINT_CUR", pass_bind(p, cur), cur);
+        hook_prelude(p, "DEINT_PREV", pass_bind(p, prev), prev);
+        pass_describe(p, "deinterlace (%s)", plane_names[cur.type]);
+        pass_deinterlace(p->sc, t->flipped ? ((t->h - 1) & 1) ^ keep : keep);
+        finish_pass_tex(p, &p->deint_tex[n], t->w, t->h);
+
+        if (new_frame) {
+            copy_image(p, &(int){0}, src);
+            pass_describe(p, "deinterlace (save %s)", plane_names[cur.type]);
+            finish_pass_tex(p, &p->deint_last_tex[n], t->w, t->h);
+        }
+
+        img[n].tex = p->deint_tex[n];
+        img[n].multiplier = 1.0;
+    }
+}
+
+// Convert the raw texture of a packed format to the planes described by
+// p->ra_format (see get_packed_desc()), and make vimg->planes point to them.
+static void pass_unpack_video(struct gl_video *p, struct video_image *vimg)
+{
+    struct mp_packed_imgfmt *pk = &p->packed;
+    struct texplane *raw = &vimg->packed;
+    const char *prec = p->ra->glsl_es ? "highp " : "";
+
+    for (int n = 0; n < p->plane_count; n++) {
+        struct texplane *t = &vimg->planes[n];
+        bool luma_422 = pk->layout == MP_PACKED_422 && n == 0;
+
+        // For 4:2:2 luma, each texel covers 2 pixels horizontally.
+        struct image img = {
+            .type = PLANE_RGB,
+            .components = 4,
+            .multiplier = 1.0,
+            .tex = raw->tex,
+            .w = luma_422 ? t->w : raw->w,
+            .h = raw->h,
+            .transform = identity_trans,
+        };
+        if (luma_422)
+            img.transform.m[0][0] = 0.5;
+        int id = pass_bind(p, img);
+
+        GLSLF("// unpack plane %d\n", n);
+        GLSLF("{\n");
+        GLSLF("%suvec4 raw = texture(texture%d, texcoord%d);\n", prec, id, id);
+
+        // (source component index, destination component) pairs
+        int src[4], dst[4], num = 0;
+        if (pk->layout == MP_PACKED_WORD) {
+            GLSLF("%suint word = raw.r;\n", prec);
+            for (int c = 0; c < 4; c++) {
+                if (pk->depth[c]) {
+                    src[num] = c;
+                    dst[num++] = c;
+                }
+            }
+        } else if (luma_422) {
+            GLSLF("%suint word = fract(texcoord%d.x * texture_size%d.x) < 0.5 "
+                  "? raw.%c : raw.%c;\n", prec, id, id,
+                  "rgba"[pk->pos_422[0]], "rgba"[pk->pos_422[2]]);
+            src[num] = 0;
+            dst[num++] = 0;
+        } else {
+            src[num] = 1;
+            dst[num++] = 0;
+            src[num] = 2;
+            dst[num++] = 1;
+        }
+
+        for (int i = 0; i < num; i++) {
+            int c = src[i];
+            unsigned int mask = (1u << pk->depth[c]) - 1;
+            const char *v = "word";
+            if (pk->layout == MP_PACKED_422 && !luma_422)
+                v = mp_tprintf(8, "raw.%c", "rgba"[pk->pos_422[c == 1 ? 1 : 3]]);
+            GLSLF("color.%c = float((%s >> %du) & %uu) * %f;\n", "rgba"[dst[i]],
+                  v, pk->shift[c], mask, 1.0 / mask);
+        }
+        GLSLF("}\n");
+
+        pass_describe(p, "unpack plane %d", n);
+        finish_pass_tex(p, &p->unpack_tex[n], t->w, t->h);
+        t->tex = p->unpack_tex[n];
+        t->flipped = raw->flipped;
+    }
 }
 
 // sample from video textures, set "color" variable to yuv value
@@ -1989,8 +2515,15 @@ static void pass_read_video(struct gl_video *p)
 {
     struct image img[4];
     struct gl_transform offsets[4];
+
+    if (p->packed.layout && !p->image.shared)
+        pass_unpack_video(p, &p->image);
+
     pass_get_images(p, &p->image, img, offsets);
 
+    if (p->deint_active)
+        pass_deinterlace_planes(p, img);
+
     // To keep the code as simple as possibly, we currently run all shader
     // stages even if they would be unnecessary (e.g. no hooks for a texture).
     // In the future, deferred image should optimize this away.
@@ -2350,6 +2883,30 @@ static void pass_scale_main(struct gl_video *p)
 
     pass_opt_hook_point(p, "PREKERNEL", NULL);
 
+    // For strong downscaling, the main scaler would have to sample a huge
+    // number of source texels per output pixel. Reduce the source with cheap
+    // 2x2 box filter passes first (a single bilinear tap each), but leave at
+    // least a 2x reduction to the main scaler, so it still determines the
+    // final filtering. This also keeps --correct-downscaling meaningful.
+    int reductions = 0;
+    while (xy[0] <= 0.25 && xy[1] <= 0.25 && reductions < PREREDUCE_MAX) {
+        int w = (p->texture_w + 1) / 2, h = (p->texture_h + 1) / 2;
+        double rx = w / (double)p->texture_w, ry = h / (double)p->texture_h;
+        struct ra_tex **tex = &p->prereduce_tex[reductions++];
+        finish_pass_tex(p, tex, p->texture_w, p->texture_h);
+        pass_describe(p, "downscaling prefilter (%dx%d)", w, h);
+        pass_read_tex(p, *tex);
+        gl_transform_trans((struct gl_transform){{{rx, 0}, {0, ry}}},
+                           &p->texture_offset);
+        p->texture_w = w;
+        p->texture_h = h;
+        xy[0] /= rx;
+        xy[1] /= ry;
+    }
+    f = MPMAX(xy[0], xy[1]);
+    if (reductions && p->opts.correct_downscaling && f < 1.0)
+        scale_factor = 1.0 / f;
+
     int vp_w = p->dst_rect.x1 - p->dst_rect.x0;
     int vp_h = p->dst_rect.y1 - p->dst_rect.y0;
     struct gl_transform transform;
@@ -2447,6 +3004,7 @@ static void pass_colormanage(struct gl_video *p, struct mp_colorspace src, bool
         struct {
             unsigned int sig_peak_raw;
             unsigned int index;
+            unsigned int counter;
             unsigned int frame_max[PEAK_DETECT_FRAMES+1];
         } peak_ssbo = {0};
 
@@ -2475,6 +3033,7 @@ static void pass_colormanage(struct gl_video *p, struct mp_colorspace src, bool
         gl_sc_ssbo(p->sc, "PeakDetect", p->hdr_peak_ssbo,
             "uint sig_peak_raw;"
             "uint index;"
+            "uint counter;"
             "uint frame_max[%d];", PEAK_DETECT_FRAMES + 1
         );
     }
@@ -2493,6 +3052,15 @@ static void pass_colormanage(struct gl_video *p, struct mp_colorspace src, bool
     }
 }
 
+// Returns a GLSL expression equivalent to gl_FragCoord.xy. During the fused
+// compute output pass (see pass_draw_to_screen), this is derived from the
+// invocation ID instead.
+static const char *frag_coord(struct gl_video *p)
+{
+    return p->pass_compute.active ? "(vec2(gl_GlobalInvocationID) + frag_offset)"
+                                  : "gl_FragCoord.xy";
+}
+
 void gl_video_set_fb_depth(struct gl_video *p, int fb_depth)
 {
     p->fb_depth = fb_depth;
@@ -2583,7 +3151,7 @@ static void pass_dither(struct gl_video *p)
 
     gl_sc_uniform_texture(p->sc, "dither", p->dither_texture);
 
-    GLSLF("vec2 dither_pos = gl_FragCoord.xy * 1.0/%d.0;\n", dither_size);
+    GLSLF("vec2 dither_pos = %s * 1.0/%d.0;\n", frag_coord(p), dither_size);
 
     if (p->opts.temporal_dither) {
         int phase = (p->frames_rendered / p->opts.temporal_dither_period) % 8u;
@@ -2688,6 +3256,9 @@ static bool pass_render_frame(struct gl_video *p, struct mp_image *mpi, uint64_t
     p->idx_hook_textures = 0;
     p->use_linear = false;
 
+    p->pass_render_count++;
+    gc_pass_tex(p);
+
     // try uploading the frame
     if (!pass_upload_image(p, mpi, id))
         return false;
@@ -2698,6 +3269,11 @@ static bool pass_render_frame(struct gl_video *p, struct mp_image *mpi, uint64_t
     if (p->dumb_mode)
         return true;
 
+    p->deint_active = p->deint_requested && p->opts.deinterlace &&
+                      (p->image.mpi->fields & MP_IMGFIELD_INTERLACED);
+    if (!p->deint_active && p->deint_last_id)
+        reset_deinterlace(p);
+
     pass_read_video(p);
     pass_opt_hook_point(p, "NATIVE", &p->texture_offset);
     pass_convert_yuv(p);
@@ -2771,22 +3347,34 @@ static void pass_draw_to_screen(struct gl_video *p, struct ra_fbo fbo)
 
     pass_colormanage(p, p->image_params.color, false);
 
-    // Since finish_pass_fbo doesn't work with compute shaders, and neither
-    // does the checkerboard/dither code, we may need an indirection via
-    // p->screen_tex here.
+    int o_w = p->dst_rect.x1 - p->dst_rect.x0,
+        o_h = p->dst_rect.y1 - p->dst_rect.y0;
+
+    // Since finish_pass_fbo doesn't work with compute shaders, we may need an
+    // indirection via p->screen_tex here. If the target can be used as storage
+    // image, write to it directly from the compute shader instead, which fuses
+    // scaling, color management and dithering into a single pass and avoids
+    // the intermediate texture. (OUTPUT hooks need the texture anyway.)
+    bool direct_compute = false;
     if (p->pass_compute.active) {
-        int o_w = p->dst_rect.x1 - p->dst_rect.x0,
-            o_h = p->dst_rect.y1 - p->dst_rect.y0;
-        finish_pass_tex(p, &p->screen_tex, o_w, o_h);
-        struct image tmp = image_wrap(p->screen_tex, PLANE_RGB, p->components);
-        copy_image(p, &(int){0}, tmp);
+        direct_compute = fbo.tex->params.storage_dst && !fbo.flip &&
+                         !hook_point_used(p, "OUTPUT");
+        if (direct_compute) {
+            gl_sc_uniform_vec2(p->sc, "frag_offset", (float[2]){
+                p->dst_rect.x0 + 0.5, p->dst_rect.y0 + 0.5});
+        } else {
+            finish_pass_tex(p, &p->screen_tex, o_w, o_h);
+            struct image tmp = image_wrap(p->screen_tex, PLANE_RGB, p->components);
+            copy_image(p, &(int){0}, tmp);
+        }
     }
 
     if (p->has_alpha){
         if (p->opts.alpha_mode == ALPHA_BLEND_TILES) {
             // Draw checkerboard pattern to indicate transparency
             GLSLF("// transparency checkerboard\n");
-            GLSL(bvec2 tile = lessThan(fract(gl_FragCoord.xy * 1.0/32.0), vec2(0.5));)
+            GLSLF("bvec2 tile = lessThan(fract(%s * 1.0/32.0), vec2(0.5));\n",
+                  frag_coord(p));
             GLSL(vec3 background = vec3(tile.x == tile.y ? 0.93 : 0.87);)
             GLSL(color.rgb += background.rgb * (1.0 - color.a);)
             GLSL(color.a = 1.0;)
@@ -2804,7 +3392,26 @@ static void pass_draw_to_screen(struct gl_video *p, struct ra_fbo fbo)
 
     pass_dither(p);
     pass_describe(p, "output to screen");
-    finish_pass_fbo(p, fbo, false, &p->dst_rect);
+
+    if (direct_compute) {
+        // The dispatch is rounded up to whole blocks, and dst_rect may extend
+        // beyond the target, so clip the writes to both.
+        gl_sc_uniform_image2D_wo(p->sc, "out_image", fbo.tex);
+        gl_sc_uniform_vec2(p->sc, "out_offset",
+                           (float[2]){p->dst_rect.x0, p->dst_rect.y0});
+        gl_sc_uniform_vec2(p->sc, "out_size", (float[2]){o_w, o_h});
+        GLSL(ivec2 out_id = ivec2(gl_GlobalInvocationID);)
+        GLSL(ivec2 out_pos = out_id + ivec2(out_offset);)
+        GLSL(if (all(lessThan(out_id, ivec2(out_size))) &&
+                 all(greaterThanEqual(out_pos, ivec2(0))) &&
+                 all(lessThan(out_pos, imageSize(out_image))))
+                 imageStore(out_image, out_pos, color);)
+        dispatch_compute(p, o_w, o_h, p->pass_compute);
+        p->pass_compute = (struct compute_info){0};
+        debug_check_gl(p, "after dispatching compute shader");
+    } else {
+        finish_pass_fbo(p, fbo, false, &p->dst_rect);
+    }
 }
 
 static bool update_surface(struct gl_video *p, struct mp_image *mpi,
@@ -2839,9 +3446,30 @@ static void gl_video_interpolate_frame(struct gl_video *p, struct vo_frame *t,
 
     // Reset the queue completely if this is a still image, to avoid any
     // interpolation artifacts from surrounding frames when unpausing or
-    // framestepping
-    if (t->still)
-        gl_video_reset_surfaces(p);
+    // framestepping. Most still frames are redraws caused by OSD changes
+    // while paused, so keep the surface of the frame itself if it already
+    // exists: the OSD is drawn on top of the surfaces, and doesn't need the
+    // video to be scaled again. With blend-subs, the subtitles are part of
+    // the surface and might have changed, so always re-render.
+    if (t->still) {
+        int keep = -1;
+        for (int i = 0; i < SURFACES_MAX; i++) {
+            if (p->surfaces[i].id && p->surfaces[i].id == t->frame_id)
+                keep = i;
+        }
+        if (keep >= 0 && !p->opts.blend_subs) {
+            for (int i = 0; i < SURFACES_MAX; i++) {
+                if (i != keep) {
+                    p->surfaces[i].id = 0;
+                    p->surfaces[i].pts = MP_NOPTS_VALUE;
+                }
+            }
+            p->surface_idx = p->surface_now = keep;
+            p->output_tex_valid = false;
+        } else {
+            gl_video_reset_surfaces(p);
+        }
+    }
 
     // First of all, figure out if we have a frame available at all, and draw
     // it manually + reset the queue if not
@@ -3004,6 +3632,26 @@ static void gl_video_interpolate_frame(struct gl_video *p, struct vo_frame *t,
     p->frames_drawn += 1;
 }
 
+// Render the current frame with the dumb mode path, which requires only a
+// single, simple shader. This is used while the shaders for the full
+// rendering path are still being compiled (--gpu-shader-compile-limit).
+static void pass_render_fallback(struct gl_video *p, struct vo_frame *frame,
+                                 struct ra_fbo fbo)
+{
+    // The intermediate results are incomplete, so don't reuse them later.
+    gl_video_reset_surfaces(p);
+    p->is_interpolated = false;
+
+    bool dumb_mode = p->dumb_mode;
+    p->dumb_mode = true;
+    pass_info_reset(p, false);
+    if (pass_render_frame(p, frame->current, frame->frame_id)) {
+        pass_describe(p, "fallback (compiling shaders)");
+        pass_draw_to_screen(p, fbo);
+    }
+    p->dumb_mode = dumb_mode;
+}
+
 void gl_video_render_frame(struct gl_video *p, struct vo_frame *frame,
                            struct ra_fbo fbo)
 {
@@ -3012,6 +3660,7 @@ void gl_video_render_frame(struct gl_video *p, struct vo_frame *frame,
     struct mp_rect target_rc = {0, 0, fbo.tex->params.w, fbo.tex->params.h};
 
     p->broken_frame = false;
+    p->compile_pending = false;
 
     bool has_frame = !!frame->current;
 
@@ -3047,6 +3696,10 @@ void gl_video_render_frame(struct gl_video *p, struct vo_frame *frame,
                 interpolate = false;
         }
 
+        // Only the video passes are subject to the limit; if they are
+        // skipped, we fall back to the dumb mode rendering below.
+        gl_sc_set_compile_limit(p->sc, p->opts.shader_compile_limit);
+
         if (interpolate) {
             gl_video_interpolate_frame(p, frame, fbo);
         } else {
@@ -3102,9 +3755,15 @@ void gl_video_render_frame(struct gl_video *p, struct vo_frame *frame,
                 pass_record(p, timer_pool_measure(p->blit_timer));
             }
         }
+
+        p->compile_pending = gl_sc_compile_deferred(p->sc);
+        gl_sc_set_compile_limit(p->sc, 0);
+        if (p->compile_pending)
+            pass_render_fallback(p, frame, fbo);
     }
 
 done:
+    gl_sc_set_compile_limit(p->sc, 0);
 
     debug_check_gl(p, "after video rendering");
 
@@ -3153,16 +3812,20 @@ void gl_video_resize(struct gl_video *p,
                      struct mp_rect *src, struct mp_rect *dst,
                      struct mp_osd_res *osd)
 {
-    if (mp_rect_equals(&p->src_rect, src) &&
-        mp_rect_equals(&p->dst_rect, dst) &&
-        osd_res_equals(p->osd_rect, *osd))
+    bool video_changed = !mp_rect_equals(&p->src_rect, src) ||
+                         !mp_rect_equals(&p->dst_rect, dst);
+    if (!video_changed && osd_res_equals(p->osd_rect, *osd))
         return;
 
     p->src_rect = *src;
     p->dst_rect = *dst;
     p->osd_rect = *osd;
 
-    gl_video_reset_surfaces(p);
+    // The interpolation surfaces contain only the scaled video (and blended
+    // subtitles, which use the video rectangles), so an OSD-only change
+    // doesn't invalidate them.
+    if (video_changed)
+        gl_video_reset_surfaces(p);
 
     if (p->osd)
         mpgl_osd_resize(p->osd, p->osd_rect, p->image_params.stereo_out);
@@ -3223,15 +3886,42 @@ static void reinterleave_vdpau(struct gl_video *p,
 }
 
 // Returns false on failure.
+// Use the textures of the upload source, if it has the same frame uploaded.
+// Only software decoded frames are shared; hwdec mapping is cheap anyway.
+static bool borrow_source_image(struct gl_video *p, struct mp_image *mpi,
+                                uint64_t id)
+{
+    struct gl_video *src = p->upload_source;
+    if (!src || p->hwdec_active || src->hwdec_active || src->image.shared ||
+        p->packed.layout ||
+        src->image.id != id || src->plane_count != p->plane_count ||
+        !mp_image_params_equal(&src->image_params, &p->image_params))
+        return false;
+
+    struct video_image *vimg = &p->image;
+    vimg->mpi = mp_image_new_ref(mpi);
+    if (!vimg->mpi)
+        return false;
+    vimg->id = id;
+    vimg->shared = true;
+    p->osd_pts = mpi->pts;
+    pass_describe(p, "upload frame (shared)");
+    return true;
+}
+
 static bool pass_upload_image(struct gl_video *p, struct mp_image *mpi, uint64_t id)
 {
     struct video_image *vimg = &p->image;
 
-    if (vimg->id == id)
+    // A shared image is only valid as long as the source still has it.
+    if (vimg->id == id && (!vimg->shared || p->upload_source->image.id == id))
         return true;
 
     unref_current_image(p);
 
+    if (borrow_source_image(p, mpi, id))
+        return true;
+
     mpi = mp_image_new_ref(mpi);
     if (!mpi)
         goto error;
@@ -3278,11 +3968,17 @@ static bool pass_upload_image(struct gl_video *p, struct mp_image *mpi, uint64_t
     }
 
     // Software decoding
-    assert(mpi->num_planes == p->plane_count);
+    struct texplane *planes = vimg->planes;
+    int num_planes = p->plane_count;
+    if (p->packed.layout) {
+        planes = &vimg->packed;
+        num_planes = 1;
+    }
+    assert(mpi->num_planes == num_planes);
 
     timer_pool_start(p->upload_timer);
-    for (int n = 0; n < p->plane_count; n++) {
-        struct texplane *plane = &vimg->planes[n];
+    for (int n = 0; n < num_planes; n++) {
+        struct texplane *plane = &planes[n];
 
         struct ra_tex_upload_params params = {
             .tex = plane->tex,
@@ -3358,7 +4054,8 @@ static bool check_dumb_mode(struct gl_video *p)
     // otherwise, use auto-detection
     if (o->target_prim || o->target_trc || o->linear_scaling ||
         o->correct_downscaling || o->sigmoid_upscaling || o->interpolation ||
-        o->blend_subs || o->deband || o->unsharp)
+        o->blend_subs || o->deband || o->unsharp ||
+        (o->deinterlace && p->deint_requested))
         return false;
     // check remaining scalers (tscale is already implicitly excluded above)
     for (int i = 0; i < SCALER_COUNT; i++) {
@@ -3530,8 +4227,10 @@ void gl_video_uninit(struct gl_video *p)
 
     uninit_video(p);
 
-    for (int n = 0; n < p->num_hwdecs; n++)
-        ra_hwdec_uninit(p->hwdecs[n]);
+    if (!p->hwdecs_borrowed) {
+        for (int n = 0; n < p->num_hwdecs; n++)
+            ra_hwdec_uninit(p->hwdecs[n]);
+    }
     p->num_hwdecs = 0;
 
     gl_sc_destroy(p->sc);
@@ -3563,6 +4262,19 @@ void gl_video_uninit(struct gl_video *p)
 void gl_video_reset(struct gl_video *p)
 {
     gl_video_reset_surfaces(p);
+    reset_deinterlace(p);
+}
+
+// Request deinterlacing of interlaced frames. Returns whether the renderer does
+// it (--gpu-deinterlace is set and the renderer isn't in dumb mode); if not,
+// the caller has to deinterlace in some other way.
+bool gl_video_set_deinterlace(struct gl_video *p, bool enable)
+{
+    if (p->deint_requested != enable) {
+        p->deint_requested = enable;
+        reinit_from_options(p);
+    }
+    return enable && p->opts.deinterlace && !p->dumb_mode;
 }
 
 bool gl_video_showing_interpolated_frame(struct gl_video *p)
@@ -3570,6 +4282,14 @@ bool gl_video_showing_interpolated_frame(struct gl_video *p)
     return p->is_interpolated;
 }
 
+// Whether the last frame was rendered with the fallback path, because not all
+// shaders could be compiled yet, or the 3D LUT is still being generated. The
+// caller should redraw soon.
+bool gl_video_compile_pending(struct gl_video *p)
+{
+    return p->compile_pending || p->lut_3d_pending;
+}
+
 static bool is_imgfmt_desc_supported(struct gl_video *p,
                                      const struct ra_imgfmt_desc *desc)
 {
@@ -3588,6 +4308,11 @@ bool gl_video_check_format(struct gl_video *p, int mp_format)
     if (ra_get_imgfmt_desc(p->ra, mp_format, &desc) &&
         is_imgfmt_desc_supported(p, &desc))
         return true;
+    struct mp_packed_imgfmt packed;
+    const struct ra_format *raw;
+    if (!p->forced_dumb_mode &&
+        get_packed_desc(p->ra, mp_format, &packed, &raw, &desc))
+        return true;
     for (int n = 0; n < p->num_hwdecs; n++) {
         if (ra_hwdec_test_format(p->hwdecs[n], mp_format))
             return true;
@@ -3684,6 +4409,7 @@ static void gl_video_update_options(struct gl_video *p)
 static void reinit_from_options(struct gl_video *p)
 {
     p->use_lut_3d = gl_lcms_has_profile(p->cms);
+    p->lut_3d_pending = false;
 
     // Copy the option fields, so that check_gl_features() can mutate them.
     // This works only for the fields themselves of course, not for any memory
@@ -3695,7 +4421,8 @@ static void reinit_from_options(struct gl_video *p)
 
     check_gl_features(p);
     uninit_rendering(p);
-    gl_sc_set_cache_dir(p->sc, p->opts.shader_cache_dir);
+    gl_sc_set_cache_dir(p->sc, p->opts.shader_cache_dir,
+                        p->opts.shader_cache_size);
     p->ra->use_pbo = p->opts.pbo;
     gl_video_setup_hooks(p);
     reinit_osd(p);
@@ -3905,11 +4632,71 @@ void gl_video_load_hwdecs(struct gl_video *p, struct mp_hwdec_devices *devs,
     p->hwdec_interop_loading_done = true;
 }
 
+// Make p render frames already uploaded by src, instead of uploading them
+// again, and use the hwdec interops loaded by src. Both must use the same ra,
+// and src must outlive p (or this must be reset with src==NULL). src must
+// have loaded its hwdecs already, and p must not load any hwdecs itself.
+void gl_video_set_upload_source(struct gl_video *p, struct gl_video *src)
+{
+    assert(!p->num_hwdecs || p->hwdecs_borrowed);
+    assert(!src || src->ra == p->ra);
+
+    unref_current_image(p);
+    p->upload_source = src;
+
+    p->num_hwdecs = 0;
+    p->hwdecs_borrowed = !!src;
+    if (src) {
+        for (int n = 0; n < src->num_hwdecs; n++)
+            MP_TARRAY_APPEND(p, p->hwdecs, p->num_hwdecs, src->hwdecs[n]);
+    }
+    p->hwdec_interop_loading_done = true;
+}
+
+// Probe the driver, unless this was already done by a previous lazy load.
+static void load_add_hwdec_once(struct gl_video *p,
+                                struct mp_hwdec_devices *devs,
+                                const struct ra_hwdec_driver *drv)
+{
+    for (int n = 0; n < p->num_hwdec_drivers_tried; n++) {
+        if (p->hwdec_drivers_tried[n] == drv)
+            return;
+    }
+    MP_TARRAY_APPEND(p, p->hwdec_drivers_tried, p->num_hwdec_drivers_tried, drv);
+    load_add_hwdec(p, devs, drv, true);
+}
+
 void gl_video_load_hwdecs_all(struct gl_video *p, struct mp_hwdec_devices *devs)
 {
     if (!p->hwdec_interop_loading_done) {
         for (int n = 0; ra_hwdec_drivers[n]; n++)
-            load_add_hwdec(p, devs, ra_hwdec_drivers[n], true);
+            load_add_hwdec_once(p, devs, ra_hwdec_drivers[n]);
         p->hwdec_interop_loading_done = true;
     }
 }
+
+// Load only the interops which can map the given hardware surface format.
+// This avoids initializing (and probing formats with) unrelated APIs. Other
+// interops can still be loaded later. Formats are compared by their libav
+// pixel format, because some APIs have several mpv sub-formats (e.g. the
+// decoder outputs IMGFMT_D3D11NV12 frames for AV_PIX_FMT_D3D11).
+void gl_video_load_hwdecs_for_img_fmt(struct gl_video *p,
+                                      struct mp_hwdec_devices *devs,
+                                      int imgfmt)
+{
+    if (p->hwdec_interop_loading_done)
+        return;
+    enum AVPixelFormat pixfmt = imgfmt2pixfmt(imgfmt);
+    for (int n = 0; ra_hwdec_drivers[n]; n++) {
+        const struct ra_hwdec_driver *drv = ra_hwdec_drivers[n];
+        for (int i = 0; drv->imgfmts[i]; i++) {
+            int fmt = drv->imgfmts[i];
+            if (fmt == imgfmt || (pixfmt != AV_PIX_FMT_NONE &&
+                                  imgfmt2pixfmt(fmt) == pixfmt))
+            {
+                load_add_hwdec_once(p, devs, drv);
+                break;
+            }
+        }
+    }
+}
@@ -57,6 +57,15 @@ struct scaler {
 
     // kernel points here
     struct filter_kernel kernel_storage;
+
+    // Cached compute shader block size for polar sampling (see
+    // pick_polar_block()). Only valid if polar_block.valid is set.
+    struct {
+        bool valid;
+        int bound, components;
+        float ratiox, ratioy;
+        int bw, bh, iw, ih;
+    } polar_block;
 };
 
 enum scaler_unit {
@@ -97,6 +106,9 @@ enum tone_mapping {
 
 // How many frames to average over for HDR peak detection
 #define PEAK_DETECT_FRAMES 100
+// Relative deviation of a frame's peak from the running average above which
+// the peak detection history is reset
+#define PEAK_DETECT_SCENE_THRESHOLD 0.5
 
 struct gl_video_opts {
     int dumb_mode;
@@ -134,11 +146,14 @@ struct gl_video_opts {
     char **user_shaders;
     int deband;
     struct deband_opts *deband_opts;
+    int deinterlace;
     float unsharp;
     int tex_pad_x, tex_pad_y;
     struct mp_icc_opts *icc_opts;
     int early_flush;
     char *shader_cache_dir;
+    int shader_cache_size;
+    int shader_compile_limit;
     char *hwdec_interop;
 };
 
@@ -176,11 +191,17 @@ struct mp_colorspace gl_video_get_output_colorspace(struct gl_video *p);
 
 void gl_video_reset(struct gl_video *p);
 bool gl_video_showing_interpolated_frame(struct gl_video *p);
+bool gl_video_set_deinterlace(struct gl_video *p, bool enable);
+bool gl_video_compile_pending(struct gl_video *p);
 
 struct mp_hwdec_devices;
 void gl_video_load_hwdecs(struct gl_video *p, struct mp_hwdec_devices *devs,
                           bool load_all_by_default);
 void gl_video_load_hwdecs_all(struct gl_video *p, struct mp_hwdec_devices *devs);
+void gl_video_load_hwdecs_for_img_fmt(struct gl_video *p,
+                                      struct mp_hwdec_devices *devs,
+                                      int imgfmt);
+void gl_video_set_upload_source(struct gl_video *p, struct gl_video *src);
 
 struct vo;
 void gl_video_configure_queue(struct gl_video *p, struct vo *vo);
@@ -579,35 +579,57 @@ static void pass_tone_map(struct gl_shader_cache *sc, float ref_peak,
     }
 
     if (!ref_peak) {
+        // Use the peak of the previous frames. This is read before this
+        // frame's result is merged below, so that all work groups see the
+        // same value.
+        GLSLF("float sig_peak = 1.0/%f * float(sig_peak_raw);\n",
+              MP_REF_WHITE * PEAK_DETECT_FRAMES);
+
         // For performance, we want to do as few atomic operations on global
         // memory as possible, so use an atomic in shmem for the work group.
         // We also want slightly more stable values, so use the group average
         // instead of the group max
-        GLSLHF("shared uint group_sum = 0;\n");
+        GLSLHF("shared uint group_sum;\n");
+        GLSL(if (gl_LocalInvocationIndex == 0))
+            GLSL(group_sum = 0;)
+        GLSL(memoryBarrierShared();)
+        GLSL(barrier();)
         GLSLF("atomicAdd(group_sum, uint(sig * %f));\n", MP_REF_WHITE);
 
         // Have one thread in each work group update the frame maximum
-        GLSL(memoryBarrierBuffer();)
+        GLSL(memoryBarrierShared();)
         GLSL(barrier();)
-        GLSL(if (gl_LocalInvocationIndex == 0))
+        GLSL(if (gl_LocalInvocationIndex == 0) {)
             GLSL(atomicMax(frame_max[index], group_sum /
                  (gl_WorkGroupSize.x * gl_WorkGroupSize.y));)
-
-        // Finally, have one thread per invocation update the total maximum
-        // and advance the index
-        GLSL(memoryBarrierBuffer();)
-        GLSL(barrier();)
-        GLSL(if (gl_GlobalInvocationID == ivec3(0)) {) // do this once per invocation
-            GLSLF("uint next = (index + 1) %% %d;\n", PEAK_DETECT_FRAMES+1);
-            GLSLF("sig_peak_raw = sig_peak_raw + frame_max[index] - frame_max[next];\n");
-            GLSLF("frame_max[next] = %d;\n", (int)MP_REF_WHITE);
-            GLSL(index = next;)
+            GLSL(memoryBarrierBuffer();)
+
+            // The last work group to finish merges the frame maximum into the
+            // history and advances the index. Doing this from an arbitrary
+            // invocation instead would race with the other work groups.
+            GLSL(uint num_wg = gl_NumWorkGroups.x * gl_NumWorkGroups.y;)
+            GLSL(if (atomicAdd(counter, 1) == num_wg - 1) {)
+                GLSL(uint cur = frame_max[index];)
+                GLSLF("uint next = (index + 1) %% %d;\n", PEAK_DETECT_FRAMES+1);
+                // On a scene change (the frame deviates a lot from the
+                // average), drop the history to adapt immediately, instead of
+                // slowly fading over PEAK_DETECT_FRAMES frames.
+                GLSLF("float avg = 1.0/%d.0 * float(sig_peak_raw);\n",
+                      PEAK_DETECT_FRAMES);
+                GLSLF("if (abs(float(cur) - avg) > %f * avg) {\n",
+                      PEAK_DETECT_SCENE_THRESHOLD);
+                    GLSLF("for (int i = 0; i < %d; i++)\n", PEAK_DETECT_FRAMES+1);
+                        GLSL(frame_max[i] = cur;)
+                    GLSLF("sig_peak_raw = cur * %du;\n", PEAK_DETECT_FRAMES);
+                GLSL(} else {)
+                    GLSL(sig_peak_raw = sig_peak_raw + cur - frame_max[next];)
+                GLSL(})
+                GLSLF("frame_max[next] = %d;\n", (int)MP_REF_WHITE);
+                GLSL(index = next;)
+                GLSL(counter = 0;)
+                GLSL(memoryBarrierBuffer();)
+            GLSL(})
         GLSL(})
-
-        GLSL(memoryBarrierBuffer();)
-        GLSL(barrier();)
-        GLSLF("float sig_peak = 1.0/%f * float(sig_peak_raw);\n",
-              MP_REF_WHITE * PEAK_DETECT_FRAMES);
     } else {
         GLSLHF("const float sig_peak = %f;\n", ref_peak);
     }
@@ -870,3 +892,62 @@ void pass_sample_unsharp(struct gl_shader_cache *sc, float param) {
     GLSLF("color = p + t * %f;\n", param);
     GLSLF("}\n");
 }
+
+// Sum of the differences between the rows above and below the missing row
+// along the direction dx, as used for edge directed interpolation.
+static void deint_edge_score(struct gl_shader_cache *sc, int dx)
+{
+    GLSLF("score = dot(abs(DEINT_CUR_texOff(vec2(%d.0, -1.0)) - "
+                          "DEINT_CUR_texOff(vec2(%d.0, 1.0))) + "
+                      "abs(DEINT_CUR_texOff(vec2(%d.0, -1.0)) - "
+                          "DEINT_CUR_texOff(vec2(%d.0, 1.0))) + "
+                      "abs(DEINT_CUR_texOff(vec2(%d.0, -1.0)) - "
+                          "DEINT_CUR_texOff(vec2(%d.0, 1.0))), vec4(1.0));\n",
+          dx - 1, -dx - 1, dx, -dx, dx + 1, -dx + 1);
+}
+
+// Yadif-style deinterlacing of a single plane. Rows with the parity keep_parity
+// (in texture rows) are the first field of DEINT_CUR, and are kept as they
+// are. The others are predicted spatially (edge directed), and the prediction
+// is clamped to the range allowed by the temporal difference to DEINT_PREV,
+// the previous frame. There is no lookahead, so unlike yadif, the temporal
+// check only looks backwards.
+void pass_deinterlace(struct gl_shader_cache *sc, int keep_parity)
+{
+    GLSLF("{\n");
+    GLSL(color = DEINT_CUR_tex(DEINT_CUR_pos);)
+    GLSLF("if (mod(floor(DEINT_CUR_pos.y * DEINT_CUR_size.y), 2.0) != %d.0) {\n",
+          keep_parity);
+    GLSL(vec4 c = DEINT_CUR_texOff(vec2(0.0, -1.0));)
+    GLSL(vec4 e = DEINT_CUR_texOff(vec2(0.0, 1.0));)
+    // The missing rows of both frames surround the current field in time.
+    GLSL(vec4 p0 = DEINT_PREV_tex(DEINT_PREV_pos);)
+    GLSL(vec4 d = (p0 + color) * 0.5;)
+    GLSL(vec4 diff = max(abs(p0 - color) * 0.5,
+                         (abs(DEINT_PREV_texOff(vec2(0.0, -1.0)) - c) +
+                          abs(DEINT_PREV_texOff(vec2(0.0, 1.0)) - e)) * 0.5);)
+    GLSL(vec4 b = (DEINT_PREV_texOff(vec2(0.0, -2.0)) +
+                   DEINT_CUR_texOff(vec2(0.0, -2.0))) * 0.5;)
+    GLSL(vec4 f = (DEINT_PREV_texOff(vec2(0.0, 2.0)) +
+                   DEINT_CUR_texOff(vec2(0.0, 2.0))) * 0.5;)
+    GLSL(vec4 dmax = max(max(d - e, d - c), min(b - c, f - e));)
+    GLSL(vec4 dmin = min(min(d - e, d - c), max(b - c, f - e));)
+    GLSL(diff = max(max(diff, dmin), -dmax);)
+    GLSL(vec4 spatial = (c + e) * 0.5;)
+    GLSL(float score;)
+    deint_edge_score(sc, 0);
+    GLSL(float best = score;)
+    static const int dirs[] = {-1, 1, -2, 2};
+    for (int n = 0; n < MP_ARRAY_SIZE(dirs); n++) {
+        deint_edge_score(sc, dirs[n]);
+        GLSLF("if (score < best) {\n");
+        GLSL(best = score;)
+        GLSLF("spatial = (DEINT_CUR_texOff(vec2(%d.0, -1.0)) + "
+                         "DEINT_CUR_texOff(vec2(%d.0, 1.0))) * 0.5;\n",
+              dirs[n], -dirs[n]);
+        GLSLF("}\n");
+    }
+    GLSL(color = clamp(spatial, d - diff, d + diff);)
+    GLSLF("}\n");
+    GLSLF("}\n");
+}
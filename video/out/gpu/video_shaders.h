@@ -53,4 +53,6 @@ void pass_sample_deband(struct gl_shader_cache *sc, struct deband_opts *opts,
 
 void pass_sample_unsharp(struct gl_shader_cache *sc, float param);
 
+void pass_deinterlace(struct gl_shader_cache *sc, int keep_parity);
+
 #endif
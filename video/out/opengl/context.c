@@ -81,6 +81,16 @@ const struct m_sub_options opengl_conf = {
     .size = sizeof(struct opengl_opts),
 };
 
+// Maximum number of asynchronous screenshot readbacks in flight.
+#define MAX_READBACKS 3
+
+struct gl_readback {
+    GLuint pbo;
+    GLsync fence;
+    int w, h;
+    bool flip;
+};
+
 struct priv {
     GL *gl;
     struct mp_log *log;
@@ -98,6 +108,9 @@ struct priv {
     // for swapchain_depth simulation
     GLsync *vsync_fences;
     int num_vsync_fences;
+    // for asynchronous screenshots (oldest first)
+    struct gl_readback readbacks[MAX_READBACKS];
+    int num_readbacks;
 };
 
 bool ra_gl_ctx_test_version(struct ra_ctx *ctx, int version, bool es)
@@ -136,10 +149,22 @@ static void *get_native_display(void *priv, const char *name)
     return p->params.native_display;
 }
 
+static void readback_free(struct priv *p, int index)
+{
+    GL *gl = p->gl;
+    struct gl_readback *rb = &p->readbacks[index];
+    if (rb->fence)
+        gl->DeleteSync(rb->fence);
+    gl->DeleteBuffers(1, &rb->pbo);
+    MP_TARRAY_REMOVE_AT(p->readbacks, p->num_readbacks, index);
+}
+
 void ra_gl_ctx_uninit(struct ra_ctx *ctx)
 {
     if (ctx->swapchain) {
         struct priv *p = ctx->swapchain->priv;
+        while (p->num_readbacks)
+            readback_free(p, 0);
         if (ctx->ra && p->wrapped_fb)
             ra_tex_free(ctx->ra, &p->wrapped_fb);
         talloc_free(ctx->swapchain);
@@ -173,14 +198,21 @@ bool ra_gl_ctx_init(struct ra_ctx *ctx, GL *gl, struct ra_gl_ctx_params params)
     if (ext) {
         if (ext->color_depth)
             p->fns.color_depth = ext->color_depth;
-        if (ext->screenshot)
+        if (ext->screenshot) {
+            // The async variant reads main_fb, which may not be what the
+            // external screenshot callback would return.
             p->fns.screenshot = ext->screenshot;
+            p->fns.screenshot_start = ext->screenshot_start;
+            p->fns.screenshot_fetch = ext->screenshot_fetch;
+        }
         if (ext->start_frame)
             p->fns.start_frame = ext->start_frame;
         if (ext->submit_frame)
             p->fns.submit_frame = ext->submit_frame;
         if (ext->swap_buffers)
             p->fns.swap_buffers = ext->swap_buffers;
+        if (ext->get_vsync)
+            p->fns.get_vsync = ext->get_vsync;
     }
 
     if (!gl->version && !gl->es)
@@ -265,6 +297,88 @@ struct mp_image *ra_gl_ctx_screenshot(struct ra_swapchain *sw)
     return screen;
 }
 
+bool ra_gl_ctx_screenshot_start(struct ra_swapchain *sw)
+{
+    struct priv *p = sw->priv;
+    GL *gl = p->gl;
+
+    // Same restriction as gl_read_fbo_contents(): ES can't read the front
+    // buffer.
+    if (!p->wrapped_fb || gl->es || !gl->FenceSync || !gl->MapBufferRange)
+        return false;
+    if (p->num_readbacks >= MAX_READBACKS)
+        return false;
+
+    struct gl_readback rb = {
+        .w = p->wrapped_fb->params.w,
+        .h = p->wrapped_fb->params.h,
+        .flip = p->params.flipped,
+    };
+
+    // Read the whole framebuffer into a PBO. This returns immediately, and
+    // the copy happens asynchronously on the GPU.
+    gl->GenBuffers(1, &rb.pbo);
+    gl->BindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+    gl->BufferData(GL_PIXEL_PACK_BUFFER, (size_t)rb.w * rb.h * 3, NULL,
+                   GL_STREAM_READ);
+    gl->BindFramebuffer(GL_FRAMEBUFFER, p->main_fb);
+    gl->ReadBuffer(p->main_fb ? GL_COLOR_ATTACHMENT0 : GL_FRONT);
+    gl->PixelStorei(GL_PACK_ALIGNMENT, 1);
+    gl->ReadPixels(0, 0, rb.w, rb.h, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    gl->PixelStorei(GL_PACK_ALIGNMENT, 4);
+    gl->BindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl->BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    rb.fence = gl->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    gl->Flush();
+
+    p->readbacks[p->num_readbacks++] = rb;
+    return true;
+}
+
+struct mp_image *ra_gl_ctx_screenshot_fetch(struct ra_swapchain *sw, bool wait)
+{
+    struct priv *p = sw->priv;
+    GL *gl = p->gl;
+
+    if (!p->num_readbacks)
+        return NULL;
+
+    struct gl_readback *rb = &p->readbacks[0];
+    if (rb->fence) {
+        GLenum res = gl->ClientWaitSync(rb->fence,
+                                        wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                        wait ? 1e9 : 0);
+        if (res == GL_TIMEOUT_EXPIRED && !wait)
+            return NULL;
+        gl->DeleteSync(rb->fence);
+        rb->fence = NULL;
+    }
+
+    struct mp_image *screen = mp_image_alloc(IMGFMT_RGB24, rb->w, rb->h);
+    gl->BindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo);
+    size_t row = (size_t)rb->w * 3;
+    uint8_t *data = gl->MapBufferRange(GL_PIXEL_PACK_BUFFER, 0, row * rb->h,
+                                       GL_MAP_READ_BIT);
+    if (screen && data) {
+        // The FB is read bottom-up; see ra_gl_ctx_screenshot().
+        for (int y = 0; y < rb->h; y++) {
+            int src_y = rb->flip ? y : rb->h - y - 1;
+            memcpy(screen->planes[0] + y * screen->stride[0],
+                   data + src_y * row, row);
+        }
+    } else {
+        talloc_free(screen);
+        screen = NULL;
+    }
+    if (data)
+        gl->UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    gl->BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback_free(p, 0);
+    return screen;
+}
+
 bool ra_gl_ctx_start_frame(struct ra_swapchain *sw, struct ra_fbo *out_fbo)
 {
     struct priv *p = sw->priv;
@@ -346,10 +460,21 @@ void ra_gl_ctx_swap_buffers(struct ra_swapchain *sw)
     }
 }
 
+static void ra_gl_ctx_get_vsync(struct ra_swapchain *sw,
+                                struct vo_vsync_info *info)
+{
+    struct priv *p = sw->priv;
+    if (p->params.get_vsync)
+        p->params.get_vsync(sw->ctx, info);
+}
+
 static const struct ra_swapchain_fns ra_gl_swapchain_fns = {
     .color_depth   = ra_gl_ctx_color_depth,
     .screenshot    = ra_gl_ctx_screenshot,
+    .screenshot_start = ra_gl_ctx_screenshot_start,
+    .screenshot_fetch = ra_gl_ctx_screenshot_fetch,
     .start_frame   = ra_gl_ctx_start_frame,
     .submit_frame  = ra_gl_ctx_submit_frame,
     .swap_buffers  = ra_gl_ctx_swap_buffers,
+    .get_vsync     = ra_gl_ctx_get_vsync,
 };
@@ -23,6 +23,9 @@ struct ra_gl_ctx_params {
     // function or if you override it yourself.
     void (*swap_buffers)(struct ra_ctx *ctx);
 
+    // See ra_swapchain_fns.get_vsync. Optional.
+    void (*get_vsync)(struct ra_ctx *ctx, struct vo_vsync_info *info);
+
     // Set to false if the implementation follows normal GL semantics, which is
     // upside down. Set to true if it does *not*, i.e. if rendering is right
     // side up
@@ -51,6 +54,8 @@ void ra_gl_ctx_resize(struct ra_swapchain *sw, int w, int h, int fbo);
 // for whatever reason, these can be used to inherit the original behavior.
 int ra_gl_ctx_color_depth(struct ra_swapchain *sw);
 struct mp_image *ra_gl_ctx_screenshot(struct ra_swapchain *sw);
+bool ra_gl_ctx_screenshot_start(struct ra_swapchain *sw);
+struct mp_image *ra_gl_ctx_screenshot_fetch(struct ra_swapchain *sw, bool wait);
 bool ra_gl_ctx_start_frame(struct ra_swapchain *sw, struct ra_fbo *out_fbo);
 bool ra_gl_ctx_submit_frame(struct ra_swapchain *sw, const struct vo_frame *frame);
 void ra_gl_ctx_swap_buffers(struct ra_swapchain *sw);
@@ -211,6 +211,12 @@ static void set_glx_attrib(int *attribs, int name, int value)
 static void glx_swap_buffers(struct ra_ctx *ctx)
 {
     glXSwapBuffers(ctx->vo->x11->display, ctx->vo->x11->window);
+    vo_x11_present_swapped(ctx->vo);
+}
+
+static void glx_get_vsync(struct ra_ctx *ctx, struct vo_vsync_info *info)
+{
+    vo_x11_get_vsync(ctx->vo, info);
 }
 
 static bool glx_init(struct ra_ctx *ctx)
@@ -296,6 +302,7 @@ static bool glx_init(struct ra_ctx *ctx)
 
     struct ra_gl_ctx_params params = {
         .swap_buffers = glx_swap_buffers,
+        .get_vsync = glx_get_vsync,
     };
 
     if (!ra_gl_ctx_init(ctx, gl, params))
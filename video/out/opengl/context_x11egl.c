@@ -79,6 +79,12 @@ static void mpegl_swap_buffers(struct ra_ctx *ctx)
 {
     struct priv *p = ctx->priv;
     eglSwapBuffers(p->egl_display, p->egl_surface);
+    vo_x11_present_swapped(ctx->vo);
+}
+
+static void mpegl_get_vsync(struct ra_ctx *ctx, struct vo_vsync_info *info)
+{
+    vo_x11_get_vsync(ctx->vo, info);
 }
 
 static bool mpegl_init(struct ra_ctx *ctx)
@@ -142,6 +148,7 @@ static bool mpegl_init(struct ra_ctx *ctx)
 
     struct ra_gl_ctx_params params = {
         .swap_buffers = mpegl_swap_buffers,
+        .get_vsync = mpegl_get_vsync,
         .native_display_type = "x11",
         .native_display = vo->x11->display,
     };
@@ -37,8 +37,10 @@
 #define CUDA_DECL(NAME, TYPE) \
     TYPE *mpv_ ## NAME;
 CUDA_FNS(CUDA_DECL)
+CUDA_EXT_FNS(CUDA_DECL)
 
 static bool cuda_loaded = false;
+static bool cuda_ext_loaded = false;
 static pthread_once_t cuda_load_once = PTHREAD_ONCE_INIT;
 
 static void cuda_do_load(void)
@@ -54,6 +56,12 @@ static void cuda_do_load(void)
     CUDA_FNS(CUDA_LOAD_SYMBOL)
 
     cuda_loaded = true;
+
+    cuda_ext_loaded = true;
+#define CUDA_LOAD_EXT_SYMBOL(NAME, TYPE) \
+    mpv_ ## NAME = dlsym(lib, #NAME); cuda_ext_loaded &= !!mpv_ ## NAME;
+
+    CUDA_EXT_FNS(CUDA_LOAD_EXT_SYMBOL)
 }
 
 bool cuda_load(void)
@@ -61,3 +69,8 @@ bool cuda_load(void)
     pthread_once(&cuda_load_once, cuda_do_load);
     return cuda_loaded;
 }
+
+bool cuda_has_external_interop(void)
+{
+    return cuda_load() && cuda_ext_loaded;
+}
@@ -89,11 +89,73 @@ typedef enum CUGLDeviceList_enum {
 
 #define CU_GRAPHICS_REGISTER_FLAGS_WRITE_DISCARD 2
 
+// External memory/semaphore interop (CUDA 10.0), used for Vulkan interop.
+typedef struct CUextMemory_st *CUexternalMemory;
+typedef struct CUextSemaphore_st *CUexternalSemaphore;
+
+typedef struct CUuuid_st {
+    char bytes[16];
+} CUuuid;
+
+typedef enum CUexternalMemoryHandleType_enum {
+    CU_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD = 1,
+} CUexternalMemoryHandleType;
+
+typedef struct CUDA_EXTERNAL_MEMORY_HANDLE_DESC_st {
+    CUexternalMemoryHandleType type;
+    union {
+        int fd;
+        struct {
+            void *handle;
+            const void *name;
+        } win32;
+    } handle;
+    unsigned long long size;
+    unsigned int flags;
+    unsigned int reserved[16];
+} CUDA_EXTERNAL_MEMORY_HANDLE_DESC;
+
+typedef struct CUDA_EXTERNAL_MEMORY_BUFFER_DESC_st {
+    unsigned long long offset;
+    unsigned long long size;
+    unsigned int flags;
+    unsigned int reserved[16];
+} CUDA_EXTERNAL_MEMORY_BUFFER_DESC;
+
+typedef enum CUexternalSemaphoreHandleType_enum {
+    CU_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD = 1,
+} CUexternalSemaphoreHandleType;
+
+typedef struct CUDA_EXTERNAL_SEMAPHORE_HANDLE_DESC_st {
+    CUexternalSemaphoreHandleType type;
+    union {
+        int fd;
+        struct {
+            void *handle;
+            const void *name;
+        } win32;
+    } handle;
+    unsigned int flags;
+    unsigned int reserved[16];
+} CUDA_EXTERNAL_SEMAPHORE_HANDLE_DESC;
+
+typedef struct CUDA_EXTERNAL_SEMAPHORE_SIGNAL_PARAMS_st {
+    struct {
+        struct {
+            unsigned long long value;
+        } fence;
+        unsigned int reserved[16];
+    } params;
+    unsigned int flags;
+    unsigned int reserved[16];
+} CUDA_EXTERNAL_SEMAPHORE_SIGNAL_PARAMS;
+
 typedef CUresult CUDAAPI tcuInit(unsigned int Flags);
 typedef CUresult CUDAAPI tcuCtxCreate_v2(CUcontext *pctx, unsigned int flags, CUdevice dev);
 typedef CUresult CUDAAPI tcuCtxPushCurrent_v2(CUcontext *pctx);
 typedef CUresult CUDAAPI tcuCtxPopCurrent_v2(CUcontext *pctx);
 typedef CUresult CUDAAPI tcuCtxDestroy_v2(CUcontext ctx);
+typedef CUresult CUDAAPI tcuCtxSynchronize(void);
 typedef CUresult CUDAAPI tcuDeviceGet(CUdevice *pdevice, int ordinal);
 typedef CUresult CUDAAPI tcuMemcpy2D_v2(const CUDA_MEMCPY2D *pcopy);
 typedef CUresult CUDAAPI tcuGetErrorName(CUresult error, const char** pstr);
@@ -104,6 +166,16 @@ typedef CUresult CUDAAPI tcuGraphicsUnregisterResource(CUgraphicsResource resour
 typedef CUresult CUDAAPI tcuGraphicsMapResources(unsigned int count, CUgraphicsResource* resources, CUstream hStream);
 typedef CUresult CUDAAPI tcuGraphicsUnmapResources(unsigned int count, CUgraphicsResource* resources, CUstream hStream);
 typedef CUresult CUDAAPI tcuGraphicsSubResourceGetMappedArray(CUarray* pArray, CUgraphicsResource resource, unsigned int arrayIndex, unsigned int mipLevel);
+typedef CUresult CUDAAPI tcuDeviceGetCount(int *count);
+typedef CUresult CUDAAPI tcuDeviceGetUuid(CUuuid *uuid, CUdevice dev);
+typedef CUresult CUDAAPI tcuMemcpy2DAsync_v2(const CUDA_MEMCPY2D *pcopy, CUstream hStream);
+typedef CUresult CUDAAPI tcuMemFree_v2(CUdeviceptr dptr);
+typedef CUresult CUDAAPI tcuImportExternalMemory(CUexternalMemory *extMem_out, const CUDA_EXTERNAL_MEMORY_HANDLE_DESC *memHandleDesc);
+typedef CUresult CUDAAPI tcuExternalMemoryGetMappedBuffer(CUdeviceptr *devPtr, CUexternalMemory extMem, const CUDA_EXTERNAL_MEMORY_BUFFER_DESC *bufferDesc);
+typedef CUresult CUDAAPI tcuDestroyExternalMemory(CUexternalMemory extMem);
+typedef CUresult CUDAAPI tcuImportExternalSemaphore(CUexternalSemaphore *extSem_out, const CUDA_EXTERNAL_SEMAPHORE_HANDLE_DESC *semHandleDesc);
+typedef CUresult CUDAAPI tcuSignalExternalSemaphoresAsync(const CUexternalSemaphore *extSemArray, const CUDA_EXTERNAL_SEMAPHORE_SIGNAL_PARAMS *paramsArray, unsigned int numExtSems, CUstream stream);
+typedef CUresult CUDAAPI tcuDestroyExternalSemaphore(CUexternalSemaphore extSem);
 
 #define CUDA_FNS(FN) \
     FN(cuInit, tcuInit) \
@@ -111,6 +183,7 @@ typedef CUresult CUDAAPI tcuGraphicsSubResourceGetMappedArray(CUarray* pArray, C
     FN(cuCtxPushCurrent_v2, tcuCtxPushCurrent_v2) \
     FN(cuCtxPopCurrent_v2, tcuCtxPopCurrent_v2) \
     FN(cuCtxDestroy_v2, tcuCtxDestroy_v2) \
+    FN(cuCtxSynchronize, tcuCtxSynchronize) \
     FN(cuDeviceGet, tcuDeviceGet) \
     FN(cuMemcpy2D_v2, tcuMemcpy2D_v2) \
     FN(cuGetErrorName, tcuGetErrorName) \
@@ -122,16 +195,31 @@ typedef CUresult CUDAAPI tcuGraphicsSubResourceGetMappedArray(CUarray* pArray, C
     FN(cuGraphicsUnmapResources, tcuGraphicsUnmapResources) \
     FN(cuGraphicsSubResourceGetMappedArray, tcuGraphicsSubResourceGetMappedArray) \
 
+// Optional functions, which are NULL if the driver is too old.
+#define CUDA_EXT_FNS(FN) \
+    FN(cuDeviceGetCount, tcuDeviceGetCount) \
+    FN(cuDeviceGetUuid, tcuDeviceGetUuid) \
+    FN(cuMemcpy2DAsync_v2, tcuMemcpy2DAsync_v2) \
+    FN(cuMemFree_v2, tcuMemFree_v2) \
+    FN(cuImportExternalMemory, tcuImportExternalMemory) \
+    FN(cuExternalMemoryGetMappedBuffer, tcuExternalMemoryGetMappedBuffer) \
+    FN(cuDestroyExternalMemory, tcuDestroyExternalMemory) \
+    FN(cuImportExternalSemaphore, tcuImportExternalSemaphore) \
+    FN(cuSignalExternalSemaphoresAsync, tcuSignalExternalSemaphoresAsync) \
+    FN(cuDestroyExternalSemaphore, tcuDestroyExternalSemaphore) \
+
 #define CUDA_EXT_DECL(NAME, TYPE) \
     extern TYPE *mpv_ ## NAME;
 
 CUDA_FNS(CUDA_EXT_DECL)
+CUDA_EXT_FNS(CUDA_EXT_DECL)
 
 #define cuInit mpv_cuInit
 #define cuCtxCreate mpv_cuCtxCreate_v2
 #define cuCtxPushCurrent mpv_cuCtxPushCurrent_v2
 #define cuCtxPopCurrent mpv_cuCtxPopCurrent_v2
 #define cuCtxDestroy mpv_cuCtxDestroy_v2
+#define cuCtxSynchronize mpv_cuCtxSynchronize
 #define cuDeviceGet mpv_cuDeviceGet
 #define cuMemcpy2D mpv_cuMemcpy2D_v2
 #define cuGetErrorName mpv_cuGetErrorName
@@ -142,7 +230,20 @@ CUDA_FNS(CUDA_EXT_DECL)
 #define cuGraphicsMapResources mpv_cuGraphicsMapResources
 #define cuGraphicsUnmapResources mpv_cuGraphicsUnmapResources
 #define cuGraphicsSubResourceGetMappedArray mpv_cuGraphicsSubResourceGetMappedArray
+#define cuDeviceGetCount mpv_cuDeviceGetCount
+#define cuDeviceGetUuid mpv_cuDeviceGetUuid
+#define cuMemcpy2DAsync mpv_cuMemcpy2DAsync_v2
+#define cuMemFree mpv_cuMemFree_v2
+#define cuImportExternalMemory mpv_cuImportExternalMemory
+#define cuExternalMemoryGetMappedBuffer mpv_cuExternalMemoryGetMappedBuffer
+#define cuDestroyExternalMemory mpv_cuDestroyExternalMemory
+#define cuImportExternalSemaphore mpv_cuImportExternalSemaphore
+#define cuSignalExternalSemaphoresAsync mpv_cuSignalExternalSemaphoresAsync
+#define cuDestroyExternalSemaphore mpv_cuDestroyExternalSemaphore
 
 bool cuda_load(void);
 
+// Whether the CUDA_EXT_FNS were all found (after a successful cuda_load()).
+bool cuda_has_external_interop(void);
+
 #endif // MPV_CUDA_DYNAMIC_H
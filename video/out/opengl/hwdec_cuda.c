@@ -25,8 +25,16 @@
  *
  * For now, cuvid/NvDecode will always return images in NV12 format, even
  * when decoding 10bit streams (there is some hardware dithering going on).
+ *
+ * With Vulkan, the frames are copied into a texture upload buffer whose memory
+ * is exported to CUDA (CUDA 10 external memory). CUDA signals an exported
+ * semaphore after the copy, which the Vulkan upload waits on.
  */
 
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
 #include "cuda_dynamic.h"
 
 #include <libavutil/hwcontext.h>
@@ -36,12 +44,27 @@
 #include "formats.h"
 #include "options/m_config.h"
 #include "ra_gl.h"
+#if HAVE_VULKAN
+#include "video/out/vulkan/ra_vk.h"
+#endif
 
 struct priv_owner {
     struct mp_hwdec_ctx hwctx;
     CUcontext display_ctx;
     CUcontext decode_ctx;
+    bool is_vk;
+};
+
+#if HAVE_VULKAN
+// Buffer shared between CUDA and Vulkan, holding all planes of a frame.
+struct ext_vk_buf {
+    struct ra_buf *buf;
+    CUexternalMemory mem;
+    CUdeviceptr ptr;
+    VkSemaphore sem;
+    CUexternalSemaphore cu_sem;
 };
+#endif
 
 struct priv {
     struct mp_image layout;
@@ -49,6 +72,16 @@ struct priv {
     CUarray cu_array[4];
 
     CUcontext display_ctx;
+
+#if HAVE_VULKAN
+    // Layout of the planes within the buffers.
+    size_t plane_offset[4];
+    ptrdiff_t plane_stride[4];
+    size_t buf_size;
+
+    struct ext_vk_buf *vk_bufs;
+    int num_vk_bufs;
+#endif
 };
 
 static int check_cu(struct ra_hwdec *hw, CUresult err, const char *func)
@@ -74,6 +107,37 @@ static int check_cu(struct ra_hwdec *hw, CUresult err, const char *func)
 
 #define CHECK_CU(x) check_cu(hw, (x), #x)
 
+#if HAVE_VULKAN
+// Find the CUDA device corresponding to the Vulkan device.
+static int cuda_get_vk_device(struct ra_hwdec *hw, CUdevice *out)
+{
+    uint8_t vk_uuid[VK_UUID_SIZE];
+    bool have_uuid = ra_vk_get_device_uuid(hw->ra, vk_uuid);
+    if (!have_uuid)
+        MP_WARN(hw, "Can't identify Vulkan device, using first CUDA device\n");
+
+    int count = 0;
+    int ret = CHECK_CU(cuDeviceGetCount(&count));
+    if (ret < 0)
+        return ret;
+
+    for (int n = 0; n < count; n++) {
+        CUdevice dev;
+        CUuuid uuid;
+        if (CHECK_CU(cuDeviceGet(&dev, n)) < 0 ||
+            CHECK_CU(cuDeviceGetUuid(&uuid, dev)) < 0)
+            continue;
+        if (!have_uuid || memcmp(uuid.bytes, vk_uuid, VK_UUID_SIZE) == 0) {
+            *out = dev;
+            return 0;
+        }
+    }
+
+    MP_VERBOSE(hw, "No CUDA device matches the Vulkan device\n");
+    return -1;
+}
+#endif
+
 static int cuda_init(struct ra_hwdec *hw)
 {
     CUdevice display_dev;
@@ -83,13 +147,25 @@ static int cuda_init(struct ra_hwdec *hw)
     int ret = 0;
     struct priv_owner *p = hw->priv;
 
-    if (!ra_is_gl(hw->ra))
-        return -1;
-
-    GL *gl = ra_gl_get(hw->ra);
-    if (gl->version < 210 && gl->es < 300) {
-        MP_VERBOSE(hw, "need OpenGL >= 2.1 or OpenGL-ES >= 3.0\n");
+    if (ra_is_gl(hw->ra)) {
+        GL *gl = ra_gl_get(hw->ra);
+        if (gl->version < 210 && gl->es < 300) {
+            MP_VERBOSE(hw, "need OpenGL >= 2.1 or OpenGL-ES >= 3.0\n");
+            return -1;
+        }
+    } else {
+#if HAVE_VULKAN
+        struct mpvk_ctx *vk = ra_vk_get(hw->ra);
+        if (!vk)
+            return -1;
+        if (!vk->has_ext_mem_fd || !vk->has_ext_sem_fd) {
+            MP_VERBOSE(hw, "Vulkan device lacks external memory support\n");
+            return -1;
+        }
+        p->is_vk = true;
+#else
         return -1;
+#endif
     }
 
     bool loaded = cuda_load();
@@ -98,13 +174,24 @@ static int cuda_init(struct ra_hwdec *hw)
         return -1;
     }
 
+    if (p->is_vk && !cuda_has_external_interop()) {
+        MP_VERBOSE(hw, "CUDA driver does not support external memory\n");
+        return -1;
+    }
+
     ret = CHECK_CU(cuInit(0));
     if (ret < 0)
         goto error;
 
     // Allocate display context
-    ret = CHECK_CU(cuGLGetDevices(&device_count, &display_dev, 1,
-                                  CU_GL_DEVICE_LIST_ALL));
+    if (p->is_vk) {
+#if HAVE_VULKAN
+        ret = cuda_get_vk_device(hw, &display_dev);
+#endif
+    } else {
+        ret = CHECK_CU(cuGLGetDevices(&device_count, &display_dev, 1,
+                                      CU_GL_DEVICE_LIST_ALL));
+    }
     if (ret < 0)
         goto error;
 
@@ -190,6 +277,149 @@ static void cuda_uninit(struct ra_hwdec *hw)
 #undef CHECK_CU
 #define CHECK_CU(x) check_cu((mapper)->owner, (x), #x)
 
+#if HAVE_VULKAN
+static void ext_vk_buf_destroy(struct ra_hwdec_mapper *mapper,
+                               struct ext_vk_buf *e)
+{
+    if (e->cu_sem)
+        CHECK_CU(cuDestroyExternalSemaphore(e->cu_sem));
+    if (e->ptr)
+        CHECK_CU(cuMemFree(e->ptr));
+    if (e->mem)
+        CHECK_CU(cuDestroyExternalMemory(e->mem));
+    ra_vk_destroy_sem(mapper->ra, e->sem);
+    ra_buf_free(mapper->ra, &e->buf);
+    *e = (struct ext_vk_buf){0};
+}
+
+// Allocate a shared buffer and import it into CUDA. The CUDA context must be
+// current.
+static bool ext_vk_buf_create(struct ra_hwdec_mapper *mapper,
+                              struct ext_vk_buf *e)
+{
+    struct priv *p = mapper->priv;
+    int mem_fd = -1, sem_fd = -1;
+    size_t mem_size = 0;
+
+    *e = (struct ext_vk_buf){0};
+
+    struct ra_buf_params params = {
+        .type = RA_BUF_TYPE_TEX_UPLOAD,
+        .size = p->buf_size,
+    };
+    e->buf = ra_vk_buf_create_exported(mapper->ra, &params, &mem_fd, &mem_size);
+    if (!e->buf)
+        goto error;
+
+    CUDA_EXTERNAL_MEMORY_HANDLE_DESC mem_desc = {
+        .type = CU_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD,
+        .handle.fd = mem_fd,
+        .size = mem_size,
+    };
+    if (CHECK_CU(cuImportExternalMemory(&e->mem, &mem_desc)) < 0)
+        goto error;
+    mem_fd = -1; // owned by CUDA now
+
+    CUDA_EXTERNAL_MEMORY_BUFFER_DESC buf_desc = {
+        .size = p->buf_size,
+    };
+    if (CHECK_CU(cuExternalMemoryGetMappedBuffer(&e->ptr, e->mem, &buf_desc)) < 0)
+        goto error;
+
+    e->sem = ra_vk_create_exported_sem(mapper->ra, &sem_fd);
+    if (!e->sem)
+        goto error;
+
+    CUDA_EXTERNAL_SEMAPHORE_HANDLE_DESC sem_desc = {
+        .type = CU_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD,
+        .handle.fd = sem_fd,
+    };
+    if (CHECK_CU(cuImportExternalSemaphore(&e->cu_sem, &sem_desc)) < 0)
+        goto error;
+    sem_fd = -1;
+
+    return true;
+
+error:
+    MP_ERR(mapper, "Failed to create CUDA/Vulkan shared buffer.\n");
+    if (mem_fd >= 0)
+        close(mem_fd);
+    if (sem_fd >= 0)
+        close(sem_fd);
+    ext_vk_buf_destroy(mapper, e);
+    return false;
+}
+
+// Return a buffer not in use by the GPU anymore. The CUDA context must be
+// current.
+static struct ext_vk_buf *ext_vk_buf_get(struct ra_hwdec_mapper *mapper)
+{
+    struct priv *p = mapper->priv;
+    struct ra *ra = mapper->ra;
+
+    for (int n = 0; n < p->num_vk_bufs; n++) {
+        struct ext_vk_buf *e = &p->vk_bufs[n];
+        if (!ra->fns->buf_poll || ra->fns->buf_poll(ra, e->buf))
+            return e;
+    }
+
+    struct ext_vk_buf e;
+    if (!ext_vk_buf_create(mapper, &e))
+        return NULL;
+    MP_TARRAY_APPEND(p, p->vk_bufs, p->num_vk_bufs, e);
+    MP_VERBOSE(mapper, "Using %d shared buffers.\n", p->num_vk_bufs);
+    return &p->vk_bufs[p->num_vk_bufs - 1];
+}
+
+static int mapper_map_vk(struct ra_hwdec_mapper *mapper)
+{
+    struct priv *p = mapper->priv;
+    struct ra *ra = mapper->ra;
+
+    struct ext_vk_buf *e = ext_vk_buf_get(mapper);
+    if (!e)
+        return -1;
+
+    for (int n = 0; n < p->layout.num_planes; n++) {
+        CUDA_MEMCPY2D cpy = {
+            .srcMemoryType = CU_MEMORYTYPE_DEVICE,
+            .dstMemoryType = CU_MEMORYTYPE_DEVICE,
+            .srcDevice     = (CUdeviceptr)mapper->src->planes[n],
+            .srcPitch      = mapper->src->stride[n],
+            .dstDevice     = e->ptr + p->plane_offset[n],
+            .dstPitch      = p->plane_stride[n],
+            .WidthInBytes  = mp_image_plane_w(&p->layout, n) *
+                             mapper->tex[n]->params.format->pixel_size,
+            .Height        = mp_image_plane_h(&p->layout, n),
+        };
+        if (CHECK_CU(cuMemcpy2DAsync(&cpy, 0)) < 0)
+            return -1;
+    }
+
+    CUDA_EXTERNAL_SEMAPHORE_SIGNAL_PARAMS sig = {0};
+    if (CHECK_CU(cuSignalExternalSemaphoresAsync(&e->cu_sem, &sig, 1, 0)) < 0)
+        return -1;
+
+    // All planes are uploaded with the same command, so the first upload
+    // waiting on the semaphore is enough.
+    ra_tex_vk_external_dep(ra, mapper->tex[0], e->sem);
+
+    for (int n = 0; n < p->layout.num_planes; n++) {
+        struct ra_tex_upload_params params = {
+            .tex = mapper->tex[n],
+            .invalidate = true,
+            .buf = e->buf,
+            .buf_offset = p->plane_offset[n],
+            .stride = p->plane_stride[n],
+        };
+        if (!ra->fns->tex_upload(ra, &params))
+            return -1;
+    }
+
+    return 0;
+}
+#endif
+
 static int mapper_init(struct ra_hwdec_mapper *mapper)
 {
     struct priv_owner *p_owner = mapper->owner->priv;
@@ -227,6 +457,7 @@ static int mapper_init(struct ra_hwdec_mapper *mapper)
             .format = format,
             .render_src = true,
             .src_linear = format->linear_filter,
+            .host_mutable = p_owner->is_vk,
         };
 
         mapper->tex[n] = ra_tex_create(mapper->ra, &params);
@@ -235,6 +466,16 @@ static int mapper_init(struct ra_hwdec_mapper *mapper)
             goto error;
         }
 
+        if (p_owner->is_vk) {
+#if HAVE_VULKAN
+            // Keep lines and planes aligned for the buffer->image copy.
+            p->plane_stride[n] = MP_ALIGN_UP(params.w, 64) * format->pixel_size;
+            p->plane_offset[n] = p->buf_size;
+            p->buf_size += MP_ALIGN_UP(p->plane_stride[n] * params.h, 4096);
+#endif
+            continue;
+        }
+
         GLuint texture;
         GLenum target;
         ra_gl_get_raw_tex(mapper->ra, mapper->tex[n], &texture, &target);
@@ -273,6 +514,15 @@ static void mapper_uninit(struct ra_hwdec_mapper *mapper)
 
     // Don't bail if any CUDA calls fail. This is all best effort.
     CHECK_CU(cuCtxPushCurrent(p->display_ctx));
+#if HAVE_VULKAN
+    if (p->num_vk_bufs) {
+        // The GPU may still be reading from the buffers.
+        CHECK_CU(cuCtxSynchronize());
+        for (int n = 0; n < p->num_vk_bufs; n++)
+            ext_vk_buf_destroy(mapper, &p->vk_bufs[n]);
+        p->num_vk_bufs = 0;
+    }
+#endif
     for (int n = 0; n < 4; n++) {
         if (p->cu_res[n] > 0)
             CHECK_CU(cuGraphicsUnregisterResource(p->cu_res[n]));
@@ -288,6 +538,7 @@ static void mapper_unmap(struct ra_hwdec_mapper *mapper)
 
 static int mapper_map(struct ra_hwdec_mapper *mapper)
 {
+    struct priv_owner *p_owner = mapper->owner->priv;
     struct priv *p = mapper->priv;
     CUcontext dummy;
     int ret = 0, eret = 0;
@@ -296,6 +547,13 @@ static int mapper_map(struct ra_hwdec_mapper *mapper)
     if (ret < 0)
         return ret;
 
+    if (p_owner->is_vk) {
+#if HAVE_VULKAN
+        ret = mapper_map_vk(mapper);
+#endif
+        goto error;
+    }
+
     for (int n = 0; n < p->layout.num_planes; n++) {
         CUDA_MEMCPY2D cpy = {
             .srcMemoryType = CU_MEMORYTYPE_DEVICE,
@@ -6,13 +6,35 @@
 
 static struct ra_fns ra_fns_gl;
 
+// Minimum size of the PBO upload ring. It's grown so that it can hold at
+// least RING_MIN_UPLOADS uploads of the largest size seen.
+#define RING_MIN_SIZE (16 * 1024 * 1024)
+#define RING_MIN_UPLOADS 4
+#define RING_ALIGN 256
+
+struct ring_fence {
+    size_t start, end;  // byte range of the ring in use by the fenced commands
+    GLsync fence;
+};
+
 // For ra.priv
 struct ra_gl {
     GL *gl;
     bool debug_enable;
     bool timer_active; // hack for GL_TIME_ELAPSED limitations
+
+    // Persistently mapped ring buffer for PBO uploads (ra.use_pbo, GL 4.4+)
+    struct ra_buf *ring;
+    size_t ring_pos;
+    struct ring_fence *ring_fences; // oldest first
+    int num_ring_fences;
+    bool ring_failed;
 };
 
+static void gl_buf_destroy(struct ra *ra, struct ra_buf *buf);
+static struct ra_buf *gl_buf_create(struct ra *ra,
+                                    const struct ra_buf_params *params);
+
 // For ra_tex.priv
 struct ra_tex_gl {
     struct ra_buf_pool pbo; // for ra.use_pbo
@@ -196,6 +218,8 @@ static int ra_init_gl(struct ra *ra, GL *gl)
     if (ra->caps & RA_CAP_COMPUTE) {
         gl->GetIntegerv(GL_MAX_COMPUTE_SHARED_MEMORY_SIZE, &ival);
         ra->max_shmem = ival;
+        gl->GetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &ival);
+        ra->max_compute_group_threads = ival;
     }
 
     gl->Disable(GL_DITHER);
@@ -217,8 +241,22 @@ struct ra *ra_create_gl(GL *gl, struct mp_log *log)
     return ra;
 }
 
+static void ring_uninit(struct ra *ra)
+{
+    struct ra_gl *p = ra->priv;
+    GL *gl = p->gl;
+
+    for (int n = 0; n < p->num_ring_fences; n++)
+        gl->DeleteSync(p->ring_fences[n].fence);
+    p->num_ring_fences = 0;
+    gl_buf_destroy(ra, p->ring);
+    p->ring = NULL;
+    p->ring_pos = 0;
+}
+
 static void gl_destroy(struct ra *ra)
 {
+    ring_uninit(ra);
     talloc_free(ra->priv);
 }
 
@@ -448,10 +486,77 @@ bool ra_is_gl(struct ra *ra)
     return ra->fns == &ra_fns_gl;
 }
 
+// Reserve size bytes in the upload ring, and return the offset, or -1 if the
+// ring is not available, or if the space is still in use by the GPU. Never
+// blocks; the caller is supposed to use a different upload path instead.
+static ptrdiff_t ring_alloc(struct ra *ra, size_t size)
+{
+    struct ra_gl *p = ra->priv;
+    GL *gl = p->gl;
+
+    if (p->ring_failed)
+        return -1;
+
+    size_t want = MPMAX(RING_MIN_SIZE, size * RING_MIN_UPLOADS);
+    if (!p->ring || p->ring->params.size < size * RING_MIN_UPLOADS) {
+        // GL keeps the old buffer alive until pending commands are done.
+        ring_uninit(ra);
+        p->ring = gl_buf_create(ra, &(struct ra_buf_params){
+            .type = RA_BUF_TYPE_TEX_UPLOAD,
+            .size = want,
+            .host_mapped = true,
+        });
+        if (!p->ring) {
+            MP_VERBOSE(ra, "Persistently mapped PBO ring not available.\n");
+            p->ring_failed = true;
+            return -1;
+        }
+        MP_VERBOSE(ra, "Allocated PBO ring of %zu bytes.\n", want);
+    }
+
+    // Retire fences the GPU is done with (they complete in order).
+    while (p->num_ring_fences) {
+        GLsync fence = p->ring_fences[0].fence;
+        GLenum res = gl->ClientWaitSync(fence, 0, 0); // non-blocking
+        if (res != GL_ALREADY_SIGNALED && res != GL_CONDITION_SATISFIED)
+            break;
+        gl->DeleteSync(fence);
+        MP_TARRAY_REMOVE_AT(p->ring_fences, p->num_ring_fences, 0);
+    }
+
+    size_t pos = MP_ALIGN_UP(p->ring_pos, RING_ALIGN);
+    if (pos + size > p->ring->params.size)
+        pos = 0;
+
+    for (int n = 0; n < p->num_ring_fences; n++) {
+        struct ring_fence *f = &p->ring_fences[n];
+        if (pos < f->end && f->start < pos + size)
+            return -1;
+    }
+
+    p->ring_pos = pos + size;
+    return pos;
+}
+
+// Fence the ring range returned by the last ring_alloc() call.
+static void ring_fence(struct ra *ra, size_t start, size_t size)
+{
+    struct ra_gl *p = ra->priv;
+    GL *gl = p->gl;
+
+    struct ring_fence f = {
+        .start = start,
+        .end = start + size,
+        .fence = gl->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0),
+    };
+    MP_TARRAY_APPEND(p, p->ring_fences, p->num_ring_fences, f);
+}
+
 static bool gl_tex_upload(struct ra *ra,
                           const struct ra_tex_upload_params *params)
 {
     GL *gl = ra_gl_get(ra);
+    struct ra_gl *p = ra->priv;
     struct ra_tex *tex = params->tex;
     struct ra_buf *buf = params->buf;
     struct ra_tex_gl *tex_gl = tex->priv;
@@ -459,8 +564,31 @@ static bool gl_tex_upload(struct ra *ra,
     assert(tex->params.host_mutable);
     assert(!params->buf || !params->src);
 
-    if (ra->use_pbo && !params->buf)
-        return ra_tex_upload_pbo(ra, &tex_gl->pbo, params);
+    if (ra->use_pbo && !params->buf) {
+        // Copy the data straight into the mapped ring if there is space. This
+        // avoids the extra copy and implicit synchronization of
+        // glBufferSubData(). Otherwise, use the per-texture buffer pool.
+        size_t row_size = tex->params.dimensions == 2 ? params->stride :
+                          tex->params.w * tex->params.format->pixel_size;
+        int height = tex->params.h;
+        if (tex->params.dimensions == 2 && params->rc)
+            height = mp_rect_h(*params->rc);
+        size_t size = row_size * height * tex->params.d;
+
+        ptrdiff_t offset = ring_alloc(ra, size);
+        if (offset < 0)
+            return ra_tex_upload_pbo(ra, &tex_gl->pbo, params);
+
+        memcpy((char *)p->ring->data + offset, params->src, size);
+
+        struct ra_tex_upload_params newparams = *params;
+        newparams.buf = p->ring;
+        newparams.buf_offset = offset;
+        newparams.src = NULL;
+        bool ok = gl_tex_upload(ra, &newparams);
+        ring_fence(ra, offset, size);
+        return ok;
+    }
 
     const void *src = params->src;
     if (buf) {
@@ -499,7 +627,7 @@ static bool gl_tex_upload(struct ra *ra,
 
     if (buf) {
         gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-        if (buf->params.host_mapped) {
+        if (buf->params.host_mapped && buf != p->ring) {
             // Make sure the PBO is not reused until GL is done with it. If a
             // previous operation is pending, "update" it by creating a new
             // fence that will cover the previous operation as well.
@@ -41,6 +41,7 @@
 #include "options/m_config.h"
 #include "common/msg.h"
 #include "common/global.h"
+#include "common/stats.h"
 #include "video/hwdec.h"
 #include "video/mp_image.h"
 #include "sub/osd.h"
@@ -52,7 +53,7 @@ extern const struct vo_driver video_out_x11;
 extern const struct vo_driver video_out_vdpau;
 extern const struct vo_driver video_out_xv;
 extern const struct vo_driver video_out_gpu;
-extern const struct vo_driver video_out_opengl_cb;
+extern const struct vo_driver video_out_libmpv;
 extern const struct vo_driver video_out_null;
 extern const struct vo_driver video_out_image;
 extern const struct vo_driver video_out_lavc;
@@ -104,15 +105,14 @@ const struct vo_driver *const video_out_drivers[] =
 #if HAVE_ENCODING
     &video_out_lavc,
 #endif
-#if HAVE_GL
-    &video_out_opengl_cb,
-#endif
+    &video_out_libmpv,
     NULL
 };
 
 struct vo_internal {
     pthread_t thread;
     struct mp_dispatch_queue *dispatch;
+    struct stats_ctx *stats;
 
     atomic_ullong dr_in_flight;
 
@@ -160,6 +160,13 @@ struct vo_internal {
 
     bool rendering;                 // true if an image is being rendered
     struct vo_frame *frame_queued;  // should be drawn next
+    // With --video-render-ahead, display-synced frames queued after
+    // frame_queued. They're moved to frame_queued one by one, once the
+    // current frame has used up its vsyncs.
+    struct vo_frame **ahead_frames;
+    int num_ahead_frames;
+    int render_ahead;               // max. num_ahead_frames
+    int timing_spin;                // busy-wait this many us before a flip
     int req_frames;                 // VO's requested value of num_frames
     uint64_t current_frame_id;
 
@@ -167,6 +174,14 @@ struct vo_internal {
     int opt_framedrop;
 };
 
+// Number of frames an untimed VO (encoding) can have queued beyond the one
+// being rendered. Decoding and filtering can run ahead of the encoder this way.
+#define UNTIMED_QUEUE_FRAMES 4
+
+// Wait for the last part of a timed flip with mp_sleep_until_us() rather than
+// a condvar timeout (microseconds).
+#define VO_PRECISE_WAIT_US 2000
+
 extern const struct m_sub_options gl_video_conf;
 
 static void forget_frames(struct vo *vo);
@@ -185,7 +200,7 @@ static bool get_desc(struct m_obj_desc *dst, int index)
         .options = vo->options,
         .options_prefix = vo->options_prefix,
         .global_opts = vo->global_opts,
-        .hidden = vo->encode || !strcmp(vo->name, "opengl-cb"),
+        .hidden = vo->encode || !strcmp(vo->name, "libmpv"),
         .p = vo,
     };
     return true;
@@ -199,6 +214,7 @@ const struct m_obj_list vo_obj_list = {
         {"gl", "gpu"},
         {"direct3d_shaders", "direct3d"},
         {"opengl", "gpu"},
+        {"opengl-cb", "libmpv"},
         {0}
     },
     .allow_unknown_entries = true,
@@ -218,6 +234,11 @@ static void update_opts(void *p)
     struct vo *vo = p;
 
     if (m_config_cache_update(vo->opts_cache)) {
+        pthread_mutex_lock(&vo->in->lock);
+        vo->in->render_ahead = vo->opts->render_ahead;
+        vo->in->timing_spin = vo->opts->timing_spin;
+        pthread_mutex_unlock(&vo->in->lock);
+
         // "Legacy" update of video position related options.
         if (vo->driver->control)
             vo->driver->control(vo, VOCTRL_SET_PANSCAN, NULL);
@@ -280,15 +301,19 @@ static struct vo *vo_create(bool probing, struct mpv_global *global,
     talloc_steal(vo, log);
     *vo->in = (struct vo_internal) {
         .dispatch = mp_dispatch_create(vo),
+        .stats = stats_ctx_create(vo, global, "vo"),
         .req_frames = 1,
         .estimated_vsync_jitter = -1,
     };
     mp_dispatch_set_wakeup_fn(vo->in->dispatch, dispatch_wakeup_cb, vo);
+    mp_dispatch_set_stats(vo->in->dispatch, vo->in->stats);
     pthread_mutex_init(&vo->in->lock, NULL);
     pthread_cond_init(&vo->in->wakeup, NULL);
 
     vo->opts_cache = m_config_cache_alloc(NULL, global, &vo_sub_opts);
     vo->opts = vo->opts_cache->opts;
+    vo->in->render_ahead = vo->opts->render_ahead;
+    vo->in->timing_spin = vo->opts->timing_spin;
 
     m_config_cache_set_dispatch_change_cb(vo->opts_cache, vo->in->dispatch,
                                           update_opts, vo);
@@ -465,11 +490,15 @@ static void vsync_skip_detection(struct vo *vo)
 }
 
 // Always called locked.
-static void update_vsync_timing_after_swap(struct vo *vo)
+static void update_vsync_timing_after_swap(struct vo *vo,
+                                           struct vo_vsync_info *vsync)
 {
     struct vo_internal *in = vo->in;
 
-    int64_t now = mp_time_us();
+    // With presentation feedback, use the real display time of the frame
+    // instead of the time the swap call returned, which is much noisier.
+    int64_t now = vsync->last_queue_display_time > 0
+                ? vsync->last_queue_display_time : mp_time_us();
     int64_t prev_vsync = in->prev_vsync;
 
     in->prev_vsync = now;
@@ -503,7 +532,15 @@ static void update_vsync_timing_after_swap(struct vo *vo)
         vsync_stddef(vo, in->vsync_interval) / in->vsync_interval;
 
     check_estimated_display_fps(vo);
-    vsync_skip_detection(vo);
+    if (vsync->skipped_vsyncs < 0) {
+        vsync_skip_detection(vo);
+    } else if (vsync->skipped_vsyncs > 0) {
+        // The driver told us, so there is no need to guess.
+        in->base_vsync = in->prev_vsync;
+        in->delayed_count += vsync->skipped_vsyncs;
+        in->drop_point = 0;
+        MP_STATS(vo, "vo-delayed");
+    }
 
     MP_STATS(vo, "value %f jitter", in->estimated_vsync_jitter);
     MP_STATS(vo, "value %f vsync-diff", in->vsync_samples[0] / 1e6);
@@ -654,6 +691,9 @@ static void forget_frames(struct vo *vo)
     in->delayed_count = 0;
     talloc_free(in->frame_queued);
     in->frame_queued = NULL;
+    for (int n = 0; n < in->num_ahead_frames; n++)
+        talloc_free(in->ahead_frames[n]);
+    in->num_ahead_frames = 0;
     in->current_frame_id += VO_MAX_REQ_FRAMES + 1;
     // don't unref current_frame; we always want to be able to redraw it
     if (in->current_frame) {
@@ -721,13 +761,43 @@ void vo_wakeup(struct vo *vo)
 // callback once the time is right.
 // If next_pts is negative, disable any timing and draw the frame as fast as
 // possible.
+// Whether the VO can take a display-synced frame (or any frame, if the VO is
+// untimed) although it still has frames to show. Must be called locked.
+static bool can_queue_ahead(struct vo *vo)
+{
+    struct vo_internal *in = vo->in;
+    if (vo->driver->untimed)
+        return in->num_ahead_frames < UNTIMED_QUEUE_FRAMES;
+    if (in->num_ahead_frames >= in->render_ahead)
+        return false;
+    struct vo_frame *last = in->num_ahead_frames
+        ? in->ahead_frames[in->num_ahead_frames - 1]
+        : (in->frame_queued ? in->frame_queued : in->current_frame);
+    return last && last->display_synced;
+}
+
+// Move the next render-ahead frame to frame_queued, if the current frame is
+// done. Must be called locked.
+static void promote_ahead_frame(struct vo *vo)
+{
+    struct vo_internal *in = vo->in;
+    if (!in->num_ahead_frames || in->frame_queued ||
+        (in->current_frame && in->current_frame->num_vsyncs > 0))
+        return;
+    in->frame_queued = in->ahead_frames[0];
+    MP_TARRAY_REMOVE_AT(in->ahead_frames, in->num_ahead_frames, 0);
+}
+
 bool vo_is_ready_for_frame(struct vo *vo, int64_t next_pts)
 {
     struct vo_internal *in = vo->in;
     pthread_mutex_lock(&in->lock);
-    bool r = vo->config_ok && !in->frame_queued &&
-             (!in->current_frame || in->current_frame->num_vsyncs < 1);
-    if (r && next_pts >= 0) {
+    bool free_slot = !in->frame_queued && !in->num_ahead_frames &&
+                     (!in->current_frame || in->current_frame->num_vsyncs < 1);
+    bool untimed = vo->driver->untimed;
+    bool r = vo->config_ok &&
+             (free_slot || ((next_pts < 0 || untimed) && can_queue_ahead(vo)));
+    if (r && next_pts >= 0 && !untimed) {
         // Don't show the frame too early - it would basically freeze the
         // display by disallowing OSD redrawing or VO interaction.
         // Actually render the frame at earliest 50ms before target time.
@@ -753,13 +823,22 @@ bool vo_is_ready_for_frame(struct vo *vo, int64_t next_pts)
 void vo_queue_frame(struct vo *vo, struct vo_frame *frame)
 {
     struct vo_internal *in = vo->in;
+    stats_event(in->stats, "queue-frame");
     pthread_mutex_lock(&in->lock);
-    assert(vo->config_ok && !in->frame_queued &&
-           (!in->current_frame || in->current_frame->num_vsyncs < 1));
+    bool free_slot = !in->frame_queued && !in->num_ahead_frames &&
+                     (!in->current_frame || in->current_frame->num_vsyncs < 1);
+    bool untimed = vo->driver->untimed;
+    assert(vo->config_ok && (free_slot ||
+                             ((frame->display_synced || untimed) &&
+                              can_queue_ahead(vo))));
     in->hasframe = true;
     frame->frame_id = ++(in->current_frame_id);
-    in->frame_queued = frame;
-    in->wakeup_pts = frame->display_synced
+    if (free_slot) {
+        in->frame_queued = frame;
+    } else {
+        MP_TARRAY_APPEND(in, in->ahead_frames, in->num_ahead_frames, frame);
+    }
+    in->wakeup_pts = frame->display_synced || untimed
                    ? 0 : frame->pts + MPMAX(frame->duration, 0);
     wakeup_locked(vo);
     pthread_mutex_unlock(&in->lock);
@@ -771,7 +850,7 @@ void vo_wait_frame(struct vo *vo)
 {
     struct vo_internal *in = vo->in;
     pthread_mutex_lock(&in->lock);
-    while (in->frame_queued || in->rendering)
+    while (in->frame_queued || in->num_ahead_frames || in->rendering)
         pthread_cond_wait(&in->wakeup, &in->lock);
     pthread_mutex_unlock(&in->lock);
 }
@@ -781,15 +860,23 @@ void vo_wait_frame(struct vo *vo)
 static void wait_until(struct vo *vo, int64_t target)
 {
     struct vo_internal *in = vo->in;
-    struct timespec ts = mp_time_us_to_timespec(target);
+    // The condvar wait can be interrupted by events, but its timeout goes
+    // through CLOCK_REALTIME and tends to overshoot. So use it only for the
+    // coarse part, and sleep precisely for the last bit.
+    int64_t coarse = target - VO_PRECISE_WAIT_US;
+    struct timespec ts = mp_time_us_to_timespec(coarse);
     pthread_mutex_lock(&in->lock);
-    while (target > mp_time_us()) {
+    while (coarse > mp_time_us()) {
         if (in->queued_events & VO_EVENT_LIVE_RESIZING)
             break;
         if (pthread_cond_timedwait(&in->wakeup, &in->lock, &ts))
             break;
     }
+    bool resizing = in->queued_events & VO_EVENT_LIVE_RESIZING;
+    int64_t spin = in->timing_spin;
     pthread_mutex_unlock(&in->lock);
+    if (!resizing)
+        mp_sleep_until_us(target, spin);
 }
 
 bool vo_render_frame_external(struct vo *vo)
@@ -828,7 +915,8 @@ bool vo_render_frame_external(struct vo *vo)
     int64_t end_time = pts + duration;
 
     // Time at which we should flip_page on the VO.
-    int64_t target = frame->display_synced ? 0 : pts - in->flip_queue_offset;
+    int64_t target = frame->display_synced || vo->driver->untimed
+                   ? 0 : pts - in->flip_queue_offset;
 
     // "normal" strict drop threshold.
     in->dropped_frame = duration >= 0 && end_time < now;
@@ -850,6 +938,7 @@ bool vo_render_frame_external(struct vo *vo)
     }
     if (in->current_frame->num_vsyncs > 0)
         in->current_frame->num_vsyncs -= 1;
+    promote_ahead_frame(vo);
 
     bool use_vsync = in->current_frame->display_synced && !in->paused;
     if (use_vsync && !in->expecting_vsync) // first DS frame in a row
@@ -867,6 +956,7 @@ bool vo_render_frame_external(struct vo *vo)
         wakeup_core(vo); // core can queue new video now
 
         MP_STATS(vo, "start video-draw");
+        stats_time_start(in->stats, "draw");
 
         if (vo->driver->draw_frame) {
             vo->driver->draw_frame(vo, frame);
@@ -874,21 +964,31 @@ bool vo_render_frame_external(struct vo *vo)
             vo->driver->draw_image(vo, mp_image_new_ref(frame->current));
         }
 
+        stats_time_end(in->stats, "draw");
         MP_STATS(vo, "end video-draw");
 
         wait_until(vo, target);
 
         MP_STATS(vo, "start video-flip");
+        stats_time_start(in->stats, "flip");
 
         vo->driver->flip_page(vo);
 
+        stats_time_end(in->stats, "flip");
         MP_STATS(vo, "end video-flip");
 
+        struct vo_vsync_info vsync = {
+            .last_queue_display_time = -1,
+            .skipped_vsyncs = -1,
+        };
+        if (vo->driver->get_vsync)
+            vo->driver->get_vsync(vo, &vsync);
+
         pthread_mutex_lock(&in->lock);
         in->dropped_frame = prev_drop_count < vo->in->drop_count;
         in->rendering = false;
 
-        update_vsync_timing_after_swap(vo);
+        update_vsync_timing_after_swap(vo, &vsync);
     }
 
     if (vo->driver->caps & VO_CAP_NOREDRAW) {
@@ -898,6 +998,7 @@ bool vo_render_frame_external(struct vo *vo)
 
     if (in->dropped_frame) {
         MP_STATS(vo, "drop-vo");
+        stats_event(in->stats, "drop");
     } else {
         in->request_redraw = false;
     }
@@ -999,6 +1100,7 @@ static void *vo_thread(void *ptr)
     bool vo_paused = false;
 
     mpthread_set_name("vo");
+    mpthread_apply_opts(vo->global, vo->log, "vo");
 
     int r = vo->driver->preinit(vo) ? -1 : 0;
     mp_rendezvous(vo, r); // init barrier
@@ -1019,9 +1121,12 @@ static void *vo_thread(void *ptr)
         else
             drop_unrendered_frame(vo);
         int64_t now = mp_time_us();
-        int64_t wait_until = now + (working ? 0 : (int64_t)1e9);
 
         pthread_mutex_lock(&in->lock);
+        // VOs that can wait for window events don't need to poll while
+        // paused (and with nothing to display there's nothing to time).
+        int64_t idle_wait = in->paused && vo->driver->wait_events ? 10e6 : 1e6;
+        int64_t wait_until = now + (working ? 0 : idle_wait);
         if (in->wakeup_pts) {
             if (in->wakeup_pts > now) {
                 wait_until = MPMIN(wait_until, in->wakeup_pts);
@@ -1140,7 +1245,8 @@ bool vo_still_displaying(struct vo *vo)
         if (in->current_frame->display_synced)
             frame_end = in->current_frame->num_vsyncs > 0 ? INT64_MAX : 0;
     }
-    bool working = now < frame_end || in->rendering || in->frame_queued;
+    bool working = now < frame_end || in->rendering || in->frame_queued ||
+                   in->num_ahead_frames;
     pthread_mutex_unlock(&vo->in->lock);
     return working && in->hasframe;
 }
@@ -1247,12 +1353,17 @@ double vo_get_delay(struct vo *vo)
 {
     struct vo_internal *in = vo->in;
     pthread_mutex_lock(&in->lock);
-    assert (!in->frame_queued);
     int64_t res = 0;
     if (in->base_vsync && in->vsync_interval > 1 && in->current_frame) {
         res = in->base_vsync;
         int extra = !!in->rendering;
-        res += (in->current_frame->num_vsyncs + extra) * in->vsync_interval;
+        int64_t num_vsyncs = in->current_frame->num_vsyncs + extra;
+        // Frames queued with render-ahead are shown before the next one.
+        if (in->frame_queued)
+            num_vsyncs += in->frame_queued->num_vsyncs;
+        for (int n = 0; n < in->num_ahead_frames; n++)
+            num_vsyncs += in->ahead_frames[n]->num_vsyncs;
+        res += num_vsyncs * in->vsync_interval;
         if (!in->current_frame->display_synced)
             res = 0;
     }
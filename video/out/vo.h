@@ -103,6 +103,9 @@ enum mp_voctrl {
 
     // Retrieve window contents. (Normal screenshots use vo_get_current_frame().)
     VOCTRL_SCREENSHOT_WIN,              // struct mp_image**
+    // Like VOCTRL_SCREENSHOT_WIN, but pipelined. See struct
+    // voctrl_screenshot_delayed.
+    VOCTRL_SCREENSHOT_WIN_DELAYED,
 
     VOCTRL_UPDATE_RENDER_OPTS,
 
@@ -111,6 +114,8 @@ enum mp_voctrl {
     VOCTRL_GET_DISPLAY_FPS,             // double*
 
     VOCTRL_GET_PREF_DEINT,              // int*
+    // Deinterlace in the VO; returns VO_TRUE if the VO will do it.
+    VOCTRL_SET_DEINTERLACE,             // int*
 
     /* private to vo_gpu */
     VOCTRL_EXTERNAL_RESIZE,
@@ -145,6 +150,16 @@ struct voctrl_playback_state {
     int percent_pos;
 };
 
+// VOCTRL_SCREENSHOT_WIN_DELAYED
+struct voctrl_screenshot_delayed {
+    // in: start reading back the current window contents
+    bool start;
+    // in: block until the oldest pending readback has completed
+    bool wait;
+    // out: oldest completed readback (if any), owned by the caller
+    struct mp_image *res;
+};
+
 // VOCTRL_PERFORMANCE_DATA
 #define VO_PERF_SAMPLE_COUNT 256
 
@@ -190,7 +205,6 @@ struct vo_extra {
     struct input_ctx *input_ctx;
     struct osd_state *osd;
     struct encode_lavc_context *encode_lavc_ctx;
-    struct mpv_opengl_cb_context *opengl_cb_context;
     void (*wakeup_cb)(void *ctx);
     void *wakeup_ctx;
 };
@@ -244,6 +258,17 @@ struct vo_frame {
     uint64_t frame_id;
 };
 
+// Presentation feedback. See get_vsync() callbacks. Values are -1 if unknown.
+struct vo_vsync_info {
+    // Estimated mp_time_us() at which the last queued frame will be (or was)
+    // displayed.
+    int64_t last_queue_display_time;
+
+    // Number of vsyncs at which a new frame was expected, but the previous
+    // one was still shown, since the last get_vsync() call.
+    int64_t skipped_vsyncs;
+};
+
 struct vo_driver {
     // Encoding functionality, which can be invoked via --o only.
     bool encode;
@@ -305,6 +330,9 @@ struct vo_driver {
      * Currently, the returned image must have exactly 1 AVBufferRef set, for
      * internal implementation simplicity.
      *
+     * If the renderer lives on a thread other than the VO thread, dr_helper.h
+     * can be used to run the allocation (and freeing) on that thread.
+     *
      * returns: an allocated, refcounted image; if NULL is returned, the caller
      * will silently fallback to a default allocator
      */
@@ -332,6 +360,13 @@ struct vo_driver {
      */
     void (*flip_page)(struct vo *vo);
 
+    /*
+     * Return presentation feedback for the frames flipped so far. The
+     * fields are preset to -1, and only known ones need to be set. Optional.
+     * Called after flip_page().
+     */
+    void (*get_vsync)(struct vo *vo, struct vo_vsync_info *info);
+
     /* These optional callbacks can be provided if the GUI framework used by
      * the VO requires entering a message loop for receiving events and does
      * not call vo_wakeup() from a separate thread when there are new events.
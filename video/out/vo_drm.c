@@ -25,8 +25,13 @@
 
 #include <libswscale/swscale.h>
 
+#include "config.h"
 #include "drm_common.h"
 
+#if HAVE_DRMPRIME
+#include "drm_prime.h"
+#endif
+
 #include "common/msg.h"
 #include "osdep/timer.h"
 #include "sub/osd.h"
@@ -49,7 +54,15 @@ struct framebuffer {
     uint32_t handle;
     uint8_t *map;
     uint32_t fb;
+    uint32_t fb_alpha; // same buffer as ARGB, for use on top of the overlay
+};
+
+#if HAVE_DRMPRIME
+struct drm_frame {
+    struct drm_prime_framebuffer fb;
+    struct mp_image *image; // associated mpv image
 };
+#endif
 
 struct priv {
     char *connector_spec;
@@ -75,6 +88,19 @@ struct priv {
     struct mp_rect dst;
     struct mp_osd_res osd;
     struct mp_sws_context *sws;
+
+#if HAVE_DRMPRIME
+    // Zero-copy mode: IMGFMT_DRMPRIME frames are scanned out directly on the
+    // overlay plane, and the primary plane carries only the OSD.
+    bool prime;
+    drmModeAtomicReq *request;
+    // current_frame is on screen (or will be after the pending flip),
+    // old_frame is kept until the flip away from it has completed.
+    struct drm_frame current_frame, old_frame;
+    // frame referenced by request, becomes current_frame on commit
+    struct drm_frame next_frame;
+    bool prime_supported;
+#endif
 };
 
 static void fb_destroy(int fd, struct framebuffer *buf)
@@ -85,6 +111,9 @@ static void fb_destroy(int fd, struct framebuffer *buf)
     if (buf->fb) {
         drmModeRmFB(fd, buf->fb);
     }
+    if (buf->fb_alpha) {
+        drmModeRmFB(fd, buf->fb_alpha);
+    }
     if (buf->handle) {
         struct drm_mode_destroy_dumb dreq = {
             .handle = buf->handle,
@@ -118,6 +147,11 @@ static bool fb_setup_single(struct vo *vo, int fd, struct framebuffer *buf)
         goto err;
     }
 
+    // depth 32 selects ARGB8888; it's fine if the driver doesn't support it
+    if (drmModeAddFB(fd, buf->width, buf->height, 32, creq.bpp, buf->stride,
+                     buf->handle, &buf->fb_alpha))
+        buf->fb_alpha = 0;
+
     // prepare buffer for memory mapping
     struct drm_mode_map_dumb mreq = {
         .handle = buf->handle,
@@ -204,6 +238,15 @@ static void crtc_release(struct vo *vo)
         }
     }
 
+#if HAVE_DRMPRIME
+    // restoring the CRTC doesn't touch the other planes
+    if (p->prime) {
+        struct drm_atomic_context *atomic = p->kms->atomic_context;
+        drmModeSetPlane(p->kms->fd, atomic->overlay_plane->id,
+                        p->kms->crtc_id, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    }
+#endif
+
     if (p->old_crtc) {
         drmModeSetCrtc(p->kms->fd, p->old_crtc->crtc_id,
                        p->old_crtc->buffer_id,
@@ -262,6 +305,39 @@ static void wakeup(struct vo *vo)
         vt_switcher_interrupt_poll(&p->vt_switcher);
 }
 
+#if HAVE_DRMPRIME
+// Takes over the framebuffer and image reference in frame.
+static void set_current_frame(struct vo *vo, struct drm_frame *frame)
+{
+    struct priv *p = vo->priv;
+
+    // old_frame was replaced on screen by current_frame with the last flip,
+    // which has completed by now.
+    drm_prime_destroy_framebuffer(vo->log, p->kms->fd, &p->old_frame.fb);
+    talloc_free(p->old_frame.image);
+
+    p->old_frame = p->current_frame;
+    if (frame) {
+        p->current_frame = *frame;
+        *frame = (struct drm_frame){0};
+    } else {
+        p->current_frame = (struct drm_frame){0};
+    }
+}
+
+static void free_next_frame(struct vo *vo)
+{
+    struct priv *p = vo->priv;
+
+    drm_prime_destroy_framebuffer(vo->log, p->kms->fd, &p->next_frame.fb);
+    mp_image_unrefp(&p->next_frame.image);
+    if (p->request) {
+        drmModeAtomicFree(p->request);
+        p->request = NULL;
+    }
+}
+#endif
+
 static int reconfig(struct vo *vo, struct mp_image_params *params)
 {
     struct priv *p = vo->priv;
@@ -270,6 +346,36 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
     vo->dheight = p->screen_h;
     vo_get_src_dst_rects(vo, &p->src, &p->dst, &p->osd);
 
+    struct framebuffer *buf = p->bufs;
+
+#if HAVE_DRMPRIME
+    // The display controller scales the video on the overlay plane, and the
+    // OSD is drawn on the whole primary plane, which is transparent elsewhere.
+    bool was_prime = p->prime;
+    p->prime = params->imgfmt == IMGFMT_DRMPRIME;
+    if (was_prime && !p->prime && p->active) {
+        // Legacy page flips can't change the pixel format of the primary
+        // plane, so go back to the XRGB buffer with a full modeset.
+        struct drm_atomic_context *atomic = p->kms->atomic_context;
+        drmModeSetPlane(p->kms->fd, atomic->overlay_plane->id,
+                        p->kms->crtc_id, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        drmModeSetCrtc(p->kms->fd, p->kms->crtc_id, p->bufs[p->front_buf].fb,
+                       0, 0, &p->kms->connector->connector_id, 1,
+                       &p->kms->mode);
+        free_next_frame(vo);
+        set_current_frame(vo, NULL);
+        set_current_frame(vo, NULL);
+    }
+    if (p->prime) {
+        talloc_free(p->cur_frame);
+        p->cur_frame = mp_image_alloc(IMGFMT_BGRA, p->screen_w, p->screen_h);
+        for (unsigned int i = 0; i < BUF_COUNT; i++)
+            memset(buf[i].map, 0, buf[i].size);
+        vo->want_redraw = true;
+        return 0;
+    }
+#endif
+
     int w = p->dst.x1 - p->dst.x0;
     int h = p->dst.y1 - p->dst.y0;
 
@@ -298,7 +404,6 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
     mp_image_params_guess_csp(&p->sws->dst);
     mp_image_set_params(p->cur_frame, &p->sws->dst);
 
-    struct framebuffer *buf = p->bufs;
     for (unsigned int i = 0; i < BUF_COUNT; i++)
         memset(buf[i].map, 0, buf[i].size);
 
@@ -309,10 +414,86 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
     return 0;
 }
 
+#if HAVE_DRMPRIME
+static void draw_image_prime(struct vo *vo, mp_image_t *mpi)
+{
+    struct priv *p = vo->priv;
+    struct drm_atomic_context *atomic = p->kms->atomic_context;
+
+    free_next_frame(vo);
+
+    uint32_t fb_id = 0;
+    if (mpi && p->current_frame.image &&
+        mpi->planes[0] == p->current_frame.image->planes[0])
+    {
+        // redraw, the frame is already on the overlay
+        fb_id = p->current_frame.fb.fb_id;
+    } else if (mpi) {
+        AVDRMFrameDescriptor *desc = (AVDRMFrameDescriptor *)mpi->planes[0];
+        if (drm_prime_create_framebuffer(vo->log, p->kms->fd, desc,
+                                         mpi->w, mpi->h, &p->next_frame.fb))
+        {
+            MP_ERR(vo, "Failed to create framebuffer for frame.\n");
+        } else {
+            p->next_frame.image = mp_image_new_ref(mpi);
+            fb_id = p->next_frame.fb.fb_id;
+        }
+    }
+
+    p->request = drmModeAtomicAlloc();
+    if (!p->request) {
+        MP_ERR(vo, "Failed to allocate atomic request.\n");
+        free_next_frame(vo);
+        return;
+    }
+
+    struct drm_object *overlay = atomic->overlay_plane;
+    if (fb_id) {
+        int srcw = p->src.x1 - p->src.x0;
+        int srch = p->src.y1 - p->src.y0;
+        int dstw = MP_ALIGN_UP(p->dst.x1 - p->dst.x0, 2);
+        int dsth = MP_ALIGN_UP(p->dst.y1 - p->dst.y0, 2);
+
+        drm_object_set_property(p->request, overlay, "FB_ID",   fb_id);
+        drm_object_set_property(p->request, overlay, "CRTC_ID", atomic->crtc->id);
+        drm_object_set_property(p->request, overlay, "SRC_X",   p->src.x0 << 16);
+        drm_object_set_property(p->request, overlay, "SRC_Y",   p->src.y0 << 16);
+        drm_object_set_property(p->request, overlay, "SRC_W",   srcw << 16);
+        drm_object_set_property(p->request, overlay, "SRC_H",   srch << 16);
+        drm_object_set_property(p->request, overlay, "CRTC_X",  MP_ALIGN_DOWN(p->dst.x0, 2));
+        drm_object_set_property(p->request, overlay, "CRTC_Y",  MP_ALIGN_DOWN(p->dst.y0, 2));
+        drm_object_set_property(p->request, overlay, "CRTC_W",  dstw);
+        drm_object_set_property(p->request, overlay, "CRTC_H",  dsth);
+        drm_object_set_property(p->request, overlay, "ZPOS",    0);
+    } else {
+        drm_object_set_property(p->request, overlay, "FB_ID",   0);
+        drm_object_set_property(p->request, overlay, "CRTC_ID", 0);
+    }
+
+    // The OSD is rendered with alpha and put on the primary plane, which
+    // therefore has to be updated even if nothing is shown.
+    struct framebuffer *front_buf = &p->bufs[p->front_buf];
+    mp_image_clear(p->cur_frame, 0, 0, p->cur_frame->w, p->cur_frame->h);
+    osd_draw_on_image(vo->osd, p->osd, mpi ? mpi->pts : 0, 0, p->cur_frame);
+    memcpy_pic(front_buf->map, p->cur_frame->planes[0],
+               p->screen_w * BYTES_PER_PIXEL, p->screen_h, front_buf->stride,
+               p->cur_frame->stride[0]);
+
+    struct drm_object *primary = atomic->primary_plane;
+    drm_object_set_property(p->request, primary, "FB_ID",   front_buf->fb_alpha);
+    drm_object_set_property(p->request, primary, "CRTC_ID", atomic->crtc->id);
+}
+#endif
+
 static void draw_image(struct vo *vo, mp_image_t *mpi)
 {
     struct priv *p = vo->priv;
 
+#if HAVE_DRMPRIME
+    if (p->active && p->prime) {
+        draw_image_prime(vo, mpi);
+    } else
+#endif
     if (p->active) {
         if (mpi) {
             struct mp_image src = *mpi;
@@ -350,9 +531,25 @@ static void flip_page(struct vo *vo)
     if (!p->active || p->pflip_happening)
         return;
 
-    int ret = drmModePageFlip(p->kms->fd, p->kms->crtc_id,
+    int ret;
+#if HAVE_DRMPRIME
+    if (p->prime) {
+        ret = -1;
+        if (p->request) {
+            ret = drmModeAtomicCommit(p->kms->fd, p->request,
+                        DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT, p);
+            drmModeAtomicFree(p->request);
+            p->request = NULL;
+        }
+        if (!ret)
+            set_current_frame(vo, &p->next_frame);
+    } else
+#endif
+    {
+        ret = drmModePageFlip(p->kms->fd, p->kms->crtc_id,
                               p->bufs[p->front_buf].fb,
                               DRM_MODE_PAGE_FLIP_EVENT, p);
+    }
     if (ret) {
         MP_WARN(vo, "Cannot flip page for connector\n");
     } else {
@@ -382,6 +579,14 @@ static void uninit(struct vo *vo)
 
     crtc_release(vo);
 
+#if HAVE_DRMPRIME
+    if (p->kms) {
+        free_next_frame(vo);
+        set_current_frame(vo, NULL);
+        set_current_frame(vo, NULL);
+    }
+#endif
+
     if (p->kms) {
         for (unsigned int i = 0; i < BUF_COUNT; i++)
             fb_destroy(p->kms->fd, &p->bufs[i]);
@@ -435,6 +640,14 @@ static int preinit(struct vo *vo)
     p->screen_w = p->bufs[0].width;
     p->screen_h = p->bufs[0].height;
 
+#if HAVE_DRMPRIME
+    uint64_t has_prime;
+    p->prime_supported = p->kms->atomic_context && p->bufs[0].fb_alpha &&
+        drmGetCap(p->kms->fd, DRM_CAP_PRIME, &has_prime) >= 0 && has_prime;
+    if (p->prime_supported)
+        MP_VERBOSE(vo, "Using overlay plane for DRM prime frames.\n");
+#endif
+
     if (!crtc_setup(vo)) {
         MP_ERR(vo, "Cannot set CRTC: %s\n", mp_strerror(errno));
         goto err;
@@ -449,6 +662,11 @@ err:
 
 static int query_format(struct vo *vo, int format)
 {
+#if HAVE_DRMPRIME
+    struct priv *p = vo->priv;
+    if (format == IMGFMT_DRMPRIME)
+        return p->prime_supported;
+#endif
     return sws_isSupportedInput(imgfmt2pixfmt(format));
 }
 
@@ -457,6 +675,11 @@ static int control(struct vo *vo, uint32_t request, void *arg)
     struct priv *p = vo->priv;
     switch (request) {
     case VOCTRL_SCREENSHOT_WIN:
+#if HAVE_DRMPRIME
+        // the video isn't part of our buffers
+        if (p->prime)
+            break;
+#endif
         *(struct mp_image**)arg = mp_image_new_copy(p->cur_frame);
         return VO_TRUE;
     case VOCTRL_REDRAW_FRAME:
@@ -85,6 +85,8 @@ static void draw_frame(struct vo *vo, struct vo_frame *frame)
         return;
 
     gl_video_render_frame(p->renderer, frame, fbo);
+    if (gl_video_compile_pending(p->renderer))
+        vo->want_redraw = true;
     if (!sw->fns->submit_frame(sw, frame)) {
         MP_ERR(vo, "Failed presenting frame!\n");
         return;
@@ -98,6 +100,14 @@ static void flip_page(struct vo *vo)
     sw->fns->swap_buffers(sw);
 }
 
+static void get_vsync(struct vo *vo, struct vo_vsync_info *info)
+{
+    struct gpu_priv *p = vo->priv;
+    struct ra_swapchain *sw = p->ctx->swapchain;
+    if (sw->fns->get_vsync)
+        sw->fns->get_vsync(sw, info);
+}
+
 static int query_format(struct vo *vo, int format)
 {
     struct gpu_priv *p = vo->priv;
@@ -119,18 +129,22 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
     return 0;
 }
 
-static void request_hwdec_api(struct vo *vo)
+static void request_hwdec_api(struct vo *vo, int imgfmt)
 {
     struct gpu_priv *p = vo->priv;
 
-    gl_video_load_hwdecs_all(p->renderer, vo->hwdec_devs);
+    if (imgfmt) {
+        gl_video_load_hwdecs_for_img_fmt(p->renderer, vo->hwdec_devs, imgfmt);
+    } else {
+        gl_video_load_hwdecs_all(p->renderer, vo->hwdec_devs);
+    }
 }
 
-static void call_request_hwdec_api(void *ctx)
+static void call_request_hwdec_api(void *ctx, int imgfmt)
 {
     // Roundabout way to run hwdec loading on the VO thread.
     // Redirects to request_hwdec_api().
-    vo_control(ctx, VOCTRL_LOAD_HWDEC_API, NULL);
+    vo_control(ctx, VOCTRL_LOAD_HWDEC_API, &imgfmt);
 }
 
 static void get_and_update_icc_profile(struct gpu_priv *p)
@@ -188,8 +202,27 @@ static int control(struct vo *vo, uint32_t request, void *data)
         *(struct mp_image **)data = screen;
         return true;
     }
+    case VOCTRL_SCREENSHOT_WIN_DELAYED: {
+        struct voctrl_screenshot_delayed *args = data;
+        if (!sw->fns->screenshot_start || !sw->fns->screenshot_fetch)
+            break;
+        args->res = sw->fns->screenshot_fetch(sw, args->wait);
+        if (args->start && !sw->fns->screenshot_start(sw)) {
+            // Possibly too many readbacks in flight; make room and retry.
+            if (!args->res)
+                args->res = sw->fns->screenshot_fetch(sw, true);
+            if (!sw->fns->screenshot_start(sw)) {
+                talloc_free(args->res);
+                args->res = NULL;
+                return VO_FALSE;
+            }
+        }
+        if (args->res)
+            args->res->params.color = gl_video_get_output_colorspace(p->renderer);
+        return VO_TRUE;
+    }
     case VOCTRL_LOAD_HWDEC_API:
-        request_hwdec_api(vo);
+        request_hwdec_api(vo, *(int *)data);
         return true;
     case VOCTRL_UPDATE_RENDER_OPTS: {
         gl_video_configure_queue(p->renderer, vo);
@@ -204,6 +237,10 @@ static int control(struct vo *vo, uint32_t request, void *data)
         if (gl_video_showing_interpolated_frame(p->renderer))
             vo->want_redraw = true;
         break;
+    case VOCTRL_SET_DEINTERLACE:
+        vo->want_redraw = true;
+        return gl_video_set_deinterlace(p->renderer, *(int *)data)
+               ? VO_TRUE : VO_FALSE;
     case VOCTRL_PERFORMANCE_DATA:
         gl_video_perfdata(p->renderer, (struct voctrl_performance_data *)data);
         return true;
@@ -331,6 +368,7 @@ const struct vo_driver video_out_gpu = {
     .get_image = get_image,
     .draw_frame = draw_frame,
     .flip_page = flip_page,
+    .get_vsync = get_vsync,
     .wait_events = wait_events,
     .wakeup = wakeup,
     .uninit = uninit,
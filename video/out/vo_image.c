@@ -20,8 +20,10 @@
 #include <string.h>
 #include <math.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <sys/stat.h>
 
+#include <libavutil/cpu.h>
 #include <libswscale/swscale.h>
 
 #include "config.h"
@@ -32,6 +34,7 @@
 #include "mpv_talloc.h"
 #include "common/common.h"
 #include "common/msg.h"
+#include "misc/thread_pool.h"
 #include "video/out/vo.h"
 #include "video/csputils.h"
 #include "video/mp_image.h"
@@ -50,6 +53,7 @@ static const struct m_sub_options image_writer_conf = {
 struct vo_image_opts {
     struct image_writer_opts *opts;
     char *outdir;
+    int threads;
 };
 
 #define OPT_BASE_STRUCT struct vo_image_opts
@@ -58,18 +62,78 @@ static const struct m_sub_options vo_image_conf = {
     .opts = (const struct m_option[]) {
         OPT_SUBSTRUCT("vo-image", opts, image_writer_conf, 0),
         OPT_STRING("vo-image-outdir", outdir, M_OPT_FILE),
+        OPT_CHOICE_OR_INT("vo-image-threads", threads, 0, 1, 64,
+                          ({"auto", 0})),
         {0},
     },
     .size = sizeof(struct vo_image_opts),
 };
 
+#define MAX_AUTO_THREADS 16
+#define MAX_QUEUED_PER_THREAD 2
+
+struct image_job {
+    char *filename;
+    struct mp_image *img;
+    bool done, ok;          // protected by priv.lock
+};
+
 struct priv {
     struct vo_image_opts *opts;
 
     struct mp_image *current;
     int frame;
+
+    struct mp_thread_pool *pool;
+    int num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    struct image_job **jobs;    // oldest first
+    int num_jobs;
+};
+
+struct job_ctx {
+    struct vo *vo;
+    struct image_job *job;
 };
 
+static void write_job(void *arg)
+{
+    struct job_ctx *ctx = arg;
+    struct vo *vo = ctx->vo;
+    struct priv *p = vo->priv;
+    struct image_job *job = ctx->job;
+    talloc_free(ctx);
+
+    bool ok = write_image(job->img, p->opts->opts, job->filename, vo->log);
+
+    pthread_mutex_lock(&p->lock);
+    job->done = true;
+    job->ok = ok;
+    pthread_cond_broadcast(&p->wakeup);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Wait until at most max_jobs are left in the queue. Jobs are retired in frame
+// order, so errors are reported in the order the frames were queued.
+static void retire_jobs(struct vo *vo, int max_jobs)
+{
+    struct priv *p = vo->priv;
+    pthread_mutex_lock(&p->lock);
+    while (p->num_jobs > max_jobs) {
+        struct image_job *job = p->jobs[0];
+        if (!job->done) {
+            pthread_cond_wait(&p->wakeup, &p->lock);
+            continue;
+        }
+        if (!job->ok)
+            MP_ERR(vo, "Failed to write %s\n", job->filename);
+        MP_TARRAY_REMOVE_AT(p->jobs, p->num_jobs, 0);
+        talloc_free(job);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
 static bool checked_mkdir(struct vo *vo, const char *buf)
 {
     MP_INFO(vo, "Creating output directory '%s'...\n", buf);
@@ -120,7 +184,26 @@ static void flip_page(struct vo *vo)
         filename = mp_path_join(t, p->opts->outdir, filename);
 
     MP_INFO(vo, "Saving %s\n", filename);
-    write_image(p->current, p->opts->opts, filename, vo->log);
+
+    if (p->pool) {
+        // Bound the number of full size images waiting to be written.
+        retire_jobs(vo, p->num_threads * MAX_QUEUED_PER_THREAD - 1);
+
+        struct image_job *job = talloc_zero(NULL, struct image_job);
+        job->filename = talloc_strdup(job, filename);
+        job->img = talloc_steal(job, p->current);
+        p->current = NULL;
+
+        pthread_mutex_lock(&p->lock);
+        MP_TARRAY_APPEND(p, p->jobs, p->num_jobs, job);
+        pthread_mutex_unlock(&p->lock);
+
+        struct job_ctx *ctx = talloc_ptrtype(NULL, ctx);
+        *ctx = (struct job_ctx){vo, job};
+        mp_thread_pool_queue(p->pool, write_job, ctx);
+    } else {
+        write_image(p->current, p->opts->opts, filename, vo->log);
+    }
 
     talloc_free(t);
     mp_image_unrefp(&p->current);
@@ -137,15 +220,29 @@ static void uninit(struct vo *vo)
 {
     struct priv *p = vo->priv;
 
+    retire_jobs(vo, 0);
+    // Joins the workers.
+    talloc_free(p->pool);
+    pthread_cond_destroy(&p->wakeup);
+    pthread_mutex_destroy(&p->lock);
+
     mp_image_unrefp(&p->current);
 }
 
 static int preinit(struct vo *vo)
 {
     struct priv *p = vo->priv;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wakeup, NULL);
     p->opts = mp_get_config_group(vo, vo->global, &vo_image_conf);
     if (p->opts->outdir && !checked_mkdir(vo, p->opts->outdir))
         return -1;
+    p->num_threads = p->opts->threads;
+    if (!p->num_threads)
+        p->num_threads = MPCLAMP(av_cpu_count(), 1, MAX_AUTO_THREADS);
+    // With 1 thread, write the images directly, as it doesn't help much.
+    if (p->num_threads > 1)
+        p->pool = mp_thread_pool_create(vo, p->num_threads);
     return 0;
 }
 
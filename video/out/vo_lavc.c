@@ -144,6 +144,11 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
         goto error;
     }
 
+    if (IMGFMT_IS_HWACCEL(params->imgfmt)) {
+        MP_VERBOSE(vo, "Encoding %s hardware frames directly.\n",
+                   mp_imgfmt_to_name(params->imgfmt));
+    }
+
     if (encode_lavc_alloc_stream(vo->encode_lavc_ctx,
                                  AVMEDIA_TYPE_VIDEO,
                                  &vc->stream, &vc->codec) < 0)
@@ -157,7 +162,10 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
     encode_lavc_set_csp(vo->encode_lavc_ctx, vc->codec, params->color.space);
     encode_lavc_set_csp_levels(vo->encode_lavc_ctx, vc->codec, params->color.levels);
 
-    if (encode_lavc_open_codec(vo->encode_lavc_ctx, vc->codec) < 0)
+    // Hardware encoders need the hw frames context, which is known only once
+    // the first frame arrives. open_hw_codec() opens the codec then.
+    if (!IMGFMT_IS_HWACCEL(params->imgfmt) &&
+        encode_lavc_open_codec(vo->encode_lavc_ctx, vc->codec) < 0)
         goto error;
 
 done:
@@ -235,22 +243,31 @@ static void write_packet(struct vo *vo, AVPacket *packet)
     vc->have_first_packet = 1;
 }
 
-static void encode_video_and_write(struct vo *vo, AVFrame *frame)
+// Returns false if encoding was aborted, and vc->codec must not be used.
+static bool encode_video_and_write(struct vo *vo, AVFrame *frame)
 {
     struct priv *vc = vo->priv;
     AVPacket packet = {0};
 
+    encode_lavc_begin_encode(vo->encode_lavc_ctx);
     int status = avcodec_send_frame(vc->codec, frame);
+    if (!encode_lavc_end_encode(vo->encode_lavc_ctx))
+        return false;
     if (status < 0) {
         MP_ERR(vo, "error encoding at %d %d/%d\n",
                frame ? (int) frame->pts : -1,
                vc->codec->time_base.num,
                vc->codec->time_base.den);
-        return;
+        return true;
     }
     for (;;) {
         av_init_packet(&packet);
+        encode_lavc_begin_encode(vo->encode_lavc_ctx);
         status = avcodec_receive_packet(vc->codec, &packet);
+        if (!encode_lavc_end_encode(vo->encode_lavc_ctx)) {
+            av_packet_unref(&packet);
+            return false;
+        }
         if (status == AVERROR(EAGAIN)) { // No more packets for now.
             if (frame == NULL) {
                 MP_ERR(vo, "sent flush frame, got EAGAIN");
@@ -274,6 +291,23 @@ static void encode_video_and_write(struct vo *vo, AVFrame *frame)
         write_packet(vo, &packet);
         av_packet_unref(&packet);
     }
+    return true;
+}
+
+// Open the encoder with the hw frames context of the first hardware frame, so
+// that surfaces are passed to it without a download/upload.
+static bool open_hw_codec(struct vo *vo, struct mp_image *mpi)
+{
+    struct priv *vc = vo->priv;
+
+    if (!mpi->hwctx) {
+        MP_FATAL(vo, "Hardware frame without frames context.\n");
+        return false;
+    }
+    vc->codec->hw_frames_ctx = av_buffer_ref(mpi->hwctx);
+    if (!vc->codec->hw_frames_ctx)
+        return false;
+    return encode_lavc_open_codec(vo->encode_lavc_ctx, vc->codec) >= 0;
 }
 
 static void draw_image_unlocked(struct vo *vo, mp_image_t *mpi)
@@ -286,7 +320,8 @@ static void draw_image_unlocked(struct vo *vo, mp_image_t *mpi)
 
     double pts = mpi ? mpi->pts : MP_NOPTS_VALUE;
 
-    if (mpi) {
+    // Subtitles can't be drawn on hardware surfaces.
+    if (mpi && !IMGFMT_IS_HWACCEL(mpi->imgfmt)) {
         assert(vo->params);
 
         struct mp_osd_res dim = osd_res_from_image_params(vo->params);
@@ -296,6 +331,12 @@ static void draw_image_unlocked(struct vo *vo, mp_image_t *mpi)
 
     if (!vc || vc->shutdown)
         goto done;
+    if (mpi && !avcodec_is_open(vc->codec)) {
+        if (!open_hw_codec(vo, mpi)) {
+            vc->shutdown = true;
+            goto done;
+        }
+    }
     if (!encode_lavc_start(ectx)) {
         MP_WARN(vo, "NOTE: skipped initial video frame (probably because audio is not there yet)\n");
         goto done;
@@ -436,8 +477,10 @@ static void draw_image_unlocked(struct vo *vo, mp_image_t *mpi)
                                           vc->worst_time_base, avc->time_base);
                 frame->pict_type = 0; // keep this at unknown/undefined
                 frame->quality = avc->global_quality;
-                encode_video_and_write(vo, frame);
+                bool ok = encode_video_and_write(vo, frame);
                 av_frame_free(&frame);
+                if (!ok)
+                    goto done;
 
                 ++vc->lastdisplaycount;
                 vc->lastencodedipts = vc->lastipts + skipframes;
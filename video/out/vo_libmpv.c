@@ -0,0 +1,679 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "config.h"
+
+#include "mpv_talloc.h"
+#include "common/common.h"
+#include "misc/bstr.h"
+#include "common/msg.h"
+#include "options/m_config.h"
+#include "options/options.h"
+#include "aspect.h"
+#include "dr_helper.h"
+#include "vo.h"
+#include "video/mp_image.h"
+#include "sub/osd.h"
+#include "osdep/atomic.h"
+#include "osdep/timer.h"
+#include "misc/dispatch.h"
+
+#include "common/global.h"
+#include "player/client.h"
+
+#include "libmpv.h"
+
+/*
+ * mpv_render_context is managed by the host application - the host application
+ * can access it any time, even if the VO is destroyed (or not created yet).
+ *
+ * - the libmpv user can mix render API and normal API; thus render API
+ *   functions can wait on the core, but not the reverse
+ * - the core does blocking calls into the VO thread, thus the VO functions
+ *   can't wait on the user calling the API functions
+ * - to make video timing work like it should, the VO thread waits on the
+ *   render API user anyway, and the (unlikely) deadlock is avoided with
+ *   a timeout
+ * - direct rendering (--vd-lavc-dr) allocates buffers on the API user's
+ *   thread, so the VO thread waits on it there too (again with a timeout).
+ *   This is only enabled with MPV_RENDER_PARAM_ADVANCED_CONTROL, where the
+ *   API user promises to process these requests in mpv_render_context_update().
+ */
+
+struct vo_priv {
+    struct mpv_render_context *ctx;
+};
+
+// State of one MPV_RENDER_PARAM_VIEW index. The need_* flags of the context
+// are propagated to all views on rendering.
+struct render_view {
+    int vp_w, vp_h;
+    bool need_resize;
+    bool need_reconfig;
+    bool need_reset;
+    bool need_update_external;
+};
+
+struct mpv_render_context {
+    struct mp_log *log;
+    struct mpv_global *global;
+    struct mp_client_api *client_api;
+
+    atomic_bool in_use;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+
+    // --- Protected by lock
+    mpv_render_update_fn update_cb;
+    void *update_cb_ctx;
+    struct vo_frame *next_frame;    // next frame to draw
+    int64_t present_count;          // incremented when next frame can be shown
+    int64_t expected_flip_count;    // next vsync event for next_frame
+    bool redrawing;                 // next_frame was a redraw request
+    int64_t flip_count;
+    struct vo_frame *cur_frame;
+    struct mp_image_params img_params;
+    struct render_view views[MP_RENDER_MAX_VIEWS];
+    bool imgfmt_supported[IMGFMT_END - IMGFMT_START];
+    bool need_reconfig;
+    bool need_resize;
+    bool need_reset;
+    bool need_update_external;
+    bool dr_request;                // dispatch needs to be processed
+    struct vo *vo;
+
+    // --- Immutable after init
+    bool advanced_control;
+    struct mp_dispatch_queue *dispatch; // DR requests and frees
+    struct dr_helper *dr;               // only with advanced_control
+    struct mp_hwdec_devices *hwdec_devs;
+
+    // --- All of these can only be accessed from mpv_render_*() API, for
+    //     which the user makes sure they're called synchronized.
+    struct render_backend *renderer;
+    struct m_config_cache *vo_opts_cache;
+    struct mp_vo_opts *vo_opts;
+};
+
+static const struct render_backend_fns *render_backends[] = {
+    &render_backend_gpu,
+    NULL
+};
+
+static void update(struct mpv_render_context *ctx);
+
+void *get_mpv_render_param(mpv_render_param *params, mpv_render_param_type type,
+                           void *def)
+{
+    for (int n = 0; params && params[n].type; n++) {
+        if (params[n].type == type)
+            return params[n].data;
+    }
+    return def;
+}
+
+static void forget_frames(struct mpv_render_context *ctx, bool all)
+{
+    pthread_cond_broadcast(&ctx->wakeup);
+    if (all) {
+        talloc_free(ctx->cur_frame);
+        ctx->cur_frame = NULL;
+    }
+}
+
+// Called on the API user's thread (via dr_helper).
+static struct mp_image *dr_get_image(void *ptr, int imgfmt, int w, int h,
+                                     int stride_align)
+{
+    struct mpv_render_context *ctx = ptr;
+    if (!ctx->renderer->fns->get_image)
+        return NULL;
+    return ctx->renderer->fns->get_image(ctx->renderer, imgfmt, w, h,
+                                         stride_align);
+}
+
+// Called on the VO thread, unlocked.
+static void dr_wakeup(void *ptr)
+{
+    struct mpv_render_context *ctx = ptr;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->dr_request = true;
+    update(ctx);
+    pthread_cond_broadcast(&ctx->wakeup);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+int mp_render_context_create(struct mpv_render_context **res,
+                             struct mpv_global *g, mpv_render_param *params)
+{
+    *res = NULL;
+
+    mpv_render_context *ctx = talloc_zero(NULL, mpv_render_context);
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->wakeup, NULL);
+    atomic_init(&ctx->in_use, false);
+
+    for (int n = 0; n < MP_RENDER_MAX_VIEWS; n++) {
+        ctx->views[n] = (struct render_view){
+            .need_resize = true,
+            .need_reconfig = true,
+            .need_reset = true,
+            .need_update_external = true,
+        };
+    }
+
+    ctx->global = g;
+    ctx->log = mp_log_new(ctx, g->log, "libmpv_render");
+    ctx->client_api = g->client_api;
+
+    ctx->vo_opts_cache = m_config_cache_alloc(ctx, ctx->global, &vo_sub_opts);
+    ctx->vo_opts = ctx->vo_opts_cache->opts;
+
+    ctx->dispatch = mp_dispatch_create(ctx);
+    ctx->advanced_control = GET_MPV_RENDER_PARAM(params,
+                            MPV_RENDER_PARAM_ADVANCED_CONTROL, int, 0);
+    if (ctx->advanced_control) {
+        ctx->dr = dr_helper_create(ctx, ctx->dispatch, dr_get_image, ctx,
+                                   dr_wakeup, ctx);
+    }
+
+    int err = MPV_ERROR_NOT_IMPLEMENTED;
+    for (int n = 0; render_backends[n]; n++) {
+        ctx->renderer = talloc_ptrtype(NULL, ctx->renderer);
+        *ctx->renderer = (struct render_backend){
+            .global = ctx->global,
+            .log = ctx->log,
+            .fns = render_backends[n],
+        };
+        err = ctx->renderer->fns->init(ctx->renderer, params);
+        if (err >= 0)
+            break;
+        ctx->renderer->fns->destroy(ctx->renderer);
+        TA_FREEP(&ctx->renderer);
+        if (err != MPV_ERROR_NOT_IMPLEMENTED)
+            break;
+    }
+
+    if (err < 0) {
+        mpv_render_context_free(ctx);
+        return err;
+    }
+
+    ctx->hwdec_devs = ctx->renderer->hwdec_devs;
+
+    for (int n = IMGFMT_START; n < IMGFMT_END; n++) {
+        ctx->imgfmt_supported[n - IMGFMT_START] =
+            ctx->renderer->fns->check_format(ctx->renderer, n);
+    }
+
+    if (!mp_set_main_render_context(ctx->client_api, ctx, true)) {
+        MP_ERR(ctx, "There is already a mpv_render_context in use.\n");
+        mpv_render_context_free(ctx);
+        return MPV_ERROR_GENERIC;
+    }
+
+    *res = ctx;
+    return 0;
+}
+
+int mpv_render_context_create(mpv_render_context **res, mpv_handle *mpv,
+                              mpv_render_param *params)
+{
+    return mp_render_context_create(res, mp_client_get_global(mpv), params);
+}
+
+void mpv_render_context_set_update_callback(mpv_render_context *ctx,
+                                            mpv_render_update_fn callback,
+                                            void *callback_ctx)
+{
+    pthread_mutex_lock(&ctx->lock);
+    ctx->update_cb = callback;
+    ctx->update_cb_ctx = callback_ctx;
+    update(ctx);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+void mpv_render_context_free(mpv_render_context *ctx)
+{
+    if (!ctx)
+        return;
+
+    // From here on, ctx becomes invisible and cannot be newly acquired. Only
+    // a VO could still hold a reference.
+    mp_set_main_render_context(ctx->client_api, ctx, false);
+
+    // If it's still in use, a VO using it must be active. Destroy the VO, and
+    // also bring down the decoder etc., which still might be using the hwdec
+    // context. The above removal guarantees it can't come back (so ctx->vo
+    // can't change to non-NULL).
+    if (atomic_load(&ctx->in_use))
+        kill_video(ctx->client_api);
+
+    assert(!atomic_load(&ctx->in_use));
+    assert(!ctx->vo);
+
+    // Free DR images released by the decoder.
+    mp_dispatch_queue_process(ctx->dispatch, 0);
+
+    forget_frames(ctx, true);
+    TA_FREEP(&ctx->next_frame);
+
+    if (ctx->renderer) {
+        ctx->renderer->fns->destroy(ctx->renderer);
+        talloc_free(ctx->renderer);
+    }
+
+    pthread_cond_destroy(&ctx->wakeup);
+    pthread_mutex_destroy(&ctx->lock);
+
+    talloc_free(ctx);
+}
+
+// Try to mark the context as "in exclusive use" (e.g. by a VO).
+// Note: the function must not acquire any locks, because it's called with an
+// external leaf lock held.
+bool mp_render_context_acquire(mpv_render_context *ctx)
+{
+    bool prev = false;
+    return atomic_compare_exchange_strong(&ctx->in_use, &prev, true);
+}
+
+int mpv_render_context_render(mpv_render_context *ctx, mpv_render_param *params)
+{
+    int view = GET_MPV_RENDER_PARAM(params, MPV_RENDER_PARAM_VIEW, int, 0);
+    if (view < 0 || view >= MP_RENDER_MAX_VIEWS)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    mp_dispatch_queue_process(ctx->dispatch, 0);
+
+    pthread_mutex_lock(&ctx->lock);
+
+    int vp_w, vp_h;
+    int err = ctx->renderer->fns->get_target_size(ctx->renderer, params,
+                                                  &vp_w, &vp_h);
+    if (err < 0) {
+        pthread_mutex_unlock(&ctx->lock);
+        return err;
+    }
+
+    ctx->dr_request = false;
+
+    for (int n = 0; n < MP_RENDER_MAX_VIEWS; n++) {
+        struct render_view *v = &ctx->views[n];
+        v->need_resize |= ctx->need_resize;
+        v->need_reconfig |= ctx->need_reconfig;
+        v->need_reset |= ctx->need_reset;
+        v->need_update_external |= ctx->need_update_external;
+    }
+    ctx->need_resize = false;
+    ctx->need_reconfig = false;
+    ctx->need_reset = false;
+    ctx->need_update_external = false;
+
+    struct vo *vo = ctx->vo;
+    struct render_view *rv = &ctx->views[view];
+
+    if (vo && (rv->vp_w != vp_w || rv->vp_h != vp_h || rv->need_resize)) {
+        rv->vp_w = vp_w;
+        rv->vp_h = vp_h;
+
+        m_config_cache_update(ctx->vo_opts_cache);
+
+        struct mp_rect src, dst;
+        struct mp_osd_res osd;
+        mp_get_src_dst_rects(ctx->log, ctx->vo_opts, vo->driver->caps,
+                             &ctx->img_params, vp_w, abs(vp_h),
+                             1.0, &src, &dst, &osd);
+
+        ctx->renderer->fns->resize(ctx->renderer, view, &src, &dst, &osd);
+    }
+    rv->need_resize = false;
+
+    if (rv->need_reconfig)
+        ctx->renderer->fns->reconfig(ctx->renderer, view, &ctx->img_params);
+    rv->need_reconfig = false;
+
+    if (rv->need_update_external)
+        ctx->renderer->fns->update_external(ctx->renderer, view, vo);
+    rv->need_update_external = false;
+
+    if (rv->need_reset) {
+        ctx->renderer->fns->reset(ctx->renderer, view);
+        if (ctx->cur_frame && view == 0)
+            ctx->cur_frame->still = true;
+    }
+    rv->need_reset = false;
+
+    // Only the main view consumes frames and is subject to video timing. The
+    // other views show whatever the main view rendered last.
+    struct vo_frame *frame = view == 0 ? ctx->next_frame : NULL;
+    int64_t wait_present_count = ctx->present_count;
+    if (frame) {
+        ctx->next_frame = NULL;
+        if (!(frame->redraw || !frame->current))
+            wait_present_count += 1;
+        pthread_cond_signal(&ctx->wakeup);
+        talloc_free(ctx->cur_frame);
+        ctx->cur_frame = vo_frame_ref(frame);
+    } else {
+        frame = vo_frame_ref(ctx->cur_frame);
+        if (frame)
+            frame->redraw = true;
+        MP_STATS(ctx, "glcb-noframe");
+    }
+    struct vo_frame dummy = {0};
+    if (!frame)
+        frame = &dummy;
+
+    pthread_mutex_unlock(&ctx->lock);
+
+    MP_STATS(ctx, "glcb-render");
+
+    err = 0;
+    if (!GET_MPV_RENDER_PARAM(params, MPV_RENDER_PARAM_SKIP_RENDERING, int, 0))
+        err = ctx->renderer->fns->render(ctx->renderer, view, params, frame);
+
+    if (frame != &dummy)
+        talloc_free(frame);
+
+    if (view == 0 &&
+        GET_MPV_RENDER_PARAM(params, MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME,
+                             int, 1))
+    {
+        pthread_mutex_lock(&ctx->lock);
+        while (wait_present_count > ctx->present_count) {
+            // The VO thread might be waiting for DR buffers before it can
+            // present the frame.
+            if (ctx->dr_request) {
+                ctx->dr_request = false;
+                pthread_mutex_unlock(&ctx->lock);
+                mp_dispatch_queue_process(ctx->dispatch, 0);
+                pthread_mutex_lock(&ctx->lock);
+                continue;
+            }
+            pthread_cond_wait(&ctx->wakeup, &ctx->lock);
+        }
+        pthread_mutex_unlock(&ctx->lock);
+    }
+
+    return err;
+}
+
+void mpv_render_context_report_swap(mpv_render_context *ctx)
+{
+    MP_STATS(ctx, "glcb-reportflip");
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->flip_count += 1;
+    pthread_cond_signal(&ctx->wakeup);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+uint64_t mpv_render_context_update(mpv_render_context *ctx)
+{
+    uint64_t res = 0;
+
+    mp_dispatch_queue_process(ctx->dispatch, 0);
+
+    pthread_mutex_lock(&ctx->lock);
+    if (ctx->next_frame)
+        res |= MPV_RENDER_UPDATE_FRAME;
+    pthread_mutex_unlock(&ctx->lock);
+    return res;
+}
+
+int mpv_render_context_set_parameter(mpv_render_context *ctx,
+                                     mpv_render_param param)
+{
+    if (!ctx->renderer->fns->set_parameter)
+        return MPV_ERROR_NOT_IMPLEMENTED;
+    return ctx->renderer->fns->set_parameter(ctx->renderer, param);
+}
+
+int mpv_render_context_get_info(mpv_render_context *ctx,
+                                mpv_render_param param)
+{
+    int res = MPV_ERROR_NOT_IMPLEMENTED;
+    pthread_mutex_lock(&ctx->lock);
+
+    switch (param.type) {
+    case MPV_RENDER_PARAM_NEXT_FRAME_INFO: {
+        mpv_render_frame_info *info = param.data;
+        *info = (mpv_render_frame_info){0};
+        struct vo_frame *frame = ctx->next_frame;
+        if (frame) {
+            info->flags =
+                MPV_RENDER_FRAME_INFO_PRESENT |
+                (frame->redraw ? MPV_RENDER_FRAME_INFO_REDRAW : 0) |
+                (frame->repeat ? MPV_RENDER_FRAME_INFO_REPEAT : 0) |
+                (frame->display_synced && !frame->redraw ?
+                    MPV_RENDER_FRAME_INFO_BLOCK_VSYNC : 0);
+            info->target_time = frame->pts;
+        }
+        res = 0;
+        break;
+    }
+    default:;
+    }
+
+    pthread_mutex_unlock(&ctx->lock);
+    return res;
+}
+
+// Called locked.
+static void update(struct mpv_render_context *ctx)
+{
+    if (ctx->update_cb)
+        ctx->update_cb(ctx->update_cb_ctx);
+}
+
+static void draw_frame(struct vo *vo, struct vo_frame *frame)
+{
+    struct vo_priv *p = vo->priv;
+    struct mpv_render_context *ctx = p->ctx;
+
+    pthread_mutex_lock(&ctx->lock);
+    assert(!ctx->next_frame);
+    ctx->next_frame = vo_frame_ref(frame);
+    ctx->expected_flip_count = ctx->flip_count + 1;
+    ctx->redrawing = frame->redraw || !frame->current;
+    update(ctx);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static void flip_page(struct vo *vo)
+{
+    struct vo_priv *p = vo->priv;
+    struct mpv_render_context *ctx = p->ctx;
+    struct timespec ts = mp_rel_time_to_timespec(0.2);
+
+    pthread_mutex_lock(&ctx->lock);
+
+    // Wait until frame was rendered
+    while (ctx->next_frame) {
+        if (pthread_cond_timedwait(&ctx->wakeup, &ctx->lock, &ts)) {
+            if (ctx->next_frame) {
+                MP_VERBOSE(vo, "mpv_render_context_render() not being called "
+                           "or stuck.\n");
+                goto done;
+            }
+        }
+    }
+
+    // Unblock mpv_render_context_render().
+    ctx->present_count += 1;
+    pthread_cond_signal(&ctx->wakeup);
+
+    if (ctx->redrawing)
+        goto done; // do not block for redrawing
+
+    // Wait until frame was presented
+    while (ctx->expected_flip_count > ctx->flip_count) {
+        // mpv_render_context_report_swap() is declared as optional API.
+        // Assume the user calls it consistently _if_ it's called at all.
+        if (!ctx->flip_count)
+            break;
+        if (pthread_cond_timedwait(&ctx->wakeup, &ctx->lock, &ts)) {
+            MP_VERBOSE(vo, "mpv_render_report_swap() not being called.\n");
+            goto done;
+        }
+    }
+
+done:
+
+    // Cleanup after the API user is not reacting, or is being unusually slow.
+    if (ctx->next_frame) {
+        talloc_free(ctx->cur_frame);
+        ctx->cur_frame = ctx->next_frame;
+        ctx->next_frame = NULL;
+        ctx->present_count += 2;
+        pthread_cond_signal(&ctx->wakeup);
+        vo_increment_drop_count(vo, 1);
+    }
+
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static int query_format(struct vo *vo, int format)
+{
+    struct vo_priv *p = vo->priv;
+    struct mpv_render_context *ctx = p->ctx;
+
+    bool ok = false;
+    pthread_mutex_lock(&ctx->lock);
+    if (format >= IMGFMT_START && format < IMGFMT_END)
+        ok = ctx->imgfmt_supported[format - IMGFMT_START];
+    pthread_mutex_unlock(&ctx->lock);
+    return ok;
+}
+
+static int reconfig(struct vo *vo, struct mp_image_params *params)
+{
+    struct vo_priv *p = vo->priv;
+    struct mpv_render_context *ctx = p->ctx;
+
+    pthread_mutex_lock(&ctx->lock);
+    forget_frames(ctx, true);
+    ctx->img_params = *params;
+    ctx->need_reconfig = true;
+    ctx->need_resize = true;
+    pthread_mutex_unlock(&ctx->lock);
+
+    return 0;
+}
+
+static int control(struct vo *vo, uint32_t request, void *data)
+{
+    struct vo_priv *p = vo->priv;
+    struct mpv_render_context *ctx = p->ctx;
+
+    switch (request) {
+    case VOCTRL_RESET:
+        pthread_mutex_lock(&ctx->lock);
+        forget_frames(ctx, false);
+        ctx->need_reset = true;
+        update(ctx);
+        pthread_mutex_unlock(&ctx->lock);
+        return VO_TRUE;
+    case VOCTRL_PAUSE:
+        vo->want_redraw = true;
+        return VO_TRUE;
+    case VOCTRL_SET_EQUALIZER:
+        vo->want_redraw = true;
+        return VO_TRUE;
+    case VOCTRL_SET_PANSCAN:
+        pthread_mutex_lock(&ctx->lock);
+        ctx->need_resize = true;
+        update(ctx);
+        pthread_mutex_unlock(&ctx->lock);
+        return VO_TRUE;
+    case VOCTRL_UPDATE_RENDER_OPTS:
+        pthread_mutex_lock(&ctx->lock);
+        ctx->need_update_external = true;
+        update(ctx);
+        pthread_mutex_unlock(&ctx->lock);
+        return VO_TRUE;
+    }
+
+    return VO_NOTIMPL;
+}
+
+static struct mp_image *get_image(struct vo *vo, int imgfmt, int w, int h,
+                                  int stride_align)
+{
+    struct vo_priv *p = vo->priv;
+    struct mpv_render_context *ctx = p->ctx;
+
+    if (!ctx->dr)
+        return NULL;
+
+    return dr_helper_get_image(ctx->dr, imgfmt, w, h, stride_align, 0.2);
+}
+
+static void uninit(struct vo *vo)
+{
+    struct vo_priv *p = vo->priv;
+    struct mpv_render_context *ctx = p->ctx;
+
+    pthread_mutex_lock(&ctx->lock);
+    forget_frames(ctx, true);
+    ctx->img_params = (struct mp_image_params){0};
+    ctx->need_reconfig = true;
+    ctx->need_resize = true;
+    ctx->need_update_external = true;
+    ctx->need_reset = true;
+    ctx->vo = NULL;
+    update(ctx);
+    pthread_mutex_unlock(&ctx->lock);
+
+    bool state = atomic_exchange(&ctx->in_use, false);
+    assert(state); // obviously must have been set
+}
+
+static int preinit(struct vo *vo)
+{
+    struct vo_priv *p = vo->priv;
+
+    struct mpv_render_context *ctx =
+        mp_client_api_acquire_render_context(vo->global->client_api);
+    p->ctx = ctx;
+
+    if (!ctx) {
+        if (!vo->probing)
+            MP_FATAL(vo, "No render context set.\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->vo = vo;
+    ctx->need_resize = true;
+    ctx->need_update_external = true;
+    pthread_mutex_unlock(&ctx->lock);
+
+    vo->hwdec_devs = ctx->hwdec_devs;
+
+    return 0;
+}
+
+const struct vo_driver video_out_libmpv = {
+    .description = "render API for libmpv",
+    .name = "libmpv",
+    .caps = VO_CAP_ROTATE90,
+    .preinit = preinit,
+    .query_format = query_format,
+    .reconfig = reconfig,
+    .control = control,
+    .get_image = get_image,
+    .draw_frame = draw_frame,
+    .flip_page = flip_page,
+    .uninit = uninit,
+    .priv_size = sizeof(struct vo_priv),
+};
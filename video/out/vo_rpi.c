@@ -31,6 +31,7 @@
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 
+#include <libavutil/buffer.h>
 #include <libavutil/rational.h>
 
 #include "common/common.h"
@@ -82,6 +83,7 @@ struct priv {
 
     // for RAM input
     MMAL_POOL_T *swpool;
+    struct dr_pool *dr_pool;    // tracks swpool buffers used by get_image()
 
     pthread_mutex_t display_mutex;
     pthread_cond_t display_cond;
@@ -102,6 +104,19 @@ struct priv {
 #define ALIGN_W 32
 #define ALIGN_H 16
 
+// Lets swpool outlive reconfig while decoders still hold images allocated by
+// get_image(). Only accessed on the VO thread.
+struct dr_pool {
+    MMAL_POOL_T *pool;
+    int refs;       // buffers taken by get_image() and not returned yet
+    bool retired;   // destroy pool once refs is 0
+};
+
+struct dr_ref {
+    struct dr_pool *pool;
+    MMAL_BUFFER_HEADER_T *buffer;
+};
+
 static void recreate_renderer(struct vo *vo);
 
 static void *get_proc_address(const GLubyte *name)
@@ -523,6 +538,96 @@ static void free_mmal_buffer(void *arg)
     mmal_buffer_header_release(buffer);
 }
 
+static void free_dr_buffer(void *opaque, uint8_t *data)
+{
+    struct dr_ref *ref = opaque;
+    struct dr_pool *pool = ref->pool;
+    mmal_buffer_header_release(ref->buffer);
+    talloc_free(ref);
+    pool->refs--;
+    if (pool->retired && !pool->refs) {
+        mmal_pool_destroy(pool->pool);
+        talloc_free(pool);
+    }
+}
+
+// Let the decoder write directly into the MMAL input buffers, so software
+// decoded frames don't need to be copied in draw_frame().
+static struct mp_image *get_image(struct vo *vo, int imgfmt, int w, int h,
+                                  int stride_align)
+{
+    struct priv *p = vo->priv;
+
+    if (!p->swpool || !vo->params || imgfmt != IMGFMT_420P ||
+        w != vo->params->w || h != vo->params->h)
+        return NULL;
+
+    struct mp_image_params params = *vo->params;
+    struct mp_image dmpi = {0};
+    layout_buffer(&dmpi, NULL, &params);
+    for (int n = 0; n < dmpi.num_planes; n++) {
+        if (dmpi.stride[n] % stride_align)
+            return NULL;
+    }
+
+    // Don't block; the decoder falls back to its own allocator.
+    MMAL_BUFFER_HEADER_T *buffer = mmal_queue_get(p->swpool->queue);
+    if (!buffer)
+        return NULL;
+    mmal_buffer_header_reset(buffer);
+    buffer->length = layout_buffer(&dmpi, buffer, &params);
+
+    for (int n = 0; n < dmpi.num_planes; n++) {
+        if ((uintptr_t)dmpi.planes[n] % stride_align) {
+            mmal_buffer_header_release(buffer);
+            return NULL;
+        }
+    }
+
+    struct dr_ref *ref = talloc_ptrtype(NULL, ref);
+    *ref = (struct dr_ref){p->dr_pool, buffer};
+
+    struct mp_image *mpi = mp_image_new_dummy_ref(&dmpi);
+    mpi->bufs[0] = av_buffer_create(buffer->data, buffer->alloc_size,
+                                    free_dr_buffer, ref, 0);
+    if (!mpi->bufs[0]) {
+        mmal_buffer_header_release(buffer);
+        talloc_free(ref);
+        talloc_free(mpi);
+        return NULL;
+    }
+    p->dr_pool->refs++;
+    return mpi;
+}
+
+// If mpi points to a swpool buffer allocated by get_image(), return it.
+static MMAL_BUFFER_HEADER_T *find_dr_buffer(struct vo *vo, struct mp_image *mpi)
+{
+    struct priv *p = vo->priv;
+
+    if (!p->swpool || mpi->imgfmt != IMGFMT_420P)
+        return NULL;
+
+    for (int n = 0; n < p->swpool->headers_num; n++) {
+        MMAL_BUFFER_HEADER_T *buffer = p->swpool->header[n];
+        if (buffer->data != mpi->planes[0])
+            continue;
+        // Must still have the layout MMAL expects (e.g. not cropped), and
+        // must not be queued on the renderer already.
+        struct mp_image dmpi = {0};
+        layout_buffer(&dmpi, buffer, vo->params);
+        for (int i = 0; i < 3; i++) {
+            if (dmpi.planes[i] != mpi->planes[i] ||
+                dmpi.stride[i] != mpi->stride[i])
+                return NULL;
+        }
+        if (mpi->w != dmpi.w || mpi->h != dmpi.h || buffer->user_data)
+            return NULL;
+        return buffer;
+    }
+    return NULL;
+}
+
 static void draw_frame(struct vo *vo, struct vo_frame *frame)
 {
     struct priv *p = vo->priv;
@@ -549,7 +654,20 @@ static void draw_frame(struct vo *vo, struct vo_frame *frame)
 
     p->display_synced = frame->display_synced;
 
-    if (mpi && mpi->imgfmt != IMGFMT_MMAL) {
+    MMAL_BUFFER_HEADER_T *dr_buffer = mpi ? find_dr_buffer(vo, mpi) : NULL;
+    if (dr_buffer) {
+        // The image data is already in the buffer; the new reference keeps
+        // it alive while the renderer uses it.
+        struct mp_image *new_ref = mp_image_new_ref(mpi);
+        talloc_free(mpi);
+        if (!new_ref) {
+            MP_ERR(vo, "Out of memory.\n");
+            return;
+        }
+        mp_image_setfmt(new_ref, IMGFMT_MMAL);
+        new_ref->planes[3] = (void *)dr_buffer;
+        mpi = new_ref;
+    } else if (mpi && mpi->imgfmt != IMGFMT_MMAL) {
         MMAL_BUFFER_HEADER_T *buffer = mmal_queue_wait(p->swpool->queue);
         if (!buffer) {
             talloc_free(mpi);
@@ -604,6 +722,7 @@ static void control_port_cb(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
 static void input_port_cb(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
 {
     struct mp_image *mpi = buffer->user_data;
+    buffer->user_data = NULL;
     talloc_free(mpi);
 }
 
@@ -620,7 +739,14 @@ static void disable_renderer(struct vo *vo)
 
         mmal_component_disable(p->renderer);
     }
-    mmal_pool_destroy(p->swpool);
+    if (p->dr_pool && p->dr_pool->refs) {
+        p->dr_pool->retired = true;
+    } else {
+        if (p->swpool)
+            mmal_pool_destroy(p->swpool);
+        talloc_free(p->dr_pool);
+    }
+    p->dr_pool = NULL;
     p->swpool = NULL;
     p->renderer_enabled = false;
 }
@@ -663,6 +789,8 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
             MP_FATAL(vo, "Could not allocate buffer pool.\n");
             return -1;
         }
+        p->dr_pool = talloc_zero(NULL, struct dr_pool);
+        p->dr_pool->pool = p->swpool;
     }
 
     if (set_geometry(vo) < 0)
@@ -911,6 +1039,7 @@ const struct vo_driver video_out_rpi = {
     .control = control,
     .draw_frame = draw_frame,
     .flip_page = flip_page,
+    .get_image = get_image,
     .uninit = uninit,
     .priv_size = sizeof(struct priv),
     .options = options,
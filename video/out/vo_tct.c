@@ -25,6 +25,8 @@
 
 #include <libswscale/swscale.h>
 
+#include "mpv_talloc.h"
+#include "misc/bstr.h"
 #include "options/m_config.h"
 #include "config.h"
 #include "vo.h"
@@ -72,10 +74,17 @@ static const struct m_sub_options vo_tct_conf = {
     .size = sizeof(struct vo_tct_opts),
 };
 
+struct lut_item {
+    char str[4];
+    int width;
+};
+
 struct priv {
     struct vo_tct_opts *opts;
-    size_t buffer_size;
-    char *buffer;
+    // output for a whole frame, written with a single call
+    bstr buffer;
+    // decimal strings for all 8 bit values
+    struct lut_item lut[256];
     int swidth;
     int sheight;
     struct mp_image *frame;
@@ -113,7 +122,44 @@ static int rgb_to_x256(uint8_t r, uint8_t g, uint8_t b)
     return color_err <= gray_err ? 16 + color_index() : 232 + gray_index;
 }
 
-static void write_plain(
+static void print_seq3(struct priv *p, const char *prefix,
+                       uint8_t r, uint8_t g, uint8_t b)
+{
+    bstr_xappend(p, &p->buffer, bstr0(prefix));
+    bstr_xappend(p, &p->buffer, (bstr){p->lut[r].str, p->lut[r].width});
+    bstr_xappend(p, &p->buffer, bstr0(";"));
+    bstr_xappend(p, &p->buffer, (bstr){p->lut[g].str, p->lut[g].width});
+    bstr_xappend(p, &p->buffer, bstr0(";"));
+    bstr_xappend(p, &p->buffer, (bstr){p->lut[b].str, p->lut[b].width});
+    bstr_xappend(p, &p->buffer, bstr0("m"));
+}
+
+static void print_seq1(struct priv *p, const char *prefix, uint8_t c)
+{
+    bstr_xappend(p, &p->buffer, bstr0(prefix));
+    bstr_xappend(p, &p->buffer, (bstr){p->lut[c].str, p->lut[c].width});
+    bstr_xappend(p, &p->buffer, bstr0("m"));
+}
+
+// Append the escape sequence for a background (bg=true) or foreground color.
+// If the color is the same as the last one (*last), nothing is appended,
+// which saves a lot of output on flat areas.
+static void print_color(struct priv *p, bool bg, bool term256, uint32_t *last,
+                        uint8_t r, uint8_t g, uint8_t b)
+{
+    uint32_t c = term256 ? rgb_to_x256(r, g, b) : (r << 16) | (g << 8) | b;
+    c |= 1u << 31; // so that it's never equal to the initial value 0
+    if (c == *last)
+        return;
+    *last = c;
+    if (term256) {
+        print_seq1(p, bg ? "\e[48;5;" : "\e[38;5;", c & 0xFF);
+    } else {
+        print_seq3(p, bg ? "\e[48;2;" : "\e[38;2;", r, g, b);
+    }
+}
+
+static void write_plain(struct priv *p,
     const int dwidth, const int dheight,
     const int swidth, const int sheight,
     const unsigned char *source, const int source_stride,
@@ -124,24 +170,21 @@ static void write_plain(
     const int ty = (dheight - sheight) / 2;
     for (int y = 0; y < sheight; y++) {
         const unsigned char *row = source + y * source_stride;
-        printf(ESC_GOTOXY, ty + y, tx);
+        bstr_xappend_asprintf(p, &p->buffer, ESC_GOTOXY, ty + y, tx);
+        uint32_t last_bg = 0;
         for (int x = 0; x < swidth; x++) {
             unsigned char b = *row++;
             unsigned char g = *row++;
             unsigned char r = *row++;
-            if (term256) {
-                printf(ESC_COLOR256_BG, rgb_to_x256(r, g, b));
-            } else {
-                printf(ESC_COLOR_BG, r, g, b);
-            }
-            printf(" ");
+            print_color(p, true, term256, &last_bg, r, g, b);
+            bstr_xappend(p, &p->buffer, bstr0(" "));
         }
-        printf(ESC_CLEAR_COLORS);
+        bstr_xappend(p, &p->buffer, bstr0(ESC_CLEAR_COLORS));
     }
-    printf("\n");
+    bstr_xappend(p, &p->buffer, bstr0("\n"));
 }
 
-static void write_half_blocks(
+static void write_half_blocks(struct priv *p,
     const int dwidth, const int dheight,
     const int swidth, const int sheight,
     unsigned char *source, int source_stride,
@@ -153,7 +196,8 @@ static void write_half_blocks(
     for (int y = 0; y < sheight * 2; y += 2) {
         const unsigned char *row_up = source + y * source_stride;
         const unsigned char *row_down = source + (y + 1) * source_stride;
-        printf(ESC_GOTOXY, ty + y / 2, tx);
+        bstr_xappend_asprintf(p, &p->buffer, ESC_GOTOXY, ty + y / 2, tx);
+        uint32_t last_bg = 0, last_fg = 0;
         for (int x = 0; x < swidth; x++) {
             unsigned char b_up = *row_up++;
             unsigned char g_up = *row_up++;
@@ -161,18 +205,14 @@ static void write_half_blocks(
             unsigned char b_down = *row_down++;
             unsigned char g_down = *row_down++;
             unsigned char r_down = *row_down++;
-            if (term256) {
-                printf(ESC_COLOR256_BG, rgb_to_x256(r_up, g_up, b_up));
-                printf(ESC_COLOR256_FG, rgb_to_x256(r_down, g_down, b_down));
-            } else {
-                printf(ESC_COLOR_BG, r_up, g_up, b_up);
-                printf(ESC_COLOR_FG, r_down, g_down, b_down);
-            }
-            printf("\xe2\x96\x84");  // UTF8 bytes of U+2584 (lower half block)
+            print_color(p, true, term256, &last_bg, r_up, g_up, b_up);
+            print_color(p, false, term256, &last_fg, r_down, g_down, b_down);
+            // UTF8 bytes of U+2584 (lower half block)
+            bstr_xappend(p, &p->buffer, bstr0("\xe2\x96\x84"));
         }
-        printf(ESC_CLEAR_COLORS);
+        bstr_xappend(p, &p->buffer, bstr0(ESC_CLEAR_COLORS));
     }
-    printf("\n");
+    bstr_xappend(p, &p->buffer, bstr0("\n"));
 }
 
 static void get_win_size(struct vo *vo, int *out_width, int *out_height) {
@@ -204,9 +244,6 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
     p->swidth = p->dst.x1 - p->dst.x0;
     p->sheight = p->dst.y1 - p->dst.y0;
 
-    if (p->buffer)
-        free(p->buffer);
-
     mp_sws_set_from_cmdline(p->sws, vo->global);
     p->sws->src = *params;
     p->sws->dst = (struct mp_image_params) {
@@ -243,17 +280,19 @@ static void draw_image(struct vo *vo, mp_image_t *mpi)
 static void flip_page(struct vo *vo)
 {
     struct priv *p = vo->priv;
+    p->buffer.len = 0;
     if (p->opts->algo == ALGO_PLAIN) {
-        write_plain(
+        write_plain(p,
             vo->dwidth, vo->dheight, p->swidth, p->sheight,
             p->frame->planes[0], p->frame->stride[0],
             p->opts->term256);
     } else {
-        write_half_blocks(
+        write_half_blocks(p,
             vo->dwidth, vo->dheight, p->swidth, p->sheight,
             p->frame->planes[0], p->frame->stride[0],
             p->opts->term256);
     }
+    fwrite(p->buffer.start, p->buffer.len, 1, stdout);
     fflush(stdout);
 }
 
@@ -263,8 +302,7 @@ static void uninit(struct vo *vo)
     printf(ESC_CLEAR_SCREEN);
     printf(ESC_GOTOXY, 0, 0);
     struct priv *p = vo->priv;
-    if (p->buffer)
-        talloc_free(p->buffer);
+    talloc_free(p->buffer.start);
     if (p->sws)
         talloc_free(p->sws);
 }
@@ -278,6 +316,10 @@ static int preinit(struct vo *vo)
     struct priv *p = vo->priv;
     p->opts = mp_get_config_group(vo, vo->global, &vo_tct_conf);
     p->sws = mp_sws_alloc(vo);
+    for (int n = 0; n < 256; n++) {
+        p->lut[n].width = snprintf(p->lut[n].str, sizeof(p->lut[n].str),
+                                   "%d", n);
+    }
     return 0;
 }
 
@@ -49,6 +49,7 @@ struct mpvk_ctx {
     VkSurfaceFormatKHR surf_format; // picked at surface initialization time
 
     struct vk_malloc *alloc;      // memory allocator for this device
+    struct stats_ctx *stats;      // optional, for memory statistics
     struct spirv_compiler *spirv; // GLSL -> SPIR-V compiler
     struct vk_cmdpool **pools;    // command pools (one per queue family)
     int num_pools;
@@ -72,4 +73,18 @@ struct mpvk_ctx {
 
     // Cached capabilities
     VkPhysicalDeviceLimits limits;
+    bool has_display_timing;    // VK_GOOGLE_display_timing is enabled
+    bool has_memory_budget;     // VK_EXT_memory_budget is enabled
+    bool has_ext_mem_fd;        // VK_KHR_external_memory_fd is enabled
+    bool has_ext_mem_dmabuf;    // VK_EXT_external_memory_dma_buf is enabled
+    bool has_ext_sem_fd;        // VK_KHR_external_semaphore_fd is enabled
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR GetPhysicalDeviceMemoryProperties2;
+    PFN_vkGetPhysicalDeviceProperties2KHR GetPhysicalDeviceProperties2;
+#ifdef VK_KHR_external_memory_fd
+    PFN_vkGetMemoryFdKHR GetMemoryFdKHR;
+    PFN_vkGetMemoryFdPropertiesKHR GetMemoryFdPropertiesKHR;
+#endif
+#ifdef VK_KHR_external_semaphore_fd
+    PFN_vkGetSemaphoreFdKHR GetSemaphoreFdKHR;
+#endif
 };
@@ -15,7 +15,9 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "common/stats.h"
 #include "options/m_config.h"
+#include "osdep/timer.h"
 #include "video/out/gpu/spirv.h"
 
 #include "context.h"
@@ -133,6 +135,12 @@ struct priv {
     int num_sems;
     int idx_sems;             // index of next free semaphore pair
     int last_imgidx;          // the image index last acquired (for submit)
+    // presentation feedback (VK_GOOGLE_display_timing):
+    PFN_vkGetRefreshCycleDurationGOOGLE GetRefreshCycleDuration;
+    PFN_vkGetPastPresentationTimingGOOGLE GetPastPresentationTiming;
+    uint32_t present_id;      // ID of the last presented frame
+    uint32_t known_id;        // ID of the last frame with known timing
+    uint64_t known_time;      // its actualPresentTime (ns)
 };
 
 static const struct ra_swapchain_fns vulkan_swapchain;
@@ -284,6 +292,9 @@ bool ra_vk_ctx_init(struct ra_ctx *ctx, struct mpvk_ctx *vk,
     p->vk = vk;
     p->opts = mp_get_config_group(p, ctx->global, &vulkan_conf);
 
+    if (!vk->stats)
+        vk->stats = stats_ctx_create(NULL, ctx->global, "vulkan");
+
     if (!mpvk_find_phys_device(vk, p->opts->device, ctx->opts.allow_sw))
         goto error;
     if (!spirv_compiler_init(ctx))
@@ -294,6 +305,15 @@ bool ra_vk_ctx_init(struct ra_ctx *ctx, struct mpvk_ctx *vk,
     if (!mpvk_device_init(vk, p->opts->dev_opts))
         goto error;
 
+    if (vk->has_display_timing) {
+        p->GetRefreshCycleDuration = (PFN_vkGetRefreshCycleDurationGOOGLE)
+            vkGetDeviceProcAddr(vk->dev, "vkGetRefreshCycleDurationGOOGLE");
+        p->GetPastPresentationTiming = (PFN_vkGetPastPresentationTimingGOOGLE)
+            vkGetDeviceProcAddr(vk->dev, "vkGetPastPresentationTimingGOOGLE");
+        if (!p->GetRefreshCycleDuration || !p->GetPastPresentationTiming)
+            vk->has_display_timing = false;
+    }
+
     ctx->ra = ra_create_vk(vk, ctx->log);
     if (!ctx->ra)
         goto error;
@@ -537,6 +557,15 @@ static bool submit_frame(struct ra_swapchain *sw, const struct vo_frame *frame)
         .pImageIndices = &p->last_imgidx,
     };
 
+    VkPresentTimeGOOGLE ptime = { .presentID = ++p->present_id };
+    VkPresentTimesInfoGOOGLE ptinfo = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE,
+        .swapchainCount = 1,
+        .pTimes = &ptime,
+    };
+    if (vk->has_display_timing)
+        pinfo.pNext = &ptinfo;
+
     MP_TRACE(vk, "vkQueuePresentKHR waits on %p\n", (void *)sem_out);
     VkResult res = vkQueuePresentKHR(queue, &pinfo);
     switch (res) {
@@ -562,6 +591,61 @@ static void swap_buffers(struct ra_swapchain *sw)
 
     while (p->frames_in_flight >= sw->ctx->opts.swapchain_depth)
         mpvk_poll_commands(p->vk, 100000); // 100μs
+
+    vk_malloc_garbage_collect(p->vk);
+}
+
+static void get_vsync(struct ra_swapchain *sw, struct vo_vsync_info *info)
+{
+    struct priv *p = sw->priv;
+    struct mpvk_ctx *vk = p->vk;
+    if (!vk->has_display_timing || !p->swapchain)
+        return;
+
+    VkRefreshCycleDurationGOOGLE cycle;
+    if (p->GetRefreshCycleDuration(vk->dev, p->swapchain, &cycle) != VK_SUCCESS)
+        return;
+    uint64_t duration = cycle.refreshDuration;
+    if (!duration)
+        return;
+
+    // The driver keeps timing records only for a limited number of frames,
+    // and reports every record only once.
+    VkPastPresentationTimingGOOGLE timings[16];
+    uint32_t num = MP_ARRAY_SIZE(timings);
+    VkResult res = p->GetPastPresentationTiming(vk->dev, p->swapchain, &num,
+                                                timings);
+    if (res != VK_SUCCESS && res != VK_INCOMPLETE)
+        return;
+
+    int64_t skipped = 0;
+    for (int n = 0; n < num; n++) {
+        VkPastPresentationTimingGOOGLE *t = &timings[n];
+        // Every frame is supposed to be shown for exactly one refresh (mpv
+        // re-presents repeated frames), so anything longer was a skip.
+        if (p->known_id && t->presentID > p->known_id &&
+            t->actualPresentTime > p->known_time)
+        {
+            uint64_t frames = t->presentID - p->known_id;
+            uint64_t vsyncs = (t->actualPresentTime - p->known_time +
+                               duration / 2) / duration;
+            if (vsyncs > frames)
+                skipped += vsyncs - frames;
+        }
+        p->known_id = t->presentID;
+        p->known_time = t->actualPresentTime;
+    }
+    info->skipped_vsyncs = skipped;
+
+    if (!p->known_id)
+        return;
+
+    // Extrapolate to the last queued frame. The times use the same clock
+    // as mp_raw_time_us() (CLOCK_MONOTONIC).
+    uint64_t display = p->known_time +
+                       (uint64_t)(p->present_id - p->known_id) * duration;
+    info->last_queue_display_time = mp_time_us() +
+        ((int64_t)(display / 1000) - (int64_t)mp_raw_time_us());
 }
 
 static const struct ra_swapchain_fns vulkan_swapchain = {
@@ -570,4 +654,5 @@ static const struct ra_swapchain_fns vulkan_swapchain = {
     .start_frame   = start_frame,
     .submit_frame  = submit_frame,
     .swap_buffers  = swap_buffers,
+    .get_vsync     = get_vsync,
 };
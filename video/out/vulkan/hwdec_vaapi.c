@@ -0,0 +1,382 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * VAAPI -> Vulkan interop. The surfaces are exported as dma-bufs, which are
+ * imported as Vulkan buffers (VK_EXT_external_memory_dma_buf), and then copied
+ * into the plane textures on the GPU. This avoids the round trip through
+ * system memory vaapi-copy does. Since a buffer->image copy can't untile,
+ * this works only with drivers exporting linear surfaces; the format probing
+ * in init() makes sure the interop is not used otherwise.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <va/va_drm.h>
+#include <va/va_drmcommon.h>
+
+#include <libavutil/hwcontext.h>
+#include <libavutil/hwcontext_vaapi.h>
+
+#include "config.h"
+
+#include "video/out/gpu/hwdec.h"
+#include "video/vaapi.h"
+#include "ra_vk.h"
+
+#ifndef DRM_FORMAT_MOD_LINEAR
+#define DRM_FORMAT_MOD_LINEAR 0
+#endif
+
+struct priv_owner {
+    struct mp_vaapi_ctx *ctx;
+    VADisplay *display;
+    int *formats;
+    bool probing_formats; // temporary during init
+};
+
+// A mapped surface, and the buffers using its memory. The surface must not be
+// reused by the decoder before the GPU is done copying from it.
+struct frame_ref {
+    struct mp_image *img;
+    struct ra_buf *bufs[4];
+    int num_bufs;
+};
+
+struct priv {
+    int num_planes;
+    struct mp_image layout;
+    struct ra_tex *tex[4];
+
+    struct frame_ref *frames;
+    int num_frames;
+};
+
+static void determine_working_formats(struct ra_hwdec *hw);
+
+static void drm_destroy(void *native_ctx)
+{
+    close((intptr_t)native_ctx);
+}
+
+static void uninit(struct ra_hwdec *hw)
+{
+    struct priv_owner *p = hw->priv;
+    if (p->ctx)
+        hwdec_devices_remove(hw->devs, &p->ctx->hwctx);
+    va_destroy(p->ctx);
+}
+
+static int init(struct ra_hwdec *hw)
+{
+    struct priv_owner *p = hw->priv;
+
+    struct mpvk_ctx *vk = ra_vk_get(hw->ra);
+    if (!vk || !vk->has_ext_mem_dmabuf)
+        return -1;
+
+    int drm_fd = open("/dev/dri/renderD128", O_RDWR | O_CLOEXEC);
+    if (drm_fd < 0) {
+        MP_VERBOSE(hw, "Could not open DRM render node.\n");
+        return -1;
+    }
+
+    p->display = vaGetDisplayDRM(drm_fd);
+    if (!p->display) {
+        MP_VERBOSE(hw, "Could not create a VA display.\n");
+        close(drm_fd);
+        return -1;
+    }
+
+    p->ctx = va_initialize(p->display, hw->log, true);
+    if (!p->ctx) {
+        vaTerminate(p->display);
+        close(drm_fd);
+        return -1;
+    }
+    p->ctx->native_ctx = (void *)(intptr_t)drm_fd;
+    p->ctx->destroy_native_ctx = drm_destroy;
+    if (!p->ctx->av_device_ref) {
+        MP_VERBOSE(hw, "libavutil vaapi code rejected the driver?\n");
+        return -1;
+    }
+
+    if (hw->probing && va_guess_if_emulated(p->ctx)) {
+        return -1;
+    }
+
+    MP_VERBOSE(hw, "using VAAPI Vulkan interop\n");
+
+    determine_working_formats(hw);
+    if (!p->formats || !p->formats[0]) {
+        return -1;
+    }
+
+    p->ctx->hwctx.supported_formats = p->formats;
+    p->ctx->hwctx.driver_name = hw->driver->name;
+    hwdec_devices_add(hw->devs, &p->ctx->hwctx);
+    return 0;
+}
+
+// Drop the surfaces the GPU is done with (or all of them if force is set).
+static void release_frames(struct ra_hwdec_mapper *mapper, bool force)
+{
+    struct priv *p = mapper->priv;
+    struct ra *ra = mapper->ra;
+
+    for (int n = p->num_frames - 1; n >= 0; n--) {
+        struct frame_ref *f = &p->frames[n];
+        bool busy = false;
+        for (int i = 0; i < f->num_bufs; i++) {
+            if (ra->fns->buf_poll && !ra->fns->buf_poll(ra, f->bufs[i]))
+                busy = true;
+        }
+        if (busy && !force)
+            continue;
+        // Freeing is deferred by ra_vk until the buffer is not in use anymore.
+        for (int i = 0; i < f->num_bufs; i++)
+            ra_buf_free(ra, &f->bufs[i]);
+        talloc_free(f->img);
+        MP_TARRAY_REMOVE_AT(p->frames, p->num_frames, n);
+    }
+}
+
+static void mapper_unmap(struct ra_hwdec_mapper *mapper)
+{
+}
+
+static void mapper_uninit(struct ra_hwdec_mapper *mapper)
+{
+    struct priv *p = mapper->priv;
+
+    release_frames(mapper, true);
+    for (int n = 0; n < 4; n++)
+        ra_tex_free(mapper->ra, &p->tex[n]);
+}
+
+static bool check_fmt(struct ra_hwdec_mapper *mapper, int fmt)
+{
+    struct priv_owner *p_owner = mapper->owner->priv;
+    for (int n = 0; p_owner->formats && p_owner->formats[n]; n++) {
+        if (p_owner->formats[n] == fmt)
+            return true;
+    }
+    return false;
+}
+
+static int mapper_init(struct ra_hwdec_mapper *mapper)
+{
+    struct priv_owner *p_owner = mapper->owner->priv;
+    struct priv *p = mapper->priv;
+
+    mapper->dst_params = mapper->src_params;
+    mapper->dst_params.imgfmt = mapper->src_params.hw_subfmt;
+    mapper->dst_params.hw_subfmt = 0;
+
+    struct ra_imgfmt_desc desc = {0};
+
+    if (!ra_get_imgfmt_desc(mapper->ra, mapper->dst_params.imgfmt, &desc))
+        return -1;
+
+    p->num_planes = desc.num_planes;
+    mp_image_set_params(&p->layout, &mapper->dst_params);
+
+    for (int n = 0; n < desc.num_planes; n++) {
+        struct ra_tex_params params = {
+            .dimensions = 2,
+            .w = mp_image_plane_w(&p->layout, n),
+            .h = mp_image_plane_h(&p->layout, n),
+            .d = 1,
+            .format = desc.planes[n],
+            .render_src = true,
+            .src_linear = desc.planes[n]->linear_filter,
+            .host_mutable = true,
+        };
+
+        p->tex[n] = ra_tex_create(mapper->ra, &params);
+        if (!p->tex[n])
+            return -1;
+    }
+
+    if (!p_owner->probing_formats && !check_fmt(mapper, mapper->dst_params.imgfmt))
+    {
+        MP_FATAL(mapper, "unsupported VA image format %s\n",
+                 mp_imgfmt_to_name(mapper->dst_params.imgfmt));
+        return -1;
+    }
+
+    return 0;
+}
+
+static int mapper_map(struct ra_hwdec_mapper *mapper)
+{
+    struct priv_owner *p_owner = mapper->owner->priv;
+    struct priv *p = mapper->priv;
+    struct ra *ra = mapper->ra;
+    VADisplay *display = p_owner->display;
+    VASurfaceID id = va_surface_id(mapper->src);
+    VADRMPRIMESurfaceDescriptor desc = {0};
+    VAStatus status;
+
+    release_frames(mapper, false);
+
+    // The GPU copy is not synchronized with the decoder otherwise.
+    status = vaSyncSurface(display, id);
+    if (!CHECK_VA_STATUS(mapper, "vaSyncSurface()"))
+        goto err;
+
+    status = vaExportSurfaceHandle(display, id,
+                                   VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
+                                   VA_EXPORT_SURFACE_READ_ONLY |
+                                   VA_EXPORT_SURFACE_SEPARATE_LAYERS,
+                                   &desc);
+    if (!CHECK_VA_STATUS(mapper, "vaExportSurfaceHandle()"))
+        goto err;
+
+    struct frame_ref f = {0};
+    bool ok = desc.num_layers == p->num_planes &&
+              desc.num_objects <= MP_ARRAY_SIZE(f.bufs);
+    for (int n = 0; n < desc.num_objects; n++) {
+        if (!ok || desc.objects[n].drm_format_modifier != DRM_FORMAT_MOD_LINEAR)
+        {
+            ok = false;
+            close(desc.objects[n].fd);
+            continue;
+        }
+        struct ra_buf_params params = {
+            .type = RA_BUF_TYPE_TEX_UPLOAD,
+            .size = desc.objects[n].size,
+        };
+        f.bufs[n] = ra_vk_buf_import_dmabuf(ra, &params, desc.objects[n].fd);
+        f.num_bufs = n + 1;
+        ok &= !!f.bufs[n];
+    }
+
+    for (int n = 0; ok && n < p->num_planes; n++) {
+        if (desc.layers[n].num_planes != 1) {
+            ok = false;
+            break;
+        }
+        struct ra_tex_upload_params params = {
+            .tex = p->tex[n],
+            .invalidate = true,
+            .buf = f.bufs[desc.layers[n].object_index[0]],
+            .buf_offset = desc.layers[n].offset[0],
+            .stride = desc.layers[n].pitch[0],
+        };
+        ok = ra->fns->tex_upload(ra, &params);
+        mapper->tex[n] = p->tex[n];
+    }
+
+    f.img = mp_image_new_ref(mapper->src);
+    MP_TARRAY_APPEND(p, p->frames, p->num_frames, f);
+
+    if (!ok)
+        goto err;
+
+    if (desc.fourcc == VA_FOURCC_YV12)
+        MPSWAP(struct ra_tex*, mapper->tex[1], mapper->tex[2]);
+
+    return 0;
+
+err:
+    if (!p_owner->probing_formats)
+        MP_FATAL(mapper, "mapping VAAPI surface failed\n");
+    return -1;
+}
+
+static bool try_format(struct ra_hwdec *hw, struct mp_image *surface)
+{
+    bool ok = false;
+    struct ra_hwdec_mapper *mapper = ra_hwdec_mapper_create(hw, &surface->params);
+    if (mapper)
+        ok = ra_hwdec_mapper_map(mapper, surface) >= 0;
+    ra_hwdec_mapper_free(&mapper);
+    return ok;
+}
+
+static void determine_working_formats(struct ra_hwdec *hw)
+{
+    struct priv_owner *p = hw->priv;
+    int num_formats = 0;
+    int *formats = NULL;
+
+    p->probing_formats = true;
+
+    AVHWFramesConstraints *fc =
+            av_hwdevice_get_hwframe_constraints(p->ctx->av_device_ref, NULL);
+    if (!fc) {
+        MP_WARN(hw, "failed to retrieve libavutil frame constraints\n");
+        goto done;
+    }
+    for (int n = 0; fc->valid_sw_formats[n] != AV_PIX_FMT_NONE; n++) {
+        AVBufferRef *fref = NULL;
+        struct mp_image *s = NULL;
+        AVFrame *frame = NULL;
+        fref = av_hwframe_ctx_alloc(p->ctx->av_device_ref);
+        if (!fref)
+            goto err;
+        AVHWFramesContext *fctx = (void *)fref->data;
+        fctx->format = AV_PIX_FMT_VAAPI;
+        fctx->sw_format = fc->valid_sw_formats[n];
+        fctx->width = 128;
+        fctx->height = 128;
+        if (av_hwframe_ctx_init(fref) < 0)
+            goto err;
+        frame = av_frame_alloc();
+        if (!frame)
+            goto err;
+        if (av_hwframe_get_buffer(fref, frame, 0) < 0)
+            goto err;
+        s = mp_image_from_av_frame(frame);
+        if (!s || !mp_image_params_valid(&s->params))
+            goto err;
+        if (try_format(hw, s))
+            MP_TARRAY_APPEND(p, formats, num_formats, s->params.hw_subfmt);
+    err:
+        talloc_free(s);
+        av_frame_free(&frame);
+        av_buffer_unref(&fref);
+    }
+    av_hwframe_constraints_free(&fc);
+
+done:
+    MP_TARRAY_APPEND(p, formats, num_formats, 0); // terminate it
+    p->formats = formats;
+    p->probing_formats = false;
+
+    MP_VERBOSE(hw, "Supported formats:\n");
+    for (int n = 0; formats[n]; n++)
+        MP_VERBOSE(hw, " %s\n", mp_imgfmt_to_name(formats[n]));
+}
+
+const struct ra_hwdec_driver ra_hwdec_vaapi_vk = {
+    .name = "vaapi-vulkan",
+    .priv_size = sizeof(struct priv_owner),
+    .imgfmts = {IMGFMT_VAAPI, 0},
+    .init = init,
+    .uninit = uninit,
+    .mapper = &(const struct ra_hwdec_mapper_driver){
+        .priv_size = sizeof(struct priv),
+        .init = mapper_init,
+        .uninit = mapper_uninit,
+        .map = mapper_map,
+        .unmap = mapper_unmap,
+    },
+};
@@ -1,5 +1,6 @@
 #include "malloc.h"
 #include "utils.h"
+#include "common/stats.h"
 #include "osdep/timer.h"
 
 // Controls the multiplication factor for new slab allocations. The new slab
@@ -22,6 +23,14 @@
 // map with lots of small buffers during uninit. (Default: 1 KB)
 #define MPVK_HEAP_MINIMUM_REGION_SIZE (1 << 10)
 
+// Controls how long a slab must have been completely unused before it gets
+// returned to the device by vk_malloc_garbage_collect. (Default: 5 s)
+#define MPVK_HEAP_EMPTY_SLAB_TIMEOUT (5 * 1000 * 1000)
+
+// Controls which fraction of a memory heap we allow ourselves to use if the
+// driver doesn't report a memory budget (VK_EXT_memory_budget).
+#define MPVK_HEAP_BUDGET_FRACTION 0.8
+
 // Represents a region of available memory
 struct vk_region {
     size_t start; // first offset in region
@@ -41,6 +50,9 @@ struct vk_slab {
     size_t size;          // total size of `slab`
     size_t used;          // number of bytes actually in use (for GC accounting)
     bool dedicated;       // slab is allocated specifically for one object
+    int heap_index;       // index into VkPhysicalDeviceMemoryProperties.memoryHeaps
+    size_t alloc_size;    // size of `mem` (can be larger than `size`)
+    int64_t empty_since;  // mp_time_us() at which `used` dropped to 0
     // free space map: a sorted list of memory regions that are available
     struct vk_region *regions;
     int num_regions;
@@ -67,6 +79,10 @@ struct vk_malloc {
     VkPhysicalDeviceMemoryProperties props;
     struct vk_heap *heaps;
     int num_heaps;
+    // per memory heap accounting, in bytes
+    size_t allocated[VK_MAX_MEMORY_HEAPS];
+    size_t used[VK_MAX_MEMORY_HEAPS];
+    int num_slabs;
 };
 
 static void slab_free(struct mpvk_ctx *vk, struct vk_slab *slab)
@@ -76,6 +92,12 @@ static void slab_free(struct mpvk_ctx *vk, struct vk_slab *slab)
 
     assert(slab->used == 0);
 
+    if (slab->mem) {
+        struct vk_malloc *ma = vk->alloc;
+        ma->allocated[slab->heap_index] -= slab->alloc_size;
+        ma->num_slabs--;
+    }
+
     int64_t start = mp_time_us();
     vkDestroyBuffer(vk->dev, slab->buffer, MPVK_ALLOCATOR);
     // also implicitly unmaps the memory if needed
@@ -113,12 +135,69 @@ static bool find_best_memtype(struct mpvk_ctx *vk, uint32_t typeBits,
     return false;
 }
 
+// Returns how many more bytes we should allocate from the given memory heap.
+static size_t heap_budget_left(struct mpvk_ctx *vk, int heap_index)
+{
+    struct vk_malloc *ma = vk->alloc;
+    uint64_t budget, usage;
+
+#ifdef VK_EXT_memory_budget
+    if (vk->has_memory_budget) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT bprops = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+        };
+        VkPhysicalDeviceMemoryProperties2KHR props = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR,
+            .pNext = &bprops,
+        };
+        vk->GetPhysicalDeviceMemoryProperties2(vk->physd, &props);
+        budget = bprops.heapBudget[heap_index];
+        usage = bprops.heapUsage[heap_index];
+        return budget > usage ? budget - usage : 0;
+    }
+#endif
+
+    // Without the extension, we can only account for our own allocations
+    budget = ma->props.memoryHeaps[heap_index].size * MPVK_HEAP_BUDGET_FRACTION;
+    usage = ma->allocated[heap_index];
+    return budget > usage ? budget - usage : 0;
+}
+
+// Frees all slabs which have been empty for at least `timeout` μs. If
+// heap_index is >= 0, only slabs from that memory heap are considered.
+// Returns the number of bytes released.
+static size_t release_empty_slabs(struct mpvk_ctx *vk, int heap_index,
+                                  int64_t timeout)
+{
+    struct vk_malloc *ma = vk->alloc;
+    int64_t now = mp_time_us();
+    size_t released = 0;
+
+    for (int i = 0; i < ma->num_heaps; i++) {
+        struct vk_heap *heap = &ma->heaps[i];
+        for (int n = heap->num_slabs - 1; n >= 0; n--) {
+            struct vk_slab *slab = heap->slabs[n];
+            if (slab->used || now - slab->empty_since < timeout)
+                continue;
+            if (heap_index >= 0 && slab->heap_index != heap_index)
+                continue;
+            released += slab->alloc_size;
+            slab_free(vk, slab);
+            MP_TARRAY_REMOVE_AT(heap->slabs, heap->num_slabs, n);
+        }
+    }
+
+    return released;
+}
+
 static struct vk_slab *slab_alloc(struct mpvk_ctx *vk, struct vk_heap *heap,
                                   size_t size)
 {
+    struct vk_malloc *ma = vk->alloc;
     struct vk_slab *slab = talloc_ptrtype(NULL, slab);
     *slab = (struct vk_slab) {
         .size = size,
+        .empty_since = mp_time_us(),
     };
 
     MP_TARRAY_APPEND(slab, slab->regions, slab->num_regions, (struct vk_region) {
@@ -167,8 +246,26 @@ static struct vk_slab *slab_alloc(struct mpvk_ctx *vk, struct vk_heap *heap,
     MP_VERBOSE(vk, "Allocating %zu memory of type 0x%x (id %d) in heap %d.\n",
                slab->size, (unsigned)type.propertyFlags, index, (int)type.heapIndex);
 
+    if (minfo.allocationSize > heap_budget_left(vk, type.heapIndex)) {
+        size_t released = release_empty_slabs(vk, type.heapIndex, 0);
+        MP_VERBOSE(vk, "Heap %d is over budget, released %zu bytes of unused "
+                   "memory.\n", (int)type.heapIndex, released);
+    }
+
     minfo.memoryTypeIndex = index;
-    VK(vkAllocateMemory(vk->dev, &minfo, MPVK_ALLOCATOR, &slab->mem));
+    VkResult res = vkAllocateMemory(vk->dev, &minfo, MPVK_ALLOCATOR, &slab->mem);
+    if (res == VK_ERROR_OUT_OF_DEVICE_MEMORY &&
+        release_empty_slabs(vk, type.heapIndex, 0))
+    {
+        MP_VERBOSE(vk, "Retrying allocation after releasing unused memory.\n");
+        res = vkAllocateMemory(vk->dev, &minfo, MPVK_ALLOCATOR, &slab->mem);
+    }
+    VK_ASSERT(res, "vkAllocateMemory");
+
+    slab->heap_index = type.heapIndex;
+    slab->alloc_size = minfo.allocationSize;
+    ma->allocated[slab->heap_index] += slab->alloc_size;
+    ma->num_slabs++;
 
     if (heap->flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
         VK(vkMapMemory(vk->dev, slab->mem, 0, VK_WHOLE_SIZE, 0, &slab->data));
@@ -272,6 +369,9 @@ void vk_free_memslice(struct mpvk_ctx *vk, struct vk_memslice slice)
 
     assert(slab->used >= slice.size);
     slab->used -= slice.size;
+    vk->alloc->used[slab->heap_index] -= slice.size;
+    if (!slab->used)
+        slab->empty_since = mp_time_us();
 
     MP_DBG(vk, "Freeing slice %zu + %zu from slab with size %zu\n",
            slice.offset, slice.size, slab->size);
@@ -335,6 +435,8 @@ static bool heap_get_region(struct mpvk_ctx *vk, struct vk_heap *heap,
     // with the heap
     if (size > MPVK_HEAP_MAXIMUM_SLAB_SIZE) {
         slab = slab_alloc(vk, heap, size);
+        if (slab)
+            slab->dedicated = true;
         *out_slab = slab;
         *out_index = 0;
         return !!slab;
@@ -368,6 +470,16 @@ static bool heap_get_region(struct mpvk_ctx *vk, struct vk_heap *heap,
     size_t slab_size = MPVK_HEAP_SLAB_GROWTH_RATE * cur_size;
     slab_size = MPMAX(MPVK_HEAP_MINIMUM_SLAB_SIZE, slab_size);
     slab_size = MPMIN(MPVK_HEAP_MAXIMUM_SLAB_SIZE, slab_size);
+
+    // Don't grow the heap beyond what the budget allows, unless the
+    // allocation itself requires it
+    VkMemoryType type;
+    int index;
+    if (find_best_memtype(vk, heap->typeBits, heap->flags, &type, &index)) {
+        size_t budget = heap_budget_left(vk, type.heapIndex);
+        slab_size = MPMAX(size, MPMIN(slab_size, budget));
+    }
+
     assert(slab_size >= size);
     slab = slab_alloc(vk, heap, slab_size);
     if (!slab)
@@ -407,6 +519,7 @@ static bool slice_heap(struct mpvk_ctx *vk, struct vk_heap *heap, size_t size,
     insert_region(slab, (struct vk_region) { out_end, reg.end });
 
     slab->used += size;
+    vk->alloc->used[slab->heap_index] += size;
     return true;
 }
 
@@ -417,6 +530,29 @@ bool vk_malloc_generic(struct mpvk_ctx *vk, VkMemoryRequirements reqs,
     return slice_heap(vk, heap, reqs.size, reqs.alignment, out);
 }
 
+bool vk_malloc_dedicated(struct mpvk_ctx *vk, VkMemoryRequirements reqs,
+                         VkMemoryPropertyFlags flags, const void *pNext,
+                         VkDeviceMemory *out)
+{
+    VkMemoryType type;
+    int index;
+    if (!find_best_memtype(vk, reqs.memoryTypeBits, flags, &type, &index))
+        return false;
+
+    VkMemoryAllocateInfo minfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = pNext,
+        .allocationSize = reqs.size,
+        .memoryTypeIndex = index,
+    };
+
+    VK(vkAllocateMemory(vk->dev, &minfo, MPVK_ALLOCATOR, out));
+    return true;
+
+error:
+    return false;
+}
+
 bool vk_malloc_buffer(struct mpvk_ctx *vk, VkBufferUsageFlags bufFlags,
                       VkMemoryPropertyFlags memFlags, VkDeviceSize size,
                       VkDeviceSize alignment, struct vk_bufslice *out)
@@ -432,3 +568,36 @@ bool vk_malloc_buffer(struct mpvk_ctx *vk, VkBufferUsageFlags bufFlags,
 
     return true;
 }
+
+void vk_malloc_garbage_collect(struct mpvk_ctx *vk)
+{
+    struct vk_malloc *ma = vk->alloc;
+    if (!ma)
+        return;
+
+    size_t released = release_empty_slabs(vk, -1, MPVK_HEAP_EMPTY_SLAB_TIMEOUT);
+    if (released)
+        MP_VERBOSE(vk, "Released %zu bytes of unused memory.\n", released);
+
+    int64_t dev_alloc = 0, dev_used = 0, host_alloc = 0, host_used = 0;
+    int64_t dev_budget = 0;
+    for (int i = 0; i < ma->props.memoryHeapCount; i++) {
+        if (ma->props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            dev_alloc += ma->allocated[i];
+            dev_used += ma->used[i];
+            if (vk->has_memory_budget)
+                dev_budget += heap_budget_left(vk, i) + ma->allocated[i];
+        } else {
+            host_alloc += ma->allocated[i];
+            host_used += ma->used[i];
+        }
+    }
+
+    stats_value(vk->stats, "device-memory-allocated", dev_alloc);
+    stats_value(vk->stats, "device-memory-used", dev_used);
+    stats_value(vk->stats, "host-memory-allocated", host_alloc);
+    stats_value(vk->stats, "host-memory-used", host_used);
+    stats_value(vk->stats, "slabs", ma->num_slabs);
+    if (vk->has_memory_budget)
+        stats_value(vk->stats, "device-memory-budget", dev_budget);
+}
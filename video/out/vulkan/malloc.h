@@ -5,6 +5,10 @@
 void vk_malloc_init(struct mpvk_ctx *vk);
 void vk_malloc_uninit(struct mpvk_ctx *vk);
 
+// Returns slabs that have been unused for a while to the device, and updates
+// the memory statistics. Should be called regularly, e.g. once per frame.
+void vk_malloc_garbage_collect(struct mpvk_ctx *vk);
+
 // Represents a single "slice" of generic (non-buffer) memory, plus some
 // metadata for accounting. This struct is essentially read-only.
 struct vk_memslice {
@@ -18,6 +22,14 @@ void vk_free_memslice(struct mpvk_ctx *vk, struct vk_memslice slice);
 bool vk_malloc_generic(struct mpvk_ctx *vk, VkMemoryRequirements reqs,
                        VkMemoryPropertyFlags flags, struct vk_memslice *out);
 
+// Allocate a separate device memory object, bypassing the slab allocator. This
+// is needed for memory shared with other APIs: `pNext` is chained into the
+// VkMemoryAllocateInfo (e.g. for import or export info). The memory is not
+// accounted for in the statistics, and must be released with vkFreeMemory.
+bool vk_malloc_dedicated(struct mpvk_ctx *vk, VkMemoryRequirements reqs,
+                         VkMemoryPropertyFlags flags, const void *pNext,
+                         VkDeviceMemory *out);
+
 // Represents a single "slice" of a larger buffer
 struct vk_bufslice {
     struct vk_memslice mem; // must be freed by the user when done
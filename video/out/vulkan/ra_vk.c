@@ -1,3 +1,5 @@
+#include <unistd.h>
+
 #include "video/out/gpu/utils.h"
 #include "video/out/gpu/spirv.h"
 
@@ -17,6 +19,7 @@ struct ra_vk {
     struct mpvk_ctx *vk;
     struct ra_tex *clear_tex; // stupid hack for clear()
     struct vk_cmd *cmd;       // currently recording cmd
+    uint64_t next_id;         // for ra_tex_vk.id and ra_buf_vk.id
 };
 
 struct mpvk_ctx *ra_vk_get(struct ra *ra)
@@ -34,8 +37,18 @@ static void vk_submit(struct ra *ra)
     struct mpvk_ctx *vk = ra_vk_get(ra);
 
     if (p->cmd) {
+        struct vk_cmdpool *pool = p->cmd->pool;
         vk_cmd_queue(vk, p->cmd);
         p->cmd = NULL;
+
+        // Submit work for the dedicated transfer queue right away, instead of
+        // at the end of the frame. The GPU can then execute the texture
+        // uploads while the rest of the frame is still being recorded, and in
+        // parallel to rendering the previous frame. Synchronization with the
+        // users of the uploaded textures happens via their semaphores.
+        if (pool == vk->pool_transfer && pool != vk->pool_graphics &&
+            pool != vk->pool_compute)
+            mpvk_submit_commands(vk);
     }
 }
 
@@ -206,6 +219,7 @@ struct ra *ra_create_vk(struct mpvk_ctx *vk, struct mp_log *log)
     ra->glsl_version = vk->spirv->glsl_version;
     ra->glsl_vulkan = true;
     ra->max_shmem = vk->limits.maxComputeSharedMemorySize;
+    ra->max_compute_group_threads = vk->limits.maxComputeWorkGroupInvocations;
     ra->max_pushc_size = vk->limits.maxPushConstantsSize;
 
     if (vk->pool_compute) {
@@ -302,6 +316,7 @@ static VkResult vk_create_render_pass(VkDevice dev, const struct ra_format *fmt,
 
 // For ra_tex.priv
 struct ra_tex_vk {
+    uint64_t id; // unique for the lifetime of the ra, never 0
     bool external_img;
     enum queue_type upload_queue;
     VkImageType type;
@@ -519,6 +534,7 @@ static struct ra_tex *vk_tex_create(struct ra *ra,
     tex->params.initial_data = NULL;
 
     struct ra_tex_vk *tex_vk = tex->priv = talloc_zero(tex, struct ra_tex_vk);
+    tex_vk->id = ++((struct ra_vk *)ra->priv)->next_id;
     tex_vk->upload_queue = GRAPHICS;
 
     const struct vk_format *fmt = params->format->priv;
@@ -666,6 +682,7 @@ struct ra_tex *ra_vk_wrap_swapchain_img(struct ra *ra, VkImage vkimg,
     };
 
     struct ra_tex_vk *tex_vk = tex->priv = talloc_zero(tex, struct ra_tex_vk);
+    tex_vk->id = ++((struct ra_vk *)ra->priv)->next_id;
     tex_vk->type = VK_IMAGE_TYPE_2D;
     tex_vk->external_img = true;
     tex_vk->img = vkimg;
@@ -682,7 +699,9 @@ error:
 
 // For ra_buf.priv
 struct ra_buf_vk {
+    uint64_t id; // unique for the lifetime of the ra, never 0
     struct vk_bufslice slice;
+    bool external; // slice.buf/slice.mem.vkmem are dedicated and owned by us
     int refcount; // 1 = object allocated but not in use, > 1 = in use
     bool needsflush;
     enum queue_type update_queue;
@@ -700,7 +719,12 @@ static void vk_buf_deref(struct ra *ra, struct ra_buf *buf)
     struct ra_buf_vk *buf_vk = buf->priv;
 
     if (--buf_vk->refcount == 0) {
-        vk_free_memslice(vk, buf_vk->slice.mem);
+        if (buf_vk->external) {
+            vkDestroyBuffer(vk->dev, buf_vk->slice.buf, MPVK_ALLOCATOR);
+            vkFreeMemory(vk->dev, buf_vk->slice.mem.vkmem, MPVK_ALLOCATOR);
+        } else {
+            vk_free_memslice(vk, buf_vk->slice.mem);
+        }
         talloc_free(buf);
     }
 }
@@ -778,6 +802,7 @@ static struct ra_buf *vk_buf_create(struct ra *ra,
     buf->params = *params;
 
     struct ra_buf_vk *buf_vk = buf->priv = talloc_zero(buf, struct ra_buf_vk);
+    buf_vk->id = ++((struct ra_vk *)ra->priv)->next_id;
     buf_vk->current_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
     buf_vk->current_access = 0;
     buf_vk->refcount = 1;
@@ -849,6 +874,221 @@ static bool vk_buf_poll(struct ra *ra, struct ra_buf *buf)
     return buf_vk->refcount == 1;
 }
 
+#ifdef VK_KHR_external_memory_fd
+// Create a texture upload buffer with dedicated memory, which is either
+// exported (import_fd < 0, *export_fd is set), or imported from import_fd.
+// An import_fd is always taken over (closed on failure).
+static struct ra_buf *vk_buf_create_external(struct ra *ra,
+        const struct ra_buf_params *params,
+        VkExternalMemoryHandleTypeFlagBitsKHR handle_type,
+        int import_fd, int *export_fd)
+{
+    struct mpvk_ctx *vk = ra_vk_get(ra);
+    assert(params->type == RA_BUF_TYPE_TEX_UPLOAD);
+    assert(!params->host_mapped && !params->host_mutable);
+    assert(!params->initial_data);
+
+    int own_fd = import_fd;
+
+    struct ra_buf *buf = talloc_zero(NULL, struct ra_buf);
+    buf->params = *params;
+
+    struct ra_buf_vk *buf_vk = buf->priv = talloc_zero(buf, struct ra_buf_vk);
+    buf_vk->id = ++((struct ra_vk *)ra->priv)->next_id;
+    buf_vk->current_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    buf_vk->current_access = 0;
+    buf_vk->refcount = 1;
+    buf_vk->external = true;
+
+    if (!vk->has_ext_mem_fd)
+        goto error;
+
+    uint32_t qfs[3] = {0};
+    for (int i = 0; i < vk->num_pools; i++)
+        qfs[i] = vk->pools[i]->qf;
+
+    VkExternalMemoryBufferCreateInfoKHR einfo = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO_KHR,
+        .handleTypes = handle_type,
+    };
+
+    VkBufferCreateInfo binfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = &einfo,
+        .size  = params->size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = vk->num_pools > 1 ? VK_SHARING_MODE_CONCURRENT
+                                         : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = vk->num_pools,
+        .pQueueFamilyIndices = qfs,
+    };
+
+    VK(vkCreateBuffer(vk->dev, &binfo, MPVK_ALLOCATOR, &buf_vk->slice.buf));
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(vk->dev, buf_vk->slice.buf, &reqs);
+
+    VkExportMemoryAllocateInfoKHR exinfo = {
+        .sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO_KHR,
+        .handleTypes = handle_type,
+    };
+    VkImportMemoryFdInfoKHR iminfo = {
+        .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,
+        .handleType = handle_type,
+        .fd = import_fd,
+    };
+
+    VkMemoryPropertyFlags memFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    const void *pNext = &exinfo;
+    if (import_fd >= 0) {
+        VkMemoryFdPropertiesKHR fdprops = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_FD_PROPERTIES_KHR,
+        };
+        VK(vk->GetMemoryFdPropertiesKHR(vk->dev, handle_type, import_fd,
+                                        &fdprops));
+        // The memory already exists, so take whatever type it has.
+        reqs.memoryTypeBits &= fdprops.memoryTypeBits;
+        reqs.size = MPMAX(reqs.size, params->size);
+        memFlags = 0;
+        pNext = &iminfo;
+    }
+
+    VkDeviceMemory mem;
+    if (!vk_malloc_dedicated(vk, reqs, memFlags, pNext, &mem))
+        goto error;
+    own_fd = -1; // now owned by the memory object
+    buf_vk->slice.mem = (struct vk_memslice) {
+        .vkmem = mem,
+        .size = reqs.size,
+    };
+
+    VK(vkBindBufferMemory(vk->dev, buf_vk->slice.buf, mem, 0));
+
+    if (import_fd < 0) {
+        VkMemoryGetFdInfoKHR finfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR,
+            .memory = mem,
+            .handleType = handle_type,
+        };
+        VK(vk->GetMemoryFdKHR(vk->dev, &finfo, export_fd));
+    }
+
+    return buf;
+
+error:
+    if (own_fd >= 0)
+        close(own_fd);
+    vk_buf_destroy(ra, buf);
+    return NULL;
+}
+#endif
+
+struct ra_buf *ra_vk_buf_create_exported(struct ra *ra,
+                                         const struct ra_buf_params *params,
+                                         int *out_fd, size_t *out_size)
+{
+#ifdef VK_KHR_external_memory_fd
+    struct ra_buf *buf = vk_buf_create_external(ra, params,
+            VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT_KHR, -1, out_fd);
+    if (buf)
+        *out_size = ((struct ra_buf_vk *)buf->priv)->slice.mem.size;
+    return buf;
+#else
+    return NULL;
+#endif
+}
+
+struct ra_buf *ra_vk_buf_import_dmabuf(struct ra *ra,
+                                       const struct ra_buf_params *params,
+                                       int fd)
+{
+#if defined(VK_KHR_external_memory_fd) && defined(VK_EXT_external_memory_dma_buf)
+    struct mpvk_ctx *vk = ra_vk_get(ra);
+    if (!vk->has_ext_mem_dmabuf) {
+        close(fd);
+        return NULL;
+    }
+    return vk_buf_create_external(ra, params,
+            VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT, fd, NULL);
+#else
+    close(fd);
+    return NULL;
+#endif
+}
+
+// Wrapper, so that semaphores can be destroyed via vk_cb callbacks.
+struct vk_sem_ref {
+    VkSemaphore sem;
+};
+
+static void vk_sem_destroy(struct ra *ra, struct vk_sem_ref *ref)
+{
+    struct mpvk_ctx *vk = ra_vk_get(ra);
+    vkDestroySemaphore(vk->dev, ref->sem, MPVK_ALLOCATOR);
+    talloc_free(ref);
+}
+
+MAKE_LAZY_DESTRUCTOR(vk_sem_destroy, struct vk_sem_ref);
+
+VkSemaphore ra_vk_create_exported_sem(struct ra *ra, int *out_fd)
+{
+    VkSemaphore sem = VK_NULL_HANDLE;
+#ifdef VK_KHR_external_semaphore_fd
+    struct mpvk_ctx *vk = ra_vk_get(ra);
+    if (!vk->has_ext_sem_fd)
+        return VK_NULL_HANDLE;
+
+    VkExportSemaphoreCreateInfoKHR einfo = {
+        .sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO_KHR,
+        .handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT_KHR,
+    };
+    VkSemaphoreCreateInfo sinfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &einfo,
+    };
+    VK(vkCreateSemaphore(vk->dev, &sinfo, MPVK_ALLOCATOR, &sem));
+
+    VkSemaphoreGetFdInfoKHR finfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
+        .semaphore = sem,
+        .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT_KHR,
+    };
+    VK(vk->GetSemaphoreFdKHR(vk->dev, &finfo, out_fd));
+    return sem;
+
+error:
+    vkDestroySemaphore(vk->dev, sem, MPVK_ALLOCATOR);
+#endif
+    return VK_NULL_HANDLE;
+}
+
+void ra_vk_destroy_sem(struct ra *ra, VkSemaphore sem)
+{
+    if (!sem)
+        return;
+    struct vk_sem_ref *ref = talloc_ptrtype(NULL, ref);
+    ref->sem = sem;
+    vk_sem_destroy_lazy(ra, ref);
+}
+
+bool ra_vk_get_device_uuid(struct ra *ra, uint8_t uuid[VK_UUID_SIZE])
+{
+    struct mpvk_ctx *vk = ra_vk_get(ra);
+    if (!vk->GetPhysicalDeviceProperties2)
+        return false;
+
+    VkPhysicalDeviceIDPropertiesKHR idprops = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES_KHR,
+    };
+    VkPhysicalDeviceProperties2KHR props = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR,
+        .pNext = &idprops,
+    };
+    vk->GetPhysicalDeviceProperties2(vk->physd, &props);
+    memcpy(uuid, idprops.deviceUUID, VK_UUID_SIZE);
+    return true;
+}
+
 static bool vk_tex_upload(struct ra *ra,
                           const struct ra_tex_upload_params *params)
 {
@@ -915,6 +1155,14 @@ error:
 
 #define MPVK_NUM_DS MPVK_MAX_STREAMING_DEPTH
 
+// Identifies the resource a descriptor was last written with. Since object
+// handles can be reused after destruction, this uses the ra_tex_vk/ra_buf_vk
+// id instead.
+struct vk_ds_binding {
+    uint64_t id;
+    VkImageLayout layout;
+};
+
 // For ra_renderpass.priv
 struct ra_renderpass_vk {
     // Pipeline / render pass
@@ -928,6 +1176,9 @@ struct ra_renderpass_vk {
     VkDescriptorPool dsPool;
     VkDescriptorSet dss[MPVK_NUM_DS];
     int dindex;
+    // What each descriptor set currently contains, indexed by
+    // dindex * num_inputs + input index. Used to skip redundant updates.
+    struct vk_ds_binding *dscache;
     // Vertex buffers (vertices)
     struct ra_buf_pool vbo;
 
@@ -1056,7 +1307,7 @@ static VkResult vk_compile_glsl(struct ra *ra, void *tactx,
     VkResult ret = VK_SUCCESS;
     int msgl = MSGL_DEBUG;
 
-    if (!vk->spirv->fns->compile_glsl(vk->spirv, tactx, type, glsl, spirv)) {
+    if (!spirv_compile_glsl(vk->spirv, tactx, type, glsl, spirv)) {
         ret = VK_ERROR_INVALID_SHADER_NV;
         msgl = MSGL_ERR;
     }
@@ -1151,6 +1402,8 @@ static struct ra_renderpass *vk_renderpass_create(struct ra *ra,
     pass_vk->dswrite = talloc_array(pass, VkWriteDescriptorSet, num_bindings);
     pass_vk->dsiinfo = talloc_array(pass, VkDescriptorImageInfo, num_bindings);
     pass_vk->dsbinfo = talloc_array(pass, VkDescriptorBufferInfo, num_bindings);
+    pass_vk->dscache = talloc_zero_array(pass, struct vk_ds_binding,
+                                         MPVK_NUM_DS * params->num_inputs);
 
     VkDescriptorSetLayoutCreateInfo dinfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
@@ -1428,18 +1681,25 @@ static const VkPipelineStageFlags passStages[] = {
     [RA_RENDERPASS_TYPE_COMPUTE] = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 };
 
+// Records the barriers needed for `val`, and appends a descriptor write to
+// pass_vk->dswrite unless descriptor set `dindex` already refers to the same
+// resource.
 static void vk_update_descriptor(struct ra *ra, struct vk_cmd *cmd,
                                  struct ra_renderpass *pass,
                                  struct ra_renderpass_input_val val,
-                                 VkDescriptorSet ds, int idx)
+                                 int dindex, int *num_writes)
 {
     struct ra_renderpass_vk *pass_vk = pass->priv;
     struct ra_renderpass_input *inp = &pass->params.inputs[val.index];
+    struct vk_ds_binding *cached =
+        &pass_vk->dscache[dindex * pass->params.num_inputs + val.index];
+    struct vk_ds_binding binding = {0};
 
+    int idx = *num_writes;
     VkWriteDescriptorSet *wds = &pass_vk->dswrite[idx];
     *wds = (VkWriteDescriptorSet) {
         .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .dstSet = ds,
+        .dstSet = pass_vk->dss[dindex],
         .dstBinding = inp->binding,
         .descriptorCount = 1,
         .descriptorType = dsType[inp->type],
@@ -1463,6 +1723,7 @@ static void vk_update_descriptor(struct ra *ra, struct vk_cmd *cmd,
         };
 
         wds->pImageInfo = iinfo;
+        binding = (struct vk_ds_binding) { tex_vk->id, iinfo->imageLayout };
         break;
     }
     case RA_VARTYPE_IMG_W: {
@@ -1481,6 +1742,7 @@ static void vk_update_descriptor(struct ra *ra, struct vk_cmd *cmd,
         };
 
         wds->pImageInfo = iinfo;
+        binding = (struct vk_ds_binding) { tex_vk->id, iinfo->imageLayout };
         break;
     }
     case RA_VARTYPE_BUF_RO:
@@ -1503,9 +1765,16 @@ static void vk_update_descriptor(struct ra *ra, struct vk_cmd *cmd,
         };
 
         wds->pBufferInfo = binfo;
+        binding = (struct vk_ds_binding) { buf_vk->id };
         break;
     }
     }
+
+    if (cached->id == binding.id && cached->layout == binding.layout)
+        return;
+
+    *cached = binding;
+    *num_writes += 1;
 }
 
 static void vk_release_descriptor(struct ra *ra, struct vk_cmd *cmd,
@@ -1547,16 +1816,16 @@ static void vk_renderpass_run(struct ra *ra,
 
     vkCmdBindPipeline(cmd->buf, bindPoint[pass->params.type], pass_vk->pipe);
 
-    VkDescriptorSet ds = pass_vk->dss[pass_vk->dindex++];
+    int dindex = pass_vk->dindex++;
     pass_vk->dindex %= MPVK_NUM_DS;
+    VkDescriptorSet ds = pass_vk->dss[dindex];
 
+    int num_writes = 0;
     for (int i = 0; i < params->num_values; i++)
-        vk_update_descriptor(ra, cmd, pass, params->values[i], ds, i);
+        vk_update_descriptor(ra, cmd, pass, params->values[i], dindex, &num_writes);
 
-    if (params->num_values > 0) {
-        vkUpdateDescriptorSets(vk->dev, params->num_values, pass_vk->dswrite,
-                               0, NULL);
-    }
+    if (num_writes > 0)
+        vkUpdateDescriptorSets(vk->dev, num_writes, pass_vk->dswrite, 0, NULL);
 
     vkCmdBindDescriptorSets(cmd->buf, bindPoint[pass->params.type],
                             pass_vk->pipeLayout, 0, 1, &ds, 0, NULL);
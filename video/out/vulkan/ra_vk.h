@@ -20,6 +20,33 @@ struct ra_tex *ra_vk_wrap_swapchain_img(struct ra *ra, VkImage vkimg,
 // ra_tex will not be used by the ra_vk until the external semaphore fires.
 void ra_tex_vk_external_dep(struct ra *ra, struct ra_tex *tex, VkSemaphore dep);
 
+// Create a texture upload buffer (RA_BUF_TYPE_TEX_UPLOAD, not host mapped or
+// mutable), whose memory is exported as opaque POSIX fd, which other APIs
+// (e.g. CUDA) can import and write to. The caller owns *out_fd. *out_size is
+// set to the size of the exported memory. Returns NULL if not supported.
+struct ra_buf *ra_vk_buf_create_exported(struct ra *ra,
+                                         const struct ra_buf_params *params,
+                                         int *out_fd, size_t *out_size);
+
+// Like ra_vk_buf_create_exported(), but the buffer uses the memory of the
+// given dma-buf. Takes over ownership of the fd (also on failure).
+struct ra_buf *ra_vk_buf_import_dmabuf(struct ra *ra,
+                                       const struct ra_buf_params *params,
+                                       int fd);
+
+// Create a semaphore which other APIs can signal, after importing *out_fd
+// (owned by the caller). Use it with ra_tex_vk_external_dep(). Returns
+// VK_NULL_HANDLE if not supported.
+VkSemaphore ra_vk_create_exported_sem(struct ra *ra, int *out_fd);
+
+// Destroy a semaphore from ra_vk_create_exported_sem(), once it's not in use
+// by any pending command anymore.
+void ra_vk_destroy_sem(struct ra *ra, VkSemaphore sem);
+
+// Get the UUID of the physical device, for matching it against devices of
+// other APIs. Returns false if this is not possible.
+bool ra_vk_get_device_uuid(struct ra *ra, uint8_t uuid[VK_UUID_SIZE]);
+
 // This function finalizes rendering, transitions `tex` (which must be a
 // wrapped swapchain image) into a format suitable for presentation, and returns
 // the resulting command buffer (or NULL on error). The caller may add their
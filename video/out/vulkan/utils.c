@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include <libavutil/macros.h>
 
 #include "video/out/gpu/spirv.h"
@@ -155,6 +157,8 @@ void mpvk_uninit(struct mpvk_ctx *vk)
         vkDestroyDevice(vk->dev, MPVK_ALLOCATOR);
     }
 
+    talloc_free(vk->stats);
+
     if (vk->dbg) {
         // Same deal as creating the debug callback, we need to load this
         // first.
@@ -191,34 +195,67 @@ bool mpvk_instance_init(struct mpvk_ctx *vk, struct mp_log *log,
     }
 
     // Enable whatever extensions were compiled in.
-    const char *extensions[] = {
-        VK_KHR_SURFACE_EXTENSION_NAME,
-        surf_ext_name,
-
-        // Extra extensions only used for debugging. These are toggled by
-        // decreasing the enabledExtensionCount, so the number needs to be
-        // synchronized with the code below.
-        VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
+    const char **exts = NULL;
+    int num_exts = 0;
+    MP_TARRAY_APPEND(NULL, exts, num_exts, VK_KHR_SURFACE_EXTENSION_NAME);
+    MP_TARRAY_APPEND(NULL, exts, num_exts, surf_ext_name);
+
+    // Extra extensions only used for debugging.
+    if (debug)
+        MP_TARRAY_APPEND(NULL, exts, num_exts, VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+
+    // Optional extensions. The first one is needed for querying the memory
+    // budget and the device UUID, the others for sharing memory and
+    // semaphores with hardware decoders.
+    const char *props2_ext = VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
+    const char *opt_exts[] = {
+        props2_ext,
+#ifdef VK_KHR_external_memory_capabilities
+        VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME,
+#endif
+#ifdef VK_KHR_external_semaphore_capabilities
+        VK_KHR_EXTERNAL_SEMAPHORE_CAPABILITIES_EXTENSION_NAME,
+#endif
     };
+    bool has_props2 = false;
+    uint32_t num_inst_exts = 0;
+    vkEnumerateInstanceExtensionProperties(NULL, &num_inst_exts, NULL);
+    VkExtensionProperties *inst_exts =
+        talloc_array(NULL, VkExtensionProperties, num_inst_exts);
+    vkEnumerateInstanceExtensionProperties(NULL, &num_inst_exts, inst_exts);
+    for (int i = 0; i < num_inst_exts; i++) {
+        for (int n = 0; n < MP_ARRAY_SIZE(opt_exts); n++) {
+            if (strcmp(inst_exts[i].extensionName, opt_exts[n]) == 0) {
+                MP_TARRAY_APPEND(NULL, exts, num_exts, opt_exts[n]);
+                has_props2 |= opt_exts[n] == props2_ext;
+            }
+        }
+    }
+    talloc_free(inst_exts);
 
-    const int debugExtensionCount = 1;
-
-    info.ppEnabledExtensionNames = extensions;
-    info.enabledExtensionCount = MP_ARRAY_SIZE(extensions);
-
-    if (!debug)
-        info.enabledExtensionCount -= debugExtensionCount;
+    info.ppEnabledExtensionNames = exts;
+    info.enabledExtensionCount = num_exts;
 
     MP_VERBOSE(vk, "Creating instance with extensions:\n");
     for (int i = 0; i < info.enabledExtensionCount; i++)
         MP_VERBOSE(vk, "    %s\n", info.ppEnabledExtensionNames[i]);
 
     VkResult res = vkCreateInstance(&info, MPVK_ALLOCATOR, &vk->inst);
+    talloc_free(exts);
     if (res != VK_SUCCESS) {
         MP_VERBOSE(vk, "Failed creating instance: %s\n", vk_err(res));
         return false;
     }
 
+    if (has_props2) {
+        vk->GetPhysicalDeviceMemoryProperties2 =
+            (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)
+            vkGetInstanceProcAddr(vk->inst, "vkGetPhysicalDeviceMemoryProperties2KHR");
+        vk->GetPhysicalDeviceProperties2 =
+            (PFN_vkGetPhysicalDeviceProperties2KHR)
+            vkGetInstanceProcAddr(vk->inst, "vkGetPhysicalDeviceProperties2KHR");
+    }
+
     if (debug) {
         // Set up a debug callback to catch validation messages
         VkDebugReportCallbackCreateInfoEXT dinfo = {
@@ -437,6 +474,22 @@ static void add_qinfo(void *tactx, VkDeviceQueueCreateInfo **qinfos,
     MP_TARRAY_APPEND(tactx, *qinfos, *num_qinfos, qinfo);
 }
 
+#if defined(VK_KHR_external_memory_fd) && defined(VK_KHR_external_semaphore_fd)
+// Whether all of the given extensions are in the list of device extensions.
+static bool has_dev_exts(VkExtensionProperties *dev_exts, int num_dev_exts,
+                         const char **names, int num_names)
+{
+    for (int n = 0; n < num_names; n++) {
+        bool found = false;
+        for (int i = 0; i < num_dev_exts && !found; i++)
+            found = strcmp(dev_exts[i].extensionName, names[n]) == 0;
+        if (!found)
+            return false;
+    }
+    return true;
+}
+#endif
+
 bool mpvk_device_init(struct mpvk_ctx *vk, struct mpvk_device_opts opts)
 {
     assert(vk->physd);
@@ -498,6 +551,60 @@ bool mpvk_device_init(struct mpvk_ctx *vk, struct mpvk_device_opts opts)
     if (vk->spirv->required_ext)
         MP_TARRAY_APPEND(tmp, exts, num_exts, vk->spirv->required_ext);
 
+    // Optional extensions
+    uint32_t num_dev_exts = 0;
+    VK(vkEnumerateDeviceExtensionProperties(vk->physd, NULL, &num_dev_exts, NULL));
+    VkExtensionProperties *dev_exts =
+        talloc_array(tmp, VkExtensionProperties, num_dev_exts);
+    VK(vkEnumerateDeviceExtensionProperties(vk->physd, NULL, &num_dev_exts,
+                                            dev_exts));
+    for (int i = 0; i < num_dev_exts; i++) {
+        const char *name = VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME;
+        if (strcmp(dev_exts[i].extensionName, name) == 0) {
+            MP_TARRAY_APPEND(tmp, exts, num_exts, name);
+            vk->has_display_timing = true;
+        }
+#ifdef VK_EXT_memory_budget
+        name = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+        if (strcmp(dev_exts[i].extensionName, name) == 0 &&
+            vk->GetPhysicalDeviceMemoryProperties2)
+        {
+            MP_TARRAY_APPEND(tmp, exts, num_exts, name);
+            vk->has_memory_budget = true;
+        }
+#endif
+    }
+
+    // External memory and semaphores, for hwdec interop. Each of these needs
+    // the base extension too, so only enable them together.
+#if defined(VK_KHR_external_memory_fd) && defined(VK_KHR_external_semaphore_fd)
+    const char *ext_mem[] = {
+        VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
+        VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+    };
+    const char *ext_sem[] = {
+        VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME,
+        VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
+    };
+    if (has_dev_exts(dev_exts, num_dev_exts, ext_mem, MP_ARRAY_SIZE(ext_mem))) {
+        for (int n = 0; n < MP_ARRAY_SIZE(ext_mem); n++)
+            MP_TARRAY_APPEND(tmp, exts, num_exts, ext_mem[n]);
+        vk->has_ext_mem_fd = true;
+#ifdef VK_EXT_external_memory_dma_buf
+        const char *name = VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME;
+        if (has_dev_exts(dev_exts, num_dev_exts, &name, 1)) {
+            MP_TARRAY_APPEND(tmp, exts, num_exts, name);
+            vk->has_ext_mem_dmabuf = true;
+        }
+#endif
+    }
+    if (has_dev_exts(dev_exts, num_dev_exts, ext_sem, MP_ARRAY_SIZE(ext_sem))) {
+        for (int n = 0; n < MP_ARRAY_SIZE(ext_sem); n++)
+            MP_TARRAY_APPEND(tmp, exts, num_exts, ext_sem[n]);
+        vk->has_ext_sem_fd = true;
+    }
+#endif
+
     VkDeviceCreateInfo dinfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .pQueueCreateInfos = qinfos,
@@ -512,6 +619,24 @@ bool mpvk_device_init(struct mpvk_ctx *vk, struct mpvk_device_opts opts)
 
     VK(vkCreateDevice(vk->physd, &dinfo, MPVK_ALLOCATOR, &vk->dev));
 
+#ifdef VK_KHR_external_memory_fd
+    if (vk->has_ext_mem_fd) {
+        vk->GetMemoryFdKHR = (PFN_vkGetMemoryFdKHR)
+            vkGetDeviceProcAddr(vk->dev, "vkGetMemoryFdKHR");
+        vk->GetMemoryFdPropertiesKHR = (PFN_vkGetMemoryFdPropertiesKHR)
+            vkGetDeviceProcAddr(vk->dev, "vkGetMemoryFdPropertiesKHR");
+        vk->has_ext_mem_fd = vk->GetMemoryFdKHR && vk->GetMemoryFdPropertiesKHR;
+        vk->has_ext_mem_dmabuf &= vk->has_ext_mem_fd;
+    }
+#endif
+#ifdef VK_KHR_external_semaphore_fd
+    if (vk->has_ext_sem_fd) {
+        vk->GetSemaphoreFdKHR = (PFN_vkGetSemaphoreFdKHR)
+            vkGetDeviceProcAddr(vk->dev, "vkGetSemaphoreFdKHR");
+        vk->has_ext_sem_fd = !!vk->GetSemaphoreFdKHR;
+    }
+#endif
+
     // Create the command pools and memory allocator
     for (int i = 0; i < num_qinfos; i++) {
         int qf = qinfos[i].queueFamilyIndex;
@@ -683,7 +808,7 @@ void mpvk_poll_commands(struct mpvk_ctx *vk, uint64_t timeout)
     }
 }
 
-bool mpvk_flush_commands(struct mpvk_ctx *vk)
+bool mpvk_submit_commands(struct mpvk_ctx *vk)
 {
     bool ret = true;
 
@@ -722,6 +847,12 @@ error:
     }
 
     vk->num_cmds_queued = 0;
+    return ret;
+}
+
+bool mpvk_flush_commands(struct mpvk_ctx *vk)
+{
+    bool ret = mpvk_submit_commands(vk);
 
     // Rotate the queues to ensure good parallelism across frames
     for (int i = 0; i < vk->num_pools; i++) {
@@ -76,6 +76,11 @@ void mpvk_poll_commands(struct mpvk_ctx *vk, uint64_t timeout);
 // Returns whether successful. Failed commands will be implicitly dropped.
 bool mpvk_flush_commands(struct mpvk_ctx *vk);
 
+// Like mpvk_flush_commands, but doesn't rotate the queues. Can be called
+// mid-frame to get work onto the GPU early, e.g. uploads on the async transfer
+// queue, which can then overlap with rendering.
+bool mpvk_submit_commands(struct mpvk_ctx *vk);
+
 // Since lots of vulkan operations need to be done lazily once the affected
 // resources are no longer in use, provide an abstraction for tracking these.
 // In practice, these are only checked and run when submitting new commands, so
@@ -18,6 +18,7 @@
 #include <poll.h>
 #include <unistd.h>
 #include <linux/input.h>
+#include <time.h>
 #include "common/msg.h"
 #include "input/input.h"
 #include "input/keycodes.h"
@@ -35,6 +36,9 @@
 // Generated from server-decoration.xml
 #include "video/out/wayland/srv-decor.h"
 
+// Generated from presentation-time.xml
+#include "video/out/wayland/presentation-time.h"
+
 static void xdg_shell_ping(void *data, struct zxdg_shell_v6 *shell, uint32_t serial)
 {
     zxdg_shell_v6_pong(shell, serial);
@@ -776,6 +780,104 @@ static const struct wl_callback_listener frame_listener = {
     frame_callback,
 };
 
+static void pres_set_clockid(void *data, struct wp_presentation *pres,
+                             uint32_t clockid)
+{
+    struct vo_wayland_state *wl = data;
+    wl->presentation_clock = clockid;
+}
+
+static const struct wp_presentation_listener pres_listener = {
+    pres_set_clockid,
+};
+
+static void remove_feedback(struct vo_wayland_state *wl,
+                            struct wp_presentation_feedback *fback)
+{
+    for (int n = 0; n < wl->num_feedbacks; n++) {
+        if (wl->feedbacks[n] == fback) {
+            MP_TARRAY_REMOVE_AT(wl->feedbacks, wl->num_feedbacks, n);
+            break;
+        }
+    }
+    wp_presentation_feedback_destroy(fback);
+}
+
+static void feedback_sync_output(void *data, struct wp_presentation_feedback *fback,
+                                 struct wl_output *output)
+{
+}
+
+static void feedback_presented(void *data, struct wp_presentation_feedback *fback,
+                               uint32_t tv_sec_hi, uint32_t tv_sec_lo,
+                               uint32_t tv_nsec, uint32_t refresh_nsec,
+                               uint32_t seq_hi, uint32_t seq_lo, uint32_t flags)
+{
+    struct vo_wayland_state *wl = data;
+    remove_feedback(wl, fback);
+
+    // Translate the timestamp from the presentation clock to mp_time_us().
+    struct timespec ts;
+    if (clock_gettime(wl->presentation_clock, &ts))
+        return;
+    int64_t now = ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000;
+    int64_t sec = ((uint64_t)tv_sec_hi << 32) | tv_sec_lo;
+    int64_t ust = sec * INT64_C(1000000) + tv_nsec / 1000;
+    uint64_t msc = ((uint64_t)seq_hi << 32) | seq_lo;
+
+    // The counter is only meaningful if the compositor is locked to vsync.
+    if ((flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC) && msc && wl->last_msc &&
+        msc > wl->last_msc + 1)
+        wl->skipped_vsyncs += msc - wl->last_msc - 1;
+
+    wl->last_msc = msc;
+    wl->last_present_time = mp_time_us() - (now - ust);
+    wl->refresh_interval = refresh_nsec / 1000;
+}
+
+static void feedback_discarded(void *data, struct wp_presentation_feedback *fback)
+{
+    struct vo_wayland_state *wl = data;
+    remove_feedback(wl, fback);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+    feedback_sync_output,
+    feedback_presented,
+    feedback_discarded,
+};
+
+// Must be called before each commit of a new frame (i.e. before swapping
+// buffers), so that vo_wayland_get_vsync() can return actual timings.
+void vo_wayland_request_feedback(struct vo_wayland_state *wl)
+{
+    if (!wl->presentation)
+        return;
+
+    // Compositors should always send an event, but don't let it grow forever.
+    if (wl->num_feedbacks == MP_WL_MAX_FEEDBACKS)
+        remove_feedback(wl, wl->feedbacks[0]);
+
+    struct wp_presentation_feedback *fback =
+        wp_presentation_feedback(wl->presentation, wl->surface);
+    wp_presentation_feedback_add_listener(fback, &feedback_listener, wl);
+    wl->feedbacks[wl->num_feedbacks++] = fback;
+}
+
+void vo_wayland_get_vsync(struct vo *vo, struct vo_vsync_info *info)
+{
+    struct vo_wayland_state *wl = vo->wl;
+
+    if (!wl->presentation || !wl->last_present_time)
+        return;
+
+    // Frames still in flight are shown one per vsync after the last one.
+    info->last_queue_display_time = wl->last_present_time +
+                                    wl->num_feedbacks * wl->refresh_interval;
+    info->skipped_vsyncs = wl->skipped_vsyncs;
+    wl->skipped_vsyncs = 0;
+}
+
 static void registry_handle_add(void *data, struct wl_registry *reg, uint32_t id,
                                 const char *interface, uint32_t ver)
 {
@@ -831,6 +933,12 @@ static void registry_handle_add(void *data, struct wl_registry *reg, uint32_t id
         wl->idle_inhibit_manager = wl_registry_bind(reg, id, &zwp_idle_inhibit_manager_v1_interface, 1);
     }
 
+    if (!strcmp(interface, wp_presentation_interface.name) && found++) {
+        wl->presentation = wl_registry_bind(reg, id, &wp_presentation_interface, 1);
+        wl->presentation_clock = CLOCK_MONOTONIC; // until the compositor tells
+        wp_presentation_add_listener(wl->presentation, &pres_listener, wl);
+    }
+
     if (found > 1)
         MP_VERBOSE(wl, "Registered for protocol %s\n", interface);
 }
@@ -1094,6 +1202,12 @@ void vo_wayland_uninit(struct vo *vo)
     if (wl->frame_callback)
         wl_callback_destroy(wl->frame_callback);
 
+    while (wl->num_feedbacks)
+        remove_feedback(wl, wl->feedbacks[0]);
+
+    if (wl->presentation)
+        wp_presentation_destroy(wl->presentation);
+
     if (wl->display) {
         close(wl_display_get_fd(wl->display));
         wl_display_disconnect(wl->display);
@@ -41,6 +41,8 @@ struct vo_wayland_output {
     struct wl_list link;
 };
 
+#define MP_WL_MAX_FEEDBACKS 8
+
 struct vo_wayland_state {
     struct mp_log        *log;
     struct vo            *vo;
@@ -77,6 +79,16 @@ struct vo_wayland_state {
     struct zwp_idle_inhibit_manager_v1 *idle_inhibit_manager;
     struct zwp_idle_inhibitor_v1 *idle_inhibitor;
 
+    /* Presentation feedback */
+    struct wp_presentation *presentation;
+    uint32_t presentation_clock;
+    struct wp_presentation_feedback *feedbacks[MP_WL_MAX_FEEDBACKS];
+    int num_feedbacks;          // requested, but not presented/discarded yet
+    int64_t last_present_time;  // mp_time_us() of the last presented frame
+    int64_t refresh_interval;   // in us, 0 if unknown
+    uint64_t last_msc;          // vsync counter of the last presented frame
+    int64_t skipped_vsyncs;     // since the last vo_wayland_get_vsync() call
+
     /* Input */
     struct wl_seat     *seat;
     struct wl_pointer  *pointer;
@@ -109,5 +121,7 @@ void vo_wayland_check_events(struct vo *vo);
 void vo_wayland_uninit(struct vo *vo);
 void vo_wayland_wakeup(struct vo *vo);
 void vo_wayland_wait_events(struct vo *vo, int64_t until_time_us);
+void vo_wayland_request_feedback(struct vo_wayland_state *wl);
+void vo_wayland_get_vsync(struct vo *vo, struct vo_vsync_info *info);
 
 #endif /* MPLAYER_WAYLAND_COMMON_H */
@@ -24,6 +24,7 @@
 #include <poll.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 #include <X11/Xmd.h>
 #include <X11/Xlib.h>
@@ -39,6 +40,10 @@
 #include <X11/extensions/Xrandr.h>
 
 #include "config.h"
+
+#if HAVE_XPRESENT
+#include <X11/extensions/Xpresent.h>
+#endif
 #include "misc/bstr.h"
 #include "options/options.h"
 #include "options/m_config.h"
@@ -540,6 +545,7 @@ int vo_x11_init(struct vo *vo)
         .input_ctx = vo->input_ctx,
         .screensaver_enabled = true,
         .xrandr_event = -1,
+        .present_code = -1,
         .wakeup_pipe = {-1, -1},
         .dpi_scale = 1,
     };
@@ -616,6 +622,17 @@ int vo_x11_init(struct vo *vo)
 
     xrandr_read(x11);
 
+#if HAVE_XPRESENT
+    int present_event, present_error;
+    if (XPresentQueryExtension(x11->display, &x11->present_code,
+                               &present_event, &present_error))
+    {
+        MP_VERBOSE(x11, "Using Present extension for frame timing.\n");
+    } else {
+        x11->present_code = -1;
+    }
+#endif
+
     vo_x11_update_geometry(vo);
 
     return 1;
@@ -1039,6 +1056,92 @@ static void vo_x11_check_net_wm_state_fullscreen_change(struct vo *vo)
     }
 }
 
+#if HAVE_XPRESENT
+static void present_complete(struct vo_x11_state *x11, uint64_t ust,
+                             uint64_t msc)
+{
+    if (x11->num_pending_presents > 0)
+        x11->num_pending_presents--;
+
+    // The UST is CLOCK_MONOTONIC in microseconds; translate it to mp_time_us().
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts))
+        return;
+    int64_t now = ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000;
+
+    if (x11->last_present_msc && msc > x11->last_present_msc) {
+        uint64_t vsyncs = msc - x11->last_present_msc;
+        x11->present_interval = (ust - x11->last_present_ust) / vsyncs;
+        x11->skipped_vsyncs += vsyncs - 1;
+    }
+
+    x11->last_present_ust = ust;
+    x11->last_present_msc = msc;
+    x11->last_present_time = mp_time_us() - (now - (int64_t)ust);
+}
+#endif
+
+static void present_handle_event(struct vo_x11_state *x11, XEvent *ev)
+{
+#if HAVE_XPRESENT
+    XGenericEventCookie *cookie = &ev->xcookie;
+    if (!XGetEventData(x11->display, cookie))
+        return;
+    if (cookie->evtype == PresentCompleteNotify) {
+        XPresentCompleteNotifyEvent *ce = cookie->data;
+        if (ce->kind == PresentCompleteKindPixmap && ce->window == x11->window)
+            present_complete(x11, ce->ust, ce->msc);
+    }
+    XFreeEventData(x11->display, cookie);
+#endif
+}
+
+static Bool is_present_event(Display *display, XEvent *ev, XPointer arg)
+{
+    struct vo_x11_state *x11 = (void *)arg;
+    return ev->type == GenericEvent && ev->xcookie.extension == x11->present_code;
+}
+
+// Must be called after each swap of a new frame, so that vo_x11_get_vsync()
+// can account for frames that were queued, but not displayed yet.
+void vo_x11_present_swapped(struct vo *vo)
+{
+    struct vo_x11_state *x11 = vo->x11;
+
+    if (x11->present_code < 0)
+        return;
+
+    // The driver might not use Present (or not for this window) at all, in
+    // which case no completion events will ever arrive.
+    if (x11->num_pending_presents == MP_X11_MAX_PENDING_PRESENTS) {
+        x11->num_pending_presents = 0;
+        x11->last_present_time = 0;
+    }
+    x11->num_pending_presents++;
+}
+
+void vo_x11_get_vsync(struct vo *vo, struct vo_vsync_info *info)
+{
+    struct vo_x11_state *x11 = vo->x11;
+
+    if (x11->present_code < 0)
+        return;
+
+    // Pick up completion events only; the rest is left to vo_x11_check_events.
+    XEvent ev;
+    while (XCheckIfEvent(x11->display, &ev, is_present_event, (XPointer)x11))
+        present_handle_event(x11, &ev);
+
+    if (!x11->last_present_time || !x11->present_interval)
+        return;
+
+    // Frames still in flight are shown one per vsync after the last one.
+    info->last_queue_display_time = x11->last_present_time +
+                            x11->num_pending_presents * x11->present_interval;
+    info->skipped_vsyncs = x11->skipped_vsyncs;
+    x11->skipped_vsyncs = 0;
+}
+
 void vo_x11_check_events(struct vo *vo)
 {
     struct vo_x11_state *x11 = vo->x11;
@@ -1193,6 +1296,9 @@ void vo_x11_check_events(struct vo *vo)
                 xrandr_read(x11);
                 vo_x11_update_geometry(vo);
             }
+            if (Event.type == GenericEvent &&
+                Event.xcookie.extension == x11->present_code)
+                present_handle_event(x11, &Event);
             break;
         }
     }
@@ -1546,6 +1652,13 @@ bool vo_x11_create_vo_window(struct vo *vo, XVisualInfo *vis,
         x11->window_hidden = true;
     }
 
+#if HAVE_XPRESENT
+    if (x11->window && x11->present_code >= 0) {
+        XPresentSelectInput(x11->display, x11->window,
+                            PresentCompleteNotifyMask);
+    }
+#endif
+
     return !!x11->window;
 }
 
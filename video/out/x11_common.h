@@ -35,10 +35,14 @@
 #endif
 
 struct vo;
+struct vo_vsync_info;
 struct mp_log;
 
 #define MAX_DISPLAYS 32 // ought to be enough for everyone
 
+// Swaps without completion event after which Present feedback is given up.
+#define MP_X11_MAX_PENDING_PRESENTS 8
+
 struct xrandr_display {
     struct mp_rect rc;
     double fps;
@@ -69,6 +73,15 @@ struct vo_x11_state {
 
     int xrandr_event;
 
+    /* Present extension frame timing feedback */
+    int present_code;           // major opcode, or -1 if unavailable
+    int num_pending_presents;   // swapped, but not completed yet
+    int64_t last_present_time;  // mp_time_us() of the last completed frame
+    int64_t present_interval;   // measured vsync duration in microseconds
+    int64_t skipped_vsyncs;     // since the last vo_x11_get_vsync() call
+    uint64_t last_present_ust;
+    uint64_t last_present_msc;
+
     bool screensaver_enabled;
     bool dpms_touched;
     double screensaver_time_last;
@@ -135,6 +148,8 @@ struct vo_x11_state {
 int vo_x11_init(struct vo *vo);
 void vo_x11_uninit(struct vo *vo);
 void vo_x11_check_events(struct vo *vo);
+void vo_x11_present_swapped(struct vo *vo);
+void vo_x11_get_vsync(struct vo *vo, struct vo_vsync_info *info);
 bool vo_x11_screen_is_composited(struct vo *vo);
 bool vo_x11_create_vo_window(struct vo *vo, XVisualInfo *vis,
                              const char *classname);
@@ -16,10 +16,12 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 
 #include <libswscale/swscale.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/bswap.h>
+#include <libavutil/cpu.h>
 #include <libavutil/opt.h>
 
 #include "config.h"
@@ -34,6 +36,7 @@
 #include "fmt-conversion.h"
 #include "csputils.h"
 #include "common/msg.h"
+#include "misc/thread_pool.h"
 #include "osdep/endian.h"
 
 //global sws_flags from the command line
@@ -45,6 +48,7 @@ struct sws_opts {
     int chr_hshift;
     float chr_sharpen;
     float lum_sharpen;
+    int threads;
 };
 
 #define OPT_BASE_STRUCT struct sws_opts
@@ -68,6 +72,8 @@ const struct m_sub_options sws_conf = {
         OPT_INT("chs", chr_hshift, 0),
         OPT_FLOATRANGE("ls", lum_sharpen, 0, -100.0, 100.0),
         OPT_FLOATRANGE("cs", chr_sharpen, 0, -100.0, 100.0),
+        OPT_CHOICE_OR_INT("threads", threads, 0, 1, MP_SWS_MAX_THREADS,
+                          ({"auto", 0})),
         {0}
     },
     .size = sizeof(struct sws_opts),
@@ -90,14 +96,27 @@ void mp_sws_set_from_cmdline(struct mp_sws_context *ctx, struct mpv_global *g)
     struct sws_opts *opts = mp_get_config_group(NULL, g, &sws_conf);
 
     sws_freeFilter(ctx->src_filter);
-    ctx->src_filter = sws_getDefaultFilter(opts->lum_gblur, opts->chr_gblur,
-                                           opts->lum_sharpen, opts->chr_sharpen,
-                                           opts->chr_hshift, opts->chr_vshift, 0);
+    ctx->src_filter = NULL;
+    // The default filter is the identity, so skip it if possible (this also
+    // allows threaded scaling, see scale_threaded()).
+    if (opts->lum_gblur || opts->chr_gblur || opts->lum_sharpen ||
+        opts->chr_sharpen || opts->chr_hshift || opts->chr_vshift)
+    {
+        ctx->src_filter = sws_getDefaultFilter(opts->lum_gblur, opts->chr_gblur,
+                                               opts->lum_sharpen,
+                                               opts->chr_sharpen,
+                                               opts->chr_hshift,
+                                               opts->chr_vshift, 0);
+    }
     ctx->force_reload = true;
 
     ctx->flags = SWS_PRINT_INFO;
     ctx->flags |= opts->scaler;
 
+    ctx->threads = opts->threads;
+    if (!ctx->threads)
+        ctx->threads = MPCLAMP(av_cpu_count(), 1, MP_SWS_MAX_THREADS);
+
     talloc_free(opts);
 }
 
@@ -251,12 +270,170 @@ int mp_sws_reinit(struct mp_sws_context *ctx)
     return 1;
 }
 
+struct sws_slice {
+    struct mp_sws_context *sws;
+    struct mp_image *tmp;   // output including the padding rows
+    struct mp_image src;    // source rows including padding
+    struct mp_image dst;    // part of the real output written by this slice
+    int skip;               // padding rows at the top of tmp
+    int ret;
+};
+
+struct mp_sws_slices {
+    struct mp_thread_pool *pool;
+    int num_threads;
+    struct sws_slice slices[MP_SWS_MAX_THREADS];
+};
+
+static void scale_slice(void *arg)
+{
+    struct sws_slice *s = arg;
+
+    s->ret = mp_sws_scale(s->sws, s->tmp, &s->src);
+    if (s->ret >= 0) {
+        struct mp_image part = *s->tmp;
+        mp_image_crop(&part, 0, s->skip, part.w, s->skip + s->dst.h);
+        mp_image_copy(&s->dst, &part);
+    }
+}
+
+static int gcd(int a, int b)
+{
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Scale the image as horizontal stripes on multiple threads. The stripes are
+// chosen such that their borders fall on rows where source and destination are
+// aligned exactly (same scaling ratio and phase as the full image), and each
+// stripe is scaled with enough surrounding rows that the filter doesn't see
+// the edge. The result is then the same as scaling the full image at once.
+// Returns 1 if the image can't be split this way, otherwise like mp_sws_scale.
+static int scale_threaded(struct mp_sws_context *ctx, struct mp_image *dst,
+                          struct mp_image *src)
+{
+    int threads = MPMIN(ctx->threads, MP_SWS_MAX_THREADS);
+    if (ctx->src_filter || ctx->dst_filter)
+        return 1;
+    if ((src->fmt.flags | dst->fmt.flags) & (MP_IMGFLAG_PAL | MP_IMGFLAG_HWACCEL))
+        return 1;
+    if (src->h < 1 || dst->h < 1)
+        return 1;
+
+    // Smallest stripe height that keeps source and destination aligned.
+    int g = gcd(src->h, dst->h);
+    int unit_src = src->h / g, unit_dst = dst->h / g;
+    int k = 1;
+    while ((unit_src * k) % src->fmt.align_y || (unit_dst * k) % dst->fmt.align_y)
+        k++;
+    if (g % k)
+        return 1;
+    unit_src *= k;
+    unit_dst *= k;
+    int num_units = g / k;
+
+    // Rows of context the filter may need around a stripe; generous enough
+    // for the widest libswscale kernels, also when downscaling.
+    int pad_rows = 8 * MPMAX(1, (src->h + dst->h - 1) / dst->h);
+    int pad = (pad_rows + unit_src - 1) / unit_src;
+
+    // Don't bother if the stripes would be mostly padding.
+    threads = MPMIN(threads, num_units / MPMAX(pad * 2, 1));
+    if (threads < 2)
+        return 1;
+
+    struct mp_sws_slices *slices = ctx->slices;
+    if (slices && slices->num_threads != threads) {
+        talloc_free(slices);
+        slices = ctx->slices = NULL;
+    }
+    if (!slices) {
+        slices = talloc_zero(ctx, struct mp_sws_slices);
+        // The calling thread scales one of the slices.
+        slices->pool = mp_thread_pool_create(slices, threads - 1);
+        if (!slices->pool) {
+            talloc_free(slices);
+            return 1;
+        }
+        slices->num_threads = threads;
+        for (int n = 0; n < threads; n++) {
+            slices->slices[n] = (struct sws_slice){
+                .sws = mp_sws_alloc(slices),
+            };
+        }
+        ctx->slices = slices;
+    }
+
+    for (int n = 0; n < threads; n++) {
+        struct sws_slice *s = &slices->slices[n];
+
+        int u0 = num_units * (int64_t)n / threads;
+        int u1 = num_units * (int64_t)(n + 1) / threads;
+        int pu0 = MPMAX(u0 - pad, 0);
+        int pu1 = MPMIN(u1 + pad, num_units);
+
+        s->src = *src;
+        mp_image_crop(&s->src, 0, pu0 * unit_src, src->w, pu1 * unit_src);
+        s->dst = *dst;
+        mp_image_crop(&s->dst, 0, u0 * unit_dst, dst->w, u1 * unit_dst);
+        s->skip = (u0 - pu0) * unit_dst;
+
+        struct mp_image_params tmp_par = dst->params;
+        tmp_par.h = (pu1 - pu0) * unit_dst;
+        if (!s->tmp || s->tmp->imgfmt != tmp_par.imgfmt ||
+            s->tmp->w != tmp_par.w || s->tmp->h != tmp_par.h)
+        {
+            talloc_free(s->tmp);
+            s->tmp = mp_image_alloc(tmp_par.imgfmt, tmp_par.w, tmp_par.h);
+            if (!s->tmp)
+                return -1;
+            talloc_steal(slices, s->tmp);
+        }
+        mp_image_set_params(s->tmp, &tmp_par);
+
+        s->sws->log = ctx->log;
+        s->sws->flags = ctx->flags;
+        s->sws->brightness = ctx->brightness;
+        s->sws->contrast = ctx->contrast;
+        s->sws->saturation = ctx->saturation;
+        s->sws->params[0] = ctx->params[0];
+        s->sws->params[1] = ctx->params[1];
+        s->sws->force_reload |= ctx->force_reload;
+    }
+
+    struct mp_thread_pool_group group = {0};
+    for (int n = 0; n < threads; n++) {
+        mp_thread_pool_queue_group(slices->pool, &group, scale_slice,
+                                   &slices->slices[n]);
+    }
+    mp_thread_pool_wait(slices->pool, &group);
+
+    ctx->force_reload = false;
+
+    for (int n = 0; n < threads; n++) {
+        if (slices->slices[n].ret < 0)
+            return slices->slices[n].ret;
+    }
+    return 0;
+}
+
 // Scale from src to dst - if src/dst have different parameters from previous
 // calls, the context is reinitialized. Return error code. (It can fail if
 // reinitialization was necessary, and swscale returned an error.)
+// If ctx->threads is set, this may split the work across worker threads.
 int mp_sws_scale(struct mp_sws_context *ctx, struct mp_image *dst,
                  struct mp_image *src)
 {
+    if (ctx->threads > 1) {
+        int r = scale_threaded(ctx, dst, src);
+        if (r <= 0)
+            return r;
+    }
+
     ctx->src = src->params;
     ctx->dst = dst->params;
 
@@ -271,13 +448,81 @@ int mp_sws_scale(struct mp_sws_context *ctx, struct mp_image *dst,
     return 0;
 }
 
+// Contexts used by mp_image_swscale(), most recently used first. Callers like
+// draw_bmp.c and screenshots keep converting between the same parameters, and
+// initializing swscale can take longer than the conversion itself.
+#define SWS_CACHE_SIZE 4
+static pthread_mutex_t sws_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct mp_sws_context *sws_cache[SWS_CACHE_SIZE];
+
+static bool scale_params_equal(struct mp_image_params a,
+                               struct mp_image_params b)
+{
+    // Same as what mp_sws_reinit() ignores.
+    a.p_w = a.p_h = b.p_w = b.p_h = 0;
+    return mp_image_params_equal(&a, &b);
+}
+
+// Take a context out of the cache (or allocate a new one).
+static struct mp_sws_context *sws_cache_get(struct mp_image *dst,
+                                            struct mp_image *src, int flags)
+{
+    struct mp_sws_context *ctx = NULL;
+    pthread_mutex_lock(&sws_cache_lock);
+    for (int n = 0; n < SWS_CACHE_SIZE; n++) {
+        struct mp_sws_context *c = sws_cache[n];
+        if (c && c->flags == flags &&
+            scale_params_equal(c->src, src->params) &&
+            scale_params_equal(c->dst, dst->params))
+        {
+            ctx = c;
+            for (int i = n; i < SWS_CACHE_SIZE - 1; i++)
+                sws_cache[i] = sws_cache[i + 1];
+            sws_cache[SWS_CACHE_SIZE - 1] = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sws_cache_lock);
+    if (!ctx) {
+        ctx = mp_sws_alloc(NULL);
+        ctx->flags = flags;
+    }
+    return ctx;
+}
+
+// Put it back as most recently used entry; this evicts the oldest entry.
+static void sws_cache_put(struct mp_sws_context *ctx)
+{
+    pthread_mutex_lock(&sws_cache_lock);
+    struct mp_sws_context *old = sws_cache[SWS_CACHE_SIZE - 1];
+    for (int n = SWS_CACHE_SIZE - 1; n > 0; n--)
+        sws_cache[n] = sws_cache[n - 1];
+    sws_cache[0] = ctx;
+    pthread_mutex_unlock(&sws_cache_lock);
+    talloc_free(old);
+}
+
+// Free all cached mp_image_swscale() contexts.
+void mp_image_swscale_flush_cache(void)
+{
+    pthread_mutex_lock(&sws_cache_lock);
+    for (int n = 0; n < SWS_CACHE_SIZE; n++) {
+        talloc_free(sws_cache[n]);
+        sws_cache[n] = NULL;
+    }
+    pthread_mutex_unlock(&sws_cache_lock);
+}
+
 int mp_image_swscale(struct mp_image *dst, struct mp_image *src,
                      int my_sws_flags)
 {
-    struct mp_sws_context *ctx = mp_sws_alloc(NULL);
-    ctx->flags = my_sws_flags;
+    struct mp_sws_context *ctx = sws_cache_get(dst, src, my_sws_flags);
     int res = mp_sws_scale(ctx, dst, src);
-    talloc_free(ctx);
+    if (res < 0) {
+        talloc_free(ctx);
+    } else {
+        sws_cache_put(ctx);
+    }
     return res;
 }
 
@@ -13,6 +13,9 @@ struct mpv_global;
 // Guaranteed to be a power of 2 and > 1.
 #define SWS_MIN_BYTE_ALIGN 16
 
+// Upper bound for mp_sws_context.threads.
+#define MP_SWS_MAX_THREADS 16
+
 extern const int mp_sws_hq_flags;
 extern const int mp_sws_fast_flags;
 
@@ -20,6 +23,7 @@ bool mp_sws_supported_format(int imgfmt);
 
 int mp_image_swscale(struct mp_image *dst, struct mp_image *src,
                      int my_sws_flags);
+void mp_image_swscale_flush_cache(void);
 
 int mp_image_sw_blur_scale(struct mp_image *dst, struct mp_image *src,
                            float gblur);
@@ -32,6 +36,10 @@ struct mp_sws_context {
     int flags;
     int brightness, contrast, saturation;
     bool force_reload;
+    // If > 1, mp_sws_scale() may split the conversion into horizontal stripes
+    // processed in parallel. Set from --sws-threads by
+    // mp_sws_set_from_cmdline(), and 0 (single-threaded) otherwise.
+    int threads;
     // These are also implicitly set by mp_sws_scale(), and thus optional.
     // Setting them before that call makes sense when using mp_sws_reinit().
     struct mp_image_params src, dst;
@@ -48,6 +56,9 @@ struct mp_sws_context {
 
     // Contains parameters for which sws is valid
     struct mp_sws_context *cached;
+
+    // Worker threads and per-stripe contexts for threaded scaling
+    struct mp_sws_slices *slices;
 };
 
 struct mp_sws_context *mp_sws_alloc(void *talloc_ctx);
@@ -3,6 +3,7 @@ from waflib import TaskGen
 from io import StringIO
 from TOOLS.matroska import generate_C_header, generate_C_definitions
 from TOOLS.file2string import file2string
+from TOOLS.dither import generate_C_dither_matrices
 import os
 
 def __zshcomp_cmd__(ctx, argument):
@@ -46,6 +47,10 @@ def ebml_header(self):
 def ebml_definitions(self):
     execf(self, generate_C_definitions)
 
+@TaskGen.feature('dither_matrices')
+def dither_matrices(self):
+    execf(self, generate_C_dither_matrices)
+
 def __zshcomp__(ctx, **kwargs):
     ctx(
         rule   = __zshcomp_cmd__(ctx, ctx.bldnode.abspath() + '/mpv'),
@@ -129,6 +129,12 @@ def build(ctx):
         ctx.wayland_protocol_header(proto_dir = ctx.env.WL_PROTO_DIR,
             protocol  = "unstable/idle-inhibit/idle-inhibit-unstable-v1",
             target    = "video/out/wayland/idle-inhibit-v1.h")
+        ctx.wayland_protocol_code(proto_dir = ctx.env.WL_PROTO_DIR,
+            protocol  = "stable/presentation-time/presentation-time",
+            target    = "video/out/wayland/presentation-time.c")
+        ctx.wayland_protocol_header(proto_dir = ctx.env.WL_PROTO_DIR,
+            protocol  = "stable/presentation-time/presentation-time",
+            target    = "video/out/wayland/presentation-time.h")
         ctx.wayland_protocol_code(proto_dir = "../video/out/wayland",
             protocol = "server-decoration",
             target   = "video/out/wayland/srv-decor.c")
@@ -138,6 +144,7 @@ def build(ctx):
 
     ctx(features = "ebml_header", target = "ebml_types.h")
     ctx(features = "ebml_definitions", target = "ebml_defs.c")
+    ctx(features = "dither_matrices", target = "video/out/dither_matrix.inc")
 
     if ctx.dependency_satisfied('cplayer'):
         main_fn_c = ctx.pick_first_matching_dep([
@@ -227,11 +234,13 @@ def build(ctx):
         ( "common/common.c" ),
         ( "common/tags.c" ),
         ( "common/msg.c" ),
+        ( "common/stats.c" ),
         ( "common/playlist.c" ),
         ( "common/recorder.c" ),
         ( "common/version.c" ),
 
         ## Demuxers
+        ( "demux/cache.c" ),
         ( "demux/codec_tags.c" ),
         ( "demux/cue.c" ),
         ( "demux/demux.c" ),
@@ -268,6 +277,7 @@ def build(ctx):
         ( "misc/charset_conv.c" ),
         ( "misc/dispatch.c" ),
         ( "misc/json.c" ),
+        ( "misc/msgpack.c" ),
         ( "misc/node.c" ),
         ( "misc/ring.c" ),
         ( "misc/rendezvous.c" ),
@@ -284,6 +294,7 @@ def build(ctx):
 
         ## Player
         ( "player/audio.c" ),
+        ( "player/audio_cache.c" ),
         ( "player/client.c" ),
         ( "player/command.c" ),
         ( "player/configfiles.c" ),
@@ -298,7 +309,9 @@ def build(ctx):
         ( "player/playloop.c" ),
         ( "player/screenshot.c" ),
         ( "player/scripting.c" ),
+        ( "player/stats_overlay.c" ),
         ( "player/sub.c" ),
+        ( "player/thumbnails.c" ),
         ( "player/video.c" ),
 
         ## Streams
@@ -334,6 +347,7 @@ def build(ctx):
         ( "stream/tv.c",                         "tv" ),
         ( "stream/tvi_dummy.c",                  "tv" ),
         ( "stream/tvi_v4l2.c",                   "tv-v4l2"),
+        ( "stream/uring.c",                      "liburing" ),
 
         ## Subtitles
         ( "sub/ass_mp.c",                        "libass"),
@@ -381,6 +395,7 @@ def build(ctx):
         ( "video/out/cocoa/window.m",            "cocoa" ),
         ( "video/out/cocoa_common.m",            "cocoa" ),
         ( "video/out/dither.c" ),
+        ( "video/out/dr_helper.c" ),
         ( "video/out/filter_kernels.c" ),
         ( "video/out/d3d11/context.c",           "d3d11" ),
         ( "video/out/d3d11/hwdec_d3d11va.c",     "d3d11 && d3d-hwaccel" ),
@@ -391,6 +406,7 @@ def build(ctx):
         ( "video/out/gpu/d3d11_helpers.c",       "d3d11 || egl-angle-win32" ),
         ( "video/out/gpu/hwdec.c" ),
         ( "video/out/gpu/lcms.c" ),
+        ( "video/out/gpu/libmpv_gpu.c" ),
         ( "video/out/gpu/osd.c" ),
         ( "video/out/gpu/ra.c" ),
         ( "video/out/gpu/spirv.c" ),
@@ -430,6 +446,7 @@ def build(ctx):
         ( "video/out/opengl/hwdec_rpi.c",        "rpi" ),
         ( "video/out/opengl/hwdec_vaegl.c",      "vaapi-egl" ),
         ( "video/out/opengl/hwdec_vdpau.c",      "vdpau-gl-x11" ),
+        ( "video/out/opengl/libmpv_gl.c",        "gl" ),
         ( "video/out/vo.c" ),
         ( "video/out/vo_mediacodec_embed.c",     "android" ),
         ( "video/out/vo_caca.c",                 "caca" ),
@@ -440,7 +457,7 @@ def build(ctx):
         ( "video/out/vo_rpi.c",                  "rpi" ),
         ( "video/out/vo_null.c" ),
         ( "video/out/vo_gpu.c" ),
-        ( "video/out/vo_opengl_cb.c",            "gl" ),
+        ( "video/out/vo_libmpv.c" ),
         ( "video/out/vo_sdl.c",                  "sdl2" ),
         ( "video/out/vo_tct.c" ),
         ( "video/out/vo_vaapi.c",                "vaapi-x11 && gpl" ),
@@ -458,10 +475,12 @@ def build(ctx):
         ( "video/out/vulkan/context_xlib.c",     "vulkan && x11" ),
         ( "video/out/vulkan/context_wayland.c",  "vulkan && wayland" ),
         ( "video/out/vulkan/context_win.c",      "vulkan && win32-desktop" ),
+        ( "video/out/vulkan/hwdec_vaapi.c",      "vaapi-vulkan" ),
         ( "video/out/vulkan/spirv_nvidia.c",     "vulkan" ),
         ( "video/out/wayland_common.c",          "wayland" ),
         ( "video/out/wayland/xdg-shell-v6.c",    "wayland" ),
         ( "video/out/wayland/idle-inhibit-v1.c", "wayland" ),
+        ( "video/out/wayland/presentation-time.c", "wayland" ),
         ( "video/out/wayland/srv-decor.c",       "wayland" ),
         ( "video/out/win_state.c"),
         ( "video/out/x11_common.c",              "x11" ),
@@ -530,7 +549,8 @@ def build(ctx):
                 ctx.path.find_node('osdep/mpv.rc'),
                 version)
 
-    if ctx.dependency_satisfied('cplayer') or ctx.dependency_satisfied('test'):
+    if ctx.dependency_satisfied('cplayer') or ctx.dependency_satisfied('test') \
+            or ctx.dependency_satisfied('bench'):
         ctx(
             target       = "objects",
             source       = ctx.filtered_sources(sources),
@@ -583,6 +603,19 @@ def build(ctx):
                 install_path = None,
             )
 
+    # Each program prints one JSON object per benchmark and line, see
+    # bench/bench.h.
+    if ctx.dependency_satisfied('bench'):
+        for bench in ctx.path.ant_glob("bench/*.c"):
+            ctx(
+                target       = os.path.splitext(bench.srcpath())[0],
+                source       = bench.srcpath(),
+                use          = ctx.dependencies_use() + ['objects'],
+                includes     = _all_includes(ctx),
+                features     = "c cprogram",
+                install_path = None,
+            )
+
     build_shared = ctx.dependency_satisfied('libmpv-shared')
     build_static = ctx.dependency_satisfied('libmpv-static')
     if build_shared or build_static:
@@ -651,7 +684,8 @@ def build(ctx):
             PRIV_LIBS    = get_deps(),
         )
 
-        headers = ["client.h", "qthelper.hpp", "opengl_cb.h", "stream_cb.h"]
+        headers = ["client.h", "qthelper.hpp", "opengl_cb.h", "render.h",
+                   "render_gl.h", "stream_cb.h", "frame_tap.h"]
         for f in headers:
             ctx.install_as(ctx.env.INCDIR + '/mpv/' + f, 'libmpv/' + f)
 